@@ -0,0 +1,825 @@
+#include "NoFloatContraction.h"
+#include "AnisotropicMips.h"
+#include "CPUVoxeliser.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define ANISOTROPIC_X86_SIMD 1
+#include <emmintrin.h>
+#else
+#define ANISOTROPIC_X86_SIMD 0
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//IEEE 754 half precision, rounding to nearest even like the GPU does when it writes a float16 target
+	uint16_t FloatToHalf(float fValue)
+	{
+		uint32_t iBits;
+		memcpy(&iBits, &fValue, sizeof(iBits));
+		uint32_t iSign = (iBits >> 16) & 0x8000;
+		uint32_t iAbs = iBits & 0x7fffffff;
+
+		if (iAbs >= 0x7f800000)
+		{
+			//inf stays inf, NaN stays a quiet NaN
+			return static_cast<uint16_t>(iSign | 0x7c00 | (iAbs > 0x7f800000 ? 0x200 : 0));
+		}
+		if (iAbs >= 0x477ff000)
+		{
+			//rounds up past the largest half
+			return static_cast<uint16_t>(iSign | 0x7c00);
+		}
+		if (iAbs < 0x38800000)
+		{
+			//denormal, or flushes to zero below half the smallest denormal
+			if (iAbs < 0x33000000)
+			{
+				return static_cast<uint16_t>(iSign);
+			}
+			uint32_t iMantissa = (iAbs & 0x7fffff) | 0x800000;
+			int iShift = 126 - static_cast<int>(iAbs >> 23);
+			uint32_t iHalf = iMantissa >> iShift;
+			uint32_t iRemainder = iMantissa & ((1u << iShift) - 1);
+			uint32_t iHalfway = 1u << (iShift - 1);
+			if (iRemainder > iHalfway || (iRemainder == iHalfway && (iHalf & 1)))
+			{
+				iHalf++;
+			}
+			return static_cast<uint16_t>(iSign | iHalf);
+		}
+
+		uint32_t iHalf = ((iAbs - 0x38000000) >> 13);
+		uint32_t iRemainder = iAbs & 0x1fff;
+		if (iRemainder > 0x1000 || (iRemainder == 0x1000 && (iHalf & 1)))
+		{
+			iHalf++;
+		}
+		return static_cast<uint16_t>(iSign | iHalf);
+	}
+
+	float HalfToFloat(uint16_t iHalf)
+	{
+		uint32_t iSign = static_cast<uint32_t>(iHalf & 0x8000) << 16;
+		uint32_t iExponent = (iHalf >> 10) & 0x1f;
+		uint32_t iMantissa = iHalf & 0x3ff;
+		uint32_t iBits;
+		if (iExponent == 0x1f)
+		{
+			iBits = iSign | 0x7f800000 | (iMantissa << 13);
+		}
+		else if (iExponent != 0)
+		{
+			iBits = iSign | ((iExponent + 112) << 23) | (iMantissa << 13);
+		}
+		else if (iMantissa == 0)
+		{
+			iBits = iSign;
+		}
+		else
+		{
+			//denormal, normalise it
+			iExponent = 113;
+			while ((iMantissa & 0x400) == 0)
+			{
+				iMantissa <<= 1;
+				iExponent--;
+			}
+			iBits = iSign | (iExponent << 23) | ((iMantissa & 0x3ff) << 13);
+		}
+		float fValue;
+		memcpy(&fValue, &iBits, sizeof(fValue));
+		return fValue;
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	//Loads and stores for each format, as 4 floats for the scalar path and an __m128 for the SSE one. Both do the
+	//same float operations so the two paths give identical texels.
+	struct TexelRGBA8
+	{
+		typedef uint32_t Type;
+
+		static void Load(uint32_t iTexel, float* pOut)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				pOut[i] = static_cast<float>((iTexel >> (i * 8)) & 0xff) * (1.f / 255.f);
+			}
+		}
+
+		static uint32_t Store(const float* pIn)
+		{
+			uint32_t iTexel = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				float fValue = std::min(std::max(pIn[i], 0.f), 1.f) * 255.f + 0.5f;
+				iTexel |= static_cast<uint32_t>(static_cast<int>(fValue)) << (i * 8);
+			}
+			return iTexel;
+		}
+
+#if ANISOTROPIC_X86_SIMD
+		static __m128 LoadSSE(uint32_t iTexel)
+		{
+			__m128i vZero = _mm_setzero_si128();
+			__m128i vTexel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(iTexel)), vZero), vZero);
+			return _mm_mul_ps(_mm_cvtepi32_ps(vTexel), _mm_set1_ps(1.f / 255.f));
+		}
+
+		static uint32_t StoreSSE(__m128 vValue)
+		{
+			vValue = _mm_min_ps(_mm_max_ps(vValue, _mm_setzero_ps()), _mm_set1_ps(1.f));
+			vValue = _mm_add_ps(_mm_mul_ps(vValue, _mm_set1_ps(255.f)), _mm_set1_ps(0.5f));
+			__m128i vTexel = _mm_cvttps_epi32(vValue);
+			vTexel = _mm_packs_epi32(vTexel, vTexel);
+			vTexel = _mm_packus_epi16(vTexel, vTexel);
+			return static_cast<uint32_t>(_mm_cvtsi128_si32(vTexel));
+		}
+#endif
+	};
+
+	//No F16C on every CPU this has to run on, so the halves are converted one at a time either way
+	struct TexelRGBA16F
+	{
+		typedef uint64_t Type;
+
+		static void Load(uint64_t iTexel, float* pOut)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				pOut[i] = HalfToFloat(static_cast<uint16_t>(iTexel >> (i * 16)));
+			}
+		}
+
+		static uint64_t Store(const float* pIn)
+		{
+			uint64_t iTexel = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				iTexel |= static_cast<uint64_t>(FloatToHalf(pIn[i])) << (i * 16);
+			}
+			return iTexel;
+		}
+
+#if ANISOTROPIC_X86_SIMD
+		static __m128 LoadSSE(uint64_t iTexel)
+		{
+			float fValues[4];
+			Load(iTexel, fValues);
+			return _mm_loadu_ps(fValues);
+		}
+
+		static uint64_t StoreSSE(__m128 vValue)
+		{
+			float fValues[4];
+			_mm_storeu_ps(fValues, vValue);
+			return Store(fValues);
+		}
+#endif
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	//Children are indexed x | y << 1 | z << 2. A cone going the positive way along an axis meets the lower child first.
+	inline void GetColumn(int iDirection, int iColumn, int& iFront, int& iBack)
+	{
+		int iAxisBit = 1 << (iDirection / 2);
+		//the iColumn'th child index without the axis bit set
+		int iLow = iColumn & (iAxisBit - 1);
+		int iHigh = (iColumn & ~(iAxisBit - 1)) << 1;
+		int iChild = iLow | iHigh;
+		bool bPositive = (iDirection & 1) == 0;
+		iFront = bPositive ? iChild : (iChild | iAxisBit);
+		iBack = bPositive ? (iChild | iAxisBit) : iChild;
+	}
+
+	void CompositeScalar(const float fChildren[8][4], int iDirection, float* pOut)
+	{
+		float fColumns[4][4];
+		for (int c = 0; c < 4; c++)
+		{
+			int iFront, iBack;
+			GetColumn(iDirection, c, iFront, iBack);
+			float fTransmittance = 1.f - fChildren[iFront][3];
+			for (int i = 0; i < 4; i++)
+			{
+				fColumns[c][i] = fChildren[iFront][i] + fChildren[iBack][i] * fTransmittance;
+			}
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			pOut[i] = ((fColumns[0][i] + fColumns[1][i]) + (fColumns[2][i] + fColumns[3][i])) * 0.25f;
+		}
+	}
+
+#if ANISOTROPIC_X86_SIMD
+	inline __m128 CompositeSSE(const __m128* pChildren, int iDirection)
+	{
+		__m128 vColumns[4];
+		__m128 vOne = _mm_set1_ps(1.f);
+		for (int c = 0; c < 4; c++)
+		{
+			int iFront, iBack;
+			GetColumn(iDirection, c, iFront, iBack);
+			__m128 vFront = pChildren[iFront];
+			__m128 vTransmittance = _mm_sub_ps(vOne, _mm_shuffle_ps(vFront, vFront, _MM_SHUFFLE(3, 3, 3, 3)));
+			vColumns[c] = _mm_add_ps(vFront, _mm_mul_ps(pChildren[iBack], vTransmittance));
+		}
+		return _mm_mul_ps(_mm_add_ps(_mm_add_ps(vColumns[0], vColumns[1]), _mm_add_ps(vColumns[2], vColumns[3])), _mm_set1_ps(0.25f));
+	}
+#endif
+
+	//One z slice of a level. arrSrc/arrDst are per direction, with bShared all 6 directions read the same source
+	//so the children only get loaded once.
+	template<typename SrcTexel, typename DstTexel>
+	void BuildSliceScalar(const typename SrcTexel::Type* const* arrSrc, typename DstTexel::Type* const* arrDst, bool bShared,
+		int iFirstDirection, int iLastDirection, int iRes, int z)
+	{
+		int iSrcRes = iRes * 2;
+		float fChildren[8][4];
+		float fOut[4];
+		for (int y = 0; y < iRes; y++)
+		{
+			for (int x = 0; x < iRes; x++)
+			{
+				for (int d = iFirstDirection; d <= iLastDirection; d++)
+				{
+					if (d == iFirstDirection || !bShared)
+					{
+						for (int i = 0; i < 8; i++)
+						{
+							int sx = x * 2 + (i & 1);
+							int sy = y * 2 + ((i >> 1) & 1);
+							int sz = z * 2 + ((i >> 2) & 1);
+							SrcTexel::Load(arrSrc[d][(sz * iSrcRes + sy) * iSrcRes + sx], fChildren[i]);
+						}
+					}
+					CompositeScalar(fChildren, d, fOut);
+					arrDst[d][(z * iRes + y) * iRes + x] = DstTexel::Store(fOut);
+				}
+			}
+		}
+	}
+
+#if ANISOTROPIC_X86_SIMD
+	template<typename SrcTexel, typename DstTexel>
+	void BuildSliceSSE(const typename SrcTexel::Type* const* arrSrc, typename DstTexel::Type* const* arrDst, bool bShared,
+		int iFirstDirection, int iLastDirection, int iRes, int z)
+	{
+		int iSrcRes = iRes * 2;
+		__m128 vChildren[8];
+		for (int y = 0; y < iRes; y++)
+		{
+			for (int x = 0; x < iRes; x++)
+			{
+				for (int d = iFirstDirection; d <= iLastDirection; d++)
+				{
+					if (d == iFirstDirection || !bShared)
+					{
+						for (int i = 0; i < 8; i++)
+						{
+							int sx = x * 2 + (i & 1);
+							int sy = y * 2 + ((i >> 1) & 1);
+							int sz = z * 2 + ((i >> 2) & 1);
+							vChildren[i] = SrcTexel::LoadSSE(arrSrc[d][(sz * iSrcRes + sy) * iSrcRes + sx]);
+						}
+					}
+					arrDst[d][(z * iRes + y) * iRes + x] = DstTexel::StoreSSE(CompositeSSE(vChildren, d));
+				}
+			}
+		}
+	}
+#endif
+
+	uint64_t HashBytes(const void* pData, size_t iSize, uint64_t iHash)
+	{
+		const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+		for (size_t i = 0; i < iSize; i++)
+		{
+			iHash = (iHash ^ pBytes[i]) * 1099511628211ULL;
+		}
+		return iHash;
+	}
+
+	uint64_t HashMips(const AnisotropicMips& mips)
+	{
+		uint64_t iHash = 14695981039346656037ULL;
+		for (int d = 0; d < adMax; d++)
+		{
+			for (int iMip = 1; iMip < mips.GetMipLevels(); iMip++)
+			{
+				iHash = HashBytes(mips.GetMipData(static_cast<AnisotropicDirection>(d), iMip), mips.GetMipSizeInBytes(iMip), iHash);
+			}
+		}
+		return iHash;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* AnisotropicMips::GetDirectionName(AnisotropicDirection eDirection)
+{
+	switch (eDirection)
+	{
+	case adPosX: return "+X";
+	case adNegX: return "-X";
+	case adPosY: return "+Y";
+	case adNegY: return "-Y";
+	case adPosZ: return "+Z";
+	case adNegZ: return "-Z";
+	default: return "Unknown";
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* AnisotropicMips::GetFormatName(AnisotropicFormat eFormat)
+{
+	switch (eFormat)
+	{
+	case afRGBA8: return "RGBA8";
+	case afRGBA16F: return "RGBA16F";
+	default: return "Unknown";
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AnisotropicMips::AnisotropicMips()
+	: m_iResolution(0)
+	, m_iMipLevels(0)
+	, m_iNumThreads(0)
+	, m_eFormat(afRGBA8)
+	, m_eSIMDLevel(simdScalar)
+{
+	SetSIMDLevel(simdMax);
+	m_Stats.iNumThreads = 0;
+	m_Stats.eSIMDLevel = simdScalar;
+	m_Stats.dTotalTimeMs = 0.0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AnisotropicMips::~AnisotropicMips()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AnisotropicMips::Initialise(int iResolution, int iMipLevels, AnisotropicFormat eFormat, int iNumThreads)
+{
+	if (iResolution <= 1 || (iResolution & (iResolution - 1)) != 0 || iMipLevels < 2 || (iResolution >> (iMipLevels - 1)) < 1 || eFormat >= afMax)
+	{
+		VS_LOG_VERBOSE("Anisotropic mips need a power of 2 resolution with room for at least one mip");
+		return false;
+	}
+
+	Shutdown();
+	m_iResolution = iResolution;
+	m_iMipLevels = iMipLevels;
+	m_eFormat = eFormat;
+	m_iNumThreads = iNumThreads;
+	for (int d = 0; d < adMax; d++)
+	{
+		m_arrMips[d].resize(iMipLevels - 1);
+		for (int iMip = 1; iMip < iMipLevels; iMip++)
+		{
+			m_arrMips[d][iMip - 1].resize(GetMipSizeInBytes(iMip), 0);
+		}
+	}
+	m_Stats.arrLevelTimeMs.assign(iMipLevels, 0.0);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AnisotropicMips::Shutdown()
+{
+	for (int d = 0; d < adMax; d++)
+	{
+		m_arrMips[d].clear();
+		m_arrMips[d].shrink_to_fit();
+	}
+	m_iResolution = 0;
+	m_iMipLevels = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AnisotropicMips::SetSIMDLevel(SIMDLevel eLevel)
+{
+#if ANISOTROPIC_X86_SIMD
+	m_eSIMDLevel = std::min(eLevel, TriangleBoxOverlap::GetSupportedLevel()) >= simdSSE ? simdSSE : simdScalar;
+#else
+	m_eSIMDLevel = simdScalar;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename SrcTexel, typename DstTexel>
+void AnisotropicMips::BuildLevel(int iMipLevel, const void* pSrc)
+{
+	const typename SrcTexel::Type* arrSrc[adMax];
+	typename DstTexel::Type* arrDst[adMax];
+	for (int d = 0; d < adMax; d++)
+	{
+		arrSrc[d] = iMipLevel == 1 ? static_cast<const typename SrcTexel::Type*>(pSrc) : reinterpret_cast<const typename SrcTexel::Type*>(m_arrMips[d][iMipLevel - 2].data());
+		arrDst[d] = reinterpret_cast<typename DstTexel::Type*>(m_arrMips[d][iMipLevel - 1].data());
+	}
+
+	//Level 1 is one job per slice doing every direction, after that every direction has its own source so it's a job
+	//per slice per direction
+	bool bShared = iMipLevel == 1;
+	int iRes = GetMipResolution(iMipLevel);
+	int iNumJobs = bShared ? iRes : iRes * adMax;
+	bool bSSE = m_eSIMDLevel >= simdSSE;
+	Parallel::For(iNumJobs, m_Stats.iNumThreads, [&](int iJob, int iThread)
+	{
+		int z = iJob % iRes;
+		int iFirst = bShared ? 0 : iJob / iRes;
+		int iLast = bShared ? adMax - 1 : iFirst;
+#if ANISOTROPIC_X86_SIMD
+		if (bSSE)
+		{
+			BuildSliceSSE<SrcTexel, DstTexel>(arrSrc, arrDst, bShared, iFirst, iLast, iRes, z);
+			return;
+		}
+#endif
+		BuildSliceScalar<SrcTexel, DstTexel>(arrSrc, arrDst, bShared, iFirst, iLast, iRes, z);
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AnisotropicMips::Build(const CPUVoxelVolume& volume)
+{
+	if (m_iResolution == 0 || volume.GetResolution() != m_iResolution)
+	{
+		VS_LOG_VERBOSE("Anisotropic mips and CPU volume resolutions don't match");
+		return false;
+	}
+
+	m_Stats.iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+	m_Stats.eSIMDLevel = m_eSIMDLevel;
+	m_Stats.dTotalTimeMs = 0.0;
+	for (int iMip = 1; iMip < m_iMipLevels; iMip++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		if (m_eFormat == afRGBA8)
+		{
+			BuildLevel<TexelRGBA8, TexelRGBA8>(iMip, volume.GetMipData(0));
+		}
+		else if (iMip == 1)
+		{
+			BuildLevel<TexelRGBA8, TexelRGBA16F>(iMip, volume.GetMipData(0));
+		}
+		else
+		{
+			BuildLevel<TexelRGBA16F, TexelRGBA16F>(iMip, nullptr);
+		}
+		m_Stats.arrLevelTimeMs[iMip] = GetElapsedMs(start);
+		m_Stats.dTotalTimeMs += m_Stats.arrLevelTimeMs[iMip];
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AnisotropicMips::Build(const uint64_t* pMip0)
+{
+	if (m_iResolution == 0 || !pMip0 || m_eFormat != afRGBA16F)
+	{
+		VS_LOG_VERBOSE("RGBA16F source needs RGBA16F anisotropic mips");
+		return false;
+	}
+
+	m_Stats.iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+	m_Stats.eSIMDLevel = m_eSIMDLevel;
+	m_Stats.dTotalTimeMs = 0.0;
+	for (int iMip = 1; iMip < m_iMipLevels; iMip++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		BuildLevel<TexelRGBA16F, TexelRGBA16F>(iMip, pMip0);
+		m_Stats.arrLevelTimeMs[iMip] = GetElapsedMs(start);
+		m_Stats.dTotalTimeMs += m_Stats.arrLevelTimeMs[iMip];
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const void* AnisotropicMips::GetMipData(AnisotropicDirection eDirection, int iMipLevel) const
+{
+	if (iMipLevel < 1 || iMipLevel >= m_iMipLevels || eDirection >= adMax)
+	{
+		return nullptr;
+	}
+	return m_arrMips[eDirection][iMipLevel - 1].data();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t AnisotropicMips::GetMipSizeInBytes(int iMipLevel) const
+{
+	size_t iRes = static_cast<size_t>(GetMipResolution(iMipLevel));
+	return iRes * iRes * iRes * GetBytesPerTexel();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMFLOAT4 AnisotropicMips::GetTexel(AnisotropicDirection eDirection, int iMipLevel, int x, int y, int z) const
+{
+	const void* pData = GetMipData(eDirection, iMipLevel);
+	int iRes = GetMipResolution(iMipLevel);
+	if (!pData || x < 0 || y < 0 || z < 0 || x >= iRes || y >= iRes || z >= iRes)
+	{
+		return XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+	}
+
+	size_t iIndex = (static_cast<size_t>(z) * iRes + y) * iRes + x;
+	float fValues[4];
+	if (m_eFormat == afRGBA8)
+	{
+		TexelRGBA8::Load(static_cast<const uint32_t*>(pData)[iIndex], fValues);
+	}
+	else
+	{
+		TexelRGBA16F::Load(static_cast<const uint64_t*>(pData)[iIndex], fValues);
+	}
+	return XMFLOAT4(fValues[0], fValues[1], fValues[2], fValues[3]);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMFLOAT4 AnisotropicMips::GetTexelForDirection(const XMFLOAT3& vDirection, int iMipLevel, int x, int y, int z) const
+{
+	float fWeights[3] = { fabsf(vDirection.x), fabsf(vDirection.y), fabsf(vDirection.z) };
+	float fTotal = fWeights[0] + fWeights[1] + fWeights[2];
+	if (fTotal <= 0.f)
+	{
+		return XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+	}
+
+	AnisotropicDirection eFaces[3] =
+	{
+		vDirection.x >= 0.f ? adPosX : adNegX,
+		vDirection.y >= 0.f ? adPosY : adNegY,
+		vDirection.z >= 0.f ? adPosZ : adNegZ
+	};
+	XMVECTOR vResult = XMVectorZero();
+	for (int a = 0; a < 3; a++)
+	{
+		XMFLOAT4 vTexel = GetTexel(eFaces[a], iMipLevel, x, y, z);
+		vResult += XMLoadFloat4(&vTexel) * (fWeights[a] / fTotal);
+	}
+	XMFLOAT4 vOut;
+	XMStoreFloat4(&vOut, vResult);
+	return vOut;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t AnisotropicMips::GetMemoryUsageInBytes() const
+{
+	size_t iBytes = 0;
+	for (int d = 0; d < adMax; d++)
+	{
+		for (size_t i = 0; i < m_arrMips[d].size(); i++)
+		{
+			iBytes += m_arrMips[d][i].size();
+		}
+	}
+	return iBytes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int AnisotropicMips::Validate(unsigned int iSeed)
+{
+	const int iResolution = 32;
+	const int iMipLevels = 4;
+	int iFailures = 0;
+
+	//Random premultiplied texels, a third empty, a third opaque and the rest partly covered
+	std::mt19937 rng(iSeed);
+	CPUVoxelVolume volume;
+	volume.Initialise(iResolution, 1);
+	std::vector<uint64_t> arrHalfTexels(static_cast<size_t>(iResolution) * iResolution * iResolution);
+	uint32_t* pVoxels = volume.GetMipData(0);
+	for (size_t i = 0; i < arrHalfTexels.size(); i++)
+	{
+		uint32_t iKind = rng() % 3;
+		uint32_t iAlpha = iKind == 0 ? 0 : (iKind == 1 ? 255 : rng() % 256);
+		uint32_t iTexel = iAlpha << 24;
+		for (int c = 0; c < 3; c++)
+		{
+			iTexel |= (iAlpha > 0 ? rng() % (iAlpha + 1) : 0) << (c * 8);
+		}
+		pVoxels[i] = iTexel;
+
+		float fValues[4];
+		TexelRGBA8::Load(iTexel, fValues);
+		fValues[0] *= 2.f; //past 1 so the float path gets some HDR values
+		arrHalfTexels[i] = TexelRGBA16F::Store(fValues);
+	}
+
+	//Every SIMD level and thread count has to match the single threaded scalar build bit for bit
+	for (int f = 0; f < afMax; f++)
+	{
+		for (int iSource = 0; iSource < (f == afRGBA16F ? 2 : 1); iSource++)
+		{
+			uint64_t iReference = 0;
+			for (int iLevel = simdScalar; iLevel <= simdSSE; iLevel++)
+			{
+				for (int iThreads = 1; iThreads <= 3; iThreads += 2)
+				{
+					AnisotropicMips mips;
+					mips.Initialise(iResolution, iMipLevels, static_cast<AnisotropicFormat>(f), iThreads);
+					mips.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+					if (iSource == 0)
+					{
+						mips.Build(volume);
+					}
+					else
+					{
+						mips.Build(arrHalfTexels.data());
+					}
+					uint64_t iHash = HashMips(mips);
+					if (iLevel == simdScalar && iThreads == 1)
+					{
+						iReference = iHash;
+					}
+					else if (iHash != iReference)
+					{
+						iFailures++;
+					}
+				}
+			}
+		}
+	}
+
+	//A one voxel wall at an odd x, so its first mip shares texels with the empty layer in front of it
+	const int iWallX = 5;
+	volume.Clear();
+	for (int z = 0; z < iResolution; z++)
+	{
+		for (int y = 0; y < iResolution; y++)
+		{
+			volume.SetVoxel(iWallX, y, z, 0xffffffff);
+		}
+	}
+	for (int f = 0; f < afMax; f++)
+	{
+		AnisotropicMips mips;
+		mips.Initialise(iResolution, iMipLevels, static_cast<AnisotropicFormat>(f), 1);
+		mips.Build(volume);
+		for (int iMip = 1; iMip < iMipLevels; iMip++)
+		{
+			int iX = iWallX >> iMip;
+			//face on it stays opaque both ways, edge on it covers half the texel at the first mip like the box filter
+			if (mips.GetTexel(adPosX, iMip, iX, 1, 1).w < 0.999f || mips.GetTexel(adNegX, iMip, iX, 1, 1).w < 0.999f)
+			{
+				iFailures++;
+			}
+			float fEdgeOn = mips.GetTexel(adPosY, iMip, iX, 1, 1).w;
+			if (iMip == 1 && fabsf(fEdgeOn - 0.5f) > 0.01f)
+			{
+				iFailures++;
+			}
+		}
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool AnisotropicMips::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser, int iMipLevels)
+{
+	const int iResolutions[] = { 128, 256, 512 };
+	const int iNumRuns = 3;
+	int iMaxThreads = Parallel::GetNumWorkerThreads();
+
+	std::vector<int> arrThreadCounts;
+	for (int t = 1; t < iMaxThreads; t *= 2)
+	{
+		arrThreadCounts.push_back(t);
+	}
+	arrThreadCounts.push_back(iMaxThreads);
+
+	std::stringstream ss;
+	ss << "../Results/AnisotropicMips_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open anisotropic mips benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Format, SIMD, Threads, Level, Level Resolution, Time(ms), Texels/sec, Matches Scalar\n";
+
+	std::stringstream summary;
+	bool bAllMatch = true;
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolution, iMipLevels))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&volume);
+
+		//What the single isotropic chain costs on the CPU, for comparison
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		volume.GenerateMips();
+		outfile << iResolution << ",RGBA8 Isotropic,Scalar,1,Total,," << GetElapsedMs(start) << ",,\n";
+
+		for (int f = 0; f < afMax; f++)
+		{
+			AnisotropicMips mips;
+			if (!mips.Initialise(iResolution, iMipLevels, static_cast<AnisotropicFormat>(f)))
+			{
+				continue;
+			}
+
+			for (int iLevel = simdScalar; iLevel <= simdSSE; iLevel++)
+			{
+				mips.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+				if (mips.m_eSIMDLevel != iLevel)
+				{
+					continue;
+				}
+
+				uint64_t iScalarHash = 0;
+				for (int t = 0; t < arrThreadCounts.size(); t++)
+				{
+					mips.SetNumThreads(arrThreadCounts[t]);
+					Stats best;
+					best.dTotalTimeMs = DBL_MAX;
+					for (int i = 0; i < iNumRuns; i++)
+					{
+						mips.Build(volume);
+						if (mips.GetStats().dTotalTimeMs < best.dTotalTimeMs)
+						{
+							best = mips.GetStats();
+						}
+					}
+
+					uint64_t iHash = HashMips(mips);
+					if (iLevel == simdScalar && t == 0)
+					{
+						iScalarHash = iHash;
+					}
+					bool bMatch = iScalarHash == 0 || iHash == iScalarHash;
+					bAllMatch &= bMatch;
+
+					const char* sSIMD = iLevel == simdScalar ? "Scalar" : "SSE";
+					for (int iMip = 1; iMip < iMipLevels; iMip++)
+					{
+						double dTexels = static_cast<double>(mips.GetMipSizeInBytes(iMip) / mips.GetBytesPerTexel()) * adMax;
+						outfile << iResolution << "," << GetFormatName(static_cast<AnisotropicFormat>(f)) << "," << sSIMD << "," << arrThreadCounts[t] << ","
+							<< iMip << "," << mips.GetMipResolution(iMip) << "," << best.arrLevelTimeMs[iMip] << "," << dTexels / (best.arrLevelTimeMs[iMip] / 1000.0) << ","
+							<< (bMatch ? "Yes" : "No") << "\n";
+					}
+					outfile << iResolution << "," << GetFormatName(static_cast<AnisotropicFormat>(f)) << "," << sSIMD << "," << arrThreadCounts[t] << ",Total,,"
+						<< best.dTotalTimeMs << ",," << (bMatch ? "Yes" : "No") << "\n";
+
+					VS_LOG("Anisotropic mips " << iResolution << "^3 " << GetFormatName(static_cast<AnisotropicFormat>(f)) << " " << sSIMD << ", "
+						<< arrThreadCounts[t] << " threads: " << best.dTotalTimeMs << "ms");
+				}
+			}
+			summary << "\n" << iResolution << " " << GetFormatName(static_cast<AnisotropicFormat>(f)) << " Memory(MB):," << mips.GetMemoryUsageInBytes() / (1024.f * 1024.f);
+		}
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	if (!bAllMatch)
+	{
+		VS_LOG_VERBOSE("Anisotropic mips changed with the SIMD level or thread count");
+	}
+	return bAllMatch && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
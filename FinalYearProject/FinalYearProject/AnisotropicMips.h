@@ -0,0 +1,121 @@
+#ifndef ANISOTROPIC_MIPS_H
+#define ANISOTROPIC_MIPS_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+#include "TriangleBoxOverlap.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Which way a cone is travelling through the volume
+enum AnisotropicDirection
+{
+	adPosX,
+	adNegX,
+	adPosY,
+	adNegY,
+	adPosZ,
+	adNegZ,
+	adMax
+};
+
+//Texel layouts, both x fastest then y then z like Texture3D
+enum AnisotropicFormat
+{
+	afRGBA8,	//DXGI_FORMAT_R8G8B8A8_UNORM, one uint32_t a texel
+	afRGBA16F,	//DXGI_FORMAT_R16G16B16A16_FLOAT, one uint64_t a texel
+	afMax
+};
+
+//Six directional mip chains built from mip 0 of the radiance volume. GenerateMips box filters the 8 children of
+//each texel, so a wall one voxel thick ends up half transparent a mip up and light leaks through it. Here each
+//direction composites the two children along its axis front to back (front + back * (1 - front alpha)) and then
+//averages the 4 columns, so an opaque wall stays opaque when seen face on.
+//Texels are premultiplied alpha, which is what mip 0 already is - empty voxels are all zeros.
+//Level 0 is the isotropic source, the chains hold levels 1 to iMipLevels - 1 and each level of a chain is built from
+//the level before in the same chain. Level 1 reads the 8 children once and writes all 6 directions from them.
+class AnisotropicMips
+{
+public:
+
+	struct Stats
+	{
+		int iNumThreads;
+		SIMDLevel eSIMDLevel;
+		std::vector<double> arrLevelTimeMs;		//[level], 0 for level 0
+		double dTotalTimeMs;
+	};
+
+	static const char* GetDirectionName(AnisotropicDirection eDirection);
+	static const char* GetFormatName(AnisotropicFormat eFormat);
+
+	AnisotropicMips();
+	~AnisotropicMips();
+
+	//iResolution is the resolution of mip 0 and has to be a power of 2. iNumThreads <= 0 uses every core.
+	bool Initialise(int iResolution, int iMipLevels, AnisotropicFormat eFormat, int iNumThreads = 0);
+	void Shutdown();
+
+	void SetNumThreads(int iNumThreads) { m_iNumThreads = iNumThreads; }
+	//Clamped to what the CPU supports, AVX2 runs the SSE path. Defaults to the best supported level.
+	void SetSIMDLevel(SIMDLevel eLevel);
+
+	//Mip 0 of the volume has to be the same resolution
+	bool Build(const CPUVoxelVolume& volume);
+	//Mip 0 as RGBA16F texels
+	bool Build(const uint64_t* pMip0);
+
+	int GetResolution() const { return m_iResolution; }
+	int GetMipLevels() const { return m_iMipLevels; }
+	int GetMipResolution(int iMipLevel) const { return m_iResolution >> iMipLevel; }
+	AnisotropicFormat GetFormat() const { return m_eFormat; }
+	int GetBytesPerTexel() const { return m_eFormat == afRGBA8 ? 4 : 8; }
+
+	//iMipLevel from 1, ready to upload with UpdateSubresource
+	const void* GetMipData(AnisotropicDirection eDirection, int iMipLevel) const;
+	size_t GetMipSizeInBytes(int iMipLevel) const;
+	XMFLOAT4 GetTexel(AnisotropicDirection eDirection, int iMipLevel, int x, int y, int z) const;
+	//The three chains facing vDirection weighted by how much it points along each axis, as the cone tracer blends them
+	XMFLOAT4 GetTexelForDirection(const XMFLOAT3& vDirection, int iMipLevel, int x, int y, int z) const;
+
+	const Stats& GetStats() const { return m_Stats; }
+	size_t GetMemoryUsageInBytes() const;
+
+	//Random volumes through every format and SIMD level against the scalar version, and a one voxel wall that has to
+	//stay opaque face on. Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Builds the voxeliser's triangles at 128^3 to 512^3 in both formats for 1 to all threads, against GenerateMips,
+	//and writes the time per level to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser, int iMipLevels);
+
+private:
+
+	template<typename SrcTexel, typename DstTexel>
+	void BuildLevel(int iMipLevel, const void* pSrc);
+
+	int m_iResolution;
+	int m_iMipLevels;
+	int m_iNumThreads;
+	AnisotropicFormat m_eFormat;
+	SIMDLevel m_eSIMDLevel;
+
+	//m_arrMips[direction][level - 1], raw texels of m_eFormat
+	std::vector<std::vector<uint8_t>> m_arrMips[adMax];
+
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !ANISOTROPIC_MIPS_H
@@ -2,6 +2,7 @@
 
 #include "Application.h"
 #include "Debugging.h"
+#include <cstring>
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -12,7 +13,7 @@ Application* Application::s_pApp = nullptr;
 void Application::Run()
 {
 	MSG msg;
-	bool bDone(false);
+	bool bDone(m_bBakeVoxelCache || m_bBakeMeshCache);
 
 	ZeroMemory(&msg, sizeof(MSG));
 
@@ -96,6 +97,8 @@ Application::Application()
 	: m_pInput(nullptr)
 	, m_pRenderer(nullptr)
 	, m_iTestIndex(0)
+	, m_bBakeVoxelCache(false)
+	, m_bBakeMeshCache(false)
 {
 
 }
@@ -172,6 +175,36 @@ bool Application::Initialise()
 	m_arrTests.push_back(t1);
 #endif
 
+	//Rewrites every mesh cache as the renderer loads the meshes
+	m_bBakeMeshCache = strstr(GetCommandLineA(), "-bakemeshcache") != nullptr;
+	Mesh::SetRebuildMeshCaches(m_bBakeMeshCache);
+	if (m_bBakeMeshCache && !strstr(GetCommandLineA(), "-bakevoxelcache"))
+	{
+		if (!m_pRenderer->Initialise(iScreenWidth, iScreenHeight, m_hwnd, rmRegularTexture, 64, true))
+		{
+			VS_LOG("Failed to initialise Renderer")
+			return false;
+		}
+		return true;
+	}
+
+	m_bBakeVoxelCache = strstr(GetCommandLineA(), "-bakevoxelcache") != nullptr;
+	if (m_bBakeVoxelCache)
+	{
+		//Skips the menus, the caches get baked at every resolution the menu offers
+		if (!m_pRenderer->Initialise(iScreenWidth, iScreenHeight, m_hwnd, rmRegularTexture, 64, true))
+		{
+			VS_LOG("Failed to initialise Renderer")
+			return false;
+		}
+		std::vector<int> arrResolutions = { 64, 128, 256, 512 };
+		if (!m_pRenderer->BakeVoxelCaches(m_hwnd, arrResolutions))
+		{
+			VS_LOG("Failed to bake the voxel caches")
+		}
+		return true;
+	}
+
 	if (!m_pRenderer->Initialise(iScreenWidth, iScreenHeight, m_hwnd, m_arrTests[m_iTestIndex].eRenderMode, m_arrTests[m_iTestIndex].iResolution, TEST_MODE))
 	{
 		VS_LOG("Failed to initialise Renderer")
@@ -58,6 +58,10 @@ private:
 	int m_iScreenWidth;
 	int m_iTestIndex;
 	std::vector<TestType> m_arrTests;
+	//Started with -bakevoxelcache, writes the voxel caches and quits without running
+	bool m_bBakeVoxelCache;
+	//Started with -bakemeshcache, writes the mesh caches and quits without running
+	bool m_bBakeMeshCache;
 
 	bool Initialise();
 	bool Update();
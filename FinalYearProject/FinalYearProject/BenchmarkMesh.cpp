@@ -0,0 +1,89 @@
+#include "BenchmarkMesh.h"
+#include "ObjParser.h"
+#include <algorithm>
+#include <cfloat>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Mesh::ModelType's
+	struct Corner
+	{
+		XMFLOAT3 pos;
+		XMFLOAT2 tex;
+		XMFLOAT3 norm;
+		XMFLOAT3 tangent;
+		XMFLOAT3 binormal;
+	};
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool BenchmarkMesh::LoadObj(const char* filename, std::vector<SubMesh>& arrSubMeshes, XMFLOAT3& vMin, XMFLOAT3& vMax)
+{
+	ObjParser parser;
+	if (!parser.Parse(filename))
+	{
+		return false;
+	}
+	const std::vector<ObjParser::Group>& arrGroups = parser.GetGroups();
+	std::vector<std::vector<Corner>> arrCorners(arrGroups.size());
+	std::vector<std::vector<Corner>*> arrCornerPointers(arrGroups.size());
+	for (size_t g = 0; g < arrGroups.size(); g++)
+	{
+		arrCornerPointers[g] = &arrCorners[g];
+	}
+	parser.ExpandGroups(arrCornerPointers.data());
+
+	arrSubMeshes.clear();
+	arrSubMeshes.resize(arrGroups.size());
+	vMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	vMax = XMFLOAT3(0.f, 0.f, 0.f);
+	for (size_t g = 0; g < arrGroups.size(); g++)
+	{
+		std::vector<Corner>& arrGroupCorners = arrCorners[g];
+		for (size_t j = 0; j + 2 < arrGroupCorners.size(); j += 3)
+		{
+			Corner* pVert1 = &arrGroupCorners[j];
+			Corner* pVert2 = &arrGroupCorners[j + 1];
+			Corner* pVert3 = &arrGroupCorners[j + 2];
+			XMFLOAT3 vVec1(pVert2->pos.x - pVert1->pos.x, pVert2->pos.y - pVert1->pos.y, pVert2->pos.z - pVert1->pos.z);
+			XMFLOAT3 vVec2(pVert3->pos.x - pVert1->pos.x, pVert3->pos.y - pVert1->pos.y, pVert3->pos.z - pVert1->pos.z);
+			XMFLOAT2 vTUVec(pVert2->tex.x - pVert1->tex.x, pVert3->tex.x - pVert1->tex.x);
+			XMFLOAT2 vTVVec(pVert2->tex.y - pVert1->tex.y, pVert3->tex.y - pVert1->tex.y);
+			float den = 1.f / ((vTUVec.x * vTVVec.y) - (vTUVec.y * vTVVec.x));
+			XMFLOAT3 tangent((vTVVec.y * vVec1.x - vTVVec.x * vVec2.x) * den, (vTVVec.y * vVec1.y - vTVVec.x * vVec2.y) * den, (vTVVec.y * vVec1.z - vTVVec.x * vVec2.z) * den);
+			XMFLOAT3 binormal((vTUVec.x * vVec2.x - vTUVec.y * vVec1.x) * den, (vTUVec.x * vVec2.y - vTUVec.y * vVec1.y) * den, (vTUVec.x * vVec2.z - vTUVec.y * vVec1.z) * den);
+			XMStoreFloat3(&tangent, XMVector3Normalize(XMLoadFloat3(&tangent)));
+			XMStoreFloat3(&binormal, XMVector3Normalize(XMLoadFloat3(&binormal)));
+			pVert1->tangent = pVert2->tangent = pVert3->tangent = tangent;
+			pVert1->binormal = pVert2->binormal = pVert3->binormal = binormal;
+		}
+
+		SubMesh& subMesh = arrSubMeshes[g];
+		subMesh.sMaterial = arrGroups[g].sMaterial;
+		subMesh.vMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		subMesh.vMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		subMesh.arrVertices.resize(arrGroupCorners.size());
+		subMesh.arrIndices.resize(arrGroupCorners.size());
+		for (size_t i = 0; i < arrGroupCorners.size(); i++)
+		{
+			const Corner& corner = arrGroupCorners[i];
+			Vertex& vertex = subMesh.arrVertices[i];
+			vertex.position = corner.pos;
+			vertex.normal = corner.norm;
+			vertex.texture = corner.tex;
+			vertex.tangent = corner.tangent;
+			vertex.binormal = corner.binormal;
+			subMesh.arrIndices[i] = static_cast<uint32_t>(i);
+			subMesh.vMin = XMFLOAT3(std::min(subMesh.vMin.x, corner.pos.x), std::min(subMesh.vMin.y, corner.pos.y), std::min(subMesh.vMin.z, corner.pos.z));
+			subMesh.vMax = XMFLOAT3(std::max(subMesh.vMax.x, corner.pos.x), std::max(subMesh.vMax.y, corner.pos.y), std::max(subMesh.vMax.z, corner.pos.z));
+		}
+		vMin = XMFLOAT3(std::min(vMin.x, subMesh.vMin.x), std::min(vMin.y, subMesh.vMin.y), std::min(vMin.z, subMesh.vMin.z));
+		vMax = XMFLOAT3(std::max(vMax.x, subMesh.vMax.x), std::max(vMax.y, subMesh.vMax.y), std::max(vMax.z, subMesh.vMax.z));
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
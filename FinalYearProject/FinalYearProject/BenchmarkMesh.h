@@ -0,0 +1,51 @@
+#ifndef BENCHMARK_MESH_H
+#define BENCHMARK_MESH_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//The vertex and index arrays Mesh builds from an obj, without needing a device or materials, for the benchmarks of
+//the mesh loading stages to run on
+namespace BenchmarkMesh
+{
+	//Mesh::VertexType's layout
+#ifdef _WIN32
+	__declspec(align(16)) struct Vertex
+#else
+	struct alignas(16) Vertex
+#endif
+	{
+		XMFLOAT3 position;
+		XMFLOAT3 normal;
+		XMFLOAT2 texture;
+		XMFLOAT3 tangent;
+		XMFLOAT3 binormal;
+	};
+
+	struct SubMesh
+	{
+		std::string sMaterial;
+		std::vector<Vertex> arrVertices;
+		std::vector<uint32_t> arrIndices;
+		XMFLOAT3 vMin;
+		XMFLOAT3 vMax;
+	};
+
+	//Everything Mesh does between the obj and making the buffers: tangents as in CalculateModelVectors, for every
+	//submesh as if they were all normal mapped, bounds, and a vertex a corner with an index each
+	bool LoadObj(const char* filename, std::vector<SubMesh>& arrSubMeshes, XMFLOAT3& vMin, XMFLOAT3& vMax);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !BENCHMARK_MESH_H
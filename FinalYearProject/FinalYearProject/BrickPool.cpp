@@ -0,0 +1,874 @@
+#include "BrickPool.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Voxels whose centre is within half a voxel's diagonal of the sphere's surface, roughly what voxelising the
+	//sphere mesh conservatively gives
+	inline bool IsInShell(int x, int y, int z, const XMFLOAT3& vCentre, float fRadius)
+	{
+		float dx = x + 0.5f - vCentre.x;
+		float dy = y + 0.5f - vCentre.y;
+		float dz = z + 0.5f - vCentre.z;
+		return fabsf(sqrtf(dx * dx + dy * dy + dz * dz) - fRadius) <= 0.866f;
+	}
+
+	//Cells whose box the shell passes through, in increasing cell index order
+	void GetShellCells(const XMFLOAT3& vCentre, float fRadius, int iCellsPerAxis, std::vector<int>& arrCells)
+	{
+		const int iBrickSize = BrickPool::kBrickSize;
+		const float fOuter = fRadius + 0.866f;
+		const float fInner = std::max(0.f, fRadius - 0.866f);
+		float fCentre[3] = { vCentre.x, vCentre.y, vCentre.z };
+		int iMin[3], iMax[3];
+		for (int a = 0; a < 3; a++)
+		{
+			iMin[a] = std::max(0, static_cast<int>(floorf((fCentre[a] - fOuter) / iBrickSize)));
+			iMax[a] = std::min(iCellsPerAxis - 1, static_cast<int>(floorf((fCentre[a] + fOuter) / iBrickSize)));
+		}
+
+		arrCells.clear();
+		for (int cz = iMin[2]; cz <= iMax[2]; cz++)
+		{
+			for (int cy = iMin[1]; cy <= iMax[1]; cy++)
+			{
+				for (int cx = iMin[0]; cx <= iMax[0]; cx++)
+				{
+					//nearest and furthest points of the cell from the centre
+					int iCell[3] = { cx, cy, cz };
+					float fNearSq = 0.f, fFarSq = 0.f;
+					for (int a = 0; a < 3; a++)
+					{
+						float fLo = static_cast<float>(iCell[a] * iBrickSize) - fCentre[a];
+						float fHi = fLo + iBrickSize;
+						float fNear = fLo > 0.f ? fLo : (fHi < 0.f ? -fHi : 0.f);
+						float fFar = std::max(fabsf(fLo), fabsf(fHi));
+						fNearSq += fNear * fNear;
+						fFarSq += fFar * fFar;
+					}
+					if (fNearSq <= fOuter * fOuter && fFarSq >= fInner * fInner)
+					{
+						arrCells.push_back((cz * iCellsPerAxis + cy) * iCellsPerAxis + cx);
+					}
+				}
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t BrickPool::kNull;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BrickPool::BrickPool()
+	: m_iResolution(0)
+	, m_iCellsPerAxis(0)
+	, m_iNumAllocated(0)
+	, m_iNumAllocations(0)
+	, m_iNumFrees(0)
+	, m_iNumMoves(0)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BrickPool::~BrickPool()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool BrickPool::Initialise(int iResolution, int iInitialCapacity)
+{
+	if (iResolution <= 0 || iResolution % kBrickSize != 0)
+	{
+		VS_LOG_VERBOSE("Brick pool resolution has to be a multiple of the brick size");
+		return false;
+	}
+
+	Shutdown();
+	m_iResolution = iResolution;
+	m_iCellsPerAxis = iResolution / kBrickSize;
+	m_arrIndirection.assign(static_cast<size_t>(m_iCellsPerAxis) * m_iCellsPerAxis * m_iCellsPerAxis, kNull);
+	if (iInitialCapacity > 0)
+	{
+		Grow(iInitialCapacity);
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::Shutdown()
+{
+	m_arrBrickData.clear();
+	m_arrBrickData.shrink_to_fit();
+	m_arrIndirection.clear();
+	m_arrIndirection.shrink_to_fit();
+	m_arrBrickOwners.clear();
+	m_arrBrickOwners.shrink_to_fit();
+	m_arrFreeList.clear();
+	m_arrFreeList.shrink_to_fit();
+	m_iResolution = 0;
+	m_iCellsPerAxis = 0;
+	m_iNumAllocated = 0;
+	m_iNumAllocations = 0;
+	m_iNumFrees = 0;
+	m_iNumMoves = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::Clear()
+{
+	std::fill(m_arrIndirection.begin(), m_arrIndirection.end(), kNull);
+	std::fill(m_arrBrickOwners.begin(), m_arrBrickOwners.end(), kNull);
+	m_iNumAllocated = 0;
+	RebuildFreeList();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::Grow(int iNewCapacity)
+{
+	int iOldCapacity = static_cast<int>(m_arrBrickOwners.size());
+	if (iNewCapacity <= iOldCapacity)
+	{
+		return;
+	}
+
+	m_arrBrickData.resize(static_cast<size_t>(iNewCapacity) * kBrickVoxels, 0);
+	m_arrBrickOwners.resize(iNewCapacity, kNull);
+	m_arrFreeList.reserve(iNewCapacity);
+	//highest first so the lowest new brick is handed out first
+	for (int i = iNewCapacity - 1; i >= iOldCapacity; i--)
+	{
+		m_arrFreeList.push_back(static_cast<uint32_t>(i));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::RebuildFreeList()
+{
+	m_arrFreeList.clear();
+	for (int i = static_cast<int>(m_arrBrickOwners.size()) - 1; i >= 0; i--)
+	{
+		if (m_arrBrickOwners[i] == kNull)
+		{
+			m_arrFreeList.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t BrickPool::Allocate(int cx, int cy, int cz)
+{
+	int iCell = GetCellIndex(cx, cy, cz);
+	if (m_arrIndirection[iCell] != kNull)
+	{
+		return m_arrIndirection[iCell];
+	}
+
+	if (m_arrFreeList.empty())
+	{
+		Grow(std::max(64, static_cast<int>(m_arrBrickOwners.size()) * 2));
+	}
+	uint32_t iBrick = m_arrFreeList.back();
+	m_arrFreeList.pop_back();
+
+	memset(GetBrickData(iBrick), 0, kBrickVoxels * sizeof(uint32_t));
+	m_arrBrickOwners[iBrick] = static_cast<uint32_t>(iCell);
+	m_arrIndirection[iCell] = iBrick;
+	m_iNumAllocated++;
+	m_iNumAllocations++;
+	return iBrick;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::Free(int cx, int cy, int cz)
+{
+	int iCell = GetCellIndex(cx, cy, cz);
+	uint32_t iBrick = m_arrIndirection[iCell];
+	if (iBrick == kNull)
+	{
+		return;
+	}
+
+	m_arrBrickOwners[iBrick] = kNull;
+	m_arrIndirection[iCell] = kNull;
+	m_arrFreeList.push_back(iBrick);
+	m_iNumAllocated--;
+	m_iNumFrees++;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool BrickPool::IsBrickEmpty(uint32_t iBrick) const
+{
+	const uint32_t* pVoxels = GetBrickData(iBrick);
+	for (int i = 0; i < kBrickVoxels; i++)
+	{
+		if (pVoxels[i] != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool BrickPool::FreeIfEmpty(int cx, int cy, int cz)
+{
+	uint32_t iBrick = GetBrick(cx, cy, cz);
+	if (iBrick == kNull || !IsBrickEmpty(iBrick))
+	{
+		return false;
+	}
+	Free(cx, cy, cz);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t BrickPool::GetVoxel(int x, int y, int z) const
+{
+	uint32_t iBrick = GetBrick(x / kBrickSize, y / kBrickSize, z / kBrickSize);
+	if (iBrick == kNull)
+	{
+		return 0;
+	}
+	return GetBrickData(iBrick)[GetBrickVoxelIndex(x % kBrickSize, y % kBrickSize, z % kBrickSize)];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::SetVoxel(int x, int y, int z, uint32_t iColour)
+{
+	int cx = x / kBrickSize, cy = y / kBrickSize, cz = z / kBrickSize;
+	uint32_t iBrick = GetBrick(cx, cy, cz);
+	if (iBrick == kNull)
+	{
+		if (iColour == 0)
+		{
+			return;
+		}
+		iBrick = Allocate(cx, cy, cz);
+	}
+	GetBrickData(iBrick)[GetBrickVoxelIndex(x % kBrickSize, y % kBrickSize, z % kBrickSize)] = iColour;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int BrickPool::Compact(int iMaxMoves)
+{
+	int iHole = 0;
+	int iTop = static_cast<int>(m_arrBrickOwners.size()) - 1;
+	int iMoves = 0;
+	while (iMoves < iMaxMoves)
+	{
+		while (iHole < iTop && m_arrBrickOwners[iHole] != kNull)
+		{
+			iHole++;
+		}
+		while (iTop > iHole && m_arrBrickOwners[iTop] == kNull)
+		{
+			iTop--;
+		}
+		if (iHole >= iTop)
+		{
+			break;
+		}
+
+		uint32_t iCell = m_arrBrickOwners[iTop];
+		memcpy(GetBrickData(iHole), GetBrickData(iTop), kBrickVoxels * sizeof(uint32_t));
+		m_arrBrickOwners[iHole] = iCell;
+		m_arrBrickOwners[iTop] = kNull;
+		m_arrIndirection[iCell] = static_cast<uint32_t>(iHole);
+		iMoves++;
+	}
+
+	if (iMoves > 0)
+	{
+		RebuildFreeList();
+	}
+	m_iNumMoves += iMoves;
+	return iMoves;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::Trim(int iMinCapacity)
+{
+	int iNewCapacity = std::max(GetStats().iHighWaterMark, iMinCapacity);
+	if (iNewCapacity >= static_cast<int>(m_arrBrickOwners.size()))
+	{
+		return;
+	}
+
+	m_arrBrickData.resize(static_cast<size_t>(iNewCapacity) * kBrickVoxels);
+	m_arrBrickData.shrink_to_fit();
+	m_arrBrickOwners.resize(iNewCapacity);
+	m_arrBrickOwners.shrink_to_fit();
+	RebuildFreeList();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::WriteCell(int cx, int cy, int cz, const uint32_t* pVoxels)
+{
+	bool bEmpty = true;
+	for (int i = 0; i < kBrickVoxels && bEmpty; i++)
+	{
+		bEmpty = pVoxels[i] == 0;
+	}
+
+	if (bEmpty)
+	{
+		Free(cx, cy, cz);
+		return;
+	}
+	uint32_t iBrick = Allocate(cx, cy, cz);
+	memcpy(GetBrickData(iBrick), pVoxels, kBrickVoxels * sizeof(uint32_t));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BrickPool::CopyCellFromVolume(const CPUVoxelVolume& volume, int cx, int cy, int cz)
+{
+	uint32_t arrVoxels[kBrickVoxels];
+	const uint32_t* pSource = volume.GetMipData(0);
+	for (int z = 0; z < kBrickSize; z++)
+	{
+		for (int y = 0; y < kBrickSize; y++)
+		{
+			const uint32_t* pRow = pSource + volume.GetIndex(cx * kBrickSize, cy * kBrickSize + y, cz * kBrickSize + z);
+			memcpy(&arrVoxels[GetBrickVoxelIndex(0, y, z)], pRow, kBrickSize * sizeof(uint32_t));
+		}
+	}
+	WriteCell(cx, cy, cz, arrVoxels);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool BrickPool::Build(const CPUVoxelVolume& volume)
+{
+	if (volume.GetResolution() != m_iResolution)
+	{
+		VS_LOG_VERBOSE("Brick pool and CPU volume resolutions don't match");
+		return false;
+	}
+
+	Clear();
+	for (int cz = 0; cz < m_iCellsPerAxis; cz++)
+	{
+		for (int cy = 0; cy < m_iCellsPerAxis; cy++)
+		{
+			for (int cx = 0; cx < m_iCellsPerAxis; cx++)
+			{
+				CopyCellFromVolume(volume, cx, cy, cz);
+			}
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long BrickPool::CompareWithDense(const CPUVoxelVolume& volume) const
+{
+	if (volume.GetResolution() != m_iResolution)
+	{
+		return -1;
+	}
+
+	long long iDiffering = 0;
+	for (int z = 0; z < m_iResolution; z++)
+	{
+		for (int y = 0; y < m_iResolution; y++)
+		{
+			for (int x = 0; x < m_iResolution; x++)
+			{
+				iDiffering += GetVoxel(x, y, z) != volume.GetVoxel(x, y, z);
+			}
+		}
+	}
+	return iDiffering;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BrickPool::Stats BrickPool::GetStats() const
+{
+	Stats stats;
+	stats.iNumCells = static_cast<int>(m_arrIndirection.size());
+	stats.iCapacity = static_cast<int>(m_arrBrickOwners.size());
+	stats.iNumAllocated = m_iNumAllocated;
+	stats.iNumFree = static_cast<int>(m_arrFreeList.size());
+
+	stats.iHighWaterMark = stats.iCapacity;
+	while (stats.iHighWaterMark > 0 && m_arrBrickOwners[stats.iHighWaterMark - 1] == kNull)
+	{
+		stats.iHighWaterMark--;
+	}
+	stats.fOccupancy = stats.iCapacity > 0 ? static_cast<float>(m_iNumAllocated) / stats.iCapacity : 0.f;
+	stats.fFragmentation = stats.iHighWaterMark > 0 ? static_cast<float>(stats.iHighWaterMark - m_iNumAllocated) / stats.iHighWaterMark : 0.f;
+
+	stats.iBrickBytes = m_arrBrickData.size() * sizeof(uint32_t);
+	stats.iIndirectionBytes = m_arrIndirection.size() * sizeof(uint32_t);
+	stats.iTotalBytes = GetMemoryUsageInBytes();
+	stats.iNumAllocations = m_iNumAllocations;
+	stats.iNumFrees = m_iNumFrees;
+	stats.iNumMoves = m_iNumMoves;
+	return stats;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t BrickPool::GetMemoryUsageInBytes() const
+{
+	return (m_arrBrickData.size() + m_arrIndirection.size() + m_arrBrickOwners.size() + m_arrFreeList.capacity()) * sizeof(uint32_t);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int BrickPool::CheckConsistency() const
+{
+	int iFailures = 0;
+	int iNumOwned = 0;
+	for (size_t i = 0; i < m_arrBrickOwners.size(); i++)
+	{
+		uint32_t iCell = m_arrBrickOwners[i];
+		if (iCell == kNull)
+		{
+			continue;
+		}
+		iNumOwned++;
+		if (iCell >= m_arrIndirection.size() || m_arrIndirection[iCell] != i)
+		{
+			iFailures++;
+		}
+	}
+
+	int iNumMapped = 0;
+	for (size_t i = 0; i < m_arrIndirection.size(); i++)
+	{
+		uint32_t iBrick = m_arrIndirection[i];
+		if (iBrick == kNull)
+		{
+			continue;
+		}
+		iNumMapped++;
+		if (iBrick >= m_arrBrickOwners.size() || m_arrBrickOwners[iBrick] != i)
+		{
+			iFailures++;
+		}
+	}
+
+	//every free brick on the free list exactly once
+	std::vector<uint8_t> arrOnFreeList(m_arrBrickOwners.size(), 0);
+	for (size_t i = 0; i < m_arrFreeList.size(); i++)
+	{
+		uint32_t iBrick = m_arrFreeList[i];
+		if (iBrick >= m_arrBrickOwners.size() || m_arrBrickOwners[iBrick] != kNull || arrOnFreeList[iBrick])
+		{
+			iFailures++;
+			continue;
+		}
+		arrOnFreeList[iBrick] = 1;
+	}
+
+	if (iNumOwned != m_iNumAllocated || iNumMapped != m_iNumAllocated || m_arrFreeList.size() + m_iNumAllocated != m_arrBrickOwners.size())
+	{
+		iFailures++;
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int BrickPool::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	const int iResolution = 64;
+	const int iNumSteps = 4000;
+	int iFailures = 0;
+
+	BrickPool pool;
+	//Sometimes no bricks up front and sometimes too few, so the pool has to grow either way
+	pool.Initialise(iResolution, (iSeed % 2) ? 0 : 16);
+	int iCellsPerAxis = pool.GetCellsPerAxis();
+	int iNumCells = iCellsPerAxis * iCellsPerAxis * iCellsPerAxis;
+
+	//What the pool should hold, and which cells should have a brick - a brick that's been set back to all zeros is
+	//kept until something frees it
+	CPUVoxelVolume reference;
+	reference.Initialise(iResolution, 1);
+	std::vector<uint8_t> arrAllocated(iNumCells, 0);
+	int iNumAllocated = 0;
+	uint32_t arrVoxels[kBrickVoxels];
+
+	auto clearReferenceCell = [&](int cx, int cy, int cz)
+	{
+		for (int z = 0; z < kBrickSize; z++)
+		{
+			for (int y = 0; y < kBrickSize; y++)
+			{
+				for (int x = 0; x < kBrickSize; x++)
+				{
+					reference.SetVoxel(cx * kBrickSize + x, cy * kBrickSize + y, cz * kBrickSize + z, 0);
+				}
+			}
+		}
+	};
+	auto isReferenceCellEmpty = [&](int cx, int cy, int cz)
+	{
+		for (int z = 0; z < kBrickSize; z++)
+		{
+			for (int y = 0; y < kBrickSize; y++)
+			{
+				for (int x = 0; x < kBrickSize; x++)
+				{
+					if (reference.GetVoxel(cx * kBrickSize + x, cy * kBrickSize + y, cz * kBrickSize + z) != 0)
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	};
+	auto setAllocated = [&](int iCell, bool bAllocated)
+	{
+		iNumAllocated += static_cast<int>(bAllocated) - arrAllocated[iCell];
+		arrAllocated[iCell] = bAllocated ? 1 : 0;
+	};
+
+	for (int iStep = 0; iStep < iNumSteps; iStep++)
+	{
+		int iCell = rng() % iNumCells;
+		int cx = iCell % iCellsPerAxis;
+		int cy = (iCell / iCellsPerAxis) % iCellsPerAxis;
+		int cz = iCell / (iCellsPerAxis * iCellsPerAxis);
+
+		//Mostly filling cells in, with enough freeing that there's always something to compact
+		uint32_t iOp = rng() % 100;
+		if (iOp < 35)
+		{
+			int x = cx * kBrickSize + rng() % kBrickSize, y = cy * kBrickSize + rng() % kBrickSize, z = cz * kBrickSize + rng() % kBrickSize;
+			uint32_t iColour = (rng() % 4 == 0) ? 0 : (rng() | 1);
+			pool.SetVoxel(x, y, z, iColour);
+			reference.SetVoxel(x, y, z, iColour);
+			if (iColour != 0)
+			{
+				setAllocated(iCell, true);
+			}
+		}
+		else if (iOp < 55)
+		{
+			//Empty, a few voxels or full
+			uint32_t iFill = rng() % 3;
+			for (int i = 0; i < kBrickVoxels; i++)
+			{
+				arrVoxels[i] = (iFill == 2 || (iFill == 1 && rng() % 16 == 0)) ? (rng() | 1) : 0;
+			}
+			pool.WriteCell(cx, cy, cz, arrVoxels);
+			bool bEmpty = true;
+			for (int z = 0; z < kBrickSize; z++)
+			{
+				for (int y = 0; y < kBrickSize; y++)
+				{
+					for (int x = 0; x < kBrickSize; x++)
+					{
+						uint32_t iColour = arrVoxels[GetBrickVoxelIndex(x, y, z)];
+						reference.SetVoxel(cx * kBrickSize + x, cy * kBrickSize + y, cz * kBrickSize + z, iColour);
+						bEmpty &= iColour == 0;
+					}
+				}
+			}
+			setAllocated(iCell, !bEmpty);
+		}
+		else if (iOp < 65)
+		{
+			//Allocating a cell that has a brick hands back the same one, a new one comes cleared
+			uint32_t iExisting = pool.GetBrick(cx, cy, cz);
+			uint32_t iBrick = pool.Allocate(cx, cy, cz);
+			if ((iExisting != kNull && iBrick != iExisting) || (iExisting == kNull && !pool.IsBrickEmpty(iBrick)))
+			{
+				iFailures++;
+			}
+			setAllocated(iCell, true);
+		}
+		else if (iOp < 80)
+		{
+			pool.Free(cx, cy, cz);
+			clearReferenceCell(cx, cy, cz);
+			setAllocated(iCell, false);
+		}
+		else if (iOp < 90)
+		{
+			bool bShouldFree = arrAllocated[iCell] && isReferenceCellEmpty(cx, cy, cz);
+			if (pool.FreeIfEmpty(cx, cy, cz) != bShouldFree)
+			{
+				iFailures++;
+			}
+			if (bShouldFree)
+			{
+				setAllocated(iCell, false);
+			}
+		}
+		else if (iOp < 96)
+		{
+			//A few moves at a time the way a frame budget would, or everything, after which the bricks are packed
+			bool bAll = rng() % 2 == 0;
+			pool.Compact(bAll ? INT_MAX : 1 + rng() % 8);
+			Stats stats = pool.GetStats();
+			if (bAll && stats.iHighWaterMark != stats.iNumAllocated)
+			{
+				iFailures++;
+			}
+			if (rng() % 2 == 0)
+			{
+				pool.Trim(static_cast<int>(rng() % 64));
+				Stats trimmed = pool.GetStats();
+				if (trimmed.iCapacity < trimmed.iHighWaterMark || trimmed.iNumAllocated != stats.iNumAllocated)
+				{
+					iFailures++;
+				}
+			}
+		}
+		else if (iOp < 97)
+		{
+			int iCapacity = pool.GetStats().iCapacity;
+			pool.Clear();
+			reference.Clear();
+			std::fill(arrAllocated.begin(), arrAllocated.end(), 0);
+			iNumAllocated = 0;
+			if (pool.GetStats().iCapacity != iCapacity)
+			{
+				iFailures++;
+			}
+		}
+		else
+		{
+			//Rebuilt from the reference only keeps the cells with something in them
+			pool.Build(reference);
+			for (int c = 0; c < iNumCells; c++)
+			{
+				setAllocated(c, !isReferenceCellEmpty(c % iCellsPerAxis, (c / iCellsPerAxis) % iCellsPerAxis, c / (iCellsPerAxis * iCellsPerAxis)));
+			}
+		}
+
+		iFailures += pool.CheckConsistency();
+		Stats stats = pool.GetStats();
+		if (stats.iNumAllocated != iNumAllocated || stats.iNumAllocated + stats.iNumFree != stats.iCapacity)
+		{
+			iFailures++;
+		}
+		if ((pool.GetBrick(cx, cy, cz) != kNull) != (arrAllocated[iCell] != 0))
+		{
+			iFailures++;
+		}
+		if (iStep % 200 == 199 || iStep == iNumSteps - 1)
+		{
+			iFailures += static_cast<int>(pool.CompareWithDense(reference));
+			for (int c = 0; c < iNumCells; c++)
+			{
+				if ((pool.m_arrIndirection[c] != kNull) != (arrAllocated[c] != 0))
+				{
+					iFailures++;
+				}
+			}
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Brick pool validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool BrickPool::RunPatrolBenchmark(const char* sName, const CPUVoxelVolume& staticVolume, const std::vector<XMFLOAT3>& arrPatrolRoute,
+	float fRadius, float fSpeed, int iNumFrames, int iCompactInterval)
+{
+	int iResolution = staticVolume.GetResolution();
+	if (arrPatrolRoute.size() < 2 || iResolution % kBrickSize != 0)
+	{
+		VS_LOG_VERBOSE("Brick pool benchmark needs a patrol route and a volume that divides into bricks");
+		return false;
+	}
+
+	std::stringstream ss;
+	ss << "../Results/BrickPool_" << sName << "_" << iResolution << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open brick pool benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Frame, Compacting, Live Bricks, Allocated, Freed, High Water Mark, Capacity, Fragmentation, Moves, Pool Memory(KB), Update(ms)\n";
+
+	const float fToKB = 1.f / 1024.f;
+	const uint32_t iSphereColour = PackRGBA8(XMFLOAT4(1.f, 0.f, 0.f, 1.f));
+	std::stringstream summary;
+	bool bValid = true;
+	for (int iPass = 0; iPass < 2; iPass++)
+	{
+		bool bCompacting = iPass == 1;
+		BrickPool pool;
+		pool.Initialise(iResolution);
+		pool.Build(staticVolume);
+		int iCellsPerAxis = pool.GetCellsPerAxis();
+
+		//a pool that never gives bricks back needs one for every allocation ever made
+		long long iGrowOnlyBricks = pool.GetStats().iNumAllocations;
+		int iPeakLive = 0, iPeakCapacity = 0, iFailures = 0;
+		double dTotalMs = 0.0, dMaxMs = 0.0;
+
+		XMFLOAT3 vPos = arrPatrolRoute[0];
+		int iPatrolIndex = 0;
+		std::vector<int> arrPrevCells, arrCells, arrTouched;
+		uint32_t arrVoxels[kBrickVoxels];
+		for (int iFrame = 0; iFrame < iNumFrames; iFrame++)
+		{
+			//same movement as Mesh::Update
+			XMVECTOR vDest = XMLoadFloat3(&arrPatrolRoute[(iPatrolIndex + 1) % arrPatrolRoute.size()]);
+			XMVECTOR vDir = XMVector3Normalize(vDest - XMLoadFloat3(&arrPatrolRoute[iPatrolIndex]));
+			XMVECTOR vCurrent = XMLoadFloat3(&vPos) + vDir * fSpeed;
+			if (XMVectorGetX(XMVector3LengthSq(vDest - vCurrent)) < fSpeed * fSpeed)
+			{
+				iPatrolIndex = (iPatrolIndex + 1) % static_cast<int>(arrPatrolRoute.size());
+			}
+			XMStoreFloat3(&vPos, vCurrent);
+
+			Stats before = pool.GetStats();
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+			//Put the static voxels back in every cell the sphere was or is in, with the sphere on top where it is now
+			GetShellCells(vPos, fRadius, iCellsPerAxis, arrCells);
+			arrTouched.clear();
+			std::set_union(arrPrevCells.begin(), arrPrevCells.end(), arrCells.begin(), arrCells.end(), std::back_inserter(arrTouched));
+			size_t iCurrent = 0;
+			for (size_t i = 0; i < arrTouched.size(); i++)
+			{
+				int iCell = arrTouched[i];
+				int cx = iCell % iCellsPerAxis;
+				int cy = (iCell / iCellsPerAxis) % iCellsPerAxis;
+				int cz = iCell / (iCellsPerAxis * iCellsPerAxis);
+				while (iCurrent < arrCells.size() && arrCells[iCurrent] < iCell)
+				{
+					iCurrent++;
+				}
+				if (iCurrent >= arrCells.size() || arrCells[iCurrent] != iCell)
+				{
+					pool.CopyCellFromVolume(staticVolume, cx, cy, cz);
+					continue;
+				}
+
+				for (int z = 0; z < kBrickSize; z++)
+				{
+					for (int y = 0; y < kBrickSize; y++)
+					{
+						for (int x = 0; x < kBrickSize; x++)
+						{
+							int vx = cx * kBrickSize + x, vy = cy * kBrickSize + y, vz = cz * kBrickSize + z;
+							arrVoxels[GetBrickVoxelIndex(x, y, z)] = IsInShell(vx, vy, vz, vPos, fRadius) ? iSphereColour : staticVolume.GetVoxel(vx, vy, vz);
+						}
+					}
+				}
+				pool.WriteCell(cx, cy, cz, arrVoxels);
+			}
+			arrPrevCells.swap(arrCells);
+
+			int iMoves = 0;
+			if (bCompacting && iCompactInterval > 0 && (iFrame % iCompactInterval) == iCompactInterval - 1)
+			{
+				//keep a quarter spare so the next few bricks the sphere needs don't double the pool straight back up
+				iMoves = pool.Compact();
+				pool.Trim(pool.GetStats().iNumAllocated * 5 / 4);
+			}
+			double dMs = GetElapsedMs(start);
+			dTotalMs += dMs;
+			dMaxMs = std::max(dMaxMs, dMs);
+
+			Stats stats = pool.GetStats();
+			long long iAllocated = stats.iNumAllocations - before.iNumAllocations;
+			long long iFreed = stats.iNumFrees - before.iNumFrees;
+			iGrowOnlyBricks += iAllocated;
+			iPeakLive = std::max(iPeakLive, stats.iNumAllocated);
+			iPeakCapacity = std::max(iPeakCapacity, stats.iCapacity);
+			iFailures += pool.CheckConsistency();
+
+			outfile << iFrame << "," << (bCompacting ? "Yes" : "No") << "," << stats.iNumAllocated << "," << iAllocated << "," << iFreed << ","
+				<< stats.iHighWaterMark << "," << stats.iCapacity << "," << stats.fFragmentation << "," << iMoves << "," << stats.iTotalBytes * fToKB << "," << dMs << "\n";
+		}
+
+		//the pool should hold exactly the static scene with the sphere where it finished
+		long long iDiffering = 0;
+		for (int z = 0; z < iResolution; z++)
+		{
+			for (int y = 0; y < iResolution; y++)
+			{
+				for (int x = 0; x < iResolution; x++)
+				{
+					uint32_t iExpected = IsInShell(x, y, z, vPos, fRadius) ? iSphereColour : staticVolume.GetVoxel(x, y, z);
+					iDiffering += pool.GetVoxel(x, y, z) != iExpected;
+				}
+			}
+		}
+		bValid &= iFailures == 0 && iDiffering == 0;
+
+		const char* sPass = bCompacting ? "Compacting" : "No Compaction";
+		summary << "\n" << sPass << " Peak Live Bricks:," << iPeakLive;
+		summary << "\n" << sPass << " Peak Capacity:," << iPeakCapacity;
+		summary << "\n" << sPass << " Peak Brick Memory(KB):," << static_cast<size_t>(iPeakCapacity) * kBrickVoxels * sizeof(uint32_t) * fToKB;
+		summary << "\n" << sPass << " Final Brick Memory(KB):," << pool.GetStats().iBrickBytes * fToKB;
+		summary << "\n" << sPass << " Grow Only Brick Memory(KB):," << static_cast<size_t>(iGrowOnlyBricks) * kBrickVoxels * sizeof(uint32_t) * fToKB;
+		summary << "\n" << sPass << " Average Update(ms):," << dTotalMs / iNumFrames;
+		summary << "\n" << sPass << " Max Update(ms):," << dMaxMs;
+		summary << "\n" << sPass << " Consistency Failures:," << iFailures;
+		summary << "\n" << sPass << " Voxels Differing:," << iDiffering;
+
+		VS_LOG("Brick pool " << sPass << ": peak " << iPeakLive << " bricks live, " << iPeakCapacity << " capacity, " << dTotalMs / iNumFrames << "ms a frame");
+	}
+
+	outfile << summary.str();
+	outfile << "\nDense Volume Memory(KB):," << staticVolume.GetMipSizeInBytes(0) * fToKB;
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	if (!bValid)
+	{
+		VS_LOG_VERBOSE("Brick pool lost track of its bricks during the patrol benchmark");
+	}
+	return bValid && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,129 @@
+#ifndef BRICK_POOL_H
+#define BRICK_POOL_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include <climits>
+#include "CPUVoxelVolume.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Pool of 8x8x8 RGBA8 voxel bricks (2KB each) for storing the voxelised scene sparsely, rather than in 32x32x16 tiles
+//(64KB) that only ever get added. The volume is split into a coarse grid of 8^3 cells and the indirection table says
+//which brick, if any, each cell lives in.
+//Allocating pops the free list and freeing pushes onto it, so both are O(1). When the free list runs dry the pool
+//doubles. Freed bricks leave holes, which Compact fills by moving the bricks at the top of the pool down into them
+//so the pool can be trimmed back.
+class BrickPool
+{
+public:
+
+	static const uint32_t kNull = 0xffffffff;
+	static const int kBrickSize = 8;
+	static const int kBrickVoxels = kBrickSize * kBrickSize * kBrickSize;
+
+	struct Stats
+	{
+		int iNumCells;				//entries in the indirection table
+		int iCapacity;				//bricks the pool has room for without growing
+		int iNumAllocated;
+		int iNumFree;
+		int iHighWaterMark;			//one past the highest brick in use
+		float fOccupancy;			//allocated / capacity
+		float fFragmentation;		//holes below the high water mark / high water mark
+		size_t iBrickBytes;
+		size_t iIndirectionBytes;
+		size_t iTotalBytes;
+		long long iNumAllocations;	//since Initialise
+		long long iNumFrees;
+		long long iNumMoves;		//bricks moved by Compact
+	};
+
+	BrickPool();
+	~BrickPool();
+
+	//iResolution has to be a multiple of kBrickSize. iInitialCapacity bricks are allocated up front.
+	bool Initialise(int iResolution, int iInitialCapacity = 0);
+	void Shutdown();
+	//Frees every brick but keeps the capacity
+	void Clear();
+
+	//Cell coordinates are voxel coordinates / kBrickSize. Allocate hands back the cell's brick if it already has one,
+	//otherwise a cleared brick off the free list.
+	uint32_t Allocate(int cx, int cy, int cz);
+	void Free(int cx, int cy, int cz);
+	//Frees the cell's brick if every voxel in it is empty. Returns true if it was freed.
+	bool FreeIfEmpty(int cx, int cy, int cz);
+	uint32_t GetBrick(int cx, int cy, int cz) const { return m_arrIndirection[GetCellIndex(cx, cy, cz)]; }
+
+	uint32_t* GetBrickData(uint32_t iBrick) { return &m_arrBrickData[static_cast<size_t>(iBrick) * kBrickVoxels]; }
+	const uint32_t* GetBrickData(uint32_t iBrick) const { return &m_arrBrickData[static_cast<size_t>(iBrick) * kBrickVoxels]; }
+	static int GetBrickVoxelIndex(int x, int y, int z) { return (z * kBrickSize + y) * kBrickSize + x; }
+	bool IsBrickEmpty(uint32_t iBrick) const;
+
+	//Voxel access. Setting a non zero voxel allocates its brick, setting 0 in an unallocated cell does nothing.
+	uint32_t GetVoxel(int x, int y, int z) const;
+	void SetVoxel(int x, int y, int z, uint32_t iColour);
+
+	//Moves up to iMaxMoves bricks from the top of the pool into the lowest holes and fixes up the indirection table.
+	//Returns the number moved. Leaves the allocated bricks packed at the bottom once it has done them all.
+	int Compact(int iMaxMoves = INT_MAX);
+	//Drops capacity above the high water mark, keeping at least iMinCapacity
+	void Trim(int iMinCapacity = 0);
+
+	//Loads mip 0 of the volume, allocating a brick for every cell with something in it
+	bool Build(const CPUVoxelVolume& volume);
+	//Replaces the cell's kBrickVoxels voxels, allocating a brick if any are set and freeing it if none are
+	void WriteCell(int cx, int cy, int cz, const uint32_t* pVoxels);
+	//WriteCell with the cell's voxels from mip 0 of the volume
+	void CopyCellFromVolume(const CPUVoxelVolume& volume, int cx, int cy, int cz);
+	//Voxels that differ from mip 0 of the volume
+	long long CompareWithDense(const CPUVoxelVolume& volume) const;
+
+	int GetResolution() const { return m_iResolution; }
+	int GetCellsPerAxis() const { return m_iCellsPerAxis; }
+	Stats GetStats() const;
+	size_t GetMemoryUsageInBytes() const;
+
+	//Random allocates, frees, writes, compacts and trims against a dense copy of what the pool should hold, checking the
+	//pool's bookkeeping after every step. Returns the number of problems.
+	static int Validate(unsigned int iSeed);
+
+	//Replays a dynamic sphere patrolling through the static volume for iNumFrames, freeing the bricks it leaves and
+	//allocating the ones it enters, with and without compacting every iCompactInterval frames, and writes the pool's
+	//size and fragmentation per frame to ../Results/. Positions and sizes are in voxels.
+	static bool RunPatrolBenchmark(const char* sName, const CPUVoxelVolume& staticVolume, const std::vector<XMFLOAT3>& arrPatrolRoute,
+		float fRadius, float fSpeed, int iNumFrames, int iCompactInterval);
+
+private:
+
+	int GetCellIndex(int cx, int cy, int cz) const { return (cz * m_iCellsPerAxis + cy) * m_iCellsPerAxis + cx; }
+	//Checks the indirection table, brick owners and free list all agree. Returns the number of problems.
+	int CheckConsistency() const;
+	void Grow(int iNewCapacity);
+	void RebuildFreeList();
+
+	int m_iResolution;
+	int m_iCellsPerAxis;
+	int m_iNumAllocated;
+
+	std::vector<uint32_t> m_arrBrickData;		//capacity * kBrickVoxels
+	std::vector<uint32_t> m_arrIndirection;		//brick for each cell, kNull if it has none
+	std::vector<uint32_t> m_arrBrickOwners;		//cell each brick belongs to, kNull if it's free
+	std::vector<uint32_t> m_arrFreeList;		//stack, the last brick freed is the next one handed out
+
+	long long m_iNumAllocations;
+	long long m_iNumFrees;
+	long long m_iNumMoves;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !BRICK_POOL_H
@@ -0,0 +1,987 @@
+#include "NoFloatContraction.h"
+#include "CPUConeTracer.h"
+#include "CPUVoxeliser.h"
+#include "OccupancyPyramid.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CONE_TRACER_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define CONE_TRACER_X86_SIMD 0
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int CPUConeTracer::kTileSize;
+const int CPUConeTracer::kNumDiffuseCones;
+const int CPUConeTracer::kMaxCones;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Same as OccupancyPyramid::MarchCone, which Validate checks the lane version against
+	const float kConeStartOffset = 1.f;
+	const float kConeStepScale = 0.5f;
+	const float kConeOpacityCutoff = 0.95f;
+
+	const float kSurfaceOffset = 1.f;				//voxels along the normal the cones start from
+	const float kDiffuseTanHalfAngle = 0.577f;		//60 degree cones
+	const float kMinSpecularTanHalfAngle = 0.05f;	//roughness 0, widening to a diffuse cone at roughness 1
+	const float kDiffuseCentreWeight = 0.25f;
+	const float kDiffuseSideWeight = 0.15f;
+	const float kCos60 = 0.5f;
+	const float kSin60 = 0.866025f;
+	//cos and sin of the side cones' angles around the normal, 72 degrees apart
+	const float kSideConeAngles[CPUConeTracer::kNumDiffuseCones - 1][2] =
+	{
+		{ 1.f, 0.f }, { 0.309017f, 0.951057f }, { -0.809017f, 0.587785f }, { -0.809017f, -0.587785f }, { 0.309017f, -0.951057f }
+	};
+
+	typedef uint32_t LaneTexels[8][CPUConeTracer::kMaxCones];		//[corner][lane]
+	typedef float LaneFractions[3][CPUConeTracer::kMaxCones];		//[axis][lane]
+	typedef float LaneColours[4][CPUConeTracer::kMaxCones];			//[channel][lane]
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	inline bool IsInsideVolume(const XMFLOAT3& vPos, float fResolution)
+	{
+		return vPos.x >= 0.f && vPos.y >= 0.f && vPos.z >= 0.f && vPos.x < fResolution && vPos.y < fResolution && vPos.z < fResolution;
+	}
+
+	inline XMFLOAT3 Normalise(const XMFLOAT3& v)
+	{
+		float fLength = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+		float fRecip = fLength > 0.f ? 1.f / fLength : 0.f;
+		return XMFLOAT3(v.x * fRecip, v.y * fRecip, v.z * fRecip);
+	}
+
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	//The 8 texels and the weights SampleTrilinear would use for one lane, worked out exactly the same way
+	inline void GatherCorners(const CPUVoxelVolume& volume, int iMipLevel, const XMFLOAT3& vUVW, int iLane, LaneTexels& texels, LaneFractions& fractions)
+	{
+		int iRes = volume.GetMipResolution(iMipLevel);
+		float fX = vUVW.x * iRes - 0.5f;
+		float fY = vUVW.y * iRes - 0.5f;
+		float fZ = vUVW.z * iRes - 0.5f;
+		int x0 = static_cast<int>(floorf(fX));
+		int y0 = static_cast<int>(floorf(fY));
+		int z0 = static_cast<int>(floorf(fZ));
+		fractions[0][iLane] = fX - x0;
+		fractions[1][iLane] = fY - y0;
+		fractions[2][iLane] = fZ - z0;
+		if (x0 >= 0 && y0 >= 0 && z0 >= 0 && x0 + 1 < iRes && y0 + 1 < iRes && z0 + 1 < iRes)
+		{
+			//All 8 inside, which is nearly always, so straight off the base texel
+			size_t iRow = iRes, iSlice = static_cast<size_t>(iRes) * iRes;
+			const uint32_t* pBase = volume.GetMipData(iMipLevel) + (z0 * iSlice) + (y0 * iRow) + x0;
+			texels[0][iLane] = pBase[0];
+			texels[1][iLane] = pBase[1];
+			texels[2][iLane] = pBase[iRow];
+			texels[3][iLane] = pBase[iRow + 1];
+			texels[4][iLane] = pBase[iSlice];
+			texels[5][iLane] = pBase[iSlice + 1];
+			texels[6][iLane] = pBase[iSlice + iRow];
+			texels[7][iLane] = pBase[iSlice + iRow + 1];
+			return;
+		}
+		for (int i = 0; i < 8; i++)
+		{
+			texels[i][iLane] = volume.GetVoxelClamped(x0 + (i & 1), y0 + ((i >> 1) & 1), z0 + ((i >> 2) & 1), iMipLevel);
+		}
+	}
+
+	inline void ClearLane(int iLane, LaneTexels& texels, LaneFractions& fractions)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			texels[i][iLane] = 0;
+		}
+		fractions[0][iLane] = fractions[1][iLane] = fractions[2][iLane] = 0.f;
+	}
+
+	//Trilinear filtering of the first iNumLanes lanes, the sum SampleTrilinear does in the same order
+	void FilterLanesScalar(const LaneTexels& texels, const LaneFractions& fractions, int iNumLanes, LaneColours& colours)
+	{
+		for (int c = 0; c < iNumLanes; c++)
+		{
+			float vResult[4] = { 0.f, 0.f, 0.f, 0.f };
+			for (int i = 0; i < 8; i++)
+			{
+				int dx = i & 1, dy = (i >> 1) & 1, dz = (i >> 2) & 1;
+				float fWeight = (dx ? fractions[0][c] : 1.f - fractions[0][c]) * (dy ? fractions[1][c] : 1.f - fractions[1][c]) * (dz ? fractions[2][c] : 1.f - fractions[2][c]);
+				uint32_t iTexel = texels[i][c];
+				if (iTexel != 0 && fWeight > 0.f)
+				{
+					XMFLOAT4 vTexel = UnpackRGBA8(iTexel);
+					vResult[0] += vTexel.x * fWeight;
+					vResult[1] += vTexel.y * fWeight;
+					vResult[2] += vTexel.z * fWeight;
+					vResult[3] += vTexel.w * fWeight;
+				}
+			}
+			for (int j = 0; j < 4; j++)
+			{
+				colours[j][c] = vResult[j];
+			}
+		}
+	}
+
+#if CONE_TRACER_X86_SIMD
+	//4 lanes at a time. Skipped corners add a masked zero, which leaves the sums exactly as the scalar ones.
+	void FilterLanesSSE(const LaneTexels& texels, const LaneFractions& fractions, int iNumLanes, LaneColours& colours)
+	{
+		const __m128 vOne = _mm_set1_ps(1.f);
+		const __m128 vZero = _mm_setzero_ps();
+		const __m128 vRecip255 = _mm_set1_ps(1.f / 255.f);
+		const __m128i vByteMask = _mm_set1_epi32(0xff);
+		for (int c = 0; c < iNumLanes; c += 4)
+		{
+			__m128 vFrac[3], vOneMinus[3];
+			for (int a = 0; a < 3; a++)
+			{
+				vFrac[a] = _mm_loadu_ps(&fractions[a][c]);
+				vOneMinus[a] = _mm_sub_ps(vOne, vFrac[a]);
+			}
+			__m128 vR = vZero, vG = vZero, vB = vZero, vA = vZero;
+			for (int i = 0; i < 8; i++)
+			{
+				__m128 vWeight = _mm_mul_ps(_mm_mul_ps((i & 1) ? vFrac[0] : vOneMinus[0], (i & 2) ? vFrac[1] : vOneMinus[1]), (i & 4) ? vFrac[2] : vOneMinus[2]);
+				__m128i vTexel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&texels[i][c]));
+				__m128 vEmpty = _mm_castsi128_ps(_mm_cmpeq_epi32(vTexel, _mm_setzero_si128()));
+				__m128 vMask = _mm_andnot_ps(vEmpty, _mm_cmpgt_ps(vWeight, vZero));
+				vWeight = _mm_and_ps(vWeight, vMask);
+				vR = _mm_add_ps(vR, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(vTexel, vByteMask)), vRecip255), vWeight));
+				vG = _mm_add_ps(vG, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(vTexel, 8), vByteMask)), vRecip255), vWeight));
+				vB = _mm_add_ps(vB, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(vTexel, 16), vByteMask)), vRecip255), vWeight));
+				vA = _mm_add_ps(vA, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(vTexel, 24)), vRecip255), vWeight));
+			}
+			_mm_storeu_ps(&colours[0][c], vR);
+			_mm_storeu_ps(&colours[1][c], vG);
+			_mm_storeu_ps(&colours[2][c], vB);
+			_mm_storeu_ps(&colours[3][c], vA);
+		}
+	}
+
+	//All 8 lanes at once
+	TARGET_AVX2 void FilterLanesAVX2(const LaneTexels& texels, const LaneFractions& fractions, int, LaneColours& colours)
+	{
+		const __m256 vOne = _mm256_set1_ps(1.f);
+		const __m256 vZero = _mm256_setzero_ps();
+		const __m256 vRecip255 = _mm256_set1_ps(1.f / 255.f);
+		const __m256i vByteMask = _mm256_set1_epi32(0xff);
+		__m256 vFrac[3], vOneMinus[3];
+		for (int a = 0; a < 3; a++)
+		{
+			vFrac[a] = _mm256_loadu_ps(fractions[a]);
+			vOneMinus[a] = _mm256_sub_ps(vOne, vFrac[a]);
+		}
+		__m256 vR = vZero, vG = vZero, vB = vZero, vA = vZero;
+		for (int i = 0; i < 8; i++)
+		{
+			__m256 vWeight = _mm256_mul_ps(_mm256_mul_ps((i & 1) ? vFrac[0] : vOneMinus[0], (i & 2) ? vFrac[1] : vOneMinus[1]), (i & 4) ? vFrac[2] : vOneMinus[2]);
+			__m256i vTexel = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(texels[i]));
+			__m256 vEmpty = _mm256_castsi256_ps(_mm256_cmpeq_epi32(vTexel, _mm256_setzero_si256()));
+			__m256 vMask = _mm256_andnot_ps(vEmpty, _mm256_cmp_ps(vWeight, vZero, _CMP_GT_OQ));
+			vWeight = _mm256_and_ps(vWeight, vMask);
+			vR = _mm256_add_ps(vR, _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(vTexel, vByteMask)), vRecip255), vWeight));
+			vG = _mm256_add_ps(vG, _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(vTexel, 8), vByteMask)), vRecip255), vWeight));
+			vB = _mm256_add_ps(vB, _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(vTexel, 16), vByteMask)), vRecip255), vWeight));
+			vA = _mm256_add_ps(vA, _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(vTexel, 24)), vRecip255), vWeight));
+		}
+		_mm256_storeu_ps(colours[0], vR);
+		_mm256_storeu_ps(colours[1], vG);
+		_mm256_storeu_ps(colours[2], vB);
+		_mm256_storeu_ps(colours[3], vA);
+	}
+#endif
+
+	void FillRandomVolume(CPUVoxelVolume& volume, std::mt19937& rng)
+	{
+		volume.Clear();
+		int iRes = volume.GetResolution();
+		std::uniform_int_distribution<int> coord(0, iRes - 1);
+		std::uniform_int_distribution<uint32_t> colour(1, 0xffffffff);
+		for (int s = 0; s < 6; s++)
+		{
+			int iMin[3], iMax[3];
+			for (int i = 0; i < 3; i++)
+			{
+				iMin[i] = coord(rng);
+				iMax[i] = std::min(iRes, iMin[i] + 1 + coord(rng) / 3);
+			}
+			uint32_t iColour = colour(rng);
+			for (int z = iMin[2]; z < iMax[2]; z++)
+			{
+				for (int y = iMin[1]; y < iMax[1]; y++)
+				{
+					for (int x = iMin[0]; x < iMax[0]; x++)
+					{
+						volume.SetVoxel(x, y, z, iColour);
+					}
+				}
+			}
+		}
+		int iNumScattered = iRes * iRes * iRes / 100;
+		for (int i = 0; i < iNumScattered; i++)
+		{
+			volume.SetVoxel(coord(rng), coord(rng), coord(rng), colour(rng));
+		}
+		volume.GenerateMips();
+	}
+
+	XMFLOAT3 RandomDirection(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> dist(-1.f, 1.f);
+		while (true)
+		{
+			XMFLOAT3 v(dist(rng), dist(rng), dist(rng));
+			float fLengthSq = v.x * v.x + v.y * v.y + v.z * v.z;
+			if (fLengthSq > 0.01f && fLengthSq <= 1.f)
+			{
+				return Normalise(v);
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUConeTracer::GBuffer::Resize(int iNewWidth, int iNewHeight)
+{
+	iWidth = iNewWidth;
+	iHeight = iNewHeight;
+	size_t iNumPixels = static_cast<size_t>(iNewWidth) * iNewHeight;
+	arrWorldPos.assign(iNumPixels, XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+	arrDiffuse.assign(iNumPixels, XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+	arrNormals.assign(iNumPixels, XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPUConeTracer::CPUConeTracer()
+	: m_pVolume(nullptr),
+	m_fMaxDistance(0.f),
+	m_iNumThreads(0),
+	m_eSIMDLevel(simdScalar)
+{
+	SetSIMDLevel(simdMax);
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPUConeTracer::~CPUConeTracer()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUConeTracer::Initialise(const XMMATRIX& mWorldToVoxelGrid, const CPUVoxelVolume* pVolume, int iNumThreads)
+{
+	if (!pVolume || pVolume->GetResolution() <= 0)
+	{
+		VS_LOG_VERBOSE("Cone tracer needs a voxel volume");
+		return false;
+	}
+	m_pVolume = pVolume;
+	m_iNumThreads = iNumThreads;
+	m_fMaxDistance = static_cast<float>(pVolume->GetResolution());
+	m_VoxelGrid.Initialise(mWorldToVoxelGrid, pVolume->GetResolution());
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUConeTracer::SetSIMDLevel(SIMDLevel eLevel)
+{
+#if CONE_TRACER_X86_SIMD
+	m_eSIMDLevel = std::min(eLevel, TriangleBoxOverlap::GetSupportedLevel());
+#else
+	m_eSIMDLevel = simdScalar;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* CPUConeTracer::GetModeName(GIRenderFlag eMode)
+{
+	switch (eMode)
+	{
+	case giFull:
+		return "Full";
+	case giDiff:
+		return "Diffuse";
+	case giSpec:
+		return "Specular";
+	case giAO:
+		return "AO";
+	default:
+		return "None";
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUConeTracer::TraceBatch(ConeBatch& batch, long long& iNumSteps) const
+{
+	const CPUVoxelVolume& volume = *m_pVolume;
+	if (m_eSIMDLevel == simdScalar || batch.iNumCones == 1)
+	{
+		for (int c = 0; c < batch.iNumCones; c++)
+		{
+			OccupancyPyramid::MarchStats stats;
+			memset(&stats, 0, sizeof(stats));
+			XMFLOAT3 vDirection(batch.vDirection[0][c], batch.vDirection[1][c], batch.vDirection[2][c]);
+			XMFLOAT4 vResult = OccupancyPyramid::MarchCone(volume, nullptr, batch.vOrigin, vDirection, batch.fTanHalfAngle[c], m_fMaxDistance, &stats);
+			batch.vResult[0][c] = vResult.x;
+			batch.vResult[1][c] = vResult.y;
+			batch.vResult[2][c] = vResult.z;
+			batch.vResult[3][c] = vResult.w;
+			iNumSteps += stats.iNumSteps;
+		}
+		return;
+	}
+
+	//Every lane marches its own cone, stepping and picking mips exactly as MarchCone does. Only the filtering is done
+	//across the lanes, as that's where the maths is, so a lone cone isn't worth putting in lanes.
+	void (*fnFilter)(const LaneTexels&, const LaneFractions&, int, LaneColours&) = FilterLanesScalar;
+	int iNumLanes = batch.iNumCones;
+#if CONE_TRACER_X86_SIMD
+	if (m_eSIMDLevel == simdAVX2)
+	{
+		fnFilter = FilterLanesAVX2;
+		iNumLanes = kMaxCones;
+	}
+	else
+	{
+		fnFilter = FilterLanesSSE;
+		iNumLanes = (batch.iNumCones + 3) & ~3;
+	}
+#endif
+
+	float fResolution = static_cast<float>(volume.GetResolution());
+	float fRecipResolution = 1.f / fResolution;
+	int iMaxMip = volume.GetMipLevels() - 1;
+
+	float t[kMaxCones], fDiameter[kMaxCones], fBlend[kMaxCones];
+	bool bActive[kMaxCones], bBlend[kMaxCones];
+	LaneTexels texels[2];
+	LaneFractions fractions[2];
+	LaneColours samples[2];
+	bool bAnyActive = false;
+	for (int c = 0; c < kMaxCones; c++)
+	{
+		t[c] = kConeStartOffset;
+		bActive[c] = c < batch.iNumCones && t[c] < m_fMaxDistance;
+		bBlend[c] = false;
+		bAnyActive |= bActive[c];
+		for (int j = 0; j < 4; j++)
+		{
+			batch.vResult[j][c] = 0.f;
+		}
+		ClearLane(c, texels[0], fractions[0]);
+		ClearLane(c, texels[1], fractions[1]);
+	}
+
+	while (bAnyActive)
+	{
+		bool bAnyBlend = false;
+		for (int c = 0; c < batch.iNumCones; c++)
+		{
+			if (!bActive[c])
+			{
+				continue;
+			}
+			XMFLOAT3 vPos(batch.vOrigin.x + batch.vDirection[0][c] * t[c], batch.vOrigin.y + batch.vDirection[1][c] * t[c], batch.vOrigin.z + batch.vDirection[2][c] * t[c]);
+			if (!IsInsideVolume(vPos, fResolution))
+			{
+				bActive[c] = false;
+				ClearLane(c, texels[0], fractions[0]);
+				ClearLane(c, texels[1], fractions[1]);
+				continue;
+			}
+			XMFLOAT3 vUVW(vPos.x * fRecipResolution, vPos.y * fRecipResolution, vPos.z * fRecipResolution);
+			fDiameter[c] = std::max(1.f, 2.f * batch.fTanHalfAngle[c] * t[c]);
+			float fMipLevel = std::max(0.f, std::min(log2f(fDiameter[c]), static_cast<float>(iMaxMip)));
+			int iLowerMip = static_cast<int>(fMipLevel);
+			int iUpperMip = std::min(iLowerMip + 1, iMaxMip);
+			fBlend[c] = fMipLevel - iLowerMip;
+			GatherCorners(volume, iLowerMip, vUVW, c, texels[0], fractions[0]);
+			bool bWasBlending = bBlend[c];
+			bBlend[c] = fBlend[c] > 0.f && iUpperMip != iLowerMip;
+			if (bBlend[c])
+			{
+				GatherCorners(volume, iUpperMip, vUVW, c, texels[1], fractions[1]);
+				bAnyBlend = true;
+			}
+			else if (bWasBlending)
+			{
+				ClearLane(c, texels[1], fractions[1]);
+			}
+		}
+
+		fnFilter(texels[0], fractions[0], iNumLanes, samples[0]);
+		if (bAnyBlend)
+		{
+			fnFilter(texels[1], fractions[1], iNumLanes, samples[1]);
+		}
+
+		bAnyActive = false;
+		for (int c = 0; c < batch.iNumCones; c++)
+		{
+			if (!bActive[c])
+			{
+				continue;
+			}
+			float vSample[4];
+			for (int j = 0; j < 4; j++)
+			{
+				vSample[j] = bBlend[c] ? samples[0][j][c] + (samples[1][j][c] - samples[0][j][c]) * fBlend[c] : samples[0][j][c];
+			}
+			//Premultiplied, front to back
+			float fTransmittance = 1.f - batch.vResult[3][c];
+			for (int j = 0; j < 4; j++)
+			{
+				batch.vResult[j][c] += fTransmittance * vSample[j];
+			}
+			iNumSteps++;
+
+			t[c] += fDiameter[c] * kConeStepScale;
+			bActive[c] = t[c] < m_fMaxDistance && batch.vResult[3][c] < kConeOpacityCutoff;
+			if (!bActive[c])
+			{
+				ClearLane(c, texels[0], fractions[0]);
+				ClearLane(c, texels[1], fractions[1]);
+			}
+			bAnyActive |= bActive[c];
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMFLOAT3 CPUConeTracer::ShadePixel(const GBuffer& gBuffer, int iPixel, const XMFLOAT3& vCameraPosition, GIRenderFlag eMode, long long& iNumCones, long long& iNumSteps) const
+{
+	const XMFLOAT4& vPosition = gBuffer.arrWorldPos[iPixel];
+	const XMFLOAT4& vAlbedo = gBuffer.arrDiffuse[iPixel];
+	const XMFLOAT4& vNormalRoughness = gBuffer.arrNormals[iPixel];
+	XMFLOAT3 vNormal = Normalise(XMFLOAT3(vNormalRoughness.x, vNormalRoughness.y, vNormalRoughness.z));
+
+	//The grid is a uniformly scaled cube, so directions are the same in voxel space as in world space
+	XMFLOAT3 vVoxelPos;
+	m_VoxelGrid.WorldToVoxel(XMFLOAT3(vPosition.x, vPosition.y, vPosition.z), vVoxelPos);
+
+	ConeBatch batch;
+	batch.iNumCones = 0;
+	batch.vOrigin = XMFLOAT3(vVoxelPos.x + vNormal.x * kSurfaceOffset, vVoxelPos.y + vNormal.y * kSurfaceOffset, vVoxelPos.z + vNormal.z * kSurfaceOffset);
+
+	bool bDiffuse = eMode == giFull || eMode == giDiff || eMode == giAO;
+	bool bSpecular = eMode == giFull || eMode == giSpec;
+	if (bDiffuse)
+	{
+		XMFLOAT3 vUp = fabsf(vNormal.y) < 0.999f ? XMFLOAT3(0.f, 1.f, 0.f) : XMFLOAT3(1.f, 0.f, 0.f);
+		XMFLOAT3 vTangent = Normalise(Cross(vUp, vNormal));
+		XMFLOAT3 vBitangent = Cross(vNormal, vTangent);
+
+		batch.vDirection[0][0] = vNormal.x;
+		batch.vDirection[1][0] = vNormal.y;
+		batch.vDirection[2][0] = vNormal.z;
+		batch.fTanHalfAngle[0] = kDiffuseTanHalfAngle;
+		for (int i = 1; i < kNumDiffuseCones; i++)
+		{
+			float fCos = kSideConeAngles[i - 1][0] * kSin60;
+			float fSin = kSideConeAngles[i - 1][1] * kSin60;
+			batch.vDirection[0][i] = vNormal.x * kCos60 + vTangent.x * fCos + vBitangent.x * fSin;
+			batch.vDirection[1][i] = vNormal.y * kCos60 + vTangent.y * fCos + vBitangent.y * fSin;
+			batch.vDirection[2][i] = vNormal.z * kCos60 + vTangent.z * fCos + vBitangent.z * fSin;
+			batch.fTanHalfAngle[i] = kDiffuseTanHalfAngle;
+		}
+		batch.iNumCones = kNumDiffuseCones;
+	}
+	int iSpecularCone = batch.iNumCones;
+	if (bSpecular)
+	{
+		XMFLOAT3 vView = Normalise(XMFLOAT3(vPosition.x - vCameraPosition.x, vPosition.y - vCameraPosition.y, vPosition.z - vCameraPosition.z));
+		float fVDotN = vView.x * vNormal.x + vView.y * vNormal.y + vView.z * vNormal.z;
+		float fRoughness = std::max(0.f, std::min(vNormalRoughness.w, 1.f));
+		batch.vDirection[0][iSpecularCone] = vView.x - 2.f * fVDotN * vNormal.x;
+		batch.vDirection[1][iSpecularCone] = vView.y - 2.f * fVDotN * vNormal.y;
+		batch.vDirection[2][iSpecularCone] = vView.z - 2.f * fVDotN * vNormal.z;
+		batch.fTanHalfAngle[iSpecularCone] = kMinSpecularTanHalfAngle + (kDiffuseTanHalfAngle - kMinSpecularTanHalfAngle) * fRoughness;
+		batch.iNumCones++;
+	}
+
+	TraceBatch(batch, iNumSteps);
+	iNumCones += batch.iNumCones;
+
+	XMFLOAT4 vDiffuse(0.f, 0.f, 0.f, 0.f);
+	if (bDiffuse)
+	{
+		for (int i = 0; i < kNumDiffuseCones; i++)
+		{
+			float fWeight = i == 0 ? kDiffuseCentreWeight : kDiffuseSideWeight;
+			vDiffuse.x += batch.vResult[0][i] * fWeight;
+			vDiffuse.y += batch.vResult[1][i] * fWeight;
+			vDiffuse.z += batch.vResult[2][i] * fWeight;
+			vDiffuse.w += batch.vResult[3][i] * fWeight;
+		}
+	}
+	XMFLOAT3 vSpecular(0.f, 0.f, 0.f);
+	if (bSpecular)
+	{
+		vSpecular = XMFLOAT3(batch.vResult[0][iSpecularCone], batch.vResult[1][iSpecularCone], batch.vResult[2][iSpecularCone]);
+	}
+
+	switch (eMode)
+	{
+	case giFull:
+		return XMFLOAT3(vAlbedo.x * vDiffuse.x + vSpecular.x, vAlbedo.y * vDiffuse.y + vSpecular.y, vAlbedo.z * vDiffuse.z + vSpecular.z);
+	case giDiff:
+		return XMFLOAT3(vAlbedo.x * vDiffuse.x, vAlbedo.y * vDiffuse.y, vAlbedo.z * vDiffuse.z);
+	case giSpec:
+		return vSpecular;
+	case giAO:
+		return XMFLOAT3(1.f - vDiffuse.w, 1.f - vDiffuse.w, 1.f - vDiffuse.w);
+	default:
+		return XMFLOAT3(0.f, 0.f, 0.f);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUConeTracer::Render(const GBuffer& gBuffer, const XMFLOAT3& vCameraPosition, GIRenderFlag eMode, std::vector<XMFLOAT3>& arrImage)
+{
+	size_t iNumPixels = static_cast<size_t>(gBuffer.iWidth) * gBuffer.iHeight;
+	if (!m_pVolume || gBuffer.arrWorldPos.size() != iNumPixels || gBuffer.arrDiffuse.size() != iNumPixels || gBuffer.arrNormals.size() != iNumPixels)
+	{
+		VS_LOG_VERBOSE("Cone tracer isn't initialised or the G-buffer is the wrong size");
+		return false;
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	arrImage.assign(iNumPixels, XMFLOAT3(0.f, 0.f, 0.f));
+
+	int iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+	std::vector<long long> arrPixels(iNumThreads, 0), arrCones(iNumThreads, 0), arrSteps(iNumThreads, 0);
+	if (eMode > giNone && eMode < giMax)
+	{
+		int iTilesX = (gBuffer.iWidth + kTileSize - 1) / kTileSize;
+		int iTilesY = (gBuffer.iHeight + kTileSize - 1) / kTileSize;
+		Parallel::For(iTilesX * iTilesY, iNumThreads, [&](int iTile, int iThread)
+		{
+			int iStartX = (iTile % iTilesX) * kTileSize;
+			int iStartY = (iTile / iTilesX) * kTileSize;
+			int iEndX = std::min(iStartX + kTileSize, gBuffer.iWidth);
+			int iEndY = std::min(iStartY + kTileSize, gBuffer.iHeight);
+			for (int y = iStartY; y < iEndY; y++)
+			{
+				for (int x = iStartX; x < iEndX; x++)
+				{
+					int iPixel = y * gBuffer.iWidth + x;
+					const XMFLOAT4& vNormal = gBuffer.arrNormals[iPixel];
+					if (vNormal.x == 0.f && vNormal.y == 0.f && vNormal.z == 0.f)
+					{
+						continue;
+					}
+					arrImage[iPixel] = ShadePixel(gBuffer, iPixel, vCameraPosition, eMode, arrCones[iThread], arrSteps[iThread]);
+					arrPixels[iThread]++;
+				}
+			}
+		});
+	}
+
+	m_Stats.eSIMDLevel = m_eSIMDLevel;
+	m_Stats.iNumThreads = iNumThreads;
+	m_Stats.eMode = eMode;
+	m_Stats.iNumPixels = 0;
+	m_Stats.iNumCones = 0;
+	m_Stats.iNumSteps = 0;
+	for (int t = 0; t < iNumThreads; t++)
+	{
+		m_Stats.iNumPixels += arrPixels[t];
+		m_Stats.iNumCones += arrCones[t];
+		m_Stats.iNumSteps += arrSteps[t];
+	}
+	m_Stats.dTimeMs = GetElapsedMs(start);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUConeTracer::WritePPM(const char* sFilename, int iWidth, int iHeight, const std::vector<XMFLOAT3>& arrImage)
+{
+	std::ofstream outfile(sFilename, std::ios::binary);
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open " << sFilename);
+		return false;
+	}
+	outfile << "P6\n" << iWidth << " " << iHeight << "\n255\n";
+	std::vector<uint8_t> arrRow(iWidth * 3);
+	for (int y = 0; y < iHeight; y++)
+	{
+		for (int x = 0; x < iWidth; x++)
+		{
+			uint32_t iColour = PackRGBA8(XMFLOAT4(arrImage[y * iWidth + x].x, arrImage[y * iWidth + x].y, arrImage[y * iWidth + x].z, 1.f));
+			arrRow[x * 3] = static_cast<uint8_t>(iColour & 0xff);
+			arrRow[x * 3 + 1] = static_cast<uint8_t>((iColour >> 8) & 0xff);
+			arrRow[x * 3 + 2] = static_cast<uint8_t>((iColour >> 16) & 0xff);
+		}
+		outfile.write(reinterpret_cast<const char*>(arrRow.data()), arrRow.size());
+	}
+	return outfile.good();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUConeTracer::WritePFM(const char* sFilename, int iWidth, int iHeight, const std::vector<XMFLOAT3>& arrImage)
+{
+	std::ofstream outfile(sFilename, std::ios::binary);
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open " << sFilename);
+		return false;
+	}
+	//A negative scale means little endian, and the rows go bottom to top
+	outfile << "PF\n" << iWidth << " " << iHeight << "\n-1.0\n";
+	for (int y = iHeight - 1; y >= 0; y--)
+	{
+		outfile.write(reinterpret_cast<const char*>(&arrImage[y * iWidth]), iWidth * sizeof(XMFLOAT3));
+	}
+	return outfile.good();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUConeTracer::BuildGBuffer(const CPUVoxelVolume& volume, const XMMATRIX& mWorldToVoxelGrid, const XMFLOAT3& vCameraPosition, const XMFLOAT3& vLookAt,
+	float fFovY, float fRoughness, int iWidth, int iHeight, GBuffer& gBuffer)
+{
+	gBuffer.Resize(iWidth, iHeight);
+	int iResolution = volume.GetResolution();
+	VoxelGrid grid;
+	grid.Initialise(mWorldToVoxelGrid, iResolution);
+
+	OccupancyPyramid pyramid;
+	bool bPyramid = pyramid.Initialise(iResolution) && pyramid.Build(volume);
+
+	XMFLOAT3 vForward = Normalise(XMFLOAT3(vLookAt.x - vCameraPosition.x, vLookAt.y - vCameraPosition.y, vLookAt.z - vCameraPosition.z));
+	XMFLOAT3 vRight = Normalise(Cross(XMFLOAT3(0.f, 1.f, 0.f), vForward));
+	XMFLOAT3 vUp = Cross(vForward, vRight);
+	float fTanHalfFov = tanf(fFovY * 0.5f);
+	float fAspect = static_cast<float>(iWidth) / iHeight;
+	XMFLOAT3 vOrigin;
+	grid.WorldToVoxel(vCameraPosition, vOrigin);
+	float fMaxDistance = iResolution * 2.f;
+
+	Parallel::For(iHeight, 0, [&](int y, int)
+	{
+		float fY = (1.f - (y + 0.5f) * 2.f / iHeight) * fTanHalfFov;
+		for (int x = 0; x < iWidth; x++)
+		{
+			float fX = ((x + 0.5f) * 2.f / iWidth - 1.f) * fTanHalfFov * fAspect;
+			XMFLOAT3 vDir = Normalise(XMFLOAT3(vForward.x + vRight.x * fX + vUp.x * fY, vForward.y + vRight.y * fX + vUp.y * fY, vForward.z + vRight.z * fX + vUp.z * fY));
+			float fHit = 0.f;
+			bool bHit = bPyramid ? pyramid.MarchRay(vOrigin, vDir, fMaxDistance, fHit) : OccupancyPyramid::MarchRayDense(volume, vOrigin, vDir, fMaxDistance, fHit);
+			if (!bHit)
+			{
+				continue;
+			}
+
+			//The ray stops where it enters the voxel, so the face it's closest to is the one it came through
+			float vHit[3] = { vOrigin.x + vDir.x * fHit, vOrigin.y + vDir.y * fHit, vOrigin.z + vDir.z * fHit };
+			float vDirection[3] = { vDir.x, vDir.y, vDir.z };
+			int vVoxel[3];
+			int iFaceAxis = 0;
+			float fFaceDistance = FLT_MAX;
+			for (int a = 0; a < 3; a++)
+			{
+				vVoxel[a] = std::max(0, std::min(static_cast<int>(floorf(vHit[a] + vDirection[a] * 0.001f)), iResolution - 1));
+				if (vDirection[a] != 0.f)
+				{
+					float fFace = vDirection[a] > 0.f ? static_cast<float>(vVoxel[a]) : static_cast<float>(vVoxel[a] + 1);
+					if (fabsf(vHit[a] - fFace) < fFaceDistance)
+					{
+						fFaceDistance = fabsf(vHit[a] - fFace);
+						iFaceAxis = a;
+					}
+				}
+			}
+			float vNormal[3] = { 0.f, 0.f, 0.f };
+			vNormal[iFaceAxis] = vDirection[iFaceAxis] > 0.f ? -1.f : 1.f;
+
+			int iPixel = y * iWidth + x;
+			XMFLOAT3 vWorld;
+			grid.VoxelToWorld(XMFLOAT3(vHit[0], vHit[1], vHit[2]), vWorld);
+			XMFLOAT4 vAlbedo = UnpackRGBA8(volume.GetVoxel(vVoxel[0], vVoxel[1], vVoxel[2]));
+			gBuffer.arrWorldPos[iPixel] = XMFLOAT4(vWorld.x, vWorld.y, vWorld.z, 1.f);
+			gBuffer.arrDiffuse[iPixel] = XMFLOAT4(vAlbedo.x, vAlbedo.y, vAlbedo.z, 0.f);
+			gBuffer.arrNormals[iPixel] = XMFLOAT4(vNormal[0], vNormal[1], vNormal[2], fRoughness);
+		}
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int CPUConeTracer::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	int iFailures = 0;
+
+	const int iResolutions[] = { 8, 32, 64 };
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iRes = iResolutions[r];
+		CPUVoxelVolume volume;
+		volume.Initialise(iRes, std::min(4, r + 2));
+		FillRandomVolume(volume, rng);
+		//World space is voxel space
+		float fGridSize;
+		XMMATRIX mWorldToVoxelGrid = VoxelGrid::CreateWorldToVoxelGrid(XMFLOAT3(0.f, 0.f, 0.f), XMFLOAT3(static_cast<float>(iRes), static_cast<float>(iRes), static_cast<float>(iRes)), fGridSize);
+
+		//Batches of random cones against marching them one at a time
+		for (int iLevel = simdScalar; iLevel < simdMax; iLevel++)
+		{
+			CPUConeTracer tracer;
+			tracer.Initialise(mWorldToVoxelGrid, &volume, 1);
+			tracer.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+			if (tracer.m_eSIMDLevel != iLevel)
+			{
+				continue;
+			}
+			for (int b = 0; b < 64; b++)
+			{
+				ConeBatch batch;
+				batch.iNumCones = 1 + b % kMaxCones;
+				batch.vOrigin = XMFLOAT3(unit(rng) * iRes, unit(rng) * iRes, unit(rng) * iRes);
+				for (int c = 0; c < batch.iNumCones; c++)
+				{
+					XMFLOAT3 vDir = RandomDirection(rng);
+					batch.vDirection[0][c] = vDir.x;
+					batch.vDirection[1][c] = vDir.y;
+					batch.vDirection[2][c] = vDir.z;
+					batch.fTanHalfAngle[c] = 0.02f + unit(rng);
+				}
+				long long iNumSteps = 0;
+				tracer.TraceBatch(batch, iNumSteps);
+				for (int c = 0; c < batch.iNumCones; c++)
+				{
+					XMFLOAT3 vDir(batch.vDirection[0][c], batch.vDirection[1][c], batch.vDirection[2][c]);
+					XMFLOAT4 vExpected = OccupancyPyramid::MarchCone(volume, nullptr, batch.vOrigin, vDir, batch.fTanHalfAngle[c], static_cast<float>(iRes));
+					XMFLOAT4 vResult(batch.vResult[0][c], batch.vResult[1][c], batch.vResult[2][c], batch.vResult[3][c]);
+					if (memcmp(&vExpected, &vResult, sizeof(XMFLOAT4)) != 0)
+					{
+						iFailures++;
+					}
+				}
+			}
+		}
+
+		//Random G-buffers in every mode, at every level and thread count against the scalar image
+		GBuffer gBuffer;
+		gBuffer.Resize(kTileSize * 2 + 5, kTileSize + 3);
+		for (size_t i = 0; i < gBuffer.arrNormals.size(); i++)
+		{
+			if (i % 7 == 0)
+			{
+				continue;
+			}
+			gBuffer.arrWorldPos[i] = XMFLOAT4(unit(rng) * iRes, unit(rng) * iRes, unit(rng) * iRes, 1.f);
+			gBuffer.arrDiffuse[i] = XMFLOAT4(unit(rng), unit(rng), unit(rng), unit(rng));
+			XMFLOAT3 vNormal = RandomDirection(rng);
+			gBuffer.arrNormals[i] = XMFLOAT4(vNormal.x, vNormal.y, vNormal.z, unit(rng));
+		}
+		XMFLOAT3 vCamera(unit(rng) * iRes, unit(rng) * iRes, unit(rng) * iRes);
+		for (int m = giNone; m < giMax; m++)
+		{
+			std::vector<XMFLOAT3> arrScalar, arrImage;
+			for (int iLevel = simdScalar; iLevel < simdMax; iLevel++)
+			{
+				CPUConeTracer tracer;
+				tracer.Initialise(mWorldToVoxelGrid, &volume);
+				tracer.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+				if (tracer.m_eSIMDLevel != iLevel)
+				{
+					continue;
+				}
+				for (int iThreads = 1; iThreads <= 3; iThreads += 2)
+				{
+					tracer.SetNumThreads(iThreads);
+					std::vector<XMFLOAT3>& arrOut = arrScalar.empty() ? arrScalar : arrImage;
+					tracer.Render(gBuffer, vCamera, static_cast<GIRenderFlag>(m), arrOut);
+					if (&arrOut == &arrImage && memcmp(arrScalar.data(), arrImage.data(), arrImage.size() * sizeof(XMFLOAT3)) != 0)
+					{
+						iFailures++;
+					}
+				}
+			}
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Cone tracer validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUConeTracer::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser, int iMipLevels)
+{
+	const int iResolutions[] = { 128, 256 };
+	const int iNumRuns = 2;
+	const int iWidth = 256;
+	const int iHeight = 144;
+	const GIRenderFlag modes[] = { giFull, giDiff, giSpec, giAO };
+
+	std::stringstream ss;
+	ss << "../Results/ConeTracer_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open cone tracer benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Mode, Method, Threads, Pixels, Cones, Steps/Cone, ms, Cones/s, Matches Scalar\n";
+
+	std::stringstream summary;
+	bool bAllMatch = true;
+	XMMATRIX mWorldToVoxelGrid = pVoxeliser->GetWorldToVoxelGrid();
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolution, iMipLevels))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&volume);
+		volume.GenerateMips();
+
+		//Camera low down in the middle of whatever got voxelised, looking along its longer horizontal side
+		int vMin[3] = { iResolution, iResolution, iResolution }, vMax[3] = { -1, -1, -1 };
+		for (int z = 0; z < iResolution; z++)
+		{
+			for (int y = 0; y < iResolution; y++)
+			{
+				for (int x = 0; x < iResolution; x++)
+				{
+					if (volume.GetVoxel(x, y, z) != 0)
+					{
+						int v[3] = { x, y, z };
+						for (int a = 0; a < 3; a++)
+						{
+							vMin[a] = std::min(vMin[a], v[a]);
+							vMax[a] = std::max(vMax[a], v[a]);
+						}
+					}
+				}
+			}
+		}
+		if (vMax[0] < 0)
+		{
+			continue;
+		}
+		VoxelGrid grid;
+		grid.Initialise(mWorldToVoxelGrid, iResolution);
+		XMFLOAT3 vCameraVoxel((vMin[0] + vMax[0] + 1) * 0.5f, vMin[1] + (vMax[1] + 1 - vMin[1]) * 0.3f, (vMin[2] + vMax[2] + 1) * 0.5f);
+		bool bAlongX = vMax[0] - vMin[0] >= vMax[2] - vMin[2];
+		XMFLOAT3 vLookAtVoxel(vCameraVoxel.x + (bAlongX ? 1.f : 0.f), vCameraVoxel.y - 0.1f, vCameraVoxel.z + (bAlongX ? 0.f : 1.f));
+		XMFLOAT3 vCamera, vLookAt;
+		grid.VoxelToWorld(vCameraVoxel, vCamera);
+		grid.VoxelToWorld(vLookAtVoxel, vLookAt);
+
+		GBuffer gBuffer;
+		BuildGBuffer(volume, mWorldToVoxelGrid, vCamera, vLookAt, XM_PIDIV2 * 0.75f, 0.3f, iWidth, iHeight, gBuffer);
+
+		CPUConeTracer tracer;
+		if (!tracer.Initialise(mWorldToVoxelGrid, &volume))
+		{
+			continue;
+		}
+		for (int m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+		{
+			std::vector<XMFLOAT3> arrScalar, arrImage;
+			for (int iLevel = simdScalar; iLevel < simdMax; iLevel++)
+			{
+				tracer.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+				if (tracer.m_eSIMDLevel != iLevel)
+				{
+					continue;
+				}
+				const int iThreadCounts[] = { 1, Parallel::GetNumWorkerThreads() };
+				for (int t = 0; t < 2; t++)
+				{
+					tracer.SetNumThreads(iThreadCounts[t]);
+					Stats best = tracer.m_Stats;
+					best.dTimeMs = DBL_MAX;
+					for (int i = 0; i < iNumRuns; i++)
+					{
+						tracer.Render(gBuffer, vCamera, modes[m], arrImage);
+						if (tracer.m_Stats.dTimeMs < best.dTimeMs)
+						{
+							best = tracer.m_Stats;
+						}
+					}
+					if (arrScalar.empty())
+					{
+						arrScalar = arrImage;
+					}
+					bool bMatch = memcmp(arrScalar.data(), arrImage.data(), arrImage.size() * sizeof(XMFLOAT3)) == 0;
+					bAllMatch &= bMatch;
+					double dConesPerSecond = best.iNumCones / (best.dTimeMs * 0.001);
+					outfile << iResolution << "," << GetModeName(modes[m]) << "," << TriangleBoxOverlap::GetLevelName(static_cast<SIMDLevel>(iLevel)) << ","
+						<< iThreadCounts[t] << "," << best.iNumPixels << "," << best.iNumCones << "," << static_cast<double>(best.iNumSteps) / std::max(1LL, best.iNumCones) << ","
+						<< best.dTimeMs << "," << dConesPerSecond << "," << (bMatch ? "Yes" : "No") << "\n";
+
+					VS_LOG(sName << " " << iResolution << "^3 " << GetModeName(modes[m]) << " " << TriangleBoxOverlap::GetLevelName(static_cast<SIMDLevel>(iLevel))
+						<< " " << iThreadCounts[t] << " threads: " << best.dTimeMs << "ms, " << dConesPerSecond / 1000000.0 << "M cones/s");
+				}
+			}
+
+			std::stringstream image;
+			image << "../Results/ConeTracer_" << sName << "_" << iResolution << "_" << GetModeName(modes[m]);
+			WritePPM((image.str() + ".ppm").c_str(), iWidth, iHeight, arrScalar);
+			WritePFM((image.str() + ".pfm").c_str(), iWidth, iHeight, arrScalar);
+		}
+		summary << "\n" << iResolution << " Image:," << iWidth << "x" << iHeight;
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	if (!bAllMatch)
+	{
+		VS_LOG_VERBOSE("Cone tracer SIMD levels gave different images");
+	}
+	return bAllMatch && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
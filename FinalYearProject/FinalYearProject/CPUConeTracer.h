@@ -0,0 +1,125 @@
+#ifndef CPU_CONE_TRACER_H
+#define CPU_CONE_TRACER_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+#include "GIRenderFlag.h"
+#include "TriangleBoxOverlap.h"
+#include "VoxelGrid.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//The indirect part of the lighting pass on the CPU, cone tracing a voxel volume and its mips from a G-buffer, for
+//checking the GPU output and baking GI offline. Each pixel traces six 60 degree diffuse cones around the normal (one
+//straight up weighted 0.25, five tilted 60 degrees off it weighted 0.15 each) and one specular cone along the
+//reflected view vector that gets wider with roughness. Every cone marches the same way as OccupancyPyramid::MarchCone.
+//The image is worked through in kTileSize^2 tiles handed out to the threads. The SSE and AVX2 versions put the cones
+//of a pixel in the lanes and do the trilinear filtering for all of them at once, giving exactly the same result as
+//marching the cones one at a time.
+class CPUConeTracer
+{
+public:
+
+	static const int kTileSize = 16;
+	static const int kNumDiffuseCones = 6;
+	static const int kMaxCones = 8;		//the diffuse cones and the specular one, a lane each
+
+	//The deferred pass's render targets - world position, albedo with metallic in w, and normal with roughness in w,
+	//like btWorldPos, btDiffuse and btNormals. A pixel with a zero normal is background and gets no GI.
+	struct GBuffer
+	{
+		int iWidth;
+		int iHeight;
+		std::vector<XMFLOAT4> arrWorldPos;
+		std::vector<XMFLOAT4> arrDiffuse;
+		std::vector<XMFLOAT4> arrNormals;
+
+		void Resize(int iNewWidth, int iNewHeight);
+	};
+
+	struct Stats
+	{
+		SIMDLevel eSIMDLevel;
+		int iNumThreads;
+		GIRenderFlag eMode;
+		double dTimeMs;
+		long long iNumPixels;		//with something in them
+		long long iNumCones;
+		long long iNumSteps;		//cone steps, each one a SampleLevel
+	};
+
+	CPUConeTracer();
+	~CPUConeTracer();
+
+	//mWorldToVoxelGrid is the transposed one VoxelisedScene hands the shaders. The volume has to stay alive while the
+	//tracer uses it. iNumThreads <= 0 uses every core.
+	bool Initialise(const XMMATRIX& mWorldToVoxelGrid, const CPUVoxelVolume* pVolume, int iNumThreads = 0);
+
+	void SetNumThreads(int iNumThreads) { m_iNumThreads = iNumThreads; }
+	//Clamped to what the CPU supports. Defaults to the best supported level.
+	void SetSIMDLevel(SIMDLevel eLevel);
+	//In voxels, defaults to the resolution
+	void SetMaxDistance(float fMaxDistance) { m_fMaxDistance = fMaxDistance; }
+
+	//The GI the lighting pass would add for the mode, linear RGB a pixel. giDiff is albedo * diffuse cones, giSpec the
+	//specular cone, giFull both of them and giAO 1 - the diffuse cones' opacity. giNone is black.
+	bool Render(const GBuffer& gBuffer, const XMFLOAT3& vCameraPosition, GIRenderFlag eMode, std::vector<XMFLOAT3>& arrImage);
+
+	const Stats& GetStats() const { return m_Stats; }
+	static const char* GetModeName(GIRenderFlag eMode);
+
+	//Binary PPM with the colours clamped to [0, 1], and PFM with the floats as they are
+	static bool WritePPM(const char* sFilename, int iWidth, int iHeight, const std::vector<XMFLOAT3>& arrImage);
+	static bool WritePFM(const char* sFilename, int iWidth, int iHeight, const std::vector<XMFLOAT3>& arrImage);
+
+	//Stand in for the G-buffer pass when there's no GPU: casts a ray per pixel into mip 0 of the volume from a
+	//perspective camera, giving each hit the face normal it went in through, the voxel's colour as albedo, no
+	//metallic and fRoughness
+	static void BuildGBuffer(const CPUVoxelVolume& volume, const XMMATRIX& mWorldToVoxelGrid, const XMFLOAT3& vCameraPosition, const XMFLOAT3& vLookAt,
+		float fFovY, float fRoughness, int iWidth, int iHeight, GBuffer& gBuffer);
+
+	//Random volumes and cones through every SIMD level against OccupancyPyramid::MarchCone, and whole images against
+	//the scalar ones. Returns the number of mismatches.
+	static int Validate(unsigned int iSeed);
+
+	//Renders the voxeliser's triangles at 128^3 and 256^3 in each mode at each SIMD level on one thread and every
+	//thread, writing the times and cones a second to ../Results/ along with the images
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser, int iMipLevels);
+
+private:
+
+	//Up to kMaxCones cones from one origin, in voxel space
+	struct ConeBatch
+	{
+		int iNumCones;
+		XMFLOAT3 vOrigin;
+		float vDirection[3][kMaxCones];
+		float fTanHalfAngle[kMaxCones];
+		float vResult[4][kMaxCones];
+	};
+
+	void TraceBatch(ConeBatch& batch, long long& iNumSteps) const;
+	XMFLOAT3 ShadePixel(const GBuffer& gBuffer, int iPixel, const XMFLOAT3& vCameraPosition, GIRenderFlag eMode, long long& iNumCones, long long& iNumSteps) const;
+
+	const CPUVoxelVolume* m_pVolume;
+	VoxelGrid m_VoxelGrid;
+	float m_fMaxDistance;
+	int m_iNumThreads;
+	SIMDLevel m_eSIMDLevel;
+
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !CPU_CONE_TRACER_H
@@ -0,0 +1,722 @@
+#include "NoFloatContraction.h"
+#include "CPURadianceInjector.h"
+#include "CPUVoxeliser.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define INJECTOR_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define INJECTOR_X86_SIMD 0
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int CPURadianceInjector::kBrickSize;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Everything a brick row kernel needs about the lights reaching the brick
+	struct RowLights
+	{
+		const float* pX;
+		const float* pY;
+		const float* pZ;
+		const float* pRecipRange;
+		const float* pR;
+		const float* pG;
+		const float* pB;
+		const int* pIndices;
+		int iCount;
+		float vBase[3];		//ambient + directional
+	};
+
+	inline uint32_t LightTexel(uint32_t iAlbedo, float r, float g, float b)
+	{
+		XMFLOAT4 vAlbedo = UnpackRGBA8(iAlbedo);
+		return PackRGBA8(XMFLOAT4(vAlbedo.x * r, vAlbedo.y * g, vAlbedo.z * b, vAlbedo.w));
+	}
+
+	//kBrickSize voxels along x at (pCentreX[i], fY, fZ). Returns how many were occupied.
+	int InjectRowScalar(const uint32_t* pAlbedo, uint32_t* pRadiance, const float* pCentreX, float fY, float fZ, const RowLights& lights)
+	{
+		int iNumLit = 0;
+		for (int i = 0; i < CPURadianceInjector::kBrickSize; i++)
+		{
+			uint32_t iAlbedo = pAlbedo[i];
+			if (iAlbedo == 0)
+			{
+				pRadiance[i] = 0;
+				continue;
+			}
+			float r = lights.vBase[0], g = lights.vBase[1], b = lights.vBase[2];
+			for (int j = 0; j < lights.iCount; j++)
+			{
+				int l = lights.pIndices[j];
+				float dx = pCentreX[i] - lights.pX[l];
+				float dy = fY - lights.pY[l];
+				float dz = fZ - lights.pZ[l];
+				float fDistance = sqrtf(dx * dx + dy * dy + dz * dz);
+				float fAttenuation = 1.f - fDistance * lights.pRecipRange[l];
+				fAttenuation = fAttenuation > 0.f ? fAttenuation : 0.f;
+				r += lights.pR[l] * fAttenuation;
+				g += lights.pG[l] * fAttenuation;
+				b += lights.pB[l] * fAttenuation;
+			}
+			pRadiance[i] = LightTexel(iAlbedo, r, g, b);
+			iNumLit++;
+		}
+		return iNumLit;
+	}
+
+#if INJECTOR_X86_SIMD
+	inline int CountBits(int iMask)
+	{
+		int iCount = 0;
+		for (; iMask != 0; iMask &= iMask - 1)
+		{
+			iCount++;
+		}
+		return iCount;
+	}
+
+	//Same sums as the scalar version, one voxel a lane, so every lane comes out bit for bit the same
+	int InjectRowSSE(const uint32_t* pAlbedo, uint32_t* pRadiance, const float* pCentreX, float fY, float fZ, const RowLights& lights)
+	{
+		const __m128i vZero = _mm_setzero_si128();
+		const __m128i vByteMask = _mm_set1_epi32(0xff);
+		const __m128 vRecip255 = _mm_set1_ps(1.f / 255.f);
+		const __m128 v255 = _mm_set1_ps(255.f);
+		const __m128 vHalf = _mm_set1_ps(0.5f);
+		const __m128 vOne = _mm_set1_ps(1.f);
+		const __m128 vZeroF = _mm_setzero_ps();
+
+		int iNumLit = 0;
+		for (int i = 0; i < CPURadianceInjector::kBrickSize; i += 4)
+		{
+			__m128i vAlbedo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pAlbedo + i));
+			__m128i vEmpty = _mm_cmpeq_epi32(vAlbedo, vZero);
+			int iEmptyMask = _mm_movemask_ps(_mm_castsi128_ps(vEmpty));
+			if (iEmptyMask == 0xf)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pRadiance + i), vZero);
+				continue;
+			}
+			iNumLit += 4 - CountBits(iEmptyMask);
+
+			__m128 vX = _mm_loadu_ps(pCentreX + i);
+			__m128 r = _mm_set1_ps(lights.vBase[0]), g = _mm_set1_ps(lights.vBase[1]), b = _mm_set1_ps(lights.vBase[2]);
+			for (int j = 0; j < lights.iCount; j++)
+			{
+				int l = lights.pIndices[j];
+				__m128 dx = _mm_sub_ps(vX, _mm_set1_ps(lights.pX[l]));
+				__m128 dy = _mm_set1_ps(fY - lights.pY[l]);
+				__m128 dz = _mm_set1_ps(fZ - lights.pZ[l]);
+				__m128 vDistance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+				__m128 vAttenuation = _mm_sub_ps(vOne, _mm_mul_ps(vDistance, _mm_set1_ps(lights.pRecipRange[l])));
+				vAttenuation = _mm_max_ps(vAttenuation, vZeroF);
+				r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(lights.pR[l]), vAttenuation));
+				g = _mm_add_ps(g, _mm_mul_ps(_mm_set1_ps(lights.pG[l]), vAttenuation));
+				b = _mm_add_ps(b, _mm_mul_ps(_mm_set1_ps(lights.pB[l]), vAttenuation));
+			}
+
+			//Unpack, light and pack again exactly like UnpackRGBA8 and PackRGBA8
+			__m128 vLight[4] = { r, g, b, vOne };
+			__m128i vResult = vZero;
+			for (int c = 0; c < 4; c++)
+			{
+				__m128 vChannel = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(vAlbedo, c * 8), vByteMask)), vRecip255);
+				if (c < 3)
+				{
+					vChannel = _mm_mul_ps(vChannel, vLight[c]);
+				}
+				vChannel = _mm_min_ps(_mm_max_ps(vChannel, vZeroF), vOne);
+				__m128i vByte = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(vChannel, v255), vHalf));
+				vResult = _mm_or_si128(vResult, _mm_slli_epi32(vByte, c * 8));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pRadiance + i), _mm_andnot_si128(vEmpty, vResult));
+		}
+		return iNumLit;
+	}
+
+	TARGET_AVX2 int InjectRowAVX2(const uint32_t* pAlbedo, uint32_t* pRadiance, const float* pCentreX, float fY, float fZ, const RowLights& lights)
+	{
+		const __m256i vZero = _mm256_setzero_si256();
+		const __m256i vByteMask = _mm256_set1_epi32(0xff);
+		const __m256 vRecip255 = _mm256_set1_ps(1.f / 255.f);
+		const __m256 v255 = _mm256_set1_ps(255.f);
+		const __m256 vHalf = _mm256_set1_ps(0.5f);
+		const __m256 vOne = _mm256_set1_ps(1.f);
+		const __m256 vZeroF = _mm256_setzero_ps();
+
+		//kBrickSize is 8, one register a row
+		__m256i vAlbedo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pAlbedo));
+		__m256i vEmpty = _mm256_cmpeq_epi32(vAlbedo, vZero);
+		int iEmptyMask = _mm256_movemask_ps(_mm256_castsi256_ps(vEmpty));
+		if (iEmptyMask == 0xff)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pRadiance), vZero);
+			return 0;
+		}
+
+		__m256 vX = _mm256_loadu_ps(pCentreX);
+		__m256 r = _mm256_set1_ps(lights.vBase[0]), g = _mm256_set1_ps(lights.vBase[1]), b = _mm256_set1_ps(lights.vBase[2]);
+		for (int j = 0; j < lights.iCount; j++)
+		{
+			int l = lights.pIndices[j];
+			__m256 dx = _mm256_sub_ps(vX, _mm256_set1_ps(lights.pX[l]));
+			__m256 dy = _mm256_set1_ps(fY - lights.pY[l]);
+			__m256 dz = _mm256_set1_ps(fZ - lights.pZ[l]);
+			__m256 vDistance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+			__m256 vAttenuation = _mm256_sub_ps(vOne, _mm256_mul_ps(vDistance, _mm256_set1_ps(lights.pRecipRange[l])));
+			vAttenuation = _mm256_max_ps(vAttenuation, vZeroF);
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(lights.pR[l]), vAttenuation));
+			g = _mm256_add_ps(g, _mm256_mul_ps(_mm256_set1_ps(lights.pG[l]), vAttenuation));
+			b = _mm256_add_ps(b, _mm256_mul_ps(_mm256_set1_ps(lights.pB[l]), vAttenuation));
+		}
+
+		__m256 vLight[4] = { r, g, b, vOne };
+		__m256i vResult = vZero;
+		for (int c = 0; c < 4; c++)
+		{
+			__m256 vChannel = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(vAlbedo, c * 8), vByteMask)), vRecip255);
+			if (c < 3)
+			{
+				vChannel = _mm256_mul_ps(vChannel, vLight[c]);
+			}
+			vChannel = _mm256_min_ps(_mm256_max_ps(vChannel, vZeroF), vOne);
+			__m256i vByte = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(vChannel, v255), vHalf));
+			vResult = _mm256_or_si256(vResult, _mm256_slli_epi32(vByte, c * 8));
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pRadiance), _mm256_andnot_si256(vEmpty, vResult));
+		return 8 - CountBits(iEmptyMask);
+	}
+#endif
+
+	//Random albedo with plenty of empty voxels, some rows left completely empty
+	void FillRandomAlbedo(CPUVoxelVolume& volume, std::mt19937& rng)
+	{
+		volume.Clear();
+		int iRes = volume.GetResolution();
+		std::uniform_int_distribution<uint32_t> colour(1, 0xffffffff);
+		std::uniform_real_distribution<float> chance(0.f, 1.f);
+		for (int z = 0; z < iRes; z++)
+		{
+			for (int y = 0; y < iRes; y++)
+			{
+				float fDensity = chance(rng) < 0.3f ? 0.f : chance(rng);
+				for (int x = 0; x < iRes; x++)
+				{
+					if (chance(rng) < fDensity)
+					{
+						volume.SetVoxel(x, y, z, colour(rng));
+					}
+				}
+			}
+		}
+	}
+
+	//Point lights scattered around the grid's cube, ranges a fraction of its size
+	void AddRandomLights(CPURadianceInjector& injector, std::mt19937& rng, int iNumLights, const XMFLOAT3& vMin, const XMFLOAT3& vMax, float fMinRange, float fMaxRange)
+	{
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		std::uniform_real_distribution<float> range(fMinRange, fMaxRange);
+		for (int i = 0; i < iNumLights; i++)
+		{
+			XMFLOAT3 vPosition(vMin.x + (vMax.x - vMin.x) * unit(rng), vMin.y + (vMax.y - vMin.y) * unit(rng), vMin.z + (vMax.z - vMin.z) * unit(rng));
+			XMFLOAT4 vColour(unit(rng) * 2.f, unit(rng) * 2.f, unit(rng) * 2.f, 1.f);
+			injector.AddPointLight(vPosition, vColour, 1.f / range(rng));
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPURadianceInjector::CPURadianceInjector()
+	: m_iResolution(0),
+	m_iNumThreads(0),
+	m_eSIMDLevel(simdScalar),
+	m_vAmbientColour(0.f, 0.f, 0.f, 0.f),
+	m_vDirectionalColour(0.f, 0.f, 0.f, 0.f)
+{
+	SetSIMDLevel(simdMax);
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPURadianceInjector::~CPURadianceInjector()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPURadianceInjector::Initialise(const XMMATRIX& mWorldToVoxelGrid, int iResolution, int iNumThreads)
+{
+	if (iResolution < kBrickSize || iResolution % kBrickSize != 0)
+	{
+		VS_LOG_VERBOSE("Radiance injector resolution has to be a multiple of the brick size");
+		return false;
+	}
+	m_iResolution = iResolution;
+	m_iNumThreads = iNumThreads;
+	m_VoxelGrid.Initialise(mWorldToVoxelGrid, iResolution);
+
+	//The grid is axis aligned so each axis of a voxel centre only depends on that axis of the voxel
+	m_arrCentreX.resize(iResolution);
+	m_arrCentreY.resize(iResolution);
+	m_arrCentreZ.resize(iResolution);
+	for (int i = 0; i < iResolution; i++)
+	{
+		float fCentre = i + 0.5f;
+		XMFLOAT3 vWorld;
+		m_VoxelGrid.VoxelToWorld(XMFLOAT3(fCentre, fCentre, fCentre), vWorld);
+		m_arrCentreX[i] = vWorld.x;
+		m_arrCentreY[i] = vWorld.y;
+		m_arrCentreZ[i] = vWorld.z;
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPURadianceInjector::SetSIMDLevel(SIMDLevel eLevel)
+{
+#if INJECTOR_X86_SIMD
+	m_eSIMDLevel = std::min(eLevel, TriangleBoxOverlap::GetSupportedLevel());
+#else
+	m_eSIMDLevel = simdScalar;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPURadianceInjector::ClearPointLights()
+{
+	m_arrLightX.clear();
+	m_arrLightY.clear();
+	m_arrLightZ.clear();
+	m_arrLightRecipRange.clear();
+	m_arrLightR.clear();
+	m_arrLightG.clear();
+	m_arrLightB.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPURadianceInjector::AddPointLight(const XMFLOAT3& vPosition, const XMFLOAT4& vColour, float fRecipRange)
+{
+	m_arrLightX.push_back(vPosition.x);
+	m_arrLightY.push_back(vPosition.y);
+	m_arrLightZ.push_back(vPosition.z);
+	m_arrLightRecipRange.push_back(fRecipRange);
+	m_arrLightR.push_back(vColour.x);
+	m_arrLightG.push_back(vColour.y);
+	m_arrLightB.push_back(vColour.z);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPURadianceInjector::Inject(const CPUVoxelVolume& albedo, CPUVoxelVolume& radiance)
+{
+	const int vMin[3] = { 0, 0, 0 };
+	const int vMax[3] = { m_iResolution, m_iResolution, m_iResolution };
+	return InjectBox(albedo, radiance, vMin, vMax);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPURadianceInjector::InjectBox(const CPUVoxelVolume& albedo, CPUVoxelVolume& radiance, const int vMin[3], const int vMax[3])
+{
+	if (albedo.GetResolution() != m_iResolution || radiance.GetResolution() != m_iResolution)
+	{
+		VS_LOG_VERBOSE("Radiance injector and voxel volume resolutions don't match");
+		return false;
+	}
+	int vBrickMin[3], vBricks[3];
+	for (int i = 0; i < 3; i++)
+	{
+		if (vMin[i] < 0 || vMax[i] > m_iResolution || vMin[i] >= vMax[i] || vMin[i] % kBrickSize != 0 || vMax[i] % kBrickSize != 0)
+		{
+			VS_LOG_VERBOSE("Radiance injector box has to be inside the volume and on brick boundaries");
+			return false;
+		}
+		vBrickMin[i] = vMin[i] / kBrickSize;
+		vBricks[i] = (vMax[i] - vMin[i]) / kBrickSize;
+	}
+
+	int iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+	int iNumBricks = vBricks[0] * vBricks[1] * vBricks[2];
+
+	std::vector<std::vector<int>> arrBrickLights(iNumThreads);
+	std::vector<long long> arrVoxelsLit(iNumThreads, 0);
+	std::vector<long long> arrLightEvaluations(iNumThreads, 0);
+	std::vector<int> arrOccupiedBricks(iNumThreads, 0);
+	for (int t = 0; t < iNumThreads; t++)
+	{
+		arrBrickLights[t].reserve(m_arrLightX.size());
+	}
+
+	const uint32_t* pAlbedo = albedo.GetMipData(0);
+	uint32_t* pRadiance = radiance.GetMipData(0);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	Parallel::For(iNumBricks, iNumThreads, [&](int iBrick, int iThread)
+	{
+		int bx = vBrickMin[0] + iBrick % vBricks[0];
+		int by = vBrickMin[1] + (iBrick / vBricks[0]) % vBricks[1];
+		int bz = vBrickMin[2] + iBrick / (vBricks[0] * vBricks[1]);
+		long long iNumLit = InjectBrick(bx, by, bz, pAlbedo, pRadiance, arrBrickLights[iThread], arrLightEvaluations[iThread]);
+		arrVoxelsLit[iThread] += iNumLit;
+		arrOccupiedBricks[iThread] += iNumLit > 0 ? 1 : 0;
+	});
+
+	m_Stats.eSIMDLevel = m_eSIMDLevel;
+	m_Stats.iNumThreads = iNumThreads;
+	m_Stats.iNumPointLights = GetNumPointLights();
+	m_Stats.dTimeMs = GetElapsedMs(start);
+	m_Stats.iNumBricks = iNumBricks;
+	m_Stats.iNumVoxelsLit = 0;
+	m_Stats.iNumLightEvaluations = 0;
+	m_Stats.iNumOccupiedBricks = 0;
+	for (int t = 0; t < iNumThreads; t++)
+	{
+		m_Stats.iNumVoxelsLit += arrVoxelsLit[t];
+		m_Stats.iNumLightEvaluations += arrLightEvaluations[t];
+		m_Stats.iNumOccupiedBricks += arrOccupiedBricks[t];
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long CPURadianceInjector::InjectBrick(int bx, int by, int bz, const uint32_t* pAlbedo, uint32_t* pRadiance, std::vector<int>& arrBrickLights, long long& iNumLightEvaluations) const
+{
+	int x0 = bx * kBrickSize, y0 = by * kBrickSize, z0 = bz * kBrickSize;
+
+	//Lights that reach any voxel centre in the brick. The ones left out would only ever add zero, so this doesn't
+	//change the result, the margin just keeps rounding in the distance from dropping a light that touches an edge.
+	float vBoxMin[3] = { std::min(m_arrCentreX[x0], m_arrCentreX[x0 + kBrickSize - 1]), std::min(m_arrCentreY[y0], m_arrCentreY[y0 + kBrickSize - 1]), std::min(m_arrCentreZ[z0], m_arrCentreZ[z0 + kBrickSize - 1]) };
+	float vBoxMax[3] = { std::max(m_arrCentreX[x0], m_arrCentreX[x0 + kBrickSize - 1]), std::max(m_arrCentreY[y0], m_arrCentreY[y0 + kBrickSize - 1]), std::max(m_arrCentreZ[z0], m_arrCentreZ[z0 + kBrickSize - 1]) };
+	arrBrickLights.clear();
+	for (int l = 0; l < m_arrLightX.size(); l++)
+	{
+		float fRecipRange = m_arrLightRecipRange[l];
+		if (fRecipRange > 0.f)
+		{
+			float vLight[3] = { m_arrLightX[l], m_arrLightY[l], m_arrLightZ[l] };
+			float fDistanceSq = 0.f;
+			for (int i = 0; i < 3; i++)
+			{
+				float d = std::max(std::max(vBoxMin[i] - vLight[i], 0.f), vLight[i] - vBoxMax[i]);
+				fDistanceSq += d * d;
+			}
+			if (fDistanceSq * fRecipRange * fRecipRange > 1.001f)
+			{
+				continue;
+			}
+		}
+		arrBrickLights.push_back(l);
+	}
+
+	RowLights lights;
+	lights.pX = m_arrLightX.data();
+	lights.pY = m_arrLightY.data();
+	lights.pZ = m_arrLightZ.data();
+	lights.pRecipRange = m_arrLightRecipRange.data();
+	lights.pR = m_arrLightR.data();
+	lights.pG = m_arrLightG.data();
+	lights.pB = m_arrLightB.data();
+	lights.pIndices = arrBrickLights.data();
+	lights.iCount = static_cast<int>(arrBrickLights.size());
+	lights.vBase[0] = m_vAmbientColour.x + m_vDirectionalColour.x;
+	lights.vBase[1] = m_vAmbientColour.y + m_vDirectionalColour.y;
+	lights.vBase[2] = m_vAmbientColour.z + m_vDirectionalColour.z;
+
+	long long iNumLit = 0;
+	const float* pCentreX = &m_arrCentreX[x0];
+	for (int z = z0; z < z0 + kBrickSize; z++)
+	{
+		for (int y = y0; y < y0 + kBrickSize; y++)
+		{
+			size_t iRow = (static_cast<size_t>(z) * m_iResolution + y) * m_iResolution + x0;
+			switch (m_eSIMDLevel)
+			{
+#if INJECTOR_X86_SIMD
+			case simdAVX2:
+				iNumLit += InjectRowAVX2(pAlbedo + iRow, pRadiance + iRow, pCentreX, m_arrCentreY[y], m_arrCentreZ[z], lights);
+				break;
+			case simdSSE:
+				iNumLit += InjectRowSSE(pAlbedo + iRow, pRadiance + iRow, pCentreX, m_arrCentreY[y], m_arrCentreZ[z], lights);
+				break;
+#endif
+			default:
+				iNumLit += InjectRowScalar(pAlbedo + iRow, pRadiance + iRow, pCentreX, m_arrCentreY[y], m_arrCentreZ[z], lights);
+				break;
+			}
+		}
+	}
+	iNumLightEvaluations += iNumLit * lights.iCount;
+	return iNumLit;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPURadianceInjector::CompareResult CPURadianceInjector::Compare(const CPUVoxelVolume& a, const CPUVoxelVolume& b, int iMipLevel, int iTolerance)
+{
+	CompareResult result;
+	result.iNumTexels = 0;
+	result.iNumMismatches = 0;
+	result.iMaxChannelDifference = 0;
+	if (a.GetResolution() != b.GetResolution() || iMipLevel >= a.GetMipLevels() || iMipLevel >= b.GetMipLevels())
+	{
+		result.iNumMismatches = -1;
+		return result;
+	}
+
+	const uint32_t* pA = a.GetMipData(iMipLevel);
+	const uint32_t* pB = b.GetMipData(iMipLevel);
+	result.iNumTexels = static_cast<long long>(a.GetMipSizeInBytes(iMipLevel) / sizeof(uint32_t));
+	for (long long i = 0; i < result.iNumTexels; i++)
+	{
+		if (pA[i] == pB[i])
+		{
+			continue;
+		}
+		int iMaxDifference = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			int iDifference = abs(static_cast<int>((pA[i] >> (c * 8)) & 0xff) - static_cast<int>((pB[i] >> (c * 8)) & 0xff));
+			iMaxDifference = std::max(iMaxDifference, iDifference);
+		}
+		result.iMaxChannelDifference = std::max(result.iMaxChannelDifference, iMaxDifference);
+		result.iNumMismatches += iMaxDifference > iTolerance ? 1 : 0;
+	}
+	return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int CPURadianceInjector::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	const int iResolutions[] = { 8, 16, 32 };
+	const int iLightCounts[] = { 0, 1, 3, 13, 37 };
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iRes = iResolutions[r];
+		std::uniform_real_distribution<float> coord(-500.f, 500.f);
+		XMFLOAT3 vMin(coord(rng), coord(rng), coord(rng));
+		XMFLOAT3 vMax(vMin.x + 50.f + fabsf(coord(rng)), vMin.y + 50.f + fabsf(coord(rng)), vMin.z + 50.f + fabsf(coord(rng)));
+		float fGridSize = 0.f;
+		XMMATRIX mWorldToVoxelGrid = VoxelGrid::CreateWorldToVoxelGrid(vMin, vMax, fGridSize);
+		VoxelGrid grid;
+		grid.Initialise(mWorldToVoxelGrid, iRes);
+
+		CPUVoxelVolume albedo, reference, radiance;
+		albedo.Initialise(iRes, 1);
+		reference.Initialise(iRes, 1);
+		radiance.Initialise(iRes, 1);
+		FillRandomAlbedo(albedo, rng);
+
+		for (int l = 0; l < sizeof(iLightCounts) / sizeof(iLightCounts[0]); l++)
+		{
+			CPURadianceInjector injector;
+			injector.Initialise(mWorldToVoxelGrid, iRes);
+			injector.SetAmbientColour(XMFLOAT4(0.05f, 0.04f, 0.03f, 1.f));
+			injector.SetDirectionalColour(XMFLOAT4(0.3f * l, 0.2f, 0.1f, 0.f));
+			AddRandomLights(injector, rng, iLightCounts[l], vMin, vMax, fGridSize * 0.1f, fGridSize * 1.5f);
+			if (l == 2)
+			{
+				//Infinite range
+				injector.AddPointLight(vMin, XMFLOAT4(0.5f, 0.5f, 0.5f, 1.f), 0.f);
+			}
+
+			//One voxel at a time, every light, positions straight from the grid
+			for (int z = 0; z < iRes; z++)
+			{
+				for (int y = 0; y < iRes; y++)
+				{
+					for (int x = 0; x < iRes; x++)
+					{
+						uint32_t iAlbedo = albedo.GetVoxel(x, y, z);
+						if (iAlbedo == 0)
+						{
+							reference.SetVoxel(x, y, z, 0);
+							continue;
+						}
+						XMFLOAT3 vWorld;
+						grid.VoxelToWorld(XMFLOAT3(x + 0.5f, y + 0.5f, z + 0.5f), vWorld);
+						float vLight[3] = { injector.m_vAmbientColour.x + injector.m_vDirectionalColour.x, injector.m_vAmbientColour.y + injector.m_vDirectionalColour.y,
+							injector.m_vAmbientColour.z + injector.m_vDirectionalColour.z };
+						for (int i = 0; i < injector.GetNumPointLights(); i++)
+						{
+							float dx = vWorld.x - injector.m_arrLightX[i];
+							float dy = vWorld.y - injector.m_arrLightY[i];
+							float dz = vWorld.z - injector.m_arrLightZ[i];
+							float fAttenuation = std::max(1.f - sqrtf(dx * dx + dy * dy + dz * dz) * injector.m_arrLightRecipRange[i], 0.f);
+							vLight[0] += injector.m_arrLightR[i] * fAttenuation;
+							vLight[1] += injector.m_arrLightG[i] * fAttenuation;
+							vLight[2] += injector.m_arrLightB[i] * fAttenuation;
+						}
+						XMFLOAT4 vAlbedo = UnpackRGBA8(iAlbedo);
+						reference.SetVoxel(x, y, z, PackRGBA8(XMFLOAT4(vAlbedo.x * vLight[0], vAlbedo.y * vLight[1], vAlbedo.z * vLight[2], vAlbedo.w)));
+					}
+				}
+			}
+
+			for (int iLevel = simdScalar; iLevel < simdMax; iLevel++)
+			{
+				injector.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+				if (injector.m_eSIMDLevel != iLevel)
+				{
+					continue;
+				}
+				for (int t = 1; t <= 3; t += 2)
+				{
+					injector.SetNumThreads(t);
+					radiance.Clear();
+					injector.Inject(albedo, radiance);
+					iFailures += static_cast<int>(Compare(radiance, reference).iNumMismatches);
+				}
+			}
+
+			//In place, the way the GPU lights the radiance volume
+			CPUVoxelVolume inPlace;
+			inPlace.Initialise(iRes, 1);
+			memcpy(inPlace.GetMipData(0), albedo.GetMipData(0), albedo.GetMipSizeInBytes(0));
+			injector.Inject(inPlace, inPlace);
+			iFailures += static_cast<int>(Compare(inPlace, reference).iNumMismatches);
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Radiance injection kernels disagree with the reference");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPURadianceInjector::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolutions[] = { 128, 256 };
+	const int iLightCounts[] = { 1, 4, 16, 64, 256 };
+	const int iNumRuns = 3;
+
+	std::stringstream ss;
+	ss << "../Results/RadianceInjection_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open radiance injection benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Point Lights, Method, Threads, Voxels Lit, Light Evaluations, ms, ns/Voxel, ns/Light Evaluation, Matches Scalar\n";
+
+	std::stringstream summary;
+	bool bAllMatch = true;
+	std::mt19937 rng(1);
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume albedo, radiance, scalar;
+		if (!albedo.Initialise(iResolution, 1) || !radiance.Initialise(iResolution, 1) || !scalar.Initialise(iResolution, 1))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&albedo);
+
+		CPURadianceInjector injector;
+		if (!injector.Initialise(pVoxeliser->GetWorldToVoxelGrid(), iResolution))
+		{
+			continue;
+		}
+		XMFLOAT3 vMin, vMax;
+		injector.m_VoxelGrid.VoxelToWorld(XMFLOAT3(0.f, 0.f, 0.f), vMin);
+		injector.m_VoxelGrid.VoxelToWorld(XMFLOAT3(static_cast<float>(iResolution), static_cast<float>(iResolution), static_cast<float>(iResolution)), vMax);
+		float fGridSize = vMax.x - vMin.x;
+		injector.SetAmbientColour(XMFLOAT4(0.05f, 0.05f, 0.05f, 1.f));
+		injector.SetDirectionalColour(XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+
+		for (int l = 0; l < sizeof(iLightCounts) / sizeof(iLightCounts[0]); l++)
+		{
+			int iNumLights = iLightCounts[l];
+			injector.ClearPointLights();
+			AddRandomLights(injector, rng, iNumLights, vMin, vMax, fGridSize * 0.1f, fGridSize * 0.3f);
+
+			bool bHaveScalar = false;
+			for (int iLevel = simdScalar; iLevel < simdMax; iLevel++)
+			{
+				injector.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+				if (injector.m_eSIMDLevel != iLevel)
+				{
+					continue;
+				}
+				const int iThreadCounts[] = { 1, Parallel::GetNumWorkerThreads() };
+				for (int t = 0; t < 2; t++)
+				{
+					injector.SetNumThreads(iThreadCounts[t]);
+					double dBestMs = DBL_MAX;
+					for (int i = 0; i < iNumRuns; i++)
+					{
+						injector.Inject(albedo, radiance);
+						dBestMs = std::min(dBestMs, injector.m_Stats.dTimeMs);
+					}
+					if (!bHaveScalar)
+					{
+						memcpy(scalar.GetMipData(0), radiance.GetMipData(0), radiance.GetMipSizeInBytes(0));
+						bHaveScalar = true;
+					}
+					bool bMatch = Compare(radiance, scalar).iNumMismatches == 0;
+					bAllMatch &= bMatch;
+
+					const Stats& stats = injector.m_Stats;
+					outfile << iResolution << "," << iNumLights << "," << TriangleBoxOverlap::GetLevelName(static_cast<SIMDLevel>(iLevel)) << "," << iThreadCounts[t] << ","
+						<< stats.iNumVoxelsLit << "," << stats.iNumLightEvaluations << "," << dBestMs << ","
+						<< (stats.iNumVoxelsLit > 0 ? dBestMs * 1000000.0 / stats.iNumVoxelsLit : 0.0) << ","
+						<< (stats.iNumLightEvaluations > 0 ? dBestMs * 1000000.0 / stats.iNumLightEvaluations : 0.0) << "," << (bMatch ? "Yes" : "No") << "\n";
+				}
+			}
+		}
+		summary << "\n" << iResolution << " Occupied Bricks:," << injector.m_Stats.iNumOccupiedBricks << "," << injector.m_Stats.iNumBricks;
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	if (!bAllMatch)
+	{
+		VS_LOG_VERBOSE("Radiance injection kernels disagree with each other");
+	}
+	return bAllMatch && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,137 @@
+#ifndef CPU_RADIANCE_INJECTOR_H
+#define CPU_RADIANCE_INJECTOR_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+#include "TriangleBoxOverlap.h"
+#include "VoxelGrid.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//The inject radiance pass on the CPU, lighting mip 0 of a voxel volume with the same inputs the compute shader
+//gets: the albedo texels, the world to voxel grid matrix and LightManager's LightBuffer. The volume has no normals
+//or shadows in it, so an occupied voxel's radiance is
+//	albedo.rgb * (ambient + directional + sum of point colour * saturate(1 - distance * reciprocal range))
+//at the voxel's centre, alpha is the albedo's and empty voxels stay zero. Texels are packed the way the R32_UINT UAV
+//writes them, so the result can be compared texel for texel with a read back of the radiance volume.
+//The volume is split into kBrickSize^3 bricks handed out to the threads one at a time, and each brick only loops
+//over the point lights whose range reaches it. The SSE and AVX2 versions light 4 or 8 voxels of a brick row at once,
+//going through the lights in the same order as the scalar one, so all three give exactly the same texels.
+class CPURadianceInjector
+{
+public:
+
+	static const int kBrickSize = 8;
+
+	struct Stats
+	{
+		SIMDLevel eSIMDLevel;
+		int iNumThreads;
+		int iNumPointLights;
+		double dTimeMs;
+		long long iNumVoxelsLit;
+		long long iNumLightEvaluations;		//voxels times the lights that reached their bricks
+		int iNumBricks;
+		int iNumOccupiedBricks;
+	};
+
+	struct CompareResult
+	{
+		long long iNumTexels;
+		long long iNumMismatches;
+		int iMaxChannelDifference;
+	};
+
+	CPURadianceInjector();
+	~CPURadianceInjector();
+
+	//mWorldToVoxelGrid is the transposed one VoxelisedScene hands the shaders. iResolution has to be a multiple of
+	//kBrickSize. iNumThreads <= 0 uses every core.
+	bool Initialise(const XMMATRIX& mWorldToVoxelGrid, int iResolution, int iNumThreads = 0);
+
+	void SetNumThreads(int iNumThreads) { m_iNumThreads = iNumThreads; }
+	//Clamped to what the CPU supports. Defaults to the best supported level.
+	void SetSIMDLevel(SIMDLevel eLevel);
+
+	void SetAmbientColour(const XMFLOAT4& vColour) { m_vAmbientColour = vColour; }
+	void SetDirectionalColour(const XMFLOAT4& vColour) { m_vDirectionalColour = vColour; }
+	void ClearPointLights();
+	//fRecipRange is 1 / range, as LightManager puts it in the light buffer
+	void AddPointLight(const XMFLOAT3& vPosition, const XMFLOAT4& vColour, float fRecipRange);
+	int GetNumPointLights() const { return static_cast<int>(m_arrLightX.size()); }
+
+	//Takes everything from a LightManager::LightBuffer, the first iNumPointLights of its point lights
+	template<typename LightBufferType>
+	void SetLights(const LightBufferType& lightBuffer, int iNumPointLights)
+	{
+		SetAmbientColour(lightBuffer.AmbientColour);
+		SetDirectionalColour(lightBuffer.DirectionalLightColour);
+		ClearPointLights();
+		for (int i = 0; i < iNumPointLights; i++)
+		{
+			AddPointLight(lightBuffer.pointLights[i].vPosition, lightBuffer.pointLights[i].vDiffuseColour, lightBuffer.pointLights[i].fRange);
+		}
+	}
+
+	//Lights mip 0 of albedo into mip 0 of radiance, which can be the same volume. Both have to be the resolution
+	//the injector was initialised with.
+	bool Inject(const CPUVoxelVolume& albedo, CPUVoxelVolume& radiance);
+	//Just the voxels [vMin, vMax), which have to be on brick boundaries, for relighting part of the volume at a time
+	bool InjectBox(const CPUVoxelVolume& albedo, CPUVoxelVolume& radiance, const int vMin[3], const int vMax[3]);
+
+	const Stats& GetStats() const { return m_Stats; }
+
+	//Texel for texel comparison of one mip, counting texels where any channel differs by more than iTolerance
+	static CompareResult Compare(const CPUVoxelVolume& a, const CPUVoxelVolume& b, int iMipLevel = 0, int iTolerance = 0);
+
+	//Random volumes and light counts through every SIMD level and thread count against a voxel at a time version.
+	//Returns the number of mismatching texels.
+	static int Validate(unsigned int iSeed);
+
+	//Lights the voxeliser's triangles at 128^3 and 256^3 with 1 to 256 point lights, at each SIMD level on one thread
+	//and every thread, writing the time per voxel per light to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	//Lights one brick, returning the number of voxels it lit
+	long long InjectBrick(int bx, int by, int bz, const uint32_t* pAlbedo, uint32_t* pRadiance, std::vector<int>& arrBrickLights, long long& iNumLightEvaluations) const;
+
+	int m_iResolution;
+	int m_iNumThreads;
+	SIMDLevel m_eSIMDLevel;
+	VoxelGrid m_VoxelGrid;
+
+	//World space centres of the voxels along each axis, so every version works out exactly the same positions
+	std::vector<float> m_arrCentreX;
+	std::vector<float> m_arrCentreY;
+	std::vector<float> m_arrCentreZ;
+
+	XMFLOAT4 m_vAmbientColour;
+	XMFLOAT4 m_vDirectionalColour;
+
+	//Point lights as structure of arrays
+	std::vector<float> m_arrLightX;
+	std::vector<float> m_arrLightY;
+	std::vector<float> m_arrLightZ;
+	std::vector<float> m_arrLightRecipRange;
+	std::vector<float> m_arrLightR;
+	std::vector<float> m_arrLightG;
+	std::vector<float> m_arrLightB;
+
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !CPU_RADIANCE_INJECTOR_H
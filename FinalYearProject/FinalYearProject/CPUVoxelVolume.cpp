@@ -0,0 +1,168 @@
+#include "CPUVoxelVolume.h"
+#include "Debugging.h"
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPUVoxelVolume::CPUVoxelVolume()
+	: m_iResolution(0)
+	, m_iMipLevels(0)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPUVoxelVolume::~CPUVoxelVolume()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUVoxelVolume::Initialise(int iResolution, int iMipLevels)
+{
+	if (iResolution <= 0 || (iResolution >> (iMipLevels - 1)) <= 0)
+	{
+		VS_LOG_VERBOSE("Invalid resolution or mip count for CPU voxel volume");
+		return false;
+	}
+
+	m_iResolution = iResolution;
+	m_iMipLevels = iMipLevels;
+	m_arrMips.resize(iMipLevels);
+	for (int i = 0; i < iMipLevels; i++)
+	{
+		size_t iMipRes = GetMipResolution(i);
+		m_arrMips[i].assign(iMipRes * iMipRes * iMipRes, 0);
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUVoxelVolume::Shutdown()
+{
+	m_arrMips.clear();
+	m_iResolution = 0;
+	m_iMipLevels = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUVoxelVolume::Clear()
+{
+	for (int i = 0; i < m_arrMips.size(); i++)
+	{
+		std::fill(m_arrMips[i].begin(), m_arrMips[i].end(), 0);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUVoxelVolume::GenerateMips()
+{
+	for (int iMip = 1; iMip < m_iMipLevels; iMip++)
+	{
+		int iRes = GetMipResolution(iMip);
+		const uint32_t* pSrc = GetMipData(iMip - 1);
+		uint32_t* pDst = GetMipData(iMip);
+		int iSrcRes = iRes * 2;
+
+		for (int z = 0; z < iRes; z++)
+		{
+			for (int y = 0; y < iRes; y++)
+			{
+				for (int x = 0; x < iRes; x++)
+				{
+					uint32_t iSum[4] = { 0, 0, 0, 0 };
+					for (int i = 0; i < 8; i++)
+					{
+						int sx = x * 2 + (i & 1);
+						int sy = y * 2 + ((i >> 1) & 1);
+						int sz = z * 2 + ((i >> 2) & 1);
+						uint32_t iTexel = pSrc[(sz * iSrcRes * iSrcRes) + (sy * iSrcRes) + sx];
+						iSum[0] += iTexel & 0xff;
+						iSum[1] += (iTexel >> 8) & 0xff;
+						iSum[2] += (iTexel >> 16) & 0xff;
+						iSum[3] += (iTexel >> 24) & 0xff;
+					}
+					//round to nearest like the hardware filter
+					pDst[(z * iRes * iRes) + (y * iRes) + x] = ((iSum[0] + 4) / 8) | (((iSum[1] + 4) / 8) << 8) | (((iSum[2] + 4) / 8) << 16) | (((iSum[3] + 4) / 8) << 24);
+				}
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMFLOAT4 CPUVoxelVolume::SampleLevel(const XMFLOAT3& vUVW, float fMipLevel) const
+{
+	fMipLevel = std::max(0.f, std::min(fMipLevel, static_cast<float>(m_iMipLevels - 1)));
+	int iLowerMip = static_cast<int>(fMipLevel);
+	int iUpperMip = std::min(iLowerMip + 1, m_iMipLevels - 1);
+	float fBlend = fMipLevel - iLowerMip;
+
+	XMFLOAT4 vLower = SampleTrilinear([&](int x, int y, int z) { return GetVoxelClamped(x, y, z, iLowerMip); }, GetMipResolution(iLowerMip), vUVW);
+	if (fBlend <= 0.f || iUpperMip == iLowerMip)
+	{
+		return vLower;
+	}
+	XMFLOAT4 vUpper = SampleTrilinear([&](int x, int y, int z) { return GetVoxelClamped(x, y, z, iUpperMip); }, GetMipResolution(iUpperMip), vUVW);
+	return XMFLOAT4(vLower.x + (vUpper.x - vLower.x) * fBlend, vLower.y + (vUpper.y - vLower.y) * fBlend,
+					vLower.z + (vUpper.z - vLower.z) * fBlend, vLower.w + (vUpper.w - vLower.w) * fBlend);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUVoxelVolume::GatherFragments(std::vector<VoxelFragment>& arrFragments) const
+{
+	arrFragments.clear();
+	const uint32_t* pVoxels = GetMipData(0);
+	size_t iIndex = 0;
+	for (uint32_t z = 0; z < static_cast<uint32_t>(m_iResolution); z++)
+	{
+		for (uint32_t y = 0; y < static_cast<uint32_t>(m_iResolution); y++)
+		{
+			for (uint32_t x = 0; x < static_cast<uint32_t>(m_iResolution); x++, iIndex++)
+			{
+				if (pVoxels[iIndex] != 0)
+				{
+					VoxelFragment fragment = { x, y, z, pVoxels[iIndex] };
+					arrFragments.push_back(fragment);
+				}
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int CPUVoxelVolume::CountOccupiedVoxels(int iMipLevel) const
+{
+	int iCount = 0;
+	const std::vector<uint32_t>& arrMip = m_arrMips[iMipLevel];
+	for (size_t i = 0; i < arrMip.size(); i++)
+	{
+		if (arrMip[i] != 0)
+		{
+			iCount++;
+		}
+	}
+	return iCount;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t CPUVoxelVolume::GetMemoryUsageInBytes() const
+{
+	size_t iBytes = 0;
+	for (int i = 0; i < m_arrMips.size(); i++)
+	{
+		iBytes += GetMipSizeInBytes(i);
+	}
+	return iBytes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
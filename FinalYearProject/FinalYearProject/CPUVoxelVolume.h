@@ -0,0 +1,151 @@
+#ifndef CPU_VOXEL_VOLUME_H
+#define CPU_VOXEL_VOLUME_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//RGBA8 packed the same way the voxelise shaders write it through the R32_UINT UAV - red in the low byte
+inline uint32_t PackRGBA8(const XMFLOAT4& vColour)
+{
+	auto toByte = [](float f) -> uint32_t
+	{
+		f = f < 0.f ? 0.f : (f > 1.f ? 1.f : f);
+		return static_cast<uint32_t>(f * 255.f + 0.5f);
+	};
+	return toByte(vColour.x) | (toByte(vColour.y) << 8) | (toByte(vColour.z) << 16) | (toByte(vColour.w) << 24);
+}
+
+inline XMFLOAT4 UnpackRGBA8(uint32_t iColour)
+{
+	const float fRecip = 1.f / 255.f;
+	return XMFLOAT4((iColour & 0xff) * fRecip, ((iColour >> 8) & 0xff) * fRecip, ((iColour >> 16) & 0xff) * fRecip, ((iColour >> 24) & 0xff) * fRecip);
+}
+
+//Unit normal packed into RGBA8 with [-1, 1] mapped to [0, 1], alpha unused
+inline uint32_t PackNormalRGBA8(const XMFLOAT3& vNormal)
+{
+	return PackRGBA8(XMFLOAT4(vNormal.x * 0.5f + 0.5f, vNormal.y * 0.5f + 0.5f, vNormal.z * 0.5f + 0.5f, 1.f));
+}
+
+inline XMFLOAT3 UnpackNormalRGBA8(uint32_t iNormal)
+{
+	XMFLOAT4 vPacked = UnpackRGBA8(iNormal);
+	return XMFLOAT3(vPacked.x * 2.f - 1.f, vPacked.y * 2.f - 1.f, vPacked.z * 2.f - 1.f);
+}
+
+//One occupied voxel, the input to anything building sparse structures out of the voxelised scene
+struct VoxelFragment
+{
+	uint32_t x, y, z;
+	uint32_t iColour;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Trilinear filtering of an RGBA8 volume through fnFetch(x, y, z), which returns 0 for texels outside the volume.
+//vUVW is [0, 1] across the volume, same as the texture coordinates the cone tracing shaders use.
+template<typename FetchFunc>
+XMFLOAT4 SampleTrilinear(const FetchFunc& fnFetch, int iResolution, const XMFLOAT3& vUVW)
+{
+	float fX = vUVW.x * iResolution - 0.5f;
+	float fY = vUVW.y * iResolution - 0.5f;
+	float fZ = vUVW.z * iResolution - 0.5f;
+	int x0 = static_cast<int>(floorf(fX));
+	int y0 = static_cast<int>(floorf(fY));
+	int z0 = static_cast<int>(floorf(fZ));
+	float fWeights[3] = { fX - x0, fY - y0, fZ - z0 };
+
+	XMFLOAT4 vResult(0.f, 0.f, 0.f, 0.f);
+	for (int i = 0; i < 8; i++)
+	{
+		int dx = i & 1, dy = (i >> 1) & 1, dz = (i >> 2) & 1;
+		float fWeight = (dx ? fWeights[0] : 1.f - fWeights[0]) * (dy ? fWeights[1] : 1.f - fWeights[1]) * (dz ? fWeights[2] : 1.f - fWeights[2]);
+		uint32_t iTexel = fnFetch(x0 + dx, y0 + dy, z0 + dz);
+		if (iTexel != 0 && fWeight > 0.f)
+		{
+			XMFLOAT4 vTexel = UnpackRGBA8(iTexel);
+			vResult.x += vTexel.x * fWeight;
+			vResult.y += vTexel.y * fWeight;
+			vResult.z += vTexel.z * fWeight;
+			vResult.w += vTexel.w * fWeight;
+		}
+	}
+	return vResult;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//A host memory copy of the radiance volume. Same layout as m_pRadianceVolume: one RGBA8 texel per voxel,
+//x fastest then y then z, with a full mip chain where each mip is half the size of the previous one.
+//Nothing in here touches D3D so it can be filled, inspected and compared without a GPU.
+class CPUVoxelVolume
+{
+public:
+	CPUVoxelVolume();
+	~CPUVoxelVolume();
+
+	bool Initialise(int iResolution, int iMipLevels);
+	void Shutdown();
+	void Clear();
+
+	int GetResolution() const { return m_iResolution; }
+	int GetMipLevels() const { return m_iMipLevels; }
+	int GetMipResolution(int iMipLevel) const { return m_iResolution >> iMipLevel; }
+
+	uint32_t* GetMipData(int iMipLevel) { return m_arrMips[iMipLevel].data(); }
+	const uint32_t* GetMipData(int iMipLevel) const { return m_arrMips[iMipLevel].data(); }
+	size_t GetMipSizeInBytes(int iMipLevel) const { return m_arrMips[iMipLevel].size() * sizeof(uint32_t); }
+
+	int GetIndex(int x, int y, int z, int iMipLevel = 0) const
+	{
+		int iRes = GetMipResolution(iMipLevel);
+		return (z * iRes * iRes) + (y * iRes) + x;
+	}
+
+	uint32_t GetVoxel(int x, int y, int z, int iMipLevel = 0) const { return m_arrMips[iMipLevel][GetIndex(x, y, z, iMipLevel)]; }
+	void SetVoxel(int x, int y, int z, uint32_t iColour, int iMipLevel = 0) { m_arrMips[iMipLevel][GetIndex(x, y, z, iMipLevel)] = iColour; }
+
+	//2x2x2 box filter down the chain, the same thing ID3D11DeviceContext::GenerateMips does for us on the GPU
+	void GenerateMips();
+
+	//Out of range texels read as empty, like a border colour of 0
+	uint32_t GetVoxelClamped(int x, int y, int z, int iMipLevel) const
+	{
+		int iRes = GetMipResolution(iMipLevel);
+		if (x < 0 || y < 0 || z < 0 || x >= iRes || y >= iRes || z >= iRes)
+		{
+			return 0;
+		}
+		return GetVoxel(x, y, z, iMipLevel);
+	}
+
+	//Trilinear within a mip and linear between mips, like SampleLevel on the radiance volume
+	XMFLOAT4 SampleLevel(const XMFLOAT3& vUVW, float fMipLevel) const;
+
+	//Every occupied voxel of mip 0, in x then y then z order
+	void GatherFragments(std::vector<VoxelFragment>& arrFragments) const;
+
+	int CountOccupiedVoxels(int iMipLevel = 0) const;
+	size_t GetMemoryUsageInBytes() const;
+
+private:
+
+	int m_iResolution;
+	int m_iMipLevels;
+
+	std::vector<std::vector<uint32_t>> m_arrMips;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !CPU_VOXEL_VOLUME_H
@@ -0,0 +1,652 @@
+#include "NoFloatContraction.h"
+#include "CPUVoxeliser.h"
+#include "Parallel.h"
+#include "TriangleBoxOverlap.h"
+#include "VoxelGrid.h"
+#include "VoxelFragmentList.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	inline float AxisTestMin(float a, float b, float c) { return std::min(a, std::min(b, c)); }
+	inline float AxisTestMax(float a, float b, float c) { return std::max(a, std::max(b, c)); }
+
+	inline float GetAxis(const XMFLOAT3& v, int iAxis)
+	{
+		return iAxis == 0 ? v.x : (iAxis == 1 ? v.y : v.z);
+	}
+
+	inline int ClampVoxel(int i, int iResolution)
+	{
+		return i < 0 ? 0 : (i >= iResolution ? iResolution - 1 : i);
+	}
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Cheap checksum so the benchmark can check every thread count produced the same volume without keeping a copy around
+	uint64_t HashVolume(const CPUVoxelVolume& volume)
+	{
+		uint64_t iHash = 14695981039346656037ULL;
+		const uint32_t* pData = volume.GetMipData(0);
+		size_t iCount = volume.GetMipSizeInBytes(0) / sizeof(uint32_t);
+		for (size_t i = 0; i < iCount; i++)
+		{
+			iHash = (iHash ^ pData[i]) * 1099511628211ULL;
+		}
+		return iHash;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPUVoxeliser::CPUVoxeliser()
+	: m_iNumThreads(0)
+	, m_eMode(cvmConservative)
+{
+	XMStoreFloat4x4(&m_mWorldToVoxelGrid, XMMatrixIdentity());
+	memset(&m_Stats, 0, sizeof(Stats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPUVoxeliser::~CPUVoxeliser()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUVoxeliser::Initialise(const XMMATRIX& mWorldToVoxelGrid, int iNumThreads)
+{
+	XMStoreFloat4x4(&m_mWorldToVoxelGrid, XMMatrixTranspose(mWorldToVoxelGrid));
+	m_iNumThreads = iNumThreads;
+	m_arrTriangles.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUVoxeliser::AddTriangles(const XMFLOAT3* pPositions, int iStride, int iNumVertices, const XMMATRIX& mWorld, const XMFLOAT4& vColour)
+{
+	XMMATRIX mWorldToGrid = mWorld * XMLoadFloat4x4(&m_mWorldToVoxelGrid);
+	uint32_t iColour = PackRGBA8(vColour);
+
+	const char* pVertex = reinterpret_cast<const char*>(pPositions);
+	int iNumTriangles = iNumVertices / 3;
+	m_arrTriangles.reserve(m_arrTriangles.size() + iNumTriangles);
+	for (int i = 0; i < iNumTriangles; i++)
+	{
+		Triangle tri;
+		for (int j = 0; j < 3; j++)
+		{
+			XMVECTOR vPos = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pVertex));
+			XMStoreFloat3(&tri.v[j], XMVector3TransformCoord(vPos, mWorldToGrid));
+			pVertex += iStride;
+		}
+		tri.iColour = iColour;
+
+		//The grid is the world scaled the same on every axis, so the grid space normal points the same way
+		XMVECTOR v0 = XMLoadFloat3(&tri.v[0]);
+		XMVECTOR vNormal = XMVector3Cross(XMLoadFloat3(&tri.v[1]) - v0, XMLoadFloat3(&tri.v[2]) - v0);
+		XMFLOAT3 vUnitNormal(0.f, 1.f, 0.f);
+		if (XMVectorGetX(XMVector3LengthSq(vNormal)) > 0.f)
+		{
+			XMStoreFloat3(&vUnitNormal, XMVector3Normalize(vNormal));
+		}
+		tri.iNormal = PackNormalRGBA8(vUnitNormal);
+		m_arrTriangles.push_back(tri);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename BinFunc>
+void CPUVoxeliser::VoxeliseBins(int iResolution, const BinFunc& fnVoxeliseBin)
+{
+	int iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+
+	//A few slabs per thread so a thread that gets the floor of the atrium doesn't hold everyone else up
+	int iSlabHeight = std::max(1, (iResolution + (iNumThreads * 8) - 1) / (iNumThreads * 8));
+	int iNumBins = (iResolution + iSlabHeight - 1) / iSlabHeight;
+
+	m_Stats.iNumTriangles = GetNumTriangles();
+	m_Stats.iNumBins = iNumBins;
+	m_Stats.iNumThreads = iNumThreads;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	BinTriangles(iResolution, iNumBins, iSlabHeight, iNumThreads);
+	m_Stats.dBinningTimeMs = GetElapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<long long> arrVoxelsWritten(iNumBins, 0);
+	Parallel::For(iNumBins, iNumThreads, [&](int iBin, int iThread)
+	{
+		int iSlabMin = iBin * iSlabHeight;
+		int iSlabMax = std::min(iSlabMin + iSlabHeight, iResolution);
+		arrVoxelsWritten[iBin] = fnVoxeliseBin(iBin, iSlabMin, iSlabMax);
+	});
+	m_Stats.dVoxeliseTimeMs = GetElapsedMs(start);
+
+	m_Stats.iNumVoxelsWritten = 0;
+	for (int i = 0; i < iNumBins; i++)
+	{
+		m_Stats.iNumVoxelsWritten += arrVoxelsWritten[i];
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUVoxeliser::Voxelise(CPUVoxelVolume* pVolume)
+{
+	if (!pVolume || pVolume->GetResolution() <= 0)
+	{
+		VS_LOG_VERBOSE("CPU voxeliser needs an initialised volume");
+		return false;
+	}
+
+	int iResolution = pVolume->GetResolution();
+	uint32_t* pVoxels = pVolume->GetMipData(0);
+	VoxeliseBins(iResolution, [&](int iBin, int iSlabMin, int iSlabMax)
+	{
+		return VoxeliseBin(iBin, iResolution, iSlabMin, iSlabMax, [&](const Triangle& tri, int x, int y, int z)
+		{
+			pVoxels[pVolume->GetIndex(x, y, z)] = tri.iColour;
+		});
+	});
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUVoxeliser::Voxelise(VoxelFragmentList* pFragments)
+{
+	if (!pFragments || pFragments->GetResolution() <= 0)
+	{
+		VS_LOG_VERBOSE("CPU voxeliser needs an initialised fragment list");
+		return false;
+	}
+
+	//Each slab fills its own pool, then they're appended in slab order so the list comes out the same whatever the
+	//thread count. There can't be more slabs than the resolution.
+	int iResolution = pFragments->GetResolution();
+	std::vector<std::vector<MortonFragment>> arrSlabFragments(iResolution);
+	VoxeliseBins(iResolution, [&](int iBin, int iSlabMin, int iSlabMax)
+	{
+		std::vector<MortonFragment>& arrOut = arrSlabFragments[iBin];
+		return VoxeliseBin(iBin, iResolution, iSlabMin, iSlabMax, [&](const Triangle& tri, int x, int y, int z)
+		{
+			MortonFragment fragment;
+			fragment.iKey = pFragments->EncodeKey(x, y, z);
+			fragment.iColour = tri.iColour;
+			fragment.iNormal = tri.iNormal;
+			arrOut.push_back(fragment);
+		});
+	});
+
+	size_t iTotal = pFragments->GetNumFragments();
+	for (int i = 0; i < iResolution; i++)
+	{
+		iTotal += arrSlabFragments[i].size();
+	}
+	pFragments->Reserve(iTotal);
+	for (int i = 0; i < iResolution; i++)
+	{
+		if (!arrSlabFragments[i].empty())
+		{
+			pFragments->AddFragments(arrSlabFragments[i].data(), arrSlabFragments[i].size());
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CPUVoxeliser::BinTriangles(int iResolution, int iNumBins, int iSlabHeight, int iNumThreads)
+{
+	int iNumTriangles = GetNumTriangles();
+	int iNumChunks = std::max(1, std::min(iNumThreads, iNumTriangles));
+	int iChunkSize = (iNumTriangles + iNumChunks - 1) / iNumChunks;
+
+	m_arrBins.resize(iNumChunks);
+	for (int c = 0; c < iNumChunks; c++)
+	{
+		m_arrBins[c].resize(iNumBins);
+		for (int b = 0; b < iNumBins; b++)
+		{
+			m_arrBins[c][b].clear();
+		}
+	}
+
+	float fHalfRes = iResolution * 0.5f;
+	Parallel::For(iNumChunks, iNumThreads, [&](int iChunk, int iThread)
+	{
+		int iStart = iChunk * iChunkSize;
+		int iEnd = std::min(iStart + iChunkSize, iNumTriangles);
+		std::vector<std::vector<int>>& arrBins = m_arrBins[iChunk];
+		for (int i = iStart; i < iEnd; i++)
+		{
+			const Triangle& tri = m_arrTriangles[i];
+			float fMinZ = AxisTestMin(tri.v[0].z, tri.v[1].z, tri.v[2].z) * fHalfRes + fHalfRes;
+			float fMaxZ = AxisTestMax(tri.v[0].z, tri.v[1].z, tri.v[2].z) * fHalfRes + fHalfRes;
+			if (fMaxZ < 0.f || fMinZ > static_cast<float>(iResolution))
+			{
+				continue;
+			}
+			//A triangle on a voxel boundary touches the voxels on both sides of it, so it starts one slab lower
+			int iFirstBin = ClampVoxel(static_cast<int>(ceilf(fMinZ)) - 1, iResolution) / iSlabHeight;
+			int iLastBin = ClampVoxel(static_cast<int>(floorf(fMaxZ)), iResolution) / iSlabHeight;
+			for (int b = iFirstBin; b <= iLastBin; b++)
+			{
+				arrBins[b].push_back(i);
+			}
+		}
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename WriteFunc>
+long long CPUVoxeliser::VoxeliseBin(int iBin, int iResolution, int iSlabMin, int iSlabMax, const WriteFunc& fnWrite) const
+{
+	long long iVoxelsWritten = 0;
+	for (int c = 0; c < m_arrBins.size(); c++)
+	{
+		const std::vector<int>& arrBin = m_arrBins[c][iBin];
+		for (int i = 0; i < arrBin.size(); i++)
+		{
+			const Triangle& tri = m_arrTriangles[arrBin[i]];
+			if (m_eMode == cvmConservative)
+			{
+				iVoxelsWritten += VoxeliseTriangleConservative(tri, iResolution, iSlabMin, iSlabMax, fnWrite);
+			}
+			else
+			{
+				iVoxelsWritten += VoxeliseTriangleDominantAxis(tri, iResolution, iSlabMin, iSlabMax, fnWrite);
+			}
+		}
+	}
+	return iVoxelsWritten;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename WriteFunc>
+long long CPUVoxeliser::VoxeliseTriangleConservative(const Triangle& tri, int iResolution, int iSlabMin, int iSlabMax, const WriteFunc& fnWrite) const
+{
+	XMFLOAT3 v[3];
+	for (int i = 0; i < 3; i++)
+	{
+		VoxelGrid::GridToVoxel(tri.v[i], iResolution, v[i]);
+	}
+	OverlapTriangle overlapTri;
+	overlapTri.Setup(v[0], v[1], v[2]);
+
+	int iMin[3], iMax[3];
+	for (int a = 0; a < 3; a++)
+	{
+		float fMin = AxisTestMin(GetAxis(v[0], a), GetAxis(v[1], a), GetAxis(v[2], a));
+		float fMax = AxisTestMax(GetAxis(v[0], a), GetAxis(v[1], a), GetAxis(v[2], a));
+		if (fMax < 0.f || fMin > static_cast<float>(iResolution))
+		{
+			return 0;
+		}
+		//Touching counts, so a minimum on a voxel boundary takes in the voxel below it as well
+		iMin[a] = ClampVoxel(static_cast<int>(ceilf(fMin)) - 1, iResolution);
+		iMax[a] = ClampVoxel(static_cast<int>(floorf(fMax)), iResolution);
+	}
+	iMin[2] = std::max(iMin[2], iSlabMin);
+	iMax[2] = std::min(iMax[2], iSlabMax - 1);
+
+	//Rows along x go through the SIMD kernel a chunk at a time
+	const int iChunkSize = 64;
+	uint8_t arrOverlaps[iChunkSize];
+	long long iVoxelsWritten = 0;
+	for (int z = iMin[2]; z <= iMax[2]; z++)
+	{
+		for (int y = iMin[1]; y <= iMax[1]; y++)
+		{
+			for (int x = iMin[0]; x <= iMax[0]; x += iChunkSize)
+			{
+				int iCount = std::min(iChunkSize, iMax[0] - x + 1);
+				if (TriangleBoxOverlap::TestVoxelRow(overlapTri, x, y, z, iCount, arrOverlaps) == 0)
+				{
+					continue;
+				}
+				for (int i = 0; i < iCount; i++)
+				{
+					if (arrOverlaps[i])
+					{
+						fnWrite(tri, x + i, y, z);
+						iVoxelsWritten++;
+					}
+				}
+			}
+		}
+	}
+	return iVoxelsWritten;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename WriteFunc>
+long long CPUVoxeliser::VoxeliseTriangleDominantAxis(const Triangle& tri, int iResolution, int iSlabMin, int iSlabMax, const WriteFunc& fnWrite) const
+{
+	XMFLOAT3 v[3];
+	for (int i = 0; i < 3; i++)
+	{
+		VoxelGrid::GridToVoxel(tri.v[i], iResolution, v[i]);
+	}
+
+	XMFLOAT3 e0(v[1].x - v[0].x, v[1].y - v[0].y, v[1].z - v[0].z);
+	XMFLOAT3 e1(v[2].x - v[0].x, v[2].y - v[0].y, v[2].z - v[0].z);
+	float n[3] = { e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x };
+
+	//Same choice the geometry shader makes when it picks one of the three axis projections
+	int iDominant = 0;
+	if (fabsf(n[1]) > fabsf(n[iDominant]))
+	{
+		iDominant = 1;
+	}
+	if (fabsf(n[2]) > fabsf(n[iDominant]))
+	{
+		iDominant = 2;
+	}
+	if (n[iDominant] == 0.f)
+	{
+		return 0;
+	}
+	int iU = (iDominant + 1) % 3;
+	int iW = (iDominant + 2) % 3;
+
+	float fU[3], fW[3];
+	for (int i = 0; i < 3; i++)
+	{
+		fU[i] = GetAxis(v[i], iU);
+		fW[i] = GetAxis(v[i], iW);
+	}
+
+	int iMin[3], iMax[3];
+	for (int a = 0; a < 3; a++)
+	{
+		float fMin = AxisTestMin(GetAxis(v[0], a), GetAxis(v[1], a), GetAxis(v[2], a));
+		float fMax = AxisTestMax(GetAxis(v[0], a), GetAxis(v[1], a), GetAxis(v[2], a));
+		if (fMax < 0.f || fMin >= static_cast<float>(iResolution))
+		{
+			return 0;
+		}
+		iMin[a] = ClampVoxel(static_cast<int>(floorf(fMin)), iResolution);
+		iMax[a] = ClampVoxel(static_cast<int>(floorf(fMax)), iResolution);
+	}
+	if (iDominant != 2)
+	{
+		iMin[2] = std::max(iMin[2], iSlabMin);
+		iMax[2] = std::min(iMax[2], iSlabMax - 1);
+	}
+
+	//Winding in the projected plane, so the edge functions are all positive inside whichever way round the triangle is
+	float fArea = (fU[1] - fU[0]) * (fW[2] - fW[0]) - (fW[1] - fW[0]) * (fU[2] - fU[0]);
+	if (fArea == 0.f)
+	{
+		return 0;
+	}
+	float fSign = fArea > 0.f ? 1.f : -1.f;
+
+	long long iVoxelsWritten = 0;
+	int iCoord[3];
+	for (int w = iMin[iW]; w <= iMax[iW]; w++)
+	{
+		for (int u = iMin[iU]; u <= iMax[iU]; u++)
+		{
+			//Sample at the voxel centre like the rasteriser does with the pixel centre
+			float pu = u + 0.5f;
+			float pw = w + 0.5f;
+			bool bInside = true;
+			for (int i = 0; i < 3 && bInside; i++)
+			{
+				int j = (i + 1) % 3;
+				float fEdge = ((fU[j] - fU[i]) * (pw - fW[i]) - (fW[j] - fW[i]) * (pu - fU[i])) * fSign;
+				bInside = fEdge >= 0.f;
+			}
+			if (!bInside)
+			{
+				continue;
+			}
+
+			float fDepth = GetAxis(v[0], iDominant) - (n[iU] * (pu - fU[0]) + n[iW] * (pw - fW[0])) / n[iDominant];
+			iCoord[iDominant] = static_cast<int>(floorf(fDepth));
+			iCoord[iU] = u;
+			iCoord[iW] = w;
+			//outside the volume gets clipped, same as it would be by the voxelise viewport
+			if (iCoord[iDominant] < 0 || iCoord[iDominant] >= iResolution || iCoord[2] < iSlabMin || iCoord[2] >= iSlabMax)
+			{
+				continue;
+			}
+			fnWrite(tri, iCoord[0], iCoord[1], iCoord[2]);
+			iVoxelsWritten++;
+		}
+	}
+	return iVoxelsWritten;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int CPUVoxeliser::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	const int iRes = 32;
+	const float fRes = static_cast<float>(iRes);
+	int iFailures = 0;
+
+	//Voxel space triangles. The first lot have every vertex on a voxel corner, so their edges and faces lie along voxel
+	//boundaries, slab boundaries and the faces of the volume.
+	std::vector<XMFLOAT3> arrPositions =
+	{
+		XMFLOAT3(4.f, 4.f, 16.f), XMFLOAT3(20.f, 4.f, 16.f), XMFLOAT3(4.f, 20.f, 16.f),
+		XMFLOAT3(2.f, 8.f, 2.f), XMFLOAT3(30.f, 8.f, 10.f), XMFLOAT3(10.f, 8.f, 30.f),
+		XMFLOAT3(8.f, 1.f, 1.f), XMFLOAT3(8.f, 31.f, 1.f), XMFLOAT3(8.f, 1.f, 24.f),
+		XMFLOAT3(0.f, 0.f, 0.f), XMFLOAT3(fRes, 0.f, 0.f), XMFLOAT3(0.f, fRes, 0.f),
+		XMFLOAT3(fRes, 2.f, 2.f), XMFLOAT3(fRes, 30.f, 2.f), XMFLOAT3(fRes, 2.f, 30.f),
+		XMFLOAT3(3.f, 5.f, 8.f), XMFLOAT3(25.f, 9.f, 8.f), XMFLOAT3(11.f, 27.f, 24.f),
+		XMFLOAT3(6.f, 6.f, 6.f), XMFLOAT3(7.f, 6.f, 6.f), XMFLOAT3(6.f, 7.f, 6.f),
+		XMFLOAT3(5.f, 5.f, 5.f), XMFLOAT3(20.f, 20.f, 20.f), XMFLOAT3(10.f, 10.f, 10.f),
+		XMFLOAT3(-5.f, 10.f, 10.f), XMFLOAT3(40.f, 12.f, 14.f), XMFLOAT3(16.f, 40.f, -3.f),
+	};
+
+	//Then random ones, big and small, some reaching outside the volume and some with their vertices snapped to voxel
+	//corners or centres
+	for (int t = 0; t < 40; t++)
+	{
+		float fSize = t % 2 ? 3.f : 24.f;
+		XMFLOAT3 vBase(unit(rng) * (fRes + 4.f) - 2.f, unit(rng) * (fRes + 4.f) - 2.f, unit(rng) * (fRes + 4.f) - 2.f);
+		for (int i = 0; i < 3; i++)
+		{
+			float fCoords[3] = { vBase.x + unit(rng) * fSize, vBase.y + unit(rng) * fSize, vBase.z + unit(rng) * fSize };
+			for (int a = 0; a < 3; a++)
+			{
+				if (t % 4 == 1)
+				{
+					fCoords[a] = floorf(fCoords[a]);
+				}
+				else if (t % 4 == 3)
+				{
+					fCoords[a] = floorf(fCoords[a]) + 0.5f;
+				}
+			}
+			arrPositions.push_back(XMFLOAT3(fCoords[0], fCoords[1], fCoords[2]));
+		}
+	}
+	int iNumTriangles = static_cast<int>(arrPositions.size()) / 3;
+
+	//World space is voxel space
+	float fGridSize;
+	XMMATRIX mWorldToVoxelGrid = VoxelGrid::CreateWorldToVoxelGrid(XMFLOAT3(0.f, 0.f, 0.f), XMFLOAT3(fRes, fRes, fRes), fGridSize);
+	int iNumThreads = std::max(4, Parallel::GetNumWorkerThreads());
+
+	CPUVoxeliser voxeliser;
+	CPUVoxelVolume volume, multiThreadVolume;
+	volume.Initialise(iRes, 1);
+	multiThreadVolume.Initialise(iRes, 1);
+	for (int m = 0; m < cvmMax; m++)
+	{
+		voxeliser.SetMode(static_cast<CPUVoxeliseMode>(m));
+		for (int t = 0; t < iNumTriangles; t++)
+		{
+			voxeliser.Initialise(mWorldToVoxelGrid, 1);
+			voxeliser.AddTriangles(&arrPositions[t * 3], sizeof(XMFLOAT3), 3, XMMatrixIdentity(), XMFLOAT4(1.f, 1.f, 1.f, 1.f));
+			volume.Clear();
+			voxeliser.Voxelise(&volume);
+			voxeliser.SetNumThreads(iNumThreads);
+			multiThreadVolume.Clear();
+			voxeliser.Voxelise(&multiThreadVolume);
+
+			//Brute force from the triangle the voxeliser stored, so both see the same grid to voxel rounding
+			XMFLOAT3 v[3];
+			for (int i = 0; i < 3; i++)
+			{
+				VoxelGrid::GridToVoxel(voxeliser.m_arrTriangles[0].v[i], iRes, v[i]);
+			}
+			OverlapTriangle overlapTri;
+			overlapTri.Setup(v[0], v[1], v[2]);
+
+			int iMismatches = 0;
+			for (int z = 0; z < iRes; z++)
+			{
+				for (int y = 0; y < iRes; y++)
+				{
+					for (int x = 0; x < iRes; x++)
+					{
+						bool bOverlaps = TriangleBoxOverlap::Test(overlapTri, XMFLOAT3(x + 0.5f, y + 0.5f, z + 0.5f), 0.5f);
+						bool bWritten = volume.GetVoxel(x, y, z) != 0;
+						//The dominant axis voxels are one deep, so they're only ever some of the ones it overlaps
+						bool bExpected = m == cvmConservative ? bWritten == bOverlaps : (!bWritten || bOverlaps);
+						if (!bExpected || bWritten != (multiThreadVolume.GetVoxel(x, y, z) != 0))
+						{
+							iMismatches++;
+						}
+					}
+				}
+			}
+			if (iMismatches > 0)
+			{
+				VS_LOG_VERBOSE("CPU voxeliser " << (m == cvmConservative ? "conservative" : "dominant axis") << " triangle " << t << " got " << iMismatches << " voxels wrong");
+				iFailures += iMismatches;
+			}
+		}
+
+		//All of them at once, where the bins hold more than one triangle and later ones overwrite earlier ones
+		voxeliser.Initialise(mWorldToVoxelGrid, 1);
+		voxeliser.AddTriangles(arrPositions.data(), sizeof(XMFLOAT3), iNumTriangles * 3, XMMatrixIdentity(), XMFLOAT4(1.f, 1.f, 1.f, 1.f));
+		volume.Clear();
+		voxeliser.Voxelise(&volume);
+		voxeliser.SetNumThreads(iNumThreads);
+		multiThreadVolume.Clear();
+		voxeliser.Voxelise(&multiThreadVolume);
+		if (HashVolume(volume) != HashVolume(multiThreadVolume))
+		{
+			VS_LOG_VERBOSE("CPU voxeliser " << (m == cvmConservative ? "conservative" : "dominant axis") << " output changed with the thread count");
+			iFailures++;
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("CPU voxeliser validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CPUVoxeliser::RunBenchmark(const char* sName)
+{
+	const int iResolutions[] = { 64, 128, 256, 512 };
+	const int iNumRuns = 3;
+	int iMaxThreads = Parallel::GetNumWorkerThreads();
+	int iSavedThreads = m_iNumThreads;
+
+	std::vector<int> arrThreadCounts;
+	for (int t = 1; t < iMaxThreads; t *= 2)
+	{
+		arrThreadCounts.push_back(t);
+	}
+	arrThreadCounts.push_back(iMaxThreads);
+
+	std::stringstream ss;
+	ss << "../Results/CPUVoxeliser_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open CPU voxeliser benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Threads, Triangles, Average(ms), Minimum(ms), Maximum(ms), Triangles/sec, Speedup, Occupied Voxels, Matches Single Thread\n";
+
+	bool bAllMatch = true;
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolutions[r], 1))
+		{
+			continue;
+		}
+
+		double dSingleThreadMs = 0.0;
+		uint64_t iSingleThreadHash = 0;
+		for (int t = 0; t < arrThreadCounts.size(); t++)
+		{
+			m_iNumThreads = arrThreadCounts[t];
+			double dMin = DBL_MAX, dMax = 0.0, dTotal = 0.0;
+			for (int i = 0; i < iNumRuns; i++)
+			{
+				volume.Clear();
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				Voxelise(&volume);
+				double dMs = GetElapsedMs(start);
+				dMin = std::min(dMin, dMs);
+				dMax = std::max(dMax, dMs);
+				dTotal += dMs;
+			}
+
+			uint64_t iHash = HashVolume(volume);
+			if (t == 0)
+			{
+				dSingleThreadMs = dMin;
+				iSingleThreadHash = iHash;
+			}
+			bool bMatch = iHash == iSingleThreadHash;
+			bAllMatch &= bMatch;
+
+			double dTrianglesPerSec = GetNumTriangles() / (dMin / 1000.0);
+			outfile << iResolutions[r] << "," << m_iNumThreads << "," << GetNumTriangles() << "," << dTotal / iNumRuns << "," << dMin << "," << dMax << ","
+				<< dTrianglesPerSec << "," << dSingleThreadMs / dMin << "," << volume.CountOccupiedVoxels() << "," << (bMatch ? "Yes" : "No") << "\n";
+
+			VS_LOG("CPU voxeliser " << iResolutions[r] << "^3, " << m_iNumThreads << " threads: " << dMin << "ms, " << dTrianglesPerSec << " triangles/sec");
+		}
+	}
+	outfile << "\nOverlap Kernel:," << TriangleBoxOverlap::GetLevelName(TriangleBoxOverlap::GetLevel());
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	m_iNumThreads = iSavedThreads;
+	if (!bAllMatch)
+	{
+		VS_LOG_VERBOSE("CPU voxeliser output changed with the thread count");
+	}
+	return bAllMatch && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
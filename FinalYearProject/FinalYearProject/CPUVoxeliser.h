@@ -0,0 +1,109 @@
+#ifndef CPU_VOXELISER_H
+#define CPU_VOXELISER_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class VoxelFragmentList;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum CPUVoxeliseMode
+{
+	cvmConservative,	//every voxel the triangle touches (triangle/box overlap), the reference to check the GPU against
+	cvmDominantAxis,	//same rule as the geometry shader path - project along the largest normal axis, one voxel deep
+	cvmMax
+};
+
+//Voxelises triangle lists on the CPU into a CPUVoxelVolume, with the same world to voxel grid transform as VoxelisedScene.
+//Triangles are collected first, then binned into slabs along z. Each slab is a job, and a job only ever writes the voxels
+//inside its own slab so the threads never touch the same memory, and the output is the same whatever the thread count.
+class CPUVoxeliser
+{
+public:
+
+	struct Triangle
+	{
+		XMFLOAT3 v[3];		//grid space, [-1, 1] covers the volume
+		uint32_t iColour;
+		uint32_t iNormal;	//see PackNormalRGBA8
+	};
+
+	struct Stats
+	{
+		int iNumTriangles;
+		int iNumBins;
+		int iNumThreads;
+		long long iNumVoxelsWritten;
+		double dBinningTimeMs;
+		double dVoxeliseTimeMs;
+	};
+
+	CPUVoxeliser();
+	~CPUVoxeliser();
+
+	//mWorldToVoxelGrid is the transposed matrix VoxelisedScene hands the shaders. iNumThreads <= 0 uses every core.
+	void Initialise(const XMMATRIX& mWorldToVoxelGrid, int iNumThreads = 0);
+
+	void SetNumThreads(int iNumThreads) { m_iNumThreads = iNumThreads; }
+	//Transposed, the way Initialise took it
+	XMMATRIX GetWorldToVoxelGrid() const { return XMMatrixTranspose(XMLoadFloat4x4(&m_mWorldToVoxelGrid)); }
+	void SetMode(CPUVoxeliseMode eMode) { m_eMode = eMode; }
+
+	void ClearTriangles() { m_arrTriangles.clear(); }
+	//Positions are a non-indexed triangle list, iStride bytes apart. mWorld is the untransposed mesh world matrix.
+	void AddTriangles(const XMFLOAT3* pPositions, int iStride, int iNumVertices, const XMMATRIX& mWorld, const XMFLOAT4& vColour);
+	int GetNumTriangles() const { return static_cast<int>(m_arrTriangles.size()); }
+
+	//Writes mip 0 of the volume, the resolution of the volume decides the voxel size
+	bool Voxelise(CPUVoxelVolume* pVolume);
+	//Same voxels, but each one a triangle writes becomes a fragment with the triangle's colour and normal instead of
+	//overwriting whatever was there. The list's resolution decides the voxel size.
+	bool Voxelise(VoxelFragmentList* pFragments);
+
+	const Stats& GetStats() const { return m_Stats; }
+
+	//Both modes against testing every voxel of a 32^3 volume with TriangleBoxOverlap::Test, for random triangles and ones
+	//lying on voxel boundaries, on one thread and several. Returns the number of mismatches.
+	static int Validate(unsigned int iSeed);
+
+	//Voxelises the current triangles at 64^3 to 512^3 for 1 to all threads and writes triangles/second to ../Results/
+	bool RunBenchmark(const char* sName);
+
+private:
+
+	void BinTriangles(int iResolution, int iNumBins, int iSlabHeight, int iNumThreads);
+	//Bins the triangles and runs fnVoxeliseBin(iBin, iSlabMin, iSlabMax) for each slab, returning the voxels it wrote
+	template<typename BinFunc>
+	void VoxeliseBins(int iResolution, const BinFunc& fnVoxeliseBin);
+	//fnWrite(tri, x, y, z) is called for every voxel a triangle in the bin covers
+	template<typename WriteFunc>
+	long long VoxeliseBin(int iBin, int iResolution, int iSlabMin, int iSlabMax, const WriteFunc& fnWrite) const;
+	template<typename WriteFunc>
+	long long VoxeliseTriangleConservative(const Triangle& tri, int iResolution, int iSlabMin, int iSlabMax, const WriteFunc& fnWrite) const;
+	template<typename WriteFunc>
+	long long VoxeliseTriangleDominantAxis(const Triangle& tri, int iResolution, int iSlabMin, int iSlabMax, const WriteFunc& fnWrite) const;
+
+	XMFLOAT4X4 m_mWorldToVoxelGrid; //untransposed
+	int m_iNumThreads;
+	CPUVoxeliseMode m_eMode;
+
+	std::vector<Triangle> m_arrTriangles;
+
+	//m_arrBins[thread][bin] - each thread bins a contiguous run of triangles so walking the threads in order keeps submission order
+	std::vector<std::vector<std::vector<int>>> m_arrBins;
+
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !CPU_VOXELISER_H
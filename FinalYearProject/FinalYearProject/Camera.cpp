@@ -1,4 +1,5 @@
 #include "Camera.h"
+#include "CameraRoute.h"
 #include "InputManager.h"
 #include "Application.h"
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -132,25 +133,15 @@ void Camera::Update()
 	{
 		if (m_iCurrentRouteIndex < m_arrRoute.size())
 		{
-			XMVECTOR vOrigin, vDestination, vCurrentPos;
-			vDestination = XMLoadFloat3(&m_arrRoute[m_iCurrentRouteIndex]);
-			vOrigin = XMLoadFloat3(&m_arrRoute[m_iCurrentRouteIndex-1]);
-			vCurrentPos = XMLoadFloat3(&m_vPosition);
-			//if we are very close to destination..
-			if (XMVector3LengthSq(vDestination - vCurrentPos).m128_f32[0] < 5 * 5)
+			int iPreviousRouteIndex = m_iCurrentRouteIndex;
+			if (!StepAlongRoute(m_arrRoute, m_iCurrentRouteIndex, m_vPosition))
 			{
-				m_iCurrentRouteIndex++; //go on to the next position
-				if (m_iCurrentRouteIndex >= m_arrRoute.size())
-				{
-					//gone past the end of the route, stop!
-					m_bFollowingRoute = false;
-					m_bFinishedRouteThisFrame = true;
-				}
+				//gone past the end of the route, stop!
+				m_bFollowingRoute = false;
+				m_bFinishedRouteThisFrame = true;
 			}
-			else
+			else if (m_iCurrentRouteIndex == iPreviousRouteIndex)
 			{
-				XMVECTOR vDir = vDestination - vOrigin;
-				XMStoreFloat3(&m_vPosition, vCurrentPos + vDir * 0.001f);
 				m_vRotation = XMFLOAT3(0.f, m_vRotation.y + 1.f, 0.f);
 			}
 		}
@@ -0,0 +1,41 @@
+#ifndef CAMERA_ROUTE_H
+#define CAMERA_ROUTE_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//One frame of the fly through route. Moves a thousandth of the current leg per frame and goes on to the next point
+//once within 5 units of it. Returns false once the end of the route has been reached.
+//The camera uses this, and so can the headless tools that need to replay the same path without a window.
+inline bool StepAlongRoute(const std::vector<XMFLOAT3>& arrRoute, int& iRouteIndex, XMFLOAT3& vPosition)
+{
+	if (iRouteIndex < 1 || iRouteIndex >= static_cast<int>(arrRoute.size()))
+	{
+		return false;
+	}
+
+	const XMFLOAT3& vDestination = arrRoute[iRouteIndex];
+	const XMFLOAT3& vOrigin = arrRoute[iRouteIndex - 1];
+	XMVECTOR vToDestination = XMLoadFloat3(&vDestination) - XMLoadFloat3(&vPosition);
+	if (XMVectorGetX(XMVector3LengthSq(vToDestination)) < 5 * 5)
+	{
+		iRouteIndex++; //go on to the next position
+		return iRouteIndex < static_cast<int>(arrRoute.size());
+	}
+
+	XMVECTOR vDir = XMLoadFloat3(&vDestination) - XMLoadFloat3(&vOrigin);
+	XMStoreFloat3(&vPosition, XMLoadFloat3(&vPosition) + vDir * 0.001f);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !CAMERA_ROUTE_H
@@ -10,11 +10,24 @@
 Some useful debugging tools/macros.
 **/
 
-#include <Windows.h>
+#ifndef DEBUGGING_H
+#define DEBUGGING_H
+
 #include <iostream>
 #include <sstream>
 #include <cassert>
 
+#ifdef _WIN32
+#include <Windows.h>
+#else
+//Headless builds of the CPU voxel tools have no debugger output window, so the log goes to stderr instead
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+inline void OutputDebugStringW(const wchar_t* s) { fputws(s, stderr); }
+#define __debugbreak() abort()
+#endif
+
 
 //Log your message along with the filename and the line number on which this log was called
 #define VS_LOG_VERBOSE( vs )													\
@@ -56,4 +69,6 @@ Some useful debugging tools/macros.
 	__debugbreak();																\
 	abort();																	\
 	}																			\
-}
\ No newline at end of file
+}
+
+#endif // !DEBUGGING_H
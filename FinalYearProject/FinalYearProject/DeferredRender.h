@@ -8,6 +8,7 @@
 #include "Texture2D.h"
 #include "LightManager.h"
 #include "VoxelisedScene.h"
+#include "GIRenderFlag.h"
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 using namespace DirectX;
@@ -20,16 +21,6 @@ enum BufferType
 	btMax
 };
 
-enum GIRenderFlag
-{
-	giNone,
-	giFull,
-	giDiff,
-	giSpec,
-	giAO,
-	giMax
-};
-
 class DeferredRender
 {
 public:
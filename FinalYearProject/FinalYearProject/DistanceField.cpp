@@ -0,0 +1,693 @@
+#include "NoFloatContraction.h"
+#include "DistanceField.h"
+#include "CPUVoxeliser.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	inline int16_t QuantiseDistance(uint32_t iSquaredDistance, bool bInside)
+	{
+		int16_t iDistance = static_cast<int16_t>(sqrtf(static_cast<float>(iSquaredDistance)) * DistanceField::kFixedPointScale + 0.5f);
+		return bInside ? -iDistance : iDistance;
+	}
+
+	//Per thread line buffers for the transforms
+	struct LineScratch
+	{
+		std::vector<uint32_t> arrIn;
+		std::vector<uint32_t> arrOut;
+		std::vector<int> arrParabolas;		//positions of the parabolas in the lower envelope
+		std::vector<double> arrBoundaries;	//where each one takes over from the one before
+		std::vector<uint16_t> arrPlane;		//x by z plane for the z pass
+
+		void Resize(int iMaxLength, size_t iPlaneSize)
+		{
+			arrIn.resize(iMaxLength);
+			arrOut.resize(iMaxLength);
+			arrParabolas.resize(iMaxLength);
+			arrBoundaries.resize(iMaxLength + 1);
+			arrPlane.resize(iPlaneSize);
+		}
+	};
+
+	//1D squared distance transform, pOut[q] = min(iCap, min over p of pIn[p] + (q - p)^2). Inputs at the cap can't
+	//bring anything under it so they're left out of the envelope, which makes lines through empty space nearly free.
+	void TransformLine(const uint32_t* pIn, int iLength, uint32_t* pOut, uint32_t iCap, int* pParabolas, double* pBoundaries)
+	{
+		int k = -1;
+		for (int q = 0; q < iLength; q++)
+		{
+			if (pIn[q] >= iCap)
+			{
+				continue;
+			}
+			long long iQ = static_cast<long long>(pIn[q]) + static_cast<long long>(q) * q;
+			double s = -DBL_MAX;
+			while (k >= 0)
+			{
+				int p = pParabolas[k];
+				long long iP = static_cast<long long>(pIn[p]) + static_cast<long long>(p) * p;
+				s = static_cast<double>(iQ - iP) / (2.0 * (q - p));
+				if (s > pBoundaries[k])
+				{
+					break;
+				}
+				k--;
+			}
+			k++;
+			pParabolas[k] = q;
+			pBoundaries[k] = k == 0 ? -DBL_MAX : s;
+		}
+		if (k < 0)
+		{
+			std::fill(pOut, pOut + iLength, iCap);
+			return;
+		}
+		pBoundaries[k + 1] = DBL_MAX;
+
+		int j = 0;
+		for (int q = 0; q < iLength; q++)
+		{
+			while (pBoundaries[j + 1] < q)
+			{
+				j++;
+			}
+			int p = pParabolas[j];
+			uint32_t iDistance = pIn[p] + static_cast<uint32_t>((q - p) * (q - p));
+			pOut[q] = std::min(iDistance, iCap);
+		}
+	}
+
+	//Brute force signed distance of one field voxel, searching the window the truncation allows
+	int16_t BruteForceDistance(const DistanceField& field, int x, int y, int z)
+	{
+		int iRes = field.GetResolution();
+		int iMaxDistance = field.GetMaxDistance();
+		uint32_t iCap = static_cast<uint32_t>(iMaxDistance * iMaxDistance);
+		bool bInside = field.IsOccupied(x, y, z);
+		uint32_t iBest = iCap;
+		for (int sz = std::max(0, z - iMaxDistance); sz <= std::min(iRes - 1, z + iMaxDistance); sz++)
+		{
+			for (int sy = std::max(0, y - iMaxDistance); sy <= std::min(iRes - 1, y + iMaxDistance); sy++)
+			{
+				for (int sx = std::max(0, x - iMaxDistance); sx <= std::min(iRes - 1, x + iMaxDistance); sx++)
+				{
+					if (field.IsOccupied(sx, sy, sz) != bInside)
+					{
+						uint32_t iDistance = static_cast<uint32_t>((sx - x) * (sx - x) + (sy - y) * (sy - y) + (sz - z) * (sz - z));
+						iBest = std::min(iBest, iDistance);
+					}
+				}
+			}
+		}
+		return QuantiseDistance(iBest, bInside);
+	}
+
+	//Boxes of random colours, like the ones OccupancyPyramid validates against
+	void FillRandomBoxes(uint32_t* pTexels, int iRes, const int vMin[3], const int vMax[3], std::mt19937& rng, int iNumBoxes)
+	{
+		std::uniform_int_distribution<uint32_t> colour(0, 0xffffffff);
+		for (int b = 0; b < iNumBoxes; b++)
+		{
+			int iBoxMin[3], iBoxMax[3];
+			for (int i = 0; i < 3; i++)
+			{
+				std::uniform_int_distribution<int> coord(vMin[i], vMax[i]);
+				iBoxMin[i] = coord(rng);
+				iBoxMax[i] = std::min(vMax[i], iBoxMin[i] + coord(rng) % std::max(1, iRes / 4));
+			}
+			//Some of them clear instead so updates take voxels away as well
+			uint32_t iColour = b % 3 == 2 ? 0 : colour(rng) | 1;
+			for (int z = iBoxMin[2]; z <= iBoxMax[2]; z++)
+			{
+				for (int y = iBoxMin[1]; y <= iBoxMax[1]; y++)
+				{
+					for (int x = iBoxMin[0]; x <= iBoxMax[0]; x++)
+					{
+						pTexels[(static_cast<size_t>(z) * iRes + y) * iRes + x] = iColour;
+					}
+				}
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DistanceField::DistanceField()
+	: m_iSourceResolution(0),
+	m_iResolution(0),
+	m_iDownsample(1),
+	m_iMaxDistance(0),
+	m_iNumThreads(0)
+{
+	m_Stats.iNumThreads = 0;
+	m_Stats.dOccupancyTimeMs = 0.0;
+	m_Stats.dTransformTimeMs = 0.0;
+	m_Stats.iNumVoxelsWritten = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DistanceField::~DistanceField()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DistanceField::Initialise(int iSourceResolution, int iDownsample, int iMaxDistance, int iNumThreads)
+{
+	if ((iDownsample != 1 && iDownsample != 2) || iSourceResolution < iDownsample || iSourceResolution % iDownsample != 0)
+	{
+		VS_LOG_VERBOSE("Distance field downsample has to be 1 or 2 and divide the resolution");
+		return false;
+	}
+	if (iMaxDistance < 1 || iMaxDistance > kMaxTruncation)
+	{
+		VS_LOG_VERBOSE("Distance field max distance out of range");
+		return false;
+	}
+
+	m_iSourceResolution = iSourceResolution;
+	m_iDownsample = iDownsample;
+	m_iResolution = iSourceResolution / iDownsample;
+	m_iMaxDistance = iMaxDistance;
+	m_iNumThreads = iNumThreads;
+
+	size_t iNumVoxels = static_cast<size_t>(m_iResolution) * m_iResolution * m_iResolution;
+	m_arrOccupancy.assign(iNumVoxels, 0);
+	m_arrField.assign(iNumVoxels, static_cast<int16_t>(iMaxDistance * kFixedPointScale));
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DistanceField::Shutdown()
+{
+	m_arrOccupancy.clear();
+	m_arrOccupancy.shrink_to_fit();
+	m_arrField.clear();
+	m_arrField.shrink_to_fit();
+	m_arrScratch.clear();
+	m_arrScratch.shrink_to_fit();
+	m_iSourceResolution = 0;
+	m_iResolution = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DistanceField::Build(const CPUVoxelVolume& volume)
+{
+	if (volume.GetResolution() != m_iSourceResolution)
+	{
+		VS_LOG_VERBOSE("Distance field and voxel volume resolutions don't match");
+		return false;
+	}
+	return Build(volume.GetMipData(0));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DistanceField::Build(const uint32_t* pMip0)
+{
+	if (m_iResolution == 0)
+	{
+		return false;
+	}
+	const int vMin[3] = { 0, 0, 0 };
+	const int vMax[3] = { m_iResolution - 1, m_iResolution - 1, m_iResolution - 1 };
+
+	auto start = std::chrono::high_resolution_clock::now();
+	UpdateOccupancy(pMip0, vMin, vMax);
+	m_Stats.dOccupancyTimeMs = GetElapsedMs(start);
+
+	Transform(vMin, vMax, vMin, vMax);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DistanceField::UpdateRegion(const uint32_t* pMip0, const int vMin[3], const int vMax[3])
+{
+	if (m_iResolution == 0)
+	{
+		return false;
+	}
+
+	int vDirtyMin[3], vDirtyMax[3], vWriteMin[3], vWriteMax[3], vSourceMin[3], vSourceMax[3];
+	for (int i = 0; i < 3; i++)
+	{
+		vDirtyMin[i] = std::max(0, vMin[i] / m_iDownsample);
+		vDirtyMax[i] = std::min(m_iResolution - 1, vMax[i] / m_iDownsample);
+		if (vDirtyMin[i] > vDirtyMax[i])
+		{
+			//Nothing of the box is in the volume
+			return true;
+		}
+		vWriteMin[i] = std::max(0, vDirtyMin[i] - m_iMaxDistance);
+		vWriteMax[i] = std::min(m_iResolution - 1, vDirtyMax[i] + m_iMaxDistance);
+		vSourceMin[i] = std::max(0, vWriteMin[i] - m_iMaxDistance);
+		vSourceMax[i] = std::min(m_iResolution - 1, vWriteMax[i] + m_iMaxDistance);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	UpdateOccupancy(pMip0, vDirtyMin, vDirtyMax);
+	m_Stats.dOccupancyTimeMs = GetElapsedMs(start);
+
+	Transform(vSourceMin, vSourceMax, vWriteMin, vWriteMax);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t DistanceField::GetMemoryUsageInBytes() const
+{
+	return m_arrOccupancy.capacity() * sizeof(uint8_t) + m_arrField.capacity() * sizeof(int16_t) + m_arrScratch.capacity() * sizeof(uint16_t);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DistanceField::UpdateOccupancy(const uint32_t* pMip0, const int vMin[3], const int vMax[3])
+{
+	int iSourceRes = m_iSourceResolution;
+	int iDownsample = m_iDownsample;
+	Parallel::For(vMax[2] - vMin[2] + 1, m_iNumThreads, [&](int iJob, int)
+	{
+		int z = vMin[2] + iJob;
+		for (int y = vMin[1]; y <= vMax[1]; y++)
+		{
+			uint8_t* pOccupancy = &m_arrOccupancy[GetIndex(0, y, z)];
+			for (int x = vMin[0]; x <= vMax[0]; x++)
+			{
+				uint32_t iAny = 0;
+				for (int dz = 0; dz < iDownsample; dz++)
+				{
+					for (int dy = 0; dy < iDownsample; dy++)
+					{
+						const uint32_t* pRow = pMip0 + (static_cast<size_t>(z * iDownsample + dz) * iSourceRes + y * iDownsample + dy) * iSourceRes + x * iDownsample;
+						for (int dx = 0; dx < iDownsample; dx++)
+						{
+							iAny |= pRow[dx];
+						}
+					}
+				}
+				pOccupancy[x] = iAny != 0 ? 1 : 0;
+			}
+		}
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DistanceField::Transform(const int vSourceMin[3], const int vSourceMax[3], const int vWriteMin[3], const int vWriteMax[3])
+{
+	int iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+	m_Stats.iNumThreads = iNumThreads;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	//Empty voxels get the distance to the nearest occupied one, then occupied ones the distance to the nearest empty one
+	TransformSide(false, vSourceMin, vSourceMax, vWriteMin, vWriteMax, iNumThreads);
+	TransformSide(true, vSourceMin, vSourceMax, vWriteMin, vWriteMax, iNumThreads);
+	m_Stats.dTransformTimeMs = GetElapsedMs(start);
+
+	m_Stats.iNumVoxelsWritten = static_cast<long long>(vWriteMax[0] - vWriteMin[0] + 1) * (vWriteMax[1] - vWriteMin[1] + 1) * (vWriteMax[2] - vWriteMin[2] + 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void DistanceField::TransformSide(bool bInside, const int vSourceMin[3], const int vSourceMax[3], const int vWriteMin[3], const int vWriteMax[3], int iNumThreads)
+{
+	const int sx = vSourceMax[0] - vSourceMin[0] + 1;
+	const int sy = vSourceMax[1] - vSourceMin[1] + 1;
+	const int sz = vSourceMax[2] - vSourceMin[2] + 1;
+	//Only the write box's columns and rows need the later passes
+	const int iWriteX0 = vWriteMin[0] - vSourceMin[0], iWriteX1 = vWriteMax[0] - vSourceMin[0];
+	const int iWriteY0 = vWriteMin[1] - vSourceMin[1], iWriteY1 = vWriteMax[1] - vSourceMin[1];
+	const int iWriteZ0 = vWriteMin[2] - vSourceMin[2], iWriteZ1 = vWriteMax[2] - vSourceMin[2];
+	const uint32_t iCap = static_cast<uint32_t>(m_iMaxDistance * m_iMaxDistance);
+	const uint8_t iSite = bInside ? 0 : 1;
+
+	m_arrScratch.resize(static_cast<size_t>(sx) * sy * sz);
+	std::vector<LineScratch> arrLines(iNumThreads);
+	int iMaxLength = std::max(sx, std::max(sy, sz));
+	for (int t = 0; t < iNumThreads; t++)
+	{
+		arrLines[t].Resize(iMaxLength, static_cast<size_t>(iWriteX1 - iWriteX0 + 1) * sz);
+	}
+
+	//x then y, a job per z slice so each one stays in cache
+	Parallel::For(sz, iNumThreads, [&](int z, int iThread)
+	{
+		LineScratch& lines = arrLines[iThread];
+		uint16_t* pSlice = &m_arrScratch[static_cast<size_t>(z) * sx * sy];
+
+		//Along x the inputs are just sites or not, so it's the distance to the nearest site either side
+		for (int y = 0; y < sy; y++)
+		{
+			const uint8_t* pOccupancy = &m_arrOccupancy[GetIndex(vSourceMin[0], vSourceMin[1] + y, vSourceMin[2] + z)];
+			uint16_t* pRow = pSlice + static_cast<size_t>(y) * sx;
+			int iLastSite = -m_iMaxDistance - 1;
+			for (int x = 0; x < sx; x++)
+			{
+				if (pOccupancy[x] == iSite)
+				{
+					iLastSite = x;
+				}
+				lines.arrOut[x] = std::min(iCap, static_cast<uint32_t>((x - iLastSite) * (x - iLastSite)));
+			}
+			iLastSite = sx + m_iMaxDistance;
+			for (int x = sx - 1; x >= 0; x--)
+			{
+				if (pOccupancy[x] == iSite)
+				{
+					iLastSite = x;
+				}
+				pRow[x] = static_cast<uint16_t>(std::min(lines.arrOut[x], static_cast<uint32_t>((iLastSite - x) * (iLastSite - x))));
+			}
+		}
+
+		for (int x = iWriteX0; x <= iWriteX1; x++)
+		{
+			bool bAnySite = false;
+			for (int y = 0; y < sy; y++)
+			{
+				lines.arrIn[y] = pSlice[static_cast<size_t>(y) * sx + x];
+				bAnySite |= lines.arrIn[y] < iCap;
+			}
+			if (!bAnySite)
+			{
+				continue;
+			}
+			TransformLine(lines.arrIn.data(), sy, lines.arrOut.data(), iCap, lines.arrParabolas.data(), lines.arrBoundaries.data());
+			for (int y = 0; y < sy; y++)
+			{
+				pSlice[static_cast<size_t>(y) * sx + x] = static_cast<uint16_t>(lines.arrOut[y]);
+			}
+		}
+	});
+
+	//z, a job per row of the write box. The row's x by z plane is gathered into a contiguous buffer a slice at a time
+	//so the strided reads and writes each touch a whole row.
+	const int iPlaneWidth = iWriteX1 - iWriteX0 + 1;
+	Parallel::For(iWriteY1 - iWriteY0 + 1, iNumThreads, [&](int iJob, int iThread)
+	{
+		LineScratch& lines = arrLines[iThread];
+		int y = iWriteY0 + iJob;
+		uint16_t* pPlane = lines.arrPlane.data();
+		for (int z = 0; z < sz; z++)
+		{
+			const uint16_t* pRow = &m_arrScratch[(static_cast<size_t>(z) * sy + y) * sx + iWriteX0];
+			for (int x = 0; x < iPlaneWidth; x++)
+			{
+				pPlane[static_cast<size_t>(x) * sz + z] = pRow[x];
+			}
+		}
+
+		for (int x = 0; x < iPlaneWidth; x++)
+		{
+			uint16_t* pLine = pPlane + static_cast<size_t>(x) * sz;
+			bool bAnySite = false;
+			for (int z = 0; z < sz; z++)
+			{
+				lines.arrIn[z] = pLine[z];
+				bAnySite |= pLine[z] < iCap;
+			}
+			if (!bAnySite)
+			{
+				continue;
+			}
+			TransformLine(lines.arrIn.data(), sz, lines.arrOut.data(), iCap, lines.arrParabolas.data(), lines.arrBoundaries.data());
+			for (int z = 0; z < sz; z++)
+			{
+				pLine[z] = static_cast<uint16_t>(lines.arrOut[z]);
+			}
+		}
+
+		//Only this side's voxels, the other transform writes the rest
+		for (int z = iWriteZ0; z <= iWriteZ1; z++)
+		{
+			size_t iIndex = GetIndex(vWriteMin[0], vSourceMin[1] + y, vSourceMin[2] + z);
+			const uint8_t* pOccupancy = &m_arrOccupancy[iIndex];
+			int16_t* pField = &m_arrField[iIndex];
+			for (int x = 0; x < iPlaneWidth; x++)
+			{
+				if (pOccupancy[x] != iSite)
+				{
+					pField[x] = QuantiseDistance(pPlane[static_cast<size_t>(x) * sz + z], bInside);
+				}
+			}
+		}
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int DistanceField::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	struct Config
+	{
+		int iSourceResolution;
+		int iDownsample;
+		int iMaxDistance;
+	};
+	//Truncated and not, at both downsamples
+	const Config configs[] = { { 16, 1, 4 }, { 32, 1, 8 }, { 32, 2, 5 }, { 16, 1, 255 }, { 64, 2, 255 }, { 48, 1, 7 } };
+	for (int c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+	{
+		const Config& config = configs[c];
+		int iRes = config.iSourceResolution;
+		std::vector<uint32_t> arrTexels(static_cast<size_t>(iRes) * iRes * iRes, 0);
+		const int vAllMin[3] = { 0, 0, 0 };
+		const int vAllMax[3] = { iRes - 1, iRes - 1, iRes - 1 };
+		FillRandomBoxes(arrTexels.data(), iRes, vAllMin, vAllMax, rng, 4 + c * 2);
+
+		DistanceField field;
+		if (!field.Initialise(iRes, config.iDownsample, config.iMaxDistance, 1 + c % 3))
+		{
+			iFailures++;
+			continue;
+		}
+		field.Build(arrTexels.data());
+
+		int iFieldRes = field.GetResolution();
+		for (int z = 0; z < iFieldRes; z++)
+		{
+			for (int y = 0; y < iFieldRes; y++)
+			{
+				for (int x = 0; x < iFieldRes; x++)
+				{
+					//Occupancy straight from the texels, then the distance by searching every voxel
+					bool bOccupied = false;
+					for (int d = 0; d < config.iDownsample * config.iDownsample * config.iDownsample; d++)
+					{
+						int dx = d % config.iDownsample, dy = (d / config.iDownsample) % config.iDownsample, dz = d / (config.iDownsample * config.iDownsample);
+						bOccupied |= arrTexels[(static_cast<size_t>(z * config.iDownsample + dz) * iRes + y * config.iDownsample + dy) * iRes + x * config.iDownsample + dx] != 0;
+					}
+					if (bOccupied != field.IsOccupied(x, y, z))
+					{
+						iFailures++;
+						continue;
+					}
+					if (field.m_arrField[field.GetIndex(x, y, z)] != BruteForceDistance(field, x, y, z))
+					{
+						iFailures++;
+					}
+				}
+			}
+		}
+
+		//Random changes in boxes, each update against building the whole field again
+		for (int u = 0; u < 4; u++)
+		{
+			int vMin[3], vMax[3];
+			for (int i = 0; i < 3; i++)
+			{
+				std::uniform_int_distribution<int> coord(0, iRes - 1);
+				vMin[i] = coord(rng);
+				vMax[i] = std::min(iRes - 1, vMin[i] + coord(rng) / 3);
+			}
+			FillRandomBoxes(arrTexels.data(), iRes, vMin, vMax, rng, 3);
+			field.UpdateRegion(arrTexels.data(), vMin, vMax);
+
+			DistanceField reference;
+			reference.Initialise(iRes, config.iDownsample, config.iMaxDistance, 1);
+			reference.Build(arrTexels.data());
+			if (field.m_arrField != reference.m_arrField || field.m_arrOccupancy != reference.m_arrOccupancy)
+			{
+				iFailures++;
+			}
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Distance field disagrees with brute force");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DistanceField::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolutions[] = { 256, 512 };
+	const int iDownsamples[] = { 1, 2 };
+	const int iMaxDistance = 16;
+	const int iNumRuns = 2;
+	const int iNumFrames = 16;
+	const int iNumErrorSamples = 4096;
+
+	std::stringstream ss;
+	ss << "../Results/DistanceField_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open distance field benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Field Resolution, Max Distance, Operation, Threads, Occupancy ms, Transform ms, Total ms, Voxels Written, Matches\n";
+
+	std::stringstream summary;
+	bool bAllMatch = true;
+	std::mt19937 rng(1);
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolution, 1))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&volume);
+		const uint32_t* pStaticTexels = volume.GetMipData(0);
+
+		for (int d = 0; d < sizeof(iDownsamples) / sizeof(iDownsamples[0]); d++)
+		{
+			DistanceField field;
+			if (!field.Initialise(iResolution, iDownsamples[d], iMaxDistance))
+			{
+				continue;
+			}
+			int iFieldRes = field.GetResolution();
+
+			const int iThreadCounts[] = { 1, Parallel::GetNumWorkerThreads() };
+			std::vector<int16_t> arrReference;
+			for (int t = 0; t < 2; t++)
+			{
+				field.SetNumThreads(iThreadCounts[t]);
+
+				//Full builds, best of a few
+				Stats best = field.m_Stats;
+				best.dOccupancyTimeMs = DBL_MAX;
+				best.dTransformTimeMs = 0.0;
+				for (int i = 0; i < iNumRuns; i++)
+				{
+					field.Build(pStaticTexels);
+					if (field.m_Stats.dOccupancyTimeMs + field.m_Stats.dTransformTimeMs < best.dOccupancyTimeMs + best.dTransformTimeMs)
+					{
+						best = field.m_Stats;
+					}
+				}
+				if (arrReference.empty())
+				{
+					arrReference = field.m_arrField;
+				}
+				bool bMatch = field.m_arrField == arrReference;
+				bAllMatch &= bMatch;
+				outfile << iResolution << "," << iFieldRes << "," << iMaxDistance << ",Build," << iThreadCounts[t] << "," << best.dOccupancyTimeMs << ","
+					<< best.dTransformTimeMs << "," << best.dOccupancyTimeMs + best.dTransformTimeMs << "," << best.iNumVoxelsWritten << "," << (bMatch ? "Yes" : "No") << "\n";
+
+				//A cube the size of a dynamic mesh moving across the middle of the volume a couple of voxels a frame,
+				//updating the old and new bounds together each frame
+				std::vector<uint32_t> arrTexels(pStaticTexels, pStaticTexels + static_cast<size_t>(iResolution) * iResolution * iResolution);
+				int iCubeSize = iResolution / 32;
+				int iStep = 2;
+				int vCube[3] = { iResolution / 4, iResolution / 2, iResolution / 2 };
+				double dOccupancyMs = 0.0, dTransformMs = 0.0;
+				long long iVoxelsWritten = 0;
+				for (int f = 0; f < iNumFrames; f++)
+				{
+					int vMin[3] = { vCube[0], vCube[1], vCube[2] };
+					int vMax[3] = { vCube[0] + iCubeSize - 1 + iStep, vCube[1] + iCubeSize - 1, vCube[2] + iCubeSize - 1 };
+					for (int z = vMin[2]; z <= vMax[2]; z++)
+					{
+						for (int y = vMin[1]; y <= vMax[1]; y++)
+						{
+							for (int x = vMin[0]; x <= vMax[0]; x++)
+							{
+								size_t iIndex = (static_cast<size_t>(z) * iResolution + y) * iResolution + x;
+								bool bInCube = x >= vCube[0] + iStep;
+								arrTexels[iIndex] = bInCube ? 0xff0000ff : pStaticTexels[iIndex];
+							}
+						}
+					}
+					vCube[0] += iStep;
+
+					field.UpdateRegion(arrTexels.data(), vMin, vMax);
+					dOccupancyMs += field.m_Stats.dOccupancyTimeMs;
+					dTransformMs += field.m_Stats.dTransformTimeMs;
+					iVoxelsWritten += field.m_Stats.iNumVoxelsWritten;
+				}
+				std::vector<int16_t> arrUpdated = field.m_arrField;
+				field.Build(arrTexels.data());
+				bMatch = arrUpdated == field.m_arrField;
+				bAllMatch &= bMatch;
+				outfile << iResolution << "," << iFieldRes << "," << iMaxDistance << ",Update " << iCubeSize << "^3 Box," << iThreadCounts[t] << "," << dOccupancyMs / iNumFrames << ","
+					<< dTransformMs / iNumFrames << "," << (dOccupancyMs + dTransformMs) / iNumFrames << "," << iVoxelsWritten / iNumFrames << "," << (bMatch ? "Yes" : "No") << "\n";
+			}
+
+			//Error at random voxels of the static field against searching their neighbourhoods
+			field.Build(pStaticTexels);
+			std::uniform_int_distribution<int> coord(0, iFieldRes - 1);
+			double dMaxError = 0.0, dTotalError = 0.0;
+			int iExact = 0;
+			for (int i = 0; i < iNumErrorSamples; i++)
+			{
+				int x = coord(rng), y = coord(rng), z = coord(rng);
+				int iExpected = BruteForceDistance(field, x, y, z);
+				double dError = fabs(static_cast<double>(field.m_arrField[field.GetIndex(x, y, z)] - iExpected)) / kFixedPointScale;
+				dMaxError = std::max(dMaxError, dError);
+				dTotalError += dError;
+				iExact += dError == 0.0 ? 1 : 0;
+			}
+			bAllMatch &= dMaxError == 0.0;
+			summary << "\n" << iResolution << " -> " << iFieldRes << " Brute Force Samples:," << iNumErrorSamples;
+			summary << "\n" << iResolution << " -> " << iFieldRes << " Exact Samples:," << iExact;
+			summary << "\n" << iResolution << " -> " << iFieldRes << " Max Error (voxels):," << dMaxError;
+			summary << "\n" << iResolution << " -> " << iFieldRes << " Mean Error (voxels):," << dTotalError / iNumErrorSamples;
+			summary << "\n" << iResolution << " -> " << iFieldRes << " Memory(MB):," << field.GetMemoryUsageInBytes() / (1024.f * 1024.f);
+		}
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	if (!bAllMatch)
+	{
+		VS_LOG_VERBOSE("Distance field update or thread count changed the result");
+	}
+	return bAllMatch && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
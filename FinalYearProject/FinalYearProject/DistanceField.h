@@ -0,0 +1,104 @@
+#ifndef DISTANCE_FIELD_H
+#define DISTANCE_FIELD_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Signed distance from every voxel of the radiance volume's occupancy to the nearest voxel of the other kind, for
+//sphere tracing cones and cheap AO. Empty voxels get the distance to the nearest occupied voxel's centre, occupied
+//ones minus the distance to the nearest empty one, both in field voxels and truncated to the max distance.
+//Built with Felzenszwalb's separable exact transform (one pass per axis) on the squared distances, either at the
+//volume's resolution or half of it where a field voxel is occupied if any of the 2x2x2 under it are.
+//Stored as int16_t fixed point, kFixedPointScale a voxel, x fastest then y then z so it can go straight into a
+//R16_SINT texture.
+class DistanceField
+{
+public:
+
+	static const int kFixedPointScale = 128;
+	static const int kMaxTruncation = 255;		//so the truncated squared distances fit the uint16_t scratch
+
+	struct Stats
+	{
+		int iNumThreads;
+		double dOccupancyTimeMs;	//downsampling the volume to the field's occupancy
+		double dTransformTimeMs;	//both transforms
+		long long iNumVoxelsWritten;
+	};
+
+	DistanceField();
+	~DistanceField();
+
+	//iSourceResolution is the radiance volume's and iDownsample 1 or 2. iNumThreads <= 0 uses every core.
+	bool Initialise(int iSourceResolution, int iDownsample, int iMaxDistance = 16, int iNumThreads = 0);
+	void Shutdown();
+
+	void SetNumThreads(int iNumThreads) { m_iNumThreads = iNumThreads; }
+
+	//Rebuilds the whole field. Mip 0 has to be the source resolution, non zero texels are occupied.
+	bool Build(const CPUVoxelVolume& volume);
+	bool Build(const uint32_t* pMip0);
+
+	//Recomputes just the part of the field a change to the source voxels [vMin, vMax] (inclusive, source voxels) can
+	//reach, which is the box grown by the max distance. A dynamic mesh that moved passes its old and new bounds.
+	//pMip0 has to already have the change in it. The result is the same as a full Build.
+	bool UpdateRegion(const uint32_t* pMip0, const int vMin[3], const int vMax[3]);
+
+	int GetSourceResolution() const { return m_iSourceResolution; }
+	int GetResolution() const { return m_iResolution; }
+	int GetDownsample() const { return m_iDownsample; }
+	int GetMaxDistance() const { return m_iMaxDistance; }
+
+	size_t GetIndex(int x, int y, int z) const { return (static_cast<size_t>(z) * m_iResolution + y) * m_iResolution + x; }
+	//In field voxels, negative inside
+	float GetDistance(int x, int y, int z) const { return static_cast<float>(m_arrField[GetIndex(x, y, z)]) / kFixedPointScale; }
+	bool IsOccupied(int x, int y, int z) const { return m_arrOccupancy[GetIndex(x, y, z)] != 0; }
+
+	const int16_t* GetData() const { return m_arrField.data(); }
+	size_t GetSizeInBytes() const { return m_arrField.size() * sizeof(int16_t); }
+	const Stats& GetStats() const { return m_Stats; }
+	size_t GetMemoryUsageInBytes() const;
+
+	//Random volumes at both downsamples against a brute force search, and random updates against full builds.
+	//Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Builds the voxeliser's triangles at 256^3 and 512^3, times full builds and updates for a moving box on one thread
+	//and every thread, and reports the error against brute force at sampled voxels to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	//Field voxels [vMin, vMax] of the occupancy from the source
+	void UpdateOccupancy(const uint32_t* pMip0, const int vMin[3], const int vMax[3]);
+	//Transforms the box [vSourceMin, vSourceMax] of the field and writes the voxels in [vWriteMin, vWriteMax] of it.
+	//Anything further than the max distance from the write box can't change it, so the source box only needs to be
+	//the write box grown by that much.
+	void Transform(const int vSourceMin[3], const int vSourceMax[3], const int vWriteMin[3], const int vWriteMax[3]);
+	void TransformSide(bool bInside, const int vSourceMin[3], const int vSourceMax[3], const int vWriteMin[3], const int vWriteMax[3], int iNumThreads);
+
+	int m_iSourceResolution;
+	int m_iResolution;
+	int m_iDownsample;
+	int m_iMaxDistance;
+	int m_iNumThreads;
+
+	std::vector<uint8_t> m_arrOccupancy;
+	std::vector<int16_t> m_arrField;
+	std::vector<uint16_t> m_arrScratch;		//squared distances after the x and y passes, over the source box
+
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !DISTANCE_FIELD_H
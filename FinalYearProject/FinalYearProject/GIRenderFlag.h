@@ -0,0 +1,20 @@
+#ifndef GI_RENDER_FLAG_H
+#define GI_RENDER_FLAG_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Which part of the global illumination the lighting pass shows. Kept out of DeferredRender.h so the CPU cone tracer
+//can use it without D3D.
+enum GIRenderFlag
+{
+	giNone,
+	giFull,
+	giDiff,
+	giSpec,
+	giAO,
+	giMax
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !GI_RENDER_FLAG_H
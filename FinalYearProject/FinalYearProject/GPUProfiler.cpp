@@ -3,6 +3,8 @@
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <climits>
+#include <algorithm>
 
 GPUProfiler* GPUProfiler::s_pTheInstance = nullptr;
 
@@ -14,6 +16,16 @@ GPUProfiler::GPUProfiler()
 	, m_fAverageImageDifference(0)
 	, m_fMaxImageDifference(0)
 	, m_fMinImageDifference(FLT_MAX)
+	, m_iVoxelsTouchedThisFrame(0)
+	, m_dStoredVoxelsTouchedAverage(0)
+	, m_iStoredVoxelsTouchedMax(0)
+	, m_iStoredVoxelsTouchedMin(LLONG_MAX)
+	, m_iRegionsUpdatedThisFrame(-1)
+	, m_iMaxStalenessThisFrame(-1)
+	, m_iTileMappingCallsThisFrame(-1)
+	, m_iTilesMappedThisFrame(-1)
+	, m_iTileMappingBacklogThisFrame(-1)
+	, m_fTileResidencyLatencyThisFrame(-1.f)
 {
 	for (int i = 0; i < ProfiledSections::psMax; i++)
 	{
@@ -86,6 +98,14 @@ bool GPUProfiler::Initialise(ID3D11Device* pDevice)
 
 void GPUProfiler::BeginFrame(ID3D11DeviceContext* pContext)
 {
+	//Only the render modes that have these set them, so they'd otherwise carry over when switching to one that doesn't
+	m_iRegionsUpdatedThisFrame = -1;
+	m_iMaxStalenessThisFrame = -1;
+	m_iTileMappingCallsThisFrame = -1;
+	m_iTilesMappedThisFrame = -1;
+	m_iTileMappingBacklogThisFrame = -1;
+	m_fTileResidencyLatencyThisFrame = -1.f;
+
 	if (m_pFontWrapper)
 	{
 		pContext->Begin(m_pDisjointQuery[m_iCurrentBufferIndex]);
@@ -177,11 +197,75 @@ void GPUProfiler::DisplayTimes(ID3D11DeviceContext* pContext, float CPUFrameTime
 				m_fMinImageDifference = fImageDifferencePercentage;
 			}
 
+			m_dStoredVoxelsTouchedAverage += static_cast<double>(m_iVoxelsTouchedThisFrame);
+			if (m_iVoxelsTouchedThisFrame > m_iStoredVoxelsTouchedMax)
+			{
+				m_iStoredVoxelsTouchedMax = m_iVoxelsTouchedThisFrame;
+			}
+			if (m_iVoxelsTouchedThisFrame < m_iStoredVoxelsTouchedMin)
+			{
+				m_iStoredVoxelsTouchedMin = m_iVoxelsTouchedThisFrame;
+			}
+			if (m_iRegionsUpdatedThisFrame >= 0)
+			{
+				m_arrStoredRegionsUpdated.push_back(m_iRegionsUpdatedThisFrame);
+				m_arrStoredMaxStaleness.push_back(m_iMaxStalenessThisFrame);
+			}
+			if (m_iTileMappingCallsThisFrame >= 0)
+			{
+				m_arrStoredTileMappingCalls.push_back(m_iTileMappingCallsThisFrame);
+				m_arrStoredTilesMapped.push_back(m_iTilesMappedThisFrame);
+			}
+			if (m_iTileMappingBacklogThisFrame >= 0)
+			{
+				m_arrStoredTileMappingBacklog.push_back(m_iTileMappingBacklogThisFrame);
+				m_StoredTileMappingLatency.Add(m_TileMappingLatencyThisFrame);
+			}
+			if (m_fTileResidencyLatencyThisFrame >= 0.f)
+			{
+				m_arrStoredTileResidencyLatency.push_back(m_fTileResidencyLatencyThisFrame);
+			}
+
 			m_iNumFramesProfiled++;
 		}
 		m_pFontWrapper->DrawString(pContext, wideCPUFrameString.c_str(), textSize, xPos, yPos, TextColour, 0);
 		yPos += textSize;
 
+		stringstream VoxelsTouchedSs;
+		VoxelsTouchedSs << "Voxels Touched:     " << m_iVoxelsTouchedThisFrame;
+		string sVoxelsTouchedString = VoxelsTouchedSs.str();
+		std::wstring wideVoxelsTouchedString(sVoxelsTouchedString.begin(), sVoxelsTouchedString.end());
+		m_pFontWrapper->DrawString(pContext, wideVoxelsTouchedString.c_str(), textSize, xPos, yPos, TextColour, 0);
+		yPos += textSize;
+
+		if (m_iRegionsUpdatedThisFrame >= 0)
+		{
+			stringstream RegionsUpdatedSs;
+			RegionsUpdatedSs << "Regions Updated:    " << m_iRegionsUpdatedThisFrame << " (max staleness " << m_iMaxStalenessThisFrame << ")";
+			string sRegionsUpdatedString = RegionsUpdatedSs.str();
+			std::wstring wideRegionsUpdatedString(sRegionsUpdatedString.begin(), sRegionsUpdatedString.end());
+			m_pFontWrapper->DrawString(pContext, wideRegionsUpdatedString.c_str(), textSize, xPos, yPos, TextColour, 0);
+			yPos += textSize;
+		}
+
+		if (m_iTileMappingCallsThisFrame >= 0)
+		{
+			stringstream TileMappingSs;
+			TileMappingSs << "Tile Mapping Calls: " << m_iTileMappingCallsThisFrame << " (" << m_iTilesMappedThisFrame << " tiles)";
+			if (m_iTileMappingBacklogThisFrame >= 0)
+			{
+				TileMappingSs << " " << m_iTileMappingBacklogThisFrame << " waiting";
+			}
+			if (m_fTileResidencyLatencyThisFrame >= 0.f)
+			{
+				TileMappingSs << std::fixed << std::setprecision(2) << " " << m_fTileResidencyLatencyThisFrame << "ms behind";
+			}
+			string sTileMappingString = TileMappingSs.str();
+			std::wstring wideTileMappingString(sTileMappingString.begin(), sTileMappingString.end());
+			m_pFontWrapper->DrawString(pContext, wideTileMappingString.c_str(), textSize, xPos, yPos, TextColour, 0);
+			yPos += textSize;
+		}
+
 		stringstream TileUpdateSs;
 		TileUpdateSs << std::fixed << std::setprecision(2) << "CPU Tile Update Time:" << CPUTileUpdateTime << "ms";
 		string sTileUpdateString = TileUpdateSs.str();
@@ -229,6 +313,7 @@ void GPUProfiler::OutputStoredTimesToFile(const char* gpuName, int gpuMemInMB, c
 		//Get the averages as up to now just accumulated values..
 		m_fStoredCPUAverageTime /= static_cast<float>(m_iNumFramesProfiled);
 		m_fAverageImageDifference /= static_cast<float>(m_iNumFramesProfiled);
+		m_dStoredVoxelsTouchedAverage /= static_cast<double>(m_iNumFramesProfiled);
 
 		std::stringstream ss;
 		ss << "../Results/" << gpuName << "_" << gpuMemInMB << "MB_" << voxelStorageType << "_" << iResolution << ".csv";
@@ -243,8 +328,94 @@ void GPUProfiler::OutputStoredTimesToFile(const char* gpuName, int gpuMemInMB, c
 			outfile << m_arrProfiledSectionNames[i] << "," << m_arrStoredGPUAverageTimes[i] << "," << m_arrStoredGPUMinTimes[i] << "," << m_arrStoredGPUMaxTimes[i] << "\n";
 		}
 		outfile << "Image Comparison Difference," << m_fAverageImageDifference << "," << m_fMinImageDifference << "," << m_fMaxImageDifference << "\n";
+		outfile << "Voxels Touched," << m_dStoredVoxelsTouchedAverage << "," << m_iStoredVoxelsTouchedMin << "," << m_iStoredVoxelsTouchedMax << "\n";
+		if (!m_arrStoredRegionsUpdated.empty())
+		{
+			double dRegionsAverage = 0;
+			double dStalenessAverage = 0;
+			for (int i = 0; i < m_arrStoredRegionsUpdated.size(); i++)
+			{
+				dRegionsAverage += m_arrStoredRegionsUpdated[i];
+				dStalenessAverage += m_arrStoredMaxStaleness[i];
+			}
+			dRegionsAverage /= m_arrStoredRegionsUpdated.size();
+			dStalenessAverage /= m_arrStoredMaxStaleness.size();
+			outfile << "Regions Updated," << dRegionsAverage << "," << *std::min_element(m_arrStoredRegionsUpdated.begin(), m_arrStoredRegionsUpdated.end()) << ","
+				<< *std::max_element(m_arrStoredRegionsUpdated.begin(), m_arrStoredRegionsUpdated.end()) << "\n";
+			outfile << "Max Region Staleness," << dStalenessAverage << "," << *std::min_element(m_arrStoredMaxStaleness.begin(), m_arrStoredMaxStaleness.end()) << ","
+				<< *std::max_element(m_arrStoredMaxStaleness.begin(), m_arrStoredMaxStaleness.end()) << "\n";
+		}
+		if (!m_arrStoredTileMappingCalls.empty())
+		{
+			long long iTotalCalls = 0;
+			long long iTotalTiles = 0;
+			for (int i = 0; i < m_arrStoredTileMappingCalls.size(); i++)
+			{
+				iTotalCalls += m_arrStoredTileMappingCalls[i];
+				iTotalTiles += m_arrStoredTilesMapped[i];
+			}
+			double dCallsAverage = static_cast<double>(iTotalCalls) / m_arrStoredTileMappingCalls.size();
+			outfile << "Tile Mapping Calls," << dCallsAverage << "," << *std::min_element(m_arrStoredTileMappingCalls.begin(), m_arrStoredTileMappingCalls.end()) << ","
+				<< *std::max_element(m_arrStoredTileMappingCalls.begin(), m_arrStoredTileMappingCalls.end()) << "\n";
+			outfile << "Tiles Per Mapping Call," << (iTotalCalls > 0 ? static_cast<double>(iTotalTiles) / iTotalCalls : 0.0) << "\n";
+		}
+		if (!m_arrStoredTileMappingBacklog.empty())
+		{
+			double dBacklogAverage = 0;
+			for (int i = 0; i < m_arrStoredTileMappingBacklog.size(); i++)
+			{
+				dBacklogAverage += m_arrStoredTileMappingBacklog[i];
+			}
+			dBacklogAverage /= m_arrStoredTileMappingBacklog.size();
+			outfile << "Tile Mapping Backlog," << dBacklogAverage << "," << *std::min_element(m_arrStoredTileMappingBacklog.begin(), m_arrStoredTileMappingBacklog.end()) << ","
+				<< *std::max_element(m_arrStoredTileMappingBacklog.begin(), m_arrStoredTileMappingBacklog.end()) << "\n";
+		}
+		if (!m_arrStoredTileResidencyLatency.empty())
+		{
+			double dLatencyAverage = 0;
+			for (int i = 0; i < m_arrStoredTileResidencyLatency.size(); i++)
+			{
+				dLatencyAverage += m_arrStoredTileResidencyLatency[i];
+			}
+			dLatencyAverage /= m_arrStoredTileResidencyLatency.size();
+			outfile << "Tile Residency Latency(ms)," << dLatencyAverage << "," << *std::min_element(m_arrStoredTileResidencyLatency.begin(), m_arrStoredTileResidencyLatency.end()) << ","
+				<< *std::max_element(m_arrStoredTileResidencyLatency.begin(), m_arrStoredTileResidencyLatency.end()) << "\n";
+		}
 		outfile << "\nMemory Usage(MB):," << MemUsage;
 
+		if (!m_arrStoredRegionsUpdated.empty())
+		{
+			outfile << "\n\nFrame, Regions Updated, Max Region Staleness\n";
+			for (int i = 0; i < m_arrStoredRegionsUpdated.size(); i++)
+			{
+				outfile << i << "," << m_arrStoredRegionsUpdated[i] << "," << m_arrStoredMaxStaleness[i] << "\n";
+			}
+		}
+
+		if (!m_arrStoredTileMappingBacklog.empty())
+		{
+			//Frames from a tile being read back occupied to it being mapped
+			outfile << "\n\nTile Mapping Latency(frames)";
+			for (int i = 0; i < TileMappingScheduler::LatencyHistogram::kNumBuckets; i++)
+			{
+				outfile << "," << TileMappingScheduler::LatencyHistogram::GetBucketName(i);
+			}
+			outfile << "\n";
+			for (int m = 0; m < TileMappingScheduler::LatencyHistogram::kMaxMipLevels; m++)
+			{
+				if (m_StoredTileMappingLatency.GetTotal(m) == 0)
+				{
+					continue;
+				}
+				outfile << "Mip " << m;
+				for (int i = 0; i < TileMappingScheduler::LatencyHistogram::kNumBuckets; i++)
+				{
+					outfile << "," << m_StoredTileMappingLatency.arrCounts[m][i];
+				}
+				outfile << "\n";
+			}
+		}
+
 		outfile.close();
 		//Reset Times Stored
 		m_fStoredCPUAverageTime = 0;
@@ -255,6 +426,17 @@ void GPUProfiler::OutputStoredTimesToFile(const char* gpuName, int gpuMemInMB, c
 		m_fMaxImageDifference = 0;
 		m_fMinImageDifference = FLT_MAX;
 
+		m_dStoredVoxelsTouchedAverage = 0;
+		m_iStoredVoxelsTouchedMax = 0;
+		m_iStoredVoxelsTouchedMin = LLONG_MAX;
+		m_arrStoredRegionsUpdated.clear();
+		m_arrStoredMaxStaleness.clear();
+		m_arrStoredTileMappingCalls.clear();
+		m_arrStoredTilesMapped.clear();
+		m_arrStoredTileMappingBacklog.clear();
+		m_StoredTileMappingLatency.Clear();
+		m_arrStoredTileResidencyLatency.clear();
+
 		for (int i = 0; i < ProfiledSections::psMax; i++)
 		{
 			m_arrStoredGPUMinTimes[i] = FLT_MAX;
@@ -5,6 +5,7 @@
 #include <string>
 #include "../FW1FontWrapper/FW1FontWrapper.h"
 #include <vector>
+#include "TileMappingScheduler.h"
 
 using namespace std;
 
@@ -42,6 +43,22 @@ public:
 	void StartTimeStamp(ID3D11DeviceContext* pContext, ProfiledSections eSectionID);
 	void EndTimeStamp(ID3D11DeviceContext* pContext, ProfiledSections eSectionID);
 
+	//Voxels the voxelisation stages wrote to this frame, shown and stored alongside the times
+	void SetVoxelsTouched(long long iVoxelsTouched) { m_iVoxelsTouchedThisFrame = iVoxelsTouched; }
+	//Regions the amortised voxel updates relit this frame and the most frames any region has gone without, stored
+	//for every profiled frame. Back to -1 each BeginFrame, and left there when the volume isn't amortised.
+	void SetRegionsUpdated(int iRegionsUpdated, int iMaxStaleness) { m_iRegionsUpdatedThisFrame = iRegionsUpdated; m_iMaxStalenessThisFrame = iMaxStaleness; }
+	//UpdateTileMappings calls the tile update made this frame and the tiles they mapped or unmapped, stored for every
+	//profiled frame. Back to -1 each BeginFrame, and left there without tiled resources.
+	void SetTileMappingCalls(int iCalls, int iTiles) { m_iTileMappingCallsThisFrame = iCalls; m_iTilesMappedThisFrame = iTiles; }
+	//Maps left waiting for the budget this frame and how long the maps let through had waited, stored for every
+	//profiled frame and written out as a latency histogram a mip. Back to -1 each BeginFrame, and left there without
+	//tiled resources.
+	void SetTileMappingSchedule(const TileMappingScheduler::FrameStats& stats) { m_iTileMappingBacklogThisFrame = stats.iNumPending; m_TileMappingLatencyThisFrame = stats.latency; }
+	//From the tile occupation being read back to its mappings being applied, stored for every profiled frame. Back to
+	//-1 each BeginFrame, and left there without tiled resources.
+	void SetTileResidencyLatency(float fLatencyMs) { m_fTileResidencyLatencyThisFrame = fLatencyMs; }
+
 	void DisplayTimes(ID3D11DeviceContext* pContext, float CPUFrameTime, float CPUTileUpdateTime, float fImageDifferencePercentage, bool bProfilingRun);
 	void OutputStoredTimesToFile(const char* gpuName, int gpuMemInMB, const char* voxelStorageType, int iResolution, int MemUsage);
 
@@ -66,6 +83,24 @@ private:
 	float m_fMaxImageDifference;
 	float m_fMinImageDifference;
 	float m_fAverageImageDifference;
+	long long m_iVoxelsTouchedThisFrame;
+	double m_dStoredVoxelsTouchedAverage;
+	long long m_iStoredVoxelsTouchedMax;
+	long long m_iStoredVoxelsTouchedMin;
+	int m_iRegionsUpdatedThisFrame;
+	int m_iMaxStalenessThisFrame;
+	vector<int> m_arrStoredRegionsUpdated;
+	vector<int> m_arrStoredMaxStaleness;
+	int m_iTileMappingCallsThisFrame;
+	int m_iTilesMappedThisFrame;
+	vector<int> m_arrStoredTileMappingCalls;
+	vector<int> m_arrStoredTilesMapped;
+	int m_iTileMappingBacklogThisFrame;
+	TileMappingScheduler::LatencyHistogram m_TileMappingLatencyThisFrame;
+	vector<int> m_arrStoredTileMappingBacklog;
+	TileMappingScheduler::LatencyHistogram m_StoredTileMappingLatency;
+	float m_fTileResidencyLatencyThisFrame;
+	vector<float> m_arrStoredTileResidencyLatency;
 
 	ID3D11Query* m_pBeginFrame[2];
 	ID3D11Query* m_pDisjointQuery[2];
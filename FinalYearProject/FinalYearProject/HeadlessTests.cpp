@@ -0,0 +1,122 @@
+//Entry point for the headless test build (see CMakeLists.txt next to the solution). Runs the Validate self test of
+//every module that has one and doesn't need a window or a device, and exits non-zero if any of them fail. A module
+//that gets a Validate goes in s_arrTests below and in the CMake test list.
+//
+//Usage: HeadlessTests [NumSeeds] [Module]
+//Seeds start at 1. With a module name only that module's tests are run.
+
+#include "TriangleBoxOverlap.h"
+#include "VoxelClipmap.h"
+#include "AnisotropicMips.h"
+#include "OccupancyPyramid.h"
+#include "DistanceField.h"
+#include "CPURadianceInjector.h"
+#include "CPUConeTracer.h"
+#include "CPUVoxeliser.h"
+#include "SparseVoxelOctree.h"
+#include "BrickPool.h"
+#include "VoxelFragmentList.h"
+#include "VoxelCache.h"
+#include "VoxelUpdateScheduler.h"
+#include "TilePool.h"
+#include "TileMappingBatch.h"
+#include "TileOccupancyBitset.h"
+#include "ResidencyPredictor.h"
+#include "TileMappingScheduler.h"
+#include "TileResidencyWorker.h"
+#include "SoftwareTiledResourceBackend.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "VertexWelder.h"
+#include "MeshOptimiser.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	struct HeadlessTest
+	{
+		const char* sName;
+		int(*pValidate)(unsigned int iSeed);
+	};
+
+	//The two that take a test size as well, at the sizes their benchmarks use
+	int ValidateTriangleBoxOverlap(unsigned int iSeed) { return TriangleBoxOverlap::Validate(2000, iSeed); }
+	int ValidateVoxelClipmap(unsigned int iSeed) { return VoxelClipmap::Validate(200, iSeed); }
+
+	const HeadlessTest s_arrTests[] =
+	{
+		{ "TriangleBoxOverlap", ValidateTriangleBoxOverlap },
+		{ "VoxelClipmap", ValidateVoxelClipmap },
+		{ "AnisotropicMips", AnisotropicMips::Validate },
+		{ "OccupancyPyramid", OccupancyPyramid::Validate },
+		{ "DistanceField", DistanceField::Validate },
+		{ "CPURadianceInjector", CPURadianceInjector::Validate },
+		{ "CPUConeTracer", CPUConeTracer::Validate },
+		{ "CPUVoxeliser", CPUVoxeliser::Validate },
+		{ "SparseVoxelOctree", SparseVoxelOctree::Validate },
+		{ "BrickPool", BrickPool::Validate },
+		{ "VoxelFragmentList", VoxelFragmentList::Validate },
+		{ "VoxelCache", VoxelCache::Validate },
+		{ "VoxelUpdateScheduler", VoxelUpdateScheduler::Validate },
+		{ "TilePool", TilePool::Validate },
+		{ "TileMappingBatch", TileMappingBatch::Validate },
+		{ "TileOccupancyBitset", TileOccupancyBitset::Validate },
+		{ "ResidencyPredictor", ResidencyPredictor::Validate },
+		{ "TileMappingScheduler", TileMappingScheduler::Validate },
+		{ "TileResidencyWorker", TileResidencyWorker::Validate },
+		{ "SoftwareTiledResourceBackend", SoftwareTiledResourceBackend::Validate },
+		{ "ObjParser", ObjParser::Validate },
+		{ "MeshCache", MeshCache::Validate },
+		{ "VertexWelder", VertexWelder::Validate },
+		{ "MeshOptimiser", MeshOptimiser::Validate },
+	};
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	int iNumSeeds = argc > 1 ? atoi(argv[1]) : 1;
+	const char* sModule = argc > 2 ? argv[2] : nullptr;
+	if (iNumSeeds < 1)
+	{
+		printf("Usage: HeadlessTests [NumSeeds] [Module]\n");
+		return EXIT_FAILURE;
+	}
+
+	int iNumRun = 0, iTotalFailures = 0;
+	for (size_t t = 0; t < sizeof(s_arrTests) / sizeof(s_arrTests[0]); t++)
+	{
+		const HeadlessTest& test = s_arrTests[t];
+		if (sModule && strcmp(sModule, test.sName) != 0)
+		{
+			continue;
+		}
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		int iFailures = 0;
+		for (int iSeed = 1; iSeed <= iNumSeeds; iSeed++)
+		{
+			iFailures += test.pValidate(static_cast<unsigned int>(iSeed));
+		}
+		double dMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		printf("%-30s %s, %d failures, %.1fms\n", test.sName, iFailures == 0 ? "passed" : "FAILED", iFailures, dMs);
+
+		iTotalFailures += iFailures;
+		iNumRun++;
+	}
+
+	if (iNumRun == 0)
+	{
+		printf("No module called %s\n", sModule);
+		return EXIT_FAILURE;
+	}
+	return iTotalFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -36,22 +36,28 @@ bool LightManager::Update(ID3D11DeviceContext3* pContext)
 	}
 	LightBuffer* pLightData;
 	pLightData = (LightBuffer*)mappedResource.pData;
+	FillLightBuffer(*pLightData);
+	
+	pContext->Unmap(m_pLightingBuffer, 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	pLightData->AmbientColour = GetAmbientColour();
-	pLightData->DirectionalLightDirection = GetDirectionalLightDirection();
-	pLightData->DirectionalLightColour = GetDirectionalLightColour();
+void LightManager::FillLightBuffer(LightBuffer& lightBuffer)
+{
+	lightBuffer.AmbientColour = GetAmbientColour();
+	lightBuffer.DirectionalLightDirection = GetDirectionalLightDirection();
+	lightBuffer.DirectionalLightColour = GetDirectionalLightColour();
 	for (int i = 0; i < m_arrPointLights.size(); i++)
 	{
 		PointLight* pLight = &m_arrPointLights[i];
 		if (pLight)
 		{
-			pLightData->pointLights[i].vDiffuseColour = pLight->GetDiffuseColour();
-			pLightData->pointLights[i].fRange = pLight->GetReciprocalRange();
-			pLightData->pointLights[i].vPosition = XMFLOAT3(pLight->GetPosition().x, pLight->GetPosition().y, pLight->GetPosition().z);
+			lightBuffer.pointLights[i].vDiffuseColour = pLight->GetDiffuseColour();
+			lightBuffer.pointLights[i].fRange = pLight->GetReciprocalRange();
+			lightBuffer.pointLights[i].vPosition = XMFLOAT3(pLight->GetPosition().x, pLight->GetPosition().y, pLight->GetPosition().z);
 		}
 	}
-	
-	pContext->Unmap(m_pLightingBuffer, 0);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
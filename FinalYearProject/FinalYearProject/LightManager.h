@@ -62,6 +62,8 @@ public:
 
 	bool Initialise(ID3D11Device3* pDevice);
 	bool Update(ID3D11DeviceContext3* pContext);
+	//What Update puts in the light buffer, for checking the shaders against on the CPU
+	void FillLightBuffer(LightBuffer& lightBuffer);
 	void SetDirectionalLightDirection(const XMFLOAT3& vDir);
 	void SetDirectionalLightColour(const XMFLOAT4& vCol);
 	const XMFLOAT3& GetDirectionalLightDirection() { return m_pDirectionalLight->GetDirection(); }
@@ -168,6 +168,7 @@ bool MaterialLibrary::LoadMaterialLibrary(ID3D11Device3* pDevice, ID3D11DeviceCo
 			if (map_d != "")
 			{
 				map_d = AssetFolderString + map_d;
+				m_arrVoxelisedTextureFiles.push_back(map_d);
 				wstring wideMaskName = wstring(map_d.begin(), map_d.end());
 				pMat->SetAlphaMask(pDevice, pContext, &wideMaskName[0]);
 				pMat->SetHasAlphaMask(true);
@@ -179,6 +180,7 @@ bool MaterialLibrary::LoadMaterialLibrary(ID3D11Device3* pDevice, ID3D11DeviceCo
 			if (map_Kd != "")
 			{
 				map_Kd = AssetFolderString + map_Kd;
+				m_arrVoxelisedTextureFiles.push_back(map_Kd);
 				wstring wideDiffuseName = wstring(map_Kd.begin(), map_Kd.end());
 				pMat->SetDiffuseTexture(pDevice, pContext, &wideDiffuseName[0]);
 				pMat->SetHasDiffuseTexture(true);
@@ -5,6 +5,7 @@
 
 #include "Material.h"
 #include <map>
+#include <vector>
 #include <string>
 #include <fstream>
 
@@ -25,8 +26,11 @@ public:
 	bool LoadMaterialLibrary(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, HWND hwnd, const char* filename);
 	Material* GetMaterial(string sMaterialName);
 	void ReloadShaders(ID3D11Device3* pDevice, HWND hwnd);
+	//Diffuse and alpha mask textures the materials loaded, the ones that change what gets voxelised
+	const std::vector<string>& GetVoxelisedTextureFiles() const { return m_arrVoxelisedTextureFiles; }
 private:
 	map<string, Material*> m_MaterialMap;
+	std::vector<string> m_arrVoxelisedTextureFiles;
 };
 
 #endif // !MATERIAL_LIBRARY_H
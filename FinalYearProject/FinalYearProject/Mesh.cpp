@@ -4,15 +4,24 @@
 #include <sstream>
 #include "DebugLog.h"
 #include "InputManager.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "VertexWelder.h"
+#include "MeshOptimiser.h"
+#include "Parallel.h"
 
 bool SortByDistanceToCameraAscending(const SubMesh* lhs, const SubMesh* rhs) { return lhs->m_fDistanceToCamera < rhs->m_fDistanceToCamera; }
 
+bool Mesh::s_bRebuildMeshCaches = false;
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 Mesh::Mesh()
 	: m_pMatLib(nullptr)
 	, m_bIsPatrolling(false)
 	, m_iCurrentPatrolIndex(0)
+	, m_bRetainCPUGeometry(false)
+	, m_bStatic(true)
 {
 	m_mWorldMat = XMMatrixIdentity();
 	m_mScaleMat = XMMatrixIdentity();
@@ -30,6 +39,22 @@ Mesh::~Mesh()
 
 bool Mesh::InitialiseFromObj(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, HWND hwnd, char* filename)
 {
+	std::string sCacheFilename = GetMeshCacheFilename(filename);
+	if (!s_bRebuildMeshCaches)
+	{
+		double dStartTime = Timer::Get()->GetCurrentTime();
+		MeshCache cache;
+		if (cache.Open(sCacheFilename.c_str()) && cache.IsUpToDate(sizeof(VertexType)))
+		{
+			bool bLoaded = LoadFromMeshCache(pDevice, pContext, hwnd, cache);
+			stringstream output;
+			output << "Time to load mesh cache " << sCacheFilename << ": " << (Timer::Get()->GetCurrentTime() - dStartTime);
+			VS_LOG(output.str().c_str());
+			return bLoaded;
+		}
+		VS_LOG_VERBOSE("Mesh cache missing or out of date, loading the obj");
+	}
+
 	//Load in the model data
 	if (!LoadModelFromObjFile(pDevice, pContext, hwnd, filename))
 	{
@@ -42,8 +67,7 @@ bool Mesh::InitialiseFromObj(ID3D11Device3* pDevice, ID3D11DeviceContext3* pCont
 	m_WholeModelBounds.Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
 	m_WholeModelBounds.Max = XMFLOAT3(0.f, 0.f, 0.f);
 
-	//Initialise the buffers and calculate bounding boxes
-	bool result(true);
+	//Calculate bounding boxes
 	for (int i = 0; i < m_arrSubMeshes.size(); i++)
 	{
 		m_arrSubMeshes[i]->CalculateBoundingBox();
@@ -73,14 +97,37 @@ bool Mesh::InitialiseFromObj(ID3D11Device3* pDevice, ID3D11DeviceContext3* pCont
 		{
 			m_WholeModelBounds.Max.z = m_arrSubMeshes[i]->m_BoundingBox.Max.z;
 		}
+	}
 
-		result = InitialiseBuffers(i, pDevice);
-		if (!result)
-		{
-			break;
-		}
+	//Initialise the buffers
+	std::vector<std::vector<VertexType>> arrVertices(m_arrSubMeshes.size());
+	std::vector<std::vector<uint32_t>> arrIndices(m_arrSubMeshes.size());
+	std::vector<uint32_t> arrIndexSizes(m_arrSubMeshes.size());
+	if (!InitialiseBuffers(pDevice, arrVertices, arrIndices, arrIndexSizes))
+	{
+		return false;
+	}
+
+	//Bake what was just built so the next run can skip all of the above
+	std::vector<MeshCache::SubMeshData> arrSubMeshData(m_arrSubMeshes.size());
+	for (int i = 0; i < m_arrSubMeshes.size(); i++)
+	{
+		MeshCache::SubMeshData& data = arrSubMeshData[i];
+		data.sMaterial = m_arrSubMeshes[i]->m_sMaterialName;
+		data.pVertices = arrVertices[i].data();
+		data.iNumVertices = static_cast<uint32_t>(arrVertices[i].size());
+		data.pIndices = arrIndices[i].data();
+		data.iNumIndices = static_cast<uint32_t>(m_arrSubMeshes[i]->m_iIndexCount);
+		data.iIndexSize = arrIndexSizes[i];
+		data.vMin = m_arrSubMeshes[i]->m_BoundingBox.Min;
+		data.vMax = m_arrSubMeshes[i]->m_BoundingBox.Max;
+	}
+	CreateDirectoryA("../Assets/MeshCache", nullptr);
+	if (!MeshCache::Write(sCacheFilename.c_str(), sizeof(VertexType), arrSubMeshData, m_arrMaterialLibraries, m_arrSourceFiles, m_WholeModelBounds.Min, m_WholeModelBounds.Max))
+	{
+		VS_LOG_VERBOSE("Unable to write the mesh cache");
 	}
-	return result;
+	return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -209,6 +256,15 @@ void Mesh::SetMeshPosition(XMFLOAT3 vTranslation)
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void Mesh::GetWorldAABB(AABB& worldAABB) const
+{
+	//the model bounds already have the scale applied (see SetMeshScale), so they only need moving
+	worldAABB.Min = XMFLOAT3(m_WholeModelBounds.Min.x + m_vWorldPos.x, m_WholeModelBounds.Min.y + m_vWorldPos.y, m_WholeModelBounds.Min.z + m_vWorldPos.z);
+	worldAABB.Max = XMFLOAT3(m_WholeModelBounds.Max.x + m_vWorldPos.x, m_WholeModelBounds.Max.y + m_vWorldPos.y, m_WholeModelBounds.Max.z + m_vWorldPos.z);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void Mesh::StartPatrol()
 {
 	m_bIsPatrolling = true;
@@ -227,25 +283,46 @@ void Mesh::Update()
 {
 	if (m_bIsPatrolling)
 	{
-		XMVECTOR vDest, vOrigin, vDir, vCurrentPos;
-		vCurrentPos = XMLoadFloat3(&m_vWorldPos);
-		vDest = XMLoadFloat3(&m_arrPatrolRoute[((m_iCurrentPatrolIndex + 1) % m_arrPatrolRoute.size())]);
-		vOrigin = XMLoadFloat3(&m_arrPatrolRoute[m_iCurrentPatrolIndex]);
-
-		vDir = vDest - vOrigin;
-		vDir = XMVector3Normalize(vDir);
-		vCurrentPos += vDir * 5;
-		if (XMVector3LengthSq(vDest - vCurrentPos).m128_f32[0] < 5.f)
-		{
-			m_iCurrentPatrolIndex = (m_iCurrentPatrolIndex + 1) % m_arrPatrolRoute.size();
-		}
-		XMStoreFloat3(&m_vWorldPos, vCurrentPos);
+		StepPatrol(m_vWorldPos, m_iCurrentPatrolIndex);
 	}
 	UpdateMatrices();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void Mesh::PredictWorldAABB(int iFramesAhead, AABB& worldAABB) const
+{
+	XMFLOAT3 vPos = m_vWorldPos;
+	int iPatrolIndex = m_iCurrentPatrolIndex;
+	for (int i = 0; i < iFramesAhead && m_bIsPatrolling; i++)
+	{
+		StepPatrol(vPos, iPatrolIndex);
+	}
+	worldAABB.Min = XMFLOAT3(m_WholeModelBounds.Min.x + vPos.x, m_WholeModelBounds.Min.y + vPos.y, m_WholeModelBounds.Min.z + vPos.z);
+	worldAABB.Max = XMFLOAT3(m_WholeModelBounds.Max.x + vPos.x, m_WholeModelBounds.Max.y + vPos.y, m_WholeModelBounds.Max.z + vPos.z);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Mesh::StepPatrol(XMFLOAT3& vPos, int& iPatrolIndex) const
+{
+	XMVECTOR vDest, vOrigin, vDir, vCurrentPos;
+	vCurrentPos = XMLoadFloat3(&vPos);
+	vDest = XMLoadFloat3(&m_arrPatrolRoute[((iPatrolIndex + 1) % m_arrPatrolRoute.size())]);
+	vOrigin = XMLoadFloat3(&m_arrPatrolRoute[iPatrolIndex]);
+
+	vDir = vDest - vOrigin;
+	vDir = XMVector3Normalize(vDir);
+	vCurrentPos += vDir * 5;
+	if (XMVector3LengthSq(vDest - vCurrentPos).m128_f32[0] < 5.f)
+	{
+		iPatrolIndex = (iPatrolIndex + 1) % m_arrPatrolRoute.size();
+	}
+	XMStoreFloat3(&vPos, vCurrentPos);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void Mesh::UpdateMatrices()
 {
 	m_mWorldMat = XMMatrixIdentity() * m_mScaleMat;
@@ -264,170 +341,137 @@ bool Mesh::LoadModelFromObjFile(ID3D11Device3* pDevice, ID3D11DeviceContext3* pC
 	}
 	
 	double dStartTime = Timer::Get()->GetCurrentTime();
-	ifstream fin;
-	fin.open(filename);
-
-	//did the file open?
-	if (fin.fail())
+	ObjParser parser;
+	if (!parser.Parse(filename))
 	{
-		VS_LOG_VERBOSE("Failed to load model, could not open file..");
+		VS_LOG_VERBOSE("Failed to load model, could not open or parse file..");
 		return false;
 	}
-
-	std::vector<XMFLOAT3> Verts;
-	std::vector<XMFLOAT2> TexCoords;
-	std::vector<XMFLOAT3> Normals;
-
-	Verts.reserve(10000);
-	TexCoords.reserve(200000);
-	Normals.reserve(300000);
-	
-	string s;
-	
-	double dFaceReadTime = 0;
-	double dModelCreateTime = 0;
-
-	int iObjectIndex( -1);
-
-	int iFaceIndex = 0;
-	char checkChar;
-	//use this to read in floats and then atof to convert. sstream >> float is very slow..
-	char nums[64];
-	//fin >> s;
-	while (fin)
+	m_arrSourceFiles.clear();
+	m_arrSourceFiles.push_back(filename);
+	m_arrMaterialLibraries = parser.GetMaterialLibraries();
+
+	//A submesh a usemtl, with each material library loaded before the usemtls that come after it in the file
+	double dModelCreateStartTime = Timer::Get()->GetCurrentTime();
+	const std::vector<std::string>& arrMaterialLibraries = parser.GetMaterialLibraries();
+	const std::vector<ObjParser::Group>& arrGroups = parser.GetGroups();
+	std::vector<std::vector<ModelType>*> arrGroupModels(arrGroups.size());
+	int iNumMaterialLibrariesLoaded = 0;
+	for (int i = 0; i <= arrGroups.size(); i++)
 	{
-		checkChar = fin.get();
-		switch (checkChar)
-		{
-		case '#':
-		case 'g':
-		case 's':
-			checkChar = fin.get();
-			while (checkChar != '\n')
-				checkChar = fin.get();
-			break;
-		case 'v':
+		int iNumMaterialLibraries = i < arrGroups.size() ? arrGroups[i].iNumMaterialLibraries : static_cast<int>(arrMaterialLibraries.size());
+		for (; iNumMaterialLibrariesLoaded < iNumMaterialLibraries; iNumMaterialLibrariesLoaded++)
 		{
-			checkChar = fin.get();
-			if (checkChar == ' ')
-			{
-				//vertex
-				float x, y, z;
-				fin >> nums;
-				x = atof(nums);
-				fin >> nums;
-				y = atof(nums);
-				fin >> nums;
-				z = atof(nums);
-				// Invert the Z vertex to change to left hand system.
-				Verts.push_back(XMFLOAT3(x, y, -z));
-			}
-			else if (checkChar == 't')
-			{
-				//texture coord
-				float u, v;
-				fin >> nums;
-				u = atof(nums);
-				fin >> nums;
-				v = atof(nums);
-				//Invert the v texture coord to left hand system
-				TexCoords.push_back(XMFLOAT2(u, 1.f - v));
-			}
-			else if (checkChar == 'n')
-			{
-				//normal coord
-				float x, y, z;
-				fin >> nums;
-				x = atof(nums);
-				fin >> nums;
-				y = atof(nums);
-				fin >> nums;
-				z = atof(nums);
-				//Invert the z normal to change to left hand system
-				Normals.push_back(XMFLOAT3(x, y, -z));
-			}
-			break;
+			string sMaterialLibName = "../Assets/Shaders/" + arrMaterialLibraries[iNumMaterialLibrariesLoaded];
+			m_pMatLib->LoadMaterialLibrary(pDevice, pContext, hwnd, sMaterialLibName.c_str());
+			m_arrSourceFiles.push_back(sMaterialLibName);
+			m_arrSourceFiles.insert(m_arrSourceFiles.end(), m_pMatLib->GetVoxelisedTextureFiles().begin(), m_pMatLib->GetVoxelisedTextureFiles().end());
 		}
-		case 'f':
+		if (i < arrGroups.size())
 		{
-			double dFaceReadStartTime = Timer::Get()->GetCurrentTime();
+			m_arrSubMeshes.push_back(new SubMesh());
+			m_arrSubMeshes[i]->m_pMaterial = m_pMatLib->GetMaterial(arrGroups[i].sMaterial);
+			m_arrSubMeshes[i]->m_sMaterialName = arrGroups[i].sMaterial;
+			arrGroupModels[i] = &m_arrSubMeshes[i]->m_arrModel;
+		}
+	}
+	double dModelCreateTime = Timer::Get()->GetCurrentTime() - dModelCreateStartTime;
 
-			Face f;
+	parser.ExpandGroups(arrGroupModels.data());
 
-			fin >> f.vIndex[2] >> checkChar >> f.tIndex[2] >> checkChar >> f.nIndex[2]
-				>> f.vIndex[1] >> checkChar >> f.tIndex[1] >> checkChar >> f.nIndex[1]
-				>> f.vIndex[0] >> checkChar >> f.tIndex[0] >> checkChar >> f.nIndex[0];
+	double dEndTime = Timer::Get()->GetCurrentTime();
+	const ObjParser::Stats& stats = parser.GetStats();
+	stringstream output;
+	output << "Time to process data: " << (dEndTime - dStartTime) << '\n' << "Time to parse: " << stats.dParseMs << "ms on " << stats.iNumThreads << " threads, "
+		<< stats.fMBPerSecond << "MB/s" << '\n' << "Time to create models: " << dModelCreateTime;
+	VS_LOG(output.str().c_str());
 
-			int iModelIndex = iFaceIndex * 3;
-			for (int j = 0; j < 3; j++)
-			{
-				m_arrSubMeshes[iObjectIndex]->m_arrModel.push_back(ModelType());
-				m_arrSubMeshes[iObjectIndex]->m_arrModel[iModelIndex + j].pos = Verts[f.vIndex[j] - 1];
-				m_arrSubMeshes[iObjectIndex]->m_arrModel[iModelIndex + j].tex = TexCoords[f.tIndex[j] - 1];
-				m_arrSubMeshes[iObjectIndex]->m_arrModel[iModelIndex + j].norm = Normals[f.nIndex[j] - 1];
-			}
+	return true;
+}
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+std::string Mesh::GetMeshCacheFilename(const char* objFilename)
+{
+	std::string sName(objFilename);
+	size_t iSlash = sName.find_last_of("/\\");
+	if (iSlash != std::string::npos)
+	{
+		sName = sName.substr(iSlash + 1);
+	}
+	size_t iDot = sName.find_last_of('.');
+	if (iDot != std::string::npos)
+	{
+		sName = sName.substr(0, iDot);
+	}
+	return "../Assets/MeshCache/" + sName + ".msc";
+}
 
-			iFaceIndex++;
-			double dFaceReadEndTime = Timer::Get()->GetCurrentTime();
-			dFaceReadTime += dFaceReadEndTime - dFaceReadStartTime;
-			break;
-		}
-		case 'u':
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Mesh::LoadFromMeshCache(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, HWND hwnd, const MeshCache& cache)
+{
+	m_pMatLib = new MaterialLibrary;
+	if (!m_pMatLib)
+	{
+		VS_LOG_VERBOSE("Unable to create new material library");
+		return false;
+	}
+
+	//The materials still come from the libraries, only the geometry is cached
+	m_arrMaterialLibraries = cache.GetMaterialLibraries();
+	m_arrSourceFiles = cache.GetSourceFiles();
+	for (int i = 0; i < m_arrMaterialLibraries.size(); i++)
+	{
+		string sMaterialLibName = "../Assets/Shaders/" + m_arrMaterialLibraries[i];
+		m_pMatLib->LoadMaterialLibrary(pDevice, pContext, hwnd, sMaterialLibName.c_str());
+	}
+
+	const MeshCacheHeader& header = cache.GetHeader();
+	m_WholeModelBounds.Min = XMFLOAT3(header.fMin[0], header.fMin[1], header.fMin[2]);
+	m_WholeModelBounds.Max = XMFLOAT3(header.fMax[0], header.fMax[1], header.fMax[2]);
+
+	for (int i = 0; i < cache.GetNumSubMeshes(); i++)
+	{
+		const MeshCacheHeader::SubMesh& entry = cache.GetSubMesh(i);
+		SubMesh* pSubMesh = new SubMesh();
+		m_arrSubMeshes.push_back(pSubMesh);
+		pSubMesh->m_sMaterialName = cache.GetMaterialName(i);
+		pSubMesh->m_pMaterial = m_pMatLib->GetMaterial(pSubMesh->m_sMaterialName);
+		pSubMesh->m_BoundingBox.Min = XMFLOAT3(entry.fMin[0], entry.fMin[1], entry.fMin[2]);
+		pSubMesh->m_BoundingBox.Max = XMFLOAT3(entry.fMax[0], entry.fMax[1], entry.fMax[2]);
+
+		//CreateBuffer copies straight out of the mapped file
+		const VertexType* pVertices = static_cast<const VertexType*>(cache.GetVertices(i));
+		const void* pIndices = cache.GetIndices(i);
+		if (!CreateBuffers(pSubMesh, pDevice, pVertices, entry.iNumVertices, pIndices, entry.iNumIndices, entry.iIndexSize))
 		{
-			fin >> s;
-			if (s == "semtl")
-			{
-				//get the mat name
-				fin >> s;
-				double dModelCreateStartTime = Timer::Get()->GetCurrentTime();
-				
-				iObjectIndex++;
-				iFaceIndex = 0;
-				m_arrSubMeshes.push_back(new SubMesh());
-				
-				m_arrSubMeshes[iObjectIndex]->m_pMaterial = m_pMatLib->GetMaterial(s);
-				double dModelCreateEndTime = Timer::Get()->GetCurrentTime();
-				dModelCreateTime += dModelCreateEndTime - dModelCreateStartTime;
-			}
- 			else
- 			{
- 				checkChar = fin.get();
- 				while (checkChar != '\n')
- 					checkChar = fin.get();
- 				break;
- 			}
-			break;
+			return false;
 		}
-		case 'm':
+
+		//Put the triangle list back together for the CPU voxel tools
+		if (m_bRetainCPUGeometry)
 		{
-			fin >> s;
-			if (s == "tllib")
+			pSubMesh->m_arrModel.resize(entry.iNumIndices);
+			for (uint32_t j = 0; j < entry.iNumIndices; j++)
 			{
-				string sMaterialLibName;
-				fin >> sMaterialLibName;
-
-				sMaterialLibName = "../Assets/Shaders/" + sMaterialLibName;
-				m_pMatLib->LoadMaterialLibrary(pDevice, pContext, hwnd, sMaterialLibName.c_str());
+				uint32_t iIndex = entry.iIndexSize == sizeof(uint16_t) ? static_cast<const uint16_t*>(pIndices)[j] : static_cast<const uint32_t*>(pIndices)[j];
+				if (iIndex >= entry.iNumVertices)
+				{
+					VS_LOG_VERBOSE("Mesh cache index out of range");
+					return false;
+				}
+				const VertexType& vertex = pVertices[iIndex];
+				ModelType& corner = pSubMesh->m_arrModel[j];
+				corner.pos = vertex.position;
+				corner.tex = vertex.texture;
+				corner.norm = vertex.normal;
+				corner.tangent = vertex.tangent;
+				corner.binormal = vertex.binormal;
 			}
- 			else
- 			{
- 				checkChar = fin.get();
- 				while (checkChar != '\n')
- 					checkChar = fin.get();
- 				break;
- 			}
-			break;
-		}
 		}
 	}
 
-	double dEndTime = Timer::Get()->GetCurrentTime();
-	stringstream output;
-	output << "Time to process data: " << (dEndTime - dStartTime) << '\n' << "Time To read in faces: " << dFaceReadTime << '\n' << "Time to create models: " << dModelCreateTime;
-	VS_LOG(output.str().c_str());
-
 	return true;
 }
 
@@ -450,49 +494,82 @@ void Mesh::ReleaseModel()
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool Mesh::InitialiseBuffers(int subMeshIndex, ID3D11Device* pDevice)
+bool Mesh::InitialiseBuffers(ID3D11Device* pDevice, std::vector<std::vector<VertexType>>& arrVertices, std::vector<std::vector<uint32_t>>& arrIndices, std::vector<uint32_t>& arrIndexSizes)
 {
-	VertexType* vertices;
-	unsigned long* indices;
+	//Weld every submesh's corners into unique vertices and indices at once and put them in the order the GPU wants
+	//them, the triangle lists aren't touched
+	std::vector<MeshOptimiser::Stats> arrStats(m_arrSubMeshes.size());
+	double dStartTime = Timer::Get()->GetCurrentTime();
+	Parallel::For(static_cast<int>(m_arrSubMeshes.size()), 0, [&](int i, int)
+	{
+		const SubMesh* pSubMesh = m_arrSubMeshes[i];
+		std::vector<VertexType>& vertices = arrVertices[i];
+		vertices.resize(pSubMesh->m_arrModel.size());
+		for (int j = 0; j < pSubMesh->m_arrModel.size(); j++)
+		{
+			// Load the vertex array with data.
+			vertices[j].position = pSubMesh->m_arrModel[j].pos;
+			vertices[j].normal = pSubMesh->m_arrModel[j].norm;
+			vertices[j].texture = pSubMesh->m_arrModel[j].tex;
+			vertices[j].tangent = pSubMesh->m_arrModel[j].tangent;
+			vertices[j].binormal = pSubMesh->m_arrModel[j].binormal;
+		}
 
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	HRESULT result;
+		VertexWelder::WeldTangentFrames(vertices, arrIndices[i]);
+		arrStats[i] = MeshOptimiser::Optimise(vertices, arrIndices[i]);
+		arrIndexSizes[i] = VertexWelder::PackIndices(arrIndices[i].data(), static_cast<uint32_t>(arrIndices[i].size()), static_cast<uint32_t>(vertices.size()));
+	});
+	double dWeldTime = Timer::Get()->GetCurrentTime() - dStartTime;
 
-	SubMesh* pSubMesh = m_arrSubMeshes[subMeshIndex];
-	if (!pSubMesh)
-	{
-		return false;
-	}
-	//Create vert array
-	vertices = new VertexType[pSubMesh->m_arrModel.size()];
-	if (!vertices)
+	size_t iNumCorners = 0, iNumVertices = 0, iBytesBefore = 0, iBytesAfter = 0;
+	double dMissesBefore = 0.0, dMissesAfter = 0.0;
+	for (int i = 0; i < m_arrSubMeshes.size(); i++)
 	{
-		return false;
+		SubMesh* pSubMesh = m_arrSubMeshes[i];
+		int iIndexCount = static_cast<int>(pSubMesh->m_arrModel.size());
+		if (!CreateBuffers(pSubMesh, pDevice, arrVertices[i].data(), static_cast<int>(arrVertices[i].size()), arrIndices[i].data(), iIndexCount, arrIndexSizes[i]))
+		{
+			return false;
+		}
+
+		iNumCorners += iIndexCount;
+		iNumVertices += arrVertices[i].size();
+		iBytesBefore += iIndexCount * (sizeof(VertexType) + sizeof(uint32_t));
+		iBytesAfter += arrVertices[i].size() * sizeof(VertexType) + iIndexCount * arrIndexSizes[i];
+		dMissesBefore += arrStats[i].fACMRBefore * (iIndexCount / 3);
+		dMissesAfter += arrStats[i].fACMRAfter * (iIndexCount / 3);
+
+		//The CPU voxel tools read the triangles back out of the submeshes, otherwise there is no need to keep them around
+		if (!m_bRetainCPUGeometry)
+		{
+			pSubMesh->m_arrModel.clear();
+		}
 	}
 
-	//Create index array
-	indices = new unsigned long[pSubMesh->m_arrModel.size()];
-	if (!indices)
+	stringstream output;
+	output << "Time to weld and optimise vertices: " << dWeldTime << ", " << iNumCorners << " to " << iNumVertices << " vertices, buffers "
+		<< iBytesBefore / (1024.0 * 1024.0) << "MB to " << iBytesAfter / (1024.0 * 1024.0) << "MB";
+	if (iNumCorners > 0 && iNumVertices > 0)
 	{
-		return false;
+		output << ", ACMR " << dMissesBefore / (iNumCorners / 3) << " to " << dMissesAfter / (iNumCorners / 3)
+			<< ", ATVR " << dMissesBefore / iNumVertices << " to " << dMissesAfter / iNumVertices;
 	}
+	VS_LOG(output.str().c_str());
 
-	pSubMesh->m_iVertexCount = pSubMesh->m_iIndexCount = pSubMesh->m_arrModel.size();
+	return true;
+}
 
-	for (int i = 0; i < pSubMesh->m_arrModel.size(); i++)
-	{
-		// Load the vertex array with data.
-		vertices[i].position = pSubMesh->m_arrModel[i].pos;  // Bottom left.
-		vertices[i].normal = pSubMesh->m_arrModel[i].norm;
-		vertices[i].texture = pSubMesh->m_arrModel[i].tex;
-		vertices[i].tangent = pSubMesh->m_arrModel[i].tangent;
-		vertices[i].binormal = pSubMesh->m_arrModel[i].binormal;
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-		indices[i] = i;
-	}
+bool Mesh::CreateBuffers(SubMesh* pSubMesh, ID3D11Device* pDevice, const void* pVertices, int iVertexCount, const void* pIndices, int iIndexCount, uint32_t iIndexSize)
+{
+	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
+	D3D11_SUBRESOURCE_DATA vertexData, indexData;
+	HRESULT result;
 
-	
+	pSubMesh->m_iVertexCount = iVertexCount;
+	pSubMesh->m_iIndexCount = iIndexCount;
+	pSubMesh->m_eIndexFormat = iIndexSize == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
 	//Setup the description of the static vertex buffer.
 	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
@@ -503,7 +580,7 @@ bool Mesh::InitialiseBuffers(int subMeshIndex, ID3D11Device* pDevice)
 	vertexBufferDesc.StructureByteStride = 0;
 
 	//Give the subresource struct a pointer to the vert data
-	vertexData.pSysMem = vertices;
+	vertexData.pSysMem = pVertices;
 	vertexData.SysMemPitch = 0;
 	vertexData.SysMemSlicePitch = 0;
 
@@ -517,14 +594,14 @@ bool Mesh::InitialiseBuffers(int subMeshIndex, ID3D11Device* pDevice)
 
 	//Setup the description of the static index buffer
 	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long) * pSubMesh->m_iIndexCount;
+	indexBufferDesc.ByteWidth = iIndexSize * pSubMesh->m_iIndexCount;
 	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	indexBufferDesc.CPUAccessFlags = 0;
 	indexBufferDesc.MiscFlags = 0;
 	indexBufferDesc.StructureByteStride = 0;
 
 	//Give the subresource a pointer to the index data.
-	indexData.pSysMem = indices;
+	indexData.pSysMem = pIndices;
 	indexData.SysMemPitch = 0;
 	indexData.SysMemSlicePitch = 0;
 
@@ -536,15 +613,6 @@ bool Mesh::InitialiseBuffers(int subMeshIndex, ID3D11Device* pDevice)
 		return false;
 	}
 
-	m_arrSubMeshes[subMeshIndex]->m_arrModel.clear();
-
-	//Release the arrays now that the vertex and index buffers have been created and loaded..
-	delete[] vertices;
-	vertices = nullptr;
-
-	delete[] indices;
-	indices = nullptr;
-
 	return true;
 }
 
@@ -582,7 +650,7 @@ void Mesh::RenderBuffers(int subMeshIndex, ID3D11DeviceContext* pDeviceContext)
 	pDeviceContext->IASetVertexBuffers(0, 1, &m_arrSubMeshes[subMeshIndex]->m_pVertexBuffer, &stride, &offset);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
-	pDeviceContext->IASetIndexBuffer(m_arrSubMeshes[subMeshIndex]->m_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	pDeviceContext->IASetIndexBuffer(m_arrSubMeshes[subMeshIndex]->m_pIndexBuffer, m_arrSubMeshes[subMeshIndex]->m_eIndexFormat, 0);
 
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
 	pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -13,6 +13,8 @@
 #include "AABB.h"
 #include "Camera.h"
 
+class MeshCache;
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 using namespace DirectX;
@@ -41,11 +43,13 @@ struct SubMesh
 {
 	std::vector<ModelType>	  m_arrModel;
 	Material*				  m_pMaterial;
+	std::string				  m_sMaterialName;	//the usemtl it was loaded from
 
 	ID3D11Buffer* m_pVertexBuffer;
 	ID3D11Buffer* m_pIndexBuffer;
 	int			  m_iVertexCount;
 	int			  m_iIndexCount;
+	DXGI_FORMAT	  m_eIndexFormat;	//16 bit when the submesh has few enough vertices
 
 	AABB		  m_BoundingBox;
 	float		  m_fDistanceToCamera;
@@ -65,10 +69,11 @@ struct SubMesh
 		, m_pMaterial(nullptr)
 		, m_iVertexCount(0)
 		, m_iIndexCount(0)
+		, m_eIndexFormat(DXGI_FORMAT_R32_UINT)
 	{
 	}
 
-	int GetNumPolys() { return m_iVertexCount / 3; }
+	int GetNumPolys() { return m_iIndexCount / 3; }
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -97,12 +102,6 @@ __declspec(align(16)) class Mesh
 	};
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	struct Face
-	{
-		int vIndex[3];
-		int tIndex[3];
-		int nIndex[3];
-	};
 public:
 	void* operator new(size_t i)
 	{
@@ -129,6 +128,9 @@ public:
 	void ReloadShaders(ID3D11Device3* pDevice, HWND hwnd);
 
 	const AABB& GetWholeModelAABB() const { return m_WholeModelBounds; }
+	void GetWorldAABB(AABB& worldAABB) const;
+	//Where the world AABB will be after iFramesAhead more Updates, following the patrol route round if it's patrolling
+	void PredictWorldAABB(int iFramesAhead, AABB& worldAABB) const;
 
 	const std::vector<SubMesh*>& GetMeshArray() { return m_arrSubMeshes; }
 
@@ -139,19 +141,44 @@ public:
 
 	void StartPatrol();
 	void AddPatrolPoint(const XMFLOAT3& vPos);
+	const std::vector<XMFLOAT3>& GetPatrolRoute() const { return m_arrPatrolRoute; }
 
 	void Update();
 	void UpdateMatrices();
 
+	//Keep the triangle lists in system memory after the vertex buffers are made, needs setting before InitialiseFromObj
+	void SetRetainCPUGeometry(bool bRetain) { m_bRetainCPUGeometry = bRetain; }
+	bool RetainsCPUGeometry() const { return m_bRetainCPUGeometry; }
+
+	//Static meshes are voxelised once and kept, dynamic ones are revoxelised every frame. Meshes are static by default.
+	void SetStatic(bool bStatic) { m_bStatic = bStatic; }
+	bool IsStatic() const { return m_bStatic; }
+
+	//The obj, its material library and the textures that affect voxelising it, for hashing into the voxel cache
+	const std::vector<std::string>& GetSourceFiles() const { return m_arrSourceFiles; }
+
+	//InitialiseFromObj loads the vertex buffers from ../Assets/MeshCache when the obj, materials and textures haven't
+	//changed since it was written, and writes it otherwise. Rebuilding ignores what's there and always writes it.
+	static void SetRebuildMeshCaches(bool bRebuild) { s_bRebuildMeshCaches = bRebuild; }
+	static std::string GetMeshCacheFilename(const char* objFilename);
+
 private:
 
 	bool LoadModelFromObjFile(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, HWND hwnd, char* filename);
+	//Makes the submeshes and buffers from a cache that's open and up to date, the buffers reading straight out of the mapping
+	bool LoadFromMeshCache(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, HWND hwnd, const MeshCache& cache);
 	void ReleaseModel();
-	bool InitialiseBuffers(int subMeshIndex, ID3D11Device* pDevice);
+	//Welds each submesh's triangle list into the arrays and reorders them for the vertex cache, overdraw and fetching,
+	//in parallel, and makes the buffers from them. The arrays are kept for the mesh cache, indices packed to 16 bits
+	//where arrIndexSizes says so.
+	bool InitialiseBuffers(ID3D11Device* pDevice, std::vector<std::vector<VertexType>>& arrVertices, std::vector<std::vector<uint32_t>>& arrIndices, std::vector<uint32_t>& arrIndexSizes);
+	bool CreateBuffers(SubMesh* pSubMesh, ID3D11Device* pDevice, const void* pVertices, int iVertexCount, const void* pIndices, int iIndexCount, uint32_t iIndexSize);
 	void ShutdownBuffers();
 	
 
 	void CalculateModelVectors();
+	//Moves a frame along the patrol route
+	void StepPatrol(XMFLOAT3& vPos, int& iPatrolIndex) const;
 
 	AABB m_WholeModelBounds;
 
@@ -166,6 +193,12 @@ private:
 	std::vector<XMFLOAT3> m_arrPatrolRoute;
 	int m_iCurrentPatrolIndex;
 	bool m_bIsPatrolling;
+	bool m_bRetainCPUGeometry;
+	bool m_bStatic;
+	std::vector<std::string> m_arrSourceFiles;
+	std::vector<std::string> m_arrMaterialLibraries;
+
+	static bool s_bRebuildMeshCaches;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,645 @@
+#include "MeshCache.h"
+#include "VoxelCache.h"
+#include "BenchmarkMesh.h"
+#include "VertexWelder.h"
+#include "MeshOptimiser.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <numeric>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t MeshCache::kMagic;
+const uint32_t MeshCache::kVersion;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	uint64_t AlignUp(uint64_t iOffset)
+	{
+		return (iOffset + MeshCache::kDataAlignment - 1) & ~static_cast<uint64_t>(MeshCache::kDataAlignment - 1);
+	}
+
+	//VoxelCache::HashFile a word at a time rather than a byte, as the obj gets hashed on every load
+	uint64_t HashFileWords(const char* filename, uint64_t iHash)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		if (!file.is_open())
+		{
+			return VoxelCache::HashBytes(filename, strlen(filename), iHash);
+		}
+
+		std::vector<uint64_t> arrBuffer((1 << 20) / sizeof(uint64_t));
+		while (file)
+		{
+			file.read(reinterpret_cast<char*>(arrBuffer.data()), arrBuffer.size() * sizeof(uint64_t));
+			size_t iNumBytes = static_cast<size_t>(file.gcount());
+			size_t iNumWords = iNumBytes / sizeof(uint64_t);
+			for (size_t i = 0; i < iNumWords; i++)
+			{
+				iHash ^= arrBuffer[i];
+				iHash *= 1099511628211ULL;
+			}
+			iHash = VoxelCache::HashBytes(&arrBuffer[iNumWords], iNumBytes - iNumWords * sizeof(uint64_t), iHash);
+		}
+		return iHash;
+	}
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//BenchmarkMesh's arrays welded and optimised as Mesh does them, and the submeshes to write for them
+	bool LoadObjVertices(const char* filename, std::vector<BenchmarkMesh::SubMesh>& arrMeshes, std::vector<MeshCache::SubMeshData>& arrSubMeshes, XMFLOAT3& vMin, XMFLOAT3& vMax)
+	{
+		if (!BenchmarkMesh::LoadObj(filename, arrMeshes, vMin, vMax))
+		{
+			return false;
+		}
+		arrSubMeshes.resize(arrMeshes.size());
+		Parallel::For(static_cast<int>(arrMeshes.size()), 0, [&](int g, int)
+		{
+			BenchmarkMesh::SubMesh& mesh = arrMeshes[g];
+			MeshCache::SubMeshData& subMesh = arrSubMeshes[g];
+			VertexWelder::WeldTangentFrames(mesh.arrVertices, mesh.arrIndices);
+			MeshOptimiser::Optimise(mesh.arrVertices, mesh.arrIndices);
+			subMesh.iNumVertices = static_cast<uint32_t>(mesh.arrVertices.size());
+			subMesh.iNumIndices = static_cast<uint32_t>(mesh.arrIndices.size());
+			subMesh.iIndexSize = VertexWelder::PackIndices(mesh.arrIndices.data(), subMesh.iNumIndices, subMesh.iNumVertices);
+			subMesh.sMaterial = mesh.sMaterial;
+			subMesh.pVertices = mesh.arrVertices.data();
+			subMesh.pIndices = mesh.arrIndices.data();
+			subMesh.vMin = mesh.vMin;
+			subMesh.vMax = mesh.vMax;
+		});
+		return true;
+	}
+
+	//Differences between what went into the cache and what comes out of it
+	int CompareWithCache(const MeshCache& cache, uint32_t iVertexStride, const std::vector<MeshCache::SubMeshData>& arrSubMeshes, const std::vector<std::string>& arrMaterialLibraries,
+		const std::vector<std::string>& arrSourceFiles)
+	{
+		if (!cache.IsOpen() || cache.GetNumSubMeshes() != static_cast<int>(arrSubMeshes.size()))
+		{
+			return 1;
+		}
+		int iFailures = 0;
+		iFailures += cache.GetHeader().iVertexStride != iVertexStride;
+		iFailures += cache.GetMaterialLibraries() != arrMaterialLibraries;
+		iFailures += cache.GetSourceFiles() != arrSourceFiles;
+		for (int i = 0; i < cache.GetNumSubMeshes(); i++)
+		{
+			const MeshCacheHeader::SubMesh& stored = cache.GetSubMesh(i);
+			const MeshCache::SubMeshData& expected = arrSubMeshes[i];
+			iFailures += cache.GetMaterialName(i) != expected.sMaterial;
+			iFailures += stored.iNumVertices != expected.iNumVertices || stored.iNumIndices != expected.iNumIndices || stored.iIndexSize != expected.iIndexSize;
+			iFailures += memcmp(stored.fMin, &expected.vMin, sizeof(stored.fMin)) != 0 || memcmp(stored.fMax, &expected.vMax, sizeof(stored.fMax)) != 0;
+			iFailures += reinterpret_cast<uintptr_t>(cache.GetVertices(i)) % MeshCache::kDataAlignment != 0;
+			if (stored.iNumVertices == expected.iNumVertices && stored.iNumIndices == expected.iNumIndices && stored.iIndexSize == expected.iIndexSize)
+			{
+				iFailures += memcmp(cache.GetVertices(i), expected.pVertices, static_cast<size_t>(expected.iNumVertices) * iVertexStride) != 0;
+				iFailures += memcmp(cache.GetIndices(i), expected.pIndices, static_cast<size_t>(expected.iNumIndices) * expected.iIndexSize) != 0;
+			}
+		}
+		return iFailures;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MeshCache::MeshCache()
+	: m_pMapped(nullptr)
+	, m_iFileSize(0)
+	, m_pHeader(nullptr)
+	, m_pSubMeshes(nullptr)
+#ifdef _WIN32
+	, m_hFile(INVALID_HANDLE_VALUE)
+	, m_hMapping(nullptr)
+#else
+	, m_iFile(-1)
+#endif
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MeshCache::~MeshCache()
+{
+	Close();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t MeshCache::HashSourceFiles(const std::vector<std::string>& arrSourceFiles, uint32_t iVertexStride)
+{
+	uint64_t iHash = VoxelCache::HashBytes(&iVertexStride, sizeof(iVertexStride));
+	for (size_t i = 0; i < arrSourceFiles.size(); i++)
+	{
+		iHash = HashFileWords(arrSourceFiles[i].c_str(), iHash);
+	}
+	return iHash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MeshCache::Write(const char* filename, uint32_t iVertexStride, const std::vector<SubMeshData>& arrSubMeshes, const std::vector<std::string>& arrMaterialLibraries,
+	const std::vector<std::string>& arrSourceFiles, const XMFLOAT3& vMin, const XMFLOAT3& vMax)
+{
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.iMagic = kMagic;
+	header.iVersion = kVersion;
+	header.iHeaderSize = sizeof(MeshCacheHeader);
+	header.iVertexStride = iVertexStride;
+	header.iNumSubMeshes = static_cast<uint32_t>(arrSubMeshes.size());
+	header.iNumMaterialLibraries = static_cast<uint32_t>(arrMaterialLibraries.size());
+	header.iNumSourceFiles = static_cast<uint32_t>(arrSourceFiles.size());
+	header.iContentHash = HashSourceFiles(arrSourceFiles, iVertexStride);
+	memcpy(header.fMin, &vMin, sizeof(header.fMin));
+	memcpy(header.fMax, &vMax, sizeof(header.fMax));
+
+	std::string sStrings;
+	for (size_t i = 0; i < arrSubMeshes.size(); i++)
+	{
+		sStrings.append(arrSubMeshes[i].sMaterial.c_str(), arrSubMeshes[i].sMaterial.size() + 1);
+	}
+	for (size_t i = 0; i < arrMaterialLibraries.size(); i++)
+	{
+		sStrings.append(arrMaterialLibraries[i].c_str(), arrMaterialLibraries[i].size() + 1);
+	}
+	for (size_t i = 0; i < arrSourceFiles.size(); i++)
+	{
+		sStrings.append(arrSourceFiles[i].c_str(), arrSourceFiles[i].size() + 1);
+	}
+
+	header.iSubMeshTableOffset = sizeof(MeshCacheHeader);
+	header.iStringsOffset = header.iSubMeshTableOffset + arrSubMeshes.size() * sizeof(MeshCacheHeader::SubMesh);
+	header.iStringsSize = sStrings.size();
+	std::vector<MeshCacheHeader::SubMesh> arrTable(arrSubMeshes.size());
+	uint64_t iOffset = AlignUp(header.iStringsOffset + header.iStringsSize);
+	for (size_t i = 0; i < arrSubMeshes.size(); i++)
+	{
+		MeshCacheHeader::SubMesh& entry = arrTable[i];
+		entry.iNumVertices = arrSubMeshes[i].iNumVertices;
+		entry.iNumIndices = arrSubMeshes[i].iNumIndices;
+		entry.iIndexSize = arrSubMeshes[i].iIndexSize;
+		entry.iPadding = 0;
+		memcpy(entry.fMin, &arrSubMeshes[i].vMin, sizeof(entry.fMin));
+		memcpy(entry.fMax, &arrSubMeshes[i].vMax, sizeof(entry.fMax));
+		entry.iVertexOffset = iOffset;
+		iOffset = AlignUp(iOffset + static_cast<uint64_t>(entry.iNumVertices) * iVertexStride);
+		entry.iIndexOffset = iOffset;
+		iOffset = AlignUp(iOffset + static_cast<uint64_t>(entry.iNumIndices) * entry.iIndexSize);
+	}
+
+	//Written to a temporary and renamed over the old one, so a half written cache never gets loaded
+	std::string sTempName = std::string(filename) + ".tmp";
+	std::ofstream file(sTempName, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open " << sTempName.c_str() << " to write the mesh cache");
+		return false;
+	}
+
+	const char padding[kDataAlignment] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (!arrTable.empty())
+	{
+		file.write(reinterpret_cast<const char*>(arrTable.data()), arrTable.size() * sizeof(MeshCacheHeader::SubMesh));
+	}
+	file.write(sStrings.data(), sStrings.size());
+	uint64_t iWritten = header.iStringsOffset + header.iStringsSize;
+	for (size_t i = 0; i < arrSubMeshes.size(); i++)
+	{
+		//Empty blobs aren't padded out to, so the file ends with the last byte of data
+		const MeshCacheHeader::SubMesh& entry = arrTable[i];
+		if (entry.iNumVertices > 0)
+		{
+			file.write(padding, static_cast<std::streamsize>(entry.iVertexOffset - iWritten));
+			file.write(static_cast<const char*>(arrSubMeshes[i].pVertices), static_cast<std::streamsize>(entry.iNumVertices) * iVertexStride);
+			iWritten = entry.iVertexOffset + static_cast<uint64_t>(entry.iNumVertices) * iVertexStride;
+		}
+		if (entry.iNumIndices > 0)
+		{
+			file.write(padding, static_cast<std::streamsize>(entry.iIndexOffset - iWritten));
+			file.write(static_cast<const char*>(arrSubMeshes[i].pIndices), static_cast<std::streamsize>(entry.iNumIndices) * entry.iIndexSize);
+			iWritten = entry.iIndexOffset + static_cast<uint64_t>(entry.iNumIndices) * entry.iIndexSize;
+		}
+	}
+	file.close();
+	if (file.fail())
+	{
+		VS_LOG_VERBOSE("Failed writing the mesh cache to " << sTempName.c_str());
+		remove(sTempName.c_str());
+		return false;
+	}
+
+	remove(filename);
+	if (rename(sTempName.c_str(), filename) != 0)
+	{
+		VS_LOG_VERBOSE("Failed to move the mesh cache to " << filename);
+		remove(sTempName.c_str());
+		return false;
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MeshCache::Open(const char* filename)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	m_hFile = hFile;
+
+	LARGE_INTEGER iSize;
+	if (!GetFileSizeEx(hFile, &iSize) || iSize.QuadPart < static_cast<LONGLONG>(sizeof(MeshCacheHeader)))
+	{
+		Close();
+		return false;
+	}
+	m_iFileSize = static_cast<size_t>(iSize.QuadPart);
+
+	m_hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_hMapping)
+	{
+		Close();
+		return false;
+	}
+	m_pMapped = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_iFile = open(filename, O_RDONLY);
+	if (m_iFile < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(m_iFile, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(MeshCacheHeader)))
+	{
+		Close();
+		return false;
+	}
+	m_iFileSize = static_cast<size_t>(fileStat.st_size);
+
+	void* pMapped = mmap(nullptr, m_iFileSize, PROT_READ, MAP_PRIVATE, m_iFile, 0);
+	m_pMapped = pMapped == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(pMapped);
+#endif
+	if (!m_pMapped)
+	{
+		VS_LOG_VERBOSE("Failed to map mesh cache " << filename);
+		Close();
+		return false;
+	}
+
+	m_pHeader = reinterpret_cast<const MeshCacheHeader*>(m_pMapped);
+	if (m_pHeader->iMagic != kMagic || m_pHeader->iVersion != kVersion || m_pHeader->iHeaderSize != sizeof(MeshCacheHeader))
+	{
+		VS_LOG_VERBOSE("Mesh cache " << filename << " is an old version or not a mesh cache");
+		Close();
+		return false;
+	}
+
+	const MeshCacheHeader& header = *m_pHeader;
+	bool bValid = header.iSubMeshTableOffset == sizeof(MeshCacheHeader)
+		&& header.iNumSubMeshes <= (m_iFileSize - sizeof(MeshCacheHeader)) / sizeof(MeshCacheHeader::SubMesh)
+		&& header.iStringsOffset == header.iSubMeshTableOffset + header.iNumSubMeshes * sizeof(MeshCacheHeader::SubMesh)
+		&& header.iStringsSize <= m_iFileSize - header.iStringsOffset;
+	if (bValid)
+	{
+		//Every string has to end inside the table
+		const char* pString = reinterpret_cast<const char*>(m_pMapped + header.iStringsOffset);
+		const char* pStringsEnd = pString + header.iStringsSize;
+		uint64_t iNumStrings = static_cast<uint64_t>(header.iNumSubMeshes) + header.iNumMaterialLibraries + header.iNumSourceFiles;
+		for (uint64_t i = 0; i < iNumStrings && bValid; i++)
+		{
+			const char* pNull = static_cast<const char*>(memchr(pString, '\0', pStringsEnd - pString));
+			if (!pNull)
+			{
+				bValid = false;
+				break;
+			}
+			std::string sString(pString, pNull);
+			if (i < header.iNumSubMeshes)
+			{
+				m_arrMaterialNames.push_back(sString);
+			}
+			else if (i < header.iNumSubMeshes + header.iNumMaterialLibraries)
+			{
+				m_arrMaterialLibraries.push_back(sString);
+			}
+			else
+			{
+				m_arrSourceFiles.push_back(sString);
+			}
+			pString = pNull + 1;
+		}
+	}
+	if (!bValid)
+	{
+		VS_LOG_VERBOSE("Mesh cache " << filename << " has a bad submesh table or strings");
+		Close();
+		return false;
+	}
+
+	m_pSubMeshes = reinterpret_cast<const MeshCacheHeader::SubMesh*>(m_pMapped + header.iSubMeshTableOffset);
+	for (uint32_t i = 0; i < header.iNumSubMeshes; i++)
+	{
+		const MeshCacheHeader::SubMesh& subMesh = m_pSubMeshes[i];
+		uint64_t iVertexBytes = static_cast<uint64_t>(subMesh.iNumVertices) * header.iVertexStride;
+		uint64_t iIndexBytes = static_cast<uint64_t>(subMesh.iNumIndices) * subMesh.iIndexSize;
+		//Empty blobs can point past the end
+		bValid = (subMesh.iIndexSize == sizeof(uint16_t) || subMesh.iIndexSize == sizeof(uint32_t))
+			&& subMesh.iVertexOffset % kDataAlignment == 0 && subMesh.iIndexOffset % kDataAlignment == 0
+			&& (iVertexBytes == 0 || (subMesh.iVertexOffset <= m_iFileSize && iVertexBytes <= m_iFileSize - subMesh.iVertexOffset))
+			&& (iIndexBytes == 0 || (subMesh.iIndexOffset <= m_iFileSize && iIndexBytes <= m_iFileSize - subMesh.iIndexOffset));
+		if (!bValid)
+		{
+			VS_LOG_VERBOSE("Mesh cache " << filename << " submesh " << i << " is truncated or corrupt");
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MeshCache::Close()
+{
+#ifdef _WIN32
+	if (m_pMapped)
+	{
+		UnmapViewOfFile(m_pMapped);
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = nullptr;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_pMapped)
+	{
+		munmap(const_cast<uint8_t*>(m_pMapped), m_iFileSize);
+	}
+	if (m_iFile >= 0)
+	{
+		close(m_iFile);
+		m_iFile = -1;
+	}
+#endif
+	m_pMapped = nullptr;
+	m_pHeader = nullptr;
+	m_pSubMeshes = nullptr;
+	m_iFileSize = 0;
+	m_arrMaterialNames.clear();
+	m_arrMaterialLibraries.clear();
+	m_arrSourceFiles.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MeshCache::IsUpToDate(uint32_t iVertexStride) const
+{
+	if (!m_pHeader || m_pHeader->iVertexStride != iVertexStride)
+	{
+		return false;
+	}
+	return HashSourceFiles(m_arrSourceFiles, iVertexStride) == m_pHeader->iContentHash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int MeshCache::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+	const char* filename = "../Results/MeshCache_Validate.msc";
+	const char* sourceFilename = "../Results/MeshCache_Validate.src";
+
+	for (int iTest = 0; iTest < 6; iTest++)
+	{
+		{
+			std::ofstream source(sourceFilename, std::ios::binary | std::ios::trunc);
+			source << "source " << rng();
+		}
+
+		//Random bytes for vertices, any stride will do
+		uint32_t iVertexStride = 4 * (1 + rng() % 16);
+		int iNumSubMeshes = rng() % 6;
+		std::vector<std::vector<uint8_t>> arrVertexBytes(iNumSubMeshes);
+		std::vector<std::vector<uint32_t>> arrIndices(iNumSubMeshes);
+		std::vector<SubMeshData> arrSubMeshes(iNumSubMeshes);
+		for (int i = 0; i < iNumSubMeshes; i++)
+		{
+			uint32_t iNumVertices = rng() % 3 == 0 ? 0 : rng() % 5000;
+			arrVertexBytes[i].resize(static_cast<size_t>(iNumVertices) * iVertexStride);
+			for (size_t b = 0; b < arrVertexBytes[i].size(); b++)
+			{
+				arrVertexBytes[i][b] = static_cast<uint8_t>(rng());
+			}
+			arrIndices[i].resize(iNumVertices > 0 ? rng() % 5000 : 0);
+			for (size_t j = 0; j < arrIndices[i].size(); j++)
+			{
+				arrIndices[i][j] = rng() % iNumVertices;
+			}
+			uint32_t iIndexSize = rng() % 2 ? VertexWelder::PackIndices(arrIndices[i].data(), static_cast<uint32_t>(arrIndices[i].size()), iNumVertices) : sizeof(uint32_t);
+			SubMeshData& subMesh = arrSubMeshes[i];
+			subMesh.sMaterial = rng() % 4 == 0 ? "" : "material_" + std::to_string(rng() % 100);
+			subMesh.pVertices = arrVertexBytes[i].data();
+			subMesh.iNumVertices = iNumVertices;
+			subMesh.pIndices = arrIndices[i].data();
+			subMesh.iNumIndices = static_cast<uint32_t>(arrIndices[i].size());
+			subMesh.iIndexSize = iIndexSize;
+			subMesh.vMin = XMFLOAT3(-static_cast<float>(rng() % 100), -1.f, -2.f);
+			subMesh.vMax = XMFLOAT3(static_cast<float>(rng() % 100), 1.f, 2.f);
+		}
+		std::vector<std::string> arrMaterialLibraries(rng() % 3, "library.mtl");
+		std::vector<std::string> arrSourceFiles(1, sourceFilename);
+		if (rng() % 2)
+		{
+			//Missing sources hash their names, so they still count
+			arrSourceFiles.push_back("../Results/MeshCache_Missing.src");
+		}
+
+		if (!Write(filename, iVertexStride, arrSubMeshes, arrMaterialLibraries, arrSourceFiles, XMFLOAT3(-1.f, -2.f, -3.f), XMFLOAT3(1.f, 2.f, 3.f)))
+		{
+			iFailures++;
+			continue;
+		}
+		MeshCache cache;
+		iFailures += !cache.Open(filename);
+		iFailures += CompareWithCache(cache, iVertexStride, arrSubMeshes, arrMaterialLibraries, arrSourceFiles);
+		iFailures += !cache.IsUpToDate(iVertexStride);
+		iFailures += cache.IsUpToDate(iVertexStride + 4);
+
+		//A source changing makes it stale
+		{
+			std::ofstream source(sourceFilename, std::ios::binary | std::ios::app);
+			source << "edited";
+		}
+		iFailures += cache.IsUpToDate(iVertexStride);
+		cache.Close();
+
+		//Cut short or scribbled on, it shouldn't open
+		std::vector<char> arrFile;
+		{
+			std::ifstream file(filename, std::ios::binary);
+			arrFile.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		size_t iDataSize = 0;
+		for (int i = 0; i < iNumSubMeshes; i++)
+		{
+			iDataSize += arrVertexBytes[i].size() + arrSubMeshes[i].iNumIndices;
+		}
+		if (iDataSize > 0)
+		{
+			std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+			file.write(arrFile.data(), arrFile.size() - 1 - rng() % std::min<size_t>(arrFile.size() - sizeof(MeshCacheHeader), 4));
+			file.close();
+			iFailures += cache.Open(filename);
+		}
+		arrFile[rng() % 4] ^= 0x5a;
+		{
+			std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+			file.write(arrFile.data(), arrFile.size());
+		}
+		iFailures += cache.Open(filename);
+	}
+	remove(filename);
+	remove(sourceFilename);
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MeshCache::RunBenchmark(const char* sName, const char* objFilename)
+{
+	const int iNumWarmLoads = 5;
+	std::string sCacheFilename = std::string("../Results/MeshCache_") + sName + ".msc";
+
+	std::stringstream ss;
+	ss << "../Results/MeshCache_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open mesh cache benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Load, Average(ms), Minimum(ms), Maximum(ms), Source Check(ms), File Size(MB)\n";
+
+	//Both paths end with the vertices and indices copied out once, the copy CreateBuffer makes
+	std::vector<uint8_t> arrUpload;
+	auto upload = [&](const void* pData, size_t iSize)
+	{
+		if (arrUpload.size() < iSize)
+		{
+			arrUpload.resize(iSize);
+		}
+		memcpy(arrUpload.data(), pData, iSize);
+	};
+
+	std::vector<BenchmarkMesh::SubMesh> arrMeshes;
+	std::vector<SubMeshData> arrSubMeshes;
+	XMFLOAT3 vMin, vMax;
+	double dObjMs[iNumWarmLoads];
+	for (int i = 0; i < iNumWarmLoads; i++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		if (!LoadObjVertices(objFilename, arrMeshes, arrSubMeshes, vMin, vMax))
+		{
+			VS_LOG_VERBOSE("Failed to load " << objFilename << " for the mesh cache benchmark");
+			return false;
+		}
+		for (size_t s = 0; s < arrSubMeshes.size(); s++)
+		{
+			upload(arrSubMeshes[s].pVertices, arrSubMeshes[s].iNumVertices * sizeof(BenchmarkMesh::Vertex));
+			upload(arrSubMeshes[s].pIndices, arrSubMeshes[s].iNumIndices * arrSubMeshes[s].iIndexSize);
+		}
+		dObjMs[i] = GetElapsedMs(start);
+	}
+
+	std::vector<std::string> arrSourceFiles(1, objFilename);
+	if (!Write(sCacheFilename.c_str(), sizeof(BenchmarkMesh::Vertex), arrSubMeshes, std::vector<std::string>(), arrSourceFiles, vMin, vMax))
+	{
+		return false;
+	}
+
+	//The first load after writing is as cold as it gets without flushing the OS's file cache
+	int iFailures = 0;
+	double dCacheMs[iNumWarmLoads + 1], dCheckMs[iNumWarmLoads + 1];
+	size_t iFileSize = 0;
+	for (int i = 0; i <= iNumWarmLoads; i++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		MeshCache cache;
+		bool bLoaded = cache.Open(sCacheFilename.c_str());
+		std::chrono::high_resolution_clock::time_point checkStart = std::chrono::high_resolution_clock::now();
+		bLoaded = bLoaded && cache.IsUpToDate(sizeof(BenchmarkMesh::Vertex));
+		dCheckMs[i] = GetElapsedMs(checkStart);
+		if (!bLoaded)
+		{
+			VS_LOG_VERBOSE("Mesh cache benchmark couldn't load the cache it wrote");
+			return false;
+		}
+		for (int s = 0; s < cache.GetNumSubMeshes(); s++)
+		{
+			upload(cache.GetVertices(s), cache.GetSubMesh(s).iNumVertices * sizeof(BenchmarkMesh::Vertex));
+			upload(cache.GetIndices(s), cache.GetSubMesh(s).iNumIndices * cache.GetSubMesh(s).iIndexSize);
+		}
+		dCacheMs[i] = GetElapsedMs(start);
+		iFileSize = cache.GetFileSizeInBytes();
+		if (i == 0)
+		{
+			iFailures += CompareWithCache(cache, sizeof(BenchmarkMesh::Vertex), arrSubMeshes, std::vector<std::string>(), arrSourceFiles);
+		}
+	}
+
+	double dFileMB = iFileSize / (1024.0 * 1024.0);
+	outfile << "Obj," << std::accumulate(dObjMs, dObjMs + iNumWarmLoads, 0.0) / iNumWarmLoads << "," << *std::min_element(dObjMs, dObjMs + iNumWarmLoads) << ","
+		<< *std::max_element(dObjMs, dObjMs + iNumWarmLoads) << ",0,0\n";
+	outfile << "Cache First," << dCacheMs[0] << "," << dCacheMs[0] << "," << dCacheMs[0] << "," << dCheckMs[0] << "," << dFileMB << "\n";
+	outfile << "Cache Warm," << std::accumulate(dCacheMs + 1, dCacheMs + iNumWarmLoads + 1, 0.0) / iNumWarmLoads << "," << *std::min_element(dCacheMs + 1, dCacheMs + iNumWarmLoads + 1) << ","
+		<< *std::max_element(dCacheMs + 1, dCacheMs + iNumWarmLoads + 1) << "," << std::accumulate(dCheckMs + 1, dCheckMs + iNumWarmLoads + 1, 0.0) / iNumWarmLoads << "," << dFileMB << "\n";
+	outfile << "\nMismatches:," << iFailures;
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+	remove(sCacheFilename.c_str());
+
+	VS_LOG(sName << " mesh cache: obj " << *std::min_element(dObjMs, dObjMs + iNumWarmLoads) << "ms, cache first load " << dCacheMs[0] << "ms, warm "
+		<< *std::min_element(dCacheMs + 1, dCacheMs + iNumWarmLoads + 1) << "ms");
+	return iFailures == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
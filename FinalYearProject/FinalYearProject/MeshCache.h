@@ -0,0 +1,131 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Fixed size header at the start of a mesh cache file. The submesh table follows it, then the strings, then each
+//submesh's vertices and indices starting on kDataAlignment boundaries. Indices are 16 bit where the submesh allows.
+struct MeshCacheHeader
+{
+	uint32_t iMagic;
+	uint32_t iVersion;
+	uint32_t iHeaderSize;
+	uint32_t iVertexStride;			//the vertices are stored exactly as the vertex buffer takes them
+	uint32_t iNumSubMeshes;
+	uint32_t iNumMaterialLibraries;
+	uint32_t iNumSourceFiles;
+	uint32_t iPadding;
+	uint64_t iContentHash;			//of the source files and the vertex stride, see MeshCache::HashSourceFiles
+	uint64_t iSubMeshTableOffset;
+	uint64_t iStringsOffset;		//null terminated: each submesh's material, then the libraries, then the sources
+	uint64_t iStringsSize;
+	float fMin[3];
+	float fMax[3];
+
+	struct SubMesh
+	{
+		uint64_t iVertexOffset;		//from the start of the file
+		uint64_t iIndexOffset;
+		uint32_t iNumVertices;
+		uint32_t iNumIndices;
+		uint32_t iIndexSize;		//2 or 4 bytes
+		uint32_t iPadding;
+		float fMin[3];
+		float fMax[3];
+	};
+};
+
+//A mesh's vertex and index buffers on disk so startup can skip parsing the obj, working out tangents and bounds and
+//building the vertex arrays. Write bakes the arrays out, Open maps the file read only and GetVertices/GetIndices point
+//straight into the mapping for CreateBuffer to read from. The cache lists the files it was built from and
+//IsUpToDate hashes them again, so editing the obj, a material library or a texture makes it rebuild.
+class MeshCache
+{
+public:
+
+	static const uint32_t kMagic = 0x4853454d;	//"MESH"
+	static const uint32_t kVersion = 3;
+	static const int kDataAlignment = 64;
+
+	//What goes in for a submesh
+	struct SubMeshData
+	{
+		std::string sMaterial;
+		const void* pVertices;
+		uint32_t iNumVertices;
+		const void* pIndices;
+		uint32_t iNumIndices;
+		uint32_t iIndexSize;
+		XMFLOAT3 vMin;
+		XMFLOAT3 vMax;
+	};
+
+	MeshCache();
+	~MeshCache();
+
+	//Every file's contents, with the vertex stride so a change to the vertex layout rebuilds too
+	static uint64_t HashSourceFiles(const std::vector<std::string>& arrSourceFiles, uint32_t iVertexStride);
+
+	static bool Write(const char* filename, uint32_t iVertexStride, const std::vector<SubMeshData>& arrSubMeshes, const std::vector<std::string>& arrMaterialLibraries,
+		const std::vector<std::string>& arrSourceFiles, const XMFLOAT3& vMin, const XMFLOAT3& vMax);
+
+	//Maps the file and checks the header, tables and strings fit in it. Doesn't touch the vertices.
+	bool Open(const char* filename);
+	void Close();
+	bool IsOpen() const { return m_pMapped != nullptr; }
+
+	//Same vertex stride, and the source files hash the same as when it was written. Reads every source file.
+	bool IsUpToDate(uint32_t iVertexStride) const;
+
+	int GetNumSubMeshes() const { return static_cast<int>(m_pHeader->iNumSubMeshes); }
+	const MeshCacheHeader::SubMesh& GetSubMesh(int iSubMesh) const { return m_pSubMeshes[iSubMesh]; }
+	const void* GetVertices(int iSubMesh) const { return m_pMapped + m_pSubMeshes[iSubMesh].iVertexOffset; }
+	const void* GetIndices(int iSubMesh) const { return m_pMapped + m_pSubMeshes[iSubMesh].iIndexOffset; }
+	const std::string& GetMaterialName(int iSubMesh) const { return m_arrMaterialNames[iSubMesh]; }
+	const std::vector<std::string>& GetMaterialLibraries() const { return m_arrMaterialLibraries; }
+	const std::vector<std::string>& GetSourceFiles() const { return m_arrSourceFiles; }
+	const MeshCacheHeader& GetHeader() const { return *m_pHeader; }
+
+	size_t GetFileSizeInBytes() const { return m_iFileSize; }
+
+	//Random submeshes written and read back, a source file changing, and truncated or corrupt files being turned down.
+	//Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Loading the obj into vertex arrays against loading the cache, the first time after writing it and then warm,
+	//writing to ../Results/MeshCache_<sName>.csv
+	static bool RunBenchmark(const char* sName, const char* objFilename);
+
+private:
+
+	const uint8_t* m_pMapped;
+	size_t m_iFileSize;
+	const MeshCacheHeader* m_pHeader;
+	const MeshCacheHeader::SubMesh* m_pSubMeshes;
+
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_iFile;
+#endif
+
+	std::vector<std::string> m_arrMaterialNames;
+	std::vector<std::string> m_arrMaterialLibraries;
+	std::vector<std::string> m_arrSourceFiles;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !MESH_CACHE_H
@@ -0,0 +1,554 @@
+#include "MeshOptimiser.h"
+#include "BenchmarkMesh.h"
+#include "VertexWelder.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <random>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int MeshOptimiser::kCacheSize;
+const float MeshOptimiser::kOverdrawThreshold = 1.05f;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	const uint32_t kUnused = 0xffffffff;
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//FIFO post transform cache: a vertex is in it if it missed within the last iCacheSize misses
+	struct CacheSimulator
+	{
+		std::vector<uint32_t> arrMissedAt;
+		uint32_t iNumMisses;
+		int iCacheSize;
+
+		CacheSimulator(uint32_t iNumVertices, int iSize)
+			: arrMissedAt(iNumVertices, 0)
+			, iNumMisses(0)
+			, iCacheSize(iSize)
+		{
+		}
+
+		//Returns true on a miss
+		bool Use(uint32_t iVertex)
+		{
+			if (arrMissedAt[iVertex] != 0 && iNumMisses - arrMissedAt[iVertex] < static_cast<uint32_t>(iCacheSize))
+			{
+				return false;
+			}
+			arrMissedAt[iVertex] = ++iNumMisses;
+			return true;
+		}
+
+		//Empty it without clearing the array, by moving everything that's in it out of the window
+		void Flush()
+		{
+			iNumMisses += iCacheSize;
+		}
+	};
+
+	uint32_t CountCacheMisses(const uint32_t* pIndices, uint32_t iNumIndices, uint32_t iNumVertices, int iCacheSize)
+	{
+		CacheSimulator cache(iNumVertices, iCacheSize);
+		uint32_t iMisses = 0;
+		for (uint32_t i = 0; i < iNumIndices; i++)
+		{
+			iMisses += cache.Use(pIndices[i]);
+		}
+		return iMisses;
+	}
+
+	//Test vertex that remembers where it started
+	struct TestVertex
+	{
+		XMFLOAT3 position;
+		XMFLOAT3 normal;
+		uint32_t iId;
+	};
+
+	//Each triangle's corners as bytes, sorted, to check the same triangles come out in some order with their winding
+	template<typename Vertex>
+	std::vector<std::string> GetSortedTriangles(const std::vector<Vertex>& arrVertices, const std::vector<uint32_t>& arrIndices, size_t iCornerBytes)
+	{
+		std::vector<std::string> arrTriangles(arrIndices.size() / 3);
+		for (size_t t = 0; t < arrTriangles.size(); t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				arrTriangles[t].append(reinterpret_cast<const char*>(&arrVertices[arrIndices[t * 3 + c]]), iCornerBytes);
+			}
+		}
+		std::sort(arrTriangles.begin(), arrTriangles.end());
+		return arrTriangles;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float MeshOptimiser::CalculateACMR(const uint32_t* pIndices, uint32_t iNumIndices, uint32_t iNumVertices, int iCacheSize)
+{
+	if (iNumIndices < 3)
+	{
+		return 0.f;
+	}
+	return static_cast<float>(CountCacheMisses(pIndices, iNumIndices, iNumVertices, iCacheSize)) / (iNumIndices / 3);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float MeshOptimiser::CalculateATVR(const uint32_t* pIndices, uint32_t iNumIndices, uint32_t iNumVertices, int iCacheSize)
+{
+	std::vector<bool> arrUsed(iNumVertices, false);
+	uint32_t iNumUsed = 0;
+	for (uint32_t i = 0; i < iNumIndices; i++)
+	{
+		iNumUsed += !arrUsed[pIndices[i]];
+		arrUsed[pIndices[i]] = true;
+	}
+	if (iNumUsed == 0)
+	{
+		return 0.f;
+	}
+	return static_cast<float>(CountCacheMisses(pIndices, iNumIndices, iNumVertices, iCacheSize)) / iNumUsed;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MeshOptimiser::OptimiseVertexCache(const uint32_t* pIndices, uint32_t iNumIndices, uint32_t iNumVertices, int iCacheSize, uint32_t* pDestIndices, std::vector<uint32_t>& arrClusters)
+{
+	arrClusters.clear();
+	uint32_t iNumTriangles = iNumIndices / 3;
+	if (iNumTriangles == 0)
+	{
+		return;
+	}
+
+	//The triangles using each vertex, and how many of them are still to be emitted
+	std::vector<uint32_t> arrLiveTriangles(iNumVertices, 0);
+	for (uint32_t i = 0; i < iNumTriangles * 3; i++)
+	{
+		arrLiveTriangles[pIndices[i]]++;
+	}
+	std::vector<uint32_t> arrAdjacencyOffsets(iNumVertices + 1, 0);
+	for (uint32_t v = 0; v < iNumVertices; v++)
+	{
+		arrAdjacencyOffsets[v + 1] = arrAdjacencyOffsets[v] + arrLiveTriangles[v];
+	}
+	std::vector<uint32_t> arrAdjacency(arrAdjacencyOffsets[iNumVertices]);
+	std::vector<uint32_t> arrFill(arrAdjacencyOffsets.begin(), arrAdjacencyOffsets.end() - 1);
+	for (uint32_t i = 0; i < iNumTriangles * 3; i++)
+	{
+		arrAdjacency[arrFill[pIndices[i]]++] = i / 3;
+	}
+
+	std::vector<int> arrCacheTime(iNumVertices, 0);
+	std::vector<bool> arrEmitted(iNumTriangles, false);
+	std::vector<uint32_t> arrDeadEnds;
+	std::vector<uint32_t> arrCandidates;
+	int iTime = iCacheSize + 1;
+	uint32_t iCursor = 0;
+	uint32_t iNumEmitted = 0;
+
+	//Picks up wherever there's something left when fanning runs dry: recently used vertices first, then the input order
+	auto skipDeadEnd = [&]() -> uint32_t
+	{
+		while (!arrDeadEnds.empty())
+		{
+			uint32_t iVertex = arrDeadEnds.back();
+			arrDeadEnds.pop_back();
+			if (arrLiveTriangles[iVertex] > 0)
+			{
+				return iVertex;
+			}
+		}
+		for (; iCursor < iNumVertices; iCursor++)
+		{
+			if (arrLiveTriangles[iCursor] > 0)
+			{
+				return iCursor;
+			}
+		}
+		return kUnused;
+	};
+
+	uint32_t iFanning = skipDeadEnd();
+	arrClusters.push_back(0);
+	while (iFanning != kUnused)
+	{
+		//Emit every triangle left around the fanning vertex
+		arrCandidates.clear();
+		for (uint32_t a = arrAdjacencyOffsets[iFanning]; a < arrAdjacencyOffsets[iFanning + 1]; a++)
+		{
+			uint32_t iTriangle = arrAdjacency[a];
+			if (arrEmitted[iTriangle])
+			{
+				continue;
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t iVertex = pIndices[iTriangle * 3 + c];
+				pDestIndices[iNumEmitted * 3 + c] = iVertex;
+				arrDeadEnds.push_back(iVertex);
+				arrCandidates.push_back(iVertex);
+				arrLiveTriangles[iVertex]--;
+				if (iTime - arrCacheTime[iVertex] > iCacheSize)
+				{
+					arrCacheTime[iVertex] = iTime++;
+				}
+			}
+			arrEmitted[iTriangle] = true;
+			iNumEmitted++;
+		}
+
+		//Next is the candidate that'll still be in the cache once its own triangles are done and has been there longest,
+		//otherwise any candidate with triangles left
+		uint32_t iNext = kUnused;
+		int iBestPriority = -1;
+		for (size_t n = 0; n < arrCandidates.size(); n++)
+		{
+			uint32_t iVertex = arrCandidates[n];
+			if (arrLiveTriangles[iVertex] == 0)
+			{
+				continue;
+			}
+			int iPriority = 0;
+			if (iTime - arrCacheTime[iVertex] + 2 * static_cast<int>(arrLiveTriangles[iVertex]) <= iCacheSize)
+			{
+				iPriority = iTime - arrCacheTime[iVertex];
+			}
+			if (iPriority > iBestPriority)
+			{
+				iBestPriority = iPriority;
+				iNext = iVertex;
+			}
+		}
+		if (iNext == kUnused)
+		{
+			iNext = skipDeadEnd();
+			if (iNext != kUnused && iNumEmitted < iNumTriangles)
+			{
+				arrClusters.push_back(iNumEmitted);
+			}
+		}
+		iFanning = iNext;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int MeshOptimiser::OptimiseOverdraw(const uint32_t* pIndices, uint32_t iNumIndices, const XMFLOAT3* pPositions, const XMFLOAT3* pNormals, uint32_t iNumVertices,
+	int iCacheSize, const std::vector<uint32_t>& arrClusters, uint32_t* pDestIndices)
+{
+	uint32_t iNumTriangles = iNumIndices / 3;
+	if (iNumTriangles == 0)
+	{
+		return 0;
+	}
+
+	//Cut the runs wherever they've been about as cheap as the whole submesh, so the sort has more to work with
+	float fThreshold = kOverdrawThreshold * CalculateACMR(pIndices, iNumTriangles * 3, iNumVertices, iCacheSize);
+	std::vector<uint32_t> arrStarts;
+	CacheSimulator cache(iNumVertices, iCacheSize);
+	for (size_t c = 0; c < arrClusters.size(); c++)
+	{
+		uint32_t iEnd = c + 1 < arrClusters.size() ? arrClusters[c + 1] : iNumTriangles;
+		uint32_t iStart = arrClusters[c];
+		uint32_t iMisses = 0;
+		cache.Flush();
+		arrStarts.push_back(iStart);
+		for (uint32_t t = iStart; t < iEnd; t++)
+		{
+			for (int v = 0; v < 3; v++)
+			{
+				iMisses += cache.Use(pIndices[t * 3 + v]);
+			}
+			if (t + 1 < iEnd && static_cast<float>(iMisses) / (t + 1 - iStart) <= fThreshold)
+			{
+				arrStarts.push_back(t + 1);
+				iStart = t + 1;
+				iMisses = 0;
+				cache.Flush();
+			}
+		}
+	}
+	int iNumClusters = static_cast<int>(arrStarts.size());
+
+	//Each cluster's area weighted centre and facing, with the faces turned to agree with the vertex normals whatever
+	//the winding
+	std::vector<XMFLOAT3> arrCentres(iNumClusters), arrFacings(iNumClusters);
+	XMVECTOR vMeshCentre = XMVectorZero();
+	float fMeshArea = 0.f;
+	for (int c = 0; c < iNumClusters; c++)
+	{
+		uint32_t iEnd = c + 1 < iNumClusters ? arrStarts[c + 1] : iNumTriangles;
+		XMVECTOR vCentre = XMVectorZero(), vUnweightedCentre = XMVectorZero(), vFacing = XMVectorZero();
+		float fArea = 0.f;
+		for (uint32_t t = arrStarts[c]; t < iEnd; t++)
+		{
+			const uint32_t* pTriangle = &pIndices[t * 3];
+			XMVECTOR vA = XMLoadFloat3(&pPositions[pTriangle[0]]);
+			XMVECTOR vB = XMLoadFloat3(&pPositions[pTriangle[1]]);
+			XMVECTOR vC = XMLoadFloat3(&pPositions[pTriangle[2]]);
+			XMVECTOR vNormal = XMVector3Cross(XMVectorSubtract(vB, vA), XMVectorSubtract(vC, vA));
+			XMVECTOR vVertexNormals = XMVectorAdd(XMVectorAdd(XMLoadFloat3(&pNormals[pTriangle[0]]), XMLoadFloat3(&pNormals[pTriangle[1]])), XMLoadFloat3(&pNormals[pTriangle[2]]));
+			if (XMVectorGetX(XMVector3Dot(vNormal, vVertexNormals)) < 0.f)
+			{
+				vNormal = XMVectorNegate(vNormal);
+			}
+			float fTriangleArea = 0.5f * XMVectorGetX(XMVector3Length(vNormal));
+			XMVECTOR vTriangleCentre = XMVectorScale(XMVectorAdd(XMVectorAdd(vA, vB), vC), 1.f / 3.f);
+			vCentre = XMVectorAdd(vCentre, XMVectorScale(vTriangleCentre, fTriangleArea));
+			vUnweightedCentre = XMVectorAdd(vUnweightedCentre, vTriangleCentre);
+			vFacing = XMVectorAdd(vFacing, vNormal);
+			fArea += fTriangleArea;
+		}
+		vMeshCentre = XMVectorAdd(vMeshCentre, vCentre);
+		fMeshArea += fArea;
+		vCentre = fArea > 0.f ? XMVectorScale(vCentre, 1.f / fArea) : XMVectorScale(vUnweightedCentre, 1.f / (iEnd - arrStarts[c]));
+		XMStoreFloat3(&arrCentres[c], vCentre);
+		XMStoreFloat3(&arrFacings[c], XMVectorGetX(XMVector3LengthSq(vFacing)) > 0.f ? XMVector3Normalize(vFacing) : XMVectorZero());
+	}
+	vMeshCentre = fMeshArea > 0.f ? XMVectorScale(vMeshCentre, 1.f / fMeshArea) : XMVectorZero();
+
+	//Clusters out at the edge and facing away from the middle hide the most, so go first. Stable for determinism.
+	std::vector<float> arrOcclusion(iNumClusters);
+	for (int c = 0; c < iNumClusters; c++)
+	{
+		arrOcclusion[c] = XMVectorGetX(XMVector3Dot(XMVectorSubtract(XMLoadFloat3(&arrCentres[c]), vMeshCentre), XMLoadFloat3(&arrFacings[c])));
+	}
+	std::vector<int> arrOrder(iNumClusters);
+	std::iota(arrOrder.begin(), arrOrder.end(), 0);
+	std::stable_sort(arrOrder.begin(), arrOrder.end(), [&](int a, int b) { return arrOcclusion[a] > arrOcclusion[b]; });
+
+	uint32_t* pDest = pDestIndices;
+	for (int o = 0; o < iNumClusters; o++)
+	{
+		int c = arrOrder[o];
+		uint32_t iEnd = c + 1 < iNumClusters ? arrStarts[c + 1] : iNumTriangles;
+		size_t iCount = static_cast<size_t>(iEnd - arrStarts[c]) * 3;
+		memcpy(pDest, &pIndices[arrStarts[c] * 3], iCount * sizeof(uint32_t));
+		pDest += iCount;
+	}
+	return iNumClusters;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t MeshOptimiser::OptimiseVertexFetch(uint32_t* pIndices, uint32_t iNumIndices, uint32_t iNumVertices, std::vector<uint32_t>& arrRemap)
+{
+	arrRemap.assign(iNumVertices, kUnused);
+	uint32_t iNumUsed = 0;
+	for (uint32_t i = 0; i < iNumIndices; i++)
+	{
+		uint32_t& iRemapped = arrRemap[pIndices[i]];
+		if (iRemapped == kUnused)
+		{
+			iRemapped = iNumUsed++;
+		}
+		pIndices[i] = iRemapped;
+	}
+	return iNumUsed;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int MeshOptimiser::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	//A lone triangle misses every corner, a quad shares two
+	uint32_t arrQuad[6] = { 0, 1, 2, 2, 1, 3 };
+	iFailures += CalculateACMR(arrQuad, 3, 4, kCacheSize) != 3.f;
+	iFailures += CalculateACMR(arrQuad, 6, 4, kCacheSize) != 2.f;
+	iFailures += CalculateATVR(arrQuad, 6, 4, kCacheSize) != 1.f;
+
+	for (int iTest = 0; iTest < 12; iTest++)
+	{
+		//Grids too big for the cache with their triangles shuffled, which Tipsify should always improve on, or random soups
+		bool bGrid = iTest % 3 != 2;
+		std::vector<TestVertex> arrVertices;
+		std::vector<uint32_t> arrIndices;
+		if (bGrid)
+		{
+			uint32_t iWidth = 8 + rng() % 60, iHeight = 8 + rng() % 60;
+			for (uint32_t y = 0; y <= iHeight; y++)
+			{
+				for (uint32_t x = 0; x <= iWidth; x++)
+				{
+					//Bent into a half pipe so the clusters face different ways
+					float fAngle = 3.14159f * x / iWidth;
+					TestVertex vertex = { XMFLOAT3(cosf(fAngle), sinf(fAngle), static_cast<float>(y)), XMFLOAT3(-cosf(fAngle), -sinf(fAngle), 0.f), static_cast<uint32_t>(arrVertices.size()) };
+					arrVertices.push_back(vertex);
+				}
+			}
+			std::vector<uint32_t> arrQuads(iWidth * iHeight);
+			std::iota(arrQuads.begin(), arrQuads.end(), 0);
+			std::shuffle(arrQuads.begin(), arrQuads.end(), rng);
+			for (size_t q = 0; q < arrQuads.size(); q++)
+			{
+				uint32_t x = arrQuads[q] % iWidth, y = arrQuads[q] / iWidth;
+				uint32_t i0 = y * (iWidth + 1) + x, i1 = i0 + 1, i2 = i0 + iWidth + 1, i3 = i2 + 1;
+				uint32_t arrQuadIndices[6] = { i0, i1, i3, i0, i3, i2 };
+				arrIndices.insert(arrIndices.end(), arrQuadIndices, arrQuadIndices + 6);
+			}
+		}
+		else
+		{
+			uint32_t iNumVertices = 1 + rng() % 500;
+			for (uint32_t v = 0; v < iNumVertices; v++)
+			{
+				TestVertex vertex = { XMFLOAT3(static_cast<float>(rng() % 100), static_cast<float>(rng() % 100), static_cast<float>(rng() % 100)), XMFLOAT3(0.f, 1.f, 0.f), v };
+				arrVertices.push_back(vertex);
+			}
+			arrIndices.resize(3 * (rng() % 2000));
+			for (size_t i = 0; i < arrIndices.size(); i++)
+			{
+				arrIndices[i] = rng() % iNumVertices;
+			}
+		}
+
+		std::vector<TestVertex> arrOriginalVertices = arrVertices;
+		std::vector<uint32_t> arrOriginalIndices = arrIndices;
+		Stats stats = Optimise(arrVertices, arrIndices);
+
+		//Same triangles, same winding, same vertices
+		iFailures += arrIndices.size() != arrOriginalIndices.size();
+		iFailures += GetSortedTriangles(arrVertices, arrIndices, sizeof(TestVertex)) != GetSortedTriangles(arrOriginalVertices, arrOriginalIndices, sizeof(TestVertex));
+
+		//Vertices numbered in the order they're first used
+		uint32_t iNextNew = 0;
+		for (size_t i = 0; i < arrIndices.size(); i++)
+		{
+			if (arrIndices[i] > iNextNew)
+			{
+				iFailures++;
+				break;
+			}
+			iNextNew += arrIndices[i] == iNextNew;
+		}
+		iFailures += iNextNew != arrVertices.size();
+
+		iFailures += stats.fACMRAfter != CalculateACMR(arrIndices.data(), static_cast<uint32_t>(arrIndices.size()), static_cast<uint32_t>(arrVertices.size()), kCacheSize);
+		if (bGrid)
+		{
+			iFailures += stats.fACMRAfter >= stats.fACMRBefore || stats.fATVRAfter >= stats.fATVRBefore;
+		}
+
+		//Again from the same input gives the same output
+		std::vector<TestVertex> arrVerticesAgain = arrOriginalVertices;
+		std::vector<uint32_t> arrIndicesAgain = arrOriginalIndices;
+		Optimise(arrVerticesAgain, arrIndicesAgain);
+		iFailures += arrIndicesAgain != arrIndices;
+		for (size_t v = 0; v < arrVertices.size() && v < arrVerticesAgain.size(); v++)
+		{
+			iFailures += arrVertices[v].iId != arrVerticesAgain[v].iId;
+		}
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool MeshOptimiser::RunBenchmark(const char* sName, const char* objFilename)
+{
+	std::stringstream ss;
+	ss << "../Results/MeshOptimiser_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open mesh optimiser benchmark output file");
+		return false;
+	}
+
+	std::vector<BenchmarkMesh::SubMesh> arrWelded;
+	XMFLOAT3 vMin, vMax;
+	if (!BenchmarkMesh::LoadObj(objFilename, arrWelded, vMin, vMax))
+	{
+		VS_LOG_VERBOSE("Failed to load " << objFilename << " for the mesh optimiser benchmark");
+		return false;
+	}
+	int iNumSubMeshes = static_cast<int>(arrWelded.size());
+	Parallel::For(iNumSubMeshes, 0, [&](int s, int)
+	{
+		VertexWelder::WeldTangentFrames(arrWelded[s].arrVertices, arrWelded[s].arrIndices);
+	});
+
+	outfile << std::fixed << "Threads, Optimise(ms)\n";
+	std::vector<BenchmarkMesh::SubMesh> arrOptimised;
+	std::vector<Stats> arrStats(iNumSubMeshes);
+	int iMaxThreads = Parallel::GetNumWorkerThreads();
+	for (int iNumThreads = 1; ; iNumThreads = std::min(iNumThreads * 2, iMaxThreads))
+	{
+		double dBestMs = 0.0;
+		for (int iRun = 0; iRun < 3; iRun++)
+		{
+			arrOptimised = arrWelded;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			Parallel::For(iNumSubMeshes, iNumThreads, [&](int s, int)
+			{
+				arrStats[s] = Optimise(arrOptimised[s].arrVertices, arrOptimised[s].arrIndices);
+			});
+			double dMs = GetElapsedMs(start);
+			if (iRun == 0 || dMs < dBestMs)
+			{
+				dBestMs = dMs;
+			}
+		}
+		outfile << iNumThreads << "," << dBestMs << "\n";
+		VS_LOG(sName << " mesh optimiser " << iNumThreads << " threads: " << dBestMs << "ms");
+
+		if (iNumThreads == iMaxThreads)
+		{
+			break;
+		}
+	}
+
+	//Weighted by triangles for ACMR and vertices for ATVR, so they're the whole mesh's
+	double dMissesBefore = 0.0, dMissesAfter = 0.0;
+	size_t iNumTriangles = 0, iNumVertices = 0;
+	int iNumClusters = 0, iMismatches = 0;
+	for (int s = 0; s < iNumSubMeshes; s++)
+	{
+		size_t iSubMeshTriangles = arrWelded[s].arrIndices.size() / 3;
+		dMissesBefore += arrStats[s].fACMRBefore * iSubMeshTriangles;
+		dMissesAfter += arrStats[s].fACMRAfter * iSubMeshTriangles;
+		iNumTriangles += iSubMeshTriangles;
+		iNumVertices += arrOptimised[s].arrVertices.size();
+		iNumClusters += arrStats[s].iNumClusters;
+		iMismatches += GetSortedTriangles(arrOptimised[s].arrVertices, arrOptimised[s].arrIndices, offsetof(BenchmarkMesh::Vertex, tangent))
+			!= GetSortedTriangles(arrWelded[s].arrVertices, arrWelded[s].arrIndices, offsetof(BenchmarkMesh::Vertex, tangent));
+	}
+	double dACMRBefore = iNumTriangles > 0 ? dMissesBefore / iNumTriangles : 0.0;
+	double dACMRAfter = iNumTriangles > 0 ? dMissesAfter / iNumTriangles : 0.0;
+	double dATVRBefore = iNumVertices > 0 ? dMissesBefore / iNumVertices : 0.0;
+	double dATVRAfter = iNumVertices > 0 ? dMissesAfter / iNumVertices : 0.0;
+	outfile << "\nSubMeshes, Triangles, Vertices, Clusters, Cache Size, ACMR Before, ACMR After, ATVR Before, ATVR After\n";
+	outfile << iNumSubMeshes << "," << iNumTriangles << "," << iNumVertices << "," << iNumClusters << "," << kCacheSize << ","
+		<< dACMRBefore << "," << dACMRAfter << "," << dATVRBefore << "," << dATVRAfter << "\n";
+	VS_LOG(sName << " mesh optimiser: ACMR " << dACMRBefore << " to " << dACMRAfter << ", ATVR " << dATVRBefore << " to " << dATVRAfter);
+
+	outfile << "\nMismatches:," << iMismatches;
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iMismatches == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,18 @@
+#ifndef NO_FLOAT_CONTRACTION_H
+#define NO_FLOAT_CONTRACTION_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Included first by the files whose SIMD kernels have to give the same bits as their scalar versions. Fusing a multiply
+//and an add into an FMA skips a rounding, so if the compiler contracts some paths and not others they stop agreeing.
+//This turns contraction off for the whole file whatever the build settings. gcc has no pragma for it that doesn't
+//also change inlining, so gcc builds rely on -ffp-contract=off, which CMakeLists.txt sets.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !NO_FLOAT_CONTRACTION_H
@@ -0,0 +1,874 @@
+#include "ObjParser.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+#include <fstream>
+#include <sstream>
+#include <random>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Chunks are cut to give each thread several, so a chunk of long face lines doesn't hold the rest up
+	const int kChunksPerThread = 8;
+	const size_t kMinChunkSize = 64 * 1024;
+
+	//Exactly representable, so dividing by them rounds the same as strtod does
+	const double kPowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+		1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	//The next whitespace delimited token on the line, empty at the end of it
+	inline void NextToken(const char*& p, const char* pEnd, const char*& pToken, const char*& pTokenEnd)
+	{
+		while (p < pEnd && IsSpace(*p))
+		{
+			p++;
+		}
+		pToken = p;
+		while (p < pEnd && !IsSpace(*p))
+		{
+			p++;
+		}
+		pTokenEnd = p;
+	}
+
+	//atof of the token. A mantissa of at most 2^53 over a power of 10 of at most 10^22 is two exact doubles, so the
+	//division is correctly rounded just as strtod is; everything else goes to strtod itself.
+	float ParseFloat(const char* p, const char* pEnd)
+	{
+		const char* s = p;
+		bool bNegative = false;
+		if (s < pEnd && (*s == '-' || *s == '+'))
+		{
+			bNegative = *s == '-';
+			s++;
+		}
+		uint64_t iMantissa = 0;
+		int iNumDigits = 0, iNumFractionDigits = 0;
+		while (s < pEnd && *s >= '0' && *s <= '9' && iNumDigits < 18)
+		{
+			iMantissa = iMantissa * 10 + (*s++ - '0');
+			iNumDigits++;
+		}
+		if (s < pEnd && *s == '.')
+		{
+			s++;
+			while (s < pEnd && *s >= '0' && *s <= '9' && iNumDigits < 18)
+			{
+				iMantissa = iMantissa * 10 + (*s++ - '0');
+				iNumDigits++;
+				iNumFractionDigits++;
+			}
+		}
+		if (s == pEnd && iNumDigits > 0 && iMantissa <= (1ULL << 53) && iNumFractionDigits <= 22)
+		{
+			double dValue = static_cast<double>(iMantissa) / kPowersOf10[iNumFractionDigits];
+			return static_cast<float>(bNegative ? -dValue : dValue);
+		}
+
+		char buffer[64];
+		size_t iLength = pEnd - p;
+		if (iLength < sizeof(buffer))
+		{
+			memcpy(buffer, p, iLength);
+			buffer[iLength] = '\0';
+			return static_cast<float>(atof(buffer));
+		}
+		return static_cast<float>(atof(std::string(p, pEnd).c_str()));
+	}
+
+	inline bool ParseInt(const char*& p, const char* pEnd, int& iValue)
+	{
+		bool bNegative = p < pEnd && *p == '-';
+		if (p < pEnd && (*p == '-' || *p == '+'))
+		{
+			p++;
+		}
+		const char* pStart = p;
+		long long iResult = 0;
+		while (p < pEnd && *p >= '0' && *p <= '9' && iResult <= INT_MAX)
+		{
+			iResult = iResult * 10 + (*p++ - '0');
+		}
+		if (p == pStart || iResult > INT_MAX)
+		{
+			return false;
+		}
+		iValue = static_cast<int>(bNegative ? -iResult : iResult);
+		return true;
+	}
+
+	//One v/vt/vn corner, 0 based
+	inline bool ParseCorner(const char*& p, const char* pEnd, int* pCorner)
+	{
+		const char* pToken;
+		const char* pTokenEnd;
+		NextToken(p, pEnd, pToken, pTokenEnd);
+		for (int i = 0; i < 3; i++)
+		{
+			if ((i > 0 && (pToken == pTokenEnd || *pToken++ != '/')) || !ParseInt(pToken, pTokenEnd, pCorner[i]) || pCorner[i] < 1)
+			{
+				return false;
+			}
+			pCorner[i]--;
+		}
+		return pToken == pTokenEnd;
+	}
+
+	inline bool IsKeyword(const char* pToken, const char* pTokenEnd, const char* sKeyword)
+	{
+		size_t iLength = strlen(sKeyword);
+		return static_cast<size_t>(pTokenEnd - pToken) == iLength && memcmp(pToken, sKeyword, iLength) == 0;
+	}
+
+	struct ReferenceCorner
+	{
+		XMFLOAT3 pos;
+		XMFLOAT2 tex;
+		XMFLOAT3 norm;
+	};
+
+	struct ReferenceGroup
+	{
+		std::string sMaterial;
+		int iNumMaterialLibraries;
+		std::vector<ReferenceCorner> arrCorners;
+	};
+
+	//Mesh::LoadModelFromObjFile as it was before this, without the materials, to check against and time
+	bool LoadReference(const char* filename, std::vector<ReferenceGroup>& arrGroups, std::vector<std::string>& arrMaterialLibraries)
+	{
+		std::ifstream fin;
+		fin.open(filename);
+		if (fin.fail())
+		{
+			return false;
+		}
+
+		std::vector<XMFLOAT3> Verts;
+		std::vector<XMFLOAT2> TexCoords;
+		std::vector<XMFLOAT3> Normals;
+
+		std::string s;
+		int iObjectIndex(-1);
+		int iFaceIndex = 0;
+		char checkChar;
+		char nums[64];
+		while (fin)
+		{
+			checkChar = fin.get();
+			switch (checkChar)
+			{
+			case '#':
+			case 'g':
+			case 's':
+				checkChar = fin.get();
+				while (checkChar != '\n')
+					checkChar = fin.get();
+				break;
+			case 'v':
+			{
+				checkChar = fin.get();
+				if (checkChar == ' ')
+				{
+					float x, y, z;
+					fin >> nums;
+					x = atof(nums);
+					fin >> nums;
+					y = atof(nums);
+					fin >> nums;
+					z = atof(nums);
+					Verts.push_back(XMFLOAT3(x, y, -z));
+				}
+				else if (checkChar == 't')
+				{
+					float u, v;
+					fin >> nums;
+					u = atof(nums);
+					fin >> nums;
+					v = atof(nums);
+					TexCoords.push_back(XMFLOAT2(u, 1.f - v));
+				}
+				else if (checkChar == 'n')
+				{
+					float x, y, z;
+					fin >> nums;
+					x = atof(nums);
+					fin >> nums;
+					y = atof(nums);
+					fin >> nums;
+					z = atof(nums);
+					Normals.push_back(XMFLOAT3(x, y, -z));
+				}
+				break;
+			}
+			case 'f':
+			{
+				int vIndex[3], tIndex[3], nIndex[3];
+				fin >> vIndex[2] >> checkChar >> tIndex[2] >> checkChar >> nIndex[2]
+					>> vIndex[1] >> checkChar >> tIndex[1] >> checkChar >> nIndex[1]
+					>> vIndex[0] >> checkChar >> tIndex[0] >> checkChar >> nIndex[0];
+
+				int iModelIndex = iFaceIndex * 3;
+				for (int j = 0; j < 3; j++)
+				{
+					arrGroups[iObjectIndex].arrCorners.push_back(ReferenceCorner());
+					arrGroups[iObjectIndex].arrCorners[iModelIndex + j].pos = Verts[vIndex[j] - 1];
+					arrGroups[iObjectIndex].arrCorners[iModelIndex + j].tex = TexCoords[tIndex[j] - 1];
+					arrGroups[iObjectIndex].arrCorners[iModelIndex + j].norm = Normals[nIndex[j] - 1];
+				}
+				iFaceIndex++;
+				break;
+			}
+			case 'u':
+			{
+				fin >> s;
+				if (s == "semtl")
+				{
+					fin >> s;
+					iObjectIndex++;
+					iFaceIndex = 0;
+					ReferenceGroup group;
+					group.sMaterial = s;
+					group.iNumMaterialLibraries = static_cast<int>(arrMaterialLibraries.size());
+					arrGroups.push_back(group);
+				}
+				else
+				{
+					checkChar = fin.get();
+					while (checkChar != '\n')
+						checkChar = fin.get();
+					break;
+				}
+				break;
+			}
+			case 'm':
+			{
+				fin >> s;
+				if (s == "tllib")
+				{
+					std::string sMaterialLibName;
+					fin >> sMaterialLibName;
+					arrMaterialLibraries.push_back(sMaterialLibName);
+				}
+				else
+				{
+					checkChar = fin.get();
+					while (checkChar != '\n')
+						checkChar = fin.get();
+					break;
+				}
+				break;
+			}
+			}
+		}
+		return true;
+	}
+
+	//Failures between what the parser gives and what the reference loader did
+	int CompareWithReference(ObjParser& parser, const std::vector<ReferenceGroup>& arrReferenceGroups, const std::vector<std::string>& arrReferenceLibraries)
+	{
+		int iFailures = 0;
+		const std::vector<ObjParser::Group>& arrGroups = parser.GetGroups();
+		iFailures += parser.GetMaterialLibraries() != arrReferenceLibraries;
+		if (arrGroups.size() != arrReferenceGroups.size())
+		{
+			return iFailures + 1;
+		}
+
+		std::vector<std::vector<ReferenceCorner>> arrCorners(arrGroups.size());
+		std::vector<std::vector<ReferenceCorner>*> arrCornerPointers(arrGroups.size());
+		for (size_t g = 0; g < arrGroups.size(); g++)
+		{
+			arrCornerPointers[g] = &arrCorners[g];
+		}
+		parser.ExpandGroups(arrCornerPointers.data());
+
+		for (size_t g = 0; g < arrGroups.size(); g++)
+		{
+			const ReferenceGroup& reference = arrReferenceGroups[g];
+			iFailures += arrGroups[g].sMaterial != reference.sMaterial;
+			iFailures += arrGroups[g].iNumMaterialLibraries != reference.iNumMaterialLibraries;
+			if (arrCorners[g].size() != reference.arrCorners.size())
+			{
+				iFailures++;
+				continue;
+			}
+			for (size_t i = 0; i < arrCorners[g].size(); i++)
+			{
+				iFailures += memcmp(&arrCorners[g][i], &reference.arrCorners[i], sizeof(ReferenceCorner)) != 0;
+			}
+		}
+		return iFailures;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ObjParser::ObjParser()
+	: m_iNumThreads(0)
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ObjParser::~ObjParser()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ObjParser::Clear()
+{
+	m_arrChunks.clear();
+	m_arrSpans.clear();
+	m_arrGroups.clear();
+	m_arrMaterialLibraries.clear();
+	m_arrPositions.clear();
+	m_arrTexCoords.clear();
+	m_arrNormals.clear();
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ObjParser::Parse(const char* filename, int iNumThreads)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	const char* pMapped = nullptr;
+	size_t iFileSize = 0;
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		VS_LOG_VERBOSE("Failed to open obj " << filename);
+		return false;
+	}
+	LARGE_INTEGER iSize;
+	if (!GetFileSizeEx(hFile, &iSize))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	iFileSize = static_cast<size_t>(iSize.QuadPart);
+	HANDLE hMapping = iFileSize > 0 ? CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	if (hMapping)
+	{
+		pMapped = static_cast<const char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+	}
+#else
+	int iFile = open(filename, O_RDONLY);
+	if (iFile < 0)
+	{
+		VS_LOG_VERBOSE("Failed to open obj " << filename);
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(iFile, &fileStat) != 0)
+	{
+		close(iFile);
+		return false;
+	}
+	iFileSize = static_cast<size_t>(fileStat.st_size);
+	if (iFileSize > 0)
+	{
+		void* pView = mmap(nullptr, iFileSize, PROT_READ, MAP_PRIVATE, iFile, 0);
+		pMapped = pView == MAP_FAILED ? nullptr : static_cast<const char*>(pView);
+	}
+#endif
+
+	bool bResult = false;
+	if (pMapped || iFileSize == 0)
+	{
+		double dMapMs = GetElapsedMs(start);
+		bResult = ParseText(pMapped, iFileSize, iNumThreads);
+		m_Stats.dMapMs = dMapMs;
+	}
+	else
+	{
+		VS_LOG_VERBOSE("Failed to map obj " << filename);
+	}
+
+	//The chunks point into the view, but they're done with once the vertices and faces are out
+	for (size_t i = 0; i < m_arrChunks.size(); i++)
+	{
+		m_arrChunks[i].pBegin = m_arrChunks[i].pEnd = nullptr;
+	}
+#ifdef _WIN32
+	if (pMapped)
+	{
+		UnmapViewOfFile(pMapped);
+	}
+	if (hMapping)
+	{
+		CloseHandle(hMapping);
+	}
+	CloseHandle(hFile);
+#else
+	if (pMapped)
+	{
+		munmap(const_cast<char*>(pMapped), iFileSize);
+	}
+	close(iFile);
+#endif
+	return bResult;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ObjParser::ParseText(const char* pText, size_t iSize, int iNumThreads)
+{
+	Clear();
+	m_iNumThreads = iNumThreads > 0 ? iNumThreads : Parallel::GetNumWorkerThreads();
+	m_Stats.iNumThreads = m_iNumThreads;
+	m_Stats.iFileSize = iSize;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	//Cut on line boundaries, each cut moved on past the next newline
+	size_t iNumChunks = std::max<size_t>(1, std::min<size_t>(m_iNumThreads * kChunksPerThread, iSize / kMinChunkSize));
+	m_arrChunks.resize(iNumChunks);
+	const char* pEnd = pText + iSize;
+	const char* pChunkBegin = pText;
+	for (size_t c = 0; c < iNumChunks; c++)
+	{
+		const char* pChunkEnd = c + 1 == iNumChunks ? pEnd : pText + iSize / iNumChunks * (c + 1);
+		if (pChunkEnd < pChunkBegin)
+		{
+			pChunkEnd = pChunkBegin;
+		}
+		const char* pNewline = pChunkEnd < pEnd ? static_cast<const char*>(memchr(pChunkEnd, '\n', pEnd - pChunkEnd)) : nullptr;
+		pChunkEnd = pNewline ? pNewline + 1 : pEnd;
+		m_arrChunks[c].pBegin = pChunkBegin;
+		m_arrChunks[c].pEnd = pChunkEnd;
+		pChunkBegin = pChunkEnd;
+	}
+	m_Stats.iNumChunks = static_cast<int>(iNumChunks);
+
+	Parallel::For(static_cast<int>(iNumChunks), m_iNumThreads, [&](int iChunk, int)
+	{
+		ParseChunk(m_arrChunks[iChunk]);
+	});
+	m_Stats.dParseMs = GetElapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	bool bResult = Merge();
+	m_Stats.dMergeMs = GetElapsedMs(start);
+	return bResult;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ObjParser::ParseChunk(Chunk& chunk)
+{
+	chunk.iBadLine = -1;
+	chunk.iNumLines = 0;
+	//Roughly what Sponza's lines average, so the arrays don't keep regrowing
+	size_t iSize = chunk.pEnd - chunk.pBegin;
+	chunk.arrPositions.reserve(iSize / 128);
+	chunk.arrTexCoords.reserve(iSize / 128);
+	chunk.arrNormals.reserve(iSize / 128);
+	chunk.arrFaces.reserve(iSize / 32 * 9 / 4);
+
+	const char* p = chunk.pBegin;
+	while (p < chunk.pEnd)
+	{
+		const char* pNewline = static_cast<const char*>(memchr(p, '\n', chunk.pEnd - p));
+		const char* pLineEnd = pNewline ? pNewline : chunk.pEnd;
+
+		const char* pToken;
+		const char* pTokenEnd;
+		NextToken(p, pLineEnd, pToken, pTokenEnd);
+		size_t iKeywordLength = pTokenEnd - pToken;
+		bool bBadLine = false;
+		if (iKeywordLength == 1 && *pToken == 'v')
+		{
+			//Invert the z to change to left hand system
+			float fValues[3];
+			for (int i = 0; i < 3; i++)
+			{
+				NextToken(p, pLineEnd, pToken, pTokenEnd);
+				fValues[i] = ParseFloat(pToken, pTokenEnd);
+			}
+			chunk.arrPositions.push_back(XMFLOAT3(fValues[0], fValues[1], -fValues[2]));
+		}
+		else if (iKeywordLength == 2 && pToken[0] == 'v' && pToken[1] == 't')
+		{
+			//Invert the v to left hand system
+			float fValues[2];
+			for (int i = 0; i < 2; i++)
+			{
+				NextToken(p, pLineEnd, pToken, pTokenEnd);
+				fValues[i] = ParseFloat(pToken, pTokenEnd);
+			}
+			chunk.arrTexCoords.push_back(XMFLOAT2(fValues[0], 1.f - fValues[1]));
+		}
+		else if (iKeywordLength == 2 && pToken[0] == 'v' && pToken[1] == 'n')
+		{
+			float fValues[3];
+			for (int i = 0; i < 3; i++)
+			{
+				NextToken(p, pLineEnd, pToken, pTokenEnd);
+				fValues[i] = ParseFloat(pToken, pTokenEnd);
+			}
+			chunk.arrNormals.push_back(XMFLOAT3(fValues[0], fValues[1], -fValues[2]));
+		}
+		else if (iKeywordLength == 1 && *pToken == 'f')
+		{
+			//Corners reversed for the winding, any past the third ignored
+			int iCorners[9];
+			bBadLine = !ParseCorner(p, pLineEnd, &iCorners[6]) || !ParseCorner(p, pLineEnd, &iCorners[3]) || !ParseCorner(p, pLineEnd, &iCorners[0]);
+			if (!bBadLine)
+			{
+				chunk.arrFaces.insert(chunk.arrFaces.end(), iCorners, iCorners + 9);
+			}
+		}
+		else if (IsKeyword(pToken, pTokenEnd, "usemtl") || IsKeyword(pToken, pTokenEnd, "mtllib"))
+		{
+			Statement statement;
+			statement.iFace = chunk.arrFaces.size() / 9;
+			statement.bMaterialLibrary = *pToken == 'm';
+			NextToken(p, pLineEnd, pToken, pTokenEnd);
+			statement.sName.assign(pToken, pTokenEnd);
+			chunk.arrStatements.push_back(statement);
+		}
+
+		if (bBadLine && chunk.iBadLine < 0)
+		{
+			chunk.iBadLine = chunk.iNumLines;
+		}
+		chunk.iNumLines++;
+		p = pLineEnd + 1;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ObjParser::Merge()
+{
+	//Prefix sums of what each chunk found
+	std::vector<size_t> arrPositionOffsets(m_arrChunks.size()), arrTexCoordOffsets(m_arrChunks.size()), arrNormalOffsets(m_arrChunks.size());
+	int iLine = 0;
+	for (size_t c = 0; c < m_arrChunks.size(); c++)
+	{
+		const Chunk& chunk = m_arrChunks[c];
+		if (chunk.iBadLine >= 0)
+		{
+			VS_LOG_VERBOSE("Obj face on line " << iLine + chunk.iBadLine + 1 << " isn't v/vt/vn");
+			return false;
+		}
+		iLine += chunk.iNumLines;
+
+		arrPositionOffsets[c] = m_Stats.iNumPositions;
+		arrTexCoordOffsets[c] = m_Stats.iNumTexCoords;
+		arrNormalOffsets[c] = m_Stats.iNumNormals;
+		m_Stats.iNumPositions += chunk.arrPositions.size();
+		m_Stats.iNumTexCoords += chunk.arrTexCoords.size();
+		m_Stats.iNumNormals += chunk.arrNormals.size();
+		m_Stats.iNumFaces += chunk.arrFaces.size() / 9;
+	}
+
+	//Statements in file order give the groups and where each chunk's faces go in them
+	for (size_t c = 0; c < m_arrChunks.size(); c++)
+	{
+		const Chunk& chunk = m_arrChunks[c];
+		size_t iNumFaces = chunk.arrFaces.size() / 9;
+		size_t iFace = 0;
+		for (size_t s = 0; s <= chunk.arrStatements.size(); s++)
+		{
+			size_t iRunEnd = s < chunk.arrStatements.size() ? chunk.arrStatements[s].iFace : iNumFaces;
+			if (iRunEnd > iFace)
+			{
+				if (m_arrGroups.empty())
+				{
+					VS_LOG_VERBOSE("Obj has faces before its first usemtl");
+					return false;
+				}
+				Span span;
+				span.iChunk = static_cast<int>(c);
+				span.iGroup = static_cast<int>(m_arrGroups.size()) - 1;
+				span.iFirstFace = iFace;
+				span.iNumFaces = iRunEnd - iFace;
+				span.iDestFace = m_arrGroups.back().iNumFaces;
+				m_arrGroups.back().iNumFaces += span.iNumFaces;
+				m_arrSpans.push_back(span);
+				iFace = iRunEnd;
+			}
+			if (s == chunk.arrStatements.size())
+			{
+				break;
+			}
+
+			const Statement& statement = chunk.arrStatements[s];
+			if (statement.bMaterialLibrary)
+			{
+				m_arrMaterialLibraries.push_back(statement.sName);
+			}
+			else
+			{
+				Group group;
+				group.sMaterial = statement.sName;
+				group.iNumFaces = 0;
+				group.iNumMaterialLibraries = static_cast<int>(m_arrMaterialLibraries.size());
+				m_arrGroups.push_back(group);
+			}
+		}
+	}
+
+	//Gather the vertices and check every face's indices in one pass over the chunks
+	m_arrPositions.resize(m_Stats.iNumPositions);
+	m_arrTexCoords.resize(m_Stats.iNumTexCoords);
+	m_arrNormals.resize(m_Stats.iNumNormals);
+	std::vector<int> arrBadIndices(m_arrChunks.size(), 0);
+	Parallel::For(static_cast<int>(m_arrChunks.size()), m_iNumThreads, [&](int c, int)
+	{
+		Chunk& chunk = m_arrChunks[c];
+		std::copy(chunk.arrPositions.begin(), chunk.arrPositions.end(), m_arrPositions.begin() + arrPositionOffsets[c]);
+		std::copy(chunk.arrTexCoords.begin(), chunk.arrTexCoords.end(), m_arrTexCoords.begin() + arrTexCoordOffsets[c]);
+		std::copy(chunk.arrNormals.begin(), chunk.arrNormals.end(), m_arrNormals.begin() + arrNormalOffsets[c]);
+		std::vector<XMFLOAT3>().swap(chunk.arrPositions);
+		std::vector<XMFLOAT2>().swap(chunk.arrTexCoords);
+		std::vector<XMFLOAT3>().swap(chunk.arrNormals);
+
+		for (size_t i = 0; i < chunk.arrFaces.size(); i += 3)
+		{
+			arrBadIndices[c] += static_cast<size_t>(chunk.arrFaces[i]) >= m_Stats.iNumPositions
+				|| static_cast<size_t>(chunk.arrFaces[i + 1]) >= m_Stats.iNumTexCoords
+				|| static_cast<size_t>(chunk.arrFaces[i + 2]) >= m_Stats.iNumNormals;
+		}
+	});
+	for (size_t c = 0; c < m_arrChunks.size(); c++)
+	{
+		if (arrBadIndices[c] > 0)
+		{
+			VS_LOG_VERBOSE("Obj has faces indexing past the end of its vertices");
+			return false;
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int ObjParser::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+	const char* filename = "../Results/ObjParser_Validate.obj";
+
+	for (int iTest = 0; iTest < 8; iTest++)
+	{
+		//Every float format atof takes, and then some short ones for the fast path
+		auto randomFloat = [&]() -> std::string
+		{
+			char buffer[64];
+			float fValue = std::uniform_real_distribution<float>(-200.f, 200.f)(rng);
+			switch (rng() % 8)
+			{
+			case 0: snprintf(buffer, sizeof(buffer), "%.17g", static_cast<double>(fValue)); break;
+			case 1: snprintf(buffer, sizeof(buffer), "%e", fValue); break;
+			case 2: snprintf(buffer, sizeof(buffer), "%d", static_cast<int>(fValue)); break;
+			case 3: snprintf(buffer, sizeof(buffer), "%.25f", fValue * 1e-6f); break;
+			case 4: snprintf(buffer, sizeof(buffer), "%s.%u", fValue < 0.f ? "-" : "+", static_cast<unsigned int>(rng() % 100000)); break;
+			default: snprintf(buffer, sizeof(buffer), "%.6f", fValue); break;
+			}
+			return buffer;
+		};
+
+		std::stringstream obj;
+		const char* sNewline = rng() % 2 ? "\r\n" : "\n";
+		int iNumPositions = 0, iNumTexCoords = 0, iNumNormals = 0;
+		obj << "# Generated" << sNewline << "mtllib test" << iTest << ".mtl" << sNewline;
+		int iNumLines = 500 + rng() % 20000;
+		for (int i = 0; i < iNumLines; i++)
+		{
+			int iType = rng() % 16;
+			if (i == 0 || iType == 0)
+			{
+				obj << "usemtl material_" << rng() % 20 << sNewline;
+			}
+			else if (iType == 1)
+			{
+				obj << (rng() % 2 ? "g group" : "s 1") << sNewline;
+			}
+			else if (iType == 2)
+			{
+				obj << "# v 1 2 3 f 1/1/1" << sNewline;
+			}
+			else if (iType == 3 && rng() % 20 == 0)
+			{
+				obj << "mtllib extra" << i << ".mtl" << sNewline;
+			}
+			else if (iType < 7 || iNumPositions == 0)
+			{
+				obj << "v " << randomFloat() << " " << randomFloat() << (rng() % 4 ? " " : "   ") << randomFloat() << sNewline;
+				iNumPositions++;
+			}
+			else if (iType < 9 || iNumTexCoords == 0)
+			{
+				obj << "vt " << randomFloat() << " " << randomFloat() << sNewline;
+				iNumTexCoords++;
+			}
+			else if (iType < 11 || iNumNormals == 0)
+			{
+				obj << "vn " << randomFloat() << " " << randomFloat() << " " << randomFloat() << sNewline;
+				iNumNormals++;
+			}
+			else
+			{
+				//Quads as well, which only ever gave their first triangle
+				obj << "f";
+				int iNumCorners = rng() % 8 ? 3 : 4;
+				for (int j = 0; j < iNumCorners; j++)
+				{
+					obj << " " << 1 + rng() % iNumPositions << "/" << 1 + rng() % iNumTexCoords << "/" << 1 + rng() % iNumNormals;
+				}
+				obj << sNewline;
+			}
+		}
+
+		std::string sText = obj.str();
+		std::ofstream outfile(filename, std::ios::binary);
+		outfile << sText;
+		outfile.close();
+
+		std::vector<ReferenceGroup> arrReferenceGroups;
+		std::vector<std::string> arrReferenceLibraries;
+		if (!LoadReference(filename, arrReferenceGroups, arrReferenceLibraries))
+		{
+			iFailures++;
+			continue;
+		}
+
+		//Mapped and from memory, with chunks small enough that there are lots of them
+		ObjParser parser;
+		iFailures += !parser.Parse(filename, 1 + rng() % 8);
+		iFailures += CompareWithReference(parser, arrReferenceGroups, arrReferenceLibraries);
+		for (int iNumThreads = 1; iNumThreads <= 4; iNumThreads *= 2)
+		{
+			iFailures += !parser.ParseText(sText.data(), sText.size(), iNumThreads);
+			iFailures += CompareWithReference(parser, arrReferenceGroups, arrReferenceLibraries);
+		}
+	}
+	remove(filename);
+
+	//Fast path against atof on its own, at the edges of it
+	const char* sFloats[] = { "0", "-0", "1.", ".5", "-.5", "+3.25", "9007199254740993", "0.1", "0.30000000000000004", "123456.789012",
+		"1e5", "1.5E-3", "100000000000000000000000", "0.0000000000000000000001", "-0.00000000000000000000001", "3.4028235e38", "nan" };
+	for (int i = 0; i < sizeof(sFloats) / sizeof(sFloats[0]); i++)
+	{
+		float fExpected = static_cast<float>(atof(sFloats[i]));
+		float fValue = ParseFloat(sFloats[i], sFloats[i] + strlen(sFloats[i]));
+		iFailures += memcmp(&fExpected, &fValue, sizeof(float)) != 0;
+	}
+
+	//Faces that aren't v/vt/vn, or before any usemtl, are errors rather than garbage
+	const char* sBadObjs[] = { "usemtl a\nv 1 2 3\nvt 0 0\nvn 0 1 0\nf 1//1 1//1 1//1\n", "v 1 2 3\nvt 0 0\nvn 0 1 0\nf 1/1/1 1/1/1 1/1/1\n",
+		"usemtl a\nv 1 2 3\nvt 0 0\nvn 0 1 0\nf 1/1/1 1/1/1 2/1/1\n", "usemtl a\nf 1/1/1 1/1/1\n" };
+	for (int i = 0; i < sizeof(sBadObjs) / sizeof(sBadObjs[0]); i++)
+	{
+		ObjParser parser;
+		iFailures += parser.ParseText(sBadObjs[i], strlen(sBadObjs[i]), 1);
+	}
+
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ObjParser::RunBenchmark(const char* sName, const char* filename)
+{
+	std::stringstream ss;
+	ss << "../Results/ObjParser_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open obj parser benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Loader, Threads, Chunks, Map(ms), Parse(ms), Merge(ms), Expand(ms), Total(ms), MB/s, Mismatches\n";
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<ReferenceGroup> arrReferenceGroups;
+	std::vector<std::string> arrReferenceLibraries;
+	if (!LoadReference(filename, arrReferenceGroups, arrReferenceLibraries))
+	{
+		VS_LOG_VERBOSE("Failed to load " << filename << " for the obj parser benchmark");
+		return false;
+	}
+	double dReferenceMs = GetElapsedMs(start);
+
+	int iFailures = 0;
+	ObjParser parser;
+	if (!parser.Parse(filename, 1))
+	{
+		return false;
+	}
+	double dFileMB = parser.GetStats().iFileSize / (1024.0 * 1024.0);
+	outfile << "ifstream,1,1,0,0,0,0," << dReferenceMs << "," << dFileMB / (dReferenceMs / 1000.0) << ",0\n";
+
+	int iMaxThreads = Parallel::GetNumWorkerThreads();
+	for (int iNumThreads = 1; ; iNumThreads = std::min(iNumThreads * 2, iMaxThreads))
+	{
+		//Best of a few, the first load of the file pays for the page cache
+		Stats best;
+		double dBestMs = 0.0;
+		int iMismatches = 0;
+		for (int iRun = 0; iRun < 3; iRun++)
+		{
+			if (!parser.Parse(filename, iNumThreads))
+			{
+				return false;
+			}
+			iMismatches = CompareWithReference(parser, arrReferenceGroups, arrReferenceLibraries);
+			const Stats& stats = parser.GetStats();
+			double dTotalMs = stats.dMapMs + stats.dParseMs + stats.dMergeMs + stats.dExpandMs;
+			if (iRun == 0 || dTotalMs < dBestMs)
+			{
+				best = stats;
+				dBestMs = dTotalMs;
+			}
+		}
+		iFailures += iMismatches;
+		outfile << "mapped," << iNumThreads << "," << best.iNumChunks << "," << best.dMapMs << "," << best.dParseMs << "," << best.dMergeMs << ","
+			<< best.dExpandMs << "," << dBestMs << "," << best.fMBPerSecond << "," << iMismatches << "\n";
+		VS_LOG(sName << " obj parser " << iNumThreads << " threads: " << best.fMBPerSecond << "MB/s against " << dFileMB / (dReferenceMs / 1000.0) << "MB/s");
+
+		if (iNumThreads == iMaxThreads)
+		{
+			break;
+		}
+	}
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iFailures == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
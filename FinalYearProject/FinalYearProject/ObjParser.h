@@ -0,0 +1,159 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include "Parallel.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Loads the triangle lists out of an obj the same way Mesh always has: z flipped on positions and normals, v flipped on
+//texture coordinates, each face's corners reversed, a group of faces for every usemtl. The file is memory mapped and
+//cut into chunks on line boundaries that are parsed on every core into their own vertex, face and statement lists,
+//then the chunks' counts are prefix summed so the vertices can be gathered and the faces expanded straight into each
+//group's triangle list in parallel.
+//Floats come out bit for bit what atof would give; the common short decimals are done here and anything longer or
+//with an exponent goes to strtod. Faces have to be v/vt/vn, as the old loader needed, and only their first three
+//corners are used.
+class ObjParser
+{
+public:
+
+	struct Stats
+	{
+		int iNumThreads;
+		int iNumChunks;
+		size_t iFileSize;
+		size_t iNumPositions;
+		size_t iNumTexCoords;
+		size_t iNumNormals;
+		size_t iNumFaces;
+		double dMapMs;
+		double dParseMs;
+		double dMergeMs;		//prefix sums, gathering the vertices and checking the indices
+		double dExpandMs;
+		float fMBPerSecond;		//over the whole load
+	};
+
+	//A usemtl and the faces up to the next one
+	struct Group
+	{
+		std::string sMaterial;
+		size_t iNumFaces;
+		int iNumMaterialLibraries;	//mtllibs before the usemtl, to be loaded before looking the material up
+	};
+
+	ObjParser();
+	~ObjParser();
+
+	//Maps and parses the file, leaving the groups ready to be expanded. iNumThreads <= 0 uses every core.
+	bool Parse(const char* filename, int iNumThreads = 0);
+	//Same, from text already in memory
+	bool ParseText(const char* pText, size_t iSize, int iNumThreads = 0);
+
+	const std::vector<Group>& GetGroups() const { return m_arrGroups; }
+	const std::vector<std::string>& GetMaterialLibraries() const { return m_arrMaterialLibraries; }
+
+	//Resizes each of ppGroupCorners[g] to 3 corners a face and fills in pos, tex and norm, like ModelType
+	template<typename Corner>
+	void ExpandGroups(std::vector<Corner>* const* ppGroupCorners);
+
+	const Stats& GetStats() const { return m_Stats; }
+
+	//Random obj text with comments, groups, CRLFs and every float format through both this and the ifstream loader
+	//this replaced, checking the groups come out bit for bit the same. Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Loads the obj with the old loader and with 1 to all threads, writing MB/s to ../Results/ObjParser_<sName>.csv
+	static bool RunBenchmark(const char* sName, const char* filename);
+
+private:
+
+	struct Statement
+	{
+		size_t iFace;				//faces in the chunk before it
+		bool bMaterialLibrary;		//mtllib, otherwise usemtl
+		std::string sName;
+	};
+
+	struct Chunk
+	{
+		const char* pBegin;
+		const char* pEnd;
+		std::vector<XMFLOAT3> arrPositions;
+		std::vector<XMFLOAT2> arrTexCoords;
+		std::vector<XMFLOAT3> arrNormals;
+		std::vector<int> arrFaces;			//0 based position, tex coord and normal a corner, corners in output order
+		std::vector<Statement> arrStatements;
+		int iBadLine;						//first line that couldn't be parsed, counted from the start of the chunk, -1 for none
+		int iNumLines;
+	};
+
+	//A run of a chunk's faces that all land in one group
+	struct Span
+	{
+		int iChunk;
+		int iGroup;
+		size_t iFirstFace;
+		size_t iNumFaces;
+		size_t iDestFace;
+	};
+
+	static void ParseChunk(Chunk& chunk);
+	bool Merge();
+	void Clear();
+
+	std::vector<Chunk> m_arrChunks;
+	std::vector<Span> m_arrSpans;
+	std::vector<Group> m_arrGroups;
+	std::vector<std::string> m_arrMaterialLibraries;
+
+	std::vector<XMFLOAT3> m_arrPositions;
+	std::vector<XMFLOAT2> m_arrTexCoords;
+	std::vector<XMFLOAT3> m_arrNormals;
+
+	int m_iNumThreads;
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename Corner>
+void ObjParser::ExpandGroups(std::vector<Corner>* const* ppGroupCorners)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (size_t g = 0; g < m_arrGroups.size(); g++)
+	{
+		ppGroupCorners[g]->resize(m_arrGroups[g].iNumFaces * 3);
+	}
+
+	Parallel::For(static_cast<int>(m_arrSpans.size()), m_iNumThreads, [&](int iSpan, int)
+	{
+		const Span& span = m_arrSpans[iSpan];
+		const int* pFace = &m_arrChunks[span.iChunk].arrFaces[span.iFirstFace * 9];
+		Corner* pCorner = &(*ppGroupCorners[span.iGroup])[span.iDestFace * 3];
+		for (size_t i = 0; i < span.iNumFaces * 3; i++, pFace += 3, pCorner++)
+		{
+			pCorner->pos = m_arrPositions[pFace[0]];
+			pCorner->tex = m_arrTexCoords[pFace[1]];
+			pCorner->norm = m_arrNormals[pFace[2]];
+		}
+	});
+
+	m_Stats.dExpandMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	double dTotalMs = m_Stats.dMapMs + m_Stats.dParseMs + m_Stats.dMergeMs + m_Stats.dExpandMs;
+	m_Stats.fMBPerSecond = dTotalMs > 0.0 ? static_cast<float>(m_Stats.iFileSize / (1024.0 * 1024.0) / (dTotalMs / 1000.0)) : 0.f;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !OBJ_PARSER_H
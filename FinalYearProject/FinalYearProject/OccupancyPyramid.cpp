@@ -0,0 +1,1081 @@
+#include "NoFloatContraction.h"
+#include "OccupancyPyramid.h"
+#include "CPUVoxeliser.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define OCCUPANCY_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define OCCUPANCY_X86_SIMD 0
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint8_t OccupancyPyramid::kCellOccupied;
+const uint8_t OccupancyPyramid::kCellFull;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Same cone parameters as the lighting shader
+	const float kConeStartOffset = 1.f;		//voxels out from the origin, so a cone doesn't see the surface it starts on
+	const float kConeStepScale = 0.5f;		//of the diameter
+	const float kConeOpacityCutoff = 0.95f;
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	inline uint8_t CellFromBlock(uint64_t iBlock)
+	{
+		return static_cast<uint8_t>((iBlock != 0 ? OccupancyPyramid::kCellOccupied : 0) | (iBlock == ~0ULL ? OccupancyPyramid::kCellFull : 0));
+	}
+
+	//Occupied if any of the 8 children are, full if all of them are
+	inline uint8_t ReduceCells(uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e, uint8_t f, uint8_t g, uint8_t h)
+	{
+		uint8_t iAny = a | b | c | d | e | f | g | h;
+		uint8_t iAll = a & b & c & d & e & f & g & h;
+		return (iAny & OccupancyPyramid::kCellOccupied) | (iAll & OccupancyPyramid::kCellFull);
+	}
+
+	//Row of iCount 4x4x4 blocks starting at voxel (x, y, z), pRow pointing at the first texel
+	void BuildBlockRowScalar(const uint32_t* pRow, int iResolution, int iCount, uint64_t* pBlocks, uint8_t* pCells)
+	{
+		for (int b = 0; b < iCount; b++)
+		{
+			uint64_t iBlock = 0;
+			for (int dz = 0; dz < 4; dz++)
+			{
+				for (int dy = 0; dy < 4; dy++)
+				{
+					const uint32_t* pTexels = pRow + (static_cast<size_t>(dz) * iResolution + dy) * iResolution + b * 4;
+					for (int dx = 0; dx < 4; dx++)
+					{
+						iBlock |= static_cast<uint64_t>(pTexels[dx] != 0) << ((dz << 4) | (dy << 2) | dx);
+					}
+				}
+			}
+			pBlocks[b] = iBlock;
+			pCells[b] = CellFromBlock(iBlock);
+		}
+	}
+
+	//One destination row of the next level up, from the 4 source rows above it
+	void ReduceRowScalar(const uint8_t* pRow00, const uint8_t* pRow01, const uint8_t* pRow10, const uint8_t* pRow11, int iStart, int iDstCount, uint8_t* pDst)
+	{
+		for (int x = iStart; x < iDstCount; x++)
+		{
+			int sx = x * 2;
+			pDst[x] = ReduceCells(pRow00[sx], pRow00[sx + 1], pRow01[sx], pRow01[sx + 1], pRow10[sx], pRow10[sx + 1], pRow11[sx], pRow11[sx + 1]);
+		}
+	}
+
+#if OCCUPANCY_X86_SIMD
+	void BuildBlockRowSSE(const uint32_t* pRow, int iResolution, int iCount, uint64_t* pBlocks, uint8_t* pCells)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		for (int b = 0; b < iCount; b++)
+		{
+			uint64_t iBlock = 0;
+			for (int dz = 0; dz < 4; dz++)
+			{
+				for (int dy = 0; dy < 4; dy++)
+				{
+					const uint32_t* pTexels = pRow + (static_cast<size_t>(dz) * iResolution + dy) * iResolution + b * 4;
+					__m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pTexels));
+					int iEmpty = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(texels, zero)));
+					iBlock |= static_cast<uint64_t>(~iEmpty & 0xf) << ((dz << 4) | (dy << 2));
+				}
+			}
+			pBlocks[b] = iBlock;
+			pCells[b] = CellFromBlock(iBlock);
+		}
+	}
+
+	//Reduces 32 bytes of each source row to 16 destination bytes. Each 16 bit lane holds a pair of neighbours in x,
+	//so shifting it down 8 bits lines the right hand one up with the left.
+	inline __m128i ReducePairsSSE(__m128i any, __m128i all)
+	{
+		__m128i pairAny = _mm_or_si128(any, _mm_srli_epi16(any, 8));
+		__m128i pairAll = _mm_and_si128(all, _mm_srli_epi16(all, 8));
+		return _mm_or_si128(_mm_and_si128(pairAny, _mm_set1_epi16(OccupancyPyramid::kCellOccupied)), _mm_and_si128(pairAll, _mm_set1_epi16(OccupancyPyramid::kCellFull)));
+	}
+
+	void ReduceRowSSE(const uint8_t* pRow00, const uint8_t* pRow01, const uint8_t* pRow10, const uint8_t* pRow11, int iDstCount, uint8_t* pDst)
+	{
+		int x = 0;
+		for (; x + 16 <= iDstCount; x += 16)
+		{
+			__m128i halves[2];
+			for (int h = 0; h < 2; h++)
+			{
+				int sx = x * 2 + h * 16;
+				__m128i r00 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow00 + sx));
+				__m128i r01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow01 + sx));
+				__m128i r10 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow10 + sx));
+				__m128i r11 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow11 + sx));
+				__m128i any = _mm_or_si128(_mm_or_si128(r00, r01), _mm_or_si128(r10, r11));
+				__m128i all = _mm_and_si128(_mm_and_si128(r00, r01), _mm_and_si128(r10, r11));
+				halves[h] = ReducePairsSSE(any, all);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + x), _mm_packus_epi16(halves[0], halves[1]));
+		}
+		ReduceRowScalar(pRow00, pRow01, pRow10, pRow11, x, iDstCount, pDst);
+	}
+
+	//Two blocks side by side at a time, 8 texels of a row covering both
+	TARGET_AVX2 void BuildBlockRowAVX2(const uint32_t* pRow, int iResolution, int iCount, uint64_t* pBlocks, uint8_t* pCells)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		int b = 0;
+		for (; b + 2 <= iCount; b += 2)
+		{
+			uint64_t iBlock0 = 0, iBlock1 = 0;
+			for (int dz = 0; dz < 4; dz++)
+			{
+				for (int dy = 0; dy < 4; dy++)
+				{
+					const uint32_t* pTexels = pRow + (static_cast<size_t>(dz) * iResolution + dy) * iResolution + b * 4;
+					__m256i texels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pTexels));
+					int iOccupied = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(texels, zero)));
+					int iShift = (dz << 4) | (dy << 2);
+					iBlock0 |= static_cast<uint64_t>(iOccupied & 0xf) << iShift;
+					iBlock1 |= static_cast<uint64_t>((iOccupied >> 4) & 0xf) << iShift;
+				}
+			}
+			pBlocks[b] = iBlock0;
+			pBlocks[b + 1] = iBlock1;
+			pCells[b] = CellFromBlock(iBlock0);
+			pCells[b + 1] = CellFromBlock(iBlock1);
+		}
+		if (b < iCount)
+		{
+			BuildBlockRowSSE(pRow + b * 4, iResolution, iCount - b, pBlocks + b, pCells + b);
+		}
+	}
+
+	TARGET_AVX2 void ReduceRowAVX2(const uint8_t* pRow00, const uint8_t* pRow01, const uint8_t* pRow10, const uint8_t* pRow11, int iDstCount, uint8_t* pDst)
+	{
+		const __m256i occupiedMask = _mm256_set1_epi16(OccupancyPyramid::kCellOccupied);
+		const __m256i fullMask = _mm256_set1_epi16(OccupancyPyramid::kCellFull);
+		int x = 0;
+		for (; x + 32 <= iDstCount; x += 32)
+		{
+			__m256i halves[2];
+			for (int h = 0; h < 2; h++)
+			{
+				int sx = x * 2 + h * 32;
+				__m256i r00 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRow00 + sx));
+				__m256i r01 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRow01 + sx));
+				__m256i r10 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRow10 + sx));
+				__m256i r11 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pRow11 + sx));
+				__m256i any = _mm256_or_si256(_mm256_or_si256(r00, r01), _mm256_or_si256(r10, r11));
+				__m256i all = _mm256_and_si256(_mm256_and_si256(r00, r01), _mm256_and_si256(r10, r11));
+				__m256i pairAny = _mm256_or_si256(any, _mm256_srli_epi16(any, 8));
+				__m256i pairAll = _mm256_and_si256(all, _mm256_srli_epi16(all, 8));
+				halves[h] = _mm256_or_si256(_mm256_and_si256(pairAny, occupiedMask), _mm256_and_si256(pairAll, fullMask));
+			}
+			//packus works within each 128 bit lane, so the quarters come out 0 2 1 3
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(halves[0], halves[1]), 0xd8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + x), packed);
+		}
+		if (x < iDstCount)
+		{
+			int sx = x * 2;
+			ReduceRowSSE(pRow00 + sx, pRow01 + sx, pRow10 + sx, pRow11 + sx, iDstCount - x, pDst + x);
+		}
+	}
+#endif
+
+	//Mip 0 voxels a SampleLevel at vUVW reads, worked out with the same float operations SampleLevel and
+	//SampleTrilinear use. Each mip it samples reads 2 texels along each axis.
+	inline void GetSampleFootprint(const XMFLOAT3& vUVW, float fMipLevel, int iResolution, int iMipLevels, int vMin[3], int vMax[3])
+	{
+		fMipLevel = std::max(0.f, std::min(fMipLevel, static_cast<float>(iMipLevels - 1)));
+		int iLowerMip = static_cast<int>(fMipLevel);
+		int iUpperMip = std::min(iLowerMip + 1, iMipLevels - 1);
+		bool bBlends = fMipLevel - iLowerMip > 0.f && iUpperMip != iLowerMip;
+
+		const float fUVW[3] = { vUVW.x, vUVW.y, vUVW.z };
+		for (int i = 0; i < 3; i++)
+		{
+			vMin[i] = iResolution;
+			vMax[i] = -1;
+		}
+		for (int iMip = iLowerMip; iMip <= (bBlends ? iUpperMip : iLowerMip); iMip++)
+		{
+			int iMipRes = iResolution >> iMip;
+			int iTexelSize = 1 << iMip;
+			for (int i = 0; i < 3; i++)
+			{
+				int iTexel = static_cast<int>(floorf(fUVW[i] * iMipRes - 0.5f));
+				vMin[i] = std::min(vMin[i], iTexel * iTexelSize);
+				vMax[i] = std::max(vMax[i], (iTexel + 2) * iTexelSize - 1);
+			}
+		}
+		//Texels outside the volume read as empty
+		for (int i = 0; i < 3; i++)
+		{
+			vMin[i] = std::max(vMin[i], 0);
+			vMax[i] = std::min(vMax[i], iResolution - 1);
+		}
+	}
+
+	inline bool IsInsideVolume(const XMFLOAT3& vPos, float fResolution)
+	{
+		return vPos.x >= 0.f && vPos.y >= 0.f && vPos.z >= 0.f && vPos.x < fResolution && vPos.y < fResolution && vPos.z < fResolution;
+	}
+
+	inline bool IsBoxInsideCell(const int vMin[3], const int vMax[3], const int vCellMin[3], const int vCellMax[3])
+	{
+		return vMin[0] >= vCellMin[0] && vMin[1] >= vCellMin[1] && vMin[2] >= vCellMin[2]
+			&& vMax[0] < vCellMax[0] && vMax[1] < vCellMax[1] && vMax[2] < vCellMax[2];
+	}
+
+	//Walks the ray from cell to cell. fnCellShift(voxel) returns -1 if the voxel is occupied, otherwise log2 of the
+	//size of the empty cell it's in. Each step jumps to where the ray leaves the cell, working out the next voxel from
+	//the face it leaves through so it doesn't depend on rounding the position.
+	template<typename CellShiftFunc>
+	bool WalkRay(int iResolution, const XMFLOAT3& vOrigin, const XMFLOAT3& vDirection, float fMaxDistance, float& fHitDistance,
+		OccupancyPyramid::MarchStats* pStats, const CellShiftFunc& fnCellShift)
+	{
+		const float fOrigin[3] = { vOrigin.x, vOrigin.y, vOrigin.z };
+		const float fDir[3] = { vDirection.x, vDirection.y, vDirection.z };
+		float fInvDir[3];
+		float tEnter = 0.f, tExit = fMaxDistance;
+		for (int i = 0; i < 3; i++)
+		{
+			if (fDir[i] == 0.f)
+			{
+				fInvDir[i] = 0.f;
+				if (fOrigin[i] < 0.f || fOrigin[i] >= iResolution)
+				{
+					return false;
+				}
+				continue;
+			}
+			fInvDir[i] = 1.f / fDir[i];
+			float t0 = (0.f - fOrigin[i]) * fInvDir[i];
+			float t1 = (iResolution - fOrigin[i]) * fInvDir[i];
+			tEnter = std::max(tEnter, std::min(t0, t1));
+			tExit = std::min(tExit, std::max(t0, t1));
+		}
+		if (tEnter > tExit)
+		{
+			return false;
+		}
+
+		int vVoxel[3];
+		for (int i = 0; i < 3; i++)
+		{
+			vVoxel[i] = std::max(0, std::min(iResolution - 1, static_cast<int>(floorf(fOrigin[i] + fDir[i] * tEnter))));
+		}
+
+		float t = tEnter;
+		while (true)
+		{
+			if (pStats)
+			{
+				pStats->iNumSteps++;
+			}
+			int iShift = fnCellShift(vVoxel);
+			if (iShift < 0)
+			{
+				fHitDistance = t;
+				return true;
+			}
+			if (pStats && iShift > 0)
+			{
+				pStats->iNumSkips++;
+			}
+
+			int vCellMin[3], vCellMax[3];
+			float tAxis[3];
+			float tCellExit = FLT_MAX;
+			for (int i = 0; i < 3; i++)
+			{
+				vCellMin[i] = (vVoxel[i] >> iShift) << iShift;
+				vCellMax[i] = vCellMin[i] + (1 << iShift);
+				tAxis[i] = fDir[i] == 0.f ? FLT_MAX : ((fDir[i] > 0.f ? vCellMax[i] : vCellMin[i]) - fOrigin[i]) * fInvDir[i];
+				tCellExit = std::min(tCellExit, tAxis[i]);
+			}
+			if (tCellExit > fMaxDistance)
+			{
+				return false;
+			}
+
+			t = std::max(t, tCellExit);
+			for (int i = 0; i < 3; i++)
+			{
+				if (tAxis[i] == tCellExit)
+				{
+					vVoxel[i] = fDir[i] > 0.f ? vCellMax[i] : vCellMin[i] - 1;
+				}
+				else
+				{
+					vVoxel[i] = std::max(vCellMin[i], std::min(vCellMax[i] - 1, static_cast<int>(floorf(fOrigin[i] + fDir[i] * t))));
+				}
+				if (vVoxel[i] < 0 || vVoxel[i] >= iResolution)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	//Random blobs, boxes and scattered voxels, with solid regions big enough to give full cells
+	void FillRandomVolume(CPUVoxelVolume& volume, std::mt19937& rng, float fDensity)
+	{
+		volume.Clear();
+		int iRes = volume.GetResolution();
+		std::uniform_int_distribution<int> coord(0, iRes - 1);
+		std::uniform_int_distribution<uint32_t> colour(1, 0xffffffff);
+		int iNumShapes = 1 + static_cast<int>(fDensity * 8);
+		for (int s = 0; s < iNumShapes; s++)
+		{
+			int iMin[3], iMax[3];
+			for (int i = 0; i < 3; i++)
+			{
+				iMin[i] = coord(rng);
+				iMax[i] = std::min(iRes, iMin[i] + 1 + coord(rng) / 4);
+			}
+			uint32_t iColour = colour(rng);
+			for (int z = iMin[2]; z < iMax[2]; z++)
+			{
+				for (int y = iMin[1]; y < iMax[1]; y++)
+				{
+					for (int x = iMin[0]; x < iMax[0]; x++)
+					{
+						volume.SetVoxel(x, y, z, iColour);
+					}
+				}
+			}
+		}
+		int iNumScattered = static_cast<int>(fDensity * iRes * iRes * iRes * 0.01f);
+		for (int i = 0; i < iNumScattered; i++)
+		{
+			volume.SetVoxel(coord(rng), coord(rng), coord(rng), colour(rng));
+		}
+	}
+
+	XMFLOAT3 RandomDirection(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		while (true)
+		{
+			XMFLOAT3 v(unit(rng), unit(rng), unit(rng));
+			float fLengthSq = v.x * v.x + v.y * v.y + v.z * v.z;
+			if (fLengthSq > 0.0001f && fLengthSq <= 1.f)
+			{
+				float fRecip = 1.f / sqrtf(fLengthSq);
+				return XMFLOAT3(v.x * fRecip, v.y * fRecip, v.z * fRecip);
+			}
+		}
+	}
+
+	//Where cones start in the lighting pass - empty voxels next to a surface, heading away from it
+	void GenerateSurfaceQueries(const CPUVoxelVolume& volume, int iNumQueries, std::mt19937& rng, std::vector<XMFLOAT3>& arrOrigins, std::vector<XMFLOAT3>& arrDirections)
+	{
+		const int iNeighbours[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		int iRes = volume.GetResolution();
+		std::uniform_int_distribution<int> coord(1, iRes - 2);
+		std::uniform_real_distribution<float> jitter(0.f, 1.f);
+		arrOrigins.clear();
+		arrDirections.clear();
+		for (int iAttempt = 0; arrOrigins.size() < iNumQueries && iAttempt < iNumQueries * 10000; iAttempt++)
+		{
+			int x = coord(rng), y = coord(rng), z = coord(rng);
+			if (volume.GetVoxel(x, y, z) != 0)
+			{
+				continue;
+			}
+			for (int n = 0; n < 6; n++)
+			{
+				if (volume.GetVoxel(x + iNeighbours[n][0], y + iNeighbours[n][1], z + iNeighbours[n][2]) != 0)
+				{
+					XMFLOAT3 vDir = RandomDirection(rng);
+					if (vDir.x * iNeighbours[n][0] + vDir.y * iNeighbours[n][1] + vDir.z * iNeighbours[n][2] > 0.f)
+					{
+						vDir = XMFLOAT3(-vDir.x, -vDir.y, -vDir.z);
+					}
+					arrOrigins.push_back(XMFLOAT3(x + jitter(rng), y + jitter(rng), z + jitter(rng)));
+					arrDirections.push_back(vDir);
+					break;
+				}
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+OccupancyPyramid::OccupancyPyramid()
+	: m_iResolution(0)
+	, m_iBlocksPerAxis(0)
+	, m_iNumLevels(0)
+	, m_iNumThreads(0)
+	, m_eSIMDLevel(simdScalar)
+{
+	SetSIMDLevel(simdMax);
+	memset(&m_BuildStats, 0, sizeof(m_BuildStats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+OccupancyPyramid::~OccupancyPyramid()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool OccupancyPyramid::Initialise(int iResolution, int iNumThreads)
+{
+	if (iResolution < kBlockSize || (iResolution & (iResolution - 1)) != 0)
+	{
+		VS_LOG_VERBOSE("Occupancy pyramid needs a power of 2 resolution of at least " << kBlockSize);
+		return false;
+	}
+
+	Shutdown();
+	m_iResolution = iResolution;
+	m_iBlocksPerAxis = iResolution / kBlockSize;
+	m_iNumThreads = iNumThreads;
+
+	//Level 1 is the blocks, then halve until there's one cell
+	m_iNumLevels = 2;
+	while (GetLevelResolution(m_iNumLevels - 1) > 1)
+	{
+		m_iNumLevels++;
+	}
+
+	m_arrBlocks.assign(static_cast<size_t>(m_iBlocksPerAxis) * m_iBlocksPerAxis * m_iBlocksPerAxis, 0);
+	m_arrLevels.resize(m_iNumLevels - 1);
+	for (int i = 1; i < m_iNumLevels; i++)
+	{
+		size_t iRes = GetLevelResolution(i);
+		m_arrLevels[i - 1].assign(iRes * iRes * iRes, 0);
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OccupancyPyramid::Shutdown()
+{
+	m_arrBlocks.clear();
+	m_arrLevels.clear();
+	m_iResolution = 0;
+	m_iBlocksPerAxis = 0;
+	m_iNumLevels = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OccupancyPyramid::SetSIMDLevel(SIMDLevel eLevel)
+{
+#if OCCUPANCY_X86_SIMD
+	m_eSIMDLevel = std::min(eLevel, TriangleBoxOverlap::GetSupportedLevel());
+#else
+	m_eSIMDLevel = simdScalar;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool OccupancyPyramid::Build(const CPUVoxelVolume& volume)
+{
+	if (volume.GetResolution() != m_iResolution)
+	{
+		VS_LOG_VERBOSE("Occupancy pyramid and volume resolutions don't match");
+		return false;
+	}
+	return Build(volume.GetMipData(0));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool OccupancyPyramid::Build(const uint32_t* pMip0)
+{
+	if (m_iResolution == 0 || !pMip0)
+	{
+		return false;
+	}
+
+	m_BuildStats.eSIMDLevel = m_eSIMDLevel;
+	m_BuildStats.iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+
+	//Blocks and level 1 together, a row of blocks to a job
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	int iBlocks = m_iBlocksPerAxis;
+	Parallel::For(iBlocks * iBlocks, m_iNumThreads, [&](int iJob, int)
+	{
+		int by = iJob % iBlocks, bz = iJob / iBlocks;
+		const uint32_t* pRow = pMip0 + (static_cast<size_t>(bz * kBlockSize) * m_iResolution + by * kBlockSize) * m_iResolution;
+		size_t iFirst = GetBlockIndex(0, by, bz);
+		uint64_t* pBlocks = &m_arrBlocks[iFirst];
+		uint8_t* pCells = &m_arrLevels[0][iFirst];
+#if OCCUPANCY_X86_SIMD
+		if (m_eSIMDLevel == simdAVX2)
+		{
+			BuildBlockRowAVX2(pRow, m_iResolution, iBlocks, pBlocks, pCells);
+			return;
+		}
+		if (m_eSIMDLevel == simdSSE)
+		{
+			BuildBlockRowSSE(pRow, m_iResolution, iBlocks, pBlocks, pCells);
+			return;
+		}
+#endif
+		BuildBlockRowScalar(pRow, m_iResolution, iBlocks, pBlocks, pCells);
+	});
+	m_BuildStats.dBlockTimeMs = GetElapsedMs(start);
+
+	//Each level up from the one below, a destination row to a job
+	start = std::chrono::high_resolution_clock::now();
+	for (int iLevel = 2; iLevel < m_iNumLevels; iLevel++)
+	{
+		int iSrcRes = GetLevelResolution(iLevel - 1);
+		int iDstRes = GetLevelResolution(iLevel);
+		const uint8_t* pSrc = m_arrLevels[iLevel - 2].data();
+		uint8_t* pDst = m_arrLevels[iLevel - 1].data();
+		Parallel::For(iDstRes * iDstRes, iDstRes >= 32 ? m_iNumThreads : 1, [&](int iJob, int)
+		{
+			int y = iJob % iDstRes, z = iJob / iDstRes;
+			const uint8_t* pRow00 = pSrc + (static_cast<size_t>(z * 2) * iSrcRes + y * 2) * iSrcRes;
+			const uint8_t* pRow01 = pRow00 + iSrcRes;
+			const uint8_t* pRow10 = pRow00 + static_cast<size_t>(iSrcRes) * iSrcRes;
+			const uint8_t* pRow11 = pRow10 + iSrcRes;
+			uint8_t* pDstRow = pDst + (static_cast<size_t>(z) * iDstRes + y) * iDstRes;
+#if OCCUPANCY_X86_SIMD
+			if (m_eSIMDLevel == simdAVX2)
+			{
+				ReduceRowAVX2(pRow00, pRow01, pRow10, pRow11, iDstRes, pDstRow);
+				return;
+			}
+			if (m_eSIMDLevel == simdSSE)
+			{
+				ReduceRowSSE(pRow00, pRow01, pRow10, pRow11, iDstRes, pDstRow);
+				return;
+			}
+#endif
+			ReduceRowScalar(pRow00, pRow01, pRow10, pRow11, 0, iDstRes, pDstRow);
+		});
+	}
+	m_BuildStats.dPyramidTimeMs = GetElapsedMs(start);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t OccupancyPyramid::GetMemoryUsageInBytes() const
+{
+	size_t iBytes = m_arrBlocks.size() * sizeof(uint64_t);
+	for (int i = 0; i < m_arrLevels.size(); i++)
+	{
+		iBytes += m_arrLevels[i].size();
+	}
+	return iBytes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool OccupancyPyramid::IsCellOccupiedAt(int iLevel, const int vVoxel[3]) const
+{
+	int iShift = GetCellShift(iLevel);
+	return IsCellOccupied(iLevel, vVoxel[0] >> iShift, vVoxel[1] >> iShift, vVoxel[2] >> iShift);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int OccupancyPyramid::FindEmptyCell(const int vMin[3], const int vMax[3], int vCellMin[3], int vCellMax[3]) const
+{
+	int iExtent = 1;
+	for (int i = 0; i < 3; i++)
+	{
+		iExtent = std::max(iExtent, vMax[i] - vMin[i] + 1);
+	}
+
+	//The first level with cells at least as big as the box, where it covers 2x2x2 cells at most
+	int iLevel = 1;
+	while (iLevel + 1 < m_iNumLevels && GetCellSize(iLevel) < iExtent)
+	{
+		iLevel++;
+	}
+	int iShift = GetCellShift(iLevel);
+	for (int cz = vMin[2] >> iShift; cz <= vMax[2] >> iShift; cz++)
+	{
+		for (int cy = vMin[1] >> iShift; cy <= vMax[1] >> iShift; cy++)
+		{
+			for (int cx = vMin[0] >> iShift; cx <= vMax[0] >> iShift; cx++)
+			{
+				if (IsCellOccupied(iLevel, cx, cy, cz))
+				{
+					return -1;
+				}
+			}
+		}
+	}
+
+	//Then climb to the biggest empty cell the whole box fits in. Occupied cells only have occupied parents, so
+	//stop at the first one.
+	int iFound = 0;
+	for (; iLevel < m_iNumLevels; iLevel++)
+	{
+		iShift = GetCellShift(iLevel);
+		if ((vMin[0] >> iShift) != (vMax[0] >> iShift) || (vMin[1] >> iShift) != (vMax[1] >> iShift) || (vMin[2] >> iShift) != (vMax[2] >> iShift))
+		{
+			continue;
+		}
+		if (IsCellOccupied(iLevel, vMin[0] >> iShift, vMin[1] >> iShift, vMin[2] >> iShift))
+		{
+			break;
+		}
+		iFound = iLevel;
+		for (int i = 0; i < 3; i++)
+		{
+			vCellMin[i] = (vMin[i] >> iShift) << iShift;
+			vCellMax[i] = vCellMin[i] + (1 << iShift);
+		}
+	}
+	return iFound;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool OccupancyPyramid::MarchRay(const XMFLOAT3& vOrigin, const XMFLOAT3& vDirection, float fMaxDistance, float& fHitDistance, MarchStats* pStats) const
+{
+	return WalkRay(m_iResolution, vOrigin, vDirection, fMaxDistance, fHitDistance, pStats, [&](const int vVoxel[3]) -> int
+	{
+		if (pStats)
+		{
+			pStats->iNumSamples++;
+		}
+		if (IsVoxelOccupied(vVoxel[0], vVoxel[1], vVoxel[2]))
+		{
+			return -1;
+		}
+		//Climb while the parent is empty too
+		int iLevel = 0;
+		while (iLevel + 1 < m_iNumLevels && !IsCellOccupiedAt(iLevel + 1, vVoxel))
+		{
+			iLevel++;
+		}
+		if (pStats)
+		{
+			pStats->iNumSamples += std::min(iLevel + 1, m_iNumLevels - 1);
+		}
+		return GetCellShift(iLevel);
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool OccupancyPyramid::MarchRayDense(const CPUVoxelVolume& volume, const XMFLOAT3& vOrigin, const XMFLOAT3& vDirection, float fMaxDistance, float& fHitDistance, MarchStats* pStats)
+{
+	return WalkRay(volume.GetResolution(), vOrigin, vDirection, fMaxDistance, fHitDistance, pStats, [&](const int vVoxel[3]) -> int
+	{
+		if (pStats)
+		{
+			pStats->iNumSamples++;
+		}
+		return volume.GetVoxel(vVoxel[0], vVoxel[1], vVoxel[2]) != 0 ? -1 : 0;
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMFLOAT4 OccupancyPyramid::MarchCone(const CPUVoxelVolume& volume, const OccupancyPyramid* pOccupancy, const XMFLOAT3& vOrigin, const XMFLOAT3& vDirection,
+	float fTanHalfAngle, float fMaxDistance, MarchStats* pStats)
+{
+	int iResolution = volume.GetResolution();
+	float fResolution = static_cast<float>(iResolution);
+	float fRecipResolution = 1.f / fResolution;
+	int iMipLevels = volume.GetMipLevels();
+	XMFLOAT4 vAccumulated(0.f, 0.f, 0.f, 0.f);
+	int vFootprintMin[3], vFootprintMax[3], vCellMin[3], vCellMax[3];
+
+	float t = kConeStartOffset;
+	while (t < fMaxDistance && vAccumulated.w < kConeOpacityCutoff)
+	{
+		XMFLOAT3 vPos(vOrigin.x + vDirection.x * t, vOrigin.y + vDirection.y * t, vOrigin.z + vDirection.z * t);
+		if (!IsInsideVolume(vPos, fResolution))
+		{
+			break;
+		}
+		XMFLOAT3 vUVW(vPos.x * fRecipResolution, vPos.y * fRecipResolution, vPos.z * fRecipResolution);
+		float fDiameter = std::max(1.f, 2.f * fTanHalfAngle * t);
+		float fMipLevel = log2f(fDiameter);
+		if (pStats)
+		{
+			pStats->iNumSteps++;
+		}
+
+		int iEmptyLevel = -1;
+		if (pOccupancy)
+		{
+			GetSampleFootprint(vUVW, fMipLevel, iResolution, iMipLevels, vFootprintMin, vFootprintMax);
+			iEmptyLevel = pOccupancy->FindEmptyCell(vFootprintMin, vFootprintMax, vCellMin, vCellMax);
+		}
+		if (iEmptyLevel == 0)
+		{
+			//Only empty texels under this sample, but it straddles cells so the next one needs checking on its own
+			if (pStats)
+			{
+				pStats->iNumSkips++;
+			}
+			t += fDiameter * kConeStepScale;
+			continue;
+		}
+		if (iEmptyLevel > 0)
+		{
+			//Every sample that stays inside the empty cell would read nothing but zeros, so run the steps through it
+			//without sampling. The step lengths only depend on t, so the samples after it land in the same places.
+			if (pStats)
+			{
+				pStats->iNumSkips++;
+			}
+			while (true)
+			{
+				t += fDiameter * kConeStepScale;
+				if (t >= fMaxDistance)
+				{
+					break;
+				}
+				vPos = XMFLOAT3(vOrigin.x + vDirection.x * t, vOrigin.y + vDirection.y * t, vOrigin.z + vDirection.z * t);
+				if (!IsInsideVolume(vPos, fResolution))
+				{
+					break;
+				}
+				vUVW = XMFLOAT3(vPos.x * fRecipResolution, vPos.y * fRecipResolution, vPos.z * fRecipResolution);
+				fDiameter = std::max(1.f, 2.f * fTanHalfAngle * t);
+				fMipLevel = log2f(fDiameter);
+				GetSampleFootprint(vUVW, fMipLevel, iResolution, iMipLevels, vFootprintMin, vFootprintMax);
+				if (!IsBoxInsideCell(vFootprintMin, vFootprintMax, vCellMin, vCellMax))
+				{
+					break;
+				}
+				if (pStats)
+				{
+					pStats->iNumSteps++;
+				}
+			}
+			continue;
+		}
+
+		XMFLOAT4 vSample = volume.SampleLevel(vUVW, fMipLevel);
+		if (pStats)
+		{
+			pStats->iNumSamples++;
+		}
+		//Premultiplied, front to back
+		float fTransmittance = 1.f - vAccumulated.w;
+		vAccumulated.x += fTransmittance * vSample.x;
+		vAccumulated.y += fTransmittance * vSample.y;
+		vAccumulated.z += fTransmittance * vSample.z;
+		vAccumulated.w += fTransmittance * vSample.w;
+
+		t += fDiameter * kConeStepScale;
+	}
+	return vAccumulated;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int OccupancyPyramid::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	//Builds at every SIMD level against working the bits and cells out one voxel at a time
+	const int iResolutions[] = { 4, 8, 32, 64, 128 };
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iRes = iResolutions[r];
+		CPUVoxelVolume volume;
+		volume.Initialise(iRes, 1);
+		FillRandomVolume(volume, rng, r % 2 == 0 ? 0.3f : 1.f);
+
+		for (int iLevel = simdScalar; iLevel < simdMax; iLevel++)
+		{
+			OccupancyPyramid pyramid;
+			pyramid.Initialise(iRes, 1 + iLevel);
+			pyramid.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+			if (pyramid.m_eSIMDLevel != iLevel)
+			{
+				continue;
+			}
+			pyramid.Build(volume);
+
+			for (int z = 0; z < iRes; z++)
+			{
+				for (int y = 0; y < iRes; y++)
+				{
+					for (int x = 0; x < iRes; x++)
+					{
+						iFailures += pyramid.IsVoxelOccupied(x, y, z) != (volume.GetVoxel(x, y, z) != 0);
+					}
+				}
+			}
+			for (int l = 1; l < pyramid.GetNumLevels(); l++)
+			{
+				int iCellSize = pyramid.GetCellSize(l);
+				int iLevelRes = pyramid.GetLevelResolution(l);
+				for (int cz = 0; cz < iLevelRes; cz++)
+				{
+					for (int cy = 0; cy < iLevelRes; cy++)
+					{
+						for (int cx = 0; cx < iLevelRes; cx++)
+						{
+							int iOccupied = 0;
+							for (int z = cz * iCellSize; z < (cz + 1) * iCellSize; z++)
+							{
+								for (int y = cy * iCellSize; y < (cy + 1) * iCellSize; y++)
+								{
+									for (int x = cx * iCellSize; x < (cx + 1) * iCellSize; x++)
+									{
+										iOccupied += volume.GetVoxel(x, y, z) != 0;
+									}
+								}
+							}
+							uint8_t iExpected = (iOccupied > 0 ? kCellOccupied : 0) | (iOccupied == iCellSize * iCellSize * iCellSize ? kCellFull : 0);
+							iFailures += pyramid.GetCell(l, cx, cy, cz) != iExpected;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//Rays and cones against the dense marches
+	const int iMarchResolution = 64;
+	CPUVoxelVolume volume;
+	volume.Initialise(iMarchResolution, 5);
+	OccupancyPyramid pyramid;
+	pyramid.Initialise(iMarchResolution);
+	std::uniform_real_distribution<float> position(-16.f, iMarchResolution + 16.f);
+	std::uniform_real_distribution<float> aperture(0.02f, 1.2f);
+	for (int v = 0; v < 4; v++)
+	{
+		FillRandomVolume(volume, rng, 0.1f + v * 0.2f);
+		volume.GenerateMips();
+		pyramid.Build(volume);
+
+		for (int i = 0; i < 2000; i++)
+		{
+			XMFLOAT3 vOrigin(position(rng), position(rng), position(rng));
+			XMFLOAT3 vDir = RandomDirection(rng);
+			//axis aligned rays run along cell faces
+			if (i % 10 == 0)
+			{
+				vOrigin = XMFLOAT3(floorf(vOrigin.x), floorf(vOrigin.y), vOrigin.z);
+				vDir = XMFLOAT3(0.f, 0.f, i % 20 == 0 ? 1.f : -1.f);
+			}
+			float fDense = 0.f, fPyramid = 0.f;
+			bool bDenseHit = MarchRayDense(volume, vOrigin, vDir, 200.f, fDense);
+			bool bPyramidHit = pyramid.MarchRay(vOrigin, vDir, 200.f, fPyramid);
+			if (bDenseHit != bPyramidHit || (bDenseHit && fabsf(fDense - fPyramid) > 1e-3f))
+			{
+				iFailures++;
+			}
+		}
+
+		for (int i = 0; i < 500; i++)
+		{
+			XMFLOAT3 vOrigin(position(rng), position(rng), position(rng));
+			XMFLOAT3 vDir = RandomDirection(rng);
+			float fTanHalfAngle = aperture(rng);
+			XMFLOAT4 vDense = MarchCone(volume, nullptr, vOrigin, vDir, fTanHalfAngle, 200.f);
+			XMFLOAT4 vPyramid = MarchCone(volume, &pyramid, vOrigin, vDir, fTanHalfAngle, 200.f);
+			if (memcmp(&vDense, &vPyramid, sizeof(XMFLOAT4)) != 0)
+			{
+				iFailures++;
+			}
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Occupancy pyramid validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool OccupancyPyramid::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser, int iMipLevels)
+{
+	const int iResolutions[] = { 128, 256, 512 };
+	const int iNumRuns = 3;
+	const int iNumQueries = 4096;
+
+	struct Query
+	{
+		const char* sName;
+		float fTanHalfAngle;	//0 for a ray
+	};
+	//60 degree diffuse cones and a narrow specular one, as the lighting pass traces them
+	const Query queries[] = { { "Diffuse Cone", 0.577f }, { "Specular Cone", 0.1f }, { "Ray", 0.f } };
+
+	std::stringstream ss;
+	ss << "../Results/OccupancyPyramid_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open occupancy pyramid benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Query, Method, Queries, Steps/Query, Samples/Query, Skips/Query, ns/Query, Matches Dense\n";
+
+	std::stringstream summary;
+	bool bAllMatch = true;
+	std::mt19937 rng(1);
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolution, iMipLevels))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&volume);
+		volume.GenerateMips();
+
+		OccupancyPyramid pyramid;
+		if (!pyramid.Initialise(iResolution))
+		{
+			continue;
+		}
+
+		//Build at each SIMD level on one thread and every thread, checked against the scalar build
+		std::vector<uint64_t> arrScalarBlocks;
+		std::vector<std::vector<uint8_t>> arrScalarLevels;
+		for (int iLevel = simdScalar; iLevel < simdMax; iLevel++)
+		{
+			pyramid.SetSIMDLevel(static_cast<SIMDLevel>(iLevel));
+			if (pyramid.m_eSIMDLevel != iLevel)
+			{
+				continue;
+			}
+			const int iThreadCounts[] = { 1, Parallel::GetNumWorkerThreads() };
+			for (int t = 0; t < 2; t++)
+			{
+				pyramid.SetNumThreads(iThreadCounts[t]);
+				BuildStats best;
+				best.dBlockTimeMs = DBL_MAX;
+				best.dPyramidTimeMs = 0.0;
+				for (int i = 0; i < iNumRuns; i++)
+				{
+					pyramid.Build(volume);
+					if (pyramid.m_BuildStats.dBlockTimeMs + pyramid.m_BuildStats.dPyramidTimeMs < best.dBlockTimeMs + best.dPyramidTimeMs)
+					{
+						best = pyramid.m_BuildStats;
+					}
+				}
+				if (arrScalarBlocks.empty())
+				{
+					arrScalarBlocks = pyramid.m_arrBlocks;
+					arrScalarLevels = pyramid.m_arrLevels;
+				}
+				bool bMatch = pyramid.m_arrBlocks == arrScalarBlocks && pyramid.m_arrLevels == arrScalarLevels;
+				bAllMatch &= bMatch;
+				outfile << iResolution << ",Build," << TriangleBoxOverlap::GetLevelName(static_cast<SIMDLevel>(iLevel)) << " " << iThreadCounts[t] << " Threads,1,,,,"
+					<< (best.dBlockTimeMs + best.dPyramidTimeMs) * 1000000.0 << "," << (bMatch ? "Yes" : "No") << "\n";
+			}
+		}
+		pyramid.SetSIMDLevel(simdMax);
+		pyramid.SetNumThreads(0);
+		pyramid.Build(volume);
+
+		std::vector<XMFLOAT3> arrOrigins, arrDirections;
+		GenerateSurfaceQueries(volume, iNumQueries, rng, arrOrigins, arrDirections);
+		int iQueries = static_cast<int>(arrOrigins.size());
+		if (iQueries == 0)
+		{
+			continue;
+		}
+		float fMaxDistance = static_cast<float>(iResolution);
+
+		for (int q = 0; q < sizeof(queries) / sizeof(queries[0]); q++)
+		{
+			std::vector<XMFLOAT4> arrResults[2];
+			for (int m = 0; m < 2; m++)
+			{
+				const OccupancyPyramid* pOccupancy = m == 0 ? nullptr : &pyramid;
+				MarchStats stats;
+				memset(&stats, 0, sizeof(stats));
+				arrResults[m].resize(iQueries);
+				double dBestMs = DBL_MAX;
+				for (int i = 0; i < iNumRuns; i++)
+				{
+					MarchStats* pStats = i == 0 ? &stats : nullptr;
+					std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+					for (int j = 0; j < iQueries; j++)
+					{
+						if (queries[q].fTanHalfAngle > 0.f)
+						{
+							arrResults[m][j] = MarchCone(volume, pOccupancy, arrOrigins[j], arrDirections[j], queries[q].fTanHalfAngle, fMaxDistance, pStats);
+						}
+						else
+						{
+							float fHit = -1.f;
+							if (pOccupancy)
+							{
+								pOccupancy->MarchRay(arrOrigins[j], arrDirections[j], fMaxDistance, fHit, pStats);
+							}
+							else
+							{
+								MarchRayDense(volume, arrOrigins[j], arrDirections[j], fMaxDistance, fHit, pStats);
+							}
+							arrResults[m][j] = XMFLOAT4(fHit, 0.f, 0.f, 0.f);
+						}
+					}
+					dBestMs = std::min(dBestMs, GetElapsedMs(start));
+				}
+
+				bool bMatch = m == 0 || memcmp(arrResults[0].data(), arrResults[1].data(), iQueries * sizeof(XMFLOAT4)) == 0;
+				bAllMatch &= bMatch;
+				double dQueries = static_cast<double>(iQueries);
+				outfile << iResolution << "," << queries[q].sName << "," << (m == 0 ? "Dense" : "Pyramid") << "," << iQueries << ","
+					<< stats.iNumSteps / dQueries << "," << stats.iNumSamples / dQueries << "," << stats.iNumSkips / dQueries << ","
+					<< dBestMs * 1000000.0 / dQueries << "," << (bMatch ? "Yes" : "No") << "\n";
+
+				VS_LOG(sName << " " << iResolution << "^3 " << queries[q].sName << (m == 0 ? " dense: " : " pyramid: ") << dBestMs * 1000000.0 / dQueries
+					<< "ns, " << stats.iNumSamples / dQueries << " samples a query");
+			}
+		}
+		summary << "\n" << iResolution << " Pyramid Memory(KB):," << pyramid.GetMemoryUsageInBytes() / 1024.f;
+		summary << "\n" << iResolution << " Dense Mip 0 Memory(KB):," << volume.GetMipSizeInBytes(0) / 1024.f;
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	if (!bAllMatch)
+	{
+		VS_LOG_VERBOSE("Occupancy pyramid changed a build or a march result");
+	}
+	return bAllMatch && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,132 @@
+#ifndef OCCUPANCY_PYRAMID_H
+#define OCCUPANCY_PYRAMID_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+#include "TriangleBoxOverlap.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//One bit per voxel of mip 0 of the radiance volume, for skipping the empty space a cone or ray goes through without
+//sampling it. The bits are packed a 4x4x4 block to a uint64_t (bit (z * 16) + (y * 4) + x), blocks x fastest then
+//y then z. Above the blocks is a pyramid of one byte per cell, each level half the resolution of the one below:
+//bit 0 is the max (something in the cell is occupied), bit 1 the min (all of it is).
+//Level 0 is the voxels, level 1 the blocks and each level after that doubles the cell size up to the whole volume.
+class OccupancyPyramid
+{
+public:
+
+	static const int kBlockSize = 4;
+	static const uint8_t kCellOccupied = 1;
+	static const uint8_t kCellFull = 2;
+
+	struct BuildStats
+	{
+		SIMDLevel eSIMDLevel;
+		int iNumThreads;
+		double dBlockTimeMs;		//voxels to bits and level 1
+		double dPyramidTimeMs;		//the levels above
+	};
+
+	//Counts for one or more queries, the same whether or not empty space is skipped so they can be compared
+	struct MarchStats
+	{
+		long long iNumSteps;		//cells stepped through for rays, cone steps for cones
+		long long iNumSamples;		//voxels tested for rays, SampleLevel calls for cones
+		long long iNumSkips;		//empty cells jumped over
+	};
+
+	OccupancyPyramid();
+	~OccupancyPyramid();
+
+	//iResolution has to be a power of 2 and at least kBlockSize. iNumThreads <= 0 uses every core.
+	bool Initialise(int iResolution, int iNumThreads = 0);
+	void Shutdown();
+
+	void SetNumThreads(int iNumThreads) { m_iNumThreads = iNumThreads; }
+	//Clamped to what the CPU supports. Defaults to the best supported level.
+	void SetSIMDLevel(SIMDLevel eLevel);
+
+	//Mip 0 of the volume has to be the same resolution. Non zero texels are occupied.
+	bool Build(const CPUVoxelVolume& volume);
+	bool Build(const uint32_t* pMip0);
+
+	int GetResolution() const { return m_iResolution; }
+	int GetNumLevels() const { return m_iNumLevels; }
+	int GetCellShift(int iLevel) const { return iLevel == 0 ? 0 : iLevel + 1; }
+	int GetCellSize(int iLevel) const { return 1 << GetCellShift(iLevel); }
+	int GetLevelResolution(int iLevel) const { return m_iResolution >> GetCellShift(iLevel); }
+
+	bool IsVoxelOccupied(int x, int y, int z) const
+	{
+		uint64_t iBlock = m_arrBlocks[GetBlockIndex(x >> 2, y >> 2, z >> 2)];
+		return ((iBlock >> (((z & 3) << 4) | ((y & 3) << 2) | (x & 3))) & 1) != 0;
+	}
+	//Cell coordinates on the level, iLevel >= 1
+	uint8_t GetCell(int iLevel, int cx, int cy, int cz) const
+	{
+		int iRes = GetLevelResolution(iLevel);
+		return m_arrLevels[iLevel - 1][(static_cast<size_t>(cz) * iRes + cy) * iRes + cx];
+	}
+	bool IsCellOccupied(int iLevel, int cx, int cy, int cz) const { return (GetCell(iLevel, cx, cy, cz) & kCellOccupied) != 0; }
+	bool IsCellFull(int iLevel, int cx, int cy, int cz) const { return (GetCell(iLevel, cx, cy, cz) & kCellFull) != 0; }
+
+	const std::vector<uint64_t>& GetBlocks() const { return m_arrBlocks; }
+	const BuildStats& GetBuildStats() const { return m_BuildStats; }
+	size_t GetMemoryUsageInBytes() const;
+
+	//Positions are in voxels, [0, resolution) across the volume, and vDirection has to be normalised.
+	//Distance to the first occupied voxel the ray enters, stepping through the biggest empty cell it's in each time.
+	//False if it leaves the volume or goes further than fMaxDistance first.
+	bool MarchRay(const XMFLOAT3& vOrigin, const XMFLOAT3& vDirection, float fMaxDistance, float& fHitDistance, MarchStats* pStats = nullptr) const;
+	//The same walk one voxel at a time, what a march with no pyramid does
+	static bool MarchRayDense(const CPUVoxelVolume& volume, const XMFLOAT3& vOrigin, const XMFLOAT3& vDirection, float fMaxDistance, float& fHitDistance, MarchStats* pStats = nullptr);
+
+	//Front to back cone trace through the volume's mip chain the way the lighting shader does it - the diameter grows
+	//by 2 * fTanHalfAngle a voxel, the mip is log2 of the diameter and each step is half a diameter. With a pyramid
+	//the steps whose samples would only read empty texels aren't sampled, so the result is exactly the same as
+	//without one, just quicker.
+	static XMFLOAT4 MarchCone(const CPUVoxelVolume& volume, const OccupancyPyramid* pOccupancy, const XMFLOAT3& vOrigin, const XMFLOAT3& vDirection,
+		float fTanHalfAngle, float fMaxDistance, MarchStats* pStats = nullptr);
+
+	//Random volumes through every SIMD level against a brute force build, and random rays and cones against the dense
+	//marches. Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Builds the voxeliser's triangles at 128^3 to 512^3 and marches diffuse cones, specular cones and rays off the
+	//surfaces with and without the pyramid, writing steps and nanoseconds per query to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser, int iMipLevels);
+
+private:
+
+	size_t GetBlockIndex(int bx, int by, int bz) const { return (static_cast<size_t>(bz) * m_iBlocksPerAxis + by) * m_iBlocksPerAxis + bx; }
+	bool IsCellOccupiedAt(int iLevel, const int vVoxel[3]) const;
+	//-1 if there might be something in the voxels [vMin, vMax]. Otherwise the level of the biggest empty cell they fit
+	//inside along with the cell's bounds [vCellMin, vCellMax), or 0 if they're empty but straddle cells.
+	int FindEmptyCell(const int vMin[3], const int vMax[3], int vCellMin[3], int vCellMax[3]) const;
+
+	int m_iResolution;
+	int m_iBlocksPerAxis;
+	int m_iNumLevels;
+	int m_iNumThreads;
+	SIMDLevel m_eSIMDLevel;
+
+	std::vector<uint64_t> m_arrBlocks;
+	std::vector<std::vector<uint8_t>> m_arrLevels;	//[level - 1]
+
+	BuildStats m_BuildStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !OCCUPANCY_PYRAMID_H
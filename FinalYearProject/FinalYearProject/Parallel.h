@@ -0,0 +1,68 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Small helpers for spreading the CPU voxel work across cores. There is no job system in the renderer so these
+//just spin up std::threads for the duration of the call, which is fine for the coarse jobs we hand them.
+namespace Parallel
+{
+	//Number of threads to use when the caller doesn't ask for a specific count..
+	inline int GetNumWorkerThreads()
+	{
+		int iNumThreads = static_cast<int>(std::thread::hardware_concurrency());
+		return iNumThreads > 0 ? iNumThreads : 1;
+	}
+
+	//Runs fnJob(iJobIndex, iThreadIndex) for every job in [0, iNumJobs). Jobs are handed out one at a time from a shared
+	//counter so uneven jobs still balance out. The calling thread does work too, so iNumThreads == 1 runs inline.
+	template<typename JobFunc>
+	void For(int iNumJobs, int iNumThreads, const JobFunc& fnJob)
+	{
+		if (iNumThreads <= 0)
+		{
+			iNumThreads = GetNumWorkerThreads();
+		}
+		iNumThreads = std::min(iNumThreads, iNumJobs);
+		if (iNumThreads <= 1)
+		{
+			for (int i = 0; i < iNumJobs; i++)
+			{
+				fnJob(i, 0);
+			}
+			return;
+		}
+
+		std::atomic<int> iNextJob(0);
+		auto worker = [&](int iThreadIndex)
+		{
+			for (int i = iNextJob++; i < iNumJobs; i = iNextJob++)
+			{
+				fnJob(i, iThreadIndex);
+			}
+		};
+
+		std::vector<std::thread> arrThreads;
+		arrThreads.reserve(iNumThreads - 1);
+		for (int t = 1; t < iNumThreads; t++)
+		{
+			arrThreads.push_back(std::thread(worker, t));
+		}
+		worker(0);
+		for (int t = 0; t < arrThreads.size(); t++)
+		{
+			arrThreads[t].join();
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !PARALLEL_H
@@ -4,6 +4,26 @@
 #include "GPUProfiler.h"
 #include "DebugLog.h"
 #include "Timer.h"
+#include "TriangleBoxOverlap.h"
+#include "VoxelClipmap.h"
+#include "VoxelFragmentList.h"
+#include "BrickPool.h"
+#include "AnisotropicMips.h"
+#include "VoxelCache.h"
+#include "OccupancyPyramid.h"
+#include "DistanceField.h"
+#include "CPUConeTracer.h"
+#include "TilePool.h"
+#include "TileMappingBatch.h"
+#include "TileOccupancyBitset.h"
+#include "ResidencyPredictor.h"
+#include "TileMappingScheduler.h"
+#include "TileResidencyWorker.h"
+#include "SoftwareTiledResourceBackend.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "VertexWelder.h"
+#include "MeshOptimiser.h"
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 Renderer::Renderer()
@@ -172,6 +192,8 @@ bool Renderer::Initialise(int iScreenWidth, int iScreenHeight, HWND hwnd, Render
 		VS_LOG_VERBOSE("Could not create Mesh");
 		return false;
 	}
+	m_arrModels[0]->SetRetainCPUGeometry(CPU_BENCHMARKS);
+	m_arrModels[1]->SetRetainCPUGeometry(CPU_BENCHMARKS);
 
 
 	if (!m_arrModels[0]->InitialiseFromObj(m_pD3D->GetDevice(), m_pD3D->GetDeviceContext(), hwnd, "../Assets/Models/sponza_tri1.obj"))
@@ -189,6 +211,7 @@ bool Renderer::Initialise(int iScreenWidth, int iScreenHeight, HWND hwnd, Render
 	m_arrModels[1]->AddPatrolPoint(XMFLOAT3(-1250.f, 200.f, 0.f));
 	m_arrModels[1]->AddPatrolPoint(XMFLOAT3(1150.f, 200.f, 0.f));
 	m_arrModels[1]->StartPatrol();
+	m_arrModels[1]->SetStatic(false);
 	
 
 	LightManager* pLightManager = LightManager::Get();
@@ -210,6 +233,11 @@ bool Renderer::Initialise(int iScreenWidth, int iScreenHeight, HWND hwnd, Render
 	{
 		m_pRegularVoxelisedScene = new VoxelisedScene;
 		m_pRegularVoxelisedScene->Initialise(m_pD3D->GetDevice(), m_pD3D->GetDeviceContext(), hwnd, m_arrModels[0]->GetWholeModelAABB(), iVoxelGridResolution, false);
+		m_pRegularVoxelisedScene->SetVoxelUpdateBudgetMs(VOXEL_UPDATE_BUDGET_MS);
+		if (!m_pRegularVoxelisedScene->LoadStaticVoxelCache(m_pD3D->GetDeviceContext(), GetVoxelCacheFilename(iVoxelGridResolution).c_str(), GetStaticVoxelContentHash()))
+		{
+			VS_LOG_VERBOSE("Voxelising the static meshes, run with -bakevoxelcache to skip this at startup");
+		}
 	}
 	if (m_eRenderMode == rmComparison || m_eRenderMode == rmTiledTexture)
 	{
@@ -221,6 +249,10 @@ bool Renderer::Initialise(int iScreenWidth, int iScreenHeight, HWND hwnd, Render
 		m_eGITypeToRender = giNone;
 	}
 	
+	if (CPU_BENCHMARKS)
+	{
+		RunCPUBenchmarks();
+	}
 
 	return true;
 }
@@ -682,7 +714,7 @@ bool Renderer::RenderRegular()
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psVoxeliseClear);
 	if (bUpdateVoxelVolume)
 	{
-		m_pRegularVoxelisedScene->RenderClearVoxelsPass(pContext);
+		m_pRegularVoxelisedScene->RenderClearVoxelsPass(pContext, m_arrModels);
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psVoxeliseClear);
 	
@@ -690,11 +722,7 @@ bool Renderer::RenderRegular()
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psVoxelisePass);
 	if (bUpdateVoxelVolume)
 	{
-		for (int i = 0; i < m_arrModels.size(); i++)
-		{
-			m_arrModels[i]->GetWorldMatrix(mWorld);
-			m_pRegularVoxelisedScene->RenderMesh(pContext, mWorld, mBaseView, mProjection, m_pCamera->GetPosition(), m_arrModels[i]);
-		}
+		m_pRegularVoxelisedScene->RenderMeshes(pContext, m_arrModels, mBaseView, mProjection, m_pCamera->GetPosition());
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psVoxelisePass);
 
@@ -709,6 +737,18 @@ bool Renderer::RenderRegular()
 		m_pRegularVoxelisedScene->RenderInjectRadiancePass(pContext);
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psInjectRadiance);
+	//After injecting, as amortised updates copy regions in and out of the radiance volume
+	GPUProfiler::Get()->SetVoxelsTouched(bUpdateVoxelVolume ? m_pRegularVoxelisedScene->GetVoxelsTouchedThisFrame() : 0);
+	if (bUpdateVoxelVolume && m_pRegularVoxelisedScene->IsAmortisingVoxelUpdates())
+	{
+		const VoxelUpdateScheduler::FrameStats& updateStats = m_pRegularVoxelisedScene->GetVoxelUpdateStats();
+		GPUProfiler::Get()->SetRegionsUpdated(updateStats.iNumRegionsUpdated, updateStats.iMaxStaleness);
+	}
+	if (CHECK_INJECT_RADIANCE && bUpdateVoxelVolume)
+	{
+		CPURadianceInjector::CompareResult result;
+		m_pRegularVoxelisedScene->CheckInjectRadiance(m_pD3D->GetDevice(), pContext, result);
+	}
 
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psGenerateMips);
 	if (bUpdateVoxelVolume)
@@ -798,6 +838,7 @@ bool Renderer::RenderTiled()
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psVoxeliseClear);
 	if (bUpdateVoxelVolume)
 	{
+		m_pTiledVoxelisedScene->CompactTiles(pContext);
 		m_pTiledVoxelisedScene->RenderClearVoxelsPass(pContext);
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psVoxeliseClear);
@@ -806,13 +847,10 @@ bool Renderer::RenderTiled()
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psVoxelisePass);
 	if (bUpdateVoxelVolume)
 	{
-		for (int i = 0; i < m_arrModels.size(); i++)
-		{
-			m_arrModels[i]->GetWorldMatrix(mWorld);
-			m_pTiledVoxelisedScene->RenderMesh(pContext, mWorld, mBaseView, mProjection, m_pCamera->GetPosition(), m_arrModels[i]);
-		}
+		m_pTiledVoxelisedScene->RenderMeshes(pContext, m_arrModels, mBaseView, mProjection, m_pCamera->GetPosition());
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psVoxelisePass);
+	GPUProfiler::Get()->SetVoxelsTouched(bUpdateVoxelVolume ? m_pTiledVoxelisedScene->GetVoxelsTouchedThisFrame() : 0);
 
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psInjectRadiance);
 	if (bUpdateVoxelVolume)
@@ -871,7 +909,12 @@ bool Renderer::RenderTiled()
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psTileUpdate);
 	if (bUpdateVoxelVolume)
 	{
-		m_pTiledVoxelisedScene->Update(pContext);
+		m_pTiledVoxelisedScene->PredictTileResidency(m_arrModels);
+		m_pTiledVoxelisedScene->Update(pContext, m_pCamera->GetPosition());
+		const TileMappingBatch::Stats& mappingStats = m_pTiledVoxelisedScene->GetTileMappingStats();
+		GPUProfiler::Get()->SetTileMappingCalls(static_cast<int>(mappingStats.iNumCalls), static_cast<int>(mappingStats.iNumTiles));
+		GPUProfiler::Get()->SetTileMappingSchedule(m_pTiledVoxelisedScene->GetTileMappingSchedule());
+		GPUProfiler::Get()->SetTileResidencyLatency(m_pTiledVoxelisedScene->GetTileResidencyLatency().fLastMs);
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psTileUpdate);
 	m_dTileUpdateTime = (Timer::Get()->GetCurrentTime() - m_dTileUpdateTime) * 1000;
@@ -916,8 +959,9 @@ bool Renderer::RenderComparison(float& imageDifferencePercent)
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psVoxeliseClear);
 	if (bUpdateVoxelVolume)
 	{
+		m_pTiledVoxelisedScene->CompactTiles(pContext);
 		m_pTiledVoxelisedScene->RenderClearVoxelsPass(pContext);
-		m_pRegularVoxelisedScene->RenderClearVoxelsPass(pContext);
+		m_pRegularVoxelisedScene->RenderClearVoxelsPass(pContext, m_arrModels);
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psVoxeliseClear);
 
@@ -925,12 +969,8 @@ bool Renderer::RenderComparison(float& imageDifferencePercent)
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psVoxelisePass);
 	if (bUpdateVoxelVolume)
 	{
-		for (int i = 0; i < m_arrModels.size(); i++)
-		{
-			m_arrModels[i]->GetWorldMatrix(mWorld);
-			m_pTiledVoxelisedScene->RenderMesh(pContext, mWorld, mBaseView, mProjection, m_pCamera->GetPosition(), m_arrModels[i]);
-			m_pRegularVoxelisedScene->RenderMesh(pContext, mWorld, mBaseView, mProjection, m_pCamera->GetPosition(), m_arrModels[i]);
-		}
+		m_pTiledVoxelisedScene->RenderMeshes(pContext, m_arrModels, mBaseView, mProjection, m_pCamera->GetPosition());
+		m_pRegularVoxelisedScene->RenderMeshes(pContext, m_arrModels, mBaseView, mProjection, m_pCamera->GetPosition());
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psVoxelisePass);
 
@@ -938,7 +978,12 @@ bool Renderer::RenderComparison(float& imageDifferencePercent)
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psTileUpdate);
 	if (bUpdateVoxelVolume)
 	{
-		m_pTiledVoxelisedScene->Update(pContext);
+		m_pTiledVoxelisedScene->PredictTileResidency(m_arrModels);
+		m_pTiledVoxelisedScene->Update(pContext, m_pCamera->GetPosition());
+		const TileMappingBatch::Stats& mappingStats = m_pTiledVoxelisedScene->GetTileMappingStats();
+		GPUProfiler::Get()->SetTileMappingCalls(static_cast<int>(mappingStats.iNumCalls), static_cast<int>(mappingStats.iNumTiles));
+		GPUProfiler::Get()->SetTileMappingSchedule(m_pTiledVoxelisedScene->GetTileMappingSchedule());
+		GPUProfiler::Get()->SetTileResidencyLatency(m_pTiledVoxelisedScene->GetTileResidencyLatency().fLastMs);
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psTileUpdate);
 	m_dTileUpdateTime = (Timer::Get()->GetCurrentTime() - m_dTileUpdateTime) * 1000;
@@ -950,6 +995,12 @@ bool Renderer::RenderComparison(float& imageDifferencePercent)
 		m_pRegularVoxelisedScene->RenderInjectRadiancePass(pContext);
 	}
 	GPUProfiler::Get()->EndTimeStamp(pContext, GPUProfiler::psInjectRadiance);
+	GPUProfiler::Get()->SetVoxelsTouched(bUpdateVoxelVolume ? m_pTiledVoxelisedScene->GetVoxelsTouchedThisFrame() + m_pRegularVoxelisedScene->GetVoxelsTouchedThisFrame() : 0);
+	if (bUpdateVoxelVolume && m_pRegularVoxelisedScene->IsAmortisingVoxelUpdates())
+	{
+		const VoxelUpdateScheduler::FrameStats& updateStats = m_pRegularVoxelisedScene->GetVoxelUpdateStats();
+		GPUProfiler::Get()->SetRegionsUpdated(updateStats.iNumRegionsUpdated, updateStats.iMaxStaleness);
+	}
 
 	GPUProfiler::Get()->StartTimeStamp(pContext, GPUProfiler::psGenerateMips);
 	if (bUpdateVoxelVolume)
@@ -1096,6 +1147,303 @@ float Renderer::GetCompTexturePercentageDifference()
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+uint64_t Renderer::GetStaticVoxelContentHash()
+{
+	uint64_t iHash = VoxelCache::HashFile("../Assets/Shaders/Voxelise_Populate.hlsl");
+	XMMATRIX mWorld;
+	for (int i = 0; i < m_arrModels.size(); i++)
+	{
+		if (!m_arrModels[i]->IsStatic())
+		{
+			continue;
+		}
+		const std::vector<std::string>& arrFiles = m_arrModels[i]->GetSourceFiles();
+		for (int j = 0; j < arrFiles.size(); j++)
+		{
+			iHash = VoxelCache::HashFile(arrFiles[j].c_str(), iHash);
+		}
+		m_arrModels[i]->GetWorldMatrix(mWorld);
+		iHash = VoxelCache::HashMatrix(mWorld, iHash);
+	}
+	return iHash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string Renderer::GetVoxelCacheFilename(int iResolution)
+{
+	return "../Assets/VoxelCache/Sponza_" + std::to_string(iResolution) + ".vxc";
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool Renderer::BakeVoxelCaches(HWND hwnd, const std::vector<int>& arrResolutions)
+{
+	ID3D11DeviceContext3* pContext = m_pD3D->GetDeviceContext();
+	uint64_t iContentHash = GetStaticVoxelContentHash();
+	XMMATRIX mView, mProjection;
+	m_pCamera->GetBaseViewMatrix(mView);
+	m_pD3D->GetProjectionMatrix(mProjection);
+
+	CreateDirectoryA("../Assets/VoxelCache", nullptr);
+	bool bSuccess = true;
+	for (int i = 0; i < arrResolutions.size(); i++)
+	{
+		VoxelisedScene scene;
+		if (FAILED(scene.Initialise(m_pD3D->GetDevice(), pContext, hwnd, m_arrModels[0]->GetWholeModelAABB(), arrResolutions[i], false)))
+		{
+			VS_LOG_VERBOSE("Failed to initialise voxelised scene to bake at " << arrResolutions[i]);
+			bSuccess = false;
+			continue;
+		}
+
+		//Same passes as the first frame, which voxelises the static meshes on their own before the dynamic ones
+		m_pD3D->TurnZBufferOff();
+		scene.RenderClearVoxelsPass(pContext, m_arrModels);
+		scene.RenderMeshes(pContext, m_arrModels, mView, mProjection, m_pCamera->GetPosition());
+		m_pD3D->TurnZBufferOn();
+
+		std::string sFilename = GetVoxelCacheFilename(arrResolutions[i]);
+		if (scene.SaveStaticVoxelCache(m_pD3D->GetDevice(), pContext, sFilename.c_str(), iContentHash))
+		{
+			VS_LOG_VERBOSE("Baked voxel cache " << sFilename.c_str());
+		}
+		else
+		{
+			VS_LOG_VERBOSE("Failed to bake voxel cache " << sFilename.c_str());
+			bSuccess = false;
+		}
+	}
+	return bSuccess;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Renderer::RunCPUBenchmarks()
+{
+	//Same grid the GPU voxelisation uses, so the numbers line up with the GPUProfiler results
+	float fVoxelGridSize = 0.f;
+	const AABB& sceneAABB = m_arrModels[0]->GetWholeModelAABB();
+	XMMATRIX mWorldToVoxelGrid = VoxelGrid::CreateWorldToVoxelGrid(sceneAABB.Min, sceneAABB.Max, fVoxelGridSize);
+
+	XMMATRIX mWorld;
+	CPUVoxeliser voxeliser;
+	voxeliser.Initialise(mWorldToVoxelGrid);
+	for (int i = 0; i < m_arrModels.size(); i++)
+	{
+		m_arrModels[i]->GetWorldMatrix(mWorld);
+		VoxelisedScene::RenderMeshCPU(&voxeliser, mWorld, m_arrModels[i]);
+	}
+
+	//Loading Sponza with the parallel parser against the old ifstream loader
+	if (!ObjParser::RunBenchmark("Sponza", "../Assets/Models/sponza_tri1.obj"))
+	{
+		VS_LOG_VERBOSE("Obj parser disagrees with the ifstream loader");
+	}
+
+	//Loading Sponza's vertex arrays from the obj against mapping them out of a mesh cache
+	if (!MeshCache::RunBenchmark("Sponza", "../Assets/Models/sponza_tri1.obj"))
+	{
+		VS_LOG_VERBOSE("Mesh cache doesn't match the obj it was written from");
+	}
+
+	//Sponza's corners welded into indexed vertices, and how much smaller the buffers get
+	if (!VertexWelder::RunBenchmark("Sponza", "../Assets/Models/sponza_tri1.obj"))
+	{
+		VS_LOG_VERBOSE("Welded vertices don't give back the corners they came from");
+	}
+
+	//Sponza's submeshes reordered for the vertex cache, overdraw and fetching, and the cache misses before and after
+	if (!MeshOptimiser::RunBenchmark("Sponza", "../Assets/Models/sponza_tri1.obj"))
+	{
+		VS_LOG_VERBOSE("Optimised submeshes don't have the triangles they started with");
+	}
+
+	if (!TriangleBoxOverlap::RunBenchmark("Synthetic"))
+	{
+		VS_LOG_VERBOSE("Triangle/box overlap kernels disagree with the scalar version");
+	}
+
+	if (!voxeliser.RunBenchmark("Sponza"))
+	{
+		VS_LOG_VERBOSE("CPU voxeliser benchmark failed");
+	}
+
+	//Six directional mip chains against the one GenerateMips makes
+	if (!AnisotropicMips::RunBenchmark("Sponza", &voxeliser, MIP_LEVELS))
+	{
+		VS_LOG_VERBOSE("Anisotropic mips benchmark failed");
+	}
+
+	//Empty space skipping for cones and rays against marching the dense volume
+	if (!OccupancyPyramid::RunBenchmark("Sponza", &voxeliser, MIP_LEVELS))
+	{
+		VS_LOG_VERBOSE("Occupancy pyramid benchmark failed");
+	}
+
+	//Full and incremental distance field builds, checked against brute force
+	if (!DistanceField::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Distance field benchmark failed");
+	}
+
+	//Radiance injection cost per light count, and the SIMD kernels against each other
+	if (!CPURadianceInjector::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Radiance injection benchmark failed");
+	}
+
+	//Cone traced GI on the CPU in each mode, the SIMD levels against each other, with the images for comparing to the GPU
+	if (!CPUConeTracer::RunBenchmark("Sponza", &voxeliser, MIP_LEVELS))
+	{
+		VS_LOG_VERBOSE("Cone tracer benchmark failed");
+	}
+
+	//Relighting a few regions a frame to a budget, and how stale the rest of the volume gets
+	if (!VoxelUpdateScheduler::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Voxel update scheduler benchmark failed");
+	}
+
+	//Tile pool size and resizes with unmapping and compaction against the old grow by one pool
+	if (!TilePool::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Tile pool benchmark failed");
+	}
+
+	//UpdateTileMappings calls batched a call a mip against a call a tile
+	if (!TileMappingBatch::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Tile mapping batch benchmark failed");
+	}
+
+	//The CPU side of the tile update, bitsets against the nested loops it used to be
+	if (!TileOccupancyBitset::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Tile occupancy benchmark failed");
+	}
+
+	//Warming up the tiled volume under a few mapping budgets, and the frames each mip waits to be mapped
+	if (!TileMappingScheduler::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Tile mapping scheduler benchmark failed");
+	}
+
+	//The tile residency work on its own thread against on the render thread
+	if (!TileResidencyWorker::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Tile residency worker benchmark failed");
+	}
+
+	//The whole tiled update against host memory, with the same rows the GPU build profiles
+	if (!SoftwareTiledResourceBackend::RunBenchmark("Sponza", &voxeliser))
+	{
+		VS_LOG_VERBOSE("Software tiled resources benchmark failed");
+	}
+
+	//Sparse voxel octree memory against the dense radiance volume at the resolutions the menu offers
+	const int iResolutions[] = { 64, 128, 256, 512 };
+	for (int i = 0; i < sizeof(iResolutions) / sizeof(iResolutions[0]); i++)
+	{
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolutions[i], MIP_LEVELS))
+		{
+			continue;
+		}
+		voxeliser.Voxelise(&volume);
+		volume.GenerateMips();
+
+		std::vector<VoxelFragment> arrFragments;
+		volume.GatherFragments(arrFragments);
+		SparseVoxelOctree octree;
+		if (octree.Initialise(iResolutions[i]) && octree.Build(arrFragments))
+		{
+			octree.WriteMemoryReport("Sponza", &volume);
+		}
+	}
+
+	//Clipmap levels of 128^3 with the finest voxels as small as the 512^3 scene grid's, along the camera route
+	if (VoxelClipmap::Validate(200, 1) != 0)
+	{
+		VS_LOG_VERBOSE("Voxel clipmap update regions are wrong");
+	}
+	VoxelClipmap clipmap;
+	if (clipmap.Initialise(4, 128, fVoxelGridSize / 512.f))
+	{
+		clipmap.WriteRouteReport("Sponza", m_pCamera->m_arrRoute);
+	}
+
+	//Sorting and merging the fragment list, synthetic fragments first then Sponza's own at 512^3
+	if (!VoxelFragmentList::RunBenchmark("Synthetic", 10000000))
+	{
+		VS_LOG_VERBOSE("Voxel fragment list radix sort disagrees with std::stable_sort");
+	}
+	VoxelFragmentList fragmentList;
+	if (fragmentList.Initialise(512) && voxeliser.Voxelise(&fragmentList))
+	{
+		fragmentList.SortAndMerge();
+		const VoxelFragmentList::Stats& stats = fragmentList.GetStats();
+		VS_LOG("Sponza fragment list: " << stats.iNumFragments << " fragments merged into " << stats.iNumVoxels << " voxels, sort " << stats.dSortTimeMs << "ms, merge " << stats.dMergeTimeMs << "ms");
+	}
+
+	//Brick pool allocations as the sphere patrols through the static scene at 256^3, at the speed Mesh::Update moves it
+	const int iBrickPoolResolution = 256;
+	CPUVoxeliser staticVoxeliser;
+	staticVoxeliser.Initialise(mWorldToVoxelGrid);
+	for (int i = 0; i < m_arrModels.size(); i++)
+	{
+		if (m_arrModels[i]->IsStatic())
+		{
+			m_arrModels[i]->GetWorldMatrix(mWorld);
+			VoxelisedScene::RenderMeshCPU(&staticVoxeliser, mWorld, m_arrModels[i]);
+		}
+	}
+	CPUVoxelVolume staticVolume;
+	if (staticVolume.Initialise(iBrickPoolResolution, 1) && staticVoxeliser.Voxelise(&staticVolume))
+	{
+		VoxelGrid grid;
+		grid.Initialise(mWorldToVoxelGrid, iBrickPoolResolution);
+		const std::vector<XMFLOAT3>& arrPatrol = m_arrModels[1]->GetPatrolRoute();
+		std::vector<XMFLOAT3> arrPatrolVoxels(arrPatrol.size());
+		for (int i = 0; i < arrPatrol.size(); i++)
+		{
+			grid.WorldToVoxel(arrPatrol[i], arrPatrolVoxels[i]);
+		}
+		AABB sphereAABB;
+		m_arrModels[1]->GetWorldAABB(sphereAABB);
+		float fRadius = (sphereAABB.Max.x - sphereAABB.Min.x) * 0.5f / grid.GetVoxelSize();
+		if (!BrickPool::RunPatrolBenchmark("Sponza", staticVolume, arrPatrolVoxels, fRadius, 5.f / grid.GetVoxelSize(), 2000, 60))
+		{
+			VS_LOG_VERBOSE("Brick pool patrol benchmark failed");
+		}
+	}
+
+	//Voxels the sphere loses to tiles the late occupation readback hasn't mapped yet, with and without residency
+	//prediction, at 512^3 where the tiles are small enough for it to leave the static scene's
+	const int iResidencyResolution = 512;
+	CPUVoxelVolume residencyVolume;
+	if (residencyVolume.Initialise(iResidencyResolution, 1) && staticVoxeliser.Voxelise(&residencyVolume))
+	{
+		VoxelGrid grid;
+		grid.Initialise(mWorldToVoxelGrid, iResidencyResolution);
+		const std::vector<XMFLOAT3>& arrPatrol = m_arrModels[1]->GetPatrolRoute();
+		std::vector<XMFLOAT3> arrPatrolVoxels(arrPatrol.size());
+		for (int i = 0; i < arrPatrol.size(); i++)
+		{
+			grid.WorldToVoxel(arrPatrol[i], arrPatrolVoxels[i]);
+		}
+		AABB sphereAABB;
+		m_arrModels[1]->GetWorldAABB(sphereAABB);
+		float fRadius = (sphereAABB.Max.x - sphereAABB.Min.x) * 0.5f / grid.GetVoxelSize();
+		if (!ResidencyPredictor::RunBenchmark("Sponza", residencyVolume, arrPatrolVoxels, fRadius, 5.f / grid.GetVoxelSize(), OCCUPATION_FRAMES - 1, 2000))
+		{
+			VS_LOG_VERBOSE("Residency predictor lost voxels the readback alone didn't");
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void Renderer::OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shaderFilename)
 {
 	//Get ptr to error message text buffer
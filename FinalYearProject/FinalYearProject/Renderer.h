@@ -21,6 +21,9 @@ const bool RENDER_DEBUG = false;
 const bool VSYNC_ENABLED = true;
 const float SCREEN_DEPTH = 3000.f;
 const float SCREEN_NEAR = 0.1f;
+const bool CPU_BENCHMARKS = false; //runs the CPU voxel benchmarks at startup and writes them to ../Results/
+const bool CHECK_INJECT_RADIANCE = false; //reads the radiance volume back every frame and checks it against CPURadianceInjector
+const float VOXEL_UPDATE_BUDGET_MS = 1.f; //GPU time a frame the amortised voxel updates get for relighting regions of the volume
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -55,6 +58,8 @@ public:
 	bool Update(HWND hwnd);
 	bool DisplayVoxelStorageMenu(RenderMode& eRenderMode);
 	bool DisplayResolutionMenu(int& iVoxelGridResolution);
+	//Voxelises the static meshes at each resolution and writes them to the voxel caches loaded at startup
+	bool BakeVoxelCaches(HWND hwnd, const std::vector<int>& arrResolutions);
 
 private:
 	int m_iScreenWidth;
@@ -101,6 +106,10 @@ private:
 	bool RenderComparison(float& imageDifferencePercent);
 
 	void RunImageCompShader();
+	void RunCPUBenchmarks();
+	//Hash of everything the static voxels are built from - the meshes' files, their transforms and the voxelise shader
+	uint64_t GetStaticVoxelContentHash();
+	std::string GetVoxelCacheFilename(int iResolution);
 	float GetCompTexturePercentageDifference();
 	void OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shaderFilename);
 
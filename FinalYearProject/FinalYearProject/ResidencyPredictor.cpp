@@ -0,0 +1,551 @@
+#include "ResidencyPredictor.h"
+#include "TileOccupancyBitset.h"
+#include "CPUVoxelVolume.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Enough to cover the frame the new mappings are first voxelised into and one either side of it
+	const int kDefaultLookaheadFrames = 2;
+	//Longer than it takes the patrolling sphere to cross a tile boundary and come back over it
+	const int kDefaultUnmapDelayFrames = 8;
+	const int kNeverNeeded = INT_MIN / 2;
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Same movement as Mesh::Update
+	void StepPatrol(const std::vector<XMFLOAT3>& arrPatrolRoute, float fSpeed, XMFLOAT3& vPos, int& iPatrolIndex)
+	{
+		XMVECTOR vDest = XMLoadFloat3(&arrPatrolRoute[(iPatrolIndex + 1) % arrPatrolRoute.size()]);
+		XMVECTOR vDir = XMVector3Normalize(vDest - XMLoadFloat3(&arrPatrolRoute[iPatrolIndex]));
+		XMVECTOR vCurrent = XMLoadFloat3(&vPos) + vDir * fSpeed;
+		if (XMVectorGetX(XMVector3LengthSq(vDest - vCurrent)) < fSpeed * fSpeed)
+		{
+			iPatrolIndex = (iPatrolIndex + 1) % static_cast<int>(arrPatrolRoute.size());
+		}
+		XMStoreFloat3(&vPos, vCurrent);
+	}
+
+	//The voxels of the sphere's shell, counted up a tile
+	void GetShellTiles(const XMFLOAT3& vCentre, float fRadius, int iResolution, const int iTileSize[3], const int iTiles[3],
+		std::vector<std::pair<int, int>>& arrTiles, int& iNumVoxels)
+	{
+		const float fCentre[3] = { vCentre.x, vCentre.y, vCentre.z };
+		int iMin[3], iMax[3];
+		for (int a = 0; a < 3; a++)
+		{
+			iMin[a] = std::max(0, static_cast<int>(floorf(fCentre[a] - fRadius - 1.f)));
+			iMax[a] = std::min(iResolution - 1, static_cast<int>(ceilf(fCentre[a] + fRadius + 1.f)));
+		}
+
+		std::vector<int> arrTileVoxels;
+		iNumVoxels = 0;
+		for (int z = iMin[2]; z <= iMax[2]; z++)
+		{
+			for (int y = iMin[1]; y <= iMax[1]; y++)
+			{
+				for (int x = iMin[0]; x <= iMax[0]; x++)
+				{
+					float dx = x + 0.5f - vCentre.x, dy = y + 0.5f - vCentre.y, dz = z + 0.5f - vCentre.z;
+					if (fabsf(sqrtf(dx * dx + dy * dy + dz * dz) - fRadius) <= 0.866f)
+					{
+						arrTileVoxels.push_back(((z / iTileSize[2]) * iTiles[1] + y / iTileSize[1]) * iTiles[0] + x / iTileSize[0]);
+						iNumVoxels++;
+					}
+				}
+			}
+		}
+
+		std::sort(arrTileVoxels.begin(), arrTileVoxels.end());
+		arrTiles.clear();
+		for (size_t i = 0; i < arrTileVoxels.size(); i++)
+		{
+			if (arrTiles.empty() || arrTiles.back().first != arrTileVoxels[i])
+			{
+				arrTiles.push_back(std::make_pair(arrTileVoxels[i], 0));
+			}
+			arrTiles.back().second++;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ResidencyPredictor::ResidencyPredictor()
+	: m_iLookaheadFrames(kDefaultLookaheadFrames),
+	m_iUnmapDelayFrames(kDefaultUnmapDelayFrames),
+	m_iReadbackLatency(0),
+	m_iFrame(0)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		m_iTiles[a] = 0;
+		m_iTileSize[a] = 1;
+	}
+	m_Stats = Stats();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ResidencyPredictor::~ResidencyPredictor()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ResidencyPredictor::Initialise(int iTilesX, int iTilesY, int iTilesZ, int iTileWidth, int iTileHeight, int iTileDepth)
+{
+	m_iTiles[0] = iTilesX;
+	m_iTiles[1] = iTilesY;
+	m_iTiles[2] = iTilesZ;
+	m_iTileSize[0] = iTileWidth;
+	m_iTileSize[1] = iTileHeight;
+	m_iTileSize[2] = iTileDepth;
+
+	size_t iNumTiles = static_cast<size_t>(iTilesX) * iTilesY * iTilesZ;
+	m_arrLastNeeded.assign(iNumTiles, kNeverNeeded);
+	m_arrFlags.assign(iNumTiles, 0);
+	m_iFrame = 0;
+	m_Stats = Stats();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ResidencyPredictor::AddVoxelBox(const int vMin[3], const int vMax[3])
+{
+	int iMin[3], iMax[3];
+	for (int a = 0; a < 3; a++)
+	{
+		int iVoxels = m_iTiles[a] * m_iTileSize[a];
+		int iBoxMin = std::max(vMin[a], 0);
+		int iBoxMax = std::min(vMax[a], iVoxels);
+		if (iBoxMin >= iBoxMax)
+		{
+			return;
+		}
+		iMin[a] = iBoxMin / m_iTileSize[a];
+		iMax[a] = (iBoxMax - 1) / m_iTileSize[a];
+	}
+
+	for (int z = iMin[2]; z <= iMax[2]; z++)
+	{
+		for (int y = iMin[1]; y <= iMax[1]; y++)
+		{
+			for (int x = iMin[0]; x <= iMax[0]; x++)
+			{
+				m_arrFlags[GetTileIndex(x, y, z)] |= tfPredicted;
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ResidencyPredictor::Apply(TileOccupancyBitset& occupancy)
+{
+	m_Stats.iNumHeld = 0;
+	for (int z = 0; z < m_iTiles[2]; z++)
+	{
+		for (int y = 0; y < m_iTiles[1]; y++)
+		{
+			for (int x = 0; x < m_iTiles[0]; x++)
+			{
+				int iTile = GetTileIndex(x, y, z);
+				uint8_t iFlags = m_arrFlags[iTile];
+				bool bOccupied = occupancy.IsOccupied(x, y, z, 0);
+				if (iFlags & tfPredicted)
+				{
+					m_arrLastNeeded[iTile] = m_iFrame + m_iReadbackLatency;
+				}
+				else if (bOccupied)
+				{
+					m_arrLastNeeded[iTile] = std::max(m_arrLastNeeded[iTile], m_iFrame);
+				}
+				bool bMapped = m_iFrame - m_arrLastNeeded[iTile] <= m_iUnmapDelayFrames;
+
+				if (bOccupied)
+				{
+					if (iFlags & tfUnconfirmed)
+					{
+						m_Stats.iNumHits++;
+						iFlags &= ~tfUnconfirmed;
+					}
+				}
+				else if (bMapped)
+				{
+					occupancy.SetOccupied(x, y, z);
+					m_Stats.iNumHeld++;
+					//Only a prediction can map a tile the readback doesn't have, the delay just keeps it mapped
+					if (!(iFlags & tfMapped))
+					{
+						m_Stats.iNumPredictedMappings++;
+						iFlags |= tfUnconfirmed;
+					}
+				}
+				else if (iFlags & tfUnconfirmed)
+				{
+					m_Stats.iNumWasted++;
+					iFlags &= ~tfUnconfirmed;
+				}
+
+				iFlags = bMapped ? (iFlags | tfMapped) : (iFlags & ~tfMapped);
+				m_arrFlags[iTile] = iFlags & ~tfPredicted;
+			}
+		}
+	}
+	m_iFrame++;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ResidencyPredictor::Clear()
+{
+	std::fill(m_arrLastNeeded.begin(), m_arrLastNeeded.end(), kNeverNeeded);
+	std::fill(m_arrFlags.begin(), m_arrFlags.end(), 0);
+	m_Stats.iNumHeld = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int ResidencyPredictor::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	for (int iTest = 0; iTest < 8; iTest++)
+	{
+		int iTiles[3] = { 1 + static_cast<int>(rng() % 70), 1 + static_cast<int>(rng() % 6), 1 + static_cast<int>(rng() % 6) };
+		int iTileSize[3] = { 1 + static_cast<int>(rng() % 4), 1 + static_cast<int>(rng() % 4), 1 + static_cast<int>(rng() % 4) };
+		int iDelay = rng() % 6;
+		int iLatency = rng() % 5;
+		int iNumTiles = iTiles[0] * iTiles[1] * iTiles[2];
+
+		TileOccupancyBitset occupancy;
+		occupancy.Initialise(iTiles[0], iTiles[1], iTiles[2], 1);
+		ResidencyPredictor predictor;
+		predictor.Initialise(iTiles[0], iTiles[1], iTiles[2], iTileSize[0], iTileSize[1], iTileSize[2]);
+		predictor.SetUnmapDelayFrames(iDelay);
+		predictor.SetReadbackLatency(iLatency);
+
+		//Each frame's readback (1) and predicted (2) tiles since the last Clear, newest last, and each tile's current
+		//stretch of being mapped
+		std::vector<std::vector<uint8_t>> arrHistory;
+		std::vector<uint8_t> arrReadback(iNumTiles, 0), arrWasMapped(iNumTiles, 0), arrPredictedStretch(iNumTiles, 0), arrStretchHit(iNumTiles, 0);
+		Stats expected = Stats();
+		for (int f = 0; f < 60; f++)
+		{
+			if (rng() % 25 == 0)
+			{
+				predictor.Clear();
+				occupancy.Clear();
+				arrHistory.clear();
+				std::fill(arrWasMapped.begin(), arrWasMapped.end(), 0);
+			}
+
+			for (int i = 0; i < iNumTiles; i++)
+			{
+				arrReadback[i] ^= (rng() % 8 == 0) ? 1 : 0;
+			}
+			std::vector<uint8_t> arrNeeded(arrReadback);
+
+			//Boxes hanging off the edges of the volume, and empty ones, as well as ones inside it
+			int iNumBoxes = rng() % 3;
+			for (int b = 0; b < iNumBoxes; b++)
+			{
+				int vMin[3], vMax[3];
+				for (int a = 0; a < 3; a++)
+				{
+					int iVoxels = iTiles[a] * iTileSize[a];
+					vMin[a] = static_cast<int>(rng() % (iVoxels + 6)) - 3;
+					vMax[a] = vMin[a] + static_cast<int>(rng() % (iTileSize[a] * 3));
+				}
+				predictor.AddVoxelBox(vMin, vMax);
+				for (int z = 0; z < iTiles[2]; z++)
+				{
+					for (int y = 0; y < iTiles[1]; y++)
+					{
+						for (int x = 0; x < iTiles[0]; x++)
+						{
+							const int t[3] = { x, y, z };
+							bool bOverlaps = true;
+							for (int a = 0; a < 3; a++)
+							{
+								bOverlaps &= vMin[a] < vMax[a] && t[a] * iTileSize[a] < vMax[a] && (t[a] + 1) * iTileSize[a] > vMin[a];
+							}
+							arrNeeded[(z * iTiles[1] + y) * iTiles[0] + x] |= bOverlaps ? 2 : 0;
+						}
+					}
+				}
+			}
+			arrHistory.push_back(arrNeeded);
+
+			occupancy.LoadMip0(arrReadback.data(), iTiles[0], iTiles[0] * iTiles[1]);
+			predictor.Apply(occupancy);
+
+			int iHeld = 0;
+			for (int z = 0; z < iTiles[2]; z++)
+			{
+				for (int y = 0; y < iTiles[1]; y++)
+				{
+					for (int x = 0; x < iTiles[0]; x++)
+					{
+						int i = (z * iTiles[1] + y) * iTiles[0] + x;
+						bool bMapped = false;
+						for (int k = 0; k < static_cast<int>(arrHistory.size()); k++)
+						{
+							uint8_t iNeeded = arrHistory[arrHistory.size() - 1 - k][i];
+							bMapped |= ((iNeeded & 1) && k <= iDelay) || ((iNeeded & 2) && k <= iDelay + iLatency);
+						}
+						iFailures += occupancy.IsOccupied(x, y, z, 0) != bMapped;
+						iHeld += bMapped && !arrReadback[i];
+
+						//A stretch is a prediction if it starts without the readback, a hit if the readback catches up
+						//before it ends and wasted if it doesn't
+						if (bMapped && !arrWasMapped[i])
+						{
+							arrPredictedStretch[i] = !arrReadback[i];
+							arrStretchHit[i] = 0;
+							expected.iNumPredictedMappings += arrPredictedStretch[i];
+						}
+						else if (bMapped && arrPredictedStretch[i] && arrReadback[i] && !arrStretchHit[i])
+						{
+							arrStretchHit[i] = 1;
+							expected.iNumHits++;
+						}
+						else if (!bMapped && arrWasMapped[i] && arrPredictedStretch[i] && !arrStretchHit[i])
+						{
+							expected.iNumWasted++;
+						}
+						arrWasMapped[i] = bMapped;
+					}
+				}
+			}
+			iFailures += predictor.GetStats().iNumHeld != iHeld;
+			occupancy.Update();
+
+			if (arrHistory.size() > static_cast<size_t>(iDelay + iLatency) + 1)
+			{
+				arrHistory.erase(arrHistory.begin());
+			}
+		}
+
+		const Stats& stats = predictor.GetStats();
+		iFailures += stats.iNumPredictedMappings != expected.iNumPredictedMappings;
+		iFailures += stats.iNumHits != expected.iNumHits;
+		iFailures += stats.iNumWasted != expected.iNumWasted;
+	}
+
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ResidencyPredictor::RunBenchmark(const char* sName, const CPUVoxelVolume& staticVolume, const std::vector<XMFLOAT3>& arrPatrolRoute,
+	float fRadius, float fSpeed, int iReadbackLatency, int iNumFrames)
+{
+	const int iTileSize[3] = { 32, 32, 16 };
+	const float fSpeedMultiples[] = { 1.f, 4.f, 16.f };
+	const int iLookaheads[] = { -1, 0, 1, 2, 4, 8 };	//-1 is no prediction at all
+	const int iDelays[] = { 0, 8, 32 };
+	const int iMaxLookahead = 8;
+
+	int iResolution = staticVolume.GetResolution();
+	if (arrPatrolRoute.size() < 2 || iResolution % iTileSize[0] != 0 || iResolution % iTileSize[2] != 0 || iReadbackLatency < 0)
+	{
+		VS_LOG_VERBOSE("Residency predictor benchmark needs a patrol route and a volume that divides into tiles");
+		return false;
+	}
+
+	std::stringstream ss;
+	ss << "../Results/ResidencyPredictor_" << sName << "_" << iResolution << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open residency predictor benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Speed(voxels a frame), Lookahead, Unmap Delay, Sphere Tile Frames, Lost Tile Frames, Coverage, Frames Losing Voxels, Lost Voxels, "
+		"Mean Lost Voxels(% of occupied), Max Lost Voxels(% of occupied), Predicted Mappings, Hits, Wasted, Hit Rate, Tiles Mapped, Tiles Unmapped, Mean Mapped Tiles, Mean Apply(ms)\n";
+
+	const int iTiles[3] = { iResolution / iTileSize[0], iResolution / iTileSize[1], iResolution / iTileSize[2] };
+	const int iNumTiles = iTiles[0] * iTiles[1] * iTiles[2];
+	std::vector<uint8_t> arrStaticTiles(iNumTiles, 0);
+	long long iStaticVoxels = 0;
+	for (int z = 0; z < iResolution; z++)
+	{
+		for (int y = 0; y < iResolution; y++)
+		{
+			for (int x = 0; x < iResolution; x++)
+			{
+				if (staticVolume.GetVoxel(x, y, z) != 0)
+				{
+					arrStaticTiles[((z / iTileSize[2]) * iTiles[1] + y / iTileSize[1]) * iTiles[0] + x / iTileSize[0]] = 1;
+					iStaticVoxels++;
+				}
+			}
+		}
+	}
+
+	std::stringstream summary;
+	ResidencyPredictor defaults;
+	int iFailures = 0;
+	for (int s = 0; s < sizeof(fSpeedMultiples) / sizeof(fSpeedMultiples[0]); s++)
+	{
+		//Where the sphere is each frame, far enough ahead for the longest lookahead, and the tiles its shell is in
+		float fFrameSpeed = fSpeed * fSpeedMultiples[s];
+		int iNumPositions = iNumFrames + iMaxLookahead + 1;
+		std::vector<XMFLOAT3> arrPositions(iNumPositions);
+		std::vector<std::vector<std::pair<int, int>>> arrShellTiles(iNumPositions);
+		std::vector<int> arrShellVoxels(iNumPositions);
+		XMFLOAT3 vPos = arrPatrolRoute[0];
+		int iPatrolIndex = 0;
+		for (int f = 0; f < iNumPositions; f++)
+		{
+			arrPositions[f] = vPos;
+			GetShellTiles(vPos, fRadius, iResolution, iTileSize, iTiles, arrShellTiles[f], arrShellVoxels[f]);
+			StepPatrol(arrPatrolRoute, fFrameSpeed, vPos, iPatrolIndex);
+		}
+
+		std::vector<long long> arrBaselineLost(iNumFrames, 0);
+		for (int l = 0; l < sizeof(iLookaheads) / sizeof(iLookaheads[0]); l++)
+		{
+			for (int d = 0; d < sizeof(iDelays) / sizeof(iDelays[0]); d++)
+			{
+				int iLookahead = iLookaheads[l];
+				bool bBaseline = iLookahead < 0 && iDelays[d] == 0;
+				ResidencyPredictor predictor;
+				predictor.Initialise(iTiles[0], iTiles[1], iTiles[2], iTileSize[0], iTileSize[1], iTileSize[2]);
+				predictor.SetLookaheadFrames(std::max(iLookahead, 0));
+				predictor.SetUnmapDelayFrames(iDelays[d]);
+				predictor.SetReadbackLatency(iReadbackLatency);
+				TileOccupancyBitset occupancy;
+				occupancy.Initialise(iTiles[0], iTiles[1], iTiles[2], 1);
+
+				//What was really occupied the last few frames, for the readback. It starts out settled with the sphere
+				//sat at the start of its route.
+				std::vector<std::vector<uint8_t>> arrOccupied(iReadbackLatency + 1, arrStaticTiles);
+				for (int r = 0; r <= iReadbackLatency; r++)
+				{
+					for (size_t i = 0; i < arrShellTiles[0].size(); i++)
+					{
+						arrOccupied[r][arrShellTiles[0][i].first] = 1;
+					}
+				}
+				occupancy.LoadMip0(arrOccupied[0].data(), iTiles[0], iTiles[0] * iTiles[1]);
+				occupancy.Update();
+				std::vector<uint8_t> arrMapped(arrOccupied[0]);
+
+				long long iSphereTileFrames = 0, iLostTileFrames = 0, iLostVoxels = 0, iTilesMapped = 0, iTilesUnmapped = 0, iMappedTiles = 0;
+				int iFramesLosing = 0;
+				double dLostPercent = 0.0, dMaxLostPercent = 0.0, dApplyMs = 0.0;
+				for (int f = 0; f < iNumFrames; f++)
+				{
+					//Voxelising this frame into whatever the last update left mapped
+					std::vector<uint8_t>& arrNow = arrOccupied[f % (iReadbackLatency + 1)];
+					arrNow = arrStaticTiles;
+					long long iLostThisFrame = 0;
+					for (size_t i = 0; i < arrShellTiles[f].size(); i++)
+					{
+						int iTile = arrShellTiles[f][i].first;
+						arrNow[iTile] = 1;
+						iSphereTileFrames++;
+						if (!arrMapped[iTile])
+						{
+							iLostTileFrames++;
+							iLostThisFrame += arrShellTiles[f][i].second;
+						}
+					}
+					iLostVoxels += iLostThisFrame;
+					iFramesLosing += iLostThisFrame > 0;
+					double dPercent = 100.0 * iLostThisFrame / (iStaticVoxels + arrShellVoxels[f]);
+					dLostPercent += dPercent;
+					dMaxLostPercent = std::max(dMaxLostPercent, dPercent);
+					if (bBaseline)
+					{
+						arrBaselineLost[f] = iLostThisFrame;
+					}
+					else
+					{
+						//Prediction and the delay only ever add tiles to what the readback maps
+						iFailures += iLostThisFrame > arrBaselineLost[f];
+					}
+
+					//Then the tile update with the readback from iReadbackLatency frames ago
+					occupancy.LoadMip0(arrOccupied[(f + 1) % (iReadbackLatency + 1)].data(), iTiles[0], iTiles[0] * iTiles[1]);
+					std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+					if (iLookahead >= 0)
+					{
+						for (int k = 0; k <= iLookahead; k++)
+						{
+							int vMin[3], vMax[3];
+							const float fCentre[3] = { arrPositions[f + k].x, arrPositions[f + k].y, arrPositions[f + k].z };
+							for (int a = 0; a < 3; a++)
+							{
+								vMin[a] = static_cast<int>(floorf(fCentre[a] - fRadius)) - 1;
+								vMax[a] = static_cast<int>(ceilf(fCentre[a] + fRadius)) + 1;
+							}
+							predictor.AddVoxelBox(vMin, vMax);
+						}
+					}
+					predictor.Apply(occupancy);
+					dApplyMs += GetElapsedMs(start);
+					occupancy.Update();
+					iTilesMapped += occupancy.GetTilesToMap().size();
+					iTilesUnmapped += occupancy.GetTilesToUnmap().size();
+
+					for (int z = 0; z < iTiles[2]; z++)
+					{
+						for (int y = 0; y < iTiles[1]; y++)
+						{
+							for (int x = 0; x < iTiles[0]; x++)
+							{
+								bool bMapped = occupancy.IsOccupied(x, y, z, 0);
+								arrMapped[(z * iTiles[1] + y) * iTiles[0] + x] = bMapped ? 1 : 0;
+								iMappedTiles += bMapped;
+							}
+						}
+					}
+				}
+
+				const Stats& stats = predictor.GetStats();
+				float fCoverage = iSphereTileFrames > 0 ? 1.f - static_cast<float>(iLostTileFrames) / iSphereTileFrames : 1.f;
+				outfile << fFrameSpeed << "," << iLookahead << "," << iDelays[d] << "," << iSphereTileFrames << "," << iLostTileFrames << "," << fCoverage << ","
+					<< iFramesLosing << "," << iLostVoxels << "," << dLostPercent / iNumFrames << "," << dMaxLostPercent << ","
+					<< stats.iNumPredictedMappings << "," << stats.iNumHits << "," << stats.iNumWasted << "," << predictor.GetHitRate() << ","
+					<< iTilesMapped << "," << iTilesUnmapped << "," << static_cast<double>(iMappedTiles) / iNumFrames << "," << dApplyMs / iNumFrames << "\n";
+
+				if (bBaseline)
+				{
+					summary << "\n" << fFrameSpeed << " Voxels A Frame No Prediction Lost Voxels:," << iLostVoxels << ",Coverage:," << fCoverage;
+				}
+				else if (iLookahead == defaults.GetLookaheadFrames() && iDelays[d] == defaults.GetUnmapDelayFrames())
+				{
+					summary << ",Default Lost Voxels:," << iLostVoxels << ",Coverage:," << fCoverage << ",Hit Rate:," << predictor.GetHitRate() << ",Wasted Mappings:," << stats.iNumWasted;
+					VS_LOG(sName << " tile residency at " << fFrameSpeed << " voxels a frame: " << iLostVoxels << " voxels lost to unmapped tiles predicting "
+						<< iLookahead << " frames ahead, " << predictor.GetHitRate() * 100.f << "% of predictions hit, " << stats.iNumWasted << " mappings wasted");
+				}
+			}
+		}
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iFailures == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,105 @@
+#ifndef RESIDENCY_PREDICTOR_H
+#define RESIDENCY_PREDICTOR_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class TileOccupancyBitset;
+class CPUVoxelVolume;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Keeps mip 0 tiles of the tiled volume mapped ahead of the occupation readback, which is a few frames old by the time
+//UpdateTiles sees it. Each frame it's given the voxel boxes the dynamic meshes will cover over the next few frames,
+//and marks the tiles under them occupied on top of what was read back. A tile then stays mapped until it's been
+//neither read back occupied nor predicted for the unmap delay, so tiles a mesh is just passing through aren't unmapped
+//and mapped again straight after. No D3D in here so it can be run and checked on its own.
+class ResidencyPredictor
+{
+public:
+
+	struct Stats
+	{
+		long long iNumPredictedMappings;	//tiles mapped on a prediction before the readback had them occupied
+		long long iNumHits;					//of those, the ones the readback then had occupied while they were mapped
+		long long iNumWasted;				//and the ones unmapped again without ever being occupied
+		int iNumHeld;						//mapped after the last Apply without being read back occupied
+	};
+
+	ResidencyPredictor();
+	~ResidencyPredictor();
+
+	//Mip 0 tile layout, same as TileOccupancyBitset, with the size of a tile in voxels
+	void Initialise(int iTilesX, int iTilesY, int iTilesZ, int iTileWidth, int iTileHeight, int iTileDepth);
+
+	//How many frames ahead the caller should predict the boxes for, see VoxelisedScene::PredictTileResidency
+	void SetLookaheadFrames(int iFrames) { m_iLookaheadFrames = iFrames; }
+	int GetLookaheadFrames() const { return m_iLookaheadFrames; }
+	//Frames a tile stays mapped once nothing needs it, 0 to unmap it as soon as the readback has it empty
+	void SetUnmapDelayFrames(int iFrames) { m_iUnmapDelayFrames = iFrames; }
+	int GetUnmapDelayFrames() const { return m_iUnmapDelayFrames; }
+	//How many frames old the readback is. A predicted tile counts as needed for this long after it was predicted, so
+	//it's still mapped when the readback catches up with a mesh that was only in it for a frame or two.
+	void SetReadbackLatency(int iFrames) { m_iReadbackLatency = iFrames; }
+
+	//Voxels [vMin, vMax), clipped to the volume. Predicted for this frame, forgotten after the next Apply.
+	void AddVoxelBox(const int vMin[3], const int vMax[3]);
+	//After TileOccupancyBitset::LoadMip0 and before its Update, adds the predicted tiles and the ones still inside
+	//their unmap delay to what was read back, and moves on a frame
+	void Apply(TileOccupancyBitset& occupancy);
+	//Nothing mapped or held, for when the tiles have all been unmapped some other way
+	void Clear();
+
+	const Stats& GetStats() const { return m_Stats; }
+	//Of the predicted mappings that have hit or been wasted so far
+	float GetHitRate() const
+	{
+		long long iResolved = m_Stats.iNumHits + m_Stats.iNumWasted;
+		return iResolved > 0 ? static_cast<float>(m_Stats.iNumHits) / iResolved : 0.f;
+	}
+
+	//Random readbacks and boxes against keeping every frame's needed tiles and looking back over the unmap delay,
+	//checking what's mapped and the hit and waste counts. Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//The sphere patrolling through the static scene with the occupation read back iReadbackLatency frames late, with
+	//no prediction and over a range of lookaheads and unmap delays, at a few multiples of fSpeed (voxels a frame).
+	//Reports the voxels the sphere loses to unmapped tiles, the predictions that hit and the mappings wasted.
+	//Writes to ../Results/
+	static bool RunBenchmark(const char* sName, const CPUVoxelVolume& staticVolume, const std::vector<XMFLOAT3>& arrPatrolRoute,
+		float fRadius, float fSpeed, int iReadbackLatency, int iNumFrames);
+
+private:
+
+	enum TileFlags
+	{
+		tfMapped = 1,
+		tfUnconfirmed = 2,		//mapped on a prediction and not read back occupied yet
+		tfPredicted = 4			//inside one of this frame's boxes
+	};
+
+	int GetTileIndex(int x, int y, int z) const { return (z * m_iTiles[1] + y) * m_iTiles[0] + x; }
+
+	int m_iTiles[3];
+	int m_iTileSize[3];
+	int m_iLookaheadFrames;
+	int m_iUnmapDelayFrames;
+	int m_iReadbackLatency;
+	int m_iFrame;
+
+	std::vector<int> m_arrLastNeeded;		//last frame a tile's needed until, from the readback or a prediction
+	std::vector<uint8_t> m_arrFlags;
+
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !RESIDENCY_PREDICTOR_H
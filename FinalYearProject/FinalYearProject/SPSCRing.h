@@ -0,0 +1,83 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Fixed size ring for handing work from exactly one producer thread to exactly one consumer thread without locks.
+//The slots are written and read in place, so a slot holding vectors keeps their memory from one trip round the ring
+//to the next. The producer calls BeginPush, fills the slot and calls EndPush; the consumer calls BeginPop, reads the
+//slot and calls EndPop. Each index is only ever written by one side, with release/acquire making the slot's contents
+//visible to the other.
+template<typename T>
+class SPSCRing
+{
+public:
+
+	SPSCRing() : m_iMask(0), m_iHead(0), m_iTail(0) {}
+
+	//Rounded up to a power of 2. Not thread safe, call before either side starts.
+	void Initialise(int iCapacity)
+	{
+		size_t iSize = 1;
+		while (iSize < static_cast<size_t>(iCapacity))
+		{
+			iSize <<= 1;
+		}
+		m_arrSlots.clear();
+		m_arrSlots.resize(iSize);
+		m_iMask = iSize - 1;
+		m_iHead.store(0, std::memory_order_relaxed);
+		m_iTail.store(0, std::memory_order_relaxed);
+	}
+
+	//Producer. The slot to fill, or nullptr if the ring's full.
+	T* BeginPush()
+	{
+		size_t iHead = m_iHead.load(std::memory_order_relaxed);
+		if (iHead - m_iTail.load(std::memory_order_acquire) > m_iMask)
+		{
+			return nullptr;
+		}
+		return &m_arrSlots[iHead & m_iMask];
+	}
+	void EndPush() { m_iHead.store(m_iHead.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	//Consumer. The oldest slot, or nullptr if the ring's empty.
+	T* BeginPop()
+	{
+		size_t iTail = m_iTail.load(std::memory_order_relaxed);
+		if (m_iHead.load(std::memory_order_acquire) == iTail)
+		{
+			return nullptr;
+		}
+		return &m_arrSlots[iTail & m_iMask];
+	}
+	void EndPop() { m_iTail.store(m_iTail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	//Either side, though it can be out of date by the time it returns
+	bool IsEmpty() const { return m_iHead.load(std::memory_order_acquire) == m_iTail.load(std::memory_order_acquire); }
+	int GetCapacity() const { return static_cast<int>(m_arrSlots.size()); }
+
+private:
+
+	std::vector<T> m_arrSlots;
+	size_t m_iMask;
+
+	//Padded apart, so the two sides aren't fighting over a cache line. Not alignas, as the rings end up inside classes
+	//allocated with new, which doesn't have to honour it.
+	char m_Padding0[64];
+	std::atomic<size_t> m_iHead;
+	char m_Padding1[64];
+	std::atomic<size_t> m_iTail;
+	char m_Padding2[64];
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !SPSC_RING_H
@@ -0,0 +1,669 @@
+#include "SoftwareTiledResourceBackend.h"
+#include "TilePool.h"
+#include "TileResidencyWorker.h"
+#include "CPUVoxeliser.h"
+#include "CPUVoxelVolume.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	const int kTexelsPerTile = TilePool::kTileWidth * TilePool::kTileHeight * TilePool::kTileDepth;
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	template<typename T>
+	void WriteSummaryRow(std::ofstream& outfile, const char* sName, const std::vector<T>& arrValues)
+	{
+		if (arrValues.empty())
+		{
+			return;
+		}
+		double dAverage = 0;
+		for (size_t i = 0; i < arrValues.size(); i++)
+		{
+			dAverage += arrValues[i];
+		}
+		dAverage /= arrValues.size();
+		outfile << sName << "," << dAverage << "," << *std::min_element(arrValues.begin(), arrValues.end()) << "," << *std::max_element(arrValues.begin(), arrValues.end()) << "\n";
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SoftwareTiledResourceBackend::SoftwareTiledResourceBackend()
+	: m_iMipLevels(0),
+	m_iPoolSize(0),
+	m_bKeepPoolBytes(false),
+	m_fLatencyPerCallUs(0.f),
+	m_fLatencyPerTileUs(0.f)
+{
+	ResetStats();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SoftwareTiledResourceBackend::~SoftwareTiledResourceBackend()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, int iInitialPoolSize, bool bKeepPoolBytes)
+{
+	m_iMipLevels = iMipLevels;
+	m_arrMipTiles.resize(iMipLevels * 3);
+	m_arrMipOffsets.resize(iMipLevels + 1);
+	m_arrMipOffsets[0] = 0;
+	for (int m = 0; m < iMipLevels; m++)
+	{
+		m_arrMipTiles[m * 3] = std::max(iTilesX >> m, 1);
+		m_arrMipTiles[m * 3 + 1] = std::max(iTilesY >> m, 1);
+		m_arrMipTiles[m * 3 + 2] = std::max(iTilesZ >> m, 1);
+		m_arrMipOffsets[m + 1] = m_arrMipOffsets[m] + m_arrMipTiles[m * 3] * m_arrMipTiles[m * 3 + 1] * m_arrMipTiles[m * 3 + 2];
+	}
+	m_arrPageTable.assign(m_arrMipOffsets[iMipLevels], -1);
+
+	m_bKeepPoolBytes = bKeepPoolBytes;
+	m_iPoolSize = iInitialPoolSize;
+	m_arrPoolBytes.clear();
+	if (m_bKeepPoolBytes)
+	{
+		m_arrPoolBytes.resize(static_cast<size_t>(m_iPoolSize) * TilePool::kTileSizeInBytes, 0);
+	}
+	ResetStats();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SoftwareTiledResourceBackend::ResetStats()
+{
+	m_Stats = Stats();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::IsValid(const TileCoord& coord) const
+{
+	if (coord.iMipLevel < 0 || coord.iMipLevel >= m_iMipLevels)
+	{
+		return false;
+	}
+	const int* pTiles = &m_arrMipTiles[coord.iMipLevel * 3];
+	return coord.x >= 0 && coord.x < pTiles[0] && coord.y >= 0 && coord.y < pTiles[1] && coord.z >= 0 && coord.z < pTiles[2];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SoftwareTiledResourceBackend::EndCall(const std::chrono::high_resolution_clock::time_point& start, int iNumTiles)
+{
+	float fLatencyUs = m_fLatencyPerCallUs + m_fLatencyPerTileUs * iNumTiles;
+	if (fLatencyUs > 0.f)
+	{
+		std::chrono::high_resolution_clock::time_point end = start + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<float, std::micro>(fLatencyUs));
+		while (std::chrono::high_resolution_clock::now() < end)
+		{
+		}
+	}
+	float fCallUs = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	m_Stats.dCallTimeUs += fCallUs;
+	m_Stats.fMaxCallTimeUs = std::max(m_Stats.fMaxCallTimeUs, fCallUs);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::ResizePool(int iNumTiles)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	m_Stats.iNumResizeCalls++;
+
+	//Tiles left pointing past the end would read and write memory that's gone
+	bool bResult = true;
+	for (size_t i = 0; i < m_arrPageTable.size(); i++)
+	{
+		if (m_arrPageTable[i] >= iNumTiles)
+		{
+			m_Stats.iNumErrors++;
+			bResult = false;
+		}
+	}
+	if (bResult)
+	{
+		m_Stats.iPoolBytesResized += static_cast<long long>(std::abs(iNumTiles - m_iPoolSize)) * TilePool::kTileSizeInBytes;
+		m_iPoolSize = iNumTiles;
+		if (m_bKeepPoolBytes)
+		{
+			m_arrPoolBytes.resize(static_cast<size_t>(m_iPoolSize) * TilePool::kTileSizeInBytes, 0);
+		}
+	}
+	else
+	{
+		VS_LOG_VERBOSE("Tile pool shrunk under a mapped tile");
+	}
+	EndCall(start, 0);
+	return bResult;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::MapTile(const TileCoord& coord, int iPoolOffset)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	m_Stats.iNumMappingCalls++;
+	bool bResult = IsValid(coord) && iPoolOffset >= 0 && iPoolOffset < m_iPoolSize;
+	if (bResult)
+	{
+		m_arrPageTable[GetTileIndex(coord)] = iPoolOffset;
+		m_Stats.iNumTilesMapped++;
+	}
+	else
+	{
+		m_Stats.iNumErrors++;
+	}
+	EndCall(start, 1);
+	return bResult;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::UnmapTile(const TileCoord& coord)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	m_Stats.iNumMappingCalls++;
+	bool bResult = IsValid(coord);
+	if (bResult)
+	{
+		m_arrPageTable[GetTileIndex(coord)] = -1;
+		m_Stats.iNumTilesUnmapped++;
+	}
+	else
+	{
+		m_Stats.iNumErrors++;
+	}
+	EndCall(start, 1);
+	return bResult;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::UpdateTileRanges(const TileRange* pRanges, int iNumRanges, bool bOnlyNewMaps)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	m_Stats.iNumMappingCalls++;
+
+	//Checked before anything's changed, the runtime rejects the whole call
+	int iNumTiles = 0;
+	for (int r = 0; r < iNumRanges; r++)
+	{
+		const TileRange& range = pRanges[r];
+		int iMipTiles = IsValid(range.start) ? m_arrMipOffsets[range.start.iMipLevel + 1] - GetTileIndex(range.start) : 0;
+		if (range.iNumTiles <= 0 || range.iNumTiles > iMipTiles || (range.iPoolOffset >= 0 && range.iPoolOffset + range.iNumTiles > m_iPoolSize))
+		{
+			m_Stats.iNumErrors++;
+			EndCall(start, 0);
+			return false;
+		}
+		iNumTiles += range.iNumTiles;
+	}
+
+	//The runtime can't tell, but a driver would be free to corrupt whatever the GPU's still doing with the tiles
+	for (int r = 0; r < iNumRanges && bOnlyNewMaps; r++)
+	{
+		int iFirst = GetTileIndex(pRanges[r].start);
+		bool bNewMaps = pRanges[r].iPoolOffset >= 0;
+		for (int i = 0; i < pRanges[r].iNumTiles && bNewMaps; i++)
+		{
+			bNewMaps = m_arrPageTable[iFirst + i] < 0;
+		}
+		if (!bNewMaps)
+		{
+			m_Stats.iNumErrors++;
+			break;
+		}
+	}
+
+	for (int r = 0; r < iNumRanges; r++)
+	{
+		const TileRange& range = pRanges[r];
+		int iFirst = GetTileIndex(range.start);
+		for (int i = 0; i < range.iNumTiles; i++)
+		{
+			m_arrPageTable[iFirst + i] = range.iPoolOffset < 0 ? -1 : range.iPoolOffset + i;
+		}
+		if (range.iPoolOffset < 0)
+		{
+			m_Stats.iNumTilesUnmapped += range.iNumTiles;
+		}
+		else
+		{
+			m_Stats.iNumTilesMapped += range.iNumTiles;
+		}
+	}
+	EndCall(start, iNumTiles);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::UnmapAll()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	//A call a mip, like the D3D backend
+	m_Stats.iNumMappingCalls += m_iMipLevels;
+	m_Stats.iNumTilesUnmapped += m_arrPageTable.size();
+	std::fill(m_arrPageTable.begin(), m_arrPageTable.end(), -1);
+	EndCall(start, static_cast<int>(m_arrPageTable.size()));
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::WriteTexel(int x, int y, int z, int iMipLevel, uint32_t iValue)
+{
+	TileCoord coord = { x / TilePool::kTileWidth, y / TilePool::kTileHeight, z / TilePool::kTileDepth, iMipLevel };
+	if (!m_bKeepPoolBytes || x < 0 || y < 0 || z < 0 || !IsValid(coord))
+	{
+		return false;
+	}
+	int iOffset = m_arrPageTable[GetTileIndex(coord)];
+	if (iOffset < 0)
+	{
+		return false;
+	}
+	int iTexel = ((z % TilePool::kTileDepth) * TilePool::kTileHeight + (y % TilePool::kTileHeight)) * TilePool::kTileWidth + (x % TilePool::kTileWidth);
+	memcpy(&m_arrPoolBytes[(static_cast<size_t>(iOffset) * kTexelsPerTile + iTexel) * 4], &iValue, 4);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t SoftwareTiledResourceBackend::ReadTexel(int x, int y, int z, int iMipLevel) const
+{
+	TileCoord coord = { x / TilePool::kTileWidth, y / TilePool::kTileHeight, z / TilePool::kTileDepth, iMipLevel };
+	if (!m_bKeepPoolBytes || x < 0 || y < 0 || z < 0 || !IsValid(coord))
+	{
+		return 0;
+	}
+	int iOffset = m_arrPageTable[GetTileIndex(coord)];
+	if (iOffset < 0)
+	{
+		return 0;
+	}
+	int iTexel = ((z % TilePool::kTileDepth) * TilePool::kTileHeight + (y % TilePool::kTileHeight)) * TilePool::kTileWidth + (x % TilePool::kTileWidth);
+	uint32_t iValue;
+	memcpy(&iValue, &m_arrPoolBytes[(static_cast<size_t>(iOffset) * kTexelsPerTile + iTexel) * 4], 4);
+	return iValue;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int SoftwareTiledResourceBackend::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	for (int iTest = 0; iTest < 6; iTest++)
+	{
+		int iTiles[3] = { 1 + static_cast<int>(rng() % 6), 1 + static_cast<int>(rng() % 4), 1 + static_cast<int>(rng() % 4) };
+		int iMipLevels = 1 + rng() % 3;
+
+		SoftwareTiledResourceBackend backend;
+		backend.Initialise(iTiles[0], iTiles[1], iTiles[2], iMipLevels, 1);
+		TilePool pool;
+		pool.Initialise(&backend, iTiles[0], iTiles[1], iTiles[2], iMipLevels, 1);
+		pool.SetCompactionThreshold(0.5f, 1);
+
+		//What each tile should read back, 0 for nothing known. Compaction loses what was in the moved tiles.
+		std::vector<std::vector<uint32_t>> arrExpected(iMipLevels);
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			arrExpected[m].assign(pool.GetNumTilesX(m) * pool.GetNumTilesY(m) * pool.GetNumTilesZ(m), 0);
+		}
+
+		for (int iStep = 0; iStep < 200; iStep++)
+		{
+			bool bBatch = rng() % 2 == 0;
+			if (bBatch)
+			{
+				pool.BeginBatch();
+			}
+			int iNumOps = 1 + rng() % 8;
+			for (int o = 0; o < iNumOps; o++)
+			{
+				int m = rng() % iMipLevels;
+				int x = rng() % pool.GetNumTilesX(m), y = rng() % pool.GetNumTilesY(m), z = rng() % pool.GetNumTilesZ(m);
+				int iTile = (z * pool.GetNumTilesY(m) + y) * pool.GetNumTilesX(m) + x;
+				if (rng() % 3 != 0)
+				{
+					//A tile that's already mapped keeps its contents
+					if (!pool.IsMapped(x, y, z, m))
+					{
+						arrExpected[m][iTile] = 0;
+					}
+					pool.MapTile(x, y, z, m);
+				}
+				else
+				{
+					pool.UnmapTile(x, y, z, m);
+					arrExpected[m][iTile] = 0;
+				}
+			}
+			if (bBatch)
+			{
+				pool.SubmitBatch();
+			}
+			if (rng() % 10 == 0 && pool.NeedsCompaction())
+			{
+				pool.Compact();
+				for (int m = 0; m < iMipLevels; m++)
+				{
+					std::fill(arrExpected[m].begin(), arrExpected[m].end(), 0u);
+				}
+			}
+
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				for (int z = 0; z < pool.GetNumTilesZ(m); z++)
+				{
+					for (int y = 0; y < pool.GetNumTilesY(m); y++)
+					{
+						for (int x = 0; x < pool.GetNumTilesX(m); x++)
+						{
+							TileCoord coord = { x, y, z, m };
+							int iTile = (z * pool.GetNumTilesY(m) + y) * pool.GetNumTilesX(m) + x;
+							iFailures += backend.GetPoolOffset(coord) != pool.GetPoolOffset(x, y, z, m);
+
+							//A texel of the tile, checked and then written with something new
+							int tx = x * TilePool::kTileWidth + rng() % TilePool::kTileWidth;
+							int ty = y * TilePool::kTileHeight + rng() % TilePool::kTileHeight;
+							int tz = z * TilePool::kTileDepth + rng() % TilePool::kTileDepth;
+							if (arrExpected[m][iTile] != 0)
+							{
+								//The whole tile was filled with it
+								iFailures += backend.ReadTexel(tx, ty, tz, m) != arrExpected[m][iTile];
+							}
+							else if (!pool.IsMapped(x, y, z, m))
+							{
+								iFailures += backend.ReadTexel(tx, ty, tz, m) != 0;
+							}
+							if (pool.IsMapped(x, y, z, m) && rng() % 4 == 0)
+							{
+								uint32_t iValue = 1 + rng() % 0xfffffffe;
+								for (int i = 0; i < kTexelsPerTile; i += 97)
+								{
+									int lx = i % TilePool::kTileWidth, ly = (i / TilePool::kTileWidth) % TilePool::kTileHeight, lz = i / (TilePool::kTileWidth * TilePool::kTileHeight);
+									backend.WriteTexel(x * TilePool::kTileWidth + lx, y * TilePool::kTileHeight + ly, z * TilePool::kTileDepth + lz, m, iValue);
+								}
+								//Only the texels written are known, so check one of them next time
+								arrExpected[m][iTile] = 0;
+								iFailures += backend.ReadTexel(x * TilePool::kTileWidth, y * TilePool::kTileHeight, z * TilePool::kTileDepth, m) != iValue;
+							}
+						}
+					}
+				}
+			}
+		}
+		iFailures += backend.GetStats().iNumErrors != 0;
+		iFailures += backend.GetPoolSize() != pool.GetStats().iPoolSizeInTiles;
+
+		//Writes to an unmapped tile go nowhere
+		pool.UnmapAll();
+		iFailures += backend.WriteTexel(0, 0, 0, 0, 1);
+		iFailures += backend.ReadTexel(0, 0, 0, 0) != 0;
+	}
+
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SoftwareTiledResourceBackend::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolutions[] = { 256, 512 };
+	const int iMipLevels = 4;				//as MIP_LEVELS
+	const int iOccupationFrames = 5;		//as OCCUPATION_FRAMES
+	const int iBudgetTiles = 256;			//as TILE_MAPPING_BUDGET_TILES
+	const float fBudgetUs = 1000.f;			//and TILE_MAPPING_BUDGET_US
+	const int iNumFrames = 300;
+	//What a driver might take, a guess until there's a GPU to measure
+	const float fLatencyPerCallUs = 20.f;
+	const float fLatencyPerTileUs = 0.5f;
+	//What the rest of the frame takes between tile updates, for the worker to get on in
+	const std::chrono::microseconds frameWork(1000);
+
+	int iFailures = 0;
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolution, 1))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&volume);
+
+		int iTilesX = iResolution / TilePool::kTileWidth, iTilesY = iResolution / TilePool::kTileHeight, iTilesZ = iResolution / TilePool::kTileDepth;
+		std::vector<uint8_t> arrStatic(static_cast<size_t>(iTilesX) * iTilesY * iTilesZ, 0);
+		for (int z = 0; z < iResolution; z++)
+		{
+			for (int y = 0; y < iResolution; y++)
+			{
+				for (int x = 0; x < iResolution; x++)
+				{
+					if (volume.GetVoxel(x, y, z) != 0)
+					{
+						arrStatic[((z / TilePool::kTileDepth) * iTilesY + (y / TilePool::kTileHeight)) * iTilesX + (x / TilePool::kTileWidth)] = 1;
+					}
+				}
+			}
+		}
+
+		//Just the page table, the pool's contents don't matter here and would be hundreds of MB at 512^3
+		SoftwareTiledResourceBackend backend;
+		backend.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels, 1, false);
+		backend.SetSimulatedLatency(fLatencyPerCallUs, fLatencyPerTileUs);
+		TilePool pool;
+		pool.Initialise(&backend, iTilesX, iTilesY, iTilesZ, iMipLevels, 1);
+		OccupancyReadbackRing readback;
+		readback.Initialise(iTilesX, iTilesY, iTilesZ, iOccupationFrames);
+		TileResidencyWorker worker;
+		worker.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels, TilePool::kTileWidth, TilePool::kTileHeight, TilePool::kTileDepth, iOccupationFrames - 1, true, true);
+		worker.SetBudget(iBudgetTiles, fBudgetUs);
+		worker.SetFocus(XMFLOAT3(iResolution * 0.5f, iResolution * 0.5f, iResolution * 0.5f));
+
+		std::vector<float> arrTileUpdateMs, arrTilesPerCall, arrResidencyLatency;
+		std::vector<int> arrMappingCalls, arrBacklog;
+		TileMappingScheduler::LatencyHistogram latency;
+		std::vector<uint8_t> arrData;
+		long long iTotalCalls = 0, iTotalTiles = 0;
+		for (int f = 0; f < iNumFrames; f++)
+		{
+			//A box a quarter of the volume across sweeping along x, a tile a frame
+			int iBoxTiles = iTilesX / 4;
+			int iSweep = iTilesX - iBoxTiles;
+			auto getBoxX = [&](int iFrame) { return iFrame % (2 * iSweep) < iSweep ? iFrame % (2 * iSweep) : 2 * iSweep - iFrame % (2 * iSweep); };
+			int iBoxX = getBoxX(f);
+			arrData = arrStatic;
+			for (int z = iTilesZ / 4; z < iTilesZ / 4 + iBoxTiles * 2; z++)
+			{
+				for (int y = iTilesY / 4; y < iTilesY / 4 + iBoxTiles; y++)
+				{
+					memset(&arrData[(static_cast<size_t>(z) * iTilesY + y) * iTilesX + iBoxX], 1, iBoxTiles);
+				}
+			}
+
+			//Same order as the renderer: compact, voxelise (here the copy into the readback ring), predict and update
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			pool.CompactIfFragmented();
+			readback.Copy(arrData.data(), iTilesX, iTilesX * iTilesY);
+			for (int k = 0; k <= worker.GetLookaheadFrames(); k++)
+			{
+				int iPredictedX = getBoxX(f + k);
+				const int vMin[3] = { iPredictedX * TilePool::kTileWidth, iTilesY / 4 * TilePool::kTileHeight, iTilesZ / 4 * TilePool::kTileDepth };
+				const int vMax[3] = { vMin[0] + iBoxTiles * TilePool::kTileWidth, vMin[1] + iBoxTiles * TilePool::kTileHeight, vMin[2] + iBoxTiles * 2 * TilePool::kTileDepth };
+				worker.AddPredictedBox(vMin, vMax);
+			}
+			int iRowPitch, iDepthPitch;
+			const uint8_t* pOldest = readback.MapOldest(iRowPitch, iDepthPitch);
+			worker.SubmitOccupancy(pOldest, iRowPitch, iDepthPitch);
+			int iCalls = 0, iTiles = 0;
+			worker.ApplyPlans([&](const TileResidencyWorker::Plan& plan)
+			{
+				pool.BeginBatch();
+				for (size_t i = 0; i < plan.arrTilesToUnmap.size(); i++)
+				{
+					const TileCoord& coord = plan.arrTilesToUnmap[i];
+					pool.UnmapTile(coord.x, coord.y, coord.z, coord.iMipLevel);
+				}
+				for (size_t i = 0; i < plan.arrTilesToMap.size(); i++)
+				{
+					const TileCoord& coord = plan.arrTilesToMap[i];
+					pool.MapTile(coord.x, coord.y, coord.z, coord.iMipLevel);
+				}
+				pool.SubmitBatch();
+				iCalls += static_cast<int>(pool.GetLastBatchStats().iNumCalls);
+				iTiles += static_cast<int>(pool.GetLastBatchStats().iNumTiles);
+				latency.Add(plan.schedule.latency);
+			});
+			arrTileUpdateMs.push_back(static_cast<float>(GetElapsedMs(start)));
+			arrMappingCalls.push_back(iCalls);
+			iTotalCalls += iCalls;
+			iTotalTiles += iTiles;
+			arrBacklog.push_back(worker.GetScheduleStats().iNumPending);
+			arrResidencyLatency.push_back(worker.GetLatencyStats().fLastMs);
+
+			std::this_thread::sleep_for(frameWork);
+		}
+
+		//Whatever the pool thinks is mapped, the backend has to have mapped
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			for (int z = 0; z < pool.GetNumTilesZ(m); z++)
+			{
+				for (int y = 0; y < pool.GetNumTilesY(m); y++)
+				{
+					for (int x = 0; x < pool.GetNumTilesX(m); x++)
+					{
+						TileCoord coord = { x, y, z, m };
+						iFailures += backend.GetPoolOffset(coord) != pool.GetPoolOffset(x, y, z, m);
+					}
+				}
+			}
+		}
+		iFailures += backend.GetStats().iNumErrors != 0;
+
+		//The same layout as GPUProfiler::OutputStoredTimesToFile
+		std::stringstream ss;
+		ss << "../Results/Software_0MB_VolumeTiledResources_" << iResolution << ".csv";
+		std::ofstream outfile;
+		outfile.open(ss.str().c_str());
+		if (!outfile.is_open())
+		{
+			VS_LOG_VERBOSE("Failed to open software tiled resources benchmark output file");
+			return false;
+		}
+		const SoftwareTiledResourceBackend::Stats& backendStats = backend.GetStats();
+		outfile << std::fixed << "Profiled Section, Average, Minimum, Maximum\n";
+		WriteSummaryRow(outfile, "CPU Tile Update Time", arrTileUpdateMs);
+		WriteSummaryRow(outfile, "Tile Mapping Calls", arrMappingCalls);
+		outfile << "Tiles Per Mapping Call," << (iTotalCalls > 0 ? static_cast<double>(iTotalTiles) / iTotalCalls : 0.0) << "\n";
+		WriteSummaryRow(outfile, "Tile Mapping Backlog", arrBacklog);
+		WriteSummaryRow(outfile, "Tile Residency Latency(ms)", arrResidencyLatency);
+		outfile << "Backend API Calls," << backendStats.iNumMappingCalls + backendStats.iNumResizeCalls << "\n";
+		outfile << "Backend Call Time(us)," << (backendStats.iNumMappingCalls + backendStats.iNumResizeCalls > 0 ? backendStats.dCallTimeUs / (backendStats.iNumMappingCalls + backendStats.iNumResizeCalls) : 0.0)
+			<< "\n";
+		outfile << "Backend Max Call Time(us)," << backendStats.fMaxCallTimeUs << "\n";
+		outfile << "Pool Bytes Resized," << backendStats.iPoolBytesResized << "\n";
+		outfile << "Occupancy Bytes Read Back," << readback.GetBytesCopied() << "\n";
+		outfile << "\nMemory Usage(MB):," << pool.GetMemoryUsageInBytes() / (1024 * 1024);
+
+		outfile << "\n\nTile Mapping Latency(frames)";
+		for (int i = 0; i < TileMappingScheduler::LatencyHistogram::kNumBuckets; i++)
+		{
+			outfile << "," << TileMappingScheduler::LatencyHistogram::GetBucketName(i);
+		}
+		outfile << "\n";
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			outfile << "Mip " << m;
+			for (int i = 0; i < TileMappingScheduler::LatencyHistogram::kNumBuckets; i++)
+			{
+				outfile << "," << latency.arrCounts[m][i];
+			}
+			outfile << "\n";
+		}
+		int iValidationFailures = Validate(1);
+		outfile << "\nValidation Failures:," << iValidationFailures;
+		iFailures += iValidationFailures;
+		outfile.close();
+
+		VS_LOG(sName << " software tiled resources " << iResolution << "^3: " << pool.GetStats().iNumMapped << " tiles mapped, " << backendStats.iNumMappingCalls
+			<< " mapping calls");
+	}
+
+	return iFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+OccupancyReadbackRing::OccupancyReadbackRing()
+	: m_iRowPitch(0),
+	m_iDepthPitch(0),
+	m_iCurrent(0),
+	m_iBytesCopied(0)
+{
+	m_iTiles[0] = m_iTiles[1] = m_iTiles[2] = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OccupancyReadbackRing::Initialise(int iTilesX, int iTilesY, int iTilesZ, int iNumFrames)
+{
+	m_iTiles[0] = iTilesX;
+	m_iTiles[1] = iTilesY;
+	m_iTiles[2] = iTilesZ;
+	//Mapped textures' rows are padded out, so the readers have to cope
+	m_iRowPitch = (iTilesX + 255) & ~255;
+	m_iDepthPitch = m_iRowPitch * iTilesY;
+	m_arrSlots.assign(iNumFrames, std::vector<uint8_t>(static_cast<size_t>(m_iDepthPitch) * iTilesZ, 0));
+	m_iCurrent = 0;
+	m_iBytesCopied = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OccupancyReadbackRing::Copy(const uint8_t* pData, int iRowPitch, int iDepthPitch)
+{
+	m_iCurrent = (m_iCurrent + 1) % static_cast<int>(m_arrSlots.size());
+	uint8_t* pSlot = m_arrSlots[m_iCurrent].data();
+	for (int z = 0; z < m_iTiles[2]; z++)
+	{
+		for (int y = 0; y < m_iTiles[1]; y++)
+		{
+			memcpy(pSlot + static_cast<size_t>(z) * m_iDepthPitch + static_cast<size_t>(y) * m_iRowPitch, pData + static_cast<size_t>(z) * iDepthPitch + static_cast<size_t>(y) * iRowPitch, m_iTiles[0]);
+		}
+	}
+	m_iBytesCopied += static_cast<long long>(m_iTiles[0]) * m_iTiles[1] * m_iTiles[2];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint8_t* OccupancyReadbackRing::MapOldest(int& iRowPitch, int& iDepthPitch) const
+{
+	iRowPitch = m_iRowPitch;
+	iDepthPitch = m_iDepthPitch;
+	return m_arrSlots[(m_iCurrent + 1) % m_arrSlots.size()].data();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
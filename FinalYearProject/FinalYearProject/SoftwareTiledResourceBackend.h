@@ -0,0 +1,129 @@
+#ifndef SOFTWARE_TILED_RESOURCE_BACKEND_H
+#define SOFTWARE_TILED_RESOURCE_BACKEND_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include "TiledResourceBackend.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Tiled resources in host memory, for running TilePool and the residency code without a GPU. Keeps a page table a mip
+//and the pool's bytes the way the runtime would: several tiles may point at the same pool tile, writes to unmapped
+//tiles go nowhere and reads from them return 0. Every call is counted and timed, and can be made to cost what a
+//driver would with SetSimulatedLatency.
+class SoftwareTiledResourceBackend : public TiledResourceBackend
+{
+public:
+
+	struct Stats
+	{
+		long long iNumResizeCalls;
+		long long iNumMappingCalls;		//MapTile, UnmapTile, UpdateTileRanges and UnmapAll
+		long long iNumTilesMapped;
+		long long iNumTilesUnmapped;
+		long long iPoolBytesResized;	//grown or shrunk by
+		long long iNumErrors;			//out of range, shrinking under a mapped tile, or no overwrite on an unmap or move
+		double dCallTimeUs;				//in mapping and resize calls, simulated latency included
+		float fMaxCallTimeUs;
+	};
+
+	SoftwareTiledResourceBackend();
+	~SoftwareTiledResourceBackend();
+
+	//Same tile layout as TilePool. Without bKeepPoolBytes there's only the page table, for big volumes where the pool
+	//contents don't matter.
+	bool Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, int iInitialPoolSize, bool bKeepPoolBytes = true);
+
+	//Spun for on top of the work each call does, 0 for none
+	void SetSimulatedLatency(float fMicrosecondsPerCall, float fMicrosecondsPerTile) { m_fLatencyPerCallUs = fMicrosecondsPerCall; m_fLatencyPerTileUs = fMicrosecondsPerTile; }
+
+	bool ResizePool(int iNumTiles) override;
+	bool MapTile(const TileCoord& coord, int iPoolOffset) override;
+	bool UnmapTile(const TileCoord& coord) override;
+	bool UpdateTileRanges(const TileRange* pRanges, int iNumRanges, bool bOnlyNewMaps) override;
+	bool UnmapAll() override;
+
+	//-1 when it isn't mapped
+	int GetPoolOffset(const TileCoord& coord) const { return m_arrPageTable[GetTileIndex(coord)]; }
+	int GetPoolSize() const { return m_iPoolSize; }
+	//A texel of the volume, RGBA8 like the radiance volume, through the page table
+	bool WriteTexel(int x, int y, int z, int iMipLevel, uint32_t iValue);
+	uint32_t ReadTexel(int x, int y, int z, int iMipLevel) const;
+
+	const Stats& GetStats() const { return m_Stats; }
+	void ResetStats();
+
+	//Random maps, unmaps, batches and compactions through a TilePool, checking the page table against the pool's
+	//offsets and that texels written to mapped tiles read back until the tile's unmapped. Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//The whole tiled update without a GPU: the voxeliser's occupancy with a box moving through it goes through an
+	//OccupancyReadbackRing, TileResidencyWorker and a TilePool on this backend, at 256^3 and 512^3. Writes the same
+	//rows GPUProfiler does for the tiled volume, where there's something to fill them, plus the backend's counts, to
+	//../Results/Software_0MB_VolumeTiledResources_<resolution>.csv
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	int GetTileIndex(const TileCoord& coord) const
+	{
+		const int* pTiles = &m_arrMipTiles[coord.iMipLevel * 3];
+		return m_arrMipOffsets[coord.iMipLevel] + (coord.z * pTiles[1] + coord.y) * pTiles[0] + coord.x;
+	}
+	bool IsValid(const TileCoord& coord) const;
+	//Spins out the simulated latency and records the call
+	void EndCall(const std::chrono::high_resolution_clock::time_point& start, int iNumTiles);
+
+	int m_iMipLevels;
+	std::vector<int> m_arrMipTiles;		//x, y and z tile counts a mip
+	std::vector<int> m_arrMipOffsets;	//first tile index of each mip
+	std::vector<int> m_arrPageTable;	//pool offset of each tile, -1 for unmapped
+	int m_iPoolSize;
+	bool m_bKeepPoolBytes;
+	std::vector<uint8_t> m_arrPoolBytes;
+
+	float m_fLatencyPerCallUs;
+	float m_fLatencyPerTileUs;
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//The occupation staging textures VoxelisedScene copies the tile occupation into each frame and maps iNumFrames - 1
+//frames later, in host memory. Rows are padded like a mapped texture's.
+class OccupancyReadbackRing
+{
+public:
+
+	OccupancyReadbackRing();
+
+	void Initialise(int iTilesX, int iTilesY, int iTilesZ, int iNumFrames);
+
+	//CopyResource into this frame's slot, and moving on a frame
+	void Copy(const uint8_t* pData, int iRowPitch, int iDepthPitch);
+	//Map of the oldest slot, iNumFrames - 1 frames behind the last Copy
+	const uint8_t* MapOldest(int& iRowPitch, int& iDepthPitch) const;
+
+	long long GetBytesCopied() const { return m_iBytesCopied; }
+	int GetNumFrames() const { return static_cast<int>(m_arrSlots.size()); }
+
+private:
+
+	int m_iTiles[3];
+	int m_iRowPitch;
+	int m_iDepthPitch;
+	int m_iCurrent;
+	std::vector<std::vector<uint8_t>> m_arrSlots;
+	long long m_iBytesCopied;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !SOFTWARE_TILED_RESOURCE_BACKEND_H
@@ -0,0 +1,578 @@
+#include "SparseVoxelOctree.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Which of the 8 children (x, y, z) falls in, bit iBit of the coordinates picks the half on each axis
+	inline uint32_t GetOctant(uint32_t x, uint32_t y, uint32_t z, int iBit)
+	{
+		return ((x >> iBit) & 1) | (((y >> iBit) & 1) << 1) | (((z >> iBit) & 1) << 2);
+	}
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Splits [0, iCount) into roughly even chunks for Parallel::For
+	struct ChunkRange
+	{
+		int iNumChunks;
+		int iChunkSize;
+
+		ChunkRange(int iCount, int iNumThreads)
+		{
+			iNumChunks = std::max(1, std::min(iNumThreads * 8, (iCount + 1023) / 1024));
+			iChunkSize = (iCount + iNumChunks - 1) / iNumChunks;
+		}
+		int Begin(int iChunk) const { return iChunk * iChunkSize; }
+		int End(int iChunk, int iCount) const { return std::min((iChunk + 1) * iChunkSize, iCount); }
+	};
+
+	//Scattered voxels at roughly fDensity, plus a few solid blocks so some nodes are full and some mips aren't rounded
+	//down to nothing. The colours are random, low alphas included, to catch rounding in the filter.
+	void FillSparseVolume(CPUVoxelVolume& volume, float fDensity, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		int iRes = volume.GetResolution();
+		volume.Clear();
+		int iNumVoxels = static_cast<int>(fDensity * iRes * iRes * iRes);
+		for (int i = 0; i < iNumVoxels; i++)
+		{
+			volume.SetVoxel(rng() % iRes, rng() % iRes, rng() % iRes, rng() | 1);
+		}
+		for (int b = 0; b < 3 && fDensity > 0.f; b++)
+		{
+			int iSize = 1 + rng() % std::max(1, iRes / 4);
+			int iMin[3] = { static_cast<int>(rng() % iRes), static_cast<int>(rng() % iRes), static_cast<int>(rng() % iRes) };
+			uint32_t iColour = rng() | 0xff000000;
+			for (int z = iMin[2]; z < std::min(iMin[2] + iSize, iRes); z++)
+			{
+				for (int y = iMin[1]; y < std::min(iMin[1] + iSize, iRes); y++)
+				{
+					for (int x = iMin[0]; x < std::min(iMin[0] + iSize, iRes); x++)
+					{
+						volume.SetVoxel(x, y, z, iColour);
+					}
+				}
+			}
+		}
+		volume.GenerateMips();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SparseVoxelOctree::SparseVoxelOctree()
+	: m_iResolution(0)
+	, m_iNumLevels(0)
+	, m_iNumThreads(0)
+{
+	memset(&m_BuildStats, 0, sizeof(BuildStats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SparseVoxelOctree::~SparseVoxelOctree()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SparseVoxelOctree::Initialise(int iResolution, int iNumThreads)
+{
+	if (iResolution < 2 || (iResolution & (iResolution - 1)) != 0)
+	{
+		VS_LOG_VERBOSE("Sparse voxel octree resolution has to be a power of 2");
+		return false;
+	}
+
+	m_iResolution = iResolution;
+	m_iNumThreads = iNumThreads > 0 ? iNumThreads : Parallel::GetNumWorkerThreads();
+	m_iNumLevels = 0;
+	while ((1 << m_iNumLevels) < iResolution)
+	{
+		m_iNumLevels++;
+	}
+
+	Clear();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SparseVoxelOctree::Shutdown()
+{
+	m_arrNodes.clear();
+	m_arrNodes.shrink_to_fit();
+	m_arrBricks.clear();
+	m_arrBricks.shrink_to_fit();
+	m_arrLevelStart.clear();
+	m_arrLevelCount.clear();
+	m_arrLevelBricks.clear();
+	m_iResolution = 0;
+	m_iNumLevels = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SparseVoxelOctree::Clear()
+{
+	//Just the root, which covers the whole volume
+	Node root = { kNull, kNull };
+	m_arrNodes.assign(1, root);
+	m_arrBricks.clear();
+	m_arrLevelStart.assign(m_iNumLevels, 0);
+	m_arrLevelCount.assign(m_iNumLevels, 0);
+	m_arrLevelBricks.assign(m_iNumLevels, 0);
+	if (m_iNumLevels > 0)
+	{
+		m_arrLevelCount[0] = 1;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SparseVoxelOctree::Build(const std::vector<VoxelFragment>& arrFragments)
+{
+	if (m_iNumLevels == 0)
+	{
+		VS_LOG_VERBOSE("Sparse voxel octree needs initialising before it can be built");
+		return false;
+	}
+
+	Clear();
+	int iNumFragments = static_cast<int>(arrFragments.size());
+	m_BuildStats.iNumFragments = iNumFragments;
+
+	//The node each fragment is in at the level being built, so each level only has to step down once
+	std::vector<uint32_t> arrFragmentNodes(iNumFragments, 0);
+	ChunkRange fragmentChunks(iNumFragments, m_iNumThreads);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int iLevel = 0; iLevel < m_iNumLevels; iLevel++)
+	{
+		uint32_t iLevelStart = m_arrLevelStart[iLevel];
+		int iLevelCount = static_cast<int>(m_arrLevelCount[iLevel]);
+
+		//Flag every node a fragment lands in
+		std::vector<std::atomic<uint8_t>> arrFlags(iLevelCount);
+		Parallel::For(fragmentChunks.iNumChunks, m_iNumThreads, [&](int iChunk, int iThread)
+		{
+			for (int f = fragmentChunks.Begin(iChunk); f < fragmentChunks.End(iChunk, iNumFragments); f++)
+			{
+				if (iLevel > 0)
+				{
+					const VoxelFragment& fragment = arrFragments[f];
+					uint32_t iOctant = GetOctant(fragment.x, fragment.y, fragment.z, m_iNumLevels - iLevel);
+					arrFragmentNodes[f] = m_arrNodes[arrFragmentNodes[f]].iChildTile + iOctant;
+				}
+				arrFlags[arrFragmentNodes[f] - iLevelStart].store(1, std::memory_order_relaxed);
+			}
+		});
+
+		//Subdivide - count the flagged nodes per chunk, prefix sum the counts, then hand out bricks and child tiles in
+		//node order so the pools come out the same whatever the thread count
+		ChunkRange nodeChunks(iLevelCount, m_iNumThreads);
+		std::vector<uint32_t> arrChunkOffsets(nodeChunks.iNumChunks + 1, 0);
+		Parallel::For(nodeChunks.iNumChunks, m_iNumThreads, [&](int iChunk, int iThread)
+		{
+			uint32_t iCount = 0;
+			for (int n = nodeChunks.Begin(iChunk); n < nodeChunks.End(iChunk, iLevelCount); n++)
+			{
+				iCount += arrFlags[n].load(std::memory_order_relaxed);
+			}
+			arrChunkOffsets[iChunk + 1] = iCount;
+		});
+		for (int c = 0; c < nodeChunks.iNumChunks; c++)
+		{
+			arrChunkOffsets[c + 1] += arrChunkOffsets[c];
+		}
+		uint32_t iNumFlagged = arrChunkOffsets[nodeChunks.iNumChunks];
+
+		bool bLeafLevel = iLevel == m_iNumLevels - 1;
+		uint32_t iBrickStart = static_cast<uint32_t>(m_arrBricks.size() / kBrickVoxels);
+		uint32_t iChildLevelStart = static_cast<uint32_t>(m_arrNodes.size());
+		m_arrBricks.resize(m_arrBricks.size() + iNumFlagged * kBrickVoxels, 0);
+		m_arrLevelBricks[iLevel] = iNumFlagged;
+		if (!bLeafLevel)
+		{
+			Node empty = { kNull, kNull };
+			m_arrNodes.resize(m_arrNodes.size() + iNumFlagged * 8, empty);
+			m_arrLevelStart[iLevel + 1] = iChildLevelStart;
+			m_arrLevelCount[iLevel + 1] = iNumFlagged * 8;
+		}
+
+		Parallel::For(nodeChunks.iNumChunks, m_iNumThreads, [&](int iChunk, int iThread)
+		{
+			uint32_t iRank = arrChunkOffsets[iChunk];
+			for (int n = nodeChunks.Begin(iChunk); n < nodeChunks.End(iChunk, iLevelCount); n++)
+			{
+				if (arrFlags[n].load(std::memory_order_relaxed))
+				{
+					Node& node = m_arrNodes[iLevelStart + n];
+					node.iBrick = iBrickStart + iRank;
+					if (!bLeafLevel)
+					{
+						node.iChildTile = iChildLevelStart + iRank * 8;
+					}
+					iRank++;
+				}
+			}
+		});
+	}
+	m_BuildStats.dSubdivideTimeMs = GetElapsedMs(start);
+
+	//Fragments into the leaf bricks, one voxel each so there is nothing to fight over
+	start = std::chrono::high_resolution_clock::now();
+	Parallel::For(fragmentChunks.iNumChunks, m_iNumThreads, [&](int iChunk, int iThread)
+	{
+		for (int f = fragmentChunks.Begin(iChunk); f < fragmentChunks.End(iChunk, iNumFragments); f++)
+		{
+			const VoxelFragment& fragment = arrFragments[f];
+			uint32_t iBrick = m_arrNodes[arrFragmentNodes[f]].iBrick;
+			m_arrBricks[iBrick * kBrickVoxels + GetOctant(fragment.x, fragment.y, fragment.z, 0)] = fragment.iColour;
+		}
+	});
+	m_BuildStats.dLeafTimeMs = GetElapsedMs(start);
+
+	//Filter up the tree a level at a time, every node in a level is independent
+	start = std::chrono::high_resolution_clock::now();
+	for (int iLevel = m_iNumLevels - 2; iLevel >= 0; iLevel--)
+	{
+		uint32_t iLevelStart = m_arrLevelStart[iLevel];
+		int iLevelCount = static_cast<int>(m_arrLevelCount[iLevel]);
+		ChunkRange nodeChunks(iLevelCount, m_iNumThreads);
+		Parallel::For(nodeChunks.iNumChunks, m_iNumThreads, [&](int iChunk, int iThread)
+		{
+			for (int n = nodeChunks.Begin(iChunk); n < nodeChunks.End(iChunk, iLevelCount); n++)
+			{
+				FilterBrick(iLevelStart + n);
+			}
+		});
+	}
+	m_BuildStats.dMipTimeMs = GetElapsedMs(start);
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SparseVoxelOctree::FilterBrick(uint32_t iNode)
+{
+	const Node& node = m_arrNodes[iNode];
+	if (node.iBrick == kNull)
+	{
+		return;
+	}
+
+	//Each octant is the 2x2x2 average of the child's brick, empty children count as zero - the same box filter as
+	//CPUVoxelVolume::GenerateMips, so the bricks match the dense mips exactly
+	uint32_t* pBrick = &m_arrBricks[node.iBrick * kBrickVoxels];
+	for (int iOctant = 0; iOctant < 8; iOctant++)
+	{
+		const Node& child = m_arrNodes[node.iChildTile + iOctant];
+		if (child.iBrick == kNull)
+		{
+			pBrick[iOctant] = 0;
+			continue;
+		}
+		const uint32_t* pChildBrick = &m_arrBricks[child.iBrick * kBrickVoxels];
+		uint32_t iSum[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < kBrickVoxels; i++)
+		{
+			iSum[0] += pChildBrick[i] & 0xff;
+			iSum[1] += (pChildBrick[i] >> 8) & 0xff;
+			iSum[2] += (pChildBrick[i] >> 16) & 0xff;
+			iSum[3] += (pChildBrick[i] >> 24) & 0xff;
+		}
+		pBrick[iOctant] = ((iSum[0] + 4) / 8) | (((iSum[1] + 4) / 8) << 8) | (((iSum[2] + 4) / 8) << 16) | (((iSum[3] + 4) / 8) << 24);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t SparseVoxelOctree::LookupLevel(int x, int y, int z, int iMipLevel) const
+{
+	if (iMipLevel < 0 || iMipLevel >= m_iNumLevels)
+	{
+		return 0;
+	}
+	int iMipRes = m_iResolution >> iMipLevel;
+	if (x < 0 || y < 0 || z < 0 || x >= iMipRes || y >= iMipRes || z >= iMipRes)
+	{
+		return 0;
+	}
+
+	//Walk down to the node whose brick holds this mip
+	int iLevel = m_iNumLevels - 1 - iMipLevel;
+	uint32_t iNode = 0;
+	for (int l = 0; l < iLevel; l++)
+	{
+		uint32_t iChildTile = m_arrNodes[iNode].iChildTile;
+		if (iChildTile == kNull)
+		{
+			return 0;
+		}
+		iNode = iChildTile + GetOctant(x, y, z, iLevel - l);
+	}
+
+	uint32_t iBrick = m_arrNodes[iNode].iBrick;
+	if (iBrick == kNull)
+	{
+		return 0;
+	}
+	return m_arrBricks[iBrick * kBrickVoxels + GetOctant(x, y, z, 0)];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMFLOAT4 SparseVoxelOctree::SampleLevel(const XMFLOAT3& vUVW, float fMipLevel) const
+{
+	fMipLevel = std::max(0.f, std::min(fMipLevel, static_cast<float>(m_iNumLevels - 1)));
+	int iLowerMip = static_cast<int>(fMipLevel);
+	int iUpperMip = std::min(iLowerMip + 1, m_iNumLevels - 1);
+	float fBlend = fMipLevel - iLowerMip;
+
+	XMFLOAT4 vLower = SampleTrilinear([&](int x, int y, int z) { return LookupLevel(x, y, z, iLowerMip); }, m_iResolution >> iLowerMip, vUVW);
+	if (fBlend <= 0.f || iUpperMip == iLowerMip)
+	{
+		return vLower;
+	}
+	XMFLOAT4 vUpper = SampleTrilinear([&](int x, int y, int z) { return LookupLevel(x, y, z, iUpperMip); }, m_iResolution >> iUpperMip, vUVW);
+	return XMFLOAT4(vLower.x + (vUpper.x - vLower.x) * fBlend, vLower.y + (vUpper.y - vLower.y) * fBlend,
+					vLower.z + (vUpper.z - vLower.z) * fBlend, vLower.w + (vUpper.w - vLower.w) * fBlend);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SparseVoxelOctree::LevelStats SparseVoxelOctree::GetLevelStats(int iLevel) const
+{
+	LevelStats stats;
+	stats.iResolution = 2 << iLevel;
+	stats.iNumNodes = static_cast<int>(m_arrLevelCount[iLevel]);
+	stats.iNumBricks = static_cast<int>(m_arrLevelBricks[iLevel]);
+	stats.iNodeBytes = stats.iNumNodes * sizeof(Node);
+	stats.iBrickBytes = stats.iNumBricks * kBrickVoxels * sizeof(uint32_t);
+	stats.iDenseBytes = static_cast<size_t>(stats.iResolution) * stats.iResolution * stats.iResolution * sizeof(uint32_t);
+	return stats;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t SparseVoxelOctree::GetMemoryUsageInBytes() const
+{
+	return m_arrNodes.size() * sizeof(Node) + m_arrBricks.size() * sizeof(uint32_t);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long SparseVoxelOctree::CompareWithDense(const CPUVoxelVolume& volume) const
+{
+	if (volume.GetResolution() != m_iResolution)
+	{
+		return -1;
+	}
+
+	long long iMismatches = 0;
+	int iNumMips = std::min(volume.GetMipLevels(), m_iNumLevels);
+	for (int iMip = 0; iMip < iNumMips; iMip++)
+	{
+		int iMipRes = volume.GetMipResolution(iMip);
+		std::vector<long long> arrSliceMismatches(iMipRes, 0);
+		Parallel::For(iMipRes, m_iNumThreads, [&](int z, int iThread)
+		{
+			for (int y = 0; y < iMipRes; y++)
+			{
+				for (int x = 0; x < iMipRes; x++)
+				{
+					if (LookupLevel(x, y, z, iMip) != volume.GetVoxel(x, y, z, iMip))
+					{
+						arrSliceMismatches[z]++;
+					}
+				}
+			}
+		});
+		for (int z = 0; z < iMipRes; z++)
+		{
+			iMismatches += arrSliceMismatches[z];
+		}
+	}
+	return iMismatches;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool SparseVoxelOctree::WriteMemoryReport(const char* sName, const CPUVoxelVolume* pDenseVolume) const
+{
+	std::stringstream ss;
+	ss << "../Results/SVO_" << sName << "_" << m_iResolution << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open sparse voxel octree report file");
+		return false;
+	}
+
+	const float fToKB = 1.f / 1024.f;
+	outfile << std::fixed << "Mip, Resolution, Nodes, Bricks, Node Memory(KB), Brick Memory(KB), Sparse Total(KB), Dense Memory(KB), Sparse/Dense\n";
+	size_t iTotalDense = 0;
+	for (int iLevel = m_iNumLevels - 1; iLevel >= 0; iLevel--)
+	{
+		LevelStats stats = GetLevelStats(iLevel);
+		size_t iSparse = stats.iNodeBytes + stats.iBrickBytes;
+		iTotalDense += stats.iDenseBytes;
+		outfile << GetMipForLevel(iLevel) << "," << stats.iResolution << "," << stats.iNumNodes << "," << stats.iNumBricks << ","
+			<< stats.iNodeBytes * fToKB << "," << stats.iBrickBytes * fToKB << "," << iSparse * fToKB << "," << stats.iDenseBytes * fToKB << ","
+			<< static_cast<double>(iSparse) / stats.iDenseBytes << "\n";
+	}
+	outfile << "Total,,,," << m_arrNodes.size() * sizeof(Node) * fToKB << "," << m_arrBricks.size() * sizeof(uint32_t) * fToKB << ","
+		<< GetMemoryUsageInBytes() * fToKB << "," << iTotalDense * fToKB << "," << static_cast<double>(GetMemoryUsageInBytes()) / iTotalDense << "\n";
+
+	outfile << "\nFragments:," << m_BuildStats.iNumFragments;
+	outfile << "\nFlag And Subdivide(ms):," << m_BuildStats.dSubdivideTimeMs;
+	outfile << "\nLeaf Write(ms):," << m_BuildStats.dLeafTimeMs;
+	outfile << "\nMip Filter(ms):," << m_BuildStats.dMipTimeMs;
+
+	if (pDenseVolume)
+	{
+		//The dense volume as the renderer allocates it, with only its own mips
+		outfile << "\nDense Volume Memory(MB):," << pDenseVolume->GetMemoryUsageInBytes() / (1024.f * 1024.f);
+		outfile << "\nTexels Differing From Dense:," << CompareWithDense(*pDenseVolume);
+
+		//Filtered samples at random positions and fractional mips, what a cone trace would see
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> randUVW(0.f, 1.f);
+		std::uniform_real_distribution<float> randMip(0.f, static_cast<float>(pDenseVolume->GetMipLevels() - 1));
+		float fMaxError = 0.f;
+		for (int i = 0; i < 10000; i++)
+		{
+			XMFLOAT3 vUVW(randUVW(rng), randUVW(rng), randUVW(rng));
+			float fMip = randMip(rng);
+			XMFLOAT4 vSparse = SampleLevel(vUVW, fMip);
+			XMFLOAT4 vDense = pDenseVolume->SampleLevel(vUVW, fMip);
+			fMaxError = std::max(fMaxError, std::max(std::max(fabsf(vSparse.x - vDense.x), fabsf(vSparse.y - vDense.y)), std::max(fabsf(vSparse.z - vDense.z), fabsf(vSparse.w - vDense.w))));
+		}
+		outfile << "\nMax Filtered Sample Error:," << fMaxError;
+	}
+	outfile.close();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int SparseVoxelOctree::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	int iFailures = 0;
+
+	const int iResolutions[] = { 2, 8, 32, 64 };
+	const float fDensities[] = { 0.f, 0.002f, 0.05f, 0.5f };
+	int iNumThreads = std::max(4, Parallel::GetNumWorkerThreads());
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iRes = iResolutions[r];
+		//Every mip down to 2x2x2, the one the root's brick holds
+		int iNumMips = 0;
+		while ((2 << iNumMips) <= iRes)
+		{
+			iNumMips++;
+		}
+		CPUVoxelVolume volume;
+		volume.Initialise(iRes, iNumMips);
+
+		//The same octrees are reused for every density, so Build has to clear out the last one properly
+		SparseVoxelOctree octree, multiThreadOctree;
+		octree.Initialise(iRes, 1);
+		multiThreadOctree.Initialise(iRes, iNumThreads);
+		for (int d = 0; d < sizeof(fDensities) / sizeof(fDensities[0]); d++)
+		{
+			FillSparseVolume(volume, fDensities[d], rng);
+			std::vector<VoxelFragment> arrFragments;
+			volume.GatherFragments(arrFragments);
+			octree.Build(arrFragments);
+			//Fragments come out of the voxeliser in any order
+			std::shuffle(arrFragments.begin(), arrFragments.end(), rng);
+			multiThreadOctree.Build(arrFragments);
+
+			if (octree.GetNumLevels() != iNumMips || octree.GetNodePool().size() != multiThreadOctree.GetNodePool().size() ||
+				octree.GetBrickPool() != multiThreadOctree.GetBrickPool())
+			{
+				VS_LOG_VERBOSE("Sparse voxel octree " << iRes << "^3 came out different with " << iNumThreads << " threads");
+				iFailures++;
+				continue;
+			}
+
+			//Every texel of every mip, and a border outside the volume that should read as empty
+			long long iLookupMismatches = 0;
+			for (int iMip = 0; iMip < iNumMips; iMip++)
+			{
+				int iMipRes = volume.GetMipResolution(iMip);
+				for (int z = -1; z <= iMipRes; z++)
+				{
+					for (int y = -1; y <= iMipRes; y++)
+					{
+						for (int x = -1; x <= iMipRes; x++)
+						{
+							uint32_t iExpected = volume.GetVoxelClamped(x, y, z, iMip);
+							if (octree.LookupLevel(x, y, z, iMip) != iExpected || multiThreadOctree.LookupLevel(x, y, z, iMip) != iExpected)
+							{
+								iLookupMismatches++;
+							}
+						}
+					}
+				}
+			}
+			if (octree.LookupLevel(0, 0, 0, -1) != 0 || octree.LookupLevel(0, 0, 0, iNumMips) != 0)
+			{
+				iLookupMismatches++;
+			}
+
+			//Filtered samples, a little outside the volume and past the last mip as well
+			int iSampleMismatches = 0;
+			for (int i = 0; i < 2000; i++)
+			{
+				XMFLOAT3 vUVW(unit(rng) * 1.2f - 0.1f, unit(rng) * 1.2f - 0.1f, unit(rng) * 1.2f - 0.1f);
+				float fMip = unit(rng) * (iNumMips + 1) - 0.5f;
+				if (i % 4 == 0)
+				{
+					fMip = floorf(fMip);
+				}
+				XMFLOAT4 vSparse = octree.SampleLevel(vUVW, fMip);
+				XMFLOAT4 vDense = volume.SampleLevel(vUVW, fMip);
+				float fError = std::max(std::max(fabsf(vSparse.x - vDense.x), fabsf(vSparse.y - vDense.y)), std::max(fabsf(vSparse.z - vDense.z), fabsf(vSparse.w - vDense.w)));
+				if (fError > 1e-5f)
+				{
+					iSampleMismatches++;
+				}
+			}
+
+			if (iLookupMismatches > 0 || iSampleMismatches > 0)
+			{
+				VS_LOG_VERBOSE("Sparse voxel octree " << iRes << "^3 at density " << fDensities[d] << ": " << iLookupMismatches << " lookups and "
+					<< iSampleMismatches << " samples differ from the dense volume");
+				iFailures += static_cast<int>(iLookupMismatches) + iSampleMismatches;
+			}
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Sparse voxel octree validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,114 @@
+#ifndef SPARSE_VOXEL_OCTREE_H
+#define SPARSE_VOXEL_OCTREE_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Sparse voxel octree holding the same data as the dense radiance volume and its whole mip chain.
+//Nodes live in a node pool in tiles of 8 siblings, and every node with something in it owns a 2x2x2 brick in the
+//brick pool holding its 8 octants. So the bricks of node level L make up the mip with resolution 2^(L+1): the leaf
+//level holds mip 0 and the root's brick is the 2x2x2 mip.
+//Built level by level from a fragment list: flag the nodes fragments land in, subdivide the flagged ones, write the
+//fragments into the leaf bricks, then box filter the bricks back up the tree.
+class SparseVoxelOctree
+{
+public:
+
+	static const uint32_t kNull = 0xffffffff;
+	static const int kBrickVoxels = 8;
+
+	struct Node
+	{
+		uint32_t iChildTile;	//first of 8 children in the node pool, kNull if the node isn't subdivided
+		uint32_t iBrick;		//brick in the brick pool, kNull if the node is empty
+	};
+
+	struct LevelStats
+	{
+		int iResolution;		//resolution of the mip this level's bricks hold
+		int iNumNodes;
+		int iNumBricks;
+		size_t iNodeBytes;
+		size_t iBrickBytes;
+		size_t iDenseBytes;		//the same mip stored densely
+	};
+
+	struct BuildStats
+	{
+		int iNumFragments;
+		double dSubdivideTimeMs;
+		double dLeafTimeMs;
+		double dMipTimeMs;
+	};
+
+	SparseVoxelOctree();
+	~SparseVoxelOctree();
+
+	//iResolution is the finest voxel resolution and has to be a power of 2
+	bool Initialise(int iResolution, int iNumThreads = 0);
+	void Shutdown();
+	void Clear();
+
+	//One fragment per voxel, e.g. from CPUVoxelVolume::GatherFragments
+	bool Build(const std::vector<VoxelFragment>& arrFragments);
+
+	int GetResolution() const { return m_iResolution; }
+	int GetNumLevels() const { return m_iNumLevels; }
+
+	//Texel (x, y, z) of mip iMipLevel, 0 if it is empty or outside the volume
+	uint32_t LookupLevel(int x, int y, int z, int iMipLevel) const;
+	uint32_t Lookup(int x, int y, int z) const { return LookupLevel(x, y, z, 0); }
+
+	//Trilinear within a mip and linear between mips, same as CPUVoxelVolume::SampleLevel
+	XMFLOAT4 SampleLevel(const XMFLOAT3& vUVW, float fMipLevel) const;
+
+	const std::vector<Node>& GetNodePool() const { return m_arrNodes; }
+	const std::vector<uint32_t>& GetBrickPool() const { return m_arrBricks; }
+
+	LevelStats GetLevelStats(int iLevel) const;
+	size_t GetMemoryUsageInBytes() const;
+	const BuildStats& GetBuildStats() const { return m_BuildStats; }
+
+	//Counts texels that differ from the dense volume over the mips both have
+	long long CompareWithDense(const CPUVoxelVolume& volume) const;
+
+	//Memory per level against the dense volume with its MIP_LEVELS mips, plus build times and accuracy, to ../Results/
+	bool WriteMemoryReport(const char* sName, const CPUVoxelVolume* pDenseVolume) const;
+
+	//Random sparse volumes built on one thread and several, with LookupLevel and SampleLevel checked against the dense
+	//volume's mips and the pools checked to come out the same. Returns the number of mismatches.
+	static int Validate(unsigned int iSeed);
+
+private:
+
+	int GetMipForLevel(int iLevel) const { return m_iNumLevels - 1 - iLevel; }
+	void FilterBrick(uint32_t iNode);
+
+	int m_iResolution;
+	int m_iNumLevels;
+	int m_iNumThreads;
+
+	std::vector<Node> m_arrNodes;
+	std::vector<uint32_t> m_arrBricks;
+
+	//nodes of a level are allocated together so each level is a contiguous run of the node pool
+	std::vector<uint32_t> m_arrLevelStart;
+	std::vector<uint32_t> m_arrLevelCount;
+	std::vector<uint32_t> m_arrLevelBricks;
+
+	BuildStats m_BuildStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !SPARSE_VOXEL_OCTREE_H
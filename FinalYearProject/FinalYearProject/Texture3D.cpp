@@ -1,16 +1,144 @@
 #include "Texture3D.h"
 #include "Debugging.h"
+#include <algorithm>
 
-//Tiles are 32x32x16 grids of 4 byte pixels given the format RGBA8
-static const int kTileSizeInBytes = 4 * 32 * 32 * 16;
+D3DTiledResourceBackend::D3DTiledResourceBackend()
+	: m_pContext(nullptr)
+	, m_pTexture(nullptr)
+	, m_pTilePool(nullptr)
+	, m_iMipLevels(0)
+{
+	m_iTiles[0] = m_iTiles[1] = m_iTiles[2] = 0;
+}
+
+void D3DTiledResourceBackend::Initialise(ID3D11Texture3D* pTexture, ID3D11Buffer* pTilePool, int iTilesX, int iTilesY, int iTilesZ, int iMipLevels)
+{
+	m_pTexture = pTexture;
+	m_pTilePool = pTilePool;
+	m_iTiles[0] = iTilesX;
+	m_iTiles[1] = iTilesY;
+	m_iTiles[2] = iTilesZ;
+	m_iMipLevels = iMipLevels;
+}
+
+bool D3DTiledResourceBackend::ResizePool(int iNumTiles)
+{
+	if (FAILED(m_pContext->ResizeTilePool(m_pTilePool, (UINT64)iNumTiles * TilePool::kTileSizeInBytes)))
+	{
+		VS_LOG_VERBOSE("Failed to resize tile pool");
+		return false;
+	}
+	return true;
+}
+
+bool D3DTiledResourceBackend::MapTile(const TileCoord& coord, int iPoolOffset)
+{
+	D3D11_TILED_RESOURCE_COORDINATE d3dCoord;
+	d3dCoord.X = coord.x;
+	d3dCoord.Y = coord.y;
+	d3dCoord.Z = coord.z;
+	d3dCoord.Subresource = coord.iMipLevel;
+
+	UINT RangeFlags = 0;
+	UINT startOffset = iPoolOffset;
+	if (FAILED(m_pContext->UpdateTileMappings(m_pTexture, 1, &d3dCoord, NULL, m_pTilePool, 1, &RangeFlags, &startOffset, nullptr, D3D11_TILE_MAPPING_NO_OVERWRITE)))
+	{
+		VS_LOG_VERBOSE("Failed to map tiles");
+		return false;
+	}
+	return true;
+}
+
+bool D3DTiledResourceBackend::UnmapTile(const TileCoord& coord)
+{
+	D3D11_TILED_RESOURCE_COORDINATE d3dCoord;
+	d3dCoord.X = coord.x;
+	d3dCoord.Y = coord.y;
+	d3dCoord.Z = coord.z;
+	d3dCoord.Subresource = coord.iMipLevel;
+
+	//The last frame's passes can still be using the tile, so this can't promise the driver no overwrite
+	UINT RangeFlags = D3D11_TILE_RANGE_NULL;
+	UINT startOffset = 0;
+	if (FAILED(m_pContext->UpdateTileMappings(m_pTexture, 1, &d3dCoord, NULL, m_pTilePool, 1, &RangeFlags, &startOffset, nullptr, 0)))
+	{
+		VS_LOG_VERBOSE("Failed to unmap tiles");
+		return false;
+	}
+	return true;
+}
+
+bool D3DTiledResourceBackend::UpdateTileRanges(const TileRange* pRanges, int iNumRanges, bool bOnlyNewMaps)
+{
+	//A region and a range for each, the ranges walk the regions' tiles in order
+	m_arrCoords.resize(iNumRanges);
+	m_arrRegionSizes.resize(iNumRanges);
+	m_arrRangeFlags.resize(iNumRanges);
+	m_arrRangeStartOffsets.resize(iNumRanges);
+	m_arrRangeTileCounts.resize(iNumRanges);
+	for (int i = 0; i < iNumRanges; i++)
+	{
+		m_arrCoords[i].X = pRanges[i].start.x;
+		m_arrCoords[i].Y = pRanges[i].start.y;
+		m_arrCoords[i].Z = pRanges[i].start.z;
+		m_arrCoords[i].Subresource = pRanges[i].start.iMipLevel;
+
+		m_arrRegionSizes[i].bUseBox = false;
+		m_arrRegionSizes[i].NumTiles = pRanges[i].iNumTiles;
+		m_arrRegionSizes[i].Width = 0;
+		m_arrRegionSizes[i].Height = 0;
+		m_arrRegionSizes[i].Depth = 0;
+
+		m_arrRangeFlags[i] = pRanges[i].iPoolOffset < 0 ? D3D11_TILE_RANGE_NULL : 0;
+		m_arrRangeStartOffsets[i] = pRanges[i].iPoolOffset < 0 ? 0 : pRanges[i].iPoolOffset;
+		m_arrRangeTileCounts[i] = pRanges[i].iNumTiles;
+	}
+
+	//Unmaps and compaction's moves change tiles the last frame's passes may still be using
+	UINT mappingFlags = bOnlyNewMaps ? D3D11_TILE_MAPPING_NO_OVERWRITE : 0;
+	if (FAILED(m_pContext->UpdateTileMappings(m_pTexture, iNumRanges, m_arrCoords.data(), m_arrRegionSizes.data(), m_pTilePool, iNumRanges, m_arrRangeFlags.data(), m_arrRangeStartOffsets.data(), m_arrRangeTileCounts.data(), mappingFlags)))
+	{
+		VS_LOG_VERBOSE("Failed to update tile mappings");
+		return false;
+	}
+	return true;
+}
+
+bool D3DTiledResourceBackend::UnmapAll()
+{
+	//One box a mip, they don't go below a tile
+	for (int i = 0; i < m_iMipLevels; i++)
+	{
+		D3D11_TILED_RESOURCE_COORDINATE coord;
+		coord.X = 0;
+		coord.Y = 0;
+		coord.Z = 0;
+		coord.Subresource = i;
+
+		D3D11_TILE_REGION_SIZE TRS;
+		TRS.bUseBox = true;
+		TRS.Width = std::max(m_iTiles[0] >> i, 1);
+		TRS.Height = (UINT16)std::max(m_iTiles[1] >> i, 1);
+		TRS.Depth = (UINT16)std::max(m_iTiles[2] >> i, 1);
+		TRS.NumTiles = TRS.Width * TRS.Height * TRS.Depth;
+
+		UINT RangeFlags = D3D11_TILE_RANGE_NULL;
+		UINT startOffset = 0;
+		if (FAILED(m_pContext->UpdateTileMappings(m_pTexture, 1, &coord, &TRS, m_pTilePool, 1, &RangeFlags, &startOffset, nullptr, 0)))
+		{
+			VS_LOG_VERBOSE("Failed to unmap tiles");
+			return false;
+		}
+	}
+	return true;
+}
 
 Texture3D::Texture3D()
 	: m_pTexture(nullptr)
 	, m_pUAV(nullptr)
 	, m_pShaderResourceView(nullptr)
 	, m_pRenderTargetView(nullptr)
-	, m_iNumTilesMapped(0)
-	, m_iBufferSizeInTiles(1)
+	, pTilePool(nullptr)
 	, m_bTiled(false)
 {
 
@@ -54,7 +182,7 @@ HRESULT Texture3D::Init(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext,
 		m_bTiled = true;
 		D3D11_BUFFER_DESC tilePoolDesc;
 		ZeroMemory(&tilePoolDesc, sizeof(tilePoolDesc));
-		tilePoolDesc.ByteWidth = m_iBufferSizeInTiles * kTileSizeInBytes;
+		tilePoolDesc.ByteWidth = TilePool::kTileSizeInBytes;
 		tilePoolDesc.Usage = D3D11_USAGE_DEFAULT;
 		tilePoolDesc.MiscFlags = D3D11_RESOURCE_MISC_TILE_POOL;
 
@@ -64,6 +192,16 @@ HRESULT Texture3D::Init(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext,
 			VS_LOG_VERBOSE("Failed to create tile pool");
 			return false;
 		}
+
+		int iTilesX = iTextureWidth / TilePool::kTileWidth;
+		int iTilesY = iTextureHeight / TilePool::kTileHeight;
+		int iTilesZ = iTextureDepth / TilePool::kTileDepth;
+		m_TileBackend.Initialise(m_pTexture, pTilePool, iTilesX, iTilesY, iTilesZ, mipLevels);
+		if (!m_TilePool.Initialise(&m_TileBackend, iTilesX, iTilesY, iTilesZ, mipLevels, 1))
+		{
+			VS_LOG_VERBOSE("Failed to initialise tile pool");
+			return false;
+		}
 	}
 
 	if (textureDesc.BindFlags & D3D11_BIND_UNORDERED_ACCESS)
@@ -149,74 +287,39 @@ ID3D11UnorderedAccessView* Texture3D::GetUAV()
 
 HRESULT Texture3D::MapTile(ID3D11DeviceContext3* pContext, int x, int y, int z, int mipLevel)
 {
-	if ((m_iNumTilesMapped + 1) > m_iBufferSizeInTiles)
-	{
-		if (FAILED(pContext->ResizeTilePool(pTilePool, (m_iBufferSizeInTiles + 1) * kTileSizeInBytes)))
-		{
-			VS_LOG_VERBOSE("Failed to create tile pool");
-			return false;
-		}
-		m_iBufferSizeInTiles++;
-	}
-	D3D11_TILED_RESOURCE_COORDINATE coord;
-	coord.X = x;
-	coord.Y = y;
-	coord.Z = z;
-	coord.Subresource = mipLevel;
-
-	D3D11_TILE_REGION_SIZE TRS;
-	TRS.bUseBox = false;
-	TRS.NumTiles = 1;
-
-	UINT RangeFlags = 0;
-	UINT startOffset = m_iNumTilesMapped;
-
-	if (FAILED(pContext->UpdateTileMappings(m_pTexture, 1, &coord, NULL, pTilePool, 1, &RangeFlags, &startOffset, nullptr, D3D11_TILE_MAPPING_NO_OVERWRITE)))
-	{
-		VS_LOG_VERBOSE("Failed to map tiles");
-		return false;
-	}
-
-	m_iNumTilesMapped++;
-	return true;
+	m_TileBackend.SetContext(pContext);
+	return m_TilePool.MapTile(x, y, z, mipLevel);
 }
 
 HRESULT Texture3D::UnmapTile(ID3D11DeviceContext3* pContext, int x, int y, int z, int mipLevel)
 {
-	return true;
+	m_TileBackend.SetContext(pContext);
+	return m_TilePool.UnmapTile(x, y, z, mipLevel);
 }
 
 HRESULT Texture3D::UnmapAllTiles(ID3D11DeviceContext3* pContext)
 {
-	m_iNumTilesMapped = 0;
-	D3D11_TILED_RESOURCE_COORDINATE coord;
-	coord.X = 0;
-	coord.Y = 0;
-	coord.Z = 0;
-	coord.Subresource = 0;
+	m_TileBackend.SetContext(pContext);
+	return m_TilePool.UnmapAll();
+}
 
-	D3D11_TILE_REGION_SIZE TRS;
-	TRS.bUseBox = true;
-	TRS.NumTiles = (m_iResolution[0]/32) * (m_iResolution[1]/32) * (m_iResolution[2]/16);
-	TRS.Width = (m_iResolution[0] / 32);
-	TRS.Depth = (m_iResolution[2] / 16);
-	TRS.Height = (m_iResolution[1] / 32);
+HRESULT Texture3D::SubmitTileBatch(ID3D11DeviceContext3* pContext)
+{
+	m_TileBackend.SetContext(pContext);
+	return m_TilePool.SubmitBatch();
+}
 
-	UINT RangeFlags = D3D11_TILE_RANGE_NULL;
-	UINT startOffset = 0;
-	HRESULT hr = pContext->UpdateTileMappings(m_pTexture, 1, &coord, &TRS, pTilePool, 1, &RangeFlags, &startOffset, nullptr, 0);
-	if (FAILED(hr))
-	{
-		VS_LOG_VERBOSE("Failed to map tiles");
-		return false;
-	}
+HRESULT Texture3D::CompactTilePool(ID3D11DeviceContext3* pContext)
+{
+	m_TileBackend.SetContext(pContext);
+	return m_TilePool.CompactIfFragmented();
 }
 
 int Texture3D::GetMemoryUsageInBytes()
 {
 	if (m_bTiled)
 	{
-		return m_iBufferSizeInTiles * kTileSizeInBytes;
+		return m_TilePool.GetMemoryUsageInBytes();
 	}
 	else
 	{
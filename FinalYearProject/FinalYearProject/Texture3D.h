@@ -2,10 +2,44 @@
 #define TEXTURE3D_H
 
 #include <d3d11_3.h>
+#include <vector>
 #include "../DirectXTex/DirectXTex.h"
+#include "TiledResourceBackend.h"
+#include "TilePool.h"
 
 using namespace DirectX;
 
+//TilePool's mappings onto a D3D11 tiled texture and its tile pool buffer. The context has to be set before each use
+//as Texture3D is handed one per call.
+class D3DTiledResourceBackend : public TiledResourceBackend
+{
+public:
+	D3DTiledResourceBackend();
+
+	void Initialise(ID3D11Texture3D* pTexture, ID3D11Buffer* pTilePool, int iTilesX, int iTilesY, int iTilesZ, int iMipLevels);
+	void SetContext(ID3D11DeviceContext3* pContext) { m_pContext = pContext; }
+
+	bool ResizePool(int iNumTiles) override;
+	bool MapTile(const TileCoord& coord, int iPoolOffset) override;
+	bool UnmapTile(const TileCoord& coord) override;
+	bool UpdateTileRanges(const TileRange* pRanges, int iNumRanges, bool bOnlyNewMaps) override;
+	bool UnmapAll() override;
+
+private:
+	ID3D11DeviceContext3* m_pContext;
+	ID3D11Texture3D* m_pTexture;
+	ID3D11Buffer* m_pTilePool;
+	int m_iTiles[3];
+	int m_iMipLevels;
+
+	//Kept between calls so a batch doesn't allocate
+	std::vector<D3D11_TILED_RESOURCE_COORDINATE> m_arrCoords;
+	std::vector<D3D11_TILE_REGION_SIZE> m_arrRegionSizes;
+	std::vector<UINT> m_arrRangeFlags;
+	std::vector<UINT> m_arrRangeStartOffsets;
+	std::vector<UINT> m_arrRangeTileCounts;
+};
+
 class Texture3D
 {
 public:
@@ -24,12 +58,18 @@ public:
 	HRESULT MapTile(ID3D11DeviceContext3* pContext, int x, int y, int z, int mipLevel);
 	HRESULT UnmapTile(ID3D11DeviceContext3* pContext, int x, int y, int z, int mipLevel);
 	HRESULT UnmapAllTiles(ID3D11DeviceContext3* pContext);
+	//Maps and unmaps in between are submitted together at the end, a call a mip
+	void BeginTileBatch() { m_TilePool.BeginBatch(); }
+	HRESULT SubmitTileBatch(ID3D11DeviceContext3* pContext);
+	const TileMappingBatch::Stats& GetLastTileBatchStats() const { return m_TilePool.GetLastBatchStats(); }
+	//Packs the mapped tiles down and shrinks the pool if enough of it is free. What was in the moved tiles is lost, so
+	//it's for just before the volume is cleared.
+	HRESULT CompactTilePool(ID3D11DeviceContext3* pContext);
+	const TilePool::Stats& GetTilePoolStats() const { return m_TilePool.GetStats(); }
 
 	int GetMemoryUsageInBytes();
 private:
 
-	int m_iNumTilesMapped;
-	int m_iBufferSizeInTiles;
 	int m_iMipLevels;
 
 	bool m_bTiled;
@@ -41,6 +81,8 @@ private:
 	ID3D11Texture3D*		  m_pTexture;
 	
 	ID3D11Buffer*			pTilePool;
+	D3DTiledResourceBackend m_TileBackend;
+	TilePool				m_TilePool;
 };
 
 #endif // !TEXTURE3D_H
\ No newline at end of file
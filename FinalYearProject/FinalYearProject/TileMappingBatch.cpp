@@ -0,0 +1,577 @@
+#include "TileMappingBatch.h"
+#include "TilePool.h"
+#include "CPUVoxeliser.h"
+#include "CPUVoxelVolume.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int TileMappingBatch::kNothingPending;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Stands in for the device context: keeps every call it's given and a page table of what they add up to
+	class RecordingBackend : public TiledResourceBackend
+	{
+	public:
+		struct Call
+		{
+			int iMipLevel;		//-1 for a single tile or an unmap all
+			bool bOnlyNewMaps;
+			std::vector<TileRange> arrRanges;
+		};
+
+		RecordingBackend(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, bool bRecordCalls)
+			: m_bRecordCalls(bRecordCalls)
+			, m_iNumCalls(0)
+			, m_iNumTiles(0)
+			, m_iNumFailures(0)
+		{
+			int iNumTiles = 0;
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				m_arrMipTiles.push_back(std::max(iTilesX >> m, 1));
+				m_arrMipTiles.push_back(std::max(iTilesY >> m, 1));
+				m_arrMipTiles.push_back(std::max(iTilesZ >> m, 1));
+				m_arrMipOffsets.push_back(iNumTiles);
+				iNumTiles += m_arrMipTiles[m * 3] * m_arrMipTiles[m * 3 + 1] * m_arrMipTiles[m * 3 + 2];
+			}
+			m_arrTileOffsets.assign(iNumTiles, -1);
+		}
+
+		bool ResizePool(int iNumTiles) override { return true; }
+
+		bool MapTile(const TileCoord& coord, int iPoolOffset) override
+		{
+			TileRange range = { coord, 1, iPoolOffset };
+			Record(-1, &range, 1, false);
+			return true;
+		}
+
+		bool UnmapTile(const TileCoord& coord) override
+		{
+			TileRange range = { coord, 1, -1 };
+			Record(-1, &range, 1, false);
+			return true;
+		}
+
+		bool UpdateTileRanges(const TileRange* pRanges, int iNumRanges, bool bOnlyNewMaps) override
+		{
+			Record(iNumRanges > 0 ? pRanges[0].start.iMipLevel : -1, pRanges, iNumRanges, bOnlyNewMaps);
+			return true;
+		}
+
+		bool UnmapAll() override
+		{
+			Record(-1, nullptr, 0, false);
+			std::fill(m_arrTileOffsets.begin(), m_arrTileOffsets.end(), -1);
+			return true;
+		}
+
+		int GetTileIndex(const TileCoord& coord) const
+		{
+			int m = coord.iMipLevel;
+			return m_arrMipOffsets[m] + (coord.z * m_arrMipTiles[m * 3 + 1] + coord.y) * m_arrMipTiles[m * 3] + coord.x;
+		}
+		int GetNumTilesInMip(int m) const { return m_arrMipTiles[m * 3] * m_arrMipTiles[m * 3 + 1] * m_arrMipTiles[m * 3 + 2]; }
+		int GetOffset(int iTile) const { return m_arrTileOffsets[iTile]; }
+		int GetPageTableSize() const { return static_cast<int>(m_arrTileOffsets.size()); }
+		int GetNumFailures() const { return m_iNumFailures; }
+		long long GetNumCalls() const { return m_iNumCalls; }
+		long long GetNumTiles() const { return m_iNumTiles; }
+		const std::vector<Call>& GetCalls() const { return m_arrCalls; }
+		void ClearCalls() { m_arrCalls.clear(); }
+
+	private:
+		void Record(int iMipLevel, const TileRange* pRanges, int iNumRanges, bool bOnlyNewMaps)
+		{
+			m_iNumCalls++;
+			Call call;
+			call.iMipLevel = iMipLevel;
+			call.bOnlyNewMaps = bOnlyNewMaps;
+			for (int r = 0; r < iNumRanges; r++)
+			{
+				const TileRange& range = pRanges[r];
+				m_iNumTiles += range.iNumTiles;
+				//Every range in the call has to be on the call's mip, and stay inside it
+				int m = range.start.iMipLevel;
+				int iStart = GetTileIndex(range.start) - m_arrMipOffsets[m];
+				if ((iMipLevel >= 0 && m != iMipLevel) || range.iNumTiles <= 0 || iStart < 0 || iStart + range.iNumTiles > GetNumTilesInMip(m))
+				{
+					m_iNumFailures++;
+					continue;
+				}
+				for (int i = 0; i < range.iNumTiles; i++)
+				{
+					//No overwrite would be a lie to the driver about anything but mapping an unmapped tile
+					int& iTileOffset = m_arrTileOffsets[m_arrMipOffsets[m] + iStart + i];
+					m_iNumFailures += bOnlyNewMaps && (range.iPoolOffset < 0 || iTileOffset >= 0);
+					iTileOffset = range.iPoolOffset < 0 ? -1 : range.iPoolOffset + i;
+				}
+				if (m_bRecordCalls)
+				{
+					call.arrRanges.push_back(range);
+				}
+			}
+			if (m_bRecordCalls)
+			{
+				m_arrCalls.push_back(call);
+			}
+		}
+
+		std::vector<int> m_arrMipTiles;
+		std::vector<int> m_arrMipOffsets;
+		std::vector<int> m_arrTileOffsets;
+		std::vector<Call> m_arrCalls;
+		bool m_bRecordCalls;
+		long long m_iNumCalls;
+		long long m_iNumTiles;
+		int m_iNumFailures;
+	};
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileMappingBatch::TileMappingBatch()
+{
+	memset(&m_LastStats, 0, sizeof(m_LastStats));
+	memset(&m_TotalStats, 0, sizeof(m_TotalStats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileMappingBatch::~TileMappingBatch()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingBatch::Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels)
+{
+	m_arrMipTiles.resize(iMipLevels * 3);
+	m_arrMipOffsets.resize(iMipLevels);
+	int iNumTiles = 0;
+	for (int m = 0; m < iMipLevels; m++)
+	{
+		m_arrMipTiles[m * 3] = std::max(iTilesX >> m, 1);
+		m_arrMipTiles[m * 3 + 1] = std::max(iTilesY >> m, 1);
+		m_arrMipTiles[m * 3 + 2] = std::max(iTilesZ >> m, 1);
+		m_arrMipOffsets[m] = iNumTiles;
+		iNumTiles += m_arrMipTiles[m * 3] * m_arrMipTiles[m * 3 + 1] * m_arrMipTiles[m * 3 + 2];
+	}
+	m_arrPendingOffsets.assign(iNumTiles, kNothingPending);
+	m_arrWasMapped.assign(iNumTiles, false);
+	m_arrPendingTiles.clear();
+	memset(&m_LastStats, 0, sizeof(m_LastStats));
+	memset(&m_TotalStats, 0, sizeof(m_TotalStats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingBatch::SetPending(const TileCoord& coord, int iPoolOffset, bool bWasMapped)
+{
+	int m = coord.iMipLevel;
+	int iTile = m_arrMipOffsets[m] + (coord.z * m_arrMipTiles[m * 3 + 1] + coord.y) * m_arrMipTiles[m * 3] + coord.x;
+	if (m_arrPendingOffsets[iTile] == kNothingPending)
+	{
+		//What the GPU has until the batch is submitted, later changes to the tile don't alter that
+		m_arrPendingTiles.push_back(iTile);
+		m_arrWasMapped[iTile] = bWasMapped;
+	}
+	m_arrPendingOffsets[iTile] = iPoolOffset;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingBatch::Clear()
+{
+	for (size_t i = 0; i < m_arrPendingTiles.size(); i++)
+	{
+		m_arrPendingOffsets[m_arrPendingTiles[i]] = kNothingPending;
+	}
+	m_arrPendingTiles.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TileMappingBatch::Submit(TiledResourceBackend* pBackend)
+{
+	memset(&m_LastStats, 0, sizeof(m_LastStats));
+	if (m_arrPendingTiles.empty())
+	{
+		return true;
+	}
+
+	//Tile indices run through each mip in x, y, z order, the order a range covers its tiles in
+	std::sort(m_arrPendingTiles.begin(), m_arrPendingTiles.end());
+
+	bool bResult = true;
+	int iMipLevels = static_cast<int>(m_arrMipOffsets.size());
+	size_t i = 0;
+	while (i < m_arrPendingTiles.size())
+	{
+		int m = static_cast<int>(std::upper_bound(m_arrMipOffsets.begin(), m_arrMipOffsets.end(), m_arrPendingTiles[i]) - m_arrMipOffsets.begin()) - 1;
+		int iMipEnd = m + 1 < iMipLevels ? m_arrMipOffsets[m + 1] : static_cast<int>(m_arrPendingOffsets.size());
+		int iTilesX = m_arrMipTiles[m * 3], iTilesY = m_arrMipTiles[m * 3 + 1];
+
+		m_arrRanges.clear();
+		int iRangeStart = -1;
+		int iTilesInCall = 0;
+		bool bOnlyNewMaps = true;
+		for (; i < m_arrPendingTiles.size() && m_arrPendingTiles[i] < iMipEnd; i++)
+		{
+			int iTile = m_arrPendingTiles[i];
+			int iOffset = m_arrPendingOffsets[iTile];
+			iTilesInCall++;
+			bOnlyNewMaps = bOnlyNewMaps && iOffset >= 0 && !m_arrWasMapped[iTile];
+
+			//Carries on the last range if it's the next tile along and either both unmap or the offsets follow on too
+			if (!m_arrRanges.empty())
+			{
+				TileRange& last = m_arrRanges.back();
+				bool bNextTile = iTile == iRangeStart + last.iNumTiles;
+				bool bBothUnmapped = iOffset < 0 && last.iPoolOffset < 0;
+				bool bNextOffset = iOffset >= 0 && last.iPoolOffset >= 0 && iOffset == last.iPoolOffset + last.iNumTiles;
+				if (bNextTile && (bBothUnmapped || bNextOffset))
+				{
+					last.iNumTiles++;
+					continue;
+				}
+			}
+
+			int iLocal = iTile - m_arrMipOffsets[m];
+			TileRange range;
+			range.start.x = iLocal % iTilesX;
+			range.start.y = (iLocal / iTilesX) % iTilesY;
+			range.start.z = iLocal / (iTilesX * iTilesY);
+			range.start.iMipLevel = m;
+			range.iNumTiles = 1;
+			range.iPoolOffset = iOffset;
+			m_arrRanges.push_back(range);
+			iRangeStart = iTile;
+		}
+
+		if (!pBackend->UpdateTileRanges(m_arrRanges.data(), static_cast<int>(m_arrRanges.size()), bOnlyNewMaps))
+		{
+			VS_LOG_VERBOSE("Failed to update tile mappings for mip " << m);
+			bResult = false;
+		}
+		m_LastStats.iNumCalls++;
+		m_LastStats.iNumRanges += m_arrRanges.size();
+		m_LastStats.iNumTiles += iTilesInCall;
+		m_LastStats.iNumNewMapCalls += bOnlyNewMaps;
+		m_LastStats.iMaxTilesPerCall = std::max(m_LastStats.iMaxTilesPerCall, iTilesInCall);
+	}
+
+	m_TotalStats.iNumCalls += m_LastStats.iNumCalls;
+	m_TotalStats.iNumRanges += m_LastStats.iNumRanges;
+	m_TotalStats.iNumTiles += m_LastStats.iNumTiles;
+	m_TotalStats.iNumNewMapCalls += m_LastStats.iNumNewMapCalls;
+	m_TotalStats.iMaxTilesPerCall = std::max(m_TotalStats.iMaxTilesPerCall, m_LastStats.iMaxTilesPerCall);
+	Clear();
+	return bResult;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TileMappingBatch::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	for (int iTest = 0; iTest < 8; iTest++)
+	{
+		int iTilesX = 1 + rng() % 8, iTilesY = 1 + rng() % 8, iTilesZ = 1 + rng() % 16;
+		int iMipLevels = 1 + rng() % 4;
+		RecordingBackend backend(iTilesX, iTilesY, iTilesZ, iMipLevels, true);
+		TileMappingBatch batch;
+		batch.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels);
+
+		std::vector<TileCoord> arrTiles;
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			for (int z = 0; z < std::max(iTilesZ >> m, 1); z++)
+			{
+				for (int y = 0; y < std::max(iTilesY >> m, 1); y++)
+				{
+					for (int x = 0; x < std::max(iTilesX >> m, 1); x++)
+					{
+						TileCoord coord = { x, y, z, m };
+						arrTiles.push_back(coord);
+					}
+				}
+			}
+		}
+
+		std::vector<int> arrReference(arrTiles.size(), -1);
+		for (int b = 0; b < 40; b++)
+		{
+			//Runs of tiles onto runs of offsets, so there's something to coalesce, mixed in with scattered ones
+			std::vector<int> arrExpected(arrReference);
+			std::vector<bool> arrMipTouched(iMipLevels, false);
+			std::vector<bool> arrTileTouched(arrTiles.size(), false);
+			std::vector<bool> arrFirstChangeNewMap(arrTiles.size(), false);
+			int iNumChanges = rng() % 12;
+			for (int c = 0; c < iNumChanges; c++)
+			{
+				int t = rng() % arrTiles.size();
+				int iRun = 1 + rng() % 6;
+				int iOffset = rng() % 3 == 0 ? -1 : static_cast<int>(rng() % 256);
+				bool bScatter = rng() % 4 == 0;
+				for (int i = 0; i < iRun && t + i < static_cast<int>(arrTiles.size()); i++)
+				{
+					int iTile = bScatter ? static_cast<int>(rng() % arrTiles.size()) : t + i;
+					int iTileOffset = iOffset < 0 ? -1 : iOffset + i;
+					if (iTileOffset >= 0 && arrReference[iTile] >= 0)
+					{
+						batch.MoveTile(arrTiles[iTile], iTileOffset);
+					}
+					else if (iTileOffset >= 0)
+					{
+						batch.MapTile(arrTiles[iTile], iTileOffset);
+					}
+					else
+					{
+						batch.UnmapTile(arrTiles[iTile]);
+					}
+					if (!arrTileTouched[iTile])
+					{
+						arrFirstChangeNewMap[iTile] = iTileOffset >= 0 && arrReference[iTile] < 0;
+					}
+					arrExpected[iTile] = iTileOffset;
+					arrMipTouched[arrTiles[iTile].iMipLevel] = true;
+					arrTileTouched[iTile] = true;
+				}
+			}
+
+			//Thrown away some of the time instead
+			bool bClear = rng() % 8 == 0;
+			backend.ClearCalls();
+			if (bClear)
+			{
+				batch.Clear();
+				iFailures += !batch.IsEmpty();
+				iFailures += !batch.Submit(&backend);
+				iFailures += !backend.GetCalls().empty();
+				continue;
+			}
+
+			//A mip's call is only new maps if every tile it changes was first mapped from unmapped and ends up mapped.
+			//Unmapping an unmapped tile and mapping it again counts as a move, the batch can't know better.
+			std::vector<bool> arrMipOnlyNewMaps(iMipLevels, true);
+			for (size_t t = 0; t < arrTiles.size(); t++)
+			{
+				if (arrTileTouched[t] && (!arrFirstChangeNewMap[t] || arrExpected[t] < 0))
+				{
+					arrMipOnlyNewMaps[arrTiles[t].iMipLevel] = false;
+				}
+			}
+			iFailures += !batch.Submit(&backend);
+			iFailures += !batch.IsEmpty();
+			arrReference = arrExpected;
+
+			//A call for each mip with changes, each one's ranges in order and none that could have been merged
+			const std::vector<RecordingBackend::Call>& arrCalls = backend.GetCalls();
+			iFailures += static_cast<int>(arrCalls.size()) != static_cast<int>(std::count(arrMipTouched.begin(), arrMipTouched.end(), true));
+			iFailures += batch.GetLastStats().iNumCalls != static_cast<long long>(arrCalls.size());
+			iFailures += batch.GetLastStats().iNumTiles != static_cast<long long>(std::count(arrTileTouched.begin(), arrTileTouched.end(), true));
+			for (size_t c = 0; c < arrCalls.size(); c++)
+			{
+				iFailures += c > 0 && arrCalls[c].iMipLevel <= arrCalls[c - 1].iMipLevel;
+				iFailures += arrCalls[c].bOnlyNewMaps != arrMipOnlyNewMaps[arrCalls[c].iMipLevel];
+				const std::vector<TileRange>& arrRanges = arrCalls[c].arrRanges;
+				for (size_t r = 1; r < arrRanges.size(); r++)
+				{
+					const TileRange& a = arrRanges[r - 1];
+					const TileRange& b = arrRanges[r];
+					int iEndA = backend.GetTileIndex(a.start) + a.iNumTiles;
+					int iStartB = backend.GetTileIndex(b.start);
+					iFailures += iStartB < iEndA;
+					bool bMergeable = iStartB == iEndA && ((a.iPoolOffset < 0 && b.iPoolOffset < 0) || (a.iPoolOffset >= 0 && b.iPoolOffset == a.iPoolOffset + a.iNumTiles));
+					iFailures += bMergeable;
+				}
+			}
+
+			for (size_t t = 0; t < arrTiles.size(); t++)
+			{
+				iFailures += backend.GetOffset(backend.GetTileIndex(arrTiles[t])) != arrReference[t];
+			}
+		}
+		iFailures += backend.GetNumFailures();
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Tile mapping batch validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TileMappingBatch::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolutions[] = { 256, 512 };
+	const int iMipLevels = 4;		//as MIP_LEVELS
+	const int iNumFrames = 60;
+
+	std::stringstream ss;
+	ss << "../Results/TileMappingBatch_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open tile mapping batch benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Frame, Tiles Changed, Calls Unbatched, Calls Batched, Ranges, Tiles Per Call, Max Tiles Per Call, Batched Update Time (ms), Unbatched Update Time (ms)\n";
+
+	std::stringstream summary;
+	int iFailures = 0;
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolution, 1))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&volume);
+
+		int iTilesX = iResolution / TilePool::kTileWidth, iTilesY = iResolution / TilePool::kTileHeight, iTilesZ = iResolution / TilePool::kTileDepth;
+		std::vector<bool> arrStaticTiles(iTilesX * iTilesY * iTilesZ, false);
+		for (int z = 0; z < iResolution; z++)
+		{
+			for (int y = 0; y < iResolution; y++)
+			{
+				for (int x = 0; x < iResolution; x++)
+				{
+					if (volume.GetVoxel(x, y, z) != 0)
+					{
+						arrStaticTiles[((z / TilePool::kTileDepth) * iTilesY + (y / TilePool::kTileHeight)) * iTilesX + (x / TilePool::kTileWidth)] = true;
+					}
+				}
+			}
+		}
+
+		//The same changes through two pools, one a tile a call as UpdateTiles used to and one batched a frame at a time
+		RecordingBackend singleBackend(iTilesX, iTilesY, iTilesZ, iMipLevels, false);
+		RecordingBackend batchedBackend(iTilesX, iTilesY, iTilesZ, iMipLevels, false);
+		TilePool singlePool, batchedPool;
+		singlePool.Initialise(&singleBackend, iTilesX, iTilesY, iTilesZ, iMipLevels, 1);
+		batchedPool.Initialise(&batchedBackend, iTilesX, iTilesY, iTilesZ, iMipLevels, 1);
+
+		double dColdStartCallsSingle = 0, dColdStartCallsBatched = 0;
+		std::vector<std::vector<bool>> arrOccupied(iMipLevels);
+		for (int f = 0; f < iNumFrames; f++)
+		{
+			//Everything static on the first frame, then a box sweeping along x
+			int iBoxTiles = std::max(1, iTilesX / 4);
+			int iSweep = iTilesX - iBoxTiles;
+			int iBoxX = iSweep > 0 ? (f % (2 * iSweep) < iSweep ? f % (2 * iSweep) : 2 * iSweep - f % (2 * iSweep)) : 0;
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				arrOccupied[m].assign(batchedPool.GetNumTilesX(m) * batchedPool.GetNumTilesY(m) * batchedPool.GetNumTilesZ(m), false);
+			}
+			for (int z = 0; z < iTilesZ; z++)
+			{
+				for (int y = 0; y < iTilesY; y++)
+				{
+					for (int x = 0; x < iTilesX; x++)
+					{
+						bool bInBox = x >= iBoxX && x < iBoxX + iBoxTiles && y >= iTilesY / 4 && y < iTilesY / 4 + iBoxTiles && z >= iTilesZ / 4 && z < iTilesZ / 4 + iBoxTiles * 2;
+						if (!bInBox && !arrStaticTiles[(z * iTilesY + y) * iTilesX + x])
+						{
+							continue;
+						}
+						for (int m = 0; m < iMipLevels; m++)
+						{
+							int mx = std::min(x >> m, batchedPool.GetNumTilesX(m) - 1), my = std::min(y >> m, batchedPool.GetNumTilesY(m) - 1), mz = std::min(z >> m, batchedPool.GetNumTilesZ(m) - 1);
+							arrOccupied[m][(mz * batchedPool.GetNumTilesY(m) + my) * batchedPool.GetNumTilesX(m) + mx] = true;
+						}
+					}
+				}
+			}
+
+			long long iSingleCallsBefore = singleBackend.GetNumCalls();
+			long long iTilesBefore = singleBackend.GetNumTiles();
+			double dTimes[2] = { 0, 0 };
+			for (int p = 0; p < 2; p++)
+			{
+				TilePool& pool = p == 0 ? batchedPool : singlePool;
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				if (p == 0)
+				{
+					pool.BeginBatch();
+				}
+				for (int m = 0; m < iMipLevels; m++)
+				{
+					for (int i = 0; i < static_cast<int>(arrOccupied[m].size()); i++)
+					{
+						int x = i % pool.GetNumTilesX(m), y = (i / pool.GetNumTilesX(m)) % pool.GetNumTilesY(m), z = i / (pool.GetNumTilesX(m) * pool.GetNumTilesY(m));
+						if (arrOccupied[m][i])
+						{
+							pool.MapTile(x, y, z, m);
+						}
+						else
+						{
+							pool.UnmapTile(x, y, z, m);
+						}
+					}
+				}
+				if (p == 0)
+				{
+					iFailures += !pool.SubmitBatch();
+				}
+				dTimes[p] = GetElapsedMs(start);
+			}
+
+			const Stats& stats = batchedPool.GetLastBatchStats();
+			long long iSingleCalls = singleBackend.GetNumCalls() - iSingleCallsBefore;
+			long long iTilesChanged = singleBackend.GetNumTiles() - iTilesBefore;
+			if (f == 0)
+			{
+				dColdStartCallsSingle = static_cast<double>(iSingleCalls);
+				dColdStartCallsBatched = static_cast<double>(stats.iNumCalls);
+			}
+			outfile << iResolution << "," << f << "," << iTilesChanged << "," << iSingleCalls << "," << stats.iNumCalls << "," << stats.iNumRanges << ","
+				<< (stats.iNumCalls > 0 ? static_cast<double>(stats.iNumTiles) / stats.iNumCalls : 0.0) << "," << stats.iMaxTilesPerCall << "," << dTimes[0] << "," << dTimes[1] << "\n";
+		}
+
+		//Both pools ended up with the same page table
+		for (int t = 0; t < singleBackend.GetPageTableSize(); t++)
+		{
+			iFailures += singleBackend.GetOffset(t) != batchedBackend.GetOffset(t);
+		}
+		iFailures += singleBackend.GetNumFailures() + batchedBackend.GetNumFailures();
+
+		const Stats& totals = batchedPool.GetTotalBatchStats();
+		summary << "\n" << iResolution << " Cold Start Calls Unbatched:," << dColdStartCallsSingle << ",Cold Start Calls Batched:," << dColdStartCallsBatched
+			<< ",Total Calls Unbatched:," << singleBackend.GetNumCalls() << ",Total Calls Batched:," << totals.iNumCalls << ",Tiles Per Call:," << (totals.iNumCalls > 0 ? static_cast<double>(totals.iNumTiles) / totals.iNumCalls : 0.0)
+			<< ",Ranges Per Call:," << (totals.iNumCalls > 0 ? static_cast<double>(totals.iNumRanges) / totals.iNumCalls : 0.0);
+		VS_LOG(sName << " " << iResolution << "^3 tile mapping: cold start in " << dColdStartCallsBatched << " calls batched against " << dColdStartCallsSingle << " a tile at a time, "
+			<< totals.iNumTiles << " tiles in " << totals.iNumCalls << " calls overall");
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iFailures == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
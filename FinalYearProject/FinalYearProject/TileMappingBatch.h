@@ -0,0 +1,85 @@
+#ifndef TILE_MAPPING_BATCH_H
+#define TILE_MAPPING_BATCH_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include "TiledResourceBackend.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Collects a frame's tile mapping changes and submits them as one UpdateTileRanges call a mip, with tiles that follow
+//on from each other in the volume and the pool merged into a single range. Mapping a tile twice before submitting
+//just keeps the last change. A mip's call only says it's nothing but new maps when every tile in it was unmapped
+//before the batch, going by which of MapTile, MoveTile or UnmapTile each tile was first given.
+class TileMappingBatch
+{
+public:
+
+	struct Stats
+	{
+		long long iNumCalls;
+		long long iNumRanges;
+		long long iNumTiles;
+		long long iNumNewMapCalls;		//with nothing but new maps in
+		int iMaxTilesPerCall;
+	};
+
+	TileMappingBatch();
+	~TileMappingBatch();
+
+	//Same tile layout as TilePool, halving down the mips but never below one tile
+	void Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels);
+
+	//MapTile for a tile that isn't mapped yet, MoveTile for one that's mapped to another offset
+	void MapTile(const TileCoord& coord, int iPoolOffset) { SetPending(coord, iPoolOffset, false); }
+	void MoveTile(const TileCoord& coord, int iPoolOffset) { SetPending(coord, iPoolOffset, true); }
+	void UnmapTile(const TileCoord& coord) { SetPending(coord, -1, true); }
+
+	bool IsEmpty() const { return m_arrPendingTiles.empty(); }
+	int GetNumPending() const { return static_cast<int>(m_arrPendingTiles.size()); }
+	//Forgets everything pending without submitting it
+	void Clear();
+
+	//Empties the batch whether or not the backend managed it
+	bool Submit(TiledResourceBackend* pBackend);
+
+	//Of the last Submit, and of all of them since Initialise
+	const Stats& GetLastStats() const { return m_LastStats; }
+	const Stats& GetTotalStats() const { return m_TotalStats; }
+	float GetTilesPerCall() const { return m_TotalStats.iNumCalls > 0 ? static_cast<float>(m_TotalStats.iNumTiles) / m_TotalStats.iNumCalls : 0.f; }
+
+	//Random batches submitted to a backend that records each call, checking the page table matches applying the same
+	//changes one tile at a time, that there's a call a mip, that no two ranges could have been merged and that only
+	//calls of new maps say so
+	static int Validate(unsigned int iSeed);
+
+	//Calls and tiles per call for the voxeliser's occupancy mapped cold and then a box moving through it, batched and
+	//one tile a call, at 256^3 and 512^3. Writes to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	static const int kNothingPending = -2;
+
+	void SetPending(const TileCoord& coord, int iPoolOffset, bool bWasMapped);
+
+	std::vector<int> m_arrMipTiles;		//x, y and z tile counts a mip
+	std::vector<int> m_arrMipOffsets;	//first tile index of each mip
+
+	std::vector<int> m_arrPendingOffsets;	//a tile index's new pool offset, -1 to unmap it
+	std::vector<int> m_arrPendingTiles;		//tile indices with something pending
+	std::vector<bool> m_arrWasMapped;		//whether a pending tile was mapped before the batch
+	std::vector<TileRange> m_arrRanges;
+
+	Stats m_LastStats;
+	Stats m_TotalStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !TILE_MAPPING_BATCH_H
@@ -0,0 +1,664 @@
+#include "TileMappingScheduler.h"
+#include "TileOccupancyBitset.h"
+#include "TilePool.h"
+#include "CPUVoxeliser.h"
+#include "CPUVoxelVolume.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int TileMappingScheduler::LatencyHistogram::kNumBuckets;
+const int TileMappingScheduler::LatencyHistogram::kMaxMipLevels;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//A tile's width is worth a point, a mip level as much as being 100 tiles further away, and 50 frames waiting
+	//as much as a mip level
+	const float kDefaultDistanceWeight = 1.f / 32.f;
+	const float kDefaultMipWeight = 100.f;
+	const float kDefaultAgeWeight = 2.f;
+	//A guess until some costs are reported
+	const float kDefaultCostPerTileUs = 5.f;
+	const float kCostSmoothing = 0.1f;
+	const float kMinCostPerTileUs = 0.01f;
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	struct RequestOrder
+	{
+		template<typename T>
+		bool operator()(const T& a, const T& b) const
+		{
+			return a.fPriority != b.fPriority ? a.fPriority > b.fPriority : a.iTile < b.iTile;
+		}
+	};
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::LatencyHistogram::Clear()
+{
+	for (int m = 0; m < kMaxMipLevels; m++)
+	{
+		for (int b = 0; b < kNumBuckets; b++)
+		{
+			arrCounts[m][b] = 0;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::LatencyHistogram::Add(const LatencyHistogram& other)
+{
+	for (int m = 0; m < kMaxMipLevels; m++)
+	{
+		for (int b = 0; b < kNumBuckets; b++)
+		{
+			arrCounts[m][b] += other.arrCounts[m][b];
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::LatencyHistogram::AddSample(int iMipLevel, int iFrames)
+{
+	arrCounts[std::min(iMipLevel, kMaxMipLevels - 1)][GetBucket(iFrames)]++;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long TileMappingScheduler::LatencyHistogram::GetTotal(int iMipLevel) const
+{
+	long long iTotal = 0;
+	for (int b = 0; b < kNumBuckets; b++)
+	{
+		iTotal += arrCounts[iMipLevel][b];
+	}
+	return iTotal;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TileMappingScheduler::LatencyHistogram::GetBucket(int iFrames)
+{
+	int iBucket = 0;
+	while (iFrames > 0 && iBucket < kNumBuckets - 1)
+	{
+		iFrames >>= 1;
+		iBucket++;
+	}
+	return iBucket;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* TileMappingScheduler::LatencyHistogram::GetBucketName(int iBucket)
+{
+	static const char* s_arrNames[kNumBuckets] = { "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64+" };
+	return s_arrNames[iBucket];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileMappingScheduler::TileMappingScheduler()
+	: m_iMipLevels(0),
+	m_iBudgetTiles(0),
+	m_fBudgetUs(0.f),
+	m_fDistanceWeight(kDefaultDistanceWeight),
+	m_fMipWeight(kDefaultMipWeight),
+	m_fAgeWeight(kDefaultAgeWeight),
+	m_fCostPerTileUs(kDefaultCostPerTileUs),
+	m_vFocus(0.f, 0.f, 0.f),
+	m_iFrame(0),
+	m_iNumRequested(0),
+	m_iNumCancelled(0)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		m_iTileSize[a] = 1;
+	}
+	m_FrameStats = FrameStats();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileMappingScheduler::~TileMappingScheduler()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, int iTileWidth, int iTileHeight, int iTileDepth)
+{
+	m_iMipLevels = iMipLevels;
+	m_iTileSize[0] = iTileWidth;
+	m_iTileSize[1] = iTileHeight;
+	m_iTileSize[2] = iTileDepth;
+
+	m_arrMipTiles.resize(iMipLevels * 3);
+	m_arrMipOffsets.resize(iMipLevels + 1);
+	m_arrMipOffsets[0] = 0;
+	for (int m = 0; m < iMipLevels; m++)
+	{
+		m_arrMipTiles[m * 3] = std::max(iTilesX >> m, 1);
+		m_arrMipTiles[m * 3 + 1] = std::max(iTilesY >> m, 1);
+		m_arrMipTiles[m * 3 + 2] = std::max(iTilesZ >> m, 1);
+		m_arrMipOffsets[m + 1] = m_arrMipOffsets[m] + m_arrMipTiles[m * 3] * m_arrMipTiles[m * 3 + 1] * m_arrMipTiles[m * 3 + 2];
+	}
+
+	m_arrState.assign(m_arrMipOffsets[iMipLevels], tsUnmapped);
+	m_arrPendingIndex.assign(m_arrMipOffsets[iMipLevels], -1);
+	m_arrPending.clear();
+	m_arrTilesToMap.clear();
+	m_arrTilesToUnmap.clear();
+	m_arrUnmapRequests.clear();
+	m_iNumRequested = 0;
+	m_iNumCancelled = 0;
+	m_iFrame = 0;
+	m_FrameStats = FrameStats();
+	m_TotalLatency.Clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::GetTileCoord(int iTile, TileCoord& coord) const
+{
+	int m = 0;
+	while (iTile >= m_arrMipOffsets[m + 1])
+	{
+		m++;
+	}
+	int i = iTile - m_arrMipOffsets[m];
+	const int* pTiles = &m_arrMipTiles[m * 3];
+	coord.x = i % pTiles[0];
+	coord.y = (i / pTiles[0]) % pTiles[1];
+	coord.z = i / (pTiles[0] * pTiles[1]);
+	coord.iMipLevel = m;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float TileMappingScheduler::GetPriority(const TileCoord& coord, int iRequestFrame) const
+{
+	//A mip m tile covers 2^m mip 0 tiles a side
+	float fScale = static_cast<float>(1 << coord.iMipLevel);
+	float dx = (coord.x + 0.5f) * fScale * m_iTileSize[0] - m_vFocus.x;
+	float dy = (coord.y + 0.5f) * fScale * m_iTileSize[1] - m_vFocus.y;
+	float dz = (coord.z + 0.5f) * fScale * m_iTileSize[2] - m_vFocus.z;
+	float fDistance = sqrtf(dx * dx + dy * dy + dz * dz);
+	return m_fMipWeight * coord.iMipLevel + m_fAgeWeight * (m_iFrame - iRequestFrame) - m_fDistanceWeight * fDistance;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::RemovePending(int iIndex)
+{
+	int iTile = m_arrPending[iIndex].iTile;
+	m_arrPendingIndex[iTile] = -1;
+	if (iIndex != static_cast<int>(m_arrPending.size()) - 1)
+	{
+		m_arrPending[iIndex] = m_arrPending.back();
+		m_arrPendingIndex[m_arrPending[iIndex].iTile] = iIndex;
+	}
+	m_arrPending.pop_back();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::RequestMap(const TileCoord& coord)
+{
+	int iTile = GetTileIndex(coord);
+	if (m_arrState[iTile] != tsUnmapped)
+	{
+		return;
+	}
+
+	Request request;
+	request.iTile = iTile;
+	request.iRequestFrame = m_iFrame;
+	request.fPriority = 0.f;
+	m_arrPendingIndex[iTile] = static_cast<int>(m_arrPending.size());
+	m_arrPending.push_back(request);
+	m_arrState[iTile] = tsPending;
+	m_iNumRequested++;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::RequestUnmap(const TileCoord& coord)
+{
+	int iTile = GetTileIndex(coord);
+	if (m_arrState[iTile] == tsPending)
+	{
+		RemovePending(m_arrPendingIndex[iTile]);
+		m_iNumCancelled++;
+	}
+	else if (m_arrState[iTile] == tsMapped)
+	{
+		m_arrUnmapRequests.push_back(coord);
+	}
+	m_arrState[iTile] = tsUnmapped;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::Schedule()
+{
+	m_FrameStats = FrameStats();
+	m_FrameStats.iFrame = m_iFrame;
+	m_FrameStats.iNumRequested = m_iNumRequested;
+	m_FrameStats.iNumCancelled = m_iNumCancelled;
+	m_FrameStats.iNumUnmapped = static_cast<int>(m_arrUnmapRequests.size());
+	m_arrTilesToUnmap.swap(m_arrUnmapRequests);
+	m_arrUnmapRequests.clear();
+	m_arrTilesToMap.clear();
+	m_iNumRequested = 0;
+	m_iNumCancelled = 0;
+
+	int iNumPending = static_cast<int>(m_arrPending.size());
+	int iBudget = iNumPending;
+	if (m_iBudgetTiles > 0)
+	{
+		iBudget = std::min(iBudget, m_iBudgetTiles);
+	}
+	if (m_fBudgetUs > 0.f)
+	{
+		iBudget = std::min(iBudget, static_cast<int>(m_fBudgetUs / m_fCostPerTileUs));
+	}
+	if (iNumPending > 0)
+	{
+		iBudget = std::max(iBudget, 1);
+	}
+	m_FrameStats.iBudgetTiles = iBudget;
+
+	if (iBudget > 0)
+	{
+		for (int i = 0; i < iNumPending; i++)
+		{
+			TileCoord coord;
+			GetTileCoord(m_arrPending[i].iTile, coord);
+			m_arrPending[i].fPriority = GetPriority(coord, m_arrPending[i].iRequestFrame);
+		}
+		//Only the ones going through this frame need to be in order
+		if (iBudget < iNumPending)
+		{
+			std::partial_sort(m_arrPending.begin(), m_arrPending.begin() + iBudget, m_arrPending.end(), RequestOrder());
+		}
+		else
+		{
+			std::sort(m_arrPending.begin(), m_arrPending.end(), RequestOrder());
+		}
+
+		m_arrTilesToMap.resize(iBudget);
+		for (int i = 0; i < iBudget; i++)
+		{
+			const Request& request = m_arrPending[i];
+			GetTileCoord(request.iTile, m_arrTilesToMap[i]);
+			m_arrState[request.iTile] = tsMapped;
+			m_arrPendingIndex[request.iTile] = -1;
+			m_FrameStats.latency.AddSample(m_arrTilesToMap[i].iMipLevel, m_iFrame - request.iRequestFrame);
+		}
+		m_arrPending.erase(m_arrPending.begin(), m_arrPending.begin() + iBudget);
+		for (int i = 0; i < static_cast<int>(m_arrPending.size()); i++)
+		{
+			m_arrPendingIndex[m_arrPending[i].iTile] = i;
+		}
+	}
+
+	m_FrameStats.iNumMapped = iBudget;
+	m_FrameStats.iNumPending = static_cast<int>(m_arrPending.size());
+	for (size_t i = 0; i < m_arrPending.size(); i++)
+	{
+		m_FrameStats.iMaxWaitFrames = std::max(m_FrameStats.iMaxWaitFrames, m_iFrame + 1 - m_arrPending[i].iRequestFrame);
+	}
+	m_FrameStats.fEstimatedUs = iBudget * m_fCostPerTileUs;
+	m_TotalLatency.Add(m_FrameStats.latency);
+	m_iFrame++;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::ReportCost(int iNumTiles, float fMicroseconds)
+{
+	if (iNumTiles <= 0)
+	{
+		return;
+	}
+	float fCost = fMicroseconds / iNumTiles;
+	m_fCostPerTileUs = std::max(m_fCostPerTileUs + (fCost - m_fCostPerTileUs) * kCostSmoothing, kMinCostPerTileUs);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileMappingScheduler::Clear()
+{
+	std::fill(m_arrState.begin(), m_arrState.end(), static_cast<uint8_t>(tsUnmapped));
+	std::fill(m_arrPendingIndex.begin(), m_arrPendingIndex.end(), -1);
+	m_arrPending.clear();
+	m_arrTilesToMap.clear();
+	m_arrTilesToUnmap.clear();
+	m_arrUnmapRequests.clear();
+	m_iNumRequested = 0;
+	m_iNumCancelled = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TileMappingScheduler::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	int iFailures = 0;
+
+	for (int iTest = 0; iTest < 8; iTest++)
+	{
+		int iTilesX = 1 + rng() % 9, iTilesY = 1 + rng() % 5, iTilesZ = 1 + rng() % 5;
+		int iMipLevels = 1 + rng() % 4;
+		int iTileSize[3] = { 1 + static_cast<int>(rng() % 32), 1 + static_cast<int>(rng() % 32), 1 + static_cast<int>(rng() % 16) };
+
+		//Two the same, to check the same input comes out the same
+		TileMappingScheduler schedulers[2];
+		int iBudgetTiles = rng() % 2 ? 0 : 1 + rng() % 20;
+		float fBudgetUs = rng() % 2 ? 0.f : 10.f + unit(rng) * 200.f;
+		float fWeights[3] = { unit(rng), unit(rng) * 50.f, unit(rng) * 5.f };
+		float fCost = 1.f + unit(rng) * 9.f;
+		for (int s = 0; s < 2; s++)
+		{
+			schedulers[s].Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels, iTileSize[0], iTileSize[1], iTileSize[2]);
+			schedulers[s].SetBudget(iBudgetTiles, fBudgetUs);
+			schedulers[s].SetPriorityWeights(fWeights[0], fWeights[1], fWeights[2]);
+			schedulers[s].SetCostEstimate(fCost);
+		}
+		TileMappingScheduler& scheduler = schedulers[0];
+		int iNumTiles = scheduler.m_arrMipOffsets[iMipLevels];
+
+		std::vector<uint8_t> arrState(iNumTiles, tsUnmapped);
+		std::vector<int> arrRequestFrame(iNumTiles, 0);
+		for (int f = 0; f < 50; f++)
+		{
+			if (rng() % 20 == 0)
+			{
+				schedulers[0].Clear();
+				schedulers[1].Clear();
+				std::fill(arrState.begin(), arrState.end(), static_cast<uint8_t>(tsUnmapped));
+			}
+
+			XMFLOAT3 vFocus(unit(rng) * iTilesX * iTileSize[0], unit(rng) * iTilesY * iTileSize[1], unit(rng) * iTilesZ * iTileSize[2]);
+			int iExpectedRequested = 0, iExpectedCancelled = 0;
+			std::vector<TileCoord> arrExpectedUnmaps;
+			int iNumOps = rng() % 30;
+			for (int o = 0; o < iNumOps; o++)
+			{
+				int iTile = rng() % iNumTiles;
+				TileCoord coord;
+				scheduler.GetTileCoord(iTile, coord);
+				if (rng() % 3 != 0)
+				{
+					if (arrState[iTile] == tsUnmapped)
+					{
+						arrState[iTile] = tsPending;
+						arrRequestFrame[iTile] = f;
+						iExpectedRequested++;
+					}
+					schedulers[0].RequestMap(coord);
+					schedulers[1].RequestMap(coord);
+				}
+				else
+				{
+					iExpectedCancelled += arrState[iTile] == tsPending;
+					if (arrState[iTile] == tsMapped)
+					{
+						arrExpectedUnmaps.push_back(coord);
+					}
+					arrState[iTile] = tsUnmapped;
+					schedulers[0].RequestUnmap(coord);
+					schedulers[1].RequestUnmap(coord);
+				}
+			}
+
+			//Everything queued, in priority order, and what the budgets should let through
+			float fCostPerTile = scheduler.GetCostPerTileUs();
+			struct Expected { int iTile; float fPriority; };
+			std::vector<Expected> arrQueued;
+			for (int i = 0; i < iNumTiles; i++)
+			{
+				if (arrState[i] == tsPending)
+				{
+					TileCoord coord;
+					scheduler.GetTileCoord(i, coord);
+					schedulers[0].SetFocus(vFocus);
+					Expected expected = { i, scheduler.GetPriority(coord, arrRequestFrame[i]) };
+					arrQueued.push_back(expected);
+				}
+			}
+			std::sort(arrQueued.begin(), arrQueued.end(), RequestOrder());
+			int iExpectedMapped = static_cast<int>(arrQueued.size());
+			if (iBudgetTiles > 0)
+			{
+				iExpectedMapped = std::min(iExpectedMapped, iBudgetTiles);
+			}
+			if (fBudgetUs > 0.f)
+			{
+				iExpectedMapped = std::min(iExpectedMapped, static_cast<int>(fBudgetUs / fCostPerTile));
+			}
+			if (!arrQueued.empty())
+			{
+				iExpectedMapped = std::max(iExpectedMapped, 1);
+			}
+
+			for (int s = 0; s < 2; s++)
+			{
+				schedulers[s].SetFocus(vFocus);
+				schedulers[s].Schedule();
+			}
+
+			const std::vector<TileCoord>& arrMapped = scheduler.GetTilesToMap();
+			iFailures += static_cast<int>(arrMapped.size()) != iExpectedMapped;
+			for (int i = 0; i < std::min(iExpectedMapped, static_cast<int>(arrMapped.size())); i++)
+			{
+				iFailures += scheduler.GetTileIndex(arrMapped[i]) != arrQueued[i].iTile;
+				arrState[arrQueued[i].iTile] = tsMapped;
+			}
+
+			const std::vector<TileCoord>& arrUnmapped = scheduler.GetTilesToUnmap();
+			iFailures += arrUnmapped.size() != arrExpectedUnmaps.size();
+			for (size_t i = 0; i < std::min(arrUnmapped.size(), arrExpectedUnmaps.size()); i++)
+			{
+				iFailures += scheduler.GetTileIndex(arrUnmapped[i]) != scheduler.GetTileIndex(arrExpectedUnmaps[i]);
+			}
+
+			const FrameStats& stats = scheduler.GetFrameStats();
+			iFailures += stats.iNumRequested != iExpectedRequested;
+			iFailures += stats.iNumCancelled != iExpectedCancelled;
+			iFailures += stats.iNumPending != static_cast<int>(arrQueued.size()) - iExpectedMapped;
+			long long iLatencySamples = 0;
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				iLatencySamples += stats.latency.GetTotal(m);
+			}
+			iFailures += iLatencySamples != iExpectedMapped;
+
+			//The copy has to have done exactly the same
+			const std::vector<TileCoord>& arrOtherMapped = schedulers[1].GetTilesToMap();
+			iFailures += arrOtherMapped.size() != arrMapped.size();
+			for (size_t i = 0; i < std::min(arrOtherMapped.size(), arrMapped.size()); i++)
+			{
+				iFailures += scheduler.GetTileIndex(arrOtherMapped[i]) != scheduler.GetTileIndex(arrMapped[i]);
+			}
+
+			if (rng() % 4 == 0)
+			{
+				float fMeasured = unit(rng) * 20.f * (stats.iNumMapped + 1);
+				schedulers[0].ReportCost(stats.iNumMapped, fMeasured);
+				schedulers[1].ReportCost(stats.iNumMapped, fMeasured);
+			}
+		}
+	}
+
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TileMappingScheduler::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolutions[] = { 256, 512 };
+	const int iMipLevels = 4;		//as MIP_LEVELS
+	const int iNumFrames = 240;
+	const int iMovingFromFrame = 120;
+	//Tile budget, microsecond budget, 0 for none
+	const int iBudgetTiles[] = { 0, 256, 64, 0 };
+	const float fBudgetUs[] = { 0.f, 0.f, 0.f, 500.f };
+	const int iNumBudgets = sizeof(iBudgetTiles) / sizeof(iBudgetTiles[0]);
+	//What the benchmark pretends UpdateTileMappings costs, a fixed part and a part a tile
+	const float fModelFixedUs = 20.f;
+	const float fModelPerTileUs = 3.f;
+
+	std::stringstream ss;
+	ss << "../Results/TileMappingScheduler_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open tile mapping scheduler benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Budget Tiles, Budget(us), Frame, Requested, Mapped, Unmapped, Cancelled, Pending, Max Wait, Estimated(us), Modelled(us), Schedule(ms)\n";
+
+	std::stringstream summary;
+	int iFailures = 0;
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolution, 1))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&volume);
+
+		int iTilesX = iResolution / TilePool::kTileWidth, iTilesY = iResolution / TilePool::kTileHeight, iTilesZ = iResolution / TilePool::kTileDepth;
+		std::vector<uint8_t> arrStatic(iTilesX * iTilesY * iTilesZ, 0);
+		for (int z = 0; z < iResolution; z++)
+		{
+			for (int y = 0; y < iResolution; y++)
+			{
+				for (int x = 0; x < iResolution; x++)
+				{
+					if (volume.GetVoxel(x, y, z) != 0)
+					{
+						arrStatic[((z / TilePool::kTileDepth) * iTilesY + (y / TilePool::kTileHeight)) * iTilesX + (x / TilePool::kTileWidth)] = 1;
+					}
+				}
+			}
+		}
+
+		for (int b = 0; b < iNumBudgets; b++)
+		{
+			TileOccupancyBitset occupancy;
+			occupancy.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels);
+			TileMappingScheduler scheduler;
+			scheduler.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels, TilePool::kTileWidth, TilePool::kTileHeight, TilePool::kTileDepth);
+			scheduler.SetBudget(iBudgetTiles[b], fBudgetUs[b]);
+
+			std::vector<uint8_t> arrData(arrStatic.size());
+			int iWarmUpFrames = -1, iPeakMapped = 0;
+			double dPeakModelledUs = 0.0, dScheduleMs = 0.0;
+			for (int f = 0; f < iNumFrames; f++)
+			{
+				//The static scene, then a box sweeping along x once it's warmed up, with the camera going round the middle
+				arrData = arrStatic;
+				if (f >= iMovingFromFrame)
+				{
+					int iBoxTiles = std::max(1, iTilesX / 4);
+					int iSweep = iTilesX - iBoxTiles;
+					int iStep = f - iMovingFromFrame;
+					int iBoxX = iSweep > 0 ? (iStep % (2 * iSweep) < iSweep ? iStep % (2 * iSweep) : 2 * iSweep - iStep % (2 * iSweep)) : 0;
+					for (int z = iTilesZ / 4; z < std::min(iTilesZ, iTilesZ / 4 + iBoxTiles * 2); z++)
+					{
+						for (int y = iTilesY / 4; y < std::min(iTilesY, iTilesY / 4 + iBoxTiles); y++)
+						{
+							for (int x = iBoxX; x < std::min(iTilesX, iBoxX + iBoxTiles); x++)
+							{
+								arrData[(z * iTilesY + y) * iTilesX + x] = 1;
+							}
+						}
+					}
+				}
+				float fAngle = f * 0.05f;
+				scheduler.SetFocus(XMFLOAT3(iResolution * (0.5f + 0.3f * cosf(fAngle)), iResolution * 0.25f, iResolution * (0.5f + 0.3f * sinf(fAngle))));
+
+				occupancy.LoadMip0(arrData.data(), iTilesX, iTilesX * iTilesY);
+				occupancy.Update();
+
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				const std::vector<TileCoord>& arrToUnmap = occupancy.GetTilesToUnmap();
+				for (size_t i = 0; i < arrToUnmap.size(); i++)
+				{
+					scheduler.RequestUnmap(arrToUnmap[i]);
+				}
+				const std::vector<TileCoord>& arrToMap = occupancy.GetTilesToMap();
+				for (size_t i = 0; i < arrToMap.size(); i++)
+				{
+					scheduler.RequestMap(arrToMap[i]);
+				}
+				scheduler.Schedule();
+				double dMs = GetElapsedMs(start);
+				dScheduleMs += dMs;
+
+				const FrameStats& stats = scheduler.GetFrameStats();
+				int iChanged = stats.iNumMapped + stats.iNumUnmapped;
+				float fModelledUs = iChanged > 0 ? fModelFixedUs + fModelPerTileUs * iChanged : 0.f;
+				scheduler.ReportCost(iChanged, fModelledUs);
+				iPeakMapped = std::max(iPeakMapped, stats.iNumMapped);
+				dPeakModelledUs = std::max(dPeakModelledUs, static_cast<double>(fModelledUs));
+				if (iWarmUpFrames < 0 && !scheduler.HasPending())
+				{
+					iWarmUpFrames = f + 1;
+				}
+
+				outfile << iResolution << "," << iBudgetTiles[b] << "," << fBudgetUs[b] << "," << f << "," << stats.iNumRequested << "," << stats.iNumMapped << ","
+					<< stats.iNumUnmapped << "," << stats.iNumCancelled << "," << stats.iNumPending << "," << stats.iMaxWaitFrames << "," << stats.fEstimatedUs << ","
+					<< fModelledUs << "," << dMs << "\n";
+			}
+
+			//Nothing should be left behind once it's had a chance to catch up
+			iFailures += iWarmUpFrames < 0;
+
+			summary << "\n" << iResolution << " Budget " << iBudgetTiles[b] << " Tiles " << fBudgetUs[b] << "us Frames To Warm Up:," << iWarmUpFrames
+				<< ",Peak Tiles Mapped:," << iPeakMapped << ",Peak Modelled(us):," << dPeakModelledUs << ",Average Schedule(ms):," << dScheduleMs / iNumFrames;
+			const LatencyHistogram& latency = scheduler.GetTotalLatency();
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				summary << "\n,Mip " << m << " Latency(frames):";
+				for (int l = 0; l < LatencyHistogram::kNumBuckets; l++)
+				{
+					summary << "," << LatencyHistogram::GetBucketName(l) << ":," << latency.arrCounts[m][l];
+				}
+			}
+			VS_LOG(sName << " " << iResolution << "^3 tile mapping budget " << iBudgetTiles[b] << " tiles " << fBudgetUs[b] << "us: warm in " << iWarmUpFrames
+				<< " frames, at most " << iPeakMapped << " tiles a frame");
+		}
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iFailures == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,163 @@
+#ifndef TILE_MAPPING_SCHEDULER_H
+#define TILE_MAPPING_SCHEDULER_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include "TiledResourceBackend.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Spreads mapping newly occupied tiles over several frames, so warming up the tiled volume doesn't map thousands of
+//tiles in one frame. Map requests queue up and each frame the highest priority ones that fit a budget, in tiles and
+//in microseconds, are let through; the rest carry over. Coarse mips come first so cones have something to sample
+//straight away, then the tiles nearest the camera, with a request's priority going up the longer it waits. Unmaps
+//aren't budgeted, they're cheap and give tiles back to the pool, and unmapping a tile that's still queued just drops
+//the request. No D3D in here so it can be run and checked on its own.
+class TileMappingScheduler
+{
+public:
+
+	//Frames from a map being requested to it being let through, bucketed by powers of 2
+	struct LatencyHistogram
+	{
+		static const int kNumBuckets = 8;		//0, 1, 2-3, 4-7, 8-15, 16-31, 32-63, 64+
+		static const int kMaxMipLevels = 8;
+
+		long long arrCounts[kMaxMipLevels][kNumBuckets];
+
+		LatencyHistogram() { Clear(); }
+		void Clear();
+		void Add(const LatencyHistogram& other);
+		void AddSample(int iMipLevel, int iFrames);
+		long long GetTotal(int iMipLevel) const;
+
+		static int GetBucket(int iFrames);
+		static const char* GetBucketName(int iBucket);
+	};
+
+	struct FrameStats
+	{
+		int iFrame;
+		int iNumRequested;		//maps asked for this frame
+		int iNumMapped;			//let through this frame
+		int iNumUnmapped;
+		int iNumCancelled;		//queued maps dropped because the tile was unmapped first
+		int iNumPending;		//carried over to the next frame
+		int iMaxWaitFrames;		//of those, the longest one has waited
+		int iBudgetTiles;		//what the budgets allowed this frame
+		float fEstimatedUs;
+		LatencyHistogram latency;	//of the maps let through this frame
+	};
+
+	TileMappingScheduler();
+	~TileMappingScheduler();
+
+	//Same tile layout as TilePool, halving down the mips but never below one tile, with the mip 0 tile size in voxels
+	void Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, int iTileWidth, int iTileHeight, int iTileDepth);
+
+	//0 or less for no limit. However tight they are at least one map is let through a frame while any are waiting.
+	void SetBudget(int iMaxTiles, float fMaxMicroseconds) { m_iBudgetTiles = iMaxTiles; m_fBudgetUs = fMaxMicroseconds; }
+	//Priority = fMip * mip level + fAge * frames waited - fDistance * voxels from the focus to the tile's centre
+	void SetPriorityWeights(float fDistance, float fMip, float fAge) { m_fDistanceWeight = fDistance; m_fMipWeight = fMip; m_fAgeWeight = fAge; }
+	//Usually the camera, in voxels
+	void SetFocus(const XMFLOAT3& vFocus) { m_vFocus = vFocus; }
+	//What mapping a tile's assumed to cost before any costs are reported
+	void SetCostEstimate(float fMicrosecondsPerTile) { m_fCostPerTileUs = fMicrosecondsPerTile; }
+
+	void RequestMap(const TileCoord& coord);
+	void RequestUnmap(const TileCoord& coord);
+
+	//Picks this frame's maps and moves on a frame. Ties are broken by tile, so the same requests always come out in
+	//the same order.
+	void Schedule();
+	//This frame's, highest priority first, and every unmap asked for since the last Schedule
+	const std::vector<TileCoord>& GetTilesToMap() const { return m_arrTilesToMap; }
+	const std::vector<TileCoord>& GetTilesToUnmap() const { return m_arrTilesToUnmap; }
+
+	//What mapping this frame's tiles really took, to learn the cost of a tile from
+	void ReportCost(int iNumTiles, float fMicroseconds);
+	float GetCostPerTileUs() const { return m_fCostPerTileUs; }
+
+	bool HasPending() const { return !m_arrPending.empty(); }
+	int GetNumPending() const { return static_cast<int>(m_arrPending.size()); }
+	//Forgets everything queued and mapped, for when the tiles have all been unmapped some other way
+	void Clear();
+
+	const FrameStats& GetFrameStats() const { return m_FrameStats; }
+	//Every map let through since Initialise
+	const LatencyHistogram& GetTotalLatency() const { return m_TotalLatency; }
+
+	//Random requests and unmaps against sorting everything queued by priority each frame, checking what's let
+	//through, the budgets, that unmaps only ever cover mapped tiles and that the same input gives the same output.
+	//Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Warming up the voxeliser's occupancy and a box moving through it afterwards at 256^3 and 512^3, unbudgeted and
+	//at a few budgets, with the latency each mip sees. Writes to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	enum TileState
+	{
+		tsUnmapped,
+		tsPending,
+		tsMapped
+	};
+
+	struct Request
+	{
+		int iTile;
+		int iRequestFrame;
+		float fPriority;
+	};
+
+	int GetTileIndex(const TileCoord& coord) const
+	{
+		const int* pTiles = &m_arrMipTiles[coord.iMipLevel * 3];
+		return m_arrMipOffsets[coord.iMipLevel] + (coord.z * pTiles[1] + coord.y) * pTiles[0] + coord.x;
+	}
+	void GetTileCoord(int iTile, TileCoord& coord) const;
+	float GetPriority(const TileCoord& coord, int iRequestFrame) const;
+	void RemovePending(int iIndex);
+
+	std::vector<int> m_arrMipTiles;		//x, y and z tile counts a mip
+	std::vector<int> m_arrMipOffsets;	//first tile index of each mip
+	int m_iMipLevels;
+	int m_iTileSize[3];
+
+	int m_iBudgetTiles;
+	float m_fBudgetUs;
+	float m_fDistanceWeight;
+	float m_fMipWeight;
+	float m_fAgeWeight;
+	float m_fCostPerTileUs;
+	XMFLOAT3 m_vFocus;
+
+	int m_iFrame;
+	std::vector<uint8_t> m_arrState;
+	std::vector<int> m_arrPendingIndex;	//a pending tile's place in m_arrPending
+	std::vector<Request> m_arrPending;
+
+	std::vector<TileCoord> m_arrTilesToMap;
+	std::vector<TileCoord> m_arrTilesToUnmap;
+	std::vector<TileCoord> m_arrUnmapRequests;	//since the last Schedule
+	int m_iNumRequested;
+	int m_iNumCancelled;
+
+	FrameStats m_FrameStats;
+	LatencyHistogram m_TotalLatency;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !TILE_MAPPING_SCHEDULER_H
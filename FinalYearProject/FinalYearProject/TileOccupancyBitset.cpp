@@ -0,0 +1,774 @@
+#include "TileOccupancyBitset.h"
+#include "CPUVoxeliser.h"
+#include "CPUVoxelVolume.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TILE_OCCUPANCY_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define TILE_OCCUPANCY_X86_SIMD 0
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	inline int CountTrailingZeros(uint64_t iBits)
+	{
+#ifdef _MSC_VER
+		//Two halves so it works in 32 bit builds too
+		unsigned long iIndex;
+		if (_BitScanForward(&iIndex, static_cast<unsigned long>(iBits)))
+		{
+			return static_cast<int>(iIndex);
+		}
+		_BitScanForward(&iIndex, static_cast<unsigned long>(iBits >> 32));
+		return static_cast<int>(iIndex) + 32;
+#else
+		return __builtin_ctzll(iBits);
+#endif
+	}
+
+	//Even bits of iBits packed into the low 32, so a pair of neighbouring tiles ORed together becomes one
+	inline uint64_t CompactPairs(uint64_t iBits)
+	{
+		iBits = (iBits | (iBits >> 1)) & 0x5555555555555555ULL;
+		iBits = (iBits | (iBits >> 1)) & 0x3333333333333333ULL;
+		iBits = (iBits | (iBits >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+		iBits = (iBits | (iBits >> 4)) & 0x00FF00FF00FF00FFULL;
+		iBits = (iBits | (iBits >> 8)) & 0x0000FFFF0000FFFFULL;
+		iBits = (iBits | (iBits >> 16)) & 0x00000000FFFFFFFFULL;
+		return iBits;
+	}
+
+	inline uint64_t GetLastWordMask(int iTiles)
+	{
+		return (iTiles & 63) == 0 ? ~0ULL : (1ULL << (iTiles & 63)) - 1;
+	}
+
+	//Up to 64 bytes of a row to a bit each
+	uint64_t PackBytesScalar(const uint8_t* pBytes, int iCount)
+	{
+		uint64_t iBits = 0;
+		for (int i = 0; i < iCount; i++)
+		{
+			iBits |= static_cast<uint64_t>(pBytes[i] != 0) << i;
+		}
+		return iBits;
+	}
+
+	void DiffScalar(const uint64_t* pCurrent, const uint64_t* pPrevious, int iStart, int iCount, uint64_t* pNewlyOccupied, uint64_t* pNewlyEmpty)
+	{
+		for (int i = iStart; i < iCount; i++)
+		{
+			uint64_t iChanged = pCurrent[i] ^ pPrevious[i];
+			pNewlyOccupied[i] = iChanged & pCurrent[i];
+			pNewlyEmpty[i] = iChanged & pPrevious[i];
+		}
+	}
+
+#if TILE_OCCUPANCY_X86_SIMD
+	uint64_t PackBytesSSE(const uint8_t* pBytes, int iCount)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		uint64_t iBits = 0;
+		int i = 0;
+		for (; i + 16 <= iCount; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBytes + i));
+			int iEmpty = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero));
+			iBits |= static_cast<uint64_t>(~iEmpty & 0xffff) << i;
+		}
+		return iBits | (PackBytesScalar(pBytes + i, iCount - i) << i);
+	}
+
+	void DiffSSE(const uint64_t* pCurrent, const uint64_t* pPrevious, int iCount, uint64_t* pNewlyOccupied, uint64_t* pNewlyEmpty)
+	{
+		int i = 0;
+		for (; i + 2 <= iCount; i += 2)
+		{
+			__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pCurrent + i));
+			__m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPrevious + i));
+			__m128i changed = _mm_xor_si128(current, previous);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pNewlyOccupied + i), _mm_and_si128(changed, current));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pNewlyEmpty + i), _mm_and_si128(changed, previous));
+		}
+		DiffScalar(pCurrent, pPrevious, i, iCount, pNewlyOccupied, pNewlyEmpty);
+	}
+
+	TARGET_AVX2 uint64_t PackBytesAVX2(const uint8_t* pBytes, int iCount)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		uint64_t iBits = 0;
+		int i = 0;
+		for (; i + 32 <= iCount; i += 32)
+		{
+			__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBytes + i));
+			unsigned int iEmpty = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero)));
+			iBits |= static_cast<uint64_t>(~iEmpty) << i;
+		}
+		return iBits | (PackBytesSSE(pBytes + i, iCount - i) << i);
+	}
+
+	TARGET_AVX2 void DiffAVX2(const uint64_t* pCurrent, const uint64_t* pPrevious, int iCount, uint64_t* pNewlyOccupied, uint64_t* pNewlyEmpty)
+	{
+		int i = 0;
+		for (; i + 4 <= iCount; i += 4)
+		{
+			__m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pCurrent + i));
+			__m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pPrevious + i));
+			__m256i changed = _mm256_xor_si256(current, previous);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pNewlyOccupied + i), _mm256_and_si256(changed, current));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pNewlyEmpty + i), _mm256_and_si256(changed, previous));
+		}
+		DiffScalar(pCurrent, pPrevious, i, iCount, pNewlyOccupied, pNewlyEmpty);
+	}
+#endif
+
+	//What UpdateTiles did before the bitsets, a bool a tile and std::pow for the mips, kept to compare against
+	class LegacyTileUpdate
+	{
+	public:
+		LegacyTileUpdate(int iResolution, int iMipLevels)
+			: m_iTextureDimension(iResolution)
+			, m_iMipLevels(iMipLevels)
+			, m_bPreviousFrameOccupation((iResolution / 16) * (iResolution / 32) * (iResolution / 32), false)
+			, m_bPreviousFrameOccupationMipLevels(iMipLevels - 1)
+		{
+			for (int i = 1; i < iMipLevels; i++)
+			{
+				int mult = std::pow(2, i);
+				m_bPreviousFrameOccupationMipLevels[i - 1].assign(((iResolution / 16) / mult) * ((iResolution / 32) / mult) * ((iResolution / 32) / mult), false);
+			}
+		}
+
+		void Update(const uint8_t* pTexData, int iRowPitch, int iDepthPitch, std::vector<TileCoord>& arrMap, std::vector<TileCoord>& arrUnmap)
+		{
+			int iNumTilesUnmappedThisFrame = 0;
+			int index = 0;
+			for (int z = 0; z < m_iTextureDimension / 16; z++)
+			{
+				for (int y = 0; y < m_iTextureDimension / 32; y++)
+				{
+					index = z * iDepthPitch + y * iRowPitch;
+					for (int x = 0; x < m_iTextureDimension / 32; x++)
+					{
+						if (pTexData[index] != 0)
+						{
+							if (!m_bPreviousFrameOccupation[(z * m_iTextureDimension / 32 * m_iTextureDimension / 32) + (y * m_iTextureDimension / 32) + x])
+							{
+								TileCoord coord = { x, y, z, 0 };
+								arrMap.push_back(coord);
+								m_bPreviousFrameOccupation[(z * m_iTextureDimension / 32 * m_iTextureDimension / 32) + (y * m_iTextureDimension / 32) + x] = true;
+								for (int i = 1; i < m_iMipLevels; i++)
+								{
+									int mult = std::pow(2, i);
+									int mipZ = z / mult;
+									int mipY = y / mult;
+									int mipX = x / mult;
+									int mipIdx = (mipZ * ((m_iTextureDimension / 32) / mult) * ((m_iTextureDimension / 32) / mult)) + mipY * ((m_iTextureDimension / 32) / mult) + mipX;
+									if (!m_bPreviousFrameOccupationMipLevels[i - 1][mipIdx])
+									{
+										TileCoord mipCoord = { mipX, mipY, mipZ, i };
+										arrMap.push_back(mipCoord);
+										m_bPreviousFrameOccupationMipLevels[i - 1][mipIdx] = true;
+									}
+								}
+							}
+						}
+						else if (m_bPreviousFrameOccupation[(z * m_iTextureDimension / 32 * m_iTextureDimension / 32) + (y * m_iTextureDimension / 32) + x])
+						{
+							TileCoord coord = { x, y, z, 0 };
+							arrUnmap.push_back(coord);
+							m_bPreviousFrameOccupation[(z * m_iTextureDimension / 32 * m_iTextureDimension / 32) + (y * m_iTextureDimension / 32) + x] = false;
+							iNumTilesUnmappedThisFrame++;
+						}
+						index++;
+					}
+				}
+			}
+
+			if (iNumTilesUnmappedThisFrame == 0)
+			{
+				return;
+			}
+			int iTilesX = m_iTextureDimension / 32;
+			int iTilesZ = m_iTextureDimension / 16;
+			for (int i = 1; i < m_iMipLevels; i++)
+			{
+				int mult = std::pow(2, i);
+				int iMipTilesX = iTilesX / mult;
+				int iMipTilesZ = iTilesZ / mult;
+				for (int mipZ = 0; mipZ < iMipTilesZ; mipZ++)
+				{
+					for (int mipY = 0; mipY < iMipTilesX; mipY++)
+					{
+						for (int mipX = 0; mipX < iMipTilesX; mipX++)
+						{
+							int mipIdx = (mipZ * iMipTilesX * iMipTilesX) + mipY * iMipTilesX + mipX;
+							if (!m_bPreviousFrameOccupationMipLevels[i - 1][mipIdx])
+							{
+								continue;
+							}
+							bool bOccupied = false;
+							for (int z = mipZ * mult; z < (mipZ + 1) * mult && !bOccupied; z++)
+							{
+								for (int y = mipY * mult; y < (mipY + 1) * mult && !bOccupied; y++)
+								{
+									for (int x = mipX * mult; x < (mipX + 1) * mult && !bOccupied; x++)
+									{
+										bOccupied = m_bPreviousFrameOccupation[(z * iTilesX * iTilesX) + (y * iTilesX) + x];
+									}
+								}
+							}
+							if (!bOccupied)
+							{
+								TileCoord coord = { mipX, mipY, mipZ, i };
+								arrUnmap.push_back(coord);
+								m_bPreviousFrameOccupationMipLevels[i - 1][mipIdx] = false;
+							}
+						}
+					}
+				}
+			}
+		}
+
+	private:
+		int m_iTextureDimension;
+		int m_iMipLevels;
+		std::vector<bool> m_bPreviousFrameOccupation;
+		std::vector<std::vector<bool>> m_bPreviousFrameOccupationMipLevels;
+	};
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileOccupancyBitset::TileOccupancyBitset()
+	: m_iMipLevels(0)
+	, m_eSIMDLevel(simdScalar)
+{
+	SetSIMDLevel(simdMax);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileOccupancyBitset::~TileOccupancyBitset()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TileOccupancyBitset::Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels)
+{
+	if (iTilesX <= 0 || iTilesY <= 0 || iTilesZ <= 0 || iMipLevels <= 0)
+	{
+		VS_LOG_VERBOSE("Invalid tile occupancy dimensions");
+		return false;
+	}
+	m_iMipLevels = iMipLevels;
+	m_arrMipTiles.resize(iMipLevels * 3);
+	m_arrMipWordsPerRow.resize(iMipLevels);
+	m_arrMipWordOffsets.resize(iMipLevels);
+	int iNumWords = 0;
+	for (int m = 0; m < iMipLevels; m++)
+	{
+		m_arrMipTiles[m * 3] = std::max(iTilesX >> m, 1);
+		m_arrMipTiles[m * 3 + 1] = std::max(iTilesY >> m, 1);
+		m_arrMipTiles[m * 3 + 2] = std::max(iTilesZ >> m, 1);
+		m_arrMipWordsPerRow[m] = (m_arrMipTiles[m * 3] + 63) / 64;
+		m_arrMipWordOffsets[m] = iNumWords;
+		iNumWords += m_arrMipWordsPerRow[m] * m_arrMipTiles[m * 3 + 1] * m_arrMipTiles[m * 3 + 2];
+	}
+
+	m_arrCurrent.assign(iNumWords, 0);
+	m_arrPrevious.assign(iNumWords, 0);
+	m_arrNewlyOccupied.assign(iNumWords, 0);
+	m_arrNewlyEmpty.assign(iNumWords, 0);
+	m_arrTilesToMap.clear();
+	m_arrTilesToUnmap.clear();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileOccupancyBitset::SetSIMDLevel(SIMDLevel eLevel)
+{
+#if TILE_OCCUPANCY_X86_SIMD
+	m_eSIMDLevel = std::min(eLevel, TriangleBoxOverlap::GetSupportedLevel());
+#else
+	m_eSIMDLevel = simdScalar;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileOccupancyBitset::LoadMip0(const uint8_t* pData, int iRowPitch, int iDepthPitch)
+{
+	int iTilesX = GetNumTilesX(0);
+	int iWordsPerRow = m_arrMipWordsPerRow[0];
+	for (int z = 0; z < GetNumTilesZ(0); z++)
+	{
+		for (int y = 0; y < GetNumTilesY(0); y++)
+		{
+			const uint8_t* pRow = pData + static_cast<size_t>(z) * iDepthPitch + static_cast<size_t>(y) * iRowPitch;
+			uint64_t* pWords = &m_arrCurrent[GetWordIndex(y, z, 0)];
+			for (int w = 0; w < iWordsPerRow; w++)
+			{
+				int iCount = std::min(64, iTilesX - w * 64);
+				switch (m_eSIMDLevel)
+				{
+#if TILE_OCCUPANCY_X86_SIMD
+				case simdAVX2:
+					pWords[w] = PackBytesAVX2(pRow + w * 64, iCount);
+					break;
+				case simdSSE:
+					pWords[w] = PackBytesSSE(pRow + w * 64, iCount);
+					break;
+#endif
+				default:
+					pWords[w] = PackBytesScalar(pRow + w * 64, iCount);
+					break;
+				}
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileOccupancyBitset::DownsampleMip(int iMipLevel)
+{
+	int c = iMipLevel - 1;
+	int iChildY = GetNumTilesY(c), iChildZ = GetNumTilesZ(c);
+	int iChildWords = m_arrMipWordsPerRow[c];
+	int iWordsPerRow = m_arrMipWordsPerRow[iMipLevel];
+	uint64_t iLastWordMask = GetLastWordMask(GetNumTilesX(iMipLevel));
+
+	for (int z = 0; z < GetNumTilesZ(iMipLevel); z++)
+	{
+		//A child past the end of an odd sized mip has no parent, and a mip only one tile across is its own child
+		int z0 = z * 2, z1 = std::min(z * 2 + 1, iChildZ - 1);
+		for (int y = 0; y < GetNumTilesY(iMipLevel); y++)
+		{
+			int y0 = y * 2, y1 = std::min(y * 2 + 1, iChildY - 1);
+			const uint64_t* pRow00 = &m_arrCurrent[GetWordIndex(y0, z0, c)];
+			const uint64_t* pRow01 = &m_arrCurrent[GetWordIndex(y1, z0, c)];
+			const uint64_t* pRow10 = &m_arrCurrent[GetWordIndex(y0, z1, c)];
+			const uint64_t* pRow11 = &m_arrCurrent[GetWordIndex(y1, z1, c)];
+			uint64_t* pDst = &m_arrCurrent[GetWordIndex(y, z, iMipLevel)];
+
+			//Each word of the parent row takes two of the child's
+			for (int w = 0; w < iWordsPerRow; w++)
+			{
+				uint64_t iLow = 0, iHigh = 0;
+				if (w * 2 < iChildWords)
+				{
+					iLow = pRow00[w * 2] | pRow01[w * 2] | pRow10[w * 2] | pRow11[w * 2];
+				}
+				if (w * 2 + 1 < iChildWords)
+				{
+					iHigh = pRow00[w * 2 + 1] | pRow01[w * 2 + 1] | pRow10[w * 2 + 1] | pRow11[w * 2 + 1];
+				}
+				pDst[w] = CompactPairs(iLow) | (CompactPairs(iHigh) << 32);
+			}
+			pDst[iWordsPerRow - 1] &= iLastWordMask;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileOccupancyBitset::AppendTiles(const std::vector<uint64_t>& arrBits, std::vector<TileCoord>& arrTiles) const
+{
+	for (int m = 0; m < m_iMipLevels; m++)
+	{
+		int iWordsPerRow = m_arrMipWordsPerRow[m];
+		for (int z = 0; z < GetNumTilesZ(m); z++)
+		{
+			for (int y = 0; y < GetNumTilesY(m); y++)
+			{
+				const uint64_t* pWords = &arrBits[GetWordIndex(y, z, m)];
+				for (int w = 0; w < iWordsPerRow; w++)
+				{
+					uint64_t iBits = pWords[w];
+					while (iBits != 0)
+					{
+						TileCoord coord = { w * 64 + CountTrailingZeros(iBits), y, z, m };
+						arrTiles.push_back(coord);
+						iBits &= iBits - 1;
+					}
+				}
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileOccupancyBitset::Update()
+{
+	for (int m = 1; m < m_iMipLevels; m++)
+	{
+		DownsampleMip(m);
+	}
+
+	//Every mip in one pass, they're all in the one array
+	int iNumWords = static_cast<int>(m_arrCurrent.size());
+	switch (m_eSIMDLevel)
+	{
+#if TILE_OCCUPANCY_X86_SIMD
+	case simdAVX2:
+		DiffAVX2(m_arrCurrent.data(), m_arrPrevious.data(), iNumWords, m_arrNewlyOccupied.data(), m_arrNewlyEmpty.data());
+		break;
+	case simdSSE:
+		DiffSSE(m_arrCurrent.data(), m_arrPrevious.data(), iNumWords, m_arrNewlyOccupied.data(), m_arrNewlyEmpty.data());
+		break;
+#endif
+	default:
+		DiffScalar(m_arrCurrent.data(), m_arrPrevious.data(), 0, iNumWords, m_arrNewlyOccupied.data(), m_arrNewlyEmpty.data());
+		break;
+	}
+
+	m_arrTilesToMap.clear();
+	m_arrTilesToUnmap.clear();
+	AppendTiles(m_arrNewlyOccupied, m_arrTilesToMap);
+	AppendTiles(m_arrNewlyEmpty, m_arrTilesToUnmap);
+
+	//Current is overwritten by the next load, so the copy has to be kept rather than swapped
+	m_arrPrevious = m_arrCurrent;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileOccupancyBitset::Clear()
+{
+	std::fill(m_arrCurrent.begin(), m_arrCurrent.end(), 0);
+	std::fill(m_arrPrevious.begin(), m_arrPrevious.end(), 0);
+	m_arrTilesToMap.clear();
+	m_arrTilesToUnmap.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TileOccupancyBitset::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	for (int iTest = 0; iTest < 8; iTest++)
+	{
+		//Rows over 64 tiles and odd sizes now and then, as well as the usual powers of 2
+		int iTilesX = iTest % 4 == 3 ? 1 + rng() % 150 : 1 << (rng() % 7);
+		int iTilesY = iTest % 4 == 3 ? 1 + rng() % 9 : 1 << (rng() % 5);
+		int iTilesZ = iTest % 4 == 3 ? 1 + rng() % 9 : 1 << (rng() % 5);
+		int iMipLevels = 1 + rng() % 5;
+		int iRowPitch = iTilesX + rng() % 40;
+		int iDepthPitch = iRowPitch * iTilesY + rng() % 40;
+		std::vector<uint8_t> arrData(static_cast<size_t>(iDepthPitch) * iTilesZ, 0);
+
+		TileOccupancyBitset bitsets[simdMax];
+		for (int l = 0; l < simdMax; l++)
+		{
+			bitsets[l].Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels);
+			bitsets[l].SetSIMDLevel(static_cast<SIMDLevel>(l));
+		}
+		const TileOccupancyBitset& layout = bitsets[0];
+
+		std::vector<std::vector<bool>> arrPrevious(iMipLevels);
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			arrPrevious[m].assign(layout.GetNumTilesX(m) * layout.GetNumTilesY(m) * layout.GetNumTilesZ(m), false);
+		}
+
+		for (int f = 0; f < 12; f++)
+		{
+			//Anything from nearly empty to nearly full, with the padding between rows full of junk
+			float fDensity = std::uniform_real_distribution<float>(0.f, 1.f)(rng);
+			fDensity = fDensity * fDensity;
+			for (size_t i = 0; i < arrData.size(); i++)
+			{
+				arrData[i] = static_cast<uint8_t>(rng() % 255 + 1);
+			}
+			for (int z = 0; z < iTilesZ; z++)
+			{
+				for (int y = 0; y < iTilesY; y++)
+				{
+					for (int x = 0; x < iTilesX; x++)
+					{
+						bool bOccupied = std::uniform_real_distribution<float>(0.f, 1.f)(rng) < fDensity;
+						arrData[static_cast<size_t>(z) * iDepthPitch + y * iRowPitch + x] = bOccupied ? static_cast<uint8_t>(1 + rng() % 255) : 0;
+					}
+				}
+			}
+			bool bClear = rng() % 10 == 0;
+
+			//Mip 0 as loaded, the mips above any of their children
+			std::vector<std::vector<bool>> arrOccupied(iMipLevels);
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				int iX = layout.GetNumTilesX(m), iY = layout.GetNumTilesY(m), iZ = layout.GetNumTilesZ(m);
+				arrOccupied[m].assign(iX * iY * iZ, false);
+				for (int z = 0; z < iZ; z++)
+				{
+					for (int y = 0; y < iY; y++)
+					{
+						for (int x = 0; x < iX; x++)
+						{
+							bool bOccupied = false;
+							if (m == 0)
+							{
+								bOccupied = arrData[static_cast<size_t>(z) * iDepthPitch + y * iRowPitch + x] != 0;
+							}
+							else
+							{
+								int cX = layout.GetNumTilesX(m - 1), cY = layout.GetNumTilesY(m - 1), cZ = layout.GetNumTilesZ(m - 1);
+								for (int cz = z * 2; cz < std::min(z * 2 + 2, cZ); cz++)
+								{
+									for (int cy = y * 2; cy < std::min(y * 2 + 2, cY); cy++)
+									{
+										for (int cx = x * 2; cx < std::min(x * 2 + 2, cX); cx++)
+										{
+											bOccupied = bOccupied || arrOccupied[m - 1][(cz * cY + cy) * cX + cx];
+										}
+									}
+								}
+							}
+							arrOccupied[m][(z * iY + y) * iX + x] = bOccupied;
+						}
+					}
+				}
+			}
+
+			std::vector<TileCoord> arrExpectedMap, arrExpectedUnmap;
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				int iX = layout.GetNumTilesX(m), iY = layout.GetNumTilesY(m);
+				for (int i = 0; i < static_cast<int>(arrOccupied[m].size()); i++)
+				{
+					TileCoord coord = { i % iX, (i / iX) % iY, i / (iX * iY), m };
+					if (arrOccupied[m][i] && !arrPrevious[m][i])
+					{
+						arrExpectedMap.push_back(coord);
+					}
+					else if (!arrOccupied[m][i] && arrPrevious[m][i])
+					{
+						arrExpectedUnmap.push_back(coord);
+					}
+				}
+			}
+
+			for (int l = 0; l < simdMax; l++)
+			{
+				TileOccupancyBitset& bitset = bitsets[l];
+				if (bitset.GetSIMDLevel() != l)
+				{
+					continue;
+				}
+				bitset.LoadMip0(arrData.data(), iRowPitch, iDepthPitch);
+				bitset.Update();
+
+				const std::vector<TileCoord>& arrMap = bitset.GetTilesToMap();
+				const std::vector<TileCoord>& arrUnmap = bitset.GetTilesToUnmap();
+				iFailures += arrMap.size() != arrExpectedMap.size();
+				iFailures += arrUnmap.size() != arrExpectedUnmap.size();
+				for (size_t i = 0; i < std::min(arrMap.size(), arrExpectedMap.size()); i++)
+				{
+					iFailures += memcmp(&arrMap[i], &arrExpectedMap[i], sizeof(TileCoord)) != 0;
+				}
+				for (size_t i = 0; i < std::min(arrUnmap.size(), arrExpectedUnmap.size()); i++)
+				{
+					iFailures += memcmp(&arrUnmap[i], &arrExpectedUnmap[i], sizeof(TileCoord)) != 0;
+				}
+				for (int m = 0; m < iMipLevels; m++)
+				{
+					int iX = bitset.GetNumTilesX(m), iY = bitset.GetNumTilesY(m);
+					for (int i = 0; i < static_cast<int>(arrOccupied[m].size()); i++)
+					{
+						iFailures += bitset.IsOccupied(i % iX, (i / iX) % iY, i / (iX * iY), m) != arrOccupied[m][i];
+					}
+				}
+				if (bClear)
+				{
+					bitset.Clear();
+				}
+			}
+			arrPrevious = arrOccupied;
+			if (bClear)
+			{
+				for (int m = 0; m < iMipLevels; m++)
+				{
+					std::fill(arrPrevious[m].begin(), arrPrevious[m].end(), false);
+				}
+			}
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Tile occupancy bitset validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TileOccupancyBitset::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolutions[] = { 512, 1024 };
+	const int iMipLevels = 4;			//as MIP_LEVELS
+	const int iNumFrames = 120;
+	const int iSourceResolution = 256;	//voxelised at this and spread over the tiles, as 1024^3 won't fit in memory
+
+	std::stringstream ss;
+	ss << "../Results/TileOccupancyBitset_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open tile occupancy benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Frame, Tiles To Map, Tiles To Unmap, Nested Loops (ms)";
+	for (int l = 0; l < simdMax; l++)
+	{
+		outfile << ", Bitset " << TriangleBoxOverlap::GetLevelName(static_cast<SIMDLevel>(l)) << " (ms)";
+	}
+	outfile << "\n";
+
+	CPUVoxelVolume volume;
+	if (!volume.Initialise(iSourceResolution, 1))
+	{
+		return false;
+	}
+	pVoxeliser->Voxelise(&volume);
+
+	std::stringstream summary;
+	int iFailures = 0;
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		int iTilesX = iResolution / 32, iTilesY = iResolution / 32, iTilesZ = iResolution / 16;
+		//Padded rows like a mapped staging texture
+		int iRowPitch = (iTilesX + 255) & ~255;
+		int iDepthPitch = iRowPitch * iTilesY;
+
+		std::vector<uint8_t> arrStatic(static_cast<size_t>(iTilesX) * iTilesY * iTilesZ, 0);
+		for (int z = 0; z < iSourceResolution; z++)
+		{
+			for (int y = 0; y < iSourceResolution; y++)
+			{
+				for (int x = 0; x < iSourceResolution; x++)
+				{
+					if (volume.GetVoxel(x, y, z) != 0)
+					{
+						int tx = x * iTilesX / iSourceResolution, ty = y * iTilesY / iSourceResolution, tz = z * iTilesZ / iSourceResolution;
+						arrStatic[(static_cast<size_t>(tz) * iTilesY + ty) * iTilesX + tx] = 1;
+					}
+				}
+			}
+		}
+
+		LegacyTileUpdate legacy(iResolution, iMipLevels);
+		TileOccupancyBitset bitsets[simdMax];
+		for (int l = 0; l < simdMax; l++)
+		{
+			bitsets[l].Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels);
+			bitsets[l].SetSIMDLevel(static_cast<SIMDLevel>(l));
+		}
+
+		std::vector<uint8_t> arrData(static_cast<size_t>(iDepthPitch) * iTilesZ, 0);
+		std::vector<TileCoord> arrLegacyMap, arrLegacyUnmap;
+		double dLegacyTotal = 0;
+		double dBitsetTotal[simdMax] = {};
+		for (int f = 0; f < iNumFrames; f++)
+		{
+			//The static scene with a box a quarter of the volume across sweeping through it along x
+			int iBoxTiles = std::max(1, iTilesX / 4);
+			int iSweep = iTilesX - iBoxTiles;
+			int iBoxX = iSweep > 0 ? (f % (2 * iSweep) < iSweep ? f % (2 * iSweep) : 2 * iSweep - f % (2 * iSweep)) : 0;
+			for (int z = 0; z < iTilesZ; z++)
+			{
+				for (int y = 0; y < iTilesY; y++)
+				{
+					for (int x = 0; x < iTilesX; x++)
+					{
+						bool bInBox = x >= iBoxX && x < iBoxX + iBoxTiles && y >= iTilesY / 4 && y < iTilesY / 4 + iBoxTiles && z >= iTilesZ / 4 && z < iTilesZ / 4 + iBoxTiles * 2;
+						arrData[static_cast<size_t>(z) * iDepthPitch + y * iRowPitch + x] = bInBox || arrStatic[(static_cast<size_t>(z) * iTilesY + y) * iTilesX + x];
+					}
+				}
+			}
+
+			arrLegacyMap.clear();
+			arrLegacyUnmap.clear();
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			legacy.Update(arrData.data(), iRowPitch, iDepthPitch, arrLegacyMap, arrLegacyUnmap);
+			double dLegacyMs = GetElapsedMs(start);
+			dLegacyTotal += dLegacyMs;
+
+			outfile << iResolution << "," << f << "," << arrLegacyMap.size() << "," << arrLegacyUnmap.size() << "," << dLegacyMs;
+			for (int l = 0; l < simdMax; l++)
+			{
+				TileOccupancyBitset& bitset = bitsets[l];
+				if (bitset.GetSIMDLevel() != l)
+				{
+					outfile << ",";
+					continue;
+				}
+				start = std::chrono::high_resolution_clock::now();
+				bitset.LoadMip0(arrData.data(), iRowPitch, iDepthPitch);
+				bitset.Update();
+				double dMs = GetElapsedMs(start);
+				dBitsetTotal[l] += dMs;
+				outfile << "," << dMs;
+
+				//Same tiles either way, just in a different order
+				iFailures += bitset.GetTilesToMap().size() != arrLegacyMap.size();
+				iFailures += bitset.GetTilesToUnmap().size() != arrLegacyUnmap.size();
+			}
+			outfile << "\n";
+		}
+
+		summary << "\n" << iResolution << " Average Nested Loops (ms):," << dLegacyTotal / iNumFrames;
+		for (int l = 0; l < simdMax; l++)
+		{
+			if (bitsets[l].GetSIMDLevel() == l)
+			{
+				summary << ",Average Bitset " << TriangleBoxOverlap::GetLevelName(static_cast<SIMDLevel>(l)) << " (ms):," << dBitsetTotal[l] / iNumFrames;
+			}
+		}
+		SIMDLevel eBest = bitsets[simdMax - 1].GetSIMDLevel();
+		VS_LOG(sName << " " << iResolution << "^3 tile update: " << dLegacyTotal / iNumFrames << "ms a frame with nested loops, " << dBitsetTotal[eBest] / iNumFrames << "ms with "
+			<< TriangleBoxOverlap::GetLevelName(eBest) << " bitsets");
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iFailures == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
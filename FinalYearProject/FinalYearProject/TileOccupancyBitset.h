@@ -0,0 +1,96 @@
+#ifndef TILE_OCCUPANCY_BITSET_H
+#define TILE_OCCUPANCY_BITSET_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <cstdint>
+#include "TiledResourceBackend.h"
+#include "TriangleBoxOverlap.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Which tiles of the tiled radiance volume are occupied, a bit a tile for every mip, and which of them changed since
+//the last Update. Each row of tiles along x is padded out to whole uint64_t words so mip 0 can be loaded a row at a
+//time from the occupation readback, the mips above built by ORing rows together and squeezing pairs of bits, and the
+//diff against last frame done a few words at a time with SIMD.
+class TileOccupancyBitset
+{
+public:
+
+	TileOccupancyBitset();
+	~TileOccupancyBitset();
+
+	//Same tile layout as TilePool, halving down the mips but never below one tile
+	bool Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels);
+
+	//Clamped to what the CPU supports. Defaults to the best supported level.
+	void SetSIMDLevel(SIMDLevel eLevel);
+	SIMDLevel GetSIMDLevel() const { return m_eSIMDLevel; }
+
+	//A byte a tile, non zero for occupied, laid out like a mapped R8 texture
+	void LoadMip0(const uint8_t* pData, int iRowPitch, int iDepthPitch);
+	//Builds the mips from what was loaded and works out what's changed since the last Update
+	void Update();
+	//Everything empty, without anything to unmap, for when the tiles have all been unmapped some other way
+	void Clear();
+
+	//From the last Update, mip 0 first
+	const std::vector<TileCoord>& GetTilesToMap() const { return m_arrTilesToMap; }
+	const std::vector<TileCoord>& GetTilesToUnmap() const { return m_arrTilesToUnmap; }
+
+	bool IsOccupied(int x, int y, int z, int iMipLevel) const
+	{
+		return ((m_arrCurrent[GetWordIndex(y, z, iMipLevel) + (x >> 6)] >> (x & 63)) & 1) != 0;
+	}
+	//Between LoadMip0 and Update, for mip 0 tiles that should be mapped whatever the readback says
+	void SetOccupied(int x, int y, int z)
+	{
+		m_arrCurrent[GetWordIndex(y, z, 0) + (x >> 6)] |= static_cast<uint64_t>(1) << (x & 63);
+	}
+
+	int GetNumTilesX(int iMipLevel) const { return m_arrMipTiles[iMipLevel * 3]; }
+	int GetNumTilesY(int iMipLevel) const { return m_arrMipTiles[iMipLevel * 3 + 1]; }
+	int GetNumTilesZ(int iMipLevel) const { return m_arrMipTiles[iMipLevel * 3 + 2]; }
+	int GetMipLevels() const { return m_iMipLevels; }
+
+	//Random occupancy at every SIMD level against a bool a tile and the mip ancestors of each one, checking the map
+	//and unmap lists come out the same. Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//CPU time of the tile update's occupancy work at 512^3 and 1024^3 with a box moving through the voxeliser's
+	//occupancy, against the nested loops UpdateTiles used before. Writes to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	int GetWordIndex(int y, int z, int iMipLevel) const
+	{
+		return m_arrMipWordOffsets[iMipLevel] + (z * GetNumTilesY(iMipLevel) + y) * m_arrMipWordsPerRow[iMipLevel];
+	}
+	void DownsampleMip(int iMipLevel);
+	void AppendTiles(const std::vector<uint64_t>& arrBits, std::vector<TileCoord>& arrTiles) const;
+
+	int m_iMipLevels;
+	std::vector<int> m_arrMipTiles;			//x, y and z tile counts a mip
+	std::vector<int> m_arrMipWordsPerRow;
+	std::vector<int> m_arrMipWordOffsets;	//first word of each mip
+
+	std::vector<uint64_t> m_arrCurrent;
+	std::vector<uint64_t> m_arrPrevious;
+	std::vector<uint64_t> m_arrNewlyOccupied;
+	std::vector<uint64_t> m_arrNewlyEmpty;
+
+	std::vector<TileCoord> m_arrTilesToMap;
+	std::vector<TileCoord> m_arrTilesToUnmap;
+
+	SIMDLevel m_eSIMDLevel;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !TILE_OCCUPANCY_BITSET_H
@@ -0,0 +1,752 @@
+#include "TilePool.h"
+#include "CPUVoxeliser.h"
+#include "CPUVoxelVolume.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int TilePool::kTileWidth;
+const int TilePool::kTileHeight;
+const int TilePool::kTileDepth;
+const int TilePool::kTileSizeInBytes;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Keeps its own page table and checks every call against it: nothing mapped outside the pool, no two tiles on the
+	//same offset, the pool never shrunk out from under a mapped tile and no overwrite only promised for new maps
+	class CheckingBackend : public TiledResourceBackend
+	{
+	public:
+		CheckingBackend(int iNumTiles, int iPoolSize)
+			: m_arrTileOffsets(iNumTiles, -1)
+			, m_arrOffsetTiles(iPoolSize, -1)
+			, m_iNumFailures(0)
+			, m_iNumCalls(0)
+			, m_pPool(nullptr)
+		{
+		}
+
+		//The pool's tile indices are needed to check against, so it's set after the pool is initialised
+		void SetPool(const TilePool* pPool) { m_pPool = pPool; }
+
+		bool ResizePool(int iNumTiles) override
+		{
+			m_iNumCalls++;
+			for (int i = iNumTiles; i < static_cast<int>(m_arrOffsetTiles.size()); i++)
+			{
+				m_iNumFailures += m_arrOffsetTiles[i] >= 0;
+			}
+			m_arrOffsetTiles.resize(iNumTiles, -1);
+			return true;
+		}
+
+		bool MapTile(const TileCoord& coord, int iPoolOffset) override
+		{
+			m_iNumCalls++;
+			int iTile = GetIndex(coord);
+			if (iPoolOffset < 0 || iPoolOffset >= static_cast<int>(m_arrOffsetTiles.size()) || (m_arrOffsetTiles[iPoolOffset] >= 0 && m_arrOffsetTiles[iPoolOffset] != iTile))
+			{
+				m_iNumFailures++;
+				return true;
+			}
+			if (m_arrTileOffsets[iTile] >= 0)
+			{
+				m_arrOffsetTiles[m_arrTileOffsets[iTile]] = -1;
+			}
+			m_arrTileOffsets[iTile] = iPoolOffset;
+			m_arrOffsetTiles[iPoolOffset] = iTile;
+			return true;
+		}
+
+		bool UnmapTile(const TileCoord& coord) override
+		{
+			m_iNumCalls++;
+			int iTile = GetIndex(coord);
+			if (m_arrTileOffsets[iTile] >= 0)
+			{
+				m_arrOffsetTiles[m_arrTileOffsets[iTile]] = -1;
+			}
+			m_arrTileOffsets[iTile] = -1;
+			return true;
+		}
+
+		bool UpdateTileRanges(const TileRange* pRanges, int iNumRanges, bool bOnlyNewMaps) override
+		{
+			m_iNumCalls++;
+			//Everything in the call lands at once, so take the tiles off their old offsets before checking the new ones
+			for (int r = 0; r < iNumRanges; r++)
+			{
+				int iStart = GetIndex(pRanges[r].start);
+				m_iNumFailures += bOnlyNewMaps && pRanges[r].iPoolOffset < 0;
+				for (int t = iStart; t < iStart + pRanges[r].iNumTiles; t++)
+				{
+					m_iNumFailures += bOnlyNewMaps && m_arrTileOffsets[t] >= 0;
+					if (m_arrTileOffsets[t] >= 0)
+					{
+						m_arrOffsetTiles[m_arrTileOffsets[t]] = -1;
+					}
+					m_arrTileOffsets[t] = -1;
+				}
+			}
+			for (int r = 0; r < iNumRanges; r++)
+			{
+				if (pRanges[r].iPoolOffset < 0)
+				{
+					continue;
+				}
+				int iStart = GetIndex(pRanges[r].start);
+				for (int i = 0; i < pRanges[r].iNumTiles; i++)
+				{
+					int iOffset = pRanges[r].iPoolOffset + i;
+					if (iOffset >= static_cast<int>(m_arrOffsetTiles.size()))
+					{
+						m_iNumFailures++;
+						continue;
+					}
+					//A batch is a call a mip, so this would be a tile another mip's call hasn't unmapped yet. Both would
+					//read and write the same memory until it did.
+					if (m_arrOffsetTiles[iOffset] >= 0)
+					{
+						m_iNumFailures++;
+						m_arrTileOffsets[m_arrOffsetTiles[iOffset]] = -1;
+					}
+					m_arrTileOffsets[iStart + i] = iOffset;
+					m_arrOffsetTiles[iOffset] = iStart + i;
+				}
+			}
+			return true;
+		}
+
+		bool UnmapAll() override
+		{
+			m_iNumCalls++;
+			std::fill(m_arrTileOffsets.begin(), m_arrTileOffsets.end(), -1);
+			std::fill(m_arrOffsetTiles.begin(), m_arrOffsetTiles.end(), -1);
+			return true;
+		}
+
+		int GetOffset(const TileCoord& coord) const { return m_arrTileOffsets[GetIndex(coord)]; }
+		int GetPoolSize() const { return static_cast<int>(m_arrOffsetTiles.size()); }
+		int GetNumFailures() const { return m_iNumFailures; }
+		long long GetNumCalls() const { return m_iNumCalls; }
+
+	private:
+		int GetIndex(const TileCoord& coord) const
+		{
+			int iIndex = 0;
+			for (int m = 0; m < coord.iMipLevel; m++)
+			{
+				iIndex += m_pPool->GetNumTilesX(m) * m_pPool->GetNumTilesY(m) * m_pPool->GetNumTilesZ(m);
+			}
+			return iIndex + (coord.z * m_pPool->GetNumTilesY(coord.iMipLevel) + coord.y) * m_pPool->GetNumTilesX(coord.iMipLevel) + coord.x;
+		}
+
+		std::vector<int> m_arrTileOffsets;
+		std::vector<int> m_arrOffsetTiles;
+		int m_iNumFailures;
+		long long m_iNumCalls;
+		const TilePool* m_pPool;
+	};
+
+	int GetNumTiles(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels)
+	{
+		int iNumTiles = 0;
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			iNumTiles += std::max(iTilesX >> m, 1) * std::max(iTilesY >> m, 1) * std::max(iTilesZ >> m, 1);
+		}
+		return iNumTiles;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TilePool::TilePool()
+	: m_pBackend(nullptr)
+	, m_iMipLevels(0)
+	, m_fGrowthFactor(2.f)
+	, m_fCompactionThreshold(0.5f)
+	, m_iMinFreeTilesToCompact(64)
+	, m_bBatching(false)
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TilePool::~TilePool()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::Initialise(TiledResourceBackend* pBackend, int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, int iInitialPoolSize)
+{
+	if (!pBackend || iTilesX <= 0 || iTilesY <= 0 || iTilesZ <= 0 || iMipLevels <= 0 || iInitialPoolSize < 0)
+	{
+		VS_LOG_VERBOSE("Invalid tile pool dimensions");
+		return false;
+	}
+	m_pBackend = pBackend;
+	m_iMipLevels = iMipLevels;
+	m_arrMipTiles.resize(iMipLevels * 3);
+	m_arrMipOffsets.resize(iMipLevels);
+	int iNumTiles = 0;
+	for (int m = 0; m < iMipLevels; m++)
+	{
+		m_arrMipTiles[m * 3] = std::max(iTilesX >> m, 1);
+		m_arrMipTiles[m * 3 + 1] = std::max(iTilesY >> m, 1);
+		m_arrMipTiles[m * 3 + 2] = std::max(iTilesZ >> m, 1);
+		m_arrMipOffsets[m] = iNumTiles;
+		iNumTiles += m_arrMipTiles[m * 3] * m_arrMipTiles[m * 3 + 1] * m_arrMipTiles[m * 3 + 2];
+	}
+
+	m_arrTileOffsets.assign(iNumTiles, -1);
+	m_arrOffsetTiles.assign(iInitialPoolSize, -1);
+	m_arrBatchFreed.clear();
+	m_Batch.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels);
+	m_bBatching = false;
+	memset(&m_Stats, 0, sizeof(m_Stats));
+	m_Stats.iPoolSizeInTiles = iInitialPoolSize;
+	m_Stats.iPeakPoolSizeInTiles = iInitialPoolSize;
+	RebuildFreeList();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileCoord TilePool::GetTileCoord(int iTileIndex) const
+{
+	int m = static_cast<int>(std::upper_bound(m_arrMipOffsets.begin(), m_arrMipOffsets.end(), iTileIndex) - m_arrMipOffsets.begin()) - 1;
+	int iLocal = iTileIndex - m_arrMipOffsets[m];
+	TileCoord coord;
+	coord.x = iLocal % GetNumTilesX(m);
+	coord.y = (iLocal / GetNumTilesX(m)) % GetNumTilesY(m);
+	coord.z = iLocal / (GetNumTilesX(m) * GetNumTilesY(m));
+	coord.iMipLevel = m;
+	return coord;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TilePool::RebuildFreeList()
+{
+	std::vector<int> arrFree;
+	for (int i = 0; i < static_cast<int>(m_arrOffsetTiles.size()); i++)
+	{
+		if (m_arrOffsetTiles[i] < 0)
+		{
+			arrFree.push_back(i);
+		}
+	}
+	m_FreeList = std::priority_queue<int, std::vector<int>, std::greater<int>>(std::greater<int>(), std::move(arrFree));
+	m_Stats.iNumFree = static_cast<int>(m_FreeList.size());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::ResizePool(int iNumTiles)
+{
+	int iOldSize = static_cast<int>(m_arrOffsetTiles.size());
+	if (!m_pBackend->ResizePool(iNumTiles))
+	{
+		VS_LOG_VERBOSE("Failed to resize tile pool to " << iNumTiles << " tiles");
+		return false;
+	}
+	m_arrOffsetTiles.resize(iNumTiles, -1);
+	if (iNumTiles > iOldSize)
+	{
+		for (int i = iOldSize; i < iNumTiles; i++)
+		{
+			m_FreeList.push(i);
+		}
+		m_Stats.iNumGrows++;
+	}
+	else
+	{
+		RebuildFreeList();
+		m_Stats.iNumShrinks++;
+	}
+	m_Stats.iPoolSizeInTiles = iNumTiles;
+	m_Stats.iNumFree = static_cast<int>(m_FreeList.size() + m_arrBatchFreed.size());
+	m_Stats.iPeakPoolSizeInTiles = std::max(m_Stats.iPeakPoolSizeInTiles, iNumTiles);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::MapTile(int x, int y, int z, int iMipLevel)
+{
+	int iTile = GetTileIndex(x, y, z, iMipLevel);
+	if (m_arrTileOffsets[iTile] >= 0)
+	{
+		return true;
+	}
+
+	if (m_FreeList.empty())
+	{
+		int iPoolSize = static_cast<int>(m_arrOffsetTiles.size());
+		int iNewSize = std::max(iPoolSize + 1, static_cast<int>(iPoolSize * m_fGrowthFactor));
+		if (!ResizePool(iNewSize))
+		{
+			return false;
+		}
+	}
+
+	int iOffset = m_FreeList.top();
+	TileCoord coord = { x, y, z, iMipLevel };
+	if (m_bBatching)
+	{
+		m_Batch.MapTile(coord, iOffset);
+	}
+	else
+	{
+		m_Stats.iNumMappingCalls++;
+		if (!m_pBackend->MapTile(coord, iOffset))
+		{
+			VS_LOG_VERBOSE("Failed to map tile");
+			return false;
+		}
+	}
+	m_FreeList.pop();
+	m_arrTileOffsets[iTile] = iOffset;
+	m_arrOffsetTiles[iOffset] = iTile;
+
+	m_Stats.iNumMapped++;
+	m_Stats.iNumFree--;
+	m_Stats.iNumMaps++;
+	m_Stats.iPeakMapped = std::max(m_Stats.iPeakMapped, m_Stats.iNumMapped);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::UnmapTile(int x, int y, int z, int iMipLevel)
+{
+	int iTile = GetTileIndex(x, y, z, iMipLevel);
+	int iOffset = m_arrTileOffsets[iTile];
+	if (iOffset < 0)
+	{
+		return true;
+	}
+
+	TileCoord coord = { x, y, z, iMipLevel };
+	if (m_bBatching)
+	{
+		m_Batch.UnmapTile(coord);
+	}
+	else
+	{
+		m_Stats.iNumMappingCalls++;
+		if (!m_pBackend->UnmapTile(coord))
+		{
+			VS_LOG_VERBOSE("Failed to unmap tile");
+			return false;
+		}
+	}
+	m_arrTileOffsets[iTile] = -1;
+	m_arrOffsetTiles[iOffset] = -1;
+	if (m_bBatching)
+	{
+		m_arrBatchFreed.push_back(iOffset);
+	}
+	else
+	{
+		m_FreeList.push(iOffset);
+	}
+
+	m_Stats.iNumMapped--;
+	m_Stats.iNumFree++;
+	m_Stats.iNumUnmaps++;
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::UnmapAll()
+{
+	//Anything pending would be undone anyway
+	m_Batch.Clear();
+	m_arrBatchFreed.clear();
+	m_Stats.iNumMappingCalls++;
+	if (!m_pBackend->UnmapAll())
+	{
+		VS_LOG_VERBOSE("Failed to unmap tiles");
+		return false;
+	}
+	m_Stats.iNumUnmaps += m_Stats.iNumMapped;
+	std::fill(m_arrTileOffsets.begin(), m_arrTileOffsets.end(), -1);
+	std::fill(m_arrOffsetTiles.begin(), m_arrOffsetTiles.end(), -1);
+	m_Stats.iNumMapped = 0;
+	RebuildFreeList();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::SubmitPending()
+{
+	bool bResult = m_Batch.Submit(m_pBackend);
+	m_Stats.iNumMappingCalls += m_Batch.GetLastStats().iNumCalls;
+	//The batch is gone whether or not the backend managed it, so its freed offsets can be handed out again
+	for (size_t i = 0; i < m_arrBatchFreed.size(); i++)
+	{
+		m_FreeList.push(m_arrBatchFreed[i]);
+	}
+	m_arrBatchFreed.clear();
+	if (!bResult)
+	{
+		VS_LOG_VERBOSE("Failed to submit tile mappings");
+	}
+	return bResult;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::SubmitBatch()
+{
+	m_bBatching = false;
+	return SubmitPending();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float TilePool::GetFragmentation() const
+{
+	return m_Stats.iPoolSizeInTiles > 0 ? static_cast<float>(m_Stats.iNumFree) / m_Stats.iPoolSizeInTiles : 0.f;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::NeedsCompaction() const
+{
+	return m_Stats.iNumFree >= m_iMinFreeTilesToCompact && GetFragmentation() >= m_fCompactionThreshold;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::Compact()
+{
+	//The moves go in a batch of their own so they coalesce, and have to land before the pool can shrink
+	if (!SubmitPending())
+	{
+		return false;
+	}
+
+	//Move the highest mapped tile into the lowest gap until there are no gaps below it
+	int iHighest = static_cast<int>(m_arrOffsetTiles.size()) - 1;
+	while (!m_FreeList.empty())
+	{
+		while (iHighest >= 0 && m_arrOffsetTiles[iHighest] < 0)
+		{
+			iHighest--;
+		}
+		int iLowestFree = m_FreeList.top();
+		if (iHighest < 0 || iLowestFree > iHighest)
+		{
+			break;
+		}
+
+		int iTile = m_arrOffsetTiles[iHighest];
+		m_Batch.MoveTile(GetTileCoord(iTile), iLowestFree);
+		m_FreeList.pop();
+		m_arrOffsetTiles[iLowestFree] = iTile;
+		m_arrOffsetTiles[iHighest] = -1;
+		m_arrTileOffsets[iTile] = iLowestFree;
+		m_Stats.iNumTilesMoved++;
+	}
+	m_Stats.iNumCompactions++;
+	if (!SubmitPending())
+	{
+		VS_LOG_VERBOSE("Failed to move tiles while compacting the tile pool");
+		RebuildFreeList();
+		return false;
+	}
+
+	//Leave room to grow into, so the next few maps don't resize it straight back
+	int iTarget = std::max(1, static_cast<int>(m_Stats.iNumMapped * (1.f + (m_fGrowthFactor - 1.f) * 0.5f)) + 1);
+	if (iTarget < static_cast<int>(m_arrOffsetTiles.size()))
+	{
+		return ResizePool(iTarget);
+	}
+	RebuildFreeList();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TilePool::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	for (int iTest = 0; iTest < 6; iTest++)
+	{
+		int iTilesX = 1 + rng() % 8, iTilesY = 1 + rng() % 8, iTilesZ = 1 + rng() % 16;
+		int iMipLevels = 1 + rng() % 4;
+		int iInitialSize = rng() % 4;
+		int iNumTiles = GetNumTiles(iTilesX, iTilesY, iTilesZ, iMipLevels);
+
+		CheckingBackend backend(iNumTiles, iInitialSize);
+		TilePool pool;
+		pool.SetGrowthFactor(1.f + (rng() % 4) * 0.5f);
+		pool.SetCompactionThreshold(0.25f, 4);
+		if (!pool.Initialise(&backend, iTilesX, iTilesY, iTilesZ, iMipLevels, iInitialSize))
+		{
+			iFailures++;
+			continue;
+		}
+		backend.SetPool(&pool);
+
+		std::vector<TileCoord> arrTiles;
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			for (int z = 0; z < pool.GetNumTilesZ(m); z++)
+			{
+				for (int y = 0; y < pool.GetNumTilesY(m); y++)
+				{
+					for (int x = 0; x < pool.GetNumTilesX(m); x++)
+					{
+						TileCoord coord = { x, y, z, m };
+						arrTiles.push_back(coord);
+					}
+				}
+			}
+		}
+		iFailures += static_cast<int>(arrTiles.size()) != iNumTiles;
+
+		std::vector<bool> arrMapped(arrTiles.size(), false);
+		int iPeak = 0;
+		for (int i = 0; i < 4000; i++)
+		{
+			//Phases of mostly mapping then mostly unmapping, so the pool grows, empties out and compacts
+			bool bMapping = (i / 500) % 2 == 0 ? rng() % 4 != 0 : rng() % 4 == 0;
+			int t = rng() % arrTiles.size();
+			const TileCoord& c = arrTiles[t];
+			if (bMapping)
+			{
+				iFailures += !pool.MapTile(c.x, c.y, c.z, c.iMipLevel);
+				arrMapped[t] = true;
+			}
+			else
+			{
+				iFailures += !pool.UnmapTile(c.x, c.y, c.z, c.iMipLevel);
+				arrMapped[t] = false;
+			}
+			iPeak = std::max(iPeak, static_cast<int>(std::count(arrMapped.begin(), arrMapped.end(), true)));
+			if (rng() % 50 == 0)
+			{
+				iFailures += !pool.CompactIfFragmented();
+			}
+			if (rng() % 100 == 0)
+			{
+				//Some of the time the changes are batched up
+				if (pool.IsBatching())
+				{
+					iFailures += !pool.SubmitBatch();
+				}
+				else
+				{
+					pool.BeginBatch();
+				}
+			}
+			if (rng() % 1000 == 0)
+			{
+				iFailures += !pool.UnmapAll();
+				std::fill(arrMapped.begin(), arrMapped.end(), false);
+			}
+
+			int iNumMapped = static_cast<int>(std::count(arrMapped.begin(), arrMapped.end(), true));
+			const Stats& stats = pool.GetStats();
+			iFailures += stats.iNumMapped != iNumMapped;
+			iFailures += stats.iNumMapped + stats.iNumFree != stats.iPoolSizeInTiles;
+			iFailures += stats.iPoolSizeInTiles != backend.GetPoolSize();
+			iFailures += stats.iPeakMapped != iPeak;
+		}
+
+		//The pool and the backend agree on every tile
+		iFailures += !pool.SubmitBatch();
+		for (size_t t = 0; t < arrTiles.size(); t++)
+		{
+			const TileCoord& c = arrTiles[t];
+			iFailures += pool.IsMapped(c.x, c.y, c.z, c.iMipLevel) != arrMapped[t];
+			iFailures += pool.GetPoolOffset(c.x, c.y, c.z, c.iMipLevel) != backend.GetOffset(c);
+		}
+
+		//Packed down with nothing above the mapped tiles but the headroom
+		iFailures += !pool.Compact();
+		for (size_t t = 0; t < arrTiles.size(); t++)
+		{
+			const TileCoord& c = arrTiles[t];
+			iFailures += pool.GetPoolOffset(c.x, c.y, c.z, c.iMipLevel) >= pool.GetStats().iNumMapped;
+		}
+		iFailures += backend.GetNumFailures();
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Tile pool validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TilePool::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolutions[] = { 256, 512 };
+	const int iMipLevels = 4;		//as MIP_LEVELS
+	const int iNumFrames = 180;
+	const int iSceneChangeFrame = 120;		//the static scene goes, leaving just the moving box
+
+	std::stringstream ss;
+	ss << "../Results/TilePool_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open tile pool benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Frame, Tiles Occupied, Mapped, Pool Tiles, Free, Fragmentation, Maps, Unmaps, Moved, Resizes, Append Only Pool Tiles, Append Only Resizes\n";
+
+	std::stringstream summary;
+	int iFailures = 0;
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume volume;
+		if (!volume.Initialise(iResolution, 1))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&volume);
+
+		int iTilesX = iResolution / kTileWidth, iTilesY = iResolution / kTileHeight, iTilesZ = iResolution / kTileDepth;
+		std::vector<bool> arrStaticTiles(iTilesX * iTilesY * iTilesZ, false);
+		for (int z = 0; z < iResolution; z++)
+		{
+			for (int y = 0; y < iResolution; y++)
+			{
+				for (int x = 0; x < iResolution; x++)
+				{
+					if (volume.GetVoxel(x, y, z) != 0)
+					{
+						arrStaticTiles[((z / kTileDepth) * iTilesY + (y / kTileHeight)) * iTilesX + (x / kTileWidth)] = true;
+					}
+				}
+			}
+		}
+
+		CheckingBackend backend(GetNumTiles(iTilesX, iTilesY, iTilesZ, iMipLevels), 1);
+		TilePool pool;
+		pool.Initialise(&backend, iTilesX, iTilesY, iTilesZ, iMipLevels, 1);
+		backend.SetPool(&pool);
+
+		//What Texture3D did before: a new offset for every map, the pool one bigger each time, and nothing unmapped
+		std::vector<std::vector<bool>> arrAppendOnlyMapped(iMipLevels);
+		int iAppendOnlyPoolSize = 1, iAppendOnlyMapped = 0, iAppendOnlyResizes = 0;
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			arrAppendOnlyMapped[m].assign(pool.GetNumTilesX(m) * pool.GetNumTilesY(m) * pool.GetNumTilesZ(m), false);
+		}
+
+		std::vector<std::vector<bool>> arrOccupied(iMipLevels);
+		for (int f = 0; f < iNumFrames; f++)
+		{
+			//Compacting at the start of the frame, where VoxelisedScene does it before clearing the volume
+			pool.CompactIfFragmented();
+
+			//Static tiles plus a quarter of the volume wide box going back and forth along x
+			int iBoxTiles = std::max(1, iTilesX / 4);
+			int iSweep = iTilesX - iBoxTiles;
+			int iBoxX = iSweep > 0 ? (f % (2 * iSweep) < iSweep ? f % (2 * iSweep) : 2 * iSweep - f % (2 * iSweep)) : 0;
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				arrOccupied[m].assign(pool.GetNumTilesX(m) * pool.GetNumTilesY(m) * pool.GetNumTilesZ(m), false);
+			}
+			int iNumOccupied = 0;
+			for (int z = 0; z < iTilesZ; z++)
+			{
+				for (int y = 0; y < iTilesY; y++)
+				{
+					for (int x = 0; x < iTilesX; x++)
+					{
+						bool bInBox = x >= iBoxX && x < iBoxX + iBoxTiles && y >= iTilesY / 4 && y < iTilesY / 4 + iBoxTiles && z >= iTilesZ / 4 && z < iTilesZ / 4 + iBoxTiles * 2;
+						bool bStatic = f < iSceneChangeFrame && arrStaticTiles[(z * iTilesY + y) * iTilesX + x];
+						if (!bInBox && !bStatic)
+						{
+							continue;
+						}
+						iNumOccupied++;
+						//Mips are needed over any occupied tile, as in VoxelisedScene::UpdateTiles
+						for (int m = 0; m < iMipLevels; m++)
+						{
+							int mx = std::min(x >> m, pool.GetNumTilesX(m) - 1), my = std::min(y >> m, pool.GetNumTilesY(m) - 1), mz = std::min(z >> m, pool.GetNumTilesZ(m) - 1);
+							arrOccupied[m][(mz * pool.GetNumTilesY(m) + my) * pool.GetNumTilesX(m) + mx] = true;
+						}
+					}
+				}
+			}
+
+			for (int m = 0; m < iMipLevels; m++)
+			{
+				for (int i = 0; i < static_cast<int>(arrOccupied[m].size()); i++)
+				{
+					int x = i % pool.GetNumTilesX(m), y = (i / pool.GetNumTilesX(m)) % pool.GetNumTilesY(m), z = i / (pool.GetNumTilesX(m) * pool.GetNumTilesY(m));
+					if (arrOccupied[m][i])
+					{
+						pool.MapTile(x, y, z, m);
+						if (!arrAppendOnlyMapped[m][i])
+						{
+							arrAppendOnlyMapped[m][i] = true;
+							if (++iAppendOnlyMapped > iAppendOnlyPoolSize)
+							{
+								iAppendOnlyPoolSize++;
+								iAppendOnlyResizes++;
+							}
+						}
+					}
+					else
+					{
+						pool.UnmapTile(x, y, z, m);
+						//It forgot the tile but kept its place in the pool, so mapping it again takes a new one
+						if (m == 0)
+						{
+							arrAppendOnlyMapped[m][i] = false;
+						}
+					}
+				}
+			}
+
+			const Stats& stats = pool.GetStats();
+			outfile << iResolution << "," << f << "," << iNumOccupied << "," << stats.iNumMapped << "," << stats.iPoolSizeInTiles << "," << stats.iNumFree << "," << pool.GetFragmentation() << ","
+				<< stats.iNumMaps << "," << stats.iNumUnmaps << "," << stats.iNumTilesMoved << "," << stats.iNumGrows + stats.iNumShrinks << "," << iAppendOnlyPoolSize << "," << iAppendOnlyResizes << "\n";
+		}
+		pool.Compact();
+
+		const Stats& stats = pool.GetStats();
+		iFailures += backend.GetNumFailures();
+		summary << "\n" << iResolution << " Peak Mapped:," << stats.iPeakMapped << ",Peak Pool Tiles:," << stats.iPeakPoolSizeInTiles << ",Final Pool Tiles:," << stats.iPoolSizeInTiles
+			<< ",Resizes:," << stats.iNumGrows + stats.iNumShrinks << ",Compactions:," << stats.iNumCompactions << ",Tiles Moved:," << stats.iNumTilesMoved
+			<< ",Append Only Pool Tiles:," << iAppendOnlyPoolSize << ",Append Only Resizes:," << iAppendOnlyResizes;
+		VS_LOG(sName << " " << iResolution << "^3 tile pool: peak " << stats.iPeakPoolSizeInTiles << " tiles, ends at " << stats.iPoolSizeInTiles << " after " << stats.iNumGrows + stats.iNumShrinks
+			<< " resizes, against " << iAppendOnlyPoolSize << " tiles and " << iAppendOnlyResizes << " resizes growing one at a time");
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iFailures == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
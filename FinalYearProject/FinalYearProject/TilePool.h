@@ -0,0 +1,133 @@
+#ifndef TILE_POOL_H
+#define TILE_POOL_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <functional>
+#include <queue>
+#include "TiledResourceBackend.h"
+#include "TileMappingBatch.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Hands out tile pool offsets to the tiles of a tiled volume. Unmapped tiles give their offset back to a free list, the
+//lowest free offset is always reused first and the pool only grows, by kGrowthFactor at a time, when the free list is
+//empty. Once enough of the pool is free Compact() moves the highest tiles down into the gaps and shrinks the pool to
+//fit, which loses what was in the moved tiles, so it's for when the volume is about to be cleared anyway.
+class TilePool
+{
+public:
+
+	static const int kTileWidth = 32;		//RGBA8 tiles are 32x32x16 texels
+	static const int kTileHeight = 32;
+	static const int kTileDepth = 16;
+	static const int kTileSizeInBytes = 4 * kTileWidth * kTileHeight * kTileDepth;
+
+	struct Stats
+	{
+		int iNumMapped;
+		int iNumFree;				//pool tiles nothing is mapped to
+		int iPoolSizeInTiles;
+		int iPeakMapped;
+		int iPeakPoolSizeInTiles;
+		int iNumGrows;
+		int iNumShrinks;
+		int iNumCompactions;
+		long long iNumTilesMoved;	//by compaction
+		long long iNumMaps;
+		long long iNumUnmaps;
+		long long iNumMappingCalls;	//to the backend, a batch counts a call a mip
+	};
+
+	TilePool();
+	~TilePool();
+
+	//The volume is iTilesX x iTilesY x iTilesZ tiles at mip 0, halving down the mips but never below one tile. The
+	//backend has to stay alive while the pool uses it and start with a pool of iInitialPoolSize tiles.
+	bool Initialise(TiledResourceBackend* pBackend, int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, int iInitialPoolSize = 1);
+
+	//How much bigger the pool gets each time it runs out, at least one tile more
+	void SetGrowthFactor(float fGrowthFactor) { m_fGrowthFactor = fGrowthFactor; }
+	//Compact when at least this fraction of the pool and iMinFreeTiles tiles are free. A fraction over 1 never compacts.
+	void SetCompactionThreshold(float fFreeFraction, int iMinFreeTiles) { m_fCompactionThreshold = fFreeFraction; m_iMinFreeTilesToCompact = iMinFreeTiles; }
+
+	int GetNumTilesX(int iMipLevel) const { return m_arrMipTiles[iMipLevel * 3]; }
+	int GetNumTilesY(int iMipLevel) const { return m_arrMipTiles[iMipLevel * 3 + 1]; }
+	int GetNumTilesZ(int iMipLevel) const { return m_arrMipTiles[iMipLevel * 3 + 2]; }
+	int GetMipLevels() const { return m_iMipLevels; }
+
+	//Both do nothing if the tile's already that way
+	bool MapTile(int x, int y, int z, int iMipLevel);
+	bool UnmapTile(int x, int y, int z, int iMipLevel);
+	bool UnmapAll();
+
+	//Between these the maps and unmaps, compaction's included, are held back and submitted together as a call a mip.
+	//The pool's own bookkeeping changes straight away, except that offsets freed in the batch aren't handed out again
+	//until it's submitted, as the calls for the other mips could land first and alias them.
+	void BeginBatch() { m_bBatching = true; }
+	bool SubmitBatch();
+	bool IsBatching() const { return m_bBatching; }
+	const TileMappingBatch::Stats& GetLastBatchStats() const { return m_Batch.GetLastStats(); }
+	const TileMappingBatch::Stats& GetTotalBatchStats() const { return m_Batch.GetTotalStats(); }
+
+	bool IsMapped(int x, int y, int z, int iMipLevel) const { return GetPoolOffset(x, y, z, iMipLevel) >= 0; }
+	//-1 when it isn't mapped
+	int GetPoolOffset(int x, int y, int z, int iMipLevel) const { return m_arrTileOffsets[GetTileIndex(x, y, z, iMipLevel)]; }
+
+	//Free tiles as a fraction of the pool
+	float GetFragmentation() const;
+	bool NeedsCompaction() const;
+	//Packs the mapped tiles into the bottom of the pool and shrinks it to fit with a little room to grow
+	bool Compact();
+	bool CompactIfFragmented() { return NeedsCompaction() ? Compact() : true; }
+
+	const Stats& GetStats() const { return m_Stats; }
+	int GetMemoryUsageInBytes() const { return m_Stats.iPoolSizeInTiles * kTileSizeInBytes; }
+
+	//Random maps and unmaps against a stand-in backend that checks no two tiles ever share an offset, even for the
+	//length of a batch, and nothing is mapped outside the pool, with compactions along the way. Returns the number of
+	//failures.
+	static int Validate(unsigned int iSeed);
+
+	//Tile occupancy of the voxeliser's triangles with a box moving through them at 256^3 and 512^3, comparing the pool
+	//size, resizes and peak with the old grow by one and never unmap behaviour. Writes to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	int GetTileIndex(int x, int y, int z, int iMipLevel) const
+	{
+		return m_arrMipOffsets[iMipLevel] + (z * GetNumTilesY(iMipLevel) + y) * GetNumTilesX(iMipLevel) + x;
+	}
+	TileCoord GetTileCoord(int iTileIndex) const;
+	bool ResizePool(int iNumTiles);
+	void RebuildFreeList();
+	bool SubmitPending();
+
+	TiledResourceBackend* m_pBackend;
+	int m_iMipLevels;
+	std::vector<int> m_arrMipTiles;		//x, y and z tile counts a mip
+	std::vector<int> m_arrMipOffsets;	//first tile index of each mip
+	float m_fGrowthFactor;
+	float m_fCompactionThreshold;
+	int m_iMinFreeTilesToCompact;
+
+	std::vector<int> m_arrTileOffsets;	//pool offset of each tile, -1 for unmapped
+	std::vector<int> m_arrOffsetTiles;	//tile at each pool offset, -1 for free
+	std::priority_queue<int, std::vector<int>, std::greater<int>> m_FreeList;
+	std::vector<int> m_arrBatchFreed;	//go on the free list once the batch is submitted
+
+	TileMappingBatch m_Batch;
+	bool m_bBatching;
+
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !TILE_POOL_H
@@ -0,0 +1,664 @@
+#include "TileResidencyWorker.h"
+#include "TilePool.h"
+#include "CPUVoxeliser.h"
+#include "CPUVoxelVolume.h"
+#include "Debugging.h"
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Enough for the worker to be a couple of frames behind without a readback being skipped
+	const int kRingSize = 4;
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileResidencyWorker::TileResidencyWorker()
+	: m_bPredictResidency(false),
+	m_bThreaded(false),
+	m_bStop(false),
+	m_iJobsDone(0),
+	m_iJobsSubmitted(0),
+	m_iFrame(0),
+	m_iAppliedTiles(0),
+	m_fAppliedUs(0.f),
+	m_dTotalLatencyMs(0.0)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		m_iTiles[a] = 0;
+	}
+	m_Settings.iBudgetTiles = 0;
+	m_Settings.fBudgetUs = 0.f;
+	m_Settings.iLookaheadFrames = m_Predictor.GetLookaheadFrames();
+	m_Settings.iUnmapDelayFrames = m_Predictor.GetUnmapDelayFrames();
+	m_Settings.vFocus = XMFLOAT3(0.f, 0.f, 0.f);
+	m_LastSchedule = TileMappingScheduler::FrameStats();
+	m_LastResidency = ResidencyPredictor::Stats();
+	m_Latency = LatencyStats();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TileResidencyWorker::~TileResidencyWorker()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TileResidencyWorker::Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, int iTileWidth, int iTileHeight, int iTileDepth,
+	int iReadbackLatency, bool bPredictResidency, bool bThreaded)
+{
+	Shutdown();
+
+	m_iTiles[0] = iTilesX;
+	m_iTiles[1] = iTilesY;
+	m_iTiles[2] = iTilesZ;
+	m_bPredictResidency = bPredictResidency;
+	if (!m_Occupancy.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels))
+	{
+		return false;
+	}
+	m_Predictor.Initialise(iTilesX, iTilesY, iTilesZ, iTileWidth, iTileHeight, iTileDepth);
+	m_Predictor.SetReadbackLatency(iReadbackLatency);
+	m_Scheduler.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels, iTileWidth, iTileHeight, iTileDepth);
+
+	m_Jobs.Initialise(kRingSize);
+	m_Plans.Initialise(kRingSize);
+	m_iJobsDone = 0;
+	m_iJobsSubmitted = 0;
+	m_iFrame = 0;
+	m_iAppliedTiles = 0;
+	m_fAppliedUs = 0.f;
+	m_arrPendingBoxes.clear();
+	m_LastSchedule = TileMappingScheduler::FrameStats();
+	m_LastResidency = ResidencyPredictor::Stats();
+	m_Latency = LatencyStats();
+	m_dTotalLatencyMs = 0.0;
+
+	m_bThreaded = bThreaded;
+	if (m_bThreaded)
+	{
+		m_bStop = false;
+		m_Thread = std::thread(&TileResidencyWorker::WorkerThread, this);
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResidencyWorker::Shutdown()
+{
+	if (m_Thread.joinable())
+	{
+		m_bStop = true;
+		WakeWorker();
+		m_Thread.join();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResidencyWorker::AddPredictedBox(const int vMin[3], const int vMax[3])
+{
+	m_arrPendingBoxes.insert(m_arrPendingBoxes.end(), vMin, vMin + 3);
+	m_arrPendingBoxes.insert(m_arrPendingBoxes.end(), vMax, vMax + 3);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TileResidencyWorker::SubmitOccupancy(const uint8_t* pData, int iRowPitch, int iDepthPitch)
+{
+	m_iFrame++;
+	Job* pJob = m_Jobs.BeginPush();
+	if (!pJob)
+	{
+		//The boxes go with the next one, they'll still be about right
+		m_Latency.iNumDropped++;
+		return false;
+	}
+
+	//Packed, so the staging texture can be unmapped as soon as this returns
+	pJob->arrOccupancy.resize(static_cast<size_t>(m_iTiles[0]) * m_iTiles[1] * m_iTiles[2]);
+	uint8_t* pDest = pJob->arrOccupancy.data();
+	for (int z = 0; z < m_iTiles[2]; z++)
+	{
+		for (int y = 0; y < m_iTiles[1]; y++)
+		{
+			memcpy(pDest, pData + static_cast<size_t>(z) * iDepthPitch + static_cast<size_t>(y) * iRowPitch, m_iTiles[0]);
+			pDest += m_iTiles[0];
+		}
+	}
+	pJob->arrPredictedBoxes.swap(m_arrPendingBoxes);
+	m_arrPendingBoxes.clear();
+	pJob->settings = m_Settings;
+	pJob->iAppliedTiles = m_iAppliedTiles;
+	pJob->fAppliedUs = m_fAppliedUs;
+	m_iAppliedTiles = 0;
+	m_fAppliedUs = 0.f;
+	pJob->iFrame = m_iFrame;
+	pJob->readbackTime = Clock::now();
+	m_Jobs.EndPush();
+	m_iJobsSubmitted++;
+
+	if (m_bThreaded)
+	{
+		WakeWorker();
+	}
+	else
+	{
+		ProcessNextJob();
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResidencyWorker::WakeWorker()
+{
+	//Taking the lock means the worker's either waiting already or yet to check the rings, so the wake isn't lost
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+	}
+	m_WakeCondition.notify_one();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResidencyWorker::WorkerThread()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_WakeMutex);
+			m_WakeCondition.wait(lock, [this]() { return m_bStop.load() || !m_Jobs.IsEmpty(); });
+		}
+		if (m_bStop)
+		{
+			return;
+		}
+		ProcessNextJob();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResidencyWorker::ProcessNextJob()
+{
+	const Job* pJob = m_Jobs.BeginPop();
+	if (!pJob)
+	{
+		return;
+	}
+
+	//The render thread applies the plans every frame so there's soon room, unless it's stopping
+	Plan* pPlan = m_Plans.BeginPush();
+	while (!pPlan)
+	{
+		if (m_bStop)
+		{
+			return;
+		}
+		std::this_thread::yield();
+		pPlan = m_Plans.BeginPush();
+	}
+
+	ProcessJob(*pJob, *pPlan);
+	m_Jobs.EndPop();
+	m_Plans.EndPush();
+	m_iJobsDone++;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResidencyWorker::ProcessJob(const Job& job, Plan& plan)
+{
+	Clock::time_point start = Clock::now();
+
+	m_Predictor.SetLookaheadFrames(job.settings.iLookaheadFrames);
+	m_Predictor.SetUnmapDelayFrames(job.settings.iUnmapDelayFrames);
+	m_Scheduler.SetBudget(job.settings.iBudgetTiles, job.settings.fBudgetUs);
+	m_Scheduler.SetFocus(job.settings.vFocus);
+	m_Scheduler.ReportCost(job.iAppliedTiles, job.fAppliedUs);
+
+	m_Occupancy.LoadMip0(job.arrOccupancy.data(), m_iTiles[0], m_iTiles[0] * m_iTiles[1]);
+	if (m_bPredictResidency)
+	{
+		for (size_t i = 0; i + 6 <= job.arrPredictedBoxes.size(); i += 6)
+		{
+			m_Predictor.AddVoxelBox(&job.arrPredictedBoxes[i], &job.arrPredictedBoxes[i + 3]);
+		}
+		m_Predictor.Apply(m_Occupancy);
+	}
+
+	//Mips are occupied when any tile under them is, so they come and go with the mip 0 tiles
+	m_Occupancy.Update();
+
+	//Only as many maps as the budget allows go through this frame, the rest wait for the next
+	const std::vector<TileCoord>& arrOccupied = m_Occupancy.GetTilesToMap();
+	const std::vector<TileCoord>& arrEmptied = m_Occupancy.GetTilesToUnmap();
+	for (size_t i = 0; i < arrEmptied.size(); i++)
+	{
+		m_Scheduler.RequestUnmap(arrEmptied[i]);
+	}
+	for (size_t i = 0; i < arrOccupied.size(); i++)
+	{
+		m_Scheduler.RequestMap(arrOccupied[i]);
+	}
+	m_Scheduler.Schedule();
+
+	plan.arrTilesToMap = m_Scheduler.GetTilesToMap();
+	plan.arrTilesToUnmap = m_Scheduler.GetTilesToUnmap();
+	plan.schedule = m_Scheduler.GetFrameStats();
+	plan.residency = m_Predictor.GetStats();
+	plan.iFrame = job.iFrame;
+	plan.readbackTime = job.readbackTime;
+	plan.dProcessMs = GetElapsedMs(start);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResidencyWorker::Flush()
+{
+	if (!m_bThreaded)
+	{
+		return;
+	}
+	while (m_iJobsDone.load() < m_iJobsSubmitted)
+	{
+		std::this_thread::yield();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TileResidencyWorker::Reset()
+{
+	while (m_iJobsDone.load() < m_iJobsSubmitted)
+	{
+		if (m_Plans.BeginPop())
+		{
+			m_Plans.EndPop();
+		}
+		std::this_thread::yield();
+	}
+	while (m_Plans.BeginPop())
+	{
+		m_Plans.EndPop();
+	}
+
+	//The worker's idle with nothing to do, so its side can be touched from here
+	m_Occupancy.Clear();
+	m_Predictor.Clear();
+	m_Scheduler.Clear();
+	m_arrPendingBoxes.clear();
+	m_iAppliedTiles = 0;
+	m_fAppliedUs = 0.f;
+	m_LastSchedule = TileMappingScheduler::FrameStats();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TileResidencyWorker::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	//Sequence numbers through a small ring as fast as both sides can go, in place like the jobs are
+	{
+		const int iNumItems = 200000;
+		SPSCRing<std::vector<int>> ring;
+		ring.Initialise(4);
+		std::thread producer([&ring]()
+		{
+			for (int i = 0; i < iNumItems; i++)
+			{
+				std::vector<int>* pSlot = ring.BeginPush();
+				while (!pSlot)
+				{
+					std::this_thread::yield();
+					pSlot = ring.BeginPush();
+				}
+				pSlot->assign(1 + i % 7, i);
+				ring.EndPush();
+			}
+		});
+		int iExpected = 0;
+		while (iExpected < iNumItems)
+		{
+			std::vector<int>* pSlot = ring.BeginPop();
+			if (!pSlot)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			bool bMatches = static_cast<int>(pSlot->size()) == 1 + iExpected % 7;
+			for (size_t i = 0; i < pSlot->size(); i++)
+			{
+				bMatches = bMatches && (*pSlot)[i] == iExpected;
+			}
+			iFailures += !bMatches;
+			ring.EndPop();
+			iExpected++;
+		}
+		producer.join();
+		iFailures += !ring.IsEmpty();
+	}
+
+	//The same readbacks through both, never skipping one, with tile budgets only as the microsecond one depends on
+	//how long applying took
+	for (int iTest = 0; iTest < 4; iTest++)
+	{
+		int iTilesX = 1 + rng() % 12, iTilesY = 1 + rng() % 6, iTilesZ = 1 + rng() % 8;
+		int iMipLevels = 1 + rng() % 4;
+		int iRowPitch = iTilesX + rng() % 5;
+		int iDepthPitch = iRowPitch * iTilesY + rng() % 5;
+		bool bPredict = rng() % 2 == 0;
+		int iBudgetTiles = rng() % 2 ? 0 : 1 + rng() % 30;
+
+		TileResidencyWorker workers[2];
+		for (int w = 0; w < 2; w++)
+		{
+			workers[w].Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels, 32, 32, 16, 4, bPredict, w == 0);
+			workers[w].SetBudget(iBudgetTiles, 0.f);
+		}
+
+		std::vector<std::vector<int>> arrPlans[2];		//map and unmap tile indices, -1 between them
+		std::vector<uint8_t> arrMapped[2];
+		int iNumTiles = 0;
+		std::vector<int> arrMipOffsets(iMipLevels + 1, 0);
+		for (int m = 0; m < iMipLevels; m++)
+		{
+			arrMipOffsets[m + 1] = arrMipOffsets[m] + std::max(iTilesX >> m, 1) * std::max(iTilesY >> m, 1) * std::max(iTilesZ >> m, 1);
+		}
+		iNumTiles = arrMipOffsets[iMipLevels];
+		for (int w = 0; w < 2; w++)
+		{
+			arrMapped[w].assign(iNumTiles, 0);
+		}
+		auto applyPlan = [&](int w, const Plan& plan)
+		{
+			std::vector<int> arrRecord;
+			for (size_t i = 0; i < plan.arrTilesToUnmap.size(); i++)
+			{
+				const TileCoord& c = plan.arrTilesToUnmap[i];
+				int iTile = arrMipOffsets[c.iMipLevel] + (c.z * std::max(iTilesY >> c.iMipLevel, 1) + c.y) * std::max(iTilesX >> c.iMipLevel, 1) + c.x;
+				iFailures += arrMapped[w][iTile] != 1;
+				arrMapped[w][iTile] = 0;
+				arrRecord.push_back(iTile);
+			}
+			arrRecord.push_back(-1);
+			for (size_t i = 0; i < plan.arrTilesToMap.size(); i++)
+			{
+				const TileCoord& c = plan.arrTilesToMap[i];
+				int iTile = arrMipOffsets[c.iMipLevel] + (c.z * std::max(iTilesY >> c.iMipLevel, 1) + c.y) * std::max(iTilesX >> c.iMipLevel, 1) + c.x;
+				iFailures += arrMapped[w][iTile] != 0;
+				arrMapped[w][iTile] = 1;
+				arrRecord.push_back(iTile);
+			}
+			arrPlans[w].push_back(arrRecord);
+		};
+
+		std::vector<uint8_t> arrData(static_cast<size_t>(iDepthPitch) * iTilesZ, 0);
+		for (int f = 0; f < 60; f++)
+		{
+			for (size_t i = 0; i < arrData.size(); i++)
+			{
+				arrData[i] = rng() % 4 == 0;
+			}
+			int iNumBoxes = rng() % 3;
+			std::vector<int> arrBoxes;
+			for (int b = 0; b < iNumBoxes * 6; b++)
+			{
+				int iSize = (b % 3 == 0 ? iTilesX * 32 : (b % 3 == 1 ? iTilesY * 32 : iTilesZ * 16));
+				arrBoxes.push_back(static_cast<int>(rng() % (iSize + 1)));
+			}
+			XMFLOAT3 vFocus(static_cast<float>(rng() % 512), static_cast<float>(rng() % 512), static_cast<float>(rng() % 512));
+
+			for (int w = 0; w < 2; w++)
+			{
+				for (size_t b = 0; b < arrBoxes.size(); b += 6)
+				{
+					const int vMin[3] = { std::min(arrBoxes[b], arrBoxes[b + 3]), std::min(arrBoxes[b + 1], arrBoxes[b + 4]), std::min(arrBoxes[b + 2], arrBoxes[b + 5]) };
+					const int vMax[3] = { std::max(arrBoxes[b], arrBoxes[b + 3]), std::max(arrBoxes[b + 1], arrBoxes[b + 4]), std::max(arrBoxes[b + 2], arrBoxes[b + 5]) };
+					workers[w].AddPredictedBox(vMin, vMax);
+				}
+				workers[w].SetFocus(vFocus);
+				//Waiting for a free slot rather than skipping, applying meanwhile as the worker can't take another job
+				//until there's room for its plan
+				while (!workers[w].m_Jobs.BeginPush())
+				{
+					workers[w].ApplyPlans([&](const Plan& plan) { applyPlan(w, plan); });
+					std::this_thread::yield();
+				}
+				workers[w].SubmitOccupancy(arrData.data(), iRowPitch, iDepthPitch);
+				workers[w].ApplyPlans([&](const Plan& plan) { applyPlan(w, plan); });
+			}
+		}
+		workers[0].Flush();
+		workers[0].ApplyPlans([&](const Plan& plan) { applyPlan(0, plan); });
+
+		iFailures += arrPlans[0] != arrPlans[1];
+		iFailures += arrMapped[0] != arrMapped[1];
+		iFailures += workers[0].GetLatencyStats().iNumPlans != 60;
+		iFailures += workers[1].GetLatencyStats().iMaxFrames != 0;
+
+		//Nothing left behind after a reset, and it carries on from empty
+		workers[0].Reset();
+		iFailures += workers[0].ApplyPlans([](const Plan&) {}) != 0;
+		std::fill(arrData.begin(), arrData.end(), static_cast<uint8_t>(1));
+		workers[0].SetBudget(0, 0.f);
+		workers[0].SubmitOccupancy(arrData.data(), iRowPitch, iDepthPitch);
+		workers[0].Flush();
+		int iMapped = 0;
+		workers[0].ApplyPlans([&](const Plan& plan) { iMapped += static_cast<int>(plan.arrTilesToMap.size()); });
+		iFailures += iMapped != iNumTiles;
+	}
+
+	//A region voxelised for a while then left empty, as the readbacks come in now the occupation's cleared every
+	//frame. Its tiles have to be unmapped again while the rest of what's occupied stays.
+	{
+		const int iTilesX = 8, iTilesY = 4, iTilesZ = 8, iMipLevels = 3;
+		TileResidencyWorker worker;
+		worker.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels, 32, 32, 16, 4, false, false);
+		worker.SetBudget(0, 0.f);
+
+		std::vector<uint8_t> arrMapped(static_cast<size_t>(iTilesX) * iTilesY * iTilesZ, 0);
+		auto applyPlan = [&](const Plan& plan)
+		{
+			//Mip 0 only, the higher mips follow from it
+			for (size_t i = 0; i < plan.arrTilesToUnmap.size(); i++)
+			{
+				const TileCoord& c = plan.arrTilesToUnmap[i];
+				if (c.iMipLevel == 0)
+				{
+					int iTile = (c.z * iTilesY + c.y) * iTilesX + c.x;
+					iFailures += arrMapped[iTile] != 1;
+					arrMapped[iTile] = 0;
+				}
+			}
+			for (size_t i = 0; i < plan.arrTilesToMap.size(); i++)
+			{
+				const TileCoord& c = plan.arrTilesToMap[i];
+				if (c.iMipLevel == 0)
+				{
+					int iTile = (c.z * iTilesY + c.y) * iTilesX + c.x;
+					iFailures += arrMapped[iTile] != 0;
+					arrMapped[iTile] = 1;
+				}
+			}
+		};
+
+		int iStayX = rng() % iTilesX, iStayY = rng() % iTilesY, iStayZ = rng() % iTilesZ;
+		int iRegionX = rng() % (iTilesX - 1), iRegionY = rng() % (iTilesY - 1), iRegionZ = rng() % (iTilesZ - 1);
+		auto inRegion = [&](int x, int y, int z)
+		{
+			return x >= iRegionX && x <= iRegionX + 1 && y >= iRegionY && y <= iRegionY + 1 && z >= iRegionZ && z <= iRegionZ + 1;
+		};
+
+		std::vector<uint8_t> arrData(static_cast<size_t>(iTilesX) * iTilesY * iTilesZ, 0);
+		const int iOccupiedFrames = 10, iEmptyFrames = 30;
+		for (int f = 0; f < iOccupiedFrames + iEmptyFrames; f++)
+		{
+			for (int z = 0; z < iTilesZ; z++)
+			{
+				for (int y = 0; y < iTilesY; y++)
+				{
+					for (int x = 0; x < iTilesX; x++)
+					{
+						bool bStay = x == iStayX && y == iStayY && z == iStayZ;
+						arrData[(z * iTilesY + y) * iTilesX + x] = bStay || (f < iOccupiedFrames && inRegion(x, y, z));
+					}
+				}
+			}
+			worker.SubmitOccupancy(arrData.data(), iTilesX, iTilesX * iTilesY);
+			worker.ApplyPlans(applyPlan);
+
+			if (f == iOccupiedFrames - 1)
+			{
+				//Everything occupied should be mapped by now
+				for (size_t i = 0; i < arrData.size(); i++)
+				{
+					iFailures += arrData[i] && !arrMapped[i];
+				}
+			}
+		}
+
+		iFailures += arrMapped != arrData;
+	}
+
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TileResidencyWorker::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolution = 512;
+	const int iMipLevels = 4;		//as MIP_LEVELS
+	const int iNumFrames = 300;
+	//What the rest of the frame takes between tile updates, for the worker to get on in
+	const std::chrono::microseconds frameWork(2000);
+	const int iBudgetTiles[] = { 0, 256 };
+
+	std::stringstream ss;
+	ss << "../Results/TileResidencyWorker_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open tile residency worker benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Threaded, Budget Tiles, Frame, Render Thread(ms), Worker(ms), Latency(ms), Latency(frames), Mapped, Unmapped\n";
+
+	CPUVoxelVolume volume;
+	if (!volume.Initialise(iResolution, 1))
+	{
+		return false;
+	}
+	pVoxeliser->Voxelise(&volume);
+
+	int iTilesX = iResolution / TilePool::kTileWidth, iTilesY = iResolution / TilePool::kTileHeight, iTilesZ = iResolution / TilePool::kTileDepth;
+	//Padded rows like a mapped staging texture
+	int iRowPitch = (iTilesX + 255) & ~255;
+	int iDepthPitch = iRowPitch * iTilesY;
+	std::vector<uint8_t> arrStatic(static_cast<size_t>(iDepthPitch) * iTilesZ, 0);
+	for (int z = 0; z < iResolution; z++)
+	{
+		for (int y = 0; y < iResolution; y++)
+		{
+			for (int x = 0; x < iResolution; x++)
+			{
+				if (volume.GetVoxel(x, y, z) != 0)
+				{
+					arrStatic[(z / TilePool::kTileDepth) * iDepthPitch + (y / TilePool::kTileHeight) * iRowPitch + (x / TilePool::kTileWidth)] = 1;
+				}
+			}
+		}
+	}
+
+	std::stringstream summary;
+	int iFailures = 0;
+	for (int t = 0; t < 2; t++)
+	{
+		bool bThreaded = t == 1;
+		for (int b = 0; b < sizeof(iBudgetTiles) / sizeof(iBudgetTiles[0]); b++)
+		{
+			TileResidencyWorker worker;
+			worker.Initialise(iTilesX, iTilesY, iTilesZ, iMipLevels, TilePool::kTileWidth, TilePool::kTileHeight, TilePool::kTileDepth, 4, true, bThreaded);
+			worker.SetBudget(iBudgetTiles[b], 0.f);
+
+			std::vector<uint8_t> arrData;
+			std::vector<uint8_t> arrMapped;
+			double dRenderThreadMs = 0.0, dMaxRenderThreadMs = 0.0, dWorkerMs = 0.0;
+			for (int f = 0; f < iNumFrames; f++)
+			{
+				//A box sweeping along x through the static scene, with the boxes a frame ahead predicted
+				arrData = arrStatic;
+				int iBoxTiles = iTilesX / 4;
+				int iSweep = iTilesX - iBoxTiles;
+				int iBoxX = f % (2 * iSweep) < iSweep ? f % (2 * iSweep) : 2 * iSweep - f % (2 * iSweep);
+				for (int z = iTilesZ / 4; z < iTilesZ / 4 + iBoxTiles * 2; z++)
+				{
+					for (int y = iTilesY / 4; y < iTilesY / 4 + iBoxTiles; y++)
+					{
+						memset(&arrData[z * iDepthPitch + y * iRowPitch + iBoxX], 1, iBoxTiles);
+					}
+				}
+				const int vMin[3] = { (iBoxX + 1) * TilePool::kTileWidth, iTilesY / 4 * TilePool::kTileHeight, iTilesZ / 4 * TilePool::kTileDepth };
+				const int vMax[3] = { vMin[0] + iBoxTiles * TilePool::kTileWidth, vMin[1] + iBoxTiles * TilePool::kTileHeight, vMin[2] + iBoxTiles * 2 * TilePool::kTileDepth };
+
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				worker.AddPredictedBox(vMin, vMax);
+				worker.SubmitOccupancy(arrData.data(), iRowPitch, iDepthPitch);
+				int iMapped = 0, iUnmapped = 0;
+				double dPlanMs = 0.0;
+				worker.ApplyPlans([&](const Plan& plan)
+				{
+					iMapped += static_cast<int>(plan.arrTilesToMap.size());
+					iUnmapped += static_cast<int>(plan.arrTilesToUnmap.size());
+					dPlanMs += plan.dProcessMs;
+				});
+				double dMs = GetElapsedMs(start);
+				dRenderThreadMs += dMs;
+				dMaxRenderThreadMs = std::max(dMaxRenderThreadMs, dMs);
+				dWorkerMs += dPlanMs;
+
+				const LatencyStats& latency = worker.GetLatencyStats();
+				outfile << bThreaded << "," << iBudgetTiles[b] << "," << f << "," << dMs << "," << dPlanMs << "," << latency.fLastMs << "," << latency.iLastFrames << ","
+					<< iMapped << "," << iUnmapped << "\n";
+
+				std::this_thread::sleep_for(frameWork);
+			}
+
+			const LatencyStats& latency = worker.GetLatencyStats();
+			iFailures += latency.iNumPlans + latency.iNumDropped < iNumFrames - kRingSize;
+			summary << "\n" << (bThreaded ? "Threaded" : "Inline") << " Budget " << iBudgetTiles[b] << " Tiles Render Thread Average(ms):," << dRenderThreadMs / iNumFrames
+				<< ",Render Thread Max(ms):," << dMaxRenderThreadMs << ",Worker Average(ms):," << dWorkerMs / std::max(latency.iNumPlans, 1LL)
+				<< ",Latency Average(ms):," << latency.fAverageMs << ",Latency Max(ms):," << latency.fMaxMs << ",Latency Max(frames):," << latency.iMaxFrames
+				<< ",Readbacks Skipped:," << latency.iNumDropped;
+			VS_LOG(sName << " tile residency " << (bThreaded ? "threaded" : "inline") << " budget " << iBudgetTiles[b] << ": render thread "
+				<< dRenderThreadMs / iNumFrames << "ms a frame, latency " << latency.fAverageMs << "ms");
+		}
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iFailures == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,206 @@
+#ifndef TILE_RESIDENCY_WORKER_H
+#define TILE_RESIDENCY_WORKER_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "SPSCRing.h"
+#include "TileOccupancyBitset.h"
+#include "ResidencyPredictor.h"
+#include "TileMappingScheduler.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Works out the tile mappings from the occupation readback on a thread of its own, so the render thread only copies
+//the readback in and applies the mappings that come out. The occupancy diff, residency prediction and mapping schedule
+//all live on the worker; each frame the render thread pushes a job with the readback, the predicted boxes and the
+//settings onto one ring and pops finished plans off another, neither of which locks. Without a thread the jobs are
+//worked through as they're submitted, which is the same code without the handoff.
+class TileResidencyWorker
+{
+public:
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	//What to map and unmap, from one job
+	struct Plan
+	{
+		std::vector<TileCoord> arrTilesToMap;
+		std::vector<TileCoord> arrTilesToUnmap;
+		TileMappingScheduler::FrameStats schedule;
+		ResidencyPredictor::Stats residency;
+		int iFrame;					//counting SubmitOccupancy calls
+		Clock::time_point readbackTime;
+		double dProcessMs;			//worker time
+	};
+
+	//From the occupation being read back to its mappings being applied
+	struct LatencyStats
+	{
+		float fLastMs;
+		float fAverageMs;
+		float fMaxMs;
+		int iLastFrames;
+		int iMaxFrames;
+		long long iNumPlans;
+		long long iNumDropped;		//readbacks skipped because the worker was still busy with earlier ones
+	};
+
+	TileResidencyWorker();
+	~TileResidencyWorker();
+
+	//Same tile layout as TilePool with the mip 0 tile size in voxels. iReadbackLatency as in ResidencyPredictor.
+	//Without bThreaded there's no worker thread and SubmitOccupancy does the work itself.
+	bool Initialise(int iTilesX, int iTilesY, int iTilesZ, int iMipLevels, int iTileWidth, int iTileHeight, int iTileDepth,
+		int iReadbackLatency, bool bPredictResidency, bool bThreaded);
+	void Shutdown();
+
+	//Render thread settings, sent with each job
+	void SetBudget(int iMaxTiles, float fMaxMicroseconds) { m_Settings.iBudgetTiles = iMaxTiles; m_Settings.fBudgetUs = fMaxMicroseconds; }
+	void SetLookaheadFrames(int iFrames) { m_Settings.iLookaheadFrames = iFrames; }
+	int GetLookaheadFrames() const { return m_Settings.iLookaheadFrames; }
+	void SetUnmapDelayFrames(int iFrames) { m_Settings.iUnmapDelayFrames = iFrames; }
+	void SetFocus(const XMFLOAT3& vFocus) { m_Settings.vFocus = vFocus; }
+	bool IsPredictingResidency() const { return m_bPredictResidency; }
+
+	//Voxels [vMin, vMax), sent with the next job, see ResidencyPredictor::AddVoxelBox
+	void AddPredictedBox(const int vMin[3], const int vMax[3]);
+	//Copies the mip 0 occupation out, a byte a tile laid out like a mapped R8 texture, and hands it to the worker.
+	//False if the worker's still got every slot full, in which case this readback is skipped; the next one is diffed
+	//against the last one the worker saw, so nothing goes missing.
+	bool SubmitOccupancy(const uint8_t* pData, int iRowPitch, int iDepthPitch);
+
+	//Calls fnApply(plan) for every plan the worker has finished, oldest first, timing each one to learn what a tile
+	//costs from. Returns how many there were.
+	template<typename ApplyFunc>
+	int ApplyPlans(const ApplyFunc& fnApply);
+
+	//Waits for the worker to finish everything it's been given, leaving the plans to be applied. The worker can't
+	//finish a job without room for its plan, so apply them first if there could be a ring's worth waiting.
+	void Flush();
+	//Waits for the worker, throws away the plans it's made and forgets what's mapped, for when the tiles have all
+	//been unmapped some other way
+	void Reset();
+
+	//From the last plan applied
+	const TileMappingScheduler::FrameStats& GetScheduleStats() const { return m_LastSchedule; }
+	const ResidencyPredictor::Stats& GetResidencyStats() const { return m_LastResidency; }
+	bool HasPendingMappings() const { return m_LastSchedule.iNumPending > 0; }
+	const LatencyStats& GetLatencyStats() const { return m_Latency; }
+
+	//Lots of items through an SPSCRing between two threads, and the same random readbacks through a threaded worker
+	//and one without a thread, checking the plans come out the same and never map a mapped tile or unmap an unmapped
+	//one, and a region going from occupied to empty getting unmapped again. Meant to be run under ThreadSanitizer as
+	//well. Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Render thread time and readback to mapping latency with and without the thread, at 512^3 with a box moving
+	//through the voxeliser's occupancy. Writes to ../Results/
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	struct Settings
+	{
+		int iBudgetTiles;
+		float fBudgetUs;
+		int iLookaheadFrames;
+		int iUnmapDelayFrames;
+		XMFLOAT3 vFocus;
+	};
+
+	struct Job
+	{
+		std::vector<uint8_t> arrOccupancy;		//packed, iTilesX a row
+		std::vector<int> arrPredictedBoxes;		//min and max, 6 ints a box
+		Settings settings;
+		int iAppliedTiles;						//what the plans applied since the last job cost
+		float fAppliedUs;
+		int iFrame;
+		Clock::time_point readbackTime;
+	};
+
+	void WorkerThread();
+	void ProcessJob(const Job& job, Plan& plan);
+	//Worker side, waits for room to push the plan
+	void ProcessNextJob();
+	void WakeWorker();
+
+	int m_iTiles[3];
+	bool m_bPredictResidency;
+	bool m_bThreaded;
+
+	//Worker thread only, once it's started
+	TileOccupancyBitset m_Occupancy;
+	ResidencyPredictor m_Predictor;
+	TileMappingScheduler m_Scheduler;
+
+	SPSCRing<Job> m_Jobs;
+	SPSCRing<Plan> m_Plans;
+	std::thread m_Thread;
+	std::atomic<bool> m_bStop;
+	std::atomic<long long> m_iJobsDone;
+	//Only for sleeping while there's nothing to do, the jobs and plans go through the rings
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeCondition;
+
+	//Render thread only
+	Settings m_Settings;
+	std::vector<int> m_arrPendingBoxes;
+	long long m_iJobsSubmitted;
+	int m_iFrame;
+	int m_iAppliedTiles;
+	float m_fAppliedUs;
+	TileMappingScheduler::FrameStats m_LastSchedule;
+	ResidencyPredictor::Stats m_LastResidency;
+	LatencyStats m_Latency;
+	double m_dTotalLatencyMs;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename ApplyFunc>
+int TileResidencyWorker::ApplyPlans(const ApplyFunc& fnApply)
+{
+	int iNumPlans = 0;
+	for (Plan* pPlan = m_Plans.BeginPop(); pPlan; pPlan = m_Plans.BeginPop())
+	{
+		Clock::time_point start = Clock::now();
+		fnApply(*pPlan);
+		Clock::time_point end = Clock::now();
+		m_iAppliedTiles += static_cast<int>(pPlan->arrTilesToMap.size() + pPlan->arrTilesToUnmap.size());
+		m_fAppliedUs += std::chrono::duration<float, std::micro>(end - start).count();
+
+		m_LastSchedule = pPlan->schedule;
+		m_LastResidency = pPlan->residency;
+		m_Latency.fLastMs = std::chrono::duration<float, std::milli>(end - pPlan->readbackTime).count();
+		m_Latency.iLastFrames = m_iFrame - pPlan->iFrame;
+		m_Latency.fMaxMs = std::max(m_Latency.fMaxMs, m_Latency.fLastMs);
+		m_Latency.iMaxFrames = std::max(m_Latency.iMaxFrames, m_Latency.iLastFrames);
+		m_Latency.iNumPlans++;
+		m_dTotalLatencyMs += m_Latency.fLastMs;
+		m_Latency.fAverageMs = static_cast<float>(m_dTotalLatencyMs / m_Latency.iNumPlans);
+
+		m_Plans.EndPop();
+		iNumPlans++;
+	}
+	return iNumPlans;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !TILE_RESIDENCY_WORKER_H
@@ -0,0 +1,50 @@
+#ifndef TILED_RESOURCE_BACKEND_H
+#define TILED_RESOURCE_BACKEND_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//A tile of a tiled volume, in tiles at its mip level
+struct TileCoord
+{
+	int x;
+	int y;
+	int z;
+	int iMipLevel;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//iNumTiles tiles of one mip from start on in x, then y, then z order, mapped to the pool tiles from iPoolOffset on or
+//unmapped when iPoolOffset is -1
+struct TileRange
+{
+	TileCoord start;
+	int iNumTiles;
+	int iPoolOffset;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//The tile pool and tile mapping operations a tiled volume needs, so the bookkeeping in TilePool can run against the
+//D3D11 tiled resources (D3DTiledResourceBackend in Texture3D.h) or a stand-in without a GPU
+class TiledResourceBackend
+{
+public:
+	virtual ~TiledResourceBackend() {}
+
+	//Grows or shrinks the pool to iNumTiles. Tiles past the end mustn't be mapped when it shrinks.
+	virtual bool ResizePool(int iNumTiles) = 0;
+	//Points the tile at iPoolOffset, replacing whatever it was mapped to before
+	virtual bool MapTile(const TileCoord& coord, int iPoolOffset) = 0;
+	virtual bool UnmapTile(const TileCoord& coord) = 0;
+	//All of the ranges in a single call, they're on the same mip and don't overlap. Which order they're applied in
+	//mustn't matter, so an offset one range frees can be used by another. bOnlyNewMaps when every tile in the call
+	//was unmapped and is being mapped, so nothing already submitted to the GPU can be using what changes.
+	virtual bool UpdateTileRanges(const TileRange* pRanges, int iNumRanges, bool bOnlyNewMaps) = 0;
+	//Unmaps every tile of every mip
+	virtual bool UnmapAll() = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !TILED_RESOURCE_BACKEND_H
@@ -0,0 +1,800 @@
+#include "NoFloatContraction.h"
+#include "TriangleBoxOverlap.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define OVERLAP_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+//gcc/clang only emit AVX2 inside functions marked for it, the rest of the file stays plain SSE2
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define OVERLAP_X86_SIMD 0
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SIMDLevel TriangleBoxOverlap::s_eLevel = simdMax;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	inline float Min3(float a, float b, float c) { return std::min(a, std::min(b, c)); }
+	inline float Max3(float a, float b, float c) { return std::max(a, std::max(b, c)); }
+
+	//true if [min(p), max(p)] misses [-r, r]
+	inline bool AxisRejects(float p0, float p1, float p2, float r)
+	{
+		return Min3(p0, p1, p2) > r || Max3(p0, p1, p2) < -r;
+	}
+
+	//The edge cross X axis test only depends on y and z, so it is the same for every voxel in a row along x
+	inline bool EdgeCrossXRejects(const XMFLOAT3& e, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c, float h)
+	{
+		return AxisRejects(e.y * a.z - e.z * a.y, e.y * b.z - e.z * b.y, e.y * c.z - e.z * c.y, h * (fabsf(e.z) + fabsf(e.y)));
+	}
+
+	inline bool EdgeCrossYRejects(const XMFLOAT3& e, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c, float h)
+	{
+		return AxisRejects(e.z * a.x - e.x * a.z, e.z * b.x - e.x * b.z, e.z * c.x - e.x * c.z, h * (fabsf(e.z) + fabsf(e.x)));
+	}
+
+	inline bool EdgeCrossZRejects(const XMFLOAT3& e, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c, float h)
+	{
+		return AxisRejects(e.x * a.y - e.y * a.x, e.x * b.y - e.y * b.x, e.x * c.y - e.y * c.x, h * (fabsf(e.y) + fabsf(e.x)));
+	}
+
+	inline float GetAxis(const XMFLOAT3& v, int iAxis)
+	{
+		return iAxis == 0 ? v.x : (iAxis == 1 ? v.y : v.z);
+	}
+
+	inline XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	int TestVoxelRowScalar(const OverlapTriangle& tri, int iStartX, int y, int z, int iCount, uint8_t* pOverlaps)
+	{
+		int iNumOverlaps = 0;
+		for (int i = 0; i < iCount; i++)
+		{
+			XMFLOAT3 vCentre((iStartX + i) + 0.5f, y + 0.5f, z + 0.5f);
+			pOverlaps[i] = TriangleBoxOverlap::Test(tri, vCentre, 0.5f) ? 1 : 0;
+			iNumOverlaps += pOverlaps[i];
+		}
+		return iNumOverlaps;
+	}
+
+	int TestTrianglesScalar(const OverlapTriangleBatch& batch, int iFirst, int iCount, const XMFLOAT3& vCentre, float fHalfSize, uint8_t* pOverlaps)
+	{
+		int iNumOverlaps = 0;
+		OverlapTriangle tri;
+		for (int i = 0; i < iCount; i++)
+		{
+			int t = iFirst + i;
+			tri.Setup(XMFLOAT3(batch.v[0][0][t], batch.v[0][1][t], batch.v[0][2][t]),
+					  XMFLOAT3(batch.v[1][0][t], batch.v[1][1][t], batch.v[1][2][t]),
+					  XMFLOAT3(batch.v[2][0][t], batch.v[2][1][t], batch.v[2][2][t]));
+			pOverlaps[i] = TriangleBoxOverlap::Test(tri, vCentre, fHalfSize) ? 1 : 0;
+			iNumOverlaps += pOverlaps[i];
+		}
+		return iNumOverlaps;
+	}
+
+#if OVERLAP_X86_SIMD
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	//SSE - 4 lanes
+
+	struct SSEConsts
+	{
+		__m128 absMask;
+		__m128 signMask;
+		SSEConsts()
+		{
+			absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+			signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+		}
+	};
+
+	inline __m128 AxisRejectsSSE(__m128 p0, __m128 p1, __m128 p2, __m128 r, const SSEConsts& k)
+	{
+		__m128 vMin = _mm_min_ps(p0, _mm_min_ps(p1, p2));
+		__m128 vMax = _mm_max_ps(p0, _mm_max_ps(p1, p2));
+		return _mm_or_ps(_mm_cmpgt_ps(vMin, r), _mm_cmplt_ps(vMax, _mm_xor_ps(r, k.signMask)));
+	}
+
+	//p = e1 * a2 - e2 * a1 for the three vertices, r = h * (|e2| + |e1|)
+	inline __m128 EdgeAxisRejectsSSE(__m128 e1, __m128 e2, __m128 a1, __m128 a2, __m128 b1, __m128 b2, __m128 c1, __m128 c2, __m128 h, const SSEConsts& k)
+	{
+		__m128 p0 = _mm_sub_ps(_mm_mul_ps(e1, a2), _mm_mul_ps(e2, a1));
+		__m128 p1 = _mm_sub_ps(_mm_mul_ps(e1, b2), _mm_mul_ps(e2, b1));
+		__m128 p2 = _mm_sub_ps(_mm_mul_ps(e1, c2), _mm_mul_ps(e2, c1));
+		__m128 r = _mm_mul_ps(h, _mm_add_ps(_mm_and_ps(e2, k.absMask), _mm_and_ps(e1, k.absMask)));
+		return AxisRejectsSSE(p0, p1, p2, r, k);
+	}
+
+	inline __m128 PlaneRejectsSSE(__m128 nx, __m128 ny, __m128 nz, __m128 ax, __m128 ay, __m128 az, __m128 h, const SSEConsts& k)
+	{
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, ax), _mm_mul_ps(ny, ay)), _mm_mul_ps(nz, az));
+		__m128 r = _mm_mul_ps(h, _mm_add_ps(_mm_add_ps(_mm_and_ps(nx, k.absMask), _mm_and_ps(ny, k.absMask)), _mm_and_ps(nz, k.absMask)));
+		return _mm_or_ps(_mm_cmpgt_ps(d, r), _mm_cmplt_ps(d, _mm_xor_ps(r, k.signMask)));
+	}
+
+	int TestVoxelRowSSE(const OverlapTriangle& tri, int iStartX, int y, int z, int iCount, uint8_t* pOverlaps)
+	{
+		const float h = 0.5f;
+		XMFLOAT3 vCentreYZ(0.f, y + 0.5f, z + 0.5f);
+		XMFLOAT3 a(0.f, tri.v[0].y - vCentreYZ.y, tri.v[0].z - vCentreYZ.z);
+		XMFLOAT3 b(0.f, tri.v[1].y - vCentreYZ.y, tri.v[1].z - vCentreYZ.z);
+		XMFLOAT3 c(0.f, tri.v[2].y - vCentreYZ.y, tri.v[2].z - vCentreYZ.z);
+
+		//Everything that doesn't depend on x is the same for the whole row, so do it once
+		if (AxisRejects(a.y, b.y, c.y, h) || AxisRejects(a.z, b.z, c.z, h) ||
+			EdgeCrossXRejects(tri.e[0], a, b, c, h) || EdgeCrossXRejects(tri.e[1], a, b, c, h) || EdgeCrossXRejects(tri.e[2], a, b, c, h))
+		{
+			memset(pOverlaps, 0, iCount);
+			return 0;
+		}
+
+		const SSEConsts k;
+		const __m128 vH = _mm_set1_ps(h);
+		const __m128 vHalf = _mm_set1_ps(0.5f);
+		const __m128 ay = _mm_set1_ps(a.y), az = _mm_set1_ps(a.z);
+		const __m128 by = _mm_set1_ps(b.y), bz = _mm_set1_ps(b.z);
+		const __m128 cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+		const __m128 v0x = _mm_set1_ps(tri.v[0].x), v1x = _mm_set1_ps(tri.v[1].x), v2x = _mm_set1_ps(tri.v[2].x);
+		const __m128 nx = _mm_set1_ps(tri.n.x), ny = _mm_set1_ps(tri.n.y), nz = _mm_set1_ps(tri.n.z);
+		__m128 e[3][3];
+		for (int i = 0; i < 3; i++)
+		{
+			e[i][0] = _mm_set1_ps(tri.e[i].x);
+			e[i][1] = _mm_set1_ps(tri.e[i].y);
+			e[i][2] = _mm_set1_ps(tri.e[i].z);
+		}
+
+		int iNumOverlaps = 0;
+		__m128i vX = _mm_add_epi32(_mm_set1_epi32(iStartX), _mm_setr_epi32(0, 1, 2, 3));
+		for (int i = 0; i < iCount; i += 4)
+		{
+			__m128 vCentreX = _mm_add_ps(_mm_cvtepi32_ps(vX), vHalf);
+			__m128 ax = _mm_sub_ps(v0x, vCentreX);
+			__m128 bx = _mm_sub_ps(v1x, vCentreX);
+			__m128 cx = _mm_sub_ps(v2x, vCentreX);
+
+			__m128 vReject = AxisRejectsSSE(ax, bx, cx, vH, k);
+			vReject = _mm_or_ps(vReject, PlaneRejectsSSE(nx, ny, nz, ax, ay, az, vH, k));
+			for (int j = 0; j < 3; j++)
+			{
+				//edge cross Y: e.z * a.x - e.x * a.z, edge cross Z: e.x * a.y - e.y * a.x
+				vReject = _mm_or_ps(vReject, EdgeAxisRejectsSSE(e[j][2], e[j][0], az, ax, bz, bx, cz, cx, vH, k));
+				vReject = _mm_or_ps(vReject, EdgeAxisRejectsSSE(e[j][0], e[j][1], ax, ay, bx, by, cx, cy, vH, k));
+			}
+
+			int iMask = _mm_movemask_ps(vReject);
+			int iLanes = std::min(4, iCount - i);
+			for (int l = 0; l < iLanes; l++)
+			{
+				pOverlaps[i + l] = (iMask >> l) & 1 ? 0 : 1;
+				iNumOverlaps += pOverlaps[i + l];
+			}
+			vX = _mm_add_epi32(vX, _mm_set1_epi32(4));
+		}
+		return iNumOverlaps;
+	}
+
+	int TestTrianglesSSE(const OverlapTriangleBatch& batch, int iFirst, int iCount, const XMFLOAT3& vCentre, float fHalfSize, uint8_t* pOverlaps)
+	{
+		const SSEConsts k;
+		const __m128 vH = _mm_set1_ps(fHalfSize);
+		const __m128 vCentreX = _mm_set1_ps(vCentre.x), vCentreY = _mm_set1_ps(vCentre.y), vCentreZ = _mm_set1_ps(vCentre.z);
+
+		int iNumOverlaps = 0;
+		int i = 0;
+		for (; i + 4 <= iCount; i += 4)
+		{
+			int t = iFirst + i;
+			__m128 v[3][3];
+			for (int vert = 0; vert < 3; vert++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					v[vert][axis] = _mm_loadu_ps(&batch.v[vert][axis][t]);
+				}
+			}
+
+			//Same as OverlapTriangle::Setup
+			__m128 e[3][3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				e[0][axis] = _mm_sub_ps(v[1][axis], v[0][axis]);
+				e[1][axis] = _mm_sub_ps(v[2][axis], v[1][axis]);
+				e[2][axis] = _mm_sub_ps(v[0][axis], v[2][axis]);
+			}
+			__m128 nx = _mm_sub_ps(_mm_mul_ps(e[0][1], e[1][2]), _mm_mul_ps(e[0][2], e[1][1]));
+			__m128 ny = _mm_sub_ps(_mm_mul_ps(e[0][2], e[1][0]), _mm_mul_ps(e[0][0], e[1][2]));
+			__m128 nz = _mm_sub_ps(_mm_mul_ps(e[0][0], e[1][1]), _mm_mul_ps(e[0][1], e[1][0]));
+
+			__m128 ax = _mm_sub_ps(v[0][0], vCentreX), ay = _mm_sub_ps(v[0][1], vCentreY), az = _mm_sub_ps(v[0][2], vCentreZ);
+			__m128 bx = _mm_sub_ps(v[1][0], vCentreX), by = _mm_sub_ps(v[1][1], vCentreY), bz = _mm_sub_ps(v[1][2], vCentreZ);
+			__m128 cx = _mm_sub_ps(v[2][0], vCentreX), cy = _mm_sub_ps(v[2][1], vCentreY), cz = _mm_sub_ps(v[2][2], vCentreZ);
+
+			__m128 vReject = AxisRejectsSSE(ax, bx, cx, vH, k);
+			vReject = _mm_or_ps(vReject, AxisRejectsSSE(ay, by, cy, vH, k));
+			vReject = _mm_or_ps(vReject, AxisRejectsSSE(az, bz, cz, vH, k));
+			vReject = _mm_or_ps(vReject, PlaneRejectsSSE(nx, ny, nz, ax, ay, az, vH, k));
+			for (int j = 0; j < 3; j++)
+			{
+				vReject = _mm_or_ps(vReject, EdgeAxisRejectsSSE(e[j][1], e[j][2], ay, az, by, bz, cy, cz, vH, k));
+				vReject = _mm_or_ps(vReject, EdgeAxisRejectsSSE(e[j][2], e[j][0], az, ax, bz, bx, cz, cx, vH, k));
+				vReject = _mm_or_ps(vReject, EdgeAxisRejectsSSE(e[j][0], e[j][1], ax, ay, bx, by, cx, cy, vH, k));
+			}
+
+			int iMask = _mm_movemask_ps(vReject);
+			for (int l = 0; l < 4; l++)
+			{
+				pOverlaps[i + l] = (iMask >> l) & 1 ? 0 : 1;
+				iNumOverlaps += pOverlaps[i + l];
+			}
+		}
+		return iNumOverlaps + TestTrianglesScalar(batch, iFirst + i, iCount - i, vCentre, fHalfSize, pOverlaps + i);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	//AVX2 - 8 lanes, exactly the same maths as the SSE version
+
+	TARGET_AVX2 inline __m256 AxisRejectsAVX(__m256 p0, __m256 p1, __m256 p2, __m256 r, __m256 signMask)
+	{
+		__m256 vMin = _mm256_min_ps(p0, _mm256_min_ps(p1, p2));
+		__m256 vMax = _mm256_max_ps(p0, _mm256_max_ps(p1, p2));
+		return _mm256_or_ps(_mm256_cmp_ps(vMin, r, _CMP_GT_OQ), _mm256_cmp_ps(vMax, _mm256_xor_ps(r, signMask), _CMP_LT_OQ));
+	}
+
+	TARGET_AVX2 inline __m256 EdgeAxisRejectsAVX(__m256 e1, __m256 e2, __m256 a1, __m256 a2, __m256 b1, __m256 b2, __m256 c1, __m256 c2, __m256 h, __m256 absMask, __m256 signMask)
+	{
+		__m256 p0 = _mm256_sub_ps(_mm256_mul_ps(e1, a2), _mm256_mul_ps(e2, a1));
+		__m256 p1 = _mm256_sub_ps(_mm256_mul_ps(e1, b2), _mm256_mul_ps(e2, b1));
+		__m256 p2 = _mm256_sub_ps(_mm256_mul_ps(e1, c2), _mm256_mul_ps(e2, c1));
+		__m256 r = _mm256_mul_ps(h, _mm256_add_ps(_mm256_and_ps(e2, absMask), _mm256_and_ps(e1, absMask)));
+		return AxisRejectsAVX(p0, p1, p2, r, signMask);
+	}
+
+	TARGET_AVX2 inline __m256 PlaneRejectsAVX(__m256 nx, __m256 ny, __m256 nz, __m256 ax, __m256 ay, __m256 az, __m256 h, __m256 absMask, __m256 signMask)
+	{
+		__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, ax), _mm256_mul_ps(ny, ay)), _mm256_mul_ps(nz, az));
+		__m256 r = _mm256_mul_ps(h, _mm256_add_ps(_mm256_add_ps(_mm256_and_ps(nx, absMask), _mm256_and_ps(ny, absMask)), _mm256_and_ps(nz, absMask)));
+		return _mm256_or_ps(_mm256_cmp_ps(d, r, _CMP_GT_OQ), _mm256_cmp_ps(d, _mm256_xor_ps(r, signMask), _CMP_LT_OQ));
+	}
+
+	TARGET_AVX2 int TestVoxelRowAVX2(const OverlapTriangle& tri, int iStartX, int y, int z, int iCount, uint8_t* pOverlaps)
+	{
+		const float h = 0.5f;
+		XMFLOAT3 vCentreYZ(0.f, y + 0.5f, z + 0.5f);
+		XMFLOAT3 a(0.f, tri.v[0].y - vCentreYZ.y, tri.v[0].z - vCentreYZ.z);
+		XMFLOAT3 b(0.f, tri.v[1].y - vCentreYZ.y, tri.v[1].z - vCentreYZ.z);
+		XMFLOAT3 c(0.f, tri.v[2].y - vCentreYZ.y, tri.v[2].z - vCentreYZ.z);
+
+		if (AxisRejects(a.y, b.y, c.y, h) || AxisRejects(a.z, b.z, c.z, h) ||
+			EdgeCrossXRejects(tri.e[0], a, b, c, h) || EdgeCrossXRejects(tri.e[1], a, b, c, h) || EdgeCrossXRejects(tri.e[2], a, b, c, h))
+		{
+			memset(pOverlaps, 0, iCount);
+			return 0;
+		}
+
+		const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+		const __m256 vH = _mm256_set1_ps(h);
+		const __m256 vHalf = _mm256_set1_ps(0.5f);
+		const __m256 ay = _mm256_set1_ps(a.y), az = _mm256_set1_ps(a.z);
+		const __m256 by = _mm256_set1_ps(b.y), bz = _mm256_set1_ps(b.z);
+		const __m256 cy = _mm256_set1_ps(c.y), cz = _mm256_set1_ps(c.z);
+		const __m256 v0x = _mm256_set1_ps(tri.v[0].x), v1x = _mm256_set1_ps(tri.v[1].x), v2x = _mm256_set1_ps(tri.v[2].x);
+		const __m256 nx = _mm256_set1_ps(tri.n.x), ny = _mm256_set1_ps(tri.n.y), nz = _mm256_set1_ps(tri.n.z);
+		__m256 e[3][3];
+		for (int i = 0; i < 3; i++)
+		{
+			e[i][0] = _mm256_set1_ps(tri.e[i].x);
+			e[i][1] = _mm256_set1_ps(tri.e[i].y);
+			e[i][2] = _mm256_set1_ps(tri.e[i].z);
+		}
+
+		int iNumOverlaps = 0;
+		__m256i vX = _mm256_add_epi32(_mm256_set1_epi32(iStartX), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		for (int i = 0; i < iCount; i += 8)
+		{
+			__m256 vCentreX = _mm256_add_ps(_mm256_cvtepi32_ps(vX), vHalf);
+			__m256 ax = _mm256_sub_ps(v0x, vCentreX);
+			__m256 bx = _mm256_sub_ps(v1x, vCentreX);
+			__m256 cx = _mm256_sub_ps(v2x, vCentreX);
+
+			__m256 vReject = AxisRejectsAVX(ax, bx, cx, vH, signMask);
+			vReject = _mm256_or_ps(vReject, PlaneRejectsAVX(nx, ny, nz, ax, ay, az, vH, absMask, signMask));
+			for (int j = 0; j < 3; j++)
+			{
+				vReject = _mm256_or_ps(vReject, EdgeAxisRejectsAVX(e[j][2], e[j][0], az, ax, bz, bx, cz, cx, vH, absMask, signMask));
+				vReject = _mm256_or_ps(vReject, EdgeAxisRejectsAVX(e[j][0], e[j][1], ax, ay, bx, by, cx, cy, vH, absMask, signMask));
+			}
+
+			int iMask = _mm256_movemask_ps(vReject);
+			int iLanes = std::min(8, iCount - i);
+			for (int l = 0; l < iLanes; l++)
+			{
+				pOverlaps[i + l] = (iMask >> l) & 1 ? 0 : 1;
+				iNumOverlaps += pOverlaps[i + l];
+			}
+			vX = _mm256_add_epi32(vX, _mm256_set1_epi32(8));
+		}
+		_mm256_zeroupper();
+		return iNumOverlaps;
+	}
+
+	TARGET_AVX2 int TestTrianglesAVX2(const OverlapTriangleBatch& batch, int iFirst, int iCount, const XMFLOAT3& vCentre, float fHalfSize, uint8_t* pOverlaps)
+	{
+		const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+		const __m256 vH = _mm256_set1_ps(fHalfSize);
+		const __m256 vCentreX = _mm256_set1_ps(vCentre.x), vCentreY = _mm256_set1_ps(vCentre.y), vCentreZ = _mm256_set1_ps(vCentre.z);
+
+		int iNumOverlaps = 0;
+		int i = 0;
+		for (; i + 8 <= iCount; i += 8)
+		{
+			int t = iFirst + i;
+			__m256 v[3][3];
+			for (int vert = 0; vert < 3; vert++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					v[vert][axis] = _mm256_loadu_ps(&batch.v[vert][axis][t]);
+				}
+			}
+
+			__m256 e[3][3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				e[0][axis] = _mm256_sub_ps(v[1][axis], v[0][axis]);
+				e[1][axis] = _mm256_sub_ps(v[2][axis], v[1][axis]);
+				e[2][axis] = _mm256_sub_ps(v[0][axis], v[2][axis]);
+			}
+			__m256 nx = _mm256_sub_ps(_mm256_mul_ps(e[0][1], e[1][2]), _mm256_mul_ps(e[0][2], e[1][1]));
+			__m256 ny = _mm256_sub_ps(_mm256_mul_ps(e[0][2], e[1][0]), _mm256_mul_ps(e[0][0], e[1][2]));
+			__m256 nz = _mm256_sub_ps(_mm256_mul_ps(e[0][0], e[1][1]), _mm256_mul_ps(e[0][1], e[1][0]));
+
+			__m256 ax = _mm256_sub_ps(v[0][0], vCentreX), ay = _mm256_sub_ps(v[0][1], vCentreY), az = _mm256_sub_ps(v[0][2], vCentreZ);
+			__m256 bx = _mm256_sub_ps(v[1][0], vCentreX), by = _mm256_sub_ps(v[1][1], vCentreY), bz = _mm256_sub_ps(v[1][2], vCentreZ);
+			__m256 cx = _mm256_sub_ps(v[2][0], vCentreX), cy = _mm256_sub_ps(v[2][1], vCentreY), cz = _mm256_sub_ps(v[2][2], vCentreZ);
+
+			__m256 vReject = AxisRejectsAVX(ax, bx, cx, vH, signMask);
+			vReject = _mm256_or_ps(vReject, AxisRejectsAVX(ay, by, cy, vH, signMask));
+			vReject = _mm256_or_ps(vReject, AxisRejectsAVX(az, bz, cz, vH, signMask));
+			vReject = _mm256_or_ps(vReject, PlaneRejectsAVX(nx, ny, nz, ax, ay, az, vH, absMask, signMask));
+			for (int j = 0; j < 3; j++)
+			{
+				vReject = _mm256_or_ps(vReject, EdgeAxisRejectsAVX(e[j][1], e[j][2], ay, az, by, bz, cy, cz, vH, absMask, signMask));
+				vReject = _mm256_or_ps(vReject, EdgeAxisRejectsAVX(e[j][2], e[j][0], az, ax, bz, bx, cz, cx, vH, absMask, signMask));
+				vReject = _mm256_or_ps(vReject, EdgeAxisRejectsAVX(e[j][0], e[j][1], ax, ay, bx, by, cx, cy, vH, absMask, signMask));
+			}
+
+			int iMask = _mm256_movemask_ps(vReject);
+			for (int l = 0; l < 8; l++)
+			{
+				pOverlaps[i + l] = (iMask >> l) & 1 ? 0 : 1;
+				iNumOverlaps += pOverlaps[i + l];
+			}
+		}
+		_mm256_zeroupper();
+		return iNumOverlaps + TestTrianglesScalar(batch, iFirst + i, iCount - i, vCentre, fHalfSize, pOverlaps + i);
+	}
+
+#endif // OVERLAP_X86_SIMD
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OverlapTriangle::Setup(const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2)
+{
+	v[0] = v0;
+	v[1] = v1;
+	v[2] = v2;
+	e[0] = Sub(v1, v0);
+	e[1] = Sub(v2, v1);
+	e[2] = Sub(v0, v2);
+	n.x = e[0].y * e[1].z - e[0].z * e[1].y;
+	n.y = e[0].z * e[1].x - e[0].x * e[1].z;
+	n.z = e[0].x * e[1].y - e[0].y * e[1].x;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OverlapTriangleBatch::Clear()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			v[i][j].clear();
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OverlapTriangleBatch::Add(const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2)
+{
+	const XMFLOAT3* pVerts[3] = { &v0, &v1, &v2 };
+	for (int i = 0; i < 3; i++)
+	{
+		v[i][0].push_back(pVerts[i]->x);
+		v[i][1].push_back(pVerts[i]->y);
+		v[i][2].push_back(pVerts[i]->z);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SIMDLevel TriangleBoxOverlap::GetSupportedLevel()
+{
+#if OVERLAP_X86_SIMD
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int iMaxLeaf = info[0];
+	__cpuid(info, 1);
+	bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	bool bAVX = (info[2] & (1 << 28)) != 0;
+	//the OS has to be saving the ymm registers as well as the CPU supporting them
+	if (iMaxLeaf >= 7 && bOSXSave && bAVX && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5))
+		{
+			return simdAVX2;
+		}
+	}
+	return simdSSE;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return simdAVX2;
+	}
+	return __builtin_cpu_supports("sse2") ? simdSSE : simdScalar;
+#endif
+#else
+	return simdScalar;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void TriangleBoxOverlap::SetLevel(SIMDLevel eLevel)
+{
+	s_eLevel = std::min(eLevel, GetSupportedLevel());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+SIMDLevel TriangleBoxOverlap::GetLevel()
+{
+	if (s_eLevel == simdMax)
+	{
+		s_eLevel = GetSupportedLevel();
+	}
+	return s_eLevel;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* TriangleBoxOverlap::GetLevelName(SIMDLevel eLevel)
+{
+	switch (eLevel)
+	{
+	case simdScalar:
+		return "Scalar";
+	case simdSSE:
+		return "SSE";
+	case simdAVX2:
+		return "AVX2";
+	default:
+		return "Unknown";
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TriangleBoxOverlap::Test(const OverlapTriangle& tri, const XMFLOAT3& vCentre, float fHalfSize)
+{
+	const float h = fHalfSize;
+	XMFLOAT3 a = Sub(tri.v[0], vCentre);
+	XMFLOAT3 b = Sub(tri.v[1], vCentre);
+	XMFLOAT3 c = Sub(tri.v[2], vCentre);
+
+	//box axes
+	if (AxisRejects(a.x, b.x, c.x, h) || AxisRejects(a.y, b.y, c.y, h) || AxisRejects(a.z, b.z, c.z, h))
+	{
+		return false;
+	}
+
+	//triangle plane
+	float d = tri.n.x * a.x + tri.n.y * a.y + tri.n.z * a.z;
+	float r = h * (fabsf(tri.n.x) + fabsf(tri.n.y) + fabsf(tri.n.z));
+	if (d > r || d < -r)
+	{
+		return false;
+	}
+
+	//edges cross box axes
+	for (int i = 0; i < 3; i++)
+	{
+		if (EdgeCrossXRejects(tri.e[i], a, b, c, h) || EdgeCrossYRejects(tri.e[i], a, b, c, h) || EdgeCrossZRejects(tri.e[i], a, b, c, h))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TriangleBoxOverlap::TestVoxelRow(const OverlapTriangle& tri, int iStartX, int y, int z, int iCount, uint8_t* pOverlaps)
+{
+	return TestVoxelRow(GetLevel(), tri, iStartX, y, z, iCount, pOverlaps);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TriangleBoxOverlap::TestVoxelRow(SIMDLevel eLevel, const OverlapTriangle& tri, int iStartX, int y, int z, int iCount, uint8_t* pOverlaps)
+{
+#if OVERLAP_X86_SIMD
+	if (eLevel == simdAVX2)
+	{
+		return TestVoxelRowAVX2(tri, iStartX, y, z, iCount, pOverlaps);
+	}
+	if (eLevel == simdSSE)
+	{
+		return TestVoxelRowSSE(tri, iStartX, y, z, iCount, pOverlaps);
+	}
+#endif
+	return TestVoxelRowScalar(tri, iStartX, y, z, iCount, pOverlaps);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TriangleBoxOverlap::TestTriangles(const OverlapTriangleBatch& batch, int iFirst, int iCount, const XMFLOAT3& vCentre, float fHalfSize, uint8_t* pOverlaps)
+{
+	return TestTriangles(GetLevel(), batch, iFirst, iCount, vCentre, fHalfSize, pOverlaps);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TriangleBoxOverlap::TestTriangles(SIMDLevel eLevel, const OverlapTriangleBatch& batch, int iFirst, int iCount, const XMFLOAT3& vCentre, float fHalfSize, uint8_t* pOverlaps)
+{
+#if OVERLAP_X86_SIMD
+	if (eLevel == simdAVX2)
+	{
+		return TestTrianglesAVX2(batch, iFirst, iCount, vCentre, fHalfSize, pOverlaps);
+	}
+	if (eLevel == simdSSE)
+	{
+		return TestTrianglesSSE(batch, iFirst, iCount, vCentre, fHalfSize, pOverlaps);
+	}
+#endif
+	return TestTrianglesScalar(batch, iFirst, iCount, vCentre, fHalfSize, pOverlaps);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int TriangleBoxOverlap::Validate(int iNumTriangles, unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	std::uniform_real_distribution<float> randPos(0.f, 8.f);
+	std::uniform_int_distribution<int> randGrid(0, 16);
+	std::uniform_int_distribution<int> randKind(0, 3);
+
+	OverlapTriangleBatch batch;
+	for (int t = 0; t < iNumTriangles; t++)
+	{
+		XMFLOAT3 v[3];
+		int iKind = randKind(rng);
+		for (int i = 0; i < 3; i++)
+		{
+			if (iKind == 1)
+			{
+				//on the half voxel grid so faces and edges lie exactly on voxel boundaries
+				v[i] = XMFLOAT3(randGrid(rng) * 0.5f, randGrid(rng) * 0.5f, randGrid(rng) * 0.5f);
+			}
+			else
+			{
+				v[i] = XMFLOAT3(randPos(rng), randPos(rng), randPos(rng));
+			}
+		}
+		if (iKind == 2)
+		{
+			//degenerate - a line or a point
+			v[2] = (t & 1) ? v[1] : XMFLOAT3((v[0].x + v[1].x) * 0.5f, (v[0].y + v[1].y) * 0.5f, (v[0].z + v[1].z) * 0.5f);
+		}
+		else if (iKind == 3)
+		{
+			//axis aligned, flat in z
+			v[1].z = v[0].z;
+			v[2].z = v[0].z;
+		}
+		batch.Add(v[0], v[1], v[2]);
+	}
+
+	int iMismatches = 0;
+	SIMDLevel eSupported = GetSupportedLevel();
+	uint8_t arrReference[16];
+	uint8_t arrResult[16];
+	OverlapTriangle tri;
+
+	//each triangle against every row of voxels around it
+	for (int t = 0; t < iNumTriangles; t++)
+	{
+		tri.Setup(XMFLOAT3(batch.v[0][0][t], batch.v[0][1][t], batch.v[0][2][t]),
+				  XMFLOAT3(batch.v[1][0][t], batch.v[1][1][t], batch.v[1][2][t]),
+				  XMFLOAT3(batch.v[2][0][t], batch.v[2][1][t], batch.v[2][2][t]));
+		for (int z = -1; z < 9; z++)
+		{
+			for (int y = -1; y < 9; y++)
+			{
+				//11 voxels so both the full vector and the tail paths get used
+				TestVoxelRowScalar(tri, -1, y, z, 11, arrReference);
+				for (int eLevel = simdSSE; eLevel <= eSupported; eLevel++)
+				{
+					TestVoxelRow(static_cast<SIMDLevel>(eLevel), tri, -1, y, z, 11, arrResult);
+					for (int i = 0; i < 11; i++)
+					{
+						iMismatches += arrResult[i] != arrReference[i] ? 1 : 0;
+					}
+				}
+			}
+		}
+	}
+
+	//batches of triangles against boxes of a couple of sizes, including some centred on the voxel grid
+	std::vector<uint8_t> arrBatchReference(iNumTriangles);
+	std::vector<uint8_t> arrBatchResult(iNumTriangles);
+	for (int i = 0; i < 256; i++)
+	{
+		XMFLOAT3 vCentre = (i & 1) ? XMFLOAT3(randGrid(rng) * 0.5f, randGrid(rng) * 0.5f, randGrid(rng) * 0.5f) : XMFLOAT3(randPos(rng), randPos(rng), randPos(rng));
+		float fHalfSize = (i & 2) ? 1.f : 0.5f;
+		TestTrianglesScalar(batch, 0, iNumTriangles, vCentre, fHalfSize, arrBatchReference.data());
+		for (int eLevel = simdSSE; eLevel <= eSupported; eLevel++)
+		{
+			TestTriangles(static_cast<SIMDLevel>(eLevel), batch, 0, iNumTriangles, vCentre, fHalfSize, arrBatchResult.data());
+			for (int t = 0; t < iNumTriangles; t++)
+			{
+				iMismatches += arrBatchResult[t] != arrBatchReference[t] ? 1 : 0;
+			}
+		}
+	}
+
+	if (iMismatches > 0)
+	{
+		VS_LOG_VERBOSE("Triangle/box overlap SIMD results differ from scalar: " << iMismatches << " mismatches");
+	}
+	return iMismatches;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool TriangleBoxOverlap::RunBenchmark(const char* sName)
+{
+	const int iNumTriangles = 100000;
+	const int iNumBoxes = 200;
+	const int iResolution = 64;
+
+	//voxel sized triangles scattered through a 64^3 grid, about what sponza looks like at that resolution
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> randPos(1.f, iResolution - 3.f);
+	std::uniform_real_distribution<float> randOffset(-1.5f, 1.5f);
+	OverlapTriangleBatch batch;
+	std::vector<OverlapTriangle> arrTriangles(iNumTriangles);
+	for (int t = 0; t < iNumTriangles; t++)
+	{
+		XMFLOAT3 vBase(randPos(rng), randPos(rng), randPos(rng));
+		XMFLOAT3 v[3];
+		for (int i = 0; i < 3; i++)
+		{
+			v[i] = XMFLOAT3(vBase.x + randOffset(rng), vBase.y + randOffset(rng), vBase.z + randOffset(rng));
+		}
+		batch.Add(v[0], v[1], v[2]);
+		arrTriangles[t].Setup(v[0], v[1], v[2]);
+	}
+
+	int iMismatches = Validate(2000, 42);
+
+	std::stringstream ss;
+	ss << "../Results/TriangleBoxOverlap_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open triangle/box overlap benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Kernel, Level, Tests, Overlaps, Time(ms), Tests/sec, Speedup\n";
+
+	SIMDLevel eSupported = GetSupportedLevel();
+	std::vector<uint8_t> arrOverlaps(std::max(iNumTriangles, iResolution));
+
+	//One triangle against the rows of voxels in its bounds, what the voxeliser does
+	double dScalarMs = 0.0;
+	for (int eLevel = simdScalar; eLevel <= eSupported; eLevel++)
+	{
+		long long iTests = 0, iOverlaps = 0;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int t = 0; t < iNumTriangles; t++)
+		{
+			const OverlapTriangle& tri = arrTriangles[t];
+			int iMin[3], iMax[3];
+			for (int a = 0; a < 3; a++)
+			{
+				iMin[a] = static_cast<int>(floorf(Min3(GetAxis(tri.v[0], a), GetAxis(tri.v[1], a), GetAxis(tri.v[2], a))));
+				iMax[a] = static_cast<int>(floorf(Max3(GetAxis(tri.v[0], a), GetAxis(tri.v[1], a), GetAxis(tri.v[2], a))));
+			}
+			for (int z = iMin[2]; z <= iMax[2]; z++)
+			{
+				for (int y = iMin[1]; y <= iMax[1]; y++)
+				{
+					int iCount = iMax[0] - iMin[0] + 1;
+					iOverlaps += TestVoxelRow(static_cast<SIMDLevel>(eLevel), tri, iMin[0], y, z, iCount, arrOverlaps.data());
+					iTests += iCount;
+				}
+			}
+		}
+		double dMs = GetElapsedMs(start);
+		if (eLevel == simdScalar)
+		{
+			dScalarMs = dMs;
+		}
+		outfile << "Voxel Row," << GetLevelName(static_cast<SIMDLevel>(eLevel)) << "," << iTests << "," << iOverlaps << "," << dMs << "," << iTests / (dMs / 1000.0) << "," << dScalarMs / dMs << "\n";
+	}
+
+	//Lots of triangles against one box, what a validation pass over a voxel does
+	for (int eLevel = simdScalar; eLevel <= eSupported; eLevel++)
+	{
+		long long iTests = 0, iOverlaps = 0;
+		std::mt19937 boxRng(99);
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int b = 0; b < iNumBoxes; b++)
+		{
+			XMFLOAT3 vCentre(randPos(boxRng), randPos(boxRng), randPos(boxRng));
+			iOverlaps += TestTriangles(static_cast<SIMDLevel>(eLevel), batch, 0, iNumTriangles, vCentre, 4.f, arrOverlaps.data());
+			iTests += iNumTriangles;
+		}
+		double dMs = GetElapsedMs(start);
+		if (eLevel == simdScalar)
+		{
+			dScalarMs = dMs;
+		}
+		outfile << "Triangle Batch," << GetLevelName(static_cast<SIMDLevel>(eLevel)) << "," << iTests << "," << iOverlaps << "," << dMs << "," << iTests / (dMs / 1000.0) << "," << dScalarMs / dMs << "\n";
+	}
+
+	outfile << "\nMismatches Against Scalar:," << iMismatches;
+	outfile.close();
+
+	return iMismatches == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
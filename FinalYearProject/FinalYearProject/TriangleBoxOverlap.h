@@ -0,0 +1,84 @@
+#ifndef TRIANGLE_BOX_OVERLAP_H
+#define TRIANGLE_BOX_OVERLAP_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum SIMDLevel
+{
+	simdScalar,
+	simdSSE,
+	simdAVX2,
+	simdMax
+};
+
+//A triangle with its edges and normal worked out once, ready to be tested against lots of voxels
+struct OverlapTriangle
+{
+	XMFLOAT3 v[3];
+	XMFLOAT3 e[3];
+	XMFLOAT3 n;
+
+	void Setup(const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2);
+};
+
+//Structure of arrays batch for testing many triangles against one box, v[vertex][axis][triangle]
+struct OverlapTriangleBatch
+{
+	std::vector<float> v[3][3];
+
+	void Clear();
+	void Add(const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2);
+	int Size() const { return static_cast<int>(v[0][0].size()); }
+};
+
+//Conservative triangle/AABB overlap using the separating axis test (Akenine-Moller) - the 3 box axes, the triangle
+//plane and the 9 edge cross products. Touching counts as overlapping.
+//The SSE and AVX2 versions do exactly the same float operations in the same order as the scalar one (no FMA, and the
+//.cpp turns floating point contraction off), so all three always give the same answer - Validate checks that.
+//Positions are in voxel space (see VoxelGrid), where voxel (x, y, z) is the unit cube centred on (x + 0.5, y + 0.5, z + 0.5).
+class TriangleBoxOverlap
+{
+public:
+
+	static SIMDLevel GetSupportedLevel();
+	//Clamped to what the CPU supports. Defaults to the best supported level.
+	static void SetLevel(SIMDLevel eLevel);
+	static SIMDLevel GetLevel();
+	static const char* GetLevelName(SIMDLevel eLevel);
+
+	//The scalar reference
+	static bool Test(const OverlapTriangle& tri, const XMFLOAT3& vCentre, float fHalfSize);
+
+	//A run of iCount unit voxels along x starting at (iStartX, y, z), 4/8 voxels at a time. Returns how many overlap.
+	static int TestVoxelRow(const OverlapTriangle& tri, int iStartX, int y, int z, int iCount, uint8_t* pOverlaps);
+	static int TestVoxelRow(SIMDLevel eLevel, const OverlapTriangle& tri, int iStartX, int y, int z, int iCount, uint8_t* pOverlaps);
+
+	//Triangles [iFirst, iFirst + iCount) of the batch against one box, 4/8 triangles at a time. Returns how many overlap.
+	static int TestTriangles(const OverlapTriangleBatch& batch, int iFirst, int iCount, const XMFLOAT3& vCentre, float fHalfSize, uint8_t* pOverlaps);
+	static int TestTriangles(SIMDLevel eLevel, const OverlapTriangleBatch& batch, int iFirst, int iCount, const XMFLOAT3& vCentre, float fHalfSize, uint8_t* pOverlaps);
+
+	//Random and deliberately awkward (grid aligned, grazing, degenerate) triangles through every supported level,
+	//returns the number of results that differ from the scalar version
+	static int Validate(int iNumTriangles, unsigned int iSeed);
+
+	//Tests/second for each level and both batch shapes, written to ../Results/
+	static bool RunBenchmark(const char* sName);
+
+private:
+
+	static SIMDLevel s_eLevel;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !TRIANGLE_BOX_OVERLAP_H
@@ -0,0 +1,378 @@
+#include "VertexWelder.h"
+#include "BenchmarkMesh.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <cstddef>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t VertexWelder::kMaxShortIndexVertices;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	const uint32_t kEmptySlot = 0xffffffff;
+
+	//A 64 bit multiply and fold a word, which spreads the low bits well enough for a power of two table
+	uint64_t HashKey(const uint8_t* pKey, uint32_t iKeyBytes)
+	{
+		uint64_t iHash = 0x9e3779b97f4a7c15ULL ^ iKeyBytes;
+		uint32_t i = 0;
+		for (; i + sizeof(uint64_t) <= iKeyBytes; i += sizeof(uint64_t))
+		{
+			uint64_t iWord;
+			memcpy(&iWord, pKey + i, sizeof(uint64_t));
+			iHash = (iHash ^ iWord) * 0xff51afd7ed558ccdULL;
+			iHash ^= iHash >> 32;
+		}
+		if (i < iKeyBytes)
+		{
+			uint64_t iWord = 0;
+			memcpy(&iWord, pKey + i, iKeyBytes - i);
+			iHash = (iHash ^ iWord) * 0xff51afd7ed558ccdULL;
+			iHash ^= iHash >> 32;
+		}
+		iHash *= 0xc4ceb9fe1a85ec53ULL;
+		return iHash ^ (iHash >> 29);
+	}
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	uint32_t GetIndex(const uint32_t* pIndices, uint32_t iIndexSize, uint32_t i)
+	{
+		return iIndexSize == sizeof(uint16_t) ? reinterpret_cast<const uint16_t*>(pIndices)[i] : pIndices[i];
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t VertexWelder::Weld(void* pVertices, uint32_t iNumVertices, uint32_t iStride, uint32_t iKeyBytes, uint32_t* pIndices)
+{
+	if (iNumVertices == 0)
+	{
+		return 0;
+	}
+
+	//At most half full
+	uint32_t iTableSize = 1;
+	while (iTableSize < iNumVertices * 2ULL)
+	{
+		iTableSize <<= 1;
+	}
+	std::vector<uint32_t> arrTable(iTableSize, kEmptySlot);
+	uint32_t iMask = iTableSize - 1;
+
+	//Vertex i is only ever moved down to iNumUnique <= i, so the ones still to be read are never overwritten
+	uint8_t* pBytes = static_cast<uint8_t*>(pVertices);
+	uint32_t iNumUnique = 0;
+	for (uint32_t i = 0; i < iNumVertices; i++)
+	{
+		const uint8_t* pVertex = pBytes + static_cast<size_t>(i) * iStride;
+		uint32_t iSlot = static_cast<uint32_t>(HashKey(pVertex, iKeyBytes)) & iMask;
+		while (arrTable[iSlot] != kEmptySlot && memcmp(pBytes + static_cast<size_t>(arrTable[iSlot]) * iStride, pVertex, iKeyBytes) != 0)
+		{
+			iSlot = (iSlot + 1) & iMask;
+		}
+
+		if (arrTable[iSlot] == kEmptySlot)
+		{
+			if (iNumUnique != i)
+			{
+				memcpy(pBytes + static_cast<size_t>(iNumUnique) * iStride, pVertex, iStride);
+			}
+			arrTable[iSlot] = iNumUnique++;
+		}
+		pIndices[i] = arrTable[iSlot];
+	}
+	return iNumUnique;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t VertexWelder::PackIndices(uint32_t* pIndices, uint32_t iNumIndices, uint32_t iNumVertices)
+{
+	if (iNumVertices > kMaxShortIndexVertices)
+	{
+		return sizeof(uint32_t);
+	}
+
+	//Each 16 bit index lands at or before the 32 bit one it came from
+	uint16_t* pShortIndices = reinterpret_cast<uint16_t*>(pIndices);
+	for (uint32_t i = 0; i < iNumIndices; i++)
+	{
+		pShortIndices[i] = static_cast<uint16_t>(pIndices[i]);
+	}
+	return sizeof(uint16_t);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int VertexWelder::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	for (int iTest = 0; iTest < 24; iTest++)
+	{
+		//Vertices drawn from a small pool so there are plenty of repeats, with random bytes after the key that
+		//shouldn't stop them welding
+		uint32_t iStride = 4 * (1 + rng() % 16);
+		uint32_t iKeyBytes = 1 + rng() % iStride;
+		uint32_t iNumVertices = iTest == 0 ? 0 : rng() % 3 == 0 ? 70000 + rng() % 10000 : rng() % 5000;
+		uint32_t iPoolSize = 1 + rng() % (iTest % 2 == 0 ? 50 : 100000);
+		std::vector<std::vector<uint8_t>> arrPool(iPoolSize, std::vector<uint8_t>(iKeyBytes));
+		for (uint32_t p = 0; p < iPoolSize; p++)
+		{
+			for (uint32_t b = 0; b < iKeyBytes; b++)
+			{
+				//Few distinct bytes so keys collide on most of their length
+				arrPool[p][b] = static_cast<uint8_t>(rng() % 4);
+			}
+		}
+
+		std::vector<uint8_t> arrVertices(static_cast<size_t>(iNumVertices) * iStride);
+		for (uint32_t i = 0; i < iNumVertices; i++)
+		{
+			const std::vector<uint8_t>& key = arrPool[rng() % iPoolSize];
+			memcpy(&arrVertices[static_cast<size_t>(i) * iStride], key.data(), iKeyBytes);
+			for (uint32_t b = iKeyBytes; b < iStride; b++)
+			{
+				arrVertices[static_cast<size_t>(i) * iStride + b] = static_cast<uint8_t>(rng());
+			}
+		}
+		std::vector<uint8_t> arrOriginal = arrVertices;
+
+		//What it should come out as: the first vertex with each key, in order
+		std::map<std::string, uint32_t> uniqueKeys;
+		std::vector<uint32_t> arrExpectedIndices(iNumVertices);
+		std::vector<uint32_t> arrFirstUse;
+		for (uint32_t i = 0; i < iNumVertices; i++)
+		{
+			std::string sKey(reinterpret_cast<const char*>(&arrOriginal[static_cast<size_t>(i) * iStride]), iKeyBytes);
+			std::map<std::string, uint32_t>::iterator it = uniqueKeys.find(sKey);
+			if (it == uniqueKeys.end())
+			{
+				it = uniqueKeys.insert(std::make_pair(sKey, static_cast<uint32_t>(arrFirstUse.size()))).first;
+				arrFirstUse.push_back(i);
+			}
+			arrExpectedIndices[i] = it->second;
+		}
+
+		std::vector<uint32_t> arrIndices(iNumVertices);
+		uint32_t iNumUnique = Weld(arrVertices.data(), iNumVertices, iStride, iKeyBytes, arrIndices.data());
+		iFailures += iNumUnique != arrFirstUse.size();
+		iFailures += arrIndices != arrExpectedIndices;
+		for (uint32_t u = 0; u < iNumUnique && u < arrFirstUse.size(); u++)
+		{
+			iFailures += memcmp(&arrVertices[static_cast<size_t>(u) * iStride], &arrOriginal[static_cast<size_t>(arrFirstUse[u]) * iStride], iStride) != 0;
+		}
+
+		//16 bit only when it fits, and the same indices either way
+		uint32_t iIndexSize = PackIndices(arrIndices.data(), iNumVertices, iNumUnique);
+		iFailures += iIndexSize != (iNumUnique <= kMaxShortIndexVertices ? sizeof(uint16_t) : sizeof(uint32_t));
+		for (uint32_t i = 0; i < iNumVertices; i++)
+		{
+			if (GetIndex(arrIndices.data(), iIndexSize, i) != arrExpectedIndices[i])
+			{
+				iFailures++;
+				break;
+			}
+		}
+	}
+
+	//Triangle lists with the tangents a bit off between faces, some mirrored and some NaN from degenerate uvs
+	for (int iTest = 0; iTest < 8; iTest++)
+	{
+		uint32_t iPoolSize = 1 + rng() % 200;
+		std::vector<BenchmarkMesh::Vertex> arrPool(iPoolSize);
+		for (uint32_t p = 0; p < iPoolSize; p++)
+		{
+			arrPool[p].position = XMFLOAT3(static_cast<float>(rng() % 8), static_cast<float>(rng() % 8), 0.f);
+			arrPool[p].normal = XMFLOAT3(0.f, 0.f, rng() % 2 ? 1.f : -1.f);
+			arrPool[p].texture = XMFLOAT2(static_cast<float>(rng() % 4) * 0.25f, 0.5f);
+		}
+
+		uint32_t iNumCorners = 3 * (rng() % 3000);
+		std::vector<BenchmarkMesh::Vertex> arrVertices(iNumCorners);
+		std::vector<float> arrHandedness(iNumCorners);
+		std::map<std::string, int> uniqueKeys;
+		for (uint32_t i = 0; i < iNumCorners; i += 3)
+		{
+			float fWobble = std::uniform_real_distribution<float>(-0.01f, 0.01f)(rng);
+			bool bMirrored = rng() % 5 == 0;
+			bool bDegenerate = rng() % 20 == 0;
+			for (uint32_t c = i; c < i + 3; c++)
+			{
+				BenchmarkMesh::Vertex& vertex = arrVertices[c];
+				vertex = arrPool[rng() % iPoolSize];
+				float fSide = vertex.normal.z;
+				vertex.tangent = bDegenerate ? XMFLOAT3(NAN, NAN, NAN) : XMFLOAT3(1.f, fWobble, 0.f);
+				vertex.binormal = bDegenerate ? XMFLOAT3(NAN, NAN, NAN) : XMFLOAT3(-fWobble, bMirrored ? fSide : -fSide, 0.f);
+				arrHandedness[c] = bDegenerate || bMirrored ? 1.f : -1.f;
+
+				float arrKey[9] = { vertex.position.x, vertex.position.y, vertex.position.z, vertex.normal.x, vertex.normal.y, vertex.normal.z,
+					vertex.texture.x, vertex.texture.y, arrHandedness[c] };
+				uniqueKeys[std::string(reinterpret_cast<const char*>(arrKey), sizeof(arrKey))] = 0;
+			}
+		}
+		std::vector<BenchmarkMesh::Vertex> arrCorners = arrVertices;
+
+		std::vector<uint32_t> arrIndices;
+		uint32_t iNumUnique = WeldTangentFrames(arrVertices, arrIndices);
+		iFailures += iNumUnique != uniqueKeys.size() || arrVertices.size() != iNumUnique || arrIndices.size() != iNumCorners;
+		for (uint32_t i = 0; i < iNumCorners && arrIndices.size() == iNumCorners; i++)
+		{
+			if (arrIndices[i] >= iNumUnique)
+			{
+				iFailures++;
+				break;
+			}
+			const BenchmarkMesh::Vertex& vertex = arrVertices[arrIndices[i]];
+			const BenchmarkMesh::Vertex& corner = arrCorners[i];
+			bool bSame = memcmp(&vertex.position, &corner.position, sizeof(XMFLOAT3)) == 0 && memcmp(&vertex.normal, &corner.normal, sizeof(XMFLOAT3)) == 0
+				&& memcmp(&vertex.texture, &corner.texture, sizeof(XMFLOAT2)) == 0;
+			//Unit length, pointing the same way as the face's and with its handedness, unless the face was degenerate
+			float fLength = sqrtf(vertex.tangent.x * vertex.tangent.x + vertex.tangent.y * vertex.tangent.y + vertex.tangent.z * vertex.tangent.z);
+			float fHandedness = (vertex.normal.x * vertex.tangent.y - vertex.normal.y * vertex.tangent.x) * vertex.binormal.z
+				+ (vertex.normal.y * vertex.tangent.z - vertex.normal.z * vertex.tangent.y) * vertex.binormal.x
+				+ (vertex.normal.z * vertex.tangent.x - vertex.normal.x * vertex.tangent.z) * vertex.binormal.y;
+			if (std::isfinite(corner.tangent.x))
+			{
+				bSame = bSame && fabsf(fLength - 1.f) < 1e-4f && vertex.tangent.x > 0.99f && (fHandedness < 0.f ? -1.f : 1.f) == arrHandedness[i];
+			}
+			if (!bSame)
+			{
+				iFailures++;
+				break;
+			}
+		}
+	}
+
+	//Boundary: exactly 65536 unique vertices still fit in 16 bits, one more doesn't
+	for (uint32_t iNumVertices = kMaxShortIndexVertices; iNumVertices <= kMaxShortIndexVertices + 1; iNumVertices++)
+	{
+		std::vector<uint32_t> arrVertices(iNumVertices);
+		for (uint32_t i = 0; i < iNumVertices; i++)
+		{
+			arrVertices[i] = i;
+		}
+		std::vector<uint32_t> arrIndices(iNumVertices);
+		uint32_t iNumUnique = Weld(arrVertices.data(), iNumVertices, sizeof(uint32_t), sizeof(uint32_t), arrIndices.data());
+		uint32_t iIndexSize = PackIndices(arrIndices.data(), iNumVertices, iNumUnique);
+		iFailures += iNumUnique != iNumVertices;
+		iFailures += iIndexSize != (iNumVertices <= kMaxShortIndexVertices ? sizeof(uint16_t) : sizeof(uint32_t));
+		iFailures += GetIndex(arrIndices.data(), iIndexSize, iNumVertices - 1) != iNumVertices - 1;
+	}
+
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VertexWelder::RunBenchmark(const char* sName, const char* objFilename)
+{
+	std::stringstream ss;
+	ss << "../Results/VertexWelder_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open vertex welder benchmark output file");
+		return false;
+	}
+
+	std::vector<BenchmarkMesh::SubMesh> arrSource;
+	XMFLOAT3 vMin, vMax;
+	if (!BenchmarkMesh::LoadObj(objFilename, arrSource, vMin, vMax))
+	{
+		VS_LOG_VERBOSE("Failed to load " << objFilename << " for the vertex welder benchmark");
+		return false;
+	}
+	int iNumSubMeshes = static_cast<int>(arrSource.size());
+
+	outfile << std::fixed << "Threads, Weld(ms)\n";
+	std::vector<BenchmarkMesh::SubMesh> arrWelded;
+	std::vector<uint32_t> arrNumUnique(iNumSubMeshes);
+	std::vector<uint32_t> arrIndexSizes(iNumSubMeshes);
+	int iMaxThreads = Parallel::GetNumWorkerThreads();
+	for (int iNumThreads = 1; ; iNumThreads = std::min(iNumThreads * 2, iMaxThreads))
+	{
+		double dBestMs = 0.0;
+		for (int iRun = 0; iRun < 3; iRun++)
+		{
+			arrWelded = arrSource;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			Parallel::For(iNumSubMeshes, iNumThreads, [&](int s, int)
+			{
+				BenchmarkMesh::SubMesh& subMesh = arrWelded[s];
+				arrNumUnique[s] = WeldTangentFrames(subMesh.arrVertices, subMesh.arrIndices);
+				arrIndexSizes[s] = PackIndices(subMesh.arrIndices.data(), static_cast<uint32_t>(subMesh.arrIndices.size()), arrNumUnique[s]);
+			});
+			double dMs = GetElapsedMs(start);
+			if (iRun == 0 || dMs < dBestMs)
+			{
+				dBestMs = dMs;
+			}
+		}
+		outfile << iNumThreads << "," << dBestMs << "\n";
+		VS_LOG(sName << " vertex welding " << iNumThreads << " threads: " << dBestMs << "ms");
+
+		if (iNumThreads == iMaxThreads)
+		{
+			break;
+		}
+	}
+
+	//Every corner's position, normal and uv have to come back out of the welded arrays exactly as they went in
+	size_t iVerticesBefore = 0, iVerticesAfter = 0, iBytesBefore = 0, iBytesAfter = 0;
+	int iNumShortIndexed = 0, iMismatches = 0;
+	for (int s = 0; s < iNumSubMeshes; s++)
+	{
+		const BenchmarkMesh::SubMesh& source = arrSource[s];
+		const BenchmarkMesh::SubMesh& welded = arrWelded[s];
+		uint32_t iNumIndices = static_cast<uint32_t>(source.arrIndices.size());
+		for (uint32_t i = 0; i < iNumIndices; i++)
+		{
+			uint32_t iIndex = GetIndex(welded.arrIndices.data(), arrIndexSizes[s], i);
+			if (iIndex >= welded.arrVertices.size() || memcmp(&welded.arrVertices[iIndex], &source.arrVertices[i], offsetof(BenchmarkMesh::Vertex, tangent)) != 0)
+			{
+				iMismatches++;
+				break;
+			}
+		}
+		iVerticesBefore += source.arrVertices.size();
+		iVerticesAfter += welded.arrVertices.size();
+		iBytesBefore += source.arrVertices.size() * sizeof(BenchmarkMesh::Vertex) + static_cast<size_t>(iNumIndices) * sizeof(uint32_t);
+		iBytesAfter += welded.arrVertices.size() * sizeof(BenchmarkMesh::Vertex) + static_cast<size_t>(iNumIndices) * arrIndexSizes[s];
+		iNumShortIndexed += arrIndexSizes[s] == sizeof(uint16_t);
+	}
+
+	double dMBBefore = iBytesBefore / (1024.0 * 1024.0);
+	double dMBAfter = iBytesAfter / (1024.0 * 1024.0);
+	outfile << "\nSubMeshes, 16 Bit Indexed, Vertices Before, Vertices After, Vertex Reduction(%), Buffers Before(MB), Buffers After(MB), Saved(MB)\n";
+	outfile << iNumSubMeshes << "," << iNumShortIndexed << "," << iVerticesBefore << "," << iVerticesAfter << ","
+		<< (iVerticesBefore > 0 ? 100.0 * (1.0 - static_cast<double>(iVerticesAfter) / iVerticesBefore) : 0.0) << ","
+		<< dMBBefore << "," << dMBAfter << "," << dMBBefore - dMBAfter << "\n";
+	VS_LOG(sName << " vertex welding: " << iVerticesBefore << " vertices to " << iVerticesAfter << ", " << dMBBefore << "MB to " << dMBAfter << "MB");
+
+	outfile << "\nMismatches:," << iMismatches;
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	return iMismatches == 0 && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
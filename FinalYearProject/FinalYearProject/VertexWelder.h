@@ -0,0 +1,123 @@
+#ifndef VERTEX_WELDER_H
+#define VERTEX_WELDER_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Turns a triangle list with a vertex a corner into unique vertices and an index buffer. Vertices are compared on
+//their first iKeyBytes bit for bit, found through an open addressed hash table with linear probing, and the first
+//of each kept in the order they first turn up so the indices stay close to the order the triangles use them in.
+//Everything is done in the caller's arrays, so it can run on every submesh at once.
+class VertexWelder
+{
+public:
+
+	//Largest vertex count 16 bit indices can address
+	static const uint32_t kMaxShortIndexVertices = 1 << 16;
+
+	//Moves the unique vertices to the front of pVertices and writes the index of each vertex that went in to pIndices.
+	//Returns how many vertices are left.
+	static uint32_t Weld(void* pVertices, uint32_t iNumVertices, uint32_t iStride, uint32_t iKeyBytes, uint32_t* pIndices);
+
+	//Welds Mesh's vertices, one a triangle corner with the face's tangent and binormal, on their position, normal,
+	//texture coordinate and tangent handedness. The tangents and binormals of the corners that weld are averaged, since
+	//the face ones hardly ever match bit for bit, and keeping handedness in the key keeps mirrored uv seams apart.
+	//arrVertices is cut down to the unique vertices and arrIndices gets an index a corner. Returns the vertex count.
+	template<typename Vertex>
+	static uint32_t WeldTangentFrames(std::vector<Vertex>& arrVertices, std::vector<uint32_t>& arrIndices);
+
+	//Packs the indices down to 16 bits in place, at the front of the same array, when there are few enough vertices.
+	//Returns the size of an index in bytes, 2 or 4.
+	static uint32_t PackIndices(uint32_t* pIndices, uint32_t iNumIndices, uint32_t iNumVertices);
+
+	//Random vertex arrays with repeats and differing bytes past the key, against welding through a std::map, and
+	//16 bit packing round trips. Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Welds the obj's submeshes as Mesh does on 1 to all threads, writing the vertex counts and memory before and
+	//after to ../Results/VertexWelder_<sName>.csv
+	static bool RunBenchmark(const char* sName, const char* objFilename);
+
+private:
+
+	//What vertices are welded on, with no padding so it can be compared as bytes
+	struct TangentFrameKey
+	{
+		XMFLOAT3 position;
+		XMFLOAT3 normal;
+		XMFLOAT2 texture;
+		float fHandedness;
+	};
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename Vertex>
+uint32_t VertexWelder::WeldTangentFrames(std::vector<Vertex>& arrVertices, std::vector<uint32_t>& arrIndices)
+{
+	uint32_t iNumCorners = static_cast<uint32_t>(arrVertices.size());
+	std::vector<TangentFrameKey> arrKeys(iNumCorners);
+	for (uint32_t i = 0; i < iNumCorners; i++)
+	{
+		const Vertex& vertex = arrVertices[i];
+		TangentFrameKey& key = arrKeys[i];
+		key.position = vertex.position;
+		key.normal = vertex.normal;
+		key.texture = vertex.texture;
+		XMVECTOR vCross = XMVector3Cross(XMLoadFloat3(&vertex.normal), XMLoadFloat3(&vertex.tangent));
+		key.fHandedness = XMVectorGetX(XMVector3Dot(vCross, XMLoadFloat3(&vertex.binormal))) < 0.f ? -1.f : 1.f;
+	}
+
+	arrIndices.resize(iNumCorners);
+	uint32_t iNumUnique = Weld(arrKeys.data(), iNumCorners, sizeof(TangentFrameKey), sizeof(TangentFrameKey), arrIndices.data());
+
+	//Sum the face tangents, leaving out the ones degenerate uvs turned to NaN
+	std::vector<uint32_t> arrFirstCorner(iNumUnique, 0xffffffff);
+	std::vector<XMFLOAT3> arrTangentSums(iNumUnique, XMFLOAT3(0.f, 0.f, 0.f));
+	std::vector<XMFLOAT3> arrBinormalSums(iNumUnique, XMFLOAT3(0.f, 0.f, 0.f));
+	for (uint32_t i = 0; i < iNumCorners; i++)
+	{
+		uint32_t iVertex = arrIndices[i];
+		if (arrFirstCorner[iVertex] == 0xffffffff)
+		{
+			arrFirstCorner[iVertex] = i;
+		}
+		const Vertex& vertex = arrVertices[i];
+		if (std::isfinite(vertex.tangent.x) && std::isfinite(vertex.tangent.y) && std::isfinite(vertex.tangent.z)
+			&& std::isfinite(vertex.binormal.x) && std::isfinite(vertex.binormal.y) && std::isfinite(vertex.binormal.z))
+		{
+			XMStoreFloat3(&arrTangentSums[iVertex], XMLoadFloat3(&arrTangentSums[iVertex]) + XMLoadFloat3(&vertex.tangent));
+			XMStoreFloat3(&arrBinormalSums[iVertex], XMLoadFloat3(&arrBinormalSums[iVertex]) + XMLoadFloat3(&vertex.binormal));
+		}
+	}
+
+	//A vertex's first corner is never before it, so they can be moved down in place. Sums that cancel out or
+	//had nothing in them keep the first corner's.
+	for (uint32_t v = 0; v < iNumUnique; v++)
+	{
+		arrVertices[v] = arrVertices[arrFirstCorner[v]];
+		XMVECTOR vTangent = XMLoadFloat3(&arrTangentSums[v]);
+		XMVECTOR vBinormal = XMLoadFloat3(&arrBinormalSums[v]);
+		if (XMVectorGetX(XMVector3LengthSq(vTangent)) > 0.f && XMVectorGetX(XMVector3LengthSq(vBinormal)) > 0.f)
+		{
+			XMStoreFloat3(&arrVertices[v].tangent, XMVector3Normalize(vTangent));
+			XMStoreFloat3(&arrVertices[v].binormal, XMVector3Normalize(vBinormal));
+		}
+	}
+	arrVertices.resize(iNumUnique);
+	return iNumUnique;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !VERTEX_WELDER_H
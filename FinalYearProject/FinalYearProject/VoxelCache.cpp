@@ -0,0 +1,617 @@
+#include "VoxelCache.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t VoxelCache::kMagic;
+const uint32_t VoxelCache::kVersion;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelCache::VoxelCache()
+	: m_pMapped(nullptr)
+	, m_iFileSize(0)
+	, m_pHeader(nullptr)
+#ifdef _WIN32
+	, m_hFile(INVALID_HANDLE_VALUE)
+	, m_hMapping(nullptr)
+#else
+	, m_iFile(-1)
+#endif
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelCache::~VoxelCache()
+{
+	Close();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t VoxelCache::HashBytes(const void* pData, size_t iSize, uint64_t iHash)
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	for (size_t i = 0; i < iSize; i++)
+	{
+		iHash ^= pBytes[i];
+		iHash *= 1099511628211ULL;
+	}
+	return iHash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t VoxelCache::HashFile(const char* filename, uint64_t iHash)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		return HashBytes(filename, strlen(filename), iHash);
+	}
+
+	std::vector<char> arrBuffer(1 << 20);
+	while (file)
+	{
+		file.read(arrBuffer.data(), arrBuffer.size());
+		iHash = HashBytes(arrBuffer.data(), static_cast<size_t>(file.gcount()), iHash);
+	}
+	return iHash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t VoxelCache::HashMatrix(const XMMATRIX& mMatrix, uint64_t iHash)
+{
+	XMFLOAT4X4 mStored;
+	XMStoreFloat4x4(&mStored, mMatrix);
+	return HashBytes(&mStored, sizeof(mStored), iHash);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelCache::CompressRLE(const uint32_t* pTexels, size_t iNumTexels, std::vector<uint32_t>& arrCompressed)
+{
+	//Gives up as soon as it's bigger than half the mip, it's not worth decoding at that point
+	size_t iMaxWords = iNumTexels / 2;
+	arrCompressed.clear();
+	size_t i = 0;
+	while (i < iNumTexels)
+	{
+		uint32_t iTexel = pTexels[i];
+		size_t iRun = 1;
+		while (i + iRun < iNumTexels && pTexels[i + iRun] == iTexel && iRun < 0xffffffff)
+		{
+			iRun++;
+		}
+		if (arrCompressed.size() + 2 > iMaxWords)
+		{
+			arrCompressed.clear();
+			return false;
+		}
+		arrCompressed.push_back(static_cast<uint32_t>(iRun));
+		arrCompressed.push_back(iTexel);
+		i += iRun;
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelCache::DecompressRLE(const uint32_t* pCompressed, size_t iNumWords, uint32_t* pTexels, size_t iNumTexels)
+{
+	if (iNumWords % 2 != 0)
+	{
+		return false;
+	}
+
+	size_t iTexel = 0;
+	for (size_t i = 0; i < iNumWords; i += 2)
+	{
+		size_t iRun = pCompressed[i];
+		if (iRun > iNumTexels - iTexel)
+		{
+			return false;
+		}
+		std::fill(pTexels + iTexel, pTexels + iTexel + iRun, pCompressed[i + 1]);
+		iTexel += iRun;
+	}
+	return iTexel == iNumTexels;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelCache::Write(const char* filename, const CPUVoxelVolume& volume, const XMMATRIX& mWorldToVoxel, uint64_t iContentHash, bool bAllowCompression)
+{
+	if (volume.GetMipLevels() < 1 || volume.GetMipLevels() > kMaxMipLevels)
+	{
+		VS_LOG_VERBOSE("Voxel cache can't store " << volume.GetMipLevels() << " mip levels");
+		return false;
+	}
+
+	VoxelCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.iMagic = kMagic;
+	header.iVersion = kVersion;
+	header.iHeaderSize = sizeof(VoxelCacheHeader);
+	header.iResolution = volume.GetResolution();
+	header.iMipLevels = volume.GetMipLevels();
+	header.iContentHash = iContentHash;
+	XMFLOAT4X4 mStored;
+	XMStoreFloat4x4(&mStored, mWorldToVoxel);
+	memcpy(header.fWorldToVoxel, &mStored, sizeof(header.fWorldToVoxel));
+
+	std::vector<std::vector<uint32_t>> arrCompressed(volume.GetMipLevels());
+	uint64_t iOffset = (sizeof(VoxelCacheHeader) + kDataAlignment - 1) & ~static_cast<uint64_t>(kDataAlignment - 1);
+	for (int i = 0; i < volume.GetMipLevels(); i++)
+	{
+		VoxelCacheHeader::Mip& mip = header.mips[i];
+		size_t iNumTexels = volume.GetMipSizeInBytes(i) / sizeof(uint32_t);
+		mip.iOffset = iOffset;
+		mip.iSize = volume.GetMipSizeInBytes(i);
+		mip.iDataHash = HashBytes(volume.GetMipData(i), volume.GetMipSizeInBytes(i));
+		if (bAllowCompression && CompressRLE(volume.GetMipData(i), iNumTexels, arrCompressed[i]))
+		{
+			mip.iCompression = vccRLE;
+			mip.iStoredSize = arrCompressed[i].size() * sizeof(uint32_t);
+		}
+		else
+		{
+			mip.iCompression = vccNone;
+			mip.iStoredSize = mip.iSize;
+		}
+		iOffset = (iOffset + mip.iStoredSize + kDataAlignment - 1) & ~static_cast<uint64_t>(kDataAlignment - 1);
+	}
+
+	//Written to a temporary and renamed over the old one, so a half written cache never gets loaded
+	std::string sTempName = std::string(filename) + ".tmp";
+	std::ofstream file(sTempName, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open " << sTempName.c_str() << " to write the voxel cache");
+		return false;
+	}
+
+	const char padding[kDataAlignment] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t iWritten = sizeof(header);
+	for (int i = 0; i < volume.GetMipLevels(); i++)
+	{
+		const VoxelCacheHeader::Mip& mip = header.mips[i];
+		file.write(padding, static_cast<std::streamsize>(mip.iOffset - iWritten));
+		const void* pData = mip.iCompression == vccRLE ? static_cast<const void*>(arrCompressed[i].data()) : static_cast<const void*>(volume.GetMipData(i));
+		file.write(static_cast<const char*>(pData), static_cast<std::streamsize>(mip.iStoredSize));
+		iWritten = mip.iOffset + mip.iStoredSize;
+	}
+	file.close();
+	if (file.fail())
+	{
+		VS_LOG_VERBOSE("Failed writing the voxel cache to " << sTempName.c_str());
+		remove(sTempName.c_str());
+		return false;
+	}
+
+	remove(filename);
+	if (rename(sTempName.c_str(), filename) != 0)
+	{
+		VS_LOG_VERBOSE("Failed to move the voxel cache to " << filename);
+		remove(sTempName.c_str());
+		return false;
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelCache::Open(const char* filename)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	m_hFile = hFile;
+
+	LARGE_INTEGER iSize;
+	if (!GetFileSizeEx(hFile, &iSize) || iSize.QuadPart < static_cast<LONGLONG>(sizeof(VoxelCacheHeader)))
+	{
+		Close();
+		return false;
+	}
+	m_iFileSize = static_cast<size_t>(iSize.QuadPart);
+
+	m_hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_hMapping)
+	{
+		Close();
+		return false;
+	}
+	m_pMapped = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_iFile = open(filename, O_RDONLY);
+	if (m_iFile < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(m_iFile, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(VoxelCacheHeader)))
+	{
+		Close();
+		return false;
+	}
+	m_iFileSize = static_cast<size_t>(fileStat.st_size);
+
+	void* pMapped = mmap(nullptr, m_iFileSize, PROT_READ, MAP_PRIVATE, m_iFile, 0);
+	m_pMapped = pMapped == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(pMapped);
+#endif
+	if (!m_pMapped)
+	{
+		VS_LOG_VERBOSE("Failed to map voxel cache " << filename);
+		Close();
+		return false;
+	}
+
+	m_pHeader = reinterpret_cast<const VoxelCacheHeader*>(m_pMapped);
+	if (m_pHeader->iMagic != kMagic || m_pHeader->iVersion != kVersion || m_pHeader->iHeaderSize != sizeof(VoxelCacheHeader))
+	{
+		VS_LOG_VERBOSE("Voxel cache " << filename << " is an old version or not a voxel cache");
+		Close();
+		return false;
+	}
+
+	if (m_pHeader->iMipLevels < 1 || m_pHeader->iMipLevels > kMaxMipLevels || m_pHeader->iResolution == 0 || (m_pHeader->iResolution >> (m_pHeader->iMipLevels - 1)) == 0)
+	{
+		VS_LOG_VERBOSE("Voxel cache " << filename << " has a bad resolution or mip count");
+		Close();
+		return false;
+	}
+
+	for (uint32_t i = 0; i < m_pHeader->iMipLevels; i++)
+	{
+		const VoxelCacheHeader::Mip& mip = m_pHeader->mips[i];
+		uint64_t iMipRes = m_pHeader->iResolution >> i;
+		bool bValid = mip.iSize == iMipRes * iMipRes * iMipRes * sizeof(uint32_t)
+			&& mip.iCompression < vccMax
+			&& (mip.iCompression != vccNone || mip.iStoredSize == mip.iSize)
+			&& mip.iOffset % kDataAlignment == 0
+			&& mip.iOffset <= m_iFileSize && mip.iStoredSize <= m_iFileSize - mip.iOffset;
+		if (!bValid)
+		{
+			VS_LOG_VERBOSE("Voxel cache " << filename << " mip " << i << " is truncated or corrupt");
+			Close();
+			return false;
+		}
+	}
+
+	m_arrDecompressedMips.resize(m_pHeader->iMipLevels);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelCache::Close()
+{
+#ifdef _WIN32
+	if (m_pMapped)
+	{
+		UnmapViewOfFile(m_pMapped);
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = nullptr;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_pMapped)
+	{
+		munmap(const_cast<uint8_t*>(m_pMapped), m_iFileSize);
+	}
+	if (m_iFile >= 0)
+	{
+		close(m_iFile);
+		m_iFile = -1;
+	}
+#endif
+	m_pMapped = nullptr;
+	m_pHeader = nullptr;
+	m_iFileSize = 0;
+	m_arrDecompressedMips.clear();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelCache::IsValidFor(uint64_t iContentHash, int iResolution, const XMMATRIX& mWorldToVoxel) const
+{
+	if (!m_pHeader)
+	{
+		return false;
+	}
+
+	if (m_pHeader->iContentHash != iContentHash || static_cast<int>(m_pHeader->iResolution) != iResolution)
+	{
+		return false;
+	}
+
+	XMFLOAT4X4 mStored;
+	XMStoreFloat4x4(&mStored, mWorldToVoxel);
+	const float* pExpected = &mStored.m[0][0];
+	for (int i = 0; i < 16; i++)
+	{
+		if (fabsf(pExpected[i] - m_pHeader->fWorldToVoxel[i]) > 1e-5f * (1.f + fabsf(pExpected[i])))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t* VoxelCache::GetMipData(int iMipLevel)
+{
+	if (!m_pHeader || iMipLevel < 0 || iMipLevel >= GetMipLevels())
+	{
+		return nullptr;
+	}
+
+	const VoxelCacheHeader::Mip& mip = m_pHeader->mips[iMipLevel];
+	const uint32_t* pStored = reinterpret_cast<const uint32_t*>(m_pMapped + mip.iOffset);
+	if (mip.iCompression == vccNone)
+	{
+		return pStored;
+	}
+
+	std::vector<uint32_t>& arrTexels = m_arrDecompressedMips[iMipLevel];
+	if (arrTexels.empty())
+	{
+		arrTexels.resize(static_cast<size_t>(mip.iSize / sizeof(uint32_t)));
+		if (!DecompressRLE(pStored, static_cast<size_t>(mip.iStoredSize / sizeof(uint32_t)), arrTexels.data(), arrTexels.size()))
+		{
+			VS_LOG_VERBOSE("Voxel cache mip " << iMipLevel << " failed to decompress");
+			arrTexels.clear();
+			return nullptr;
+		}
+	}
+	return arrTexels.data();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelCache::ReadIntoVolume(CPUVoxelVolume& volume)
+{
+	if (!m_pHeader || !volume.Initialise(GetResolution(), GetMipLevels()))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < GetMipLevels(); i++)
+	{
+		const uint32_t* pTexels = GetMipData(i);
+		if (!pTexels)
+		{
+			return false;
+		}
+		memcpy(volume.GetMipData(i), pTexels, volume.GetMipSizeInBytes(i));
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelCache::VerifyData()
+{
+	if (!m_pHeader)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < GetMipLevels(); i++)
+	{
+		const uint32_t* pTexels = GetMipData(i);
+		if (!pTexels || HashBytes(pTexels, static_cast<size_t>(m_pHeader->mips[i].iSize)) != m_pHeader->mips[i].iDataHash)
+		{
+			VS_LOG_VERBOSE("Voxel cache mip " << i << " doesn't match its hash");
+			return false;
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int VoxelCache::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+	const char* filename = "../Results/VoxelCache_Validate.vxc";
+	const char* sourceFilename = "../Results/VoxelCache_Validate.src";
+
+	//RLE on its own, runs of every length including the whole buffer, and encodings that don't add up
+	for (int iTest = 0; iTest < 20; iTest++)
+	{
+		std::vector<uint32_t> arrTexels(1 + rng() % 2000);
+		uint32_t iMaxRun = iTest % 4 == 0 ? static_cast<uint32_t>(arrTexels.size()) : 1 + rng() % 64;
+		for (size_t i = 0; i < arrTexels.size();)
+		{
+			uint32_t iTexel = rng() % 3 == 0 ? 0 : static_cast<uint32_t>(rng());
+			size_t iRun = std::min<size_t>(1 + rng() % iMaxRun, arrTexels.size() - i);
+			std::fill(arrTexels.begin() + i, arrTexels.begin() + i + iRun, iTexel);
+			i += iRun;
+		}
+		//It should only give up when the runs won't fit in half the size
+		size_t iNumRuns = 1;
+		for (size_t i = 1; i < arrTexels.size(); i++)
+		{
+			iNumRuns += arrTexels[i] != arrTexels[i - 1];
+		}
+		std::vector<uint32_t> arrCompressed;
+		bool bCompressed = CompressRLE(arrTexels.data(), arrTexels.size(), arrCompressed);
+		iFailures += bCompressed != (iNumRuns * 2 <= arrTexels.size() / 2);
+		if (!bCompressed)
+		{
+			continue;
+		}
+		iFailures += arrCompressed.size() != iNumRuns * 2;
+		std::vector<uint32_t> arrDecompressed(arrTexels.size());
+		iFailures += !DecompressRLE(arrCompressed.data(), arrCompressed.size(), arrDecompressed.data(), arrDecompressed.size());
+		iFailures += arrDecompressed != arrTexels;
+		iFailures += DecompressRLE(arrCompressed.data(), arrCompressed.size() - 1, arrDecompressed.data(), arrDecompressed.size());
+		iFailures += DecompressRLE(arrCompressed.data(), arrCompressed.size(), arrDecompressed.data(), arrDecompressed.size() - 1);
+		if (arrCompressed.size() > 2)
+		{
+			iFailures += DecompressRLE(arrCompressed.data(), arrCompressed.size() - 2, arrDecompressed.data(), arrDecompressed.size());
+		}
+	}
+
+	for (int iTest = 0; iTest < 6; iTest++)
+	{
+		{
+			std::ofstream source(sourceFilename, std::ios::binary | std::ios::trunc);
+			source << "source " << rng();
+		}
+
+		//Empty, a few solid blocks, or noise that RLE can't do anything with
+		int iResolution = 8 << (rng() % 3);
+		int iMaxMips = 1;
+		while ((iResolution >> iMaxMips) > 0)
+		{
+			iMaxMips++;
+		}
+		CPUVoxelVolume volume;
+		volume.Initialise(iResolution, 1 + rng() % iMaxMips);
+		int iFill = iTest % 3;
+		for (int z = 0; z < iResolution; z++)
+		{
+			for (int y = 0; y < iResolution; y++)
+			{
+				for (int x = 0; x < iResolution; x++)
+				{
+					bool bSolid = iFill == 1 && ((x / 4 + y / 4 + z / 4) % 3 == 0);
+					volume.SetVoxel(x, y, z, iFill == 2 ? static_cast<uint32_t>(rng()) : (bSolid ? 0xff204080 : 0));
+				}
+			}
+		}
+		volume.GenerateMips();
+
+		uint64_t iContentHash = HashFile(sourceFilename);
+		XMMATRIX mWorldToVoxel = XMMatrixScaling(0.5f + iTest, 1.f, 2.f) * XMMatrixTranslation(static_cast<float>(rng() % 100), -3.f, 7.f);
+		bool bAllowCompression = rng() % 3 != 0;
+		if (!Write(filename, volume, mWorldToVoxel, iContentHash, bAllowCompression))
+		{
+			iFailures++;
+			continue;
+		}
+
+		VoxelCache cache;
+		if (!cache.Open(filename))
+		{
+			iFailures++;
+			continue;
+		}
+		iFailures += cache.GetResolution() != iResolution || cache.GetMipLevels() != volume.GetMipLevels();
+		iFailures += !cache.IsValidFor(iContentHash, iResolution, mWorldToVoxel);
+		iFailures += cache.IsValidFor(iContentHash, iResolution * 2, mWorldToVoxel);
+		iFailures += cache.IsValidFor(iContentHash, iResolution, mWorldToVoxel * XMMatrixTranslation(0.f, 0.01f, 0.f));
+		iFailures += !cache.VerifyData();
+
+		//Noise never compresses, an empty volume always does once compression's allowed
+		if (!bAllowCompression || iFill != 1)
+		{
+			iFailures += cache.GetHeader().mips[0].iCompression != ((bAllowCompression && iFill == 0) ? vccRLE : vccNone);
+		}
+		for (int i = 0; i < volume.GetMipLevels(); i++)
+		{
+			const uint32_t* pTexels = cache.GetMipData(i);
+			iFailures += !pTexels || memcmp(pTexels, volume.GetMipData(i), volume.GetMipSizeInBytes(i)) != 0;
+			iFailures += cache.GetHeader().mips[i].iOffset % kDataAlignment != 0;
+		}
+		CPUVoxelVolume readBack;
+		iFailures += !cache.ReadIntoVolume(readBack);
+		for (int i = 0; i < std::min(readBack.GetMipLevels(), volume.GetMipLevels()); i++)
+		{
+			iFailures += memcmp(readBack.GetMipData(i), volume.GetMipData(i), volume.GetMipSizeInBytes(i)) != 0;
+		}
+
+		//The source changing makes it stale, and a missing file still hashes to something else
+		{
+			std::ofstream source(sourceFilename, std::ios::binary | std::ios::app);
+			source << "edited";
+		}
+		iFailures += cache.IsValidFor(HashFile(sourceFilename), iResolution, mWorldToVoxel);
+		iFailures += HashFile("../Results/VoxelCache_Missing.src") == HashFile("../Results/VoxelCache_Missing2.src");
+		cache.Close();
+
+		std::vector<char> arrFile;
+		{
+			std::ifstream file(filename, std::ios::binary);
+			arrFile.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		//Cut short anywhere from the last texel back into the header, it shouldn't open
+		size_t arrCuts[2] = { 1 + rng() % 4, arrFile.size() - rng() % sizeof(VoxelCacheHeader) };
+		for (int c = 0; c < 2; c++)
+		{
+			{
+				std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+				file.write(arrFile.data(), arrFile.size() - arrCuts[c]);
+			}
+			iFailures += cache.Open(filename);
+			cache.Close();
+		}
+
+		//Scribbled on texels still open, since Open doesn't read them, but don't verify
+		{
+			std::vector<char> arrScribbled = arrFile;
+			arrScribbled[arrScribbled.size() - 1 - rng() % 4] ^= 0x5a;
+			std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+			file.write(arrScribbled.data(), arrScribbled.size());
+		}
+		iFailures += !cache.Open(filename) || cache.VerifyData();
+		cache.Close();
+
+		//Nor does a bad magic number
+		arrFile[rng() % 4] ^= 0x5a;
+		{
+			std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+			file.write(arrFile.data(), arrFile.size());
+		}
+		iFailures += cache.Open(filename);
+		cache.Close();
+	}
+	remove(filename);
+	remove(sourceFilename);
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Voxel cache validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,124 @@
+#ifndef VOXEL_CACHE_H
+#define VOXEL_CACHE_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum VoxelCacheCompression
+{
+	vccNone,	//texels exactly as they go into UpdateSubresource
+	vccRLE,		//(count, texel) uint32_t pairs, only used when it at least halves the mip
+	vccMax
+};
+
+//Fixed size header at the start of a voxel cache file. Every mip starts on a kDataAlignment boundary so uncompressed
+//ones can be handed straight out of the mapped file.
+struct VoxelCacheHeader
+{
+	uint32_t iMagic;
+	uint32_t iVersion;
+	uint32_t iHeaderSize;
+	uint32_t iResolution;
+	uint32_t iMipLevels;
+	uint32_t iPadding;
+	uint64_t iContentHash;			//of whatever the voxels were built from, see VoxelCache::HashFile
+	float fWorldToVoxel[16];		//row major, as XMStoreFloat4x4 writes it
+
+	struct Mip
+	{
+		uint64_t iOffset;			//from the start of the file
+		uint64_t iStoredSize;		//bytes in the file
+		uint64_t iSize;				//bytes once decompressed
+		uint32_t iCompression;		//VoxelCacheCompression
+		uint32_t iPadding;
+		uint64_t iDataHash;			//of the decompressed texels
+	};
+	Mip mips[16];
+};
+
+//Voxelised static scene on disk so startup can skip voxelising it. Write bakes a CPUVoxelVolume out, Open maps the
+//file read only and GetMipData points straight into the mapping for uncompressed mips, so loading is just the
+//UpdateSubresource. The content hash is whatever the caller builds from the scene's source files and transforms -
+//if it, the resolution or the world to voxel matrix don't match IsValidFor fails and the caller revoxelises.
+class VoxelCache
+{
+public:
+
+	static const uint32_t kMagic = 0x48435856;	//"VXCH"
+	static const uint32_t kVersion = 1;
+	static const int kMaxMipLevels = 16;
+	static const int kDataAlignment = 64;
+
+	VoxelCache();
+	~VoxelCache();
+
+	//FNV-1a, iHash carries on from a previous call so several things can go into one hash
+	static uint64_t HashBytes(const void* pData, size_t iSize, uint64_t iHash = 14695981039346656037ULL);
+	//Hashes the file's contents. Missing files hash their name instead, so a file turning up later still changes it.
+	static uint64_t HashFile(const char* filename, uint64_t iHash = 14695981039346656037ULL);
+	static uint64_t HashMatrix(const XMMATRIX& mMatrix, uint64_t iHash = 14695981039346656037ULL);
+
+	//Writes every mip of the volume, RLE compressing the ones it pays off for when bAllowCompression is set
+	static bool Write(const char* filename, const CPUVoxelVolume& volume, const XMMATRIX& mWorldToVoxel, uint64_t iContentHash, bool bAllowCompression = true);
+
+	//Maps the file and checks the header and mip table fit in it. Doesn't touch the texels.
+	bool Open(const char* filename);
+	void Close();
+	bool IsOpen() const { return m_pMapped != nullptr; }
+
+	//Same content hash, resolution and world to voxel matrix as the cache was written with
+	bool IsValidFor(uint64_t iContentHash, int iResolution, const XMMATRIX& mWorldToVoxel) const;
+
+	const VoxelCacheHeader& GetHeader() const { return *m_pHeader; }
+	int GetResolution() const { return static_cast<int>(m_pHeader->iResolution); }
+	int GetMipLevels() const { return static_cast<int>(m_pHeader->iMipLevels); }
+	int GetMipResolution(int iMipLevel) const { return GetResolution() >> iMipLevel; }
+
+	//Texels of the mip, x fastest then y then z. Points into the mapping when the mip isn't compressed, otherwise it's
+	//decoded into a buffer owned by the cache the first time it's asked for. Null if the mip is corrupt.
+	const uint32_t* GetMipData(int iMipLevel);
+	//Decodes every mip of the cache into the volume, which gets initialised to match
+	bool ReadIntoVolume(CPUVoxelVolume& volume);
+	//Hashes every mip's texels against the header. Reads the whole file so it's left out of the normal load.
+	bool VerifyData();
+
+	size_t GetFileSizeInBytes() const { return m_iFileSize; }
+
+	//Random volumes written and read back with and without compression, RLE round trips, the cache going stale when
+	//its source, resolution or matrix change, and truncated or corrupt files being turned down. Returns the number of
+	//failures.
+	static int Validate(unsigned int iSeed);
+
+private:
+
+	static bool CompressRLE(const uint32_t* pTexels, size_t iNumTexels, std::vector<uint32_t>& arrCompressed);
+	static bool DecompressRLE(const uint32_t* pCompressed, size_t iNumWords, uint32_t* pTexels, size_t iNumTexels);
+
+	const uint8_t* m_pMapped;
+	size_t m_iFileSize;
+	const VoxelCacheHeader* m_pHeader;
+
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_iFile;
+#endif
+
+	std::vector<std::vector<uint32_t>> m_arrDecompressedMips;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !VOXEL_CACHE_H
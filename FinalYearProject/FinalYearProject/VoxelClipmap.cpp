@@ -0,0 +1,595 @@
+#include "VoxelClipmap.h"
+#include "CameraRoute.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	//Modulo that stays positive for negative voxel coordinates
+	inline int WrapCoord(int i, int iResolution)
+	{
+		int iWrapped = i % iResolution;
+		return iWrapped < 0 ? iWrapped + iResolution : iWrapped;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long ClipmapRegion::GetNumVoxels() const
+{
+	return static_cast<long long>(iMax[0] - iMin[0]) * (iMax[1] - iMin[1]) * (iMax[2] - iMin[2]);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelClipmap::VoxelClipmap()
+	: m_iNumLevels(0)
+	, m_iResolution(0)
+	, m_iSnapVoxels(1)
+	, m_fFinestVoxelSize(0.f)
+	, m_bValid(false)
+{
+	m_UpdateStats.iNumRegions = 0;
+	m_UpdateStats.iNumFullUpdates = 0;
+	m_UpdateStats.iNumVoxelsUpdated = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelClipmap::~VoxelClipmap()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelClipmap::Initialise(int iNumLevels, int iResolution, float fFinestVoxelSize, int iSnapVoxels)
+{
+	if (iNumLevels < 1 || iResolution < 2 || iSnapVoxels < 1 || (iResolution % 2) != 0 || ((iResolution / 2) % iSnapVoxels) != 0 || fFinestVoxelSize <= 0.f)
+	{
+		VS_LOG_VERBOSE("Invalid voxel clipmap settings");
+		return false;
+	}
+
+	m_iNumLevels = iNumLevels;
+	m_iResolution = iResolution;
+	m_iSnapVoxels = iSnapVoxels;
+	m_fFinestVoxelSize = fFinestVoxelSize;
+	m_arrOrigins.assign(iNumLevels * 3, 0);
+	m_UpdateStats.arrLevelVoxels.assign(iNumLevels, 0);
+	Invalidate();
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelClipmap::Shutdown()
+{
+	m_arrOrigins.clear();
+	m_arrUpdateRegions.clear();
+	m_UpdateStats.arrLevelVoxels.clear();
+	m_iNumLevels = 0;
+	m_bValid = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelClipmap::Invalidate()
+{
+	m_bValid = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float VoxelClipmap::GetVoxelSize(int iLevel) const
+{
+	return m_fFinestVoxelSize * static_cast<float>(1 << iLevel);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelClipmap::GetWindowOrigin(int iLevel, const XMFLOAT3& vCameraPos, int vOrigin[3]) const
+{
+	float fVoxelSize = GetVoxelSize(iLevel);
+	const float vCamera[3] = { vCameraPos.x, vCameraPos.y, vCameraPos.z };
+	for (int iAxis = 0; iAxis < 3; iAxis++)
+	{
+		//snap the centre so the window only moves in whole steps, then put the camera in the middle of it
+		int iCentre = static_cast<int>(floorf(vCamera[iAxis] / (fVoxelSize * m_iSnapVoxels))) * m_iSnapVoxels;
+		vOrigin[iAxis] = iCentre - m_iResolution / 2;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelClipmap::Update(const XMFLOAT3& vCameraPos)
+{
+	m_arrUpdateRegions.clear();
+	m_UpdateStats.iNumFullUpdates = 0;
+	m_UpdateStats.iNumVoxelsUpdated = 0;
+
+	for (int iLevel = 0; iLevel < m_iNumLevels; iLevel++)
+	{
+		int* pOrigin = &m_arrOrigins[iLevel * 3];
+		int vNewOrigin[3];
+		GetWindowOrigin(iLevel, vCameraPos, vNewOrigin);
+
+		size_t iFirstRegion = m_arrUpdateRegions.size();
+		bool bFullUpdate = !m_bValid;
+		for (int iAxis = 0; iAxis < 3; iAxis++)
+		{
+			if (abs(vNewOrigin[iAxis] - pOrigin[iAxis]) >= m_iResolution)
+			{
+				bFullUpdate = true;
+			}
+		}
+
+		if (bFullUpdate)
+		{
+			ClipmapRegion region;
+			region.iLevel = iLevel;
+			for (int iAxis = 0; iAxis < 3; iAxis++)
+			{
+				region.iMin[iAxis] = vNewOrigin[iAxis];
+				region.iMax[iAxis] = vNewOrigin[iAxis] + m_iResolution;
+			}
+			m_arrUpdateRegions.push_back(region);
+			m_UpdateStats.iNumFullUpdates++;
+		}
+		else
+		{
+			AddExposedRegions(iLevel, pOrigin, vNewOrigin);
+		}
+
+		long long iLevelVoxels = 0;
+		for (size_t i = iFirstRegion; i < m_arrUpdateRegions.size(); i++)
+		{
+			iLevelVoxels += m_arrUpdateRegions[i].GetNumVoxels();
+		}
+		m_UpdateStats.arrLevelVoxels[iLevel] = iLevelVoxels;
+		m_UpdateStats.iNumVoxelsUpdated += iLevelVoxels;
+
+		pOrigin[0] = vNewOrigin[0];
+		pOrigin[1] = vNewOrigin[1];
+		pOrigin[2] = vNewOrigin[2];
+	}
+
+	m_UpdateStats.iNumRegions = static_cast<int>(m_arrUpdateRegions.size());
+	m_bValid = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelClipmap::AddExposedRegions(int iLevel, const int vOldOrigin[3], const int vNewOrigin[3])
+{
+	//What's left of the new window once the slabs found so far are taken off, so the slabs never overlap
+	int vRemainingMin[3] = { vNewOrigin[0], vNewOrigin[1], vNewOrigin[2] };
+	int vRemainingMax[3] = { vNewOrigin[0] + m_iResolution, vNewOrigin[1] + m_iResolution, vNewOrigin[2] + m_iResolution };
+
+	for (int iAxis = 0; iAxis < 3; iAxis++)
+	{
+		int iDelta = vNewOrigin[iAxis] - vOldOrigin[iAxis];
+		if (iDelta == 0)
+		{
+			continue;
+		}
+
+		ClipmapRegion region;
+		region.iLevel = iLevel;
+		for (int i = 0; i < 3; i++)
+		{
+			region.iMin[i] = vRemainingMin[i];
+			region.iMax[i] = vRemainingMax[i];
+		}
+
+		if (iDelta > 0)
+		{
+			//moved up the axis, the slab past the old window's max end is new
+			region.iMin[iAxis] = vOldOrigin[iAxis] + m_iResolution;
+			vRemainingMax[iAxis] = vOldOrigin[iAxis] + m_iResolution;
+		}
+		else
+		{
+			region.iMax[iAxis] = vOldOrigin[iAxis];
+			vRemainingMin[iAxis] = vOldOrigin[iAxis];
+		}
+		m_arrUpdateRegions.push_back(region);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelClipmap::GetTexelRegions(const ClipmapRegion& region, std::vector<ClipmapRegion>& arrTexelRegions) const
+{
+	//Each axis wraps round at most once since a region is never bigger than the level
+	int iRangeMin[3][2], iRangeMax[3][2], iNumRanges[3];
+	for (int iAxis = 0; iAxis < 3; iAxis++)
+	{
+		int iStart = WrapCoord(region.iMin[iAxis], m_iResolution);
+		int iLength = region.iMax[iAxis] - region.iMin[iAxis];
+		iRangeMin[iAxis][0] = iStart;
+		if (iStart + iLength <= m_iResolution)
+		{
+			iRangeMax[iAxis][0] = iStart + iLength;
+			iNumRanges[iAxis] = 1;
+		}
+		else
+		{
+			iRangeMax[iAxis][0] = m_iResolution;
+			iRangeMin[iAxis][1] = 0;
+			iRangeMax[iAxis][1] = iStart + iLength - m_iResolution;
+			iNumRanges[iAxis] = 2;
+		}
+	}
+
+	for (int z = 0; z < iNumRanges[2]; z++)
+	{
+		for (int y = 0; y < iNumRanges[1]; y++)
+		{
+			for (int x = 0; x < iNumRanges[0]; x++)
+			{
+				ClipmapRegion texelRegion;
+				texelRegion.iLevel = region.iLevel;
+				texelRegion.iMin[0] = iRangeMin[0][x];
+				texelRegion.iMax[0] = iRangeMax[0][x];
+				texelRegion.iMin[1] = iRangeMin[1][y];
+				texelRegion.iMax[1] = iRangeMax[1][y];
+				texelRegion.iMin[2] = iRangeMin[2][z];
+				texelRegion.iMax[2] = iRangeMax[2][z];
+				arrTexelRegions.push_back(texelRegion);
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMFLOAT3 VoxelClipmap::GetLevelMin(int iLevel) const
+{
+	float fVoxelSize = GetVoxelSize(iLevel);
+	const int* pOrigin = &m_arrOrigins[iLevel * 3];
+	return XMFLOAT3(pOrigin[0] * fVoxelSize, pOrigin[1] * fVoxelSize, pOrigin[2] * fVoxelSize);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMFLOAT3 VoxelClipmap::GetLevelMax(int iLevel) const
+{
+	float fVoxelSize = GetVoxelSize(iLevel);
+	const int* pOrigin = &m_arrOrigins[iLevel * 3];
+	return XMFLOAT3((pOrigin[0] + m_iResolution) * fVoxelSize, (pOrigin[1] + m_iResolution) * fVoxelSize, (pOrigin[2] + m_iResolution) * fVoxelSize);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelClipmap::WorldToVoxel(int iLevel, const XMFLOAT3& vWorld, int vVoxel[3]) const
+{
+	float fInvVoxelSize = 1.f / GetVoxelSize(iLevel);
+	vVoxel[0] = static_cast<int>(floorf(vWorld.x * fInvVoxelSize));
+	vVoxel[1] = static_cast<int>(floorf(vWorld.y * fInvVoxelSize));
+	vVoxel[2] = static_cast<int>(floorf(vWorld.z * fInvVoxelSize));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelClipmap::VoxelToTexel(const int vVoxel[3], int vTexel[3]) const
+{
+	vTexel[0] = WrapCoord(vVoxel[0], m_iResolution);
+	vTexel[1] = WrapCoord(vVoxel[1], m_iResolution);
+	vTexel[2] = WrapCoord(vVoxel[2], m_iResolution);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelClipmap::IsInsideLevel(int iLevel, const int vVoxel[3]) const
+{
+	const int* pOrigin = &m_arrOrigins[iLevel * 3];
+	for (int iAxis = 0; iAxis < 3; iAxis++)
+	{
+		if (vVoxel[iAxis] < pOrigin[iAxis] || vVoxel[iAxis] >= pOrigin[iAxis] + m_iResolution)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int VoxelClipmap::GetLevelForPoint(const XMFLOAT3& vWorld, int iBorderVoxels) const
+{
+	for (int iLevel = 0; iLevel < m_iNumLevels; iLevel++)
+	{
+		int vVoxel[3];
+		WorldToVoxel(iLevel, vWorld, vVoxel);
+		const int* pOrigin = &m_arrOrigins[iLevel * 3];
+		bool bInside = true;
+		for (int iAxis = 0; iAxis < 3; iAxis++)
+		{
+			if (vVoxel[iAxis] < pOrigin[iAxis] + iBorderVoxels || vVoxel[iAxis] >= pOrigin[iAxis] + m_iResolution - iBorderVoxels)
+			{
+				bInside = false;
+			}
+		}
+		if (bInside)
+		{
+			return iLevel;
+		}
+	}
+	return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMMATRIX VoxelClipmap::GetWorldToVoxelGridMatrix(int iLevel) const
+{
+	XMFLOAT3 vMin = GetLevelMin(iLevel);
+	float fExtent = GetVoxelSize(iLevel) * m_iResolution;
+
+	//Move the centre of the window to the origin and scale it down to [-1, 1]
+	float fScale = 2.f / fExtent;
+	XMMATRIX mWorldToVoxelGrid = XMMatrixScaling(fScale, fScale, fScale) *
+		XMMatrixTranslation(-vMin.x * fScale - 1.f, -vMin.y * fScale - 1.f, -vMin.z * fScale - 1.f);
+
+	return XMMatrixTranspose(mWorldToVoxelGrid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMMATRIX VoxelClipmap::GetWorldToTextureMatrix(int iLevel) const
+{
+	//World voxel v is texel v mod resolution, so with a wrap sampler this is just a scale
+	float fScale = 1.f / (GetVoxelSize(iLevel) * m_iResolution);
+	return XMMatrixTranspose(XMMatrixScaling(fScale, fScale, fScale));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t VoxelClipmap::GetMemoryUsageInBytes(int iBytesPerVoxel) const
+{
+	size_t iLevelVoxels = static_cast<size_t>(m_iResolution) * m_iResolution * m_iResolution;
+	return iLevelVoxels * m_iNumLevels * iBytesPerVoxel;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int VoxelClipmap::Validate(int iNumMoves, unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	const int iResolutions[] = { 8, 12, 16 };
+	for (int iConfig = 0; iConfig < sizeof(iResolutions) / sizeof(iResolutions[0]); iConfig++)
+	{
+		const int iResolution = iResolutions[iConfig];
+		const int iSnap = (iResolution / 2) % 2 == 0 ? 2 : 1;
+		VoxelClipmap clipmap;
+		if (!clipmap.Initialise(3, iResolution, 1.f, iSnap))
+		{
+			return iFailures + 1;
+		}
+
+		//mostly small steps like a camera would make, with the odd jump bigger than a level
+		std::uniform_real_distribution<float> randStep(-3.f, 3.f);
+		std::uniform_real_distribution<float> randJump(-100.f, 100.f);
+		std::uniform_int_distribution<int> randChoice(0, 19);
+		XMFLOAT3 vCamera(0.5f, 0.5f, 0.5f);
+		std::vector<int> arrOldOrigins;
+		std::vector<int> arrCoverage(iResolution * iResolution * iResolution);
+		std::vector<ClipmapRegion> arrTexelRegions;
+
+		for (int iMove = 0; iMove < iNumMoves; iMove++)
+		{
+			bool bFirst = (iMove == 0);
+			arrOldOrigins = clipmap.m_arrOrigins;
+			if (randChoice(rng) == 0)
+			{
+				vCamera = XMFLOAT3(randJump(rng), randJump(rng), randJump(rng));
+			}
+			else
+			{
+				vCamera.x += randStep(rng);
+				vCamera.y += randStep(rng);
+				vCamera.z += randStep(rng);
+			}
+			clipmap.Update(vCamera);
+
+			for (int iLevel = 0; iLevel < clipmap.GetNumLevels(); iLevel++)
+			{
+				const int* pOld = &arrOldOrigins[iLevel * 3];
+				const int* pNew = &clipmap.m_arrOrigins[iLevel * 3];
+
+				//every voxel of the new window is covered once if it just came into view and not at all otherwise
+				std::fill(arrCoverage.begin(), arrCoverage.end(), 0);
+				bool bOutside = false;
+				for (size_t iRegion = 0; iRegion < clipmap.m_arrUpdateRegions.size(); iRegion++)
+				{
+					const ClipmapRegion& region = clipmap.m_arrUpdateRegions[iRegion];
+					if (region.iLevel != iLevel)
+					{
+						continue;
+					}
+					for (int z = region.iMin[2]; z < region.iMax[2]; z++)
+					{
+						for (int y = region.iMin[1]; y < region.iMax[1]; y++)
+						{
+							for (int x = region.iMin[0]; x < region.iMax[0]; x++)
+							{
+								int vVoxel[3] = { x, y, z };
+								if (!clipmap.IsInsideLevel(iLevel, vVoxel))
+								{
+									bOutside = true;
+									continue;
+								}
+								arrCoverage[((z - pNew[2]) * iResolution + (y - pNew[1])) * iResolution + (x - pNew[0])]++;
+							}
+						}
+					}
+
+					//the texel boxes have to stay inside the texture and add up to the region
+					arrTexelRegions.clear();
+					clipmap.GetTexelRegions(region, arrTexelRegions);
+					long long iTexels = 0;
+					for (size_t i = 0; i < arrTexelRegions.size(); i++)
+					{
+						const ClipmapRegion& texelRegion = arrTexelRegions[i];
+						for (int iAxis = 0; iAxis < 3; iAxis++)
+						{
+							if (texelRegion.iMin[iAxis] < 0 || texelRegion.iMax[iAxis] > iResolution || texelRegion.iMin[iAxis] >= texelRegion.iMax[iAxis])
+							{
+								iFailures++;
+							}
+						}
+						iTexels += texelRegion.GetNumVoxels();
+					}
+					if (iTexels != region.GetNumVoxels())
+					{
+						iFailures++;
+					}
+				}
+				if (bOutside)
+				{
+					iFailures++;
+				}
+
+				bool bFull = bFirst || clipmap.m_UpdateStats.arrLevelVoxels[iLevel] == static_cast<long long>(iResolution) * iResolution * iResolution;
+				std::vector<bool> arrTexelUsed(arrCoverage.size(), false);
+				for (int z = 0; z < iResolution; z++)
+				{
+					for (int y = 0; y < iResolution; y++)
+					{
+						for (int x = 0; x < iResolution; x++)
+						{
+							int vVoxel[3] = { x + pNew[0], y + pNew[1], z + pNew[2] };
+							bool bWasInside = vVoxel[0] >= pOld[0] && vVoxel[0] < pOld[0] + iResolution &&
+								vVoxel[1] >= pOld[1] && vVoxel[1] < pOld[1] + iResolution &&
+								vVoxel[2] >= pOld[2] && vVoxel[2] < pOld[2] + iResolution;
+							int iExpected = (bFull || !bWasInside) ? 1 : 0;
+							if (arrCoverage[(z * iResolution + y) * iResolution + x] != iExpected)
+							{
+								iFailures++;
+							}
+
+							//the window maps onto the texture one to one
+							int vTexel[3];
+							clipmap.VoxelToTexel(vVoxel, vTexel);
+							int iTexel = (vTexel[2] * iResolution + vTexel[1]) * iResolution + vTexel[0];
+							if (arrTexelUsed[iTexel])
+							{
+								iFailures++;
+							}
+							arrTexelUsed[iTexel] = true;
+						}
+					}
+				}
+
+				//each level sits inside the next one out
+				if (iLevel + 1 < clipmap.GetNumLevels())
+				{
+					XMFLOAT3 vMin = clipmap.GetLevelMin(iLevel), vMax = clipmap.GetLevelMax(iLevel);
+					XMFLOAT3 vOuterMin = clipmap.GetLevelMin(iLevel + 1), vOuterMax = clipmap.GetLevelMax(iLevel + 1);
+					if (vMin.x < vOuterMin.x || vMin.y < vOuterMin.y || vMin.z < vOuterMin.z ||
+						vMax.x > vOuterMax.x || vMax.y > vOuterMax.y || vMax.z > vOuterMax.z)
+					{
+						iFailures++;
+					}
+				}
+			}
+
+			//the camera is always in the finest level
+			if (clipmap.GetLevelForPoint(vCamera, 0) != 0)
+			{
+				iFailures++;
+			}
+		}
+	}
+
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelClipmap::WriteRouteReport(const char* sName, const std::vector<XMFLOAT3>& arrRoute)
+{
+	if (m_iNumLevels == 0 || arrRoute.size() < 2)
+	{
+		return false;
+	}
+
+	std::stringstream ss;
+	ss << "../Results/VoxelClipmap_" << sName << "_" << m_iResolution << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open voxel clipmap report file");
+		return false;
+	}
+
+	outfile << std::fixed << "Frame, Camera X, Camera Y, Camera Z";
+	for (int iLevel = 0; iLevel < m_iNumLevels; iLevel++)
+	{
+		outfile << ", Level " << iLevel << " Voxels";
+	}
+	outfile << ", Total Voxels, Regions, Full Level Updates\n";
+
+	//Same as Camera::TraverseRoute followed by Camera::Update every frame
+	XMFLOAT3 vPosition = arrRoute[0];
+	int iRouteIndex = 1;
+	Invalidate();
+
+	const long long iFullVoxels = static_cast<long long>(m_iResolution) * m_iResolution * m_iResolution * m_iNumLevels;
+	long long iTotalVoxels = 0, iMaxVoxels = 0;
+	int iNumFrames = 0, iNumIdleFrames = 0;
+	bool bFollowingRoute = true;
+	while (bFollowingRoute)
+	{
+		Update(vPosition);
+
+		outfile << iNumFrames << "," << vPosition.x << "," << vPosition.y << "," << vPosition.z;
+		for (int iLevel = 0; iLevel < m_iNumLevels; iLevel++)
+		{
+			outfile << "," << m_UpdateStats.arrLevelVoxels[iLevel];
+		}
+		outfile << "," << m_UpdateStats.iNumVoxelsUpdated << "," << m_UpdateStats.iNumRegions << "," << m_UpdateStats.iNumFullUpdates << "\n";
+
+		//the first frame fills the whole clipmap, leave it out of the averages
+		if (iNumFrames > 0)
+		{
+			iTotalVoxels += m_UpdateStats.iNumVoxelsUpdated;
+			iMaxVoxels = std::max(iMaxVoxels, m_UpdateStats.iNumVoxelsUpdated);
+			if (m_UpdateStats.iNumVoxelsUpdated == 0)
+			{
+				iNumIdleFrames++;
+			}
+		}
+		iNumFrames++;
+
+		bFollowingRoute = StepAlongRoute(arrRoute, iRouteIndex, vPosition);
+	}
+
+	double dAverage = iNumFrames > 1 ? static_cast<double>(iTotalVoxels) / (iNumFrames - 1) : 0.0;
+	outfile << "\nLevels:," << m_iNumLevels;
+	outfile << "\nResolution:," << m_iResolution;
+	outfile << "\nFinest Voxel Size:," << m_fFinestVoxelSize;
+	outfile << "\nCoarsest Level Extent:," << GetVoxelSize(m_iNumLevels - 1) * m_iResolution;
+	outfile << "\nClipmap Memory RGBA8(MB):," << GetMemoryUsageInBytes(4) / (1024.f * 1024.f);
+	outfile << "\nFrames:," << iNumFrames;
+	outfile << "\nFrames With No Update:," << iNumIdleFrames;
+	outfile << "\nFull Clipmap Voxels:," << iFullVoxels;
+	outfile << "\nAverage Voxels Per Frame:," << dAverage;
+	outfile << "\nMax Voxels Per Frame:," << iMaxVoxels;
+	outfile << "\nAverage Fraction Of Full Revoxelise:," << dAverage / iFullVoxels;
+	outfile.close();
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
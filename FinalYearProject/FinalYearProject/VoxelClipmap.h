@@ -0,0 +1,115 @@
+#ifndef VOXEL_CLIPMAP_H
+#define VOXEL_CLIPMAP_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//A box of voxels [iMin, iMax) on one clipmap level. Depending on where it came from it's either in the level's
+//world voxel coordinates (world position / voxel size) or in texels of the level's volume texture.
+struct ClipmapRegion
+{
+	int iLevel;
+	int iMin[3];
+	int iMax[3];
+
+	long long GetNumVoxels() const;
+};
+
+//Camera centred voxel clipmap. Each level is a cube of the same resolution with twice the voxel size of the one
+//before, so level 0 has the finest voxels round the camera and the last level covers the most of the scene.
+//Levels are stored toroidally - world voxel v lives in texel v mod resolution - so when the camera moves, a level's
+//window just slides along and only the slabs of voxels that have come into view need revoxelising and relighting.
+//This is all CPU bookkeeping, working out what to update and the matrices to do it with. It doesn't touch D3D.
+class VoxelClipmap
+{
+public:
+
+	struct UpdateStats
+	{
+		int iNumRegions;
+		int iNumFullUpdates;			//levels that moved further than their resolution and had to be redone entirely
+		long long iNumVoxelsUpdated;
+		std::vector<long long> arrLevelVoxels;
+	};
+
+	VoxelClipmap();
+	~VoxelClipmap();
+
+	//Each level's window moves in steps of iSnapVoxels of its own voxels, and half of iResolution has to be a multiple
+	//of it. An even number keeps every level lined up with the voxels of the next level out.
+	bool Initialise(int iNumLevels, int iResolution, float fFinestVoxelSize, int iSnapVoxels = 2);
+	void Shutdown();
+
+	//Moves the windows to follow the camera and works out the regions that need updating. The first update after
+	//Initialise or Invalidate does every level in full.
+	void Update(const XMFLOAT3& vCameraPos);
+	void Invalidate();
+
+	//Regions from the last Update in world voxel coordinates, no two overlapping
+	const std::vector<ClipmapRegion>& GetUpdateRegions() const { return m_arrUpdateRegions; }
+	const UpdateStats& GetUpdateStats() const { return m_UpdateStats; }
+
+	//Splits a world voxel region into the (up to 8) boxes of texels it covers once it wraps round the level's texture
+	void GetTexelRegions(const ClipmapRegion& region, std::vector<ClipmapRegion>& arrTexelRegions) const;
+
+	int GetNumLevels() const { return m_iNumLevels; }
+	int GetResolution() const { return m_iResolution; }
+	float GetVoxelSize(int iLevel) const;
+	XMFLOAT3 GetLevelMin(int iLevel) const;
+	XMFLOAT3 GetLevelMax(int iLevel) const;
+
+	//World voxel coordinates on a level, and where they live in the level's texture
+	void WorldToVoxel(int iLevel, const XMFLOAT3& vWorld, int vVoxel[3]) const;
+	void VoxelToTexel(const int vVoxel[3], int vTexel[3]) const;
+	bool IsInsideLevel(int iLevel, const int vVoxel[3]) const;
+
+	//Finest level that has the point inside it with at least iBorderVoxels to spare, -1 if none do
+	int GetLevelForPoint(const XMFLOAT3& vWorld, int iBorderVoxels = 1) const;
+
+	//Maps the level's window to [-1, 1] on every axis, for voxelising into it. Transposed, like
+	//VoxelisedScene's world to voxel grid matrix.
+	XMMATRIX GetWorldToVoxelGridMatrix(int iLevel) const;
+	//Maps world positions to texture coordinates of the level's toroidal volume, for sampling it in the lighting
+	//pass with a wrap sampler. Transposed.
+	XMMATRIX GetWorldToTextureMatrix(int iLevel) const;
+
+	size_t GetMemoryUsageInBytes(int iBytesPerVoxel) const;
+
+	//Random camera moves on small clipmaps, checking after each that the regions are exactly the voxels that came
+	//into view and don't overlap, and that each level's texels are all used once. Returns the number of failures.
+	static int Validate(int iNumMoves, unsigned int iSeed);
+
+	//Replays the camera fly through route (see StepAlongRoute) and writes the voxels revoxelised each frame for
+	//each level to ../Results/, against what voxelising the whole clipmap every frame would cost
+	bool WriteRouteReport(const char* sName, const std::vector<XMFLOAT3>& arrRoute);
+
+private:
+
+	void GetWindowOrigin(int iLevel, const XMFLOAT3& vCameraPos, int vOrigin[3]) const;
+	void AddExposedRegions(int iLevel, const int vOldOrigin[3], const int vNewOrigin[3]);
+
+	int m_iNumLevels;
+	int m_iResolution;
+	int m_iSnapVoxels;
+	float m_fFinestVoxelSize;
+	bool m_bValid;
+
+	//world voxel coordinates of the min corner of each level's window, 3 per level
+	std::vector<int> m_arrOrigins;
+
+	std::vector<ClipmapRegion> m_arrUpdateRegions;
+	UpdateStats m_UpdateStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !VOXEL_CLIPMAP_H
@@ -0,0 +1,645 @@
+#include "VoxelFragmentList.h"
+#include "Parallel.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	const int kRadixBuckets = 1 << VoxelFragmentList::kRadixBits;
+
+	//Spreads the low 10 bits out to every third bit
+	inline uint32_t Part1By2(uint32_t i)
+	{
+		i &= 0x000003ff;
+		i = (i ^ (i << 16)) & 0xff0000ff;
+		i = (i ^ (i << 8)) & 0x0300f00f;
+		i = (i ^ (i << 4)) & 0x030c30c3;
+		i = (i ^ (i << 2)) & 0x09249249;
+		return i;
+	}
+
+	//Same for the low 21 bits into 63
+	inline uint64_t Part1By2(uint64_t i)
+	{
+		i &= 0x1fffff;
+		i = (i | (i << 32)) & 0x001f00000000ffffULL;
+		i = (i | (i << 16)) & 0x001f0000ff0000ffULL;
+		i = (i | (i << 8)) & 0x100f00f00f00f00fULL;
+		i = (i | (i << 4)) & 0x10c30c30c30c30c3ULL;
+		i = (i | (i << 2)) & 0x1249249249249249ULL;
+		return i;
+	}
+
+	inline uint32_t Compact1By2(uint64_t i)
+	{
+		i &= 0x1249249249249249ULL;
+		i = (i ^ (i >> 2)) & 0x10c30c30c30c30c3ULL;
+		i = (i ^ (i >> 4)) & 0x100f00f00f00f00fULL;
+		i = (i ^ (i >> 8)) & 0x001f0000ff0000ffULL;
+		i = (i ^ (i >> 16)) & 0x001f00000000ffffULL;
+		i = (i ^ (i >> 32)) & 0x1fffff;
+		return static_cast<uint32_t>(i);
+	}
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Averages a run of fragments in the same voxel. Colour channels are rounded to nearest, normals are summed and
+	//renormalised. A run of one is left exactly as it was.
+	MortonFragment MergeRun(const MortonFragment* pRun, size_t iCount)
+	{
+		if (iCount == 1)
+		{
+			return pRun[0];
+		}
+
+		uint64_t iChannelSums[4] = { 0, 0, 0, 0 };
+		float fNormal[3] = { 0.f, 0.f, 0.f };
+		for (size_t i = 0; i < iCount; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				iChannelSums[c] += (pRun[i].iColour >> (c * 8)) & 0xff;
+			}
+			XMFLOAT3 vNormal = UnpackNormalRGBA8(pRun[i].iNormal);
+			fNormal[0] += vNormal.x;
+			fNormal[1] += vNormal.y;
+			fNormal[2] += vNormal.z;
+		}
+
+		MortonFragment merged;
+		merged.iKey = pRun[0].iKey;
+		merged.iColour = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			merged.iColour |= static_cast<uint32_t>((iChannelSums[c] + iCount / 2) / iCount) << (c * 8);
+		}
+
+		float fLength = sqrtf(fNormal[0] * fNormal[0] + fNormal[1] * fNormal[1] + fNormal[2] * fNormal[2]);
+		float fInvLength = fLength > 0.f ? 1.f / fLength : 0.f;
+		merged.iNormal = PackNormalRGBA8(XMFLOAT3(fNormal[0] * fInvLength, fNormal[1] * fInvLength, fNormal[2] * fInvLength));
+		return merged;
+	}
+
+	void SortReference(std::vector<MortonFragment>& arrFragments)
+	{
+		std::stable_sort(arrFragments.begin(), arrFragments.end(), [](const MortonFragment& a, const MortonFragment& b) { return a.iKey < b.iKey; });
+	}
+
+	//A serial merge of already sorted fragments
+	void MergeReference(std::vector<MortonFragment>& arrFragments)
+	{
+		size_t iNumVoxels = 0;
+		for (size_t i = 0; i < arrFragments.size();)
+		{
+			size_t iEnd = i + 1;
+			while (iEnd < arrFragments.size() && arrFragments[iEnd].iKey == arrFragments[i].iKey)
+			{
+				iEnd++;
+			}
+			arrFragments[iNumVoxels++] = MergeRun(&arrFragments[i], iEnd - i);
+			i = iEnd;
+		}
+		arrFragments.resize(iNumVoxels);
+	}
+
+	//The straightforward version the benchmark checks against
+	void SortAndMergeReference(std::vector<MortonFragment>& arrFragments)
+	{
+		SortReference(arrFragments);
+		MergeReference(arrFragments);
+	}
+
+	bool FragmentsMatch(const std::vector<MortonFragment>& a, const std::vector<MortonFragment>& b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].iKey != b[i].iKey || a[i].iColour != b[i].iColour || a[i].iNormal != b[i].iNormal)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t VoxelFragmentList::EncodeMorton30(uint32_t x, uint32_t y, uint32_t z)
+{
+	return Part1By2(x) | (Part1By2(y) << 1) | (Part1By2(z) << 2);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t VoxelFragmentList::EncodeMorton60(uint32_t x, uint32_t y, uint32_t z)
+{
+	return Part1By2(static_cast<uint64_t>(x)) | (Part1By2(static_cast<uint64_t>(y)) << 1) | (Part1By2(static_cast<uint64_t>(z)) << 2);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::DecodeMorton(uint64_t iKey, uint32_t& x, uint32_t& y, uint32_t& z)
+{
+	x = Compact1By2(iKey);
+	y = Compact1By2(iKey >> 1);
+	z = Compact1By2(iKey >> 2);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelFragmentList::VoxelFragmentList()
+	: m_iResolution(0)
+	, m_iKeyBits(0)
+	, m_iNumThreads(0)
+{
+	memset(&m_Stats, 0, sizeof(Stats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelFragmentList::~VoxelFragmentList()
+{
+	Shutdown();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelFragmentList::Initialise(int iResolution, int iNumThreads)
+{
+	if (iResolution <= 0 || (iResolution & (iResolution - 1)) != 0 || iResolution > (1 << 20))
+	{
+		VS_LOG_VERBOSE("Voxel fragment list resolution has to be a power of 2 no bigger than 2^20");
+		return false;
+	}
+
+	m_iResolution = iResolution;
+	m_iKeyBits = iResolution <= 1024 ? 30 : 60;
+	m_iNumThreads = iNumThreads;
+	Clear();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::Shutdown()
+{
+	std::vector<MortonFragment>().swap(m_arrFragments);
+	std::vector<MortonFragment>().swap(m_arrScratch);
+	m_iResolution = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::Clear()
+{
+	m_arrFragments.clear();
+	memset(&m_Stats, 0, sizeof(Stats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::Reserve(size_t iNumFragments)
+{
+	m_arrFragments.reserve(iNumFragments);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t VoxelFragmentList::EncodeKey(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return m_iKeyBits == 30 ? EncodeMorton30(x, y, z) : EncodeMorton60(x, y, z);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::AddFragment(uint32_t x, uint32_t y, uint32_t z, uint32_t iColour, uint32_t iNormal)
+{
+	MortonFragment fragment;
+	fragment.iKey = EncodeKey(x, y, z);
+	fragment.iColour = iColour;
+	fragment.iNormal = iNormal;
+	m_arrFragments.push_back(fragment);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::AddFragments(const MortonFragment* pFragments, size_t iNumFragments)
+{
+	m_arrFragments.insert(m_arrFragments.end(), pFragments, pFragments + iNumFragments);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::SortAndMerge()
+{
+	Sort();
+	Merge();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::Sort()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	size_t iNumFragments = m_arrFragments.size();
+	int iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+	m_Stats.iNumThreads = iNumThreads;
+	m_Stats.iKeyBits = m_iKeyBits;
+	m_Stats.iNumFragments = static_cast<long long>(iNumFragments);
+	m_Stats.iNumPasses = 0;
+	if (iNumFragments < 2)
+	{
+		m_Stats.dSortTimeMs = GetElapsedMs(start);
+		return;
+	}
+
+	//One chunk per thread, each chunk counts its digits then scatters them to where the counts say, so the sort is
+	//stable and the output is the same for any number of chunks
+	int iNumChunks = static_cast<int>(std::max<size_t>(1, std::min<size_t>(iNumThreads, iNumFragments / 4096)));
+	size_t iChunkSize = (iNumFragments + iNumChunks - 1) / iNumChunks;
+	std::vector<size_t> arrCounts(iNumChunks * kRadixBuckets);
+	m_arrScratch.resize(iNumFragments);
+
+	int iNumPasses = (m_iKeyBits + kRadixBits - 1) / kRadixBits;
+	for (int iPass = 0; iPass < iNumPasses; iPass++)
+	{
+		int iShift = iPass * kRadixBits;
+		const MortonFragment* pSrc = m_arrFragments.data();
+		MortonFragment* pDst = m_arrScratch.data();
+
+		Parallel::For(iNumChunks, iNumThreads, [&](int iChunk, int iThread)
+		{
+			size_t* pCounts = &arrCounts[iChunk * kRadixBuckets];
+			memset(pCounts, 0, sizeof(size_t) * kRadixBuckets);
+			size_t iEnd = std::min(iNumFragments, (iChunk + 1) * iChunkSize);
+			for (size_t i = iChunk * iChunkSize; i < iEnd; i++)
+			{
+				pCounts[(pSrc[i].iKey >> iShift) & (kRadixBuckets - 1)]++;
+			}
+		});
+
+		//Every key has the same digit, e.g. the top bits of a 60 bit key at low resolution, so nothing would move
+		bool bSkipPass = false;
+		size_t iOffset = 0;
+		for (int iDigit = 0; iDigit < kRadixBuckets; iDigit++)
+		{
+			size_t iDigitTotal = 0;
+			for (int iChunk = 0; iChunk < iNumChunks; iChunk++)
+			{
+				size_t& iCount = arrCounts[iChunk * kRadixBuckets + iDigit];
+				size_t iChunkCount = iCount;
+				iCount = iOffset;
+				iOffset += iChunkCount;
+				iDigitTotal += iChunkCount;
+			}
+			if (iDigitTotal == iNumFragments)
+			{
+				bSkipPass = true;
+			}
+		}
+		if (bSkipPass)
+		{
+			continue;
+		}
+
+		Parallel::For(iNumChunks, iNumThreads, [&](int iChunk, int iThread)
+		{
+			size_t* pOffsets = &arrCounts[iChunk * kRadixBuckets];
+			size_t iEnd = std::min(iNumFragments, (iChunk + 1) * iChunkSize);
+			for (size_t i = iChunk * iChunkSize; i < iEnd; i++)
+			{
+				pDst[pOffsets[(pSrc[i].iKey >> iShift) & (kRadixBuckets - 1)]++] = pSrc[i];
+			}
+		});
+
+		m_arrFragments.swap(m_arrScratch);
+		m_Stats.iNumPasses++;
+	}
+
+	m_Stats.dSortTimeMs = GetElapsedMs(start);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::Merge()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	size_t iNumFragments = m_arrFragments.size();
+	int iNumThreads = m_iNumThreads > 0 ? m_iNumThreads : Parallel::GetNumWorkerThreads();
+	int iNumChunks = static_cast<int>(std::max<size_t>(1, std::min<size_t>(iNumThreads, iNumFragments / 4096)));
+
+	//Chunk starts get pushed forward to the next voxel so no voxel's fragments are split between two chunks
+	std::vector<size_t> arrChunkStart(iNumChunks + 1);
+	for (int iChunk = 0; iChunk < iNumChunks; iChunk++)
+	{
+		size_t iStart = iNumFragments * iChunk / iNumChunks;
+		if (iChunk > 0)
+		{
+			iStart = std::max(iStart, arrChunkStart[iChunk - 1]);
+		}
+		while (iStart > 0 && iStart < iNumFragments && m_arrFragments[iStart].iKey == m_arrFragments[iStart - 1].iKey)
+		{
+			iStart++;
+		}
+		arrChunkStart[iChunk] = iStart;
+	}
+	arrChunkStart[iNumChunks] = iNumFragments;
+
+	std::vector<size_t> arrChunkVoxels(iNumChunks + 1, 0);
+	Parallel::For(iNumChunks, iNumThreads, [&](int iChunk, int iThread)
+	{
+		size_t iNumVoxels = 0;
+		for (size_t i = arrChunkStart[iChunk]; i < arrChunkStart[iChunk + 1]; i++)
+		{
+			if (i == arrChunkStart[iChunk] || m_arrFragments[i].iKey != m_arrFragments[i - 1].iKey)
+			{
+				iNumVoxels++;
+			}
+		}
+		arrChunkVoxels[iChunk + 1] = iNumVoxels;
+	});
+	for (int iChunk = 0; iChunk < iNumChunks; iChunk++)
+	{
+		arrChunkVoxels[iChunk + 1] += arrChunkVoxels[iChunk];
+	}
+
+	m_arrScratch.resize(arrChunkVoxels[iNumChunks]);
+	Parallel::For(iNumChunks, iNumThreads, [&](int iChunk, int iThread)
+	{
+		size_t iOut = arrChunkVoxels[iChunk];
+		size_t iEnd = arrChunkStart[iChunk + 1];
+		for (size_t i = arrChunkStart[iChunk]; i < iEnd;)
+		{
+			size_t iRunEnd = i + 1;
+			while (iRunEnd < iEnd && m_arrFragments[iRunEnd].iKey == m_arrFragments[i].iKey)
+			{
+				iRunEnd++;
+			}
+			m_arrScratch[iOut++] = MergeRun(&m_arrFragments[i], iRunEnd - i);
+			i = iRunEnd;
+		}
+	});
+	m_arrFragments.swap(m_arrScratch);
+
+	m_Stats.iNumVoxels = static_cast<long long>(m_arrFragments.size());
+	m_Stats.dMergeTimeMs = GetElapsedMs(start);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelFragmentList::GetVoxelFragments(std::vector<VoxelFragment>& arrFragments) const
+{
+	arrFragments.resize(m_arrFragments.size());
+	for (size_t i = 0; i < m_arrFragments.size(); i++)
+	{
+		DecodeMorton(m_arrFragments[i].iKey, arrFragments[i].x, arrFragments[i].y, arrFragments[i].z);
+		arrFragments[i].iColour = m_arrFragments[i].iColour;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelFragmentList::WriteToVolume(CPUVoxelVolume* pVolume) const
+{
+	if (!pVolume || pVolume->GetResolution() != m_iResolution)
+	{
+		VS_LOG_VERBOSE("Voxel fragment list and volume resolutions don't match");
+		return false;
+	}
+
+	uint32_t* pVoxels = pVolume->GetMipData(0);
+	memset(pVoxels, 0, pVolume->GetMipSizeInBytes(0));
+	for (size_t i = 0; i < m_arrFragments.size(); i++)
+	{
+		uint32_t x, y, z;
+		DecodeMorton(m_arrFragments[i].iKey, x, y, z);
+		pVoxels[pVolume->GetIndex(x, y, z)] = m_arrFragments[i].iColour;
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int VoxelFragmentList::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	//30 bit keys up to 1024^3, 60 bit keys above
+	const int iResolutions[] = { 32, 1024, 2048, 1 << 20 };
+	const int iSizes[] = { 0, 1, 100, 5000, 60000 };
+	int iMaxThreads = std::max(4, Parallel::GetNumWorkerThreads());
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		uint32_t iRes = static_cast<uint32_t>(iResolutions[r]);
+		VoxelFragmentList list;
+		list.Initialise(iResolutions[r]);
+
+		for (int i = 0; i < 1000; i++)
+		{
+			uint32_t x = rng() % iRes, y = rng() % iRes, z = rng() % iRes;
+			uint32_t dx, dy, dz;
+			DecodeMorton(list.EncodeKey(x, y, z), dx, dy, dz);
+			if (dx != x || dy != y || dz != z)
+			{
+				iFailures++;
+			}
+		}
+
+		for (int s = 0; s < sizeof(iSizes) / sizeof(iSizes[0]); s++)
+		{
+			//Every fragment in one voxel, so every radix pass gets skipped. A handful of voxels with long runs that
+			//straddle the merge chunks. Keys anywhere in the range, top bits included.
+			for (int iSpread = 0; iSpread < 3; iSpread++)
+			{
+				uint32_t iNumVoxels = iSpread == 0 ? 1 : 7;
+				std::vector<uint32_t> arrVoxelCoords(3 * iNumVoxels);
+				for (uint32_t v = 0; v < iNumVoxels; v++)
+				{
+					arrVoxelCoords[v * 3] = rng() % iRes;
+					arrVoxelCoords[v * 3 + 1] = rng() % iRes;
+					arrVoxelCoords[v * 3 + 2] = rng() % iRes;
+				}
+				std::vector<MortonFragment> arrInput(iSizes[s]);
+				for (int i = 0; i < iSizes[s]; i++)
+				{
+					uint32_t x, y, z;
+					if (iSpread == 2)
+					{
+						//Half at the far corner of the volume so the highest digits are all in use
+						bool bFar = rng() % 2 == 0;
+						x = bFar ? iRes - 1 - rng() % 4 : rng() % iRes;
+						y = bFar ? iRes - 1 - rng() % 4 : rng() % iRes;
+						z = bFar ? iRes - 1 - rng() % 4 : rng() % iRes;
+					}
+					else
+					{
+						uint32_t v = rng() % iNumVoxels;
+						x = arrVoxelCoords[v * 3];
+						y = arrVoxelCoords[v * 3 + 1];
+						z = arrVoxelCoords[v * 3 + 2];
+					}
+					//Colours differ within a voxel so an unstable sort changes the order they're found in
+					arrInput[i].iKey = list.EncodeKey(x, y, z);
+					arrInput[i].iColour = static_cast<uint32_t>(rng());
+					arrInput[i].iNormal = static_cast<uint32_t>(rng()) | 0xff000000;
+				}
+
+				std::vector<MortonFragment> arrSorted = arrInput;
+				SortReference(arrSorted);
+				std::vector<MortonFragment> arrMerged = arrSorted;
+				MergeReference(arrMerged);
+
+				int iThreadCounts[2] = { 1, iMaxThreads };
+				for (int t = 0; t < 2; t++)
+				{
+					int iThreads = iThreadCounts[t];
+					list.SetNumThreads(iThreads);
+					list.Clear();
+					list.AddFragments(arrInput.data(), arrInput.size());
+					list.Sort();
+					bool bSortMatches = FragmentsMatch(list.GetFragments(), arrSorted);
+					list.Merge();
+					bool bMergeMatches = FragmentsMatch(list.GetFragments(), arrMerged);
+					if (!bSortMatches || !bMergeMatches)
+					{
+						const char* sSpreads[] = { "one voxel", "a few voxels", "anywhere" };
+						VS_LOG_VERBOSE("Voxel fragment list " << iRes << "^3 with " << iSizes[s] << " fragments in " << sSpreads[iSpread] << " on " << iThreads
+							<< " threads: " << (bSortMatches ? "" : "sort ") << (bMergeMatches ? "" : "merge ") << "doesn't match");
+						iFailures += (bSortMatches ? 0 : 1) + (bMergeMatches ? 0 : 1);
+					}
+				}
+			}
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Voxel fragment list validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelFragmentList::RunBenchmark(const char* sName, int iNumFragments)
+{
+	//30 bit keys at the biggest dense volume, 60 bit keys at a resolution only a sparse structure could hold
+	const int iResolutions[] = { 512, 4096 };
+	const int iNumRuns = 3;
+	int iMaxThreads = Parallel::GetNumWorkerThreads();
+
+	std::vector<int> arrThreadCounts;
+	for (int t = 1; t < iMaxThreads; t *= 2)
+	{
+		arrThreadCounts.push_back(t);
+	}
+	arrThreadCounts.push_back(iMaxThreads);
+
+	std::stringstream ss;
+	ss << "../Results/VoxelFragmentList_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open voxel fragment list benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Key Bits, Threads, Fragments, Voxels, Radix Passes, Sort(ms), Merge(ms), Total(ms), Fragments/sec, Speedup, Reference(ms), Matches Reference\n";
+
+	bool bAllMatch = true;
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		VoxelFragmentList list;
+		if (!list.Initialise(iResolutions[r]))
+		{
+			continue;
+		}
+
+		//Fragments off a wavy surface, about 4 to a voxel like a dense mesh gives, arriving in no particular order
+		std::mt19937 rng(11);
+		int iNumSurfacePoints = std::max(1, iNumFragments / 4);
+		std::uniform_int_distribution<int> randPoint(0, iNumSurfacePoints - 1);
+		std::uniform_int_distribution<uint32_t> randColour(0, 0xffffffff);
+		std::uniform_int_distribution<int> randJitter(0, 3);
+		std::vector<MortonFragment> arrInput(iNumFragments);
+		float fRes = static_cast<float>(iResolutions[r]);
+		for (int i = 0; i < iNumFragments; i++)
+		{
+			uint64_t iHash = (static_cast<uint64_t>(randPoint(rng)) + 1) * 0x9e3779b97f4a7c15ULL;
+			iHash = (iHash ^ (iHash >> 31)) * 0xbf58476d1ce4e5b9ULL;
+			uint32_t x = static_cast<uint32_t>(iHash % iResolutions[r]);
+			uint32_t y = static_cast<uint32_t>((iHash >> 32) % iResolutions[r]);
+			float fHeight = 0.5f + 0.25f * sinf(x * 6.2831853f / fRes * 3.f) * cosf(y * 6.2831853f / fRes * 2.f);
+			uint32_t z = std::min(static_cast<uint32_t>(fHeight * fRes) + (randJitter(rng) == 3 ? 1u : 0u), static_cast<uint32_t>(iResolutions[r] - 1));
+			arrInput[i].iKey = list.EncodeKey(x, y, z);
+			arrInput[i].iColour = randColour(rng);
+			arrInput[i].iNormal = PackNormalRGBA8(XMFLOAT3(0.f, 0.f, 1.f));
+		}
+
+		std::vector<MortonFragment> arrReference = arrInput;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		SortAndMergeReference(arrReference);
+		double dReferenceMs = GetElapsedMs(start);
+
+		double dSingleThreadMs = 0.0;
+		for (int t = 0; t < arrThreadCounts.size(); t++)
+		{
+			list.SetNumThreads(arrThreadCounts[t]);
+			double dBestMs = DBL_MAX;
+			Stats bestStats = list.GetStats();
+			for (int i = 0; i < iNumRuns; i++)
+			{
+				list.Clear();
+				list.AddFragments(arrInput.data(), arrInput.size());
+				list.SortAndMerge();
+				double dMs = list.GetStats().dSortTimeMs + list.GetStats().dMergeTimeMs;
+				if (dMs < dBestMs)
+				{
+					dBestMs = dMs;
+					bestStats = list.GetStats();
+				}
+			}
+			if (t == 0)
+			{
+				dSingleThreadMs = dBestMs;
+			}
+
+			bool bMatch = FragmentsMatch(list.GetFragments(), arrReference);
+			bAllMatch &= bMatch;
+			double dFragmentsPerSec = iNumFragments / (dBestMs / 1000.0);
+			outfile << iResolutions[r] << "," << bestStats.iKeyBits << "," << arrThreadCounts[t] << "," << iNumFragments << "," << bestStats.iNumVoxels << ","
+				<< bestStats.iNumPasses << "," << bestStats.dSortTimeMs << "," << bestStats.dMergeTimeMs << "," << dBestMs << "," << dFragmentsPerSec << ","
+				<< dSingleThreadMs / dBestMs << "," << dReferenceMs << "," << (bMatch ? "Yes" : "No") << "\n";
+
+			VS_LOG("Voxel fragment list " << iResolutions[r] << "^3, " << arrThreadCounts[t] << " threads: " << dBestMs << "ms, " << dFragmentsPerSec << " fragments/sec");
+		}
+	}
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	if (!bAllMatch)
+	{
+		VS_LOG_VERBOSE("Voxel fragment list sort and merge doesn't match the reference");
+	}
+	return bAllMatch && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,108 @@
+#ifndef VOXEL_FRAGMENT_LIST_H
+#define VOXEL_FRAGMENT_LIST_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+#include "CPUVoxelVolume.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//One voxelised fragment, keyed by the Morton code of its voxel so sorting by key puts the voxels in Z order
+struct MortonFragment
+{
+	uint64_t iKey;
+	uint32_t iColour;	//RGBA8, see PackRGBA8
+	uint32_t iNormal;	//see PackNormalRGBA8
+};
+
+//Fragment list stage between voxelising and writing voxels. Instead of the last fragment to land in a voxel winning,
+//every fragment goes into the pool, the pool gets radix sorted by Morton code, then the fragments in each voxel are
+//merged into one with their colours and normals averaged. The result doesn't depend on the order fragments arrived
+//in or the thread count, it's in Z order for the sparse builders, and it can be written out as a dense mip 0 for
+//uploading to the radiance volume.
+//Keys are 30 bit (10 bits an axis) up to 1024^3 and 60 bit (20 bits an axis) above that.
+class VoxelFragmentList
+{
+public:
+
+	struct Stats
+	{
+		int iNumThreads;
+		int iKeyBits;
+		int iNumPasses;			//radix passes that actually moved data, passes where every key has the same digit are skipped
+		long long iNumFragments;
+		long long iNumVoxels;	//after merging
+		double dSortTimeMs;
+		double dMergeTimeMs;
+	};
+
+	static const int kRadixBits = 8;
+
+	static uint32_t EncodeMorton30(uint32_t x, uint32_t y, uint32_t z);
+	static uint64_t EncodeMorton60(uint32_t x, uint32_t y, uint32_t z);
+	//Works for both key sizes
+	static void DecodeMorton(uint64_t iKey, uint32_t& x, uint32_t& y, uint32_t& z);
+
+	VoxelFragmentList();
+	~VoxelFragmentList();
+
+	//iResolution has to be a power of 2 no bigger than 2^20. iNumThreads <= 0 uses every core.
+	bool Initialise(int iResolution, int iNumThreads = 0);
+	void Shutdown();
+	void Clear();
+	void Reserve(size_t iNumFragments);
+
+	void SetNumThreads(int iNumThreads) { m_iNumThreads = iNumThreads; }
+
+	uint64_t EncodeKey(uint32_t x, uint32_t y, uint32_t z) const;
+	void AddFragment(uint32_t x, uint32_t y, uint32_t z, uint32_t iColour, uint32_t iNormal);
+	//Appends a pool of fragments some other stage has already keyed with EncodeKey
+	void AddFragments(const MortonFragment* pFragments, size_t iNumFragments);
+
+	//Sorts into Morton order then merges the fragments in each voxel. Afterwards there's one fragment per voxel.
+	void SortAndMerge();
+	void Sort();
+	void Merge();
+
+	int GetResolution() const { return m_iResolution; }
+	int GetKeyBits() const { return m_iKeyBits; }
+	size_t GetNumFragments() const { return m_arrFragments.size(); }
+	const std::vector<MortonFragment>& GetFragments() const { return m_arrFragments; }
+	const Stats& GetStats() const { return m_Stats; }
+
+	//For SparseVoxelOctree::Build
+	void GetVoxelFragments(std::vector<VoxelFragment>& arrFragments) const;
+	//Clears mip 0 of the volume and writes the merged voxels into it, ready to upload
+	bool WriteToVolume(CPUVoxelVolume* pVolume) const;
+
+	//Random fragment pools at 30 and 60 bit keys, from empty to big enough to split between threads and from every key
+	//the same to keys across the whole range. Checks Sort against std::stable_sort, Merge against a serial merge and the
+	//Morton codes round trip, on one thread and several. Returns the number of mismatches.
+	static int Validate(unsigned int iSeed);
+
+	//Sorts and merges iNumFragments synthetic fragments at 30 and 60 bit keys for 1 to all threads, checking each
+	//against std::stable_sort and a serial merge, and writes fragments/second to ../Results/
+	static bool RunBenchmark(const char* sName, int iNumFragments);
+
+private:
+
+	int m_iResolution;
+	int m_iKeyBits;
+	int m_iNumThreads;
+
+	std::vector<MortonFragment> m_arrFragments;
+	std::vector<MortonFragment> m_arrScratch;
+
+	Stats m_Stats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !VOXEL_FRAGMENT_LIST_H
@@ -0,0 +1,82 @@
+#include "VoxelGrid.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelGrid::VoxelGrid()
+	: m_iResolution(0)
+	, m_fVoxelSize(0.f)
+	, m_vScale(0.f, 0.f, 0.f)
+	, m_vOffset(0.f, 0.f, 0.f)
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+XMMATRIX VoxelGrid::CreateWorldToVoxelGrid(const XMFLOAT3& vMin, const XMFLOAT3& vMax, float& fVoxelGridSize)
+{
+	XMFLOAT3 vVoxelGridSize(vMax.x - vMin.x, vMax.y - vMin.y, vMax.z - vMin.z);
+
+	//make the voxel grid into a square which will fit the whole scene
+	fVoxelGridSize = vVoxelGridSize.x;
+	if (vVoxelGridSize.y > fVoxelGridSize)
+	{
+		fVoxelGridSize = vVoxelGridSize.y;
+	}
+	if (vVoxelGridSize.z > fVoxelGridSize)
+	{
+		fVoxelGridSize = vVoxelGridSize.z;
+	}
+
+	//Move the centre of the AABB to the origin and scale the cube down to [-1, 1]
+	float fScale = 2.f / fVoxelGridSize;
+	XMFLOAT3 vTranslateToOrigin;
+	vTranslateToOrigin.x = (-vMin.x - (vVoxelGridSize.x * 0.5f)) * fScale;
+	vTranslateToOrigin.y = (-vMin.y - (vVoxelGridSize.y * 0.5f)) * fScale;
+	vTranslateToOrigin.z = (-vMin.z - (vVoxelGridSize.z * 0.5f)) * fScale;
+
+	XMMATRIX mWorldToVoxelGrid = XMMatrixScaling(fScale, fScale, fScale) * XMMatrixTranslation(vTranslateToOrigin.x, vTranslateToOrigin.y, vTranslateToOrigin.z);
+
+	return XMMatrixTranspose(mWorldToVoxelGrid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelGrid::Initialise(const XMMATRIX& mWorldToVoxelGrid, int iResolution)
+{
+	m_iResolution = iResolution;
+
+	XMFLOAT4X4 mGrid;
+	XMStoreFloat4x4(&mGrid, XMMatrixTranspose(mWorldToVoxelGrid));
+
+	//grid space is [-1, 1], voxel space is [0, resolution)
+	float fHalfRes = iResolution * 0.5f;
+	m_vScale = XMFLOAT3(mGrid.m[0][0] * fHalfRes, mGrid.m[1][1] * fHalfRes, mGrid.m[2][2] * fHalfRes);
+	m_vOffset = XMFLOAT3((mGrid.m[3][0] + 1.f) * fHalfRes, (mGrid.m[3][1] + 1.f) * fHalfRes, (mGrid.m[3][2] + 1.f) * fHalfRes);
+	m_fVoxelSize = 1.f / m_vScale.x;
+
+	XMMATRIX mWorldToVoxel = XMMatrixScaling(m_vScale.x, m_vScale.y, m_vScale.z) * XMMatrixTranslation(m_vOffset.x, m_vOffset.y, m_vOffset.z);
+	XMMATRIX mVoxelToWorld = XMMatrixTranslation(-m_vOffset.x, -m_vOffset.y, -m_vOffset.z) * XMMatrixScaling(1.f / m_vScale.x, 1.f / m_vScale.y, 1.f / m_vScale.z);
+	XMStoreFloat4x4(&m_mWorldToVoxel, mWorldToVoxel);
+	XMStoreFloat4x4(&m_mVoxelToWorld, mVoxelToWorld);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelGrid::WorldToVoxel(const XMFLOAT3& vWorld, XMFLOAT3& vVoxel) const
+{
+	vVoxel.x = vWorld.x * m_vScale.x + m_vOffset.x;
+	vVoxel.y = vWorld.y * m_vScale.y + m_vOffset.y;
+	vVoxel.z = vWorld.z * m_vScale.z + m_vOffset.z;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelGrid::VoxelToWorld(const XMFLOAT3& vVoxel, XMFLOAT3& vWorld) const
+{
+	vWorld.x = (vVoxel.x - m_vOffset.x) / m_vScale.x;
+	vWorld.y = (vVoxel.y - m_vOffset.y) / m_vScale.y;
+	vWorld.z = (vVoxel.z - m_vOffset.z) / m_vScale.z;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
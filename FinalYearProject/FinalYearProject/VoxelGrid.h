@@ -0,0 +1,64 @@
+#ifndef VOXEL_GRID_H
+#define VOXEL_GRID_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//The voxel grid conventions shared by the GPU voxelisation and the CPU voxel tools.
+//The world to voxel grid matrix maps the scene cube onto [-1, 1] on every axis. It is stored transposed, ready for
+//the shaders, so anything doing the maths on the CPU goes through here rather than unpicking it itself.
+//Voxel (x, y, z) covers [x, x+1) in voxel space, where voxel space = (grid * 0.5 + 0.5) * resolution.
+class VoxelGrid
+{
+public:
+	VoxelGrid();
+
+	//Fits a cube around the AABB and builds the (transposed) world to voxel grid matrix, same as the GPU path has always done
+	static XMMATRIX CreateWorldToVoxelGrid(const XMFLOAT3& vMin, const XMFLOAT3& vMax, float& fVoxelGridSize);
+
+	void Initialise(const XMMATRIX& mWorldToVoxelGrid, int iResolution);
+
+	//[-1, 1] grid space to [0, resolution) voxel space, for things that only have grid space positions
+	static void GridToVoxel(const XMFLOAT3& vGrid, int iResolution, XMFLOAT3& vVoxel)
+	{
+		float fHalfRes = iResolution * 0.5f;
+		vVoxel.x = vGrid.x * fHalfRes + fHalfRes;
+		vVoxel.y = vGrid.y * fHalfRes + fHalfRes;
+		vVoxel.z = vGrid.z * fHalfRes + fHalfRes;
+	}
+
+	int GetResolution() const { return m_iResolution; }
+
+	//Untransposed (row vector) versions, so they can be used directly with XMVector3TransformCoord
+	const XMFLOAT4X4& GetWorldToVoxelMatrix() const { return m_mWorldToVoxel; }
+	const XMFLOAT4X4& GetVoxelToWorldMatrix() const { return m_mVoxelToWorld; }
+
+	void WorldToVoxel(const XMFLOAT3& vWorld, XMFLOAT3& vVoxel) const;
+	void VoxelToWorld(const XMFLOAT3& vVoxel, XMFLOAT3& vWorld) const;
+
+	//Size of one voxel in world units
+	float GetVoxelSize() const { return m_fVoxelSize; }
+
+private:
+
+	int m_iResolution;
+	float m_fVoxelSize;
+
+	//The grid is a scaled and translated cube so these are all we need per axis: voxel = world * scale + offset
+	XMFLOAT3 m_vScale;
+	XMFLOAT3 m_vOffset;
+
+	XMFLOAT4X4 m_mWorldToVoxel;
+	XMFLOAT4X4 m_mVoxelToWorld;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !VOXEL_GRID_H
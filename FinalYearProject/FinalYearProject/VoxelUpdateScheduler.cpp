@@ -0,0 +1,738 @@
+#include "VoxelUpdateScheduler.h"
+#include "CPURadianceInjector.h"
+#include "CPUVoxeliser.h"
+#include "VoxelGrid.h"
+#include "Debugging.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const int VoxelUpdateScheduler::kCostHistory;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	const double kCostSmoothing = 0.1;			//weight of each new time in the cost fit
+	const double kMinRegionVariance = 0.25;		//below this the region counts are too steady to fit a slope to
+	const float kMinCostPerRegionMs = 0.0001f;
+
+	double GetElapsedMs(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelUpdateScheduler::VoxelUpdateScheduler()
+	: m_iResolution(0),
+	m_iRegionSize(0),
+	m_iRegionsPerAxis(0),
+	m_iFrame(0),
+	m_iMinRegionsPerFrame(1),
+	m_fBudgetMs(0.f),
+	m_fFixedMs(0.f),
+	m_fPerRegionMs(0.01f),
+	m_dMeanRegions(0.0),
+	m_dMeanMs(0.0),
+	m_dMeanRegionsSq(0.0),
+	m_dMeanRegionsMs(0.0),
+	m_bHaveCostSamples(false)
+{
+	memset(m_arrRegionHistory, 0, sizeof(m_arrRegionHistory));
+	memset(&m_FrameStats, 0, sizeof(m_FrameStats));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelUpdateScheduler::~VoxelUpdateScheduler()
+{
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelUpdateScheduler::Initialise(int iResolution, int iRegionSize, float fBudgetMs)
+{
+	if (iRegionSize <= 0 || iResolution < iRegionSize || iResolution % iRegionSize != 0)
+	{
+		VS_LOG_VERBOSE("Voxel update regions have to divide the volume");
+		return false;
+	}
+	m_iResolution = iResolution;
+	m_iRegionSize = iRegionSize;
+	m_iRegionsPerAxis = iResolution / iRegionSize;
+	m_fBudgetMs = fBudgetMs;
+	m_iFrame = 0;
+
+	int iNumRegions = m_iRegionsPerAxis * m_iRegionsPerAxis * m_iRegionsPerAxis;
+	m_arrLastUpdated.assign(iNumRegions, -1);
+	m_arrDirty.assign(iNumRegions, 1);
+	m_arrEmpty.assign(iNumRegions, 0);
+	m_arrScheduled.clear();
+	m_arrScheduled.reserve(iNumRegions);
+	m_arrBoxes.clear();
+	m_arrCandidates.reserve(iNumRegions);
+
+	m_bHaveCostSamples = false;
+	memset(m_arrRegionHistory, 0, sizeof(m_arrRegionHistory));
+	memset(&m_FrameStats, 0, sizeof(m_FrameStats));
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelUpdateScheduler::SetCostEstimate(float fFixedMs, float fPerRegionMs)
+{
+	m_fFixedMs = std::max(0.f, fFixedMs);
+	m_fPerRegionMs = std::max(kMinCostPerRegionMs, fPerRegionMs);
+	m_bHaveCostSamples = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelUpdateScheduler::GetRegionBox(int iRegion, Box& box) const
+{
+	int vRegion[3] = { iRegion % m_iRegionsPerAxis, (iRegion / m_iRegionsPerAxis) % m_iRegionsPerAxis, iRegion / (m_iRegionsPerAxis * m_iRegionsPerAxis) };
+	for (int i = 0; i < 3; i++)
+	{
+		box.vMin[i] = vRegion[i] * m_iRegionSize;
+		box.vMax[i] = box.vMin[i] + m_iRegionSize;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelUpdateScheduler::MarkBoxDirty(const int vMin[3], const int vMax[3])
+{
+	int vRegionMin[3], vRegionMax[3];
+	for (int i = 0; i < 3; i++)
+	{
+		int iMin = std::max(vMin[i], 0);
+		int iMax = std::min(vMax[i], m_iResolution);
+		if (iMin >= iMax)
+		{
+			return;
+		}
+		vRegionMin[i] = iMin / m_iRegionSize;
+		vRegionMax[i] = (iMax - 1) / m_iRegionSize;
+	}
+	for (int rz = vRegionMin[2]; rz <= vRegionMax[2]; rz++)
+	{
+		for (int ry = vRegionMin[1]; ry <= vRegionMax[1]; ry++)
+		{
+			for (int rx = vRegionMin[0]; rx <= vRegionMax[0]; rx++)
+			{
+				m_arrDirty[GetRegionIndex(rx, ry, rz)] = 1;
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelUpdateScheduler::MarkSphereDirty(const XMFLOAT3& vCentre, float fRadius)
+{
+	float vSphere[3] = { vCentre.x, vCentre.y, vCentre.z };
+	int vRegionMin[3], vRegionMax[3];
+	for (int i = 0; i < 3; i++)
+	{
+		float fMin = std::max(vSphere[i] - fRadius, 0.f);
+		float fMax = std::min(vSphere[i] + fRadius, static_cast<float>(m_iResolution) - 0.5f);
+		if (fMin > fMax)
+		{
+			return;
+		}
+		vRegionMin[i] = static_cast<int>(fMin) / m_iRegionSize;
+		vRegionMax[i] = static_cast<int>(fMax) / m_iRegionSize;
+	}
+
+	//Only the regions the sphere actually reaches, not its whole bounding box
+	float fRadiusSq = fRadius * fRadius;
+	for (int rz = vRegionMin[2]; rz <= vRegionMax[2]; rz++)
+	{
+		for (int ry = vRegionMin[1]; ry <= vRegionMax[1]; ry++)
+		{
+			for (int rx = vRegionMin[0]; rx <= vRegionMax[0]; rx++)
+			{
+				int vRegion[3] = { rx, ry, rz };
+				float fDistanceSq = 0.f;
+				for (int i = 0; i < 3; i++)
+				{
+					float fBoxMin = static_cast<float>(vRegion[i] * m_iRegionSize);
+					float fBoxMax = fBoxMin + m_iRegionSize;
+					float d = std::max(std::max(fBoxMin - vSphere[i], 0.f), vSphere[i] - fBoxMax);
+					fDistanceSq += d * d;
+				}
+				if (fDistanceSq <= fRadiusSq)
+				{
+					m_arrDirty[GetRegionIndex(rx, ry, rz)] = 1;
+				}
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelUpdateScheduler::MarkAllDirty()
+{
+	std::fill(m_arrDirty.begin(), m_arrDirty.end(), static_cast<uint8_t>(1));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelUpdateScheduler::ScheduleFrame()
+{
+	m_iFrame++;
+	m_arrScheduled.clear();
+	int iNumRegions = GetNumRegions();
+
+	for (int r = 0; r < iNumRegions; r++)
+	{
+		if (m_arrDirty[r])
+		{
+			m_arrScheduled.push_back(r);
+			m_arrLastUpdated[r] = m_iFrame;
+			m_arrDirty[r] = 0;
+		}
+	}
+	int iNumForced = static_cast<int>(m_arrScheduled.size());
+
+	//As many more as the budget has room for, least recently updated first. Ties go to the lowest index, so with a
+	//steady budget the regions come round in order.
+	int iBudgetRegions = static_cast<int>(std::min(static_cast<double>(iNumRegions), std::max(0.0, floor((m_fBudgetMs - m_fFixedMs) / m_fPerRegionMs))));
+	int iExtra = std::max(iBudgetRegions - iNumForced, m_iMinRegionsPerFrame);
+	if (iExtra > 0)
+	{
+		m_arrCandidates.clear();
+		for (int r = 0; r < iNumRegions; r++)
+		{
+			if (!m_arrEmpty[r] && m_arrLastUpdated[r] != m_iFrame)
+			{
+				m_arrCandidates.push_back((static_cast<uint64_t>(m_arrLastUpdated[r] + 1) << 32) | static_cast<uint64_t>(r));
+			}
+		}
+		if (iExtra < static_cast<int>(m_arrCandidates.size()))
+		{
+			std::nth_element(m_arrCandidates.begin(), m_arrCandidates.begin() + iExtra, m_arrCandidates.end());
+			m_arrCandidates.resize(iExtra);
+		}
+		for (size_t i = 0; i < m_arrCandidates.size(); i++)
+		{
+			int r = static_cast<int>(m_arrCandidates[i] & 0xffffffff);
+			m_arrScheduled.push_back(r);
+			m_arrLastUpdated[r] = m_iFrame;
+		}
+	}
+
+	//Runs of neighbouring regions along x go as one box, so there are fewer copies
+	std::sort(m_arrScheduled.begin(), m_arrScheduled.end());
+	m_arrBoxes.clear();
+	for (size_t i = 0; i < m_arrScheduled.size(); i++)
+	{
+		int r = m_arrScheduled[i];
+		bool bExtendsLast = i > 0 && r == m_arrScheduled[i - 1] + 1 && r % m_iRegionsPerAxis != 0;
+		if (bExtendsLast)
+		{
+			m_arrBoxes.back().vMax[0] += m_iRegionSize;
+		}
+		else
+		{
+			Box box;
+			GetRegionBox(r, box);
+			m_arrBoxes.push_back(box);
+		}
+	}
+
+	int iNumScheduled = static_cast<int>(m_arrScheduled.size());
+	m_arrRegionHistory[m_iFrame % kCostHistory] = iNumScheduled;
+	m_FrameStats.iFrame = m_iFrame;
+	m_FrameStats.iNumRegionsUpdated = iNumScheduled;
+	m_FrameStats.iNumForced = iNumForced;
+	m_FrameStats.iNumBoxes = static_cast<int>(m_arrBoxes.size());
+	m_FrameStats.fEstimatedMs = m_fFixedMs + m_fPerRegionMs * iNumScheduled;
+	m_FrameStats.bOverBudget = m_FrameStats.fEstimatedMs > m_fBudgetMs;
+	UpdateStaleness();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelUpdateScheduler::UpdateStaleness()
+{
+	int iMax = 0;
+	long long iTotal = 0;
+	int iCount = 0;
+	for (int r = 0; r < GetNumRegions(); r++)
+	{
+		if (m_arrEmpty[r])
+		{
+			continue;
+		}
+		//Never updated counts as stale as the frames so far
+		int iStaleness = m_arrLastUpdated[r] < 0 ? m_iFrame : m_iFrame - m_arrLastUpdated[r];
+		iMax = std::max(iMax, iStaleness);
+		iTotal += iStaleness;
+		iCount++;
+	}
+	m_FrameStats.iMaxStaleness = iMax;
+	m_FrameStats.fMeanStaleness = iCount > 0 ? static_cast<float>(static_cast<double>(iTotal) / iCount) : 0.f;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelUpdateScheduler::ReportFrameCost(int iFramesAgo, float fMs)
+{
+	int iFrame = m_iFrame - iFramesAgo;
+	if (iFramesAgo < 0 || iFramesAgo >= kCostHistory || iFrame < 1)
+	{
+		return;
+	}
+	double n = static_cast<double>(m_arrRegionHistory[iFrame % kCostHistory]);
+	double ms = static_cast<double>(fMs);
+	if (!m_bHaveCostSamples)
+	{
+		m_dMeanRegions = n;
+		m_dMeanMs = ms;
+		m_dMeanRegionsSq = n * n;
+		m_dMeanRegionsMs = n * ms;
+		m_bHaveCostSamples = true;
+	}
+	else
+	{
+		m_dMeanRegions += (n - m_dMeanRegions) * kCostSmoothing;
+		m_dMeanMs += (ms - m_dMeanMs) * kCostSmoothing;
+		m_dMeanRegionsSq += (n * n - m_dMeanRegionsSq) * kCostSmoothing;
+		m_dMeanRegionsMs += (n * ms - m_dMeanRegionsMs) * kCostSmoothing;
+	}
+
+	//Least squares line through the recent (regions, ms) pairs when the counts have moved around enough, otherwise
+	//keep the fixed part and put the rest of the time down to the regions
+	double dVariance = m_dMeanRegionsSq - m_dMeanRegions * m_dMeanRegions;
+	if (dVariance > kMinRegionVariance)
+	{
+		double dSlope = (m_dMeanRegionsMs - m_dMeanRegions * m_dMeanMs) / dVariance;
+		double dIntercept = m_dMeanMs - dSlope * m_dMeanRegions;
+		if (dSlope > kMinCostPerRegionMs && dIntercept >= 0.0)
+		{
+			m_fPerRegionMs = static_cast<float>(dSlope);
+			m_fFixedMs = static_cast<float>(dIntercept);
+			return;
+		}
+	}
+	if (m_dMeanRegions > 0.0)
+	{
+		m_fFixedMs = std::min(m_fFixedMs, static_cast<float>(m_dMeanMs));
+		m_fPerRegionMs = std::max(kMinCostPerRegionMs, static_cast<float>((m_dMeanMs - m_fFixedMs) / m_dMeanRegions));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int VoxelUpdateScheduler::Validate(unsigned int iSeed)
+{
+	std::mt19937 rng(iSeed);
+	int iFailures = 0;
+
+	for (int iTest = 0; iTest < 8; iTest++)
+	{
+		int iRegionSize = 4 << (iTest % 3);
+		int iResolution = iRegionSize * (2 + iTest);
+		VoxelUpdateScheduler scheduler;
+		scheduler.Initialise(iResolution, iRegionSize, 1.f);
+		int iNumRegions = scheduler.GetNumRegions();
+		int iPerFrame = 1 + static_cast<int>(rng() % std::max(1, iNumRegions / 4));
+		scheduler.SetCostEstimate(0.25f, 0.75f / iPerFrame);
+		//Budget a hair over what iPerFrame regions cost, so rounding can't take one away
+		scheduler.SetBudgetMs(0.25f + 0.75f / iPerFrame * (iPerFrame + 0.5f));
+
+		int iNumNonEmpty = 0;
+		for (int r = 0; r < iNumRegions; r++)
+		{
+			bool bEmpty = rng() % 10 == 0;
+			scheduler.SetRegionEmpty(r, bEmpty);
+			iNumNonEmpty += bEmpty ? 0 : 1;
+		}
+
+		//First frame does everything
+		scheduler.ScheduleFrame();
+		iFailures += scheduler.GetFrameStats().iNumRegionsUpdated != iNumRegions;
+
+		std::uniform_int_distribution<int> coord(-iRegionSize, iResolution + iRegionSize);
+		int iCycle = (std::max(iNumNonEmpty, 1) + iPerFrame - 1) / iPerFrame;
+		int iQuietFrames = 0;
+		for (int f = 0; f < 200 + iCycle * 3; f++)
+		{
+			//Dirty boxes for the first 200 frames, then quiet so the staleness bound can be checked
+			std::vector<uint8_t> arrExpected(iNumRegions, 0);
+			bool bDirty = f < 200 && rng() % 3 == 0;
+			if (bDirty)
+			{
+				int vMin[3], vMax[3];
+				for (int i = 0; i < 3; i++)
+				{
+					int a = coord(rng), b = coord(rng);
+					vMin[i] = std::min(a, b);
+					vMax[i] = std::max(a, b) + 1;
+				}
+				scheduler.MarkBoxDirty(vMin, vMax);
+				for (int r = 0; r < iNumRegions; r++)
+				{
+					Box box;
+					scheduler.GetRegionBox(r, box);
+					bool bOverlaps = true;
+					for (int i = 0; i < 3; i++)
+					{
+						bOverlaps &= std::max(vMin[i], 0) < box.vMax[i] && std::min(vMax[i], iResolution) > box.vMin[i];
+					}
+					arrExpected[r] = bOverlaps ? 1 : 0;
+				}
+			}
+			scheduler.ScheduleFrame();
+			const std::vector<int>& arrScheduled = scheduler.GetScheduledRegions();
+
+			//Dirty regions all there, nothing twice, and the boxes cover exactly the regions
+			std::vector<int> arrCount(iNumRegions, 0);
+			for (size_t i = 0; i < arrScheduled.size(); i++)
+			{
+				arrCount[arrScheduled[i]]++;
+			}
+			long long iBoxVoxels = 0;
+			const std::vector<Box>& arrBoxes = scheduler.GetScheduledBoxes();
+			for (size_t b = 0; b < arrBoxes.size(); b++)
+			{
+				iBoxVoxels += static_cast<long long>(arrBoxes[b].vMax[0] - arrBoxes[b].vMin[0]) * (arrBoxes[b].vMax[1] - arrBoxes[b].vMin[1]) * (arrBoxes[b].vMax[2] - arrBoxes[b].vMin[2]);
+				for (int z = arrBoxes[b].vMin[2]; z < arrBoxes[b].vMax[2]; z += iRegionSize)
+				{
+					for (int y = arrBoxes[b].vMin[1]; y < arrBoxes[b].vMax[1]; y += iRegionSize)
+					{
+						for (int x = arrBoxes[b].vMin[0]; x < arrBoxes[b].vMax[0]; x += iRegionSize)
+						{
+							iFailures += arrCount[scheduler.GetRegionIndex(x / iRegionSize, y / iRegionSize, z / iRegionSize)] != 1;
+						}
+					}
+				}
+			}
+			iFailures += iBoxVoxels != static_cast<long long>(arrScheduled.size()) * iRegionSize * iRegionSize * iRegionSize;
+			int iNumForced = 0;
+			for (int r = 0; r < iNumRegions; r++)
+			{
+				iFailures += arrCount[r] > 1;
+				iFailures += arrExpected[r] && arrCount[r] != 1;
+				iFailures += arrCount[r] == 1 && scheduler.GetStaleness(r) != 0;
+				iNumForced += arrExpected[r];
+			}
+			iFailures += scheduler.GetFrameStats().iNumForced != iNumForced;
+
+			//Within budget when nothing's dirty, and once a whole cycle has gone by nothing is staler than a cycle
+			if (!bDirty)
+			{
+				iFailures += static_cast<int>(arrScheduled.size()) != std::min(iPerFrame, iNumNonEmpty);
+				iQuietFrames = f >= 200 ? iQuietFrames + 1 : 0;
+				if (iQuietFrames > iCycle)
+				{
+					iFailures += scheduler.GetFrameStats().iMaxStaleness >= iCycle + 1;
+				}
+			}
+		}
+	}
+
+	//The cost fit against a known line, with noise and the times coming back two frames late. Dirty boxes of all sizes
+	//keep the region counts moving so there's a line to fit.
+	{
+		const float fFixedMs = 0.5f, fPerRegionMs = 0.02f, fBudgetMs = 2.f;
+		VoxelUpdateScheduler scheduler;
+		scheduler.Initialise(256, 16, fBudgetMs);
+		scheduler.SetCostEstimate(0.f, 0.1f);
+		std::uniform_real_distribution<float> noise(0.98f, 1.02f);
+		std::uniform_int_distribution<int> coord(0, 255), size(0, 128);
+		std::vector<float> arrCosts;
+		auto runFrame = [&]()
+		{
+			scheduler.ScheduleFrame();
+			arrCosts.push_back(fFixedMs + fPerRegionMs * scheduler.GetFrameStats().iNumRegionsUpdated);
+			if (arrCosts.size() > 2)
+			{
+				scheduler.ReportFrameCost(2, arrCosts[arrCosts.size() - 3] * noise(rng));
+			}
+		};
+		for (int f = 0; f < 400; f++)
+		{
+			if (f % 2 == 0)
+			{
+				int iSize = size(rng);
+				int vMin[3] = { coord(rng), coord(rng), coord(rng) };
+				int vMax[3] = { vMin[0] + iSize, vMin[1] + iSize, vMin[2] + iSize };
+				scheduler.MarkBoxDirty(vMin, vMax);
+			}
+			runFrame();
+		}
+		if (fabsf(scheduler.GetFixedCostMs() - fFixedMs) > 0.15f || fabsf(scheduler.GetCostPerRegionMs() - fPerRegionMs) > 0.005f)
+		{
+			iFailures++;
+		}
+		//With the dirty boxes stopped the frames should come in at the budget
+		for (int f = 0; f < 40; f++)
+		{
+			runFrame();
+			if (f >= 4 && (arrCosts.back() > fBudgetMs * 1.1f || arrCosts.back() < fBudgetMs * 0.8f))
+			{
+				iFailures++;
+			}
+		}
+	}
+
+	//No budget and no minimum, as VoxelisedScene runs it when not amortising: exactly the dirty regions each frame,
+	//whatever the costs reported, and nothing at all when nothing changed
+	{
+		VoxelUpdateScheduler scheduler;
+		scheduler.Initialise(128, 16, 0.f);
+		scheduler.SetMinRegionsPerFrame(0);
+		scheduler.ScheduleFrame();
+		iFailures += scheduler.GetFrameStats().iNumRegionsUpdated != scheduler.GetNumRegions();
+		std::uniform_int_distribution<int> coord(-8, 136);
+		for (int f = 0; f < 100; f++)
+		{
+			std::vector<uint8_t> arrExpected(scheduler.GetNumRegions(), 0);
+			if (f % 4 != 3)
+			{
+				int vMin[3], vMax[3];
+				for (int i = 0; i < 3; i++)
+				{
+					int a = coord(rng), b = coord(rng);
+					vMin[i] = std::min(a, b);
+					vMax[i] = std::max(a, b) + 1;
+				}
+				scheduler.MarkBoxDirty(vMin, vMax);
+				for (int r = 0; r < scheduler.GetNumRegions(); r++)
+				{
+					Box box;
+					scheduler.GetRegionBox(r, box);
+					bool bOverlaps = true;
+					for (int i = 0; i < 3; i++)
+					{
+						bOverlaps &= std::max(vMin[i], 0) < box.vMax[i] && std::min(vMax[i], 128) > box.vMin[i];
+					}
+					arrExpected[r] = bOverlaps ? 1 : 0;
+				}
+			}
+			scheduler.ScheduleFrame();
+			scheduler.ReportFrameCost(0, 0.5f);
+			std::vector<uint8_t> arrScheduled(scheduler.GetNumRegions(), 0);
+			for (size_t i = 0; i < scheduler.GetScheduledRegions().size(); i++)
+			{
+				arrScheduled[scheduler.GetScheduledRegions()[i]] = 1;
+			}
+			iFailures += arrScheduled != arrExpected;
+		}
+	}
+
+	if (iFailures > 0)
+	{
+		VS_LOG_VERBOSE("Voxel update scheduler validation failed " << iFailures << " times");
+	}
+	return iFailures;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelUpdateScheduler::RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser)
+{
+	const int iResolutions[] = { 128, 256 };
+	const float fBudgetFractions[] = { 1.f / 16.f, 1.f / 8.f, 1.f / 4.f };	//of relighting the whole volume
+	const int iRegionSize = 32;
+	const int iNumFrames = 90;
+	const int iNumLights = 8;
+
+	std::stringstream ss;
+	ss << "../Results/VoxelUpdateScheduler_" << sName << ".csv";
+	std::ofstream outfile;
+	outfile.open(ss.str().c_str());
+	if (!outfile.is_open())
+	{
+		VS_LOG_VERBOSE("Failed to open voxel update scheduler benchmark output file");
+		return false;
+	}
+	outfile << std::fixed << "Resolution, Budget(ms), Frame, Regions Updated, Forced, Boxes, Estimated ms, Measured ms, Over Budget, Max Staleness, Mean Staleness\n";
+
+	std::stringstream summary;
+	bool bAllConverged = true;
+	XMMATRIX mWorldToVoxelGrid = pVoxeliser->GetWorldToVoxelGrid();
+	for (int r = 0; r < sizeof(iResolutions) / sizeof(iResolutions[0]); r++)
+	{
+		int iResolution = iResolutions[r];
+		CPUVoxelVolume albedo;
+		if (!albedo.Initialise(iResolution, 1))
+		{
+			continue;
+		}
+		pVoxeliser->Voxelise(&albedo);
+		VoxelGrid grid;
+		grid.Initialise(mWorldToVoxelGrid, iResolution);
+
+		//Point lights spread through the volume, reaching an eighth of it. The first one moves in a circle.
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> position(0.2f, 0.8f);
+		float fRangeVoxels = iResolution / 8.f;
+		float fRangeWorld = fRangeVoxels * grid.GetVoxelSize();
+		std::vector<XMFLOAT3> arrLightVoxels(iNumLights);
+		for (int l = 0; l < iNumLights; l++)
+		{
+			arrLightVoxels[l] = XMFLOAT3(position(rng) * iResolution, position(rng) * iResolution, position(rng) * iResolution);
+		}
+		auto setLights = [&](CPURadianceInjector& injector)
+		{
+			injector.SetAmbientColour(XMFLOAT4(0.05f, 0.05f, 0.05f, 1.f));
+			injector.SetDirectionalColour(XMFLOAT4(0.3f, 0.3f, 0.3f, 1.f));
+			injector.ClearPointLights();
+			for (int l = 0; l < iNumLights; l++)
+			{
+				XMFLOAT3 vWorld;
+				grid.VoxelToWorld(arrLightVoxels[l], vWorld);
+				injector.AddPointLight(vWorld, XMFLOAT4(1.f, 0.9f, 0.8f, 1.f), 1.f / fRangeWorld);
+			}
+		};
+		auto moveLight = [&](int iFrame) -> XMFLOAT3
+		{
+			float fAngle = iFrame * 0.1f;
+			return XMFLOAT3(iResolution * (0.5f + 0.3f * cosf(fAngle)), iResolution * 0.5f, iResolution * (0.5f + 0.3f * sinf(fAngle)));
+		};
+
+		CPURadianceInjector injector;
+		if (!injector.Initialise(mWorldToVoxelGrid, iResolution))
+		{
+			continue;
+		}
+		CPUVoxelVolume radiance;
+		radiance.Initialise(iResolution, 1);
+		arrLightVoxels[0] = moveLight(0);
+		setLights(injector);
+		double dFullMs = DBL_MAX;
+		for (int i = 0; i < 3; i++)
+		{
+			injector.Inject(albedo, radiance);
+			dFullMs = std::min(dFullMs, injector.GetStats().dTimeMs);
+		}
+		summary << "\n" << iResolution << " Full Relight(ms):," << dFullMs;
+
+		for (int b = 0; b < sizeof(fBudgetFractions) / sizeof(fBudgetFractions[0]); b++)
+		{
+			float fBudgetMs = static_cast<float>(dFullMs * fBudgetFractions[b]);
+			VoxelUpdateScheduler scheduler;
+			scheduler.Initialise(iResolution, iRegionSize, fBudgetMs);
+			int iNumRegions = scheduler.GetNumRegions();
+			scheduler.SetCostEstimate(0.f, static_cast<float>(dFullMs / iNumRegions));
+			for (int i = 0; i < iNumRegions; i++)
+			{
+				Box box;
+				scheduler.GetRegionBox(i, box);
+				bool bEmpty = true;
+				for (int z = box.vMin[2]; z < box.vMax[2] && bEmpty; z++)
+				{
+					for (int y = box.vMin[1]; y < box.vMax[1] && bEmpty; y++)
+					{
+						for (int x = box.vMin[0]; x < box.vMax[0]; x++)
+						{
+							if (albedo.GetVoxel(x, y, z) != 0)
+							{
+								bEmpty = false;
+								break;
+							}
+						}
+					}
+				}
+				scheduler.SetRegionEmpty(i, bEmpty);
+			}
+
+			//A dynamic box an eighth of the volume across sweeping along x, and the first light going round. The
+			//voxels themselves don't change, only which regions are forced.
+			radiance.Clear();
+			int iBoxSize = iResolution / 8;
+			int vDynamicMin[3] = { 0, iResolution / 4, iResolution / 2 };
+			int iMaxStaleness = 0;
+			double dTotalMs = 0.0;
+			int iTotalRegions = 0;
+			for (int f = 0; f < iNumFrames; f++)
+			{
+				int vOldMin[3] = { vDynamicMin[0], vDynamicMin[1], vDynamicMin[2] };
+				vDynamicMin[0] = (f * 3) % (iResolution - iBoxSize);
+				int vOldMax[3] = { vOldMin[0] + iBoxSize, vOldMin[1] + iBoxSize, vOldMin[2] + iBoxSize };
+				int vNewMax[3] = { vDynamicMin[0] + iBoxSize, vDynamicMin[1] + iBoxSize, vDynamicMin[2] + iBoxSize };
+				scheduler.MarkBoxDirty(vOldMin, vOldMax);
+				scheduler.MarkBoxDirty(vDynamicMin, vNewMax);
+
+				XMFLOAT3 vOldLight = arrLightVoxels[0];
+				arrLightVoxels[0] = moveLight(f);
+				scheduler.MarkSphereDirty(vOldLight, fRangeVoxels);
+				scheduler.MarkSphereDirty(arrLightVoxels[0], fRangeVoxels);
+				setLights(injector);
+
+				scheduler.ScheduleFrame();
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				const std::vector<Box>& arrBoxes = scheduler.GetScheduledBoxes();
+				for (size_t i = 0; i < arrBoxes.size(); i++)
+				{
+					injector.InjectBox(albedo, radiance, arrBoxes[i].vMin, arrBoxes[i].vMax);
+				}
+				float fMeasuredMs = static_cast<float>(GetElapsedMs(start));
+				scheduler.ReportFrameCost(0, fMeasuredMs);
+
+				const FrameStats& stats = scheduler.GetFrameStats();
+				if (f > 0)
+				{
+					iMaxStaleness = std::max(iMaxStaleness, stats.iMaxStaleness);
+					dTotalMs += fMeasuredMs;
+					iTotalRegions += stats.iNumRegionsUpdated;
+				}
+				outfile << iResolution << "," << fBudgetMs << "," << stats.iFrame << "," << stats.iNumRegionsUpdated << "," << stats.iNumForced << "," << stats.iNumBoxes << ","
+					<< stats.fEstimatedMs << "," << fMeasuredMs << "," << (stats.bOverBudget ? "Yes" : "No") << "," << stats.iMaxStaleness << "," << stats.fMeanStaleness << "\n";
+			}
+
+			//Once things stop moving a full cycle of frames should leave exactly what relighting everything gives
+			for (int f = 0; f < iNumRegions + 1; f++)
+			{
+				scheduler.ScheduleFrame();
+				const std::vector<Box>& arrBoxes = scheduler.GetScheduledBoxes();
+				for (size_t i = 0; i < arrBoxes.size(); i++)
+				{
+					injector.InjectBox(albedo, radiance, arrBoxes[i].vMin, arrBoxes[i].vMax);
+				}
+				if (scheduler.GetFrameStats().iMaxStaleness <= f)
+				{
+					break;
+				}
+			}
+			CPUVoxelVolume reference;
+			reference.Initialise(iResolution, 1);
+			injector.Inject(albedo, reference);
+			CPURadianceInjector::CompareResult result = CPURadianceInjector::Compare(reference, radiance);
+			bAllConverged &= result.iNumMismatches == 0;
+
+			double dFrames = static_cast<double>(iNumFrames - 1);
+			summary << "\n" << iResolution << " Budget " << fBudgetMs << "ms Mean Frame(ms):," << dTotalMs / dFrames << ",Mean Regions:," << iTotalRegions / dFrames
+				<< ",Max Staleness:," << iMaxStaleness << ",Mismatches After Settling:," << result.iNumMismatches;
+			VS_LOG(sName << " " << iResolution << "^3 budget " << fBudgetMs << "ms: " << dTotalMs / dFrames << "ms a frame against " << dFullMs
+				<< "ms for everything, " << iTotalRegions / dFrames << " of " << iNumRegions << " regions a frame, max staleness " << iMaxStaleness);
+		}
+	}
+	outfile << summary.str();
+	int iValidationFailures = Validate(1);
+	outfile << "\nValidation Failures:," << iValidationFailures;
+	outfile.close();
+
+	if (!bAllConverged)
+	{
+		VS_LOG_VERBOSE("Amortised voxel updates didn't settle on the full relight");
+	}
+	return bAllConverged && iValidationFailures == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
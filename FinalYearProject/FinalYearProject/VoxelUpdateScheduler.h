@@ -0,0 +1,138 @@
+#ifndef VOXEL_UPDATE_SCHEDULER_H
+#define VOXEL_UPDATE_SCHEDULER_H
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <DirectXMath.h>
+#include <vector>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+using namespace DirectX;
+
+class CPUVoxeliser;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//Spreads relighting the voxel volume over several frames, since the lighting barely changes from one frame to the
+//next. The volume is cut into iRegionSize^3 regions and each frame updates as many of the least recently updated
+//ones as fit in a time budget, so every region gets refreshed every few frames in turn. Regions marked dirty -
+//where a dynamic mesh was or is, or in range of a light that changed - are always updated the next frame, even if
+//they blow the budget. The cost of a frame is learned from the times it's given, as a fixed part plus a part per
+//region. No D3D in here so it can be run and checked on its own; VoxelisedScene does the copies.
+class VoxelUpdateScheduler
+{
+public:
+
+	//Voxels [vMin, vMax)
+	struct Box
+	{
+		int vMin[3];
+		int vMax[3];
+	};
+
+	struct FrameStats
+	{
+		int iFrame;
+		int iNumRegionsUpdated;
+		int iNumForced;				//dirty regions, updated whatever the budget
+		int iNumBoxes;				//the regions merged into runs along x
+		float fEstimatedMs;
+		bool bOverBudget;
+		int iMaxStaleness;			//frames since the least recently updated region was updated, after this frame
+		float fMeanStaleness;
+	};
+
+	VoxelUpdateScheduler();
+	~VoxelUpdateScheduler();
+
+	//iResolution has to be a multiple of iRegionSize. Every region starts dirty, so the first frame does everything.
+	bool Initialise(int iResolution, int iRegionSize, float fBudgetMs);
+
+	void SetBudgetMs(float fBudgetMs) { m_fBudgetMs = fBudgetMs; }
+	float GetBudgetMs() const { return m_fBudgetMs; }
+	//What a frame is assumed to cost before any times are reported
+	void SetCostEstimate(float fFixedMs, float fPerRegionMs);
+	//Fewest regions a frame takes in turn on top of the dirty ones, so the rest of the volume keeps being refreshed
+	//however tight the budget or however much is dirty
+	void SetMinRegionsPerFrame(int iMinRegions) { m_iMinRegionsPerFrame = iMinRegions; }
+
+	int GetResolution() const { return m_iResolution; }
+	int GetRegionSize() const { return m_iRegionSize; }
+	int GetRegionsPerAxis() const { return m_iRegionsPerAxis; }
+	int GetNumRegions() const { return static_cast<int>(m_arrLastUpdated.size()); }
+	int GetRegionIndex(int rx, int ry, int rz) const { return (rz * m_iRegionsPerAxis + ry) * m_iRegionsPerAxis + rx; }
+	void GetRegionBox(int iRegion, Box& box) const;
+
+	//Voxels [vMin, vMax), clipped to the volume
+	void MarkBoxDirty(const int vMin[3], const int vMax[3]);
+	//Centre and radius in voxels, e.g. a point light's range
+	void MarkSphereDirty(const XMFLOAT3& vCentre, float fRadius);
+	void MarkAllDirty();
+	//Regions with nothing in them are only updated when they're dirty, as there's nothing there to light
+	void SetRegionEmpty(int iRegion, bool bEmpty) { m_arrEmpty[iRegion] = bEmpty ? 1 : 0; }
+
+	//Picks this frame's regions: every dirty one, then the least recently updated ones that fit the budget
+	void ScheduleFrame();
+	const std::vector<int>& GetScheduledRegions() const { return m_arrScheduled; }
+	const std::vector<Box>& GetScheduledBoxes() const { return m_arrBoxes; }
+	const FrameStats& GetFrameStats() const { return m_FrameStats; }
+
+	//The measured cost of the frame scheduled iFramesAgo frames before the latest one, which is 0. GPU timestamps come
+	//back a frame or two late, so the scheduler keeps the last few frames' region counts to match them up with.
+	void ReportFrameCost(int iFramesAgo, float fMs);
+	float GetFixedCostMs() const { return m_fFixedMs; }
+	float GetCostPerRegionMs() const { return m_fPerRegionMs; }
+
+	//Frames since the region was last updated, -1 if it never has been
+	int GetStaleness(int iRegion) const { return m_arrLastUpdated[iRegion] < 0 ? -1 : m_iFrame - m_arrLastUpdated[iRegion]; }
+
+	//Random budgets, dirty boxes and costs against the guarantees: dirty regions go the frame after they're marked,
+	//nothing goes twice in a frame, the budget holds when nothing is dirty, no non-empty region goes staler than the
+	//regions divided by the regions a frame, and the learned cost comes out close to a linear one it's given.
+	//Returns the number of failures.
+	static int Validate(unsigned int iSeed);
+
+	//Plays back a dynamic box moving through the voxeliser's triangles and a light moving around at 128^3 and 256^3,
+	//relighting each frame's regions with CPURadianceInjector at budgets of a sixteenth to a quarter of relighting
+	//everything, and writes the regions updated, staleness and cost of every frame to ../Results/. Fails if the
+	//volume doesn't come out the same as a full relight once things stop moving.
+	static bool RunBenchmark(const char* sName, CPUVoxeliser* pVoxeliser);
+
+private:
+
+	static const int kCostHistory = 8;
+
+	void UpdateStaleness();
+
+	int m_iResolution;
+	int m_iRegionSize;
+	int m_iRegionsPerAxis;
+	int m_iFrame;
+	int m_iMinRegionsPerFrame;
+	float m_fBudgetMs;
+
+	std::vector<int> m_arrLastUpdated;		//frame, -1 for never
+	std::vector<uint8_t> m_arrDirty;
+	std::vector<uint8_t> m_arrEmpty;
+	std::vector<int> m_arrScheduled;
+	std::vector<Box> m_arrBoxes;
+	std::vector<uint64_t> m_arrCandidates;	//last updated frame in the high bits, region in the low bits, for picking
+
+	//Linear cost model fitted with exponentially weighted least squares
+	float m_fFixedMs;
+	float m_fPerRegionMs;
+	double m_dMeanRegions;
+	double m_dMeanMs;
+	double m_dMeanRegionsSq;
+	double m_dMeanRegionsMs;
+	bool m_bHaveCostSamples;
+	int m_arrRegionHistory[kCostHistory];	//regions updated, by frame modulo kCostHistory
+
+	FrameStats m_FrameStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // !VOXEL_UPDATE_SCHEDULER_H
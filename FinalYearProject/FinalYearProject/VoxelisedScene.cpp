@@ -1,5 +1,7 @@
 #include "VoxelisedScene.h"
 #include "Debugging.h"
+#include <algorithm>
+#include <cstring>
 
 
 //Defines for compute shaders..
@@ -12,9 +14,32 @@ VoxelisedScene::VoxelisedScene()
 	:m_iDebugMipLevel(0)
 	, m_iCurrentOccupationTexture(0)
 	, m_bReadyToRunProfiling(false)
+	, m_bPredictTileResidency(false)
+	, m_bIncrementalVoxelisation(false)
+	, m_bStaticVoxelsValid(false)
+	, m_pStaticVoxelVolume(nullptr)
+	, m_pVoxelVolume(nullptr)
+	, m_iVoxelsTouched(0)
+	, m_bRegionVoxelUpdates(false)
+	, m_bAmortisedVoxelUpdates(false)
+	, m_pInjectVolume(nullptr)
+	, m_pEmptyRegionVolume(nullptr)
+	, m_iLastNumLights(-1)
+	, m_iInjectFrame(0)
+#if SPARSE_VOXEL_OCTREES
+	, m_pOctree(nullptr)
+#endif
+#if BRICK_POOL
+	, m_pBrickPool(nullptr)
+#endif
 {
-	
-	
+	for (int i = 0; i < INJECT_TIMING_FRAMES; i++)
+	{
+		m_pInjectTimingDisjoint[i] = nullptr;
+		m_pInjectTimingStart[i] = nullptr;
+		m_pInjectTimingEnd[i] = nullptr;
+		m_arrInjectTimingFrame[i] = -1;
+	}
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -32,28 +57,11 @@ HRESULT VoxelisedScene::Initialise(ID3D11Device3* pDevice, ID3D11DeviceContext3*
 	m_bUseTiledResources = bUseTiledResources;
 	if (m_bUseTiledResources)
 	{
-		for (int z = 0; z < m_iTextureDimension / 16; z++)
-		{
-			for (int y = 0; y < m_iTextureDimension / 32; y++)
-			{
-				for (int x = 0; x < m_iTextureDimension / 32; x++)
-				{
-					m_bPreviousFrameOccupation.push_back(false);
-				}
-			}
-		}
-
-		for (int i = 1; i < MIP_LEVELS; i++)
-		{
-			int mult = std::pow(2, i);
-			int numTilesInMip = ((m_iTextureDimension / 16) / (mult)) * ((m_iTextureDimension / 32) / mult) * ((m_iTextureDimension / 32) / mult);
-			m_bPreviousFrameOccupationMipLevels[i - 1] = new bool[numTilesInMip];
-			for (int j = 0; j < numTilesInMip; j++)
-			{
-				m_bPreviousFrameOccupationMipLevels[i - 1][j] = false;
-			}
-		}
-
+		m_bPredictTileResidency = TILE_RESIDENCY_PREDICTION != 0;
+		//UpdateTiles reads back the occupation from OCCUPATION_FRAMES - 1 frames ago
+		m_ResidencyWorker.Initialise(m_iTextureDimension / 32, m_iTextureDimension / 32, m_iTextureDimension / 16, MIP_LEVELS, 32, 32, 16,
+			OCCUPATION_FRAMES - 1, m_bPredictTileResidency, TILE_RESIDENCY_WORKER != 0);
+		m_ResidencyWorker.SetBudget(TILE_MAPPING_BUDGET_TILES, TILE_MAPPING_BUDGET_US);
 	}
 	else
 	{
@@ -146,11 +154,71 @@ HRESULT VoxelisedScene::Initialise(ID3D11Device3* pDevice, ID3D11DeviceContext3*
 #if SPARSE_VOXEL_OCTREES
 	InitialiseOctreeData();
 #endif
+#if BRICK_POOL
+	m_pBrickPool = new BrickPool;
+	if (!m_pBrickPool->Initialise(m_iTextureDimension))
+	{
+		VS_LOG_VERBOSE("Failed to initialise brick pool");
+	}
+#endif
 	
 	
 	
 	m_pRadianceVolume = new Texture3D;
 	m_pRadianceVolume->Init(pDevice, pContext, m_iTextureDimension, m_iTextureDimension, m_iTextureDimension, MIP_LEVELS, DXGI_FORMAT_R8G8B8A8_TYPELESS, DXGI_FORMAT_R32_UINT, DXGI_FORMAT_R8G8B8A8_UNORM, D3D11_USAGE_DEFAULT, D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE, 0, MiscFlags | D3D11_RESOURCE_MISC_GENERATE_MIPS);
+
+#if INCREMENTAL_VOXELISATION
+	//The tiled volume maps its tiles from what gets voxelised each frame, so it has to revoxelise everything
+	m_bIncrementalVoxelisation = !m_bUseTiledResources;
+#endif
+	if (m_bIncrementalVoxelisation)
+	{
+		m_pStaticVoxelVolume = new Texture3D;
+		m_pStaticVoxelVolume->Init(pDevice, pContext, m_iTextureDimension, m_iTextureDimension, m_iTextureDimension, 1, DXGI_FORMAT_R8G8B8A8_TYPELESS, DXGI_FORMAT_R32_UINT, DXGI_FORMAT_R8G8B8A8_UNORM, D3D11_USAGE_DEFAULT, 0, 0, 0);
+		m_pVoxelVolume = new Texture3D;
+		m_pVoxelVolume->Init(pDevice, pContext, m_iTextureDimension, m_iTextureDimension, m_iTextureDimension, 1, DXGI_FORMAT_R8G8B8A8_TYPELESS, DXGI_FORMAT_R32_UINT, DXGI_FORMAT_R8G8B8A8_UNORM, D3D11_USAGE_DEFAULT, D3D11_BIND_UNORDERED_ACCESS, 0, 0);
+		m_bStaticVoxelsValid = false;
+	}
+
+	//Only the regions that changed get copied in and relit. Amortising gives the scheduler a budget to refresh the rest
+	//in turn, without one it takes exactly the dirty regions.
+	if (m_bIncrementalVoxelisation)
+	{
+		m_bRegionVoxelUpdates = m_UpdateScheduler.Initialise(m_iTextureDimension, VOXEL_UPDATE_REGION_SIZE, 0.f);
+	}
+#if AMORTISED_VOXEL_UPDATES
+	m_bAmortisedVoxelUpdates = m_bRegionVoxelUpdates;
+#endif
+	if (m_bAmortisedVoxelUpdates)
+	{
+		//The budget comes from SetVoxelUpdateBudgetMs
+		D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+		D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+		for (int i = 0; i < INJECT_TIMING_FRAMES; i++)
+		{
+			if (FAILED(pDevice->CreateQuery(&disjointDesc, &m_pInjectTimingDisjoint[i])) || FAILED(pDevice->CreateQuery(&timestampDesc, &m_pInjectTimingStart[i])) ||
+				FAILED(pDevice->CreateQuery(&timestampDesc, &m_pInjectTimingEnd[i])))
+			{
+				VS_LOG_VERBOSE("Failed to create inject radiance timing queries");
+				return E_FAIL;
+			}
+		}
+	}
+	else if (m_bRegionVoxelUpdates)
+	{
+		m_UpdateScheduler.SetMinRegionsPerFrame(0);
+	}
+	if (m_bRegionVoxelUpdates)
+	{
+		m_pInjectVolume = new Texture3D;
+		m_pInjectVolume->Init(pDevice, pContext, m_iTextureDimension, m_iTextureDimension, m_iTextureDimension, 1, DXGI_FORMAT_R8G8B8A8_TYPELESS, DXGI_FORMAT_R32_UINT, DXGI_FORMAT_R8G8B8A8_UNORM, D3D11_USAGE_DEFAULT, D3D11_BIND_UNORDERED_ACCESS, 0, 0);
+		//A whole row of regions, the biggest box the scheduler hands out
+		m_pEmptyRegionVolume = new Texture3D;
+		m_pEmptyRegionVolume->Init(pDevice, pContext, m_iTextureDimension, VOXEL_UPDATE_REGION_SIZE, VOXEL_UPDATE_REGION_SIZE, 1, DXGI_FORMAT_R8G8B8A8_TYPELESS, DXGI_FORMAT_R32_UINT, DXGI_FORMAT_R8G8B8A8_UNORM, D3D11_USAGE_DEFAULT, D3D11_BIND_UNORDERED_ACCESS, 0, 0);
+		UINT colour[4] = { 0, 0, 0, 0 };
+		pContext->ClearUnorderedAccessViewUint(m_pInjectVolume->GetUAV(), colour);
+		pContext->ClearUnorderedAccessViewUint(m_pEmptyRegionVolume->GetUAV(), colour);
+	}
 		
 
 	//Initialise Rasteriser state
@@ -202,6 +270,102 @@ void VoxelisedScene::RenderClearVoxelsPass(ID3D11DeviceContext* pContext)
 	colour[3] = 0;
 	
 	pContext->ClearUnorderedAccessViewUint(m_pRadianceVolume->GetUAV(), colour);
+	if (m_bUseTiledResources)
+	{
+		//The voxeliser only ever sets tiles as occupied, so without this nothing would be unmapped once it was mapped
+		pContext->ClearUnorderedAccessViewUint(m_pTileOccupation->GetUAV(), colour);
+	}
+	m_iVoxelsTouched = static_cast<long long>(m_iTextureDimension) * m_iTextureDimension * m_iTextureDimension;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelisedScene::RenderClearVoxelsPass(ID3D11DeviceContext* pContext, const std::vector<Mesh*>& arrMeshes)
+{
+	if (!m_bIncrementalVoxelisation)
+	{
+		RenderClearVoxelsPass(pContext);
+		return;
+	}
+
+	long long iVolumeVoxels = static_cast<long long>(m_iTextureDimension) * m_iTextureDimension * m_iTextureDimension;
+	if (!m_bStaticVoxelsValid)
+	{
+		//everything is about to be voxelised again
+		UINT colour[4] = { 0, 0, 0, 0 };
+		pContext->ClearUnorderedAccessViewUint(m_pVoxelVolume->GetUAV(), colour);
+		m_arrDynamicVoxelBoxes.clear();
+		m_iVoxelsTouched = iVolumeVoxels;
+		if (m_bRegionVoxelUpdates)
+		{
+			m_UpdateScheduler.MarkAllDirty();
+		}
+		return;
+	}
+
+	std::vector<D3D11_BOX> arrBoxes;
+	for (int i = 0; i < arrMeshes.size(); i++)
+	{
+		if (!arrMeshes[i]->IsStatic())
+		{
+			AABB worldAABB;
+			arrMeshes[i]->GetWorldAABB(worldAABB);
+			D3D11_BOX box;
+			if (GetVoxelBox(worldAABB, box))
+			{
+				arrBoxes.push_back(box);
+			}
+		}
+	}
+
+	//Put the static voxels back where the dynamic meshes were last frame and where they're about to be voxelised.
+	//A mesh's two boxes usually overlap as it won't have moved far, so they're restored as one.
+	m_iVoxelsTouched = 0;
+	for (int i = 0; i < static_cast<int>(std::max(arrBoxes.size(), m_arrDynamicVoxelBoxes.size())); i++)
+	{
+		D3D11_BOX restore[2];
+		int iNumBoxes = 0;
+		bool bCurrent = i < arrBoxes.size();
+		bool bPrevious = i < m_arrDynamicVoxelBoxes.size();
+		if (bCurrent && bPrevious &&
+			arrBoxes[i].left < m_arrDynamicVoxelBoxes[i].right && m_arrDynamicVoxelBoxes[i].left < arrBoxes[i].right &&
+			arrBoxes[i].top < m_arrDynamicVoxelBoxes[i].bottom && m_arrDynamicVoxelBoxes[i].top < arrBoxes[i].bottom &&
+			arrBoxes[i].front < m_arrDynamicVoxelBoxes[i].back && m_arrDynamicVoxelBoxes[i].front < arrBoxes[i].back)
+		{
+			D3D11_BOX& box = restore[iNumBoxes++];
+			box.left = std::min(arrBoxes[i].left, m_arrDynamicVoxelBoxes[i].left);
+			box.top = std::min(arrBoxes[i].top, m_arrDynamicVoxelBoxes[i].top);
+			box.front = std::min(arrBoxes[i].front, m_arrDynamicVoxelBoxes[i].front);
+			box.right = std::max(arrBoxes[i].right, m_arrDynamicVoxelBoxes[i].right);
+			box.bottom = std::max(arrBoxes[i].bottom, m_arrDynamicVoxelBoxes[i].bottom);
+			box.back = std::max(arrBoxes[i].back, m_arrDynamicVoxelBoxes[i].back);
+		}
+		else
+		{
+			if (bCurrent)
+			{
+				restore[iNumBoxes++] = arrBoxes[i];
+			}
+			if (bPrevious)
+			{
+				restore[iNumBoxes++] = m_arrDynamicVoxelBoxes[i];
+			}
+		}
+
+		for (int j = 0; j < iNumBoxes; j++)
+		{
+			pContext->CopySubresourceRegion(m_pVoxelVolume->GetTexture(), 0, restore[j].left, restore[j].top, restore[j].front, m_pStaticVoxelVolume->GetTexture(), 0, &restore[j]);
+			m_iVoxelsTouched += static_cast<long long>(restore[j].right - restore[j].left) * (restore[j].bottom - restore[j].top) * (restore[j].back - restore[j].front);
+			if (m_bRegionVoxelUpdates)
+			{
+				//The voxels here have changed so they have to be relit this frame
+				int vMin[3] = { static_cast<int>(restore[j].left), static_cast<int>(restore[j].top), static_cast<int>(restore[j].front) };
+				int vMax[3] = { static_cast<int>(restore[j].right), static_cast<int>(restore[j].bottom), static_cast<int>(restore[j].back) };
+				m_UpdateScheduler.MarkBoxDirty(vMin, vMax);
+			}
+		}
+	}
+	m_arrDynamicVoxelBoxes = arrBoxes;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -211,9 +375,39 @@ void VoxelisedScene::RenderInjectRadiancePass(ID3D11DeviceContext* pContext)
 	ID3D11UnorderedAccessView* ppUAViewNULL[1] = { nullptr };
 	ID3D11ShaderResourceView* ppSRVNull[1] = { nullptr };
 
-	pContext->CSSetShader(m_pInjectRadianceComputeShader, nullptr, 0);
 	ID3D11UnorderedAccessView* uav = m_pRadianceVolume->GetUAV();
-	
+	std::vector<D3D11_BOX> arrBoxes;
+	int iTimingSet = m_iInjectFrame % INJECT_TIMING_FRAMES;
+	if (m_bAmortisedVoxelUpdates)
+	{
+		//Reuses the set from INJECT_TIMING_FRAMES frames ago, given up on if it still hasn't come back
+		ReportInjectRadianceTimes(pContext);
+		pContext->Begin(m_pInjectTimingDisjoint[iTimingSet]);
+		pContext->End(m_pInjectTimingStart[iTimingSet]);
+	}
+	if (m_bRegionVoxelUpdates)
+	{
+		MarkChangedLightsDirty();
+		m_UpdateScheduler.ScheduleFrame();
+
+		//Only this frame's regions go in to be lit, the rest of the inject volume is left empty
+		const std::vector<VoxelUpdateScheduler::Box>& arrScheduled = m_UpdateScheduler.GetScheduledBoxes();
+		arrBoxes.resize(arrScheduled.size());
+		for (int i = 0; i < arrScheduled.size(); i++)
+		{
+			D3D11_BOX& box = arrBoxes[i];
+			box.left = arrScheduled[i].vMin[0];
+			box.top = arrScheduled[i].vMin[1];
+			box.front = arrScheduled[i].vMin[2];
+			box.right = arrScheduled[i].vMax[0];
+			box.bottom = arrScheduled[i].vMax[1];
+			box.back = arrScheduled[i].vMax[2];
+			pContext->CopySubresourceRegion(m_pInjectVolume->GetTexture(), 0, box.left, box.top, box.front, m_pVoxelVolume->GetTexture(), 0, &box);
+		}
+		uav = m_pInjectVolume->GetUAV();
+	}
+
+	pContext->CSSetShader(m_pInjectRadianceComputeShader, nullptr, 0);
 	pContext->CSSetUnorderedAccessViews(0, 1, &uav, nullptr);
 	
 	ID3D11Buffer* pLightBuffer = LightManager::Get()->GetLightBuffer();
@@ -224,6 +418,102 @@ void VoxelisedScene::RenderInjectRadiancePass(ID3D11DeviceContext* pContext)
 	//Reset
 	pContext->CSSetShader(nullptr, nullptr, 0);
 	pContext->CSSetUnorderedAccessViews(0, 1, ppUAViewNULL, nullptr);
+
+	//Move the lit regions over to the radiance volume and empty them out of the inject volume for next frame
+	for (int i = 0; i < arrBoxes.size(); i++)
+	{
+		const D3D11_BOX& box = arrBoxes[i];
+		pContext->CopySubresourceRegion(m_pRadianceVolume->GetTexture(), 0, box.left, box.top, box.front, m_pInjectVolume->GetTexture(), 0, &box);
+		D3D11_BOX emptyBox = { 0, 0, 0, box.right - box.left, box.bottom - box.top, box.back - box.front };
+		pContext->CopySubresourceRegion(m_pInjectVolume->GetTexture(), 0, box.left, box.top, box.front, m_pEmptyRegionVolume->GetTexture(), 0, &emptyBox);
+		m_iVoxelsTouched += 3 * static_cast<long long>(emptyBox.right) * emptyBox.bottom * emptyBox.back;
+	}
+
+	if (m_bAmortisedVoxelUpdates)
+	{
+		pContext->End(m_pInjectTimingEnd[iTimingSet]);
+		pContext->End(m_pInjectTimingDisjoint[iTimingSet]);
+		m_arrInjectTimingFrame[iTimingSet] = m_iInjectFrame;
+		m_iInjectFrame++;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelisedScene::ReportInjectRadianceTimes(ID3D11DeviceContext* pContext)
+{
+	//Oldest first, as the scheduler only keeps a few frames of region counts to match the times up with
+	for (int f = m_iInjectFrame - INJECT_TIMING_FRAMES; f < m_iInjectFrame; f++)
+	{
+		int i = f % INJECT_TIMING_FRAMES;
+		if (f < 0 || m_arrInjectTimingFrame[i] != f)
+		{
+			continue;
+		}
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		if (pContext->GetData(m_pInjectTimingDisjoint[i], &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		{
+			//Later ones won't be done either
+			break;
+		}
+		UINT64 iStart, iEnd;
+		m_arrInjectTimingFrame[i] = -1;
+		if (!disjoint.Disjoint && pContext->GetData(m_pInjectTimingStart[i], &iStart, sizeof(iStart), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+			pContext->GetData(m_pInjectTimingEnd[i], &iEnd, sizeof(iEnd), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+		{
+			//The scheduler's latest frame is the last one, this frame hasn't been scheduled yet
+			float fMs = static_cast<float>(static_cast<double>(iEnd - iStart) / static_cast<double>(disjoint.Frequency) * 1000.0);
+			m_UpdateScheduler.ReportFrameCost(m_iInjectFrame - 1 - f, fMs);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelisedScene::MarkChangedLightsDirty()
+{
+	LightManager::LightBuffer lightBuffer;
+	LightManager::Get()->FillLightBuffer(lightBuffer);
+	int iNumLights = LightManager::Get()->GetNumLightsAllocated();
+
+	auto equal3 = [](const XMFLOAT3& a, const XMFLOAT3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+	auto equal4 = [](const XMFLOAT4& a, const XMFLOAT4& b) { return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w; };
+	if (iNumLights != m_iLastNumLights || !equal4(lightBuffer.AmbientColour, m_LastLightBuffer.AmbientColour) ||
+		!equal4(lightBuffer.DirectionalLightColour, m_LastLightBuffer.DirectionalLightColour) || !equal3(lightBuffer.DirectionalLightDirection, m_LastLightBuffer.DirectionalLightDirection))
+	{
+		//These light everything
+		m_UpdateScheduler.MarkAllDirty();
+	}
+	else
+	{
+		//m_mWorldToVoxelGrid is kept transposed for the shaders
+		XMMATRIX mWorldToVoxelGrid = XMMatrixTranspose(m_mWorldToVoxelGrid);
+		float fHalfRes = m_iTextureDimension * 0.5f;
+		for (int i = 0; i < iNumLights; i++)
+		{
+			const LightManager::PointLightPixelStruct* arrLights[2] = { &m_LastLightBuffer.pointLights[i], &lightBuffer.pointLights[i] };
+			if (equal3(arrLights[0]->vPosition, arrLights[1]->vPosition) && equal4(arrLights[0]->vDiffuseColour, arrLights[1]->vDiffuseColour) && arrLights[0]->fRange == arrLights[1]->fRange)
+			{
+				continue;
+			}
+
+			//Everything it reached and everything it reaches now, fRange is 1 / range
+			for (int j = 0; j < 2; j++)
+			{
+				if (arrLights[j]->fRange <= 0.f)
+				{
+					m_UpdateScheduler.MarkAllDirty();
+					continue;
+				}
+				XMFLOAT3 vGrid;
+				XMStoreFloat3(&vGrid, XMVector3TransformCoord(XMLoadFloat3(&arrLights[j]->vPosition), mWorldToVoxelGrid));
+				XMFLOAT3 vVoxel(vGrid.x * fHalfRes + fHalfRes, vGrid.y * fHalfRes + fHalfRes, vGrid.z * fHalfRes + fHalfRes);
+				m_UpdateScheduler.MarkSphereDirty(vVoxel, 1.f / (arrLights[j]->fRange * GetVoxelScale()) + 1.f);
+			}
+		}
+	}
+	m_LastLightBuffer = lightBuffer;
+	m_iLastNumLights = iNumLights;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -296,8 +586,58 @@ void VoxelisedScene::RenderMesh(ID3D11DeviceContext3* pDeviceContext, const XMMA
 		}
 	}
 	PostRender(pDeviceContext);
+
+	AABB worldAABB;
+	pMesh->GetWorldAABB(worldAABB);
+	D3D11_BOX box;
+	if (GetVoxelBox(worldAABB, box))
+	{
+		m_iVoxelsTouched += static_cast<long long>(box.right - box.left) * (box.bottom - box.top) * (box.back - box.front);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelisedScene::RenderMeshes(ID3D11DeviceContext3* pDeviceContext, const std::vector<Mesh*>& arrMeshes, const XMMATRIX& mView, const XMMATRIX& mProjection, const XMFLOAT3& eyePos)
+{
+	XMMATRIX mWorld;
+	long long iVolumeVoxels = static_cast<long long>(m_iTextureDimension) * m_iTextureDimension * m_iTextureDimension;
+	if (m_bIncrementalVoxelisation && !m_bStaticVoxelsValid)
+	{
+		//Voxelise the static meshes on their own and keep them
+		for (int i = 0; i < arrMeshes.size(); i++)
+		{
+			if (arrMeshes[i]->IsStatic())
+			{
+				arrMeshes[i]->GetWorldMatrix(mWorld);
+				RenderMesh(pDeviceContext, mWorld, mView, mProjection, eyePos, arrMeshes[i]);
+			}
+		}
+		pDeviceContext->CopySubresourceRegion(m_pStaticVoxelVolume->GetTexture(), 0, 0, 0, 0, m_pVoxelVolume->GetTexture(), 0, nullptr);
+		m_iVoxelsTouched += iVolumeVoxels;
+		m_bStaticVoxelsValid = true;
+	}
+
+	for (int i = 0; i < arrMeshes.size(); i++)
+	{
+		if (!m_bIncrementalVoxelisation || !arrMeshes[i]->IsStatic())
+		{
+			arrMeshes[i]->GetWorldMatrix(mWorld);
+			RenderMesh(pDeviceContext, mWorld, mView, mProjection, eyePos, arrMeshes[i]);
+		}
+	}
+
+	if (m_bIncrementalVoxelisation && !m_bRegionVoxelUpdates)
+	{
+		//Injecting radiance overwrites the voxels, so without the scheduler to say which regions changed it gets a fresh
+		//copy of all of them every frame
+		pDeviceContext->CopySubresourceRegion(m_pRadianceVolume->GetTexture(), 0, 0, 0, 0, m_pVoxelVolume->GetTexture(), 0, nullptr);
+		m_iVoxelsTouched += iVolumeVoxels;
+	}
+
 	if (m_bUseTiledResources)
 	{
+		//Once a frame with every mesh in it, so the one UpdateTiles reads is OCCUPATION_FRAMES - 1 frames old
 		m_iCurrentOccupationTexture = (m_iCurrentOccupationTexture + 1) % OCCUPATION_FRAMES;
 		pDeviceContext->CopySubresourceRegion(m_pTileOccupationStaging[m_iCurrentOccupationTexture], 0, 0, 0, 0, m_pTileOccupation->GetTexture(), 0, nullptr);
 	}
@@ -305,6 +645,21 @@ void VoxelisedScene::RenderMesh(ID3D11DeviceContext3* pDeviceContext, const XMMA
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void VoxelisedScene::RenderMeshCPU(CPUVoxeliser* pVoxeliser, const XMMATRIX& mWorld, Mesh* pMesh)
+{
+	//Same submeshes the GPU pass draws, but needs the mesh to have kept its triangles (Mesh::SetRetainCPUGeometry)
+	for (int i = 0; i < pMesh->GetMeshArray().size(); i++)
+	{
+		SubMesh* pSubMesh = pMesh->GetMeshArray()[i];
+		if (!pSubMesh->m_pMaterial->UsesAlphaMaps() && !pSubMesh->m_arrModel.empty())
+		{
+			pVoxeliser->AddTriangles(&pSubMesh->m_arrModel[0].pos, sizeof(ModelType), static_cast<int>(pSubMesh->m_arrModel.size()), mWorld, XMFLOAT4(1.f, 1.f, 1.f, 1.f));
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 bool VoxelisedScene::SetVoxeliseShaderParams(ID3D11DeviceContext3* pDeviceContext, const XMMATRIX& mWorld, const XMMATRIX& mView, const XMMATRIX& mProjection, const XMFLOAT3& eyePos)
 {
 	m_pVoxeliseScenePass->SetActiveRenderPass(pDeviceContext);
@@ -346,7 +701,7 @@ bool VoxelisedScene::SetVoxeliseShaderParams(ID3D11DeviceContext3* pDeviceContex
 	}
 	else
 	{
-		ID3D11UnorderedAccessView* uavs[1] = { m_pRadianceVolume->GetUAV() };
+		ID3D11UnorderedAccessView* uavs[1] = { m_bIncrementalVoxelisation ? m_pVoxelVolume->GetUAV() : m_pRadianceVolume->GetUAV() };
 		pDeviceContext->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 0, 1, uavs, 0);
 	}
 	
@@ -404,6 +759,8 @@ void VoxelisedScene::PostRender(ID3D11DeviceContext* pContext)
 
 void VoxelisedScene::Shutdown()
 {
+	m_ResidencyWorker.Shutdown();
+
 	if (m_pVoxeliseScenePass)
 	{
 		m_pVoxeliseScenePass->Shutdown();
@@ -447,6 +804,44 @@ void VoxelisedScene::Shutdown()
 	
 	delete m_pRadianceVolume;
 	m_pRadianceVolume = nullptr;
+
+	delete m_pStaticVoxelVolume;
+	m_pStaticVoxelVolume = nullptr;
+	delete m_pVoxelVolume;
+	m_pVoxelVolume = nullptr;
+	m_arrDynamicVoxelBoxes.clear();
+	delete m_pInjectVolume;
+	m_pInjectVolume = nullptr;
+	delete m_pEmptyRegionVolume;
+	m_pEmptyRegionVolume = nullptr;
+	for (int i = 0; i < INJECT_TIMING_FRAMES; i++)
+	{
+		if (m_pInjectTimingDisjoint[i])
+		{
+			m_pInjectTimingDisjoint[i]->Release();
+			m_pInjectTimingDisjoint[i] = nullptr;
+		}
+		if (m_pInjectTimingStart[i])
+		{
+			m_pInjectTimingStart[i]->Release();
+			m_pInjectTimingStart[i] = nullptr;
+		}
+		if (m_pInjectTimingEnd[i])
+		{
+			m_pInjectTimingEnd[i]->Release();
+			m_pInjectTimingEnd[i] = nullptr;
+		}
+		m_arrInjectTimingFrame[i] = -1;
+	}
+
+#if SPARSE_VOXEL_OCTREES
+	delete m_pOctree;
+	m_pOctree = nullptr;
+#endif
+#if BRICK_POOL
+	delete m_pBrickPool;
+	m_pBrickPool = nullptr;
+#endif
 	
 	m_pDebugCubesIndexBuffer->Release();
 	m_pDebugCubesVertexBuffer->Release();
@@ -454,12 +849,6 @@ void VoxelisedScene::Shutdown()
 	
 	if (m_bUseTiledResources)
 	{
-		for (int i = 0; i < MIP_LEVELS - 1; i++)
-		{
-			delete[] m_bPreviousFrameOccupationMipLevels[i];
-			m_bPreviousFrameOccupationMipLevels[i] = nullptr;
-		}
-
 		delete m_pTileOccupation;
 		m_pTileOccupation = nullptr;
 		for (int j = 0; j < OCCUPATION_FRAMES; j++)
@@ -473,6 +862,202 @@ void VoxelisedScene::Shutdown()
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#if SPARSE_VOXEL_OCTREES
+void VoxelisedScene::InitialiseOctreeData()
+{
+	m_pOctree = new SparseVoxelOctree;
+	if (!m_pOctree->Initialise(m_iTextureDimension))
+	{
+		VS_LOG_VERBOSE("Failed to initialise sparse voxel octree");
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelisedScene::BuildOctree(const CPUVoxelVolume& volume)
+{
+	if (!m_pOctree || volume.GetResolution() != m_iTextureDimension)
+	{
+		VS_LOG_VERBOSE("Octree and CPU volume resolutions don't match");
+		return false;
+	}
+	std::vector<VoxelFragment> arrFragments;
+	volume.GatherFragments(arrFragments);
+	return m_pOctree->Build(arrFragments);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#endif
+
+#if BRICK_POOL
+bool VoxelisedScene::BuildBrickPool(const CPUVoxelVolume& volume)
+{
+	if (!m_pBrickPool)
+	{
+		return false;
+	}
+	return m_pBrickPool->Build(volume);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#endif
+
+bool VoxelisedScene::LoadStaticVoxelCache(ID3D11DeviceContext3* pContext, const char* filename, uint64_t iContentHash)
+{
+	if (!m_bIncrementalVoxelisation)
+	{
+		return false;
+	}
+
+	VoxelCache cache;
+	if (!cache.Open(filename))
+	{
+		VS_LOG_VERBOSE("No voxel cache at " << filename);
+		return false;
+	}
+	if (!cache.IsValidFor(iContentHash, m_iTextureDimension, m_mWorldToVoxelGrid))
+	{
+		VS_LOG_VERBOSE("Voxel cache " << filename << " is out of date");
+		return false;
+	}
+
+	//Straight out of the mapped file when it isn't compressed
+	const uint32_t* pTexels = cache.GetMipData(0);
+	if (!pTexels)
+	{
+		return false;
+	}
+	UINT iRowPitch = m_iTextureDimension * sizeof(uint32_t);
+	pContext->UpdateSubresource(m_pStaticVoxelVolume->GetTexture(), 0, nullptr, pTexels, iRowPitch, iRowPitch * m_iTextureDimension);
+
+	//Same state RenderMeshes leaves it in after voxelising the static meshes
+	pContext->CopySubresourceRegion(m_pVoxelVolume->GetTexture(), 0, 0, 0, 0, m_pStaticVoxelVolume->GetTexture(), 0, nullptr);
+	m_arrDynamicVoxelBoxes.clear();
+	m_bStaticVoxelsValid = true;
+	if (m_bRegionVoxelUpdates)
+	{
+		m_UpdateScheduler.MarkAllDirty();
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelisedScene::SaveStaticVoxelCache(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, const char* filename, uint64_t iContentHash)
+{
+	if (!m_bIncrementalVoxelisation || !m_bStaticVoxelsValid)
+	{
+		VS_LOG_VERBOSE("No static voxels to save to the voxel cache");
+		return false;
+	}
+
+	CPUVoxelVolume volume;
+	if (!ReadbackMip0(pDevice, pContext, m_pStaticVoxelVolume->GetTexture(), volume))
+	{
+		return false;
+	}
+
+	return VoxelCache::Write(filename, volume, m_mWorldToVoxelGrid, iContentHash);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelisedScene::CheckInjectRadiance(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, CPURadianceInjector::CompareResult& result)
+{
+	if (!m_bIncrementalVoxelisation || m_bUseTiledResources)
+	{
+		VS_LOG_VERBOSE("Checking the radiance injection needs incremental voxelisation and a regular volume");
+		return false;
+	}
+
+	CPUVoxelVolume albedo, gpuRadiance;
+	if (!ReadbackMip0(pDevice, pContext, m_pVoxelVolume->GetTexture(), albedo) || !ReadbackMip0(pDevice, pContext, m_pRadianceVolume->GetTexture(), gpuRadiance))
+	{
+		return false;
+	}
+
+	LightManager::LightBuffer lightBuffer;
+	LightManager::Get()->FillLightBuffer(lightBuffer);
+
+	CPURadianceInjector injector;
+	if (!injector.Initialise(m_mWorldToVoxelGrid, m_iTextureDimension))
+	{
+		return false;
+	}
+	injector.SetLights(lightBuffer, LightManager::Get()->GetNumLightsAllocated());
+	CPUVoxelVolume cpuRadiance;
+	double dCPUTimeMs = 0.0;
+	if (m_bRegionVoxelUpdates)
+	{
+		//Only the regions relit this frame are up to date, the rest was lit with whatever the lights were back then
+		cpuRadiance = gpuRadiance;
+		const std::vector<VoxelUpdateScheduler::Box>& arrBoxes = m_UpdateScheduler.GetScheduledBoxes();
+		for (int i = 0; i < arrBoxes.size(); i++)
+		{
+			injector.InjectBox(albedo, cpuRadiance, arrBoxes[i].vMin, arrBoxes[i].vMax);
+			dCPUTimeMs += injector.GetStats().dTimeMs;
+		}
+	}
+	else
+	{
+		cpuRadiance.Initialise(m_iTextureDimension, 1);
+		injector.Inject(albedo, cpuRadiance);
+		dCPUTimeMs = injector.GetStats().dTimeMs;
+	}
+
+	//The GPU's float to unorm conversion is allowed to be a little off, so one step either way still counts
+	result = CPURadianceInjector::Compare(gpuRadiance, cpuRadiance, 0, 1);
+	VS_LOG("Inject radiance check: " << result.iNumMismatches << " of " << result.iNumTexels << " texels differ, max channel difference " << result.iMaxChannelDifference
+		<< ", CPU took " << dCPUTimeMs << "ms");
+	return result.iNumMismatches == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VoxelisedScene::ReadbackMip0(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, ID3D11Texture3D* pTexture, CPUVoxelVolume& volume)
+{
+	D3D11_TEXTURE3D_DESC textureDesc;
+	pTexture->GetDesc(&textureDesc);
+	textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	textureDesc.Usage = D3D11_USAGE_STAGING;
+	textureDesc.BindFlags = 0;
+	textureDesc.MiscFlags = 0;
+	ID3D11Texture3D* pStaging = nullptr;
+	HRESULT result = pDevice->CreateTexture3D(&textureDesc, nullptr, &pStaging);
+	if (FAILED(result))
+	{
+		VS_LOG_VERBOSE("Failed to create readback staging texture");
+		return false;
+	}
+	pContext->CopyResource(pStaging, pTexture);
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	result = pContext->Map(pStaging, 0, D3D11_MAP_READ, 0, &mapped);
+	if (FAILED(result))
+	{
+		VS_LOG_VERBOSE("Couldn't map readback staging texture");
+		pStaging->Release();
+		return false;
+	}
+
+	volume.Initialise(m_iTextureDimension, 1);
+	size_t iRowSize = m_iTextureDimension * sizeof(uint32_t);
+	for (int z = 0; z < m_iTextureDimension; z++)
+	{
+		for (int y = 0; y < m_iTextureDimension; y++)
+		{
+			const char* pRow = static_cast<const char*>(mapped.pData) + z * mapped.DepthPitch + y * mapped.RowPitch;
+			memcpy(&volume.GetMipData(0)[volume.GetIndex(0, y, z)], pRow, iRowSize);
+		}
+	}
+	pContext->Unmap(pStaging, 0);
+	pStaging->Release();
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 ID3D11ShaderResourceView* VoxelisedScene::GetRadianceVolume()
 {
 	
@@ -482,10 +1067,15 @@ ID3D11ShaderResourceView* VoxelisedScene::GetRadianceVolume()
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void VoxelisedScene::Update(ID3D11DeviceContext3* pDeviceContext)
+void VoxelisedScene::Update(ID3D11DeviceContext3* pDeviceContext, const XMFLOAT3& vEyePos)
 {
 	if (m_bUseTiledResources)
 	{
+		//m_mWorldToVoxelGrid is kept transposed for the shaders
+		XMFLOAT3 vGrid;
+		XMStoreFloat3(&vGrid, XMVector3TransformCoord(XMLoadFloat3(&vEyePos), XMMatrixTranspose(m_mWorldToVoxelGrid)));
+		float fHalfRes = m_iTextureDimension * 0.5f;
+		m_ResidencyWorker.SetFocus(XMFLOAT3(vGrid.x * fHalfRes + fHalfRes, vGrid.y * fHalfRes + fHalfRes, vGrid.z * fHalfRes + fHalfRes));
 		UpdateTiles(pDeviceContext);
 	}
 }
@@ -496,100 +1086,69 @@ void VoxelisedScene::UpdateTiles(ID3D11DeviceContext3* pContext)
 {
 	if (m_bUseTiledResources)
 	{
-		int iNumTilesMappedThisFrame = 0;
-		int iFrameMinus2TileOccupation = (m_iCurrentOccupationTexture + 1) % OCCUPATION_FRAMES;
+		int iOldestTileOccupation = (m_iCurrentOccupationTexture + 1) % OCCUPATION_FRAMES;
 		
 		D3D11_MAPPED_SUBRESOURCE pTexture;
-		HRESULT res = pContext->Map(m_pTileOccupationStaging[iFrameMinus2TileOccupation], 0, D3D11_MAP_READ, 0, &pTexture);
+		HRESULT res = pContext->Map(m_pTileOccupationStaging[iOldestTileOccupation], 0, D3D11_MAP_READ, 0, &pTexture);
 		if (FAILED(res))
 		{
 			VS_LOG_VERBOSE("Couldn't map resource..")
 				return;
 		}
-		char* pTexData = static_cast<char*>(pTexture.pData);
+		m_ResidencyWorker.SubmitOccupancy(static_cast<const uint8_t*>(pTexture.pData), pTexture.RowPitch, pTexture.DepthPitch);
+		pContext->Unmap(m_pTileOccupationStaging[iOldestTileOccupation], 0);
 
-		UINT num = pTexData[0];
-		int index = 0;
-		for (int z = 0; z < m_iTextureDimension / 16; z++)
+		//Whatever the worker's finished, which with the thread is usually last frame's. Everything in a plan goes to
+		//the driver together at the end, a call a mip.
+		int iNumPlans = m_ResidencyWorker.ApplyPlans([&](const TileResidencyWorker::Plan& plan)
 		{
-			for (int y = 0; y < m_iTextureDimension / 32; y++)
+			m_pRadianceVolume->BeginTileBatch();
+			for (size_t i = 0; i < plan.arrTilesToUnmap.size(); i++)
 			{
-				index = z * (pTexture.DepthPitch ) + y * (pTexture.RowPitch );
-				for (int x = 0; x < m_iTextureDimension / 32; x++)
-				{
-					char* TexData = &pTexData[index];
-					if (pTexData[index] != 0)
-					{
-						if (!m_bPreviousFrameOccupation[(z*m_iTextureDimension/32* m_iTextureDimension / 32) + (y*m_iTextureDimension / 32) + x])
-						{
-							if(m_pRadianceVolume->MapTile(pContext, x, y, z, 0))
-								m_bPreviousFrameOccupation[(z * m_iTextureDimension / 32 * m_iTextureDimension / 32) + (y * m_iTextureDimension / 32) + x] = true;
-							
-							for (int i = 1; i < MIP_LEVELS; i++)
-							{
-								int mult = std::pow(2, i);
-								int mipZ = z / mult;
-								int mipY = y / mult;
-								int mipX = x / mult;
-								int mipIdx = (mipZ * ((m_iTextureDimension / 32) / mult) * ((m_iTextureDimension / 32) / mult)) + mipY * ((m_iTextureDimension / 32) / mult) + mipX;
-								if (!m_bPreviousFrameOccupationMipLevels[i - 1][mipIdx])
-								{
-									if (m_pRadianceVolume->MapTile(pContext, mipX, mipY, mipZ, i))
-									{
-										m_bPreviousFrameOccupationMipLevels[i - 1][mipIdx] = true;
-									}
-								}
-							}
-							//Limit number of tiles which can be mapped per frame to stop frame rate spikes..
-							iNumTilesMappedThisFrame++;
-// 							if (iNumTilesMappedThisFrame >= 20)
-// 							{
-// 								break;
-// 							}
-						}
-					}
-					else
-					{
-						//TODO: and unmap the tile..
-						m_bPreviousFrameOccupation[(z * m_iTextureDimension / 32 * m_iTextureDimension / 32) + (y * m_iTextureDimension / 32) + x] = false;
-					}
-					index++;
-				}
+				const TileCoord& coord = plan.arrTilesToUnmap[i];
+				m_pRadianceVolume->UnmapTile(pContext, coord.x, coord.y, coord.z, coord.iMipLevel);
 			}
-		}
-		pContext->Unmap(m_pTileOccupationStaging[iFrameMinus2TileOccupation], 0);
-		if (iNumTilesMappedThisFrame <= 0)
+			for (size_t i = 0; i < plan.arrTilesToMap.size(); i++)
+			{
+				const TileCoord& coord = plan.arrTilesToMap[i];
+				m_pRadianceVolume->MapTile(pContext, coord.x, coord.y, coord.z, coord.iMipLevel);
+			}
+			m_pRadianceVolume->SubmitTileBatch(pContext);
+		});
+
+		if (iNumPlans > 0 && !m_ResidencyWorker.HasPendingMappings())
 		{
 			m_bReadyToRunProfiling = true;
 		}
-		
 	}
 }
 
-void VoxelisedScene::UnmapAllTiles(ID3D11DeviceContext3* pDeviceContext)
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelisedScene::PredictTileResidency(const std::vector<Mesh*>& arrMeshes)
 {
-	if (m_bUseTiledResources)
+	if (!m_bUseTiledResources || !m_bPredictTileResidency)
 	{
-		m_pRadianceVolume->UnmapAllTiles(pDeviceContext);
-		for (int z = 0; z < m_iTextureDimension / 16; z++)
+		return;
+	}
+
+	//The tiles mapped this frame are first voxelised into next frame, so from where the meshes are now onwards
+	for (size_t i = 0; i < arrMeshes.size(); i++)
+	{
+		if (arrMeshes[i]->IsStatic())
 		{
-			for (int y = 0; y < m_iTextureDimension / 32; y++)
-			{
-				for (int x = 0; x < m_iTextureDimension / 32; x++)
-				{
-					m_bPreviousFrameOccupation[(z * m_iTextureDimension / 32 * m_iTextureDimension / 32) + (y * m_iTextureDimension / 32) + x] = false;
-				}
-			}
+			continue;
 		}
-
-		for (int i = 1; i < MIP_LEVELS; i++)
+		for (int iFrame = 0; iFrame <= m_ResidencyWorker.GetLookaheadFrames(); iFrame++)
 		{
-			int mult = std::pow(2, i);
-			int numTilesInMip = ((m_iTextureDimension / 16) / (mult)) * ((m_iTextureDimension / 32) / mult) * ((m_iTextureDimension / 32) / mult);
-			m_bPreviousFrameOccupationMipLevels[i - 1] = new bool[numTilesInMip];
-			for (int j = 0; j < numTilesInMip; j++)
+			AABB worldAABB;
+			arrMeshes[i]->PredictWorldAABB(iFrame, worldAABB);
+			D3D11_BOX box;
+			if (GetVoxelBox(worldAABB, box))
 			{
-				m_bPreviousFrameOccupationMipLevels[i - 1][j] = false;
+				const int vMin[3] = { static_cast<int>(box.left), static_cast<int>(box.top), static_cast<int>(box.front) };
+				const int vMax[3] = { static_cast<int>(box.right), static_cast<int>(box.bottom), static_cast<int>(box.back) };
+				m_ResidencyWorker.AddPredictedBox(vMin, vMax);
 			}
 		}
 	}
@@ -597,68 +1156,86 @@ void VoxelisedScene::UnmapAllTiles(ID3D11DeviceContext3* pDeviceContext)
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void VoxelisedScene::CreateWorldToVoxelGrid(const AABB& voxelGridAABB)
+void VoxelisedScene::CompactTiles(ID3D11DeviceContext3* pDeviceContext)
 {
-	//Initialise Matrices..
-	float voxelGridSize = 0;
-	XMFLOAT3 vVoxelGridSize;
-	XMVECTOR Min, Max, VoxelGridSize;
-	Max = XMLoadFloat3(&voxelGridAABB.Max);
-	Min = XMLoadFloat3(&voxelGridAABB.Min);
-
-	VoxelGridSize = Max - Min;
-	XMStoreFloat3(&vVoxelGridSize, VoxelGridSize);
-	//make the voxel grid into a square which will fit the whole scene
-	if (vVoxelGridSize.x > vVoxelGridSize.y)
+	if (m_bUseTiledResources)
 	{
-		if (vVoxelGridSize.x > vVoxelGridSize.z)
-		{
-			voxelGridSize = vVoxelGridSize.x;
-		}
-		else
-		{
-			voxelGridSize = vVoxelGridSize.z;
-		}
+		//Whatever was in the moved tiles is gone, fine as it's all about to be cleared and voxelised again
+		m_pRadianceVolume->CompactTilePool(pDeviceContext);
 	}
-	else
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void VoxelisedScene::UnmapAllTiles(ID3D11DeviceContext3* pDeviceContext)
+{
+	if (m_bUseTiledResources)
 	{
-		if (vVoxelGridSize.y > vVoxelGridSize.z)
-		{
-			voxelGridSize = vVoxelGridSize.y;
-		}
-		else
-		{
-			voxelGridSize = vVoxelGridSize.z;
-		}
+		m_pRadianceVolume->UnmapAllTiles(pDeviceContext);
+		m_ResidencyWorker.Reset();
 	}
-	m_vVoxelGridSize = XMFLOAT3(voxelGridSize, voxelGridSize, voxelGridSize);
-
-	float scale = m_iTextureDimension / voxelGridSize;
+}
 
-	XMVECTOR translateToOrigin = (-Min - (VoxelGridSize * 0.5f));
-	XMMATRIX scaling = XMMatrixScaling(2.f / voxelGridSize, 2.f / voxelGridSize, 2.f / voxelGridSize);
-	translateToOrigin = XMVector3Transform(translateToOrigin, scaling);
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	m_mWorldToVoxelGrid.r[0].m128_f32[0] = 2.f / voxelGridSize;
-	m_mWorldToVoxelGrid.r[0].m128_f32[1] = 0.0f;
-	m_mWorldToVoxelGrid.r[0].m128_f32[2] = 0.0f;
-	m_mWorldToVoxelGrid.r[0].m128_f32[3] = 0.0f;
+void VoxelisedScene::CreateWorldToVoxelGrid(const AABB& voxelGridAABB)
+{
+	//Initialise Matrices..
+	float voxelGridSize = 0;
+	m_mWorldToVoxelGrid = VoxelGrid::CreateWorldToVoxelGrid(voxelGridAABB.Min, voxelGridAABB.Max, voxelGridSize);
+	m_vVoxelGridSize = XMFLOAT3(voxelGridSize, voxelGridSize, voxelGridSize);
+}
 
-	m_mWorldToVoxelGrid.r[1].m128_f32[0] = 0.0f;
-	m_mWorldToVoxelGrid.r[1].m128_f32[1] = 2.f / voxelGridSize;
-	m_mWorldToVoxelGrid.r[1].m128_f32[2] = 0.0f;
-	m_mWorldToVoxelGrid.r[1].m128_f32[3] = 0.0f;
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	m_mWorldToVoxelGrid.r[2].m128_f32[0] = 0.0f;
-	m_mWorldToVoxelGrid.r[2].m128_f32[1] = 0.0f;
-	m_mWorldToVoxelGrid.r[2].m128_f32[2] = 2.f / voxelGridSize;
-	m_mWorldToVoxelGrid.r[2].m128_f32[3] = 0.0f;
+bool VoxelisedScene::GetVoxelBox(const AABB& worldAABB, D3D11_BOX& box)
+{
+	//m_mWorldToVoxelGrid is kept transposed for the shaders
+	XMMATRIX mWorldToVoxelGrid = XMMatrixTranspose(m_mWorldToVoxelGrid);
+	XMFLOAT3 vGridMin, vGridMax;
+	XMStoreFloat3(&vGridMin, XMVector3TransformCoord(XMLoadFloat3(&worldAABB.Min), mWorldToVoxelGrid));
+	XMStoreFloat3(&vGridMax, XMVector3TransformCoord(XMLoadFloat3(&worldAABB.Max), mWorldToVoxelGrid));
+
+	//grid space is [-1, 1], voxel space is [0, resolution)
+	float fHalfRes = m_iTextureDimension * 0.5f;
+	const float arrGridMin[3] = { vGridMin.x, vGridMin.y, vGridMin.z };
+	const float arrGridMax[3] = { vGridMax.x, vGridMax.y, vGridMax.z };
+	int iMin[3], iMax[3];
+	for (int i = 0; i < 3; i++)
+	{
+		iMin[i] = static_cast<int>(floorf(std::min(arrGridMin[i], arrGridMax[i]) * fHalfRes + fHalfRes)) - 1;
+		iMax[i] = static_cast<int>(ceilf(std::max(arrGridMin[i], arrGridMax[i]) * fHalfRes + fHalfRes)) + 1;
+		iMin[i] = std::max(iMin[i], 0);
+		iMax[i] = std::min(iMax[i], m_iTextureDimension);
+		if (iMin[i] >= iMax[i])
+		{
+			return false;
+		}
+	}
 
-	m_mWorldToVoxelGrid.r[3] = translateToOrigin;
-	m_mWorldToVoxelGrid.r[3].m128_f32[3] = 1.0f;
+	box.left = iMin[0];
+	box.top = iMin[1];
+	box.front = iMin[2];
+	box.right = iMax[0];
+	box.bottom = iMax[1];
+	box.back = iMax[2];
+	return true;
+}
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	m_mWorldToVoxelGrid = XMMatrixTranspose(m_mWorldToVoxelGrid);
+int VoxelisedScene::GetMemoryUsageInBytes()
+{
+	int iMemoryUsage = m_pRadianceVolume->GetMemoryUsageInBytes();
+	if (m_bIncrementalVoxelisation)
+	{
+		iMemoryUsage += m_pStaticVoxelVolume->GetMemoryUsageInBytes() + m_pVoxelVolume->GetMemoryUsageInBytes();
+	}
+	if (m_bRegionVoxelUpdates)
+	{
+		iMemoryUsage += m_pInjectVolume->GetMemoryUsageInBytes() + m_pEmptyRegionVolume->GetMemoryUsageInBytes();
+	}
+	return iMemoryUsage;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -12,10 +12,29 @@
 #include "Texture2D.h"
 #include "Texture3D.h"
 #include "RenderPass.h"
+#include "VoxelGrid.h"
+#include "CPUVoxeliser.h"
+#include "SparseVoxelOctree.h"
+#include "BrickPool.h"
+#include "VoxelCache.h"
+#include "CPURadianceInjector.h"
+#include "VoxelUpdateScheduler.h"
+#include "TileResidencyWorker.h"
+#include "LightManager.h"
 
 
 #define MIP_LEVELS 4
 #define OCCUPATION_FRAMES 5
+#define SPARSE_VOXEL_OCTREES 0
+#define BRICK_POOL 0
+#define INCREMENTAL_VOXELISATION 1
+#define AMORTISED_VOXEL_UPDATES 1
+#define VOXEL_UPDATE_REGION_SIZE 32
+#define INJECT_TIMING_FRAMES 3
+#define TILE_RESIDENCY_PREDICTION 1
+#define TILE_MAPPING_BUDGET_TILES 256
+#define TILE_MAPPING_BUDGET_US 1000.f
+#define TILE_RESIDENCY_WORKER 1
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -94,11 +113,19 @@ public:
 
 	HRESULT Initialise(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, HWND hwnd, const AABB& voxelGridAABB, int iTextureResolution, bool bUseTiledResources = false);
 	void RenderClearVoxelsPass(ID3D11DeviceContext* pContext);
+	//With incremental voxelisation this only puts the static voxels back where the dynamic meshes were last frame and
+	//are now, otherwise it clears the whole volume
+	void RenderClearVoxelsPass(ID3D11DeviceContext* pContext, const std::vector<Mesh*>& arrMeshes);
 	void RenderInjectRadiancePass(ID3D11DeviceContext* pContext);
 	void GenerateMips(ID3D11DeviceContext* pContext);
 	void RenderDebugCubes(ID3D11DeviceContext3* pContext, const XMMATRIX& mWorld, const XMMATRIX& mView, const XMMATRIX& mProjection, Camera* pCamera);
 	
 	void RenderMesh(ID3D11DeviceContext3* pDeviceContext, const XMMATRIX& mWorld, const XMMATRIX& mView, const XMMATRIX& mProjection, const XMFLOAT3& eyePos, Mesh* pVoxelise);
+	//Voxelises the meshes, leaving out the static ones while the static voxels are still cached, then copies out the
+	//frame's tile occupation for UpdateTiles to read back
+	void RenderMeshes(ID3D11DeviceContext3* pDeviceContext, const std::vector<Mesh*>& arrMeshes, const XMMATRIX& mView, const XMMATRIX& mProjection, const XMFLOAT3& eyePos);
+	//Queues the mesh on a CPU voxeliser set up with GetWorldToVoxelMatrix(), for checking the GPU output against
+	static void RenderMeshCPU(CPUVoxeliser* pVoxeliser, const XMMATRIX& mWorld, Mesh* pMesh);
 	bool SetVoxeliseShaderParams(ID3D11DeviceContext3* pDeviceContext, const XMMATRIX& mWorld, const XMMATRIX& mView, const XMMATRIX& mProjection, const XMFLOAT3& eyePos);
 	bool SetDebugShaderParams(ID3D11DeviceContext* pDeviceContext, const XMMATRIX& mWorld, const XMMATRIX& mView, const XMMATRIX& mProjection);
 
@@ -114,14 +141,65 @@ public:
 
 	float GetVoxelScale() { return m_vVoxelGridSize.x / m_iTextureDimension; } //size of one voxel
 
-	void Update(ID3D11DeviceContext3* pDeviceContext);
+	//vEyePos is where the tiles nearest get mapped first from, when there are more to map than the budget allows
+	void Update(ID3D11DeviceContext3* pDeviceContext, const XMFLOAT3& vEyePos);
 
 	void UnmapAllTiles(ID3D11DeviceContext3* pDeviceContext);
+	//Moves the mapped tiles down and shrinks the tile pool once enough of it is free, only before the clear
+	void CompactTiles(ID3D11DeviceContext3* pDeviceContext);
+	const TilePool::Stats& GetTilePoolStats() { return m_pRadianceVolume->GetTilePoolStats(); }
+	//UpdateTileMappings calls and the tiles in them from the last Update
+	const TileMappingBatch::Stats& GetTileMappingStats() { return m_pRadianceVolume->GetLastTileBatchStats(); }
+
+	//Tiled residency prediction, see ResidencyPredictor. Call after the meshes have been voxelised and before Update, so
+	//the tiles the dynamic meshes are heading into are mapped before the occupation readback catches up with them.
+	void PredictTileResidency(const std::vector<Mesh*>& arrMeshes);
+	void SetTileResidencyLookahead(int iFrames) { m_ResidencyWorker.SetLookaheadFrames(iFrames); }
+	void SetTileUnmapDelay(int iFrames) { m_ResidencyWorker.SetUnmapDelayFrames(iFrames); }
+	const ResidencyPredictor::Stats& GetTileResidencyStats() { return m_ResidencyWorker.GetResidencyStats(); }
+	//Tiled mapping budget, see TileMappingScheduler. 0 or less for no limit.
+	void SetTileMappingBudget(int iMaxTiles, float fMaxMicroseconds) { m_ResidencyWorker.SetBudget(iMaxTiles, fMaxMicroseconds); }
+	const TileMappingScheduler::FrameStats& GetTileMappingSchedule() { return m_ResidencyWorker.GetScheduleStats(); }
+	//From the occupation being read back to its mappings being applied, see TileResidencyWorker
+	const TileResidencyWorker::LatencyStats& GetTileResidencyLatency() { return m_ResidencyWorker.GetLatencyStats(); }
+
+#if SPARSE_VOXEL_OCTREES
+	//Builds the octree from a CPU voxelised copy of the scene, see CPUVoxeliser
+	bool BuildOctree(const CPUVoxelVolume& volume);
+	SparseVoxelOctree* GetOctree() { return m_pOctree; }
+#endif
+
+#if BRICK_POOL
+	//Stores the CPU voxelised copy of the scene in 8^3 bricks, see BrickPool
+	bool BuildBrickPool(const CPUVoxelVolume& volume);
+	BrickPool* GetBrickPool() { return m_pBrickPool; }
+#endif
 
-	int GetMemoryUsageInBytes() { return m_pRadianceVolume->GetMemoryUsageInBytes(); }
+	int GetMemoryUsageInBytes();
 	int GetTextureDimensions() { return m_iTextureDimension; }
 	bool ReadyToProfile() { return m_bReadyToRunProfiling; }
 
+	//Revoxelise the static meshes next frame, e.g. after one has moved
+	void InvalidateStaticVoxels() { m_bStaticVoxelsValid = false; }
+	bool AreStaticVoxelsValid() { return m_bStaticVoxelsValid; }
+
+	//Fills the static voxels from a cache written by SaveStaticVoxelCache instead of voxelising the static meshes.
+	//False if there's no cache, it's stale or this scene doesn't keep static voxels, and the next RenderMeshes voxelises.
+	bool LoadStaticVoxelCache(ID3D11DeviceContext3* pContext, const char* filename, uint64_t iContentHash);
+	//Reads the static voxels back and writes them out, they have to have been voxelised already
+	bool SaveStaticVoxelCache(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, const char* filename, uint64_t iContentHash);
+	//Reads back the voxels and the radiance the inject radiance pass lit them with, and compares it against lighting
+	//the same voxels with CPURadianceInjector. Needs incremental voxelisation, since that keeps the unlit voxels around.
+	bool CheckInjectRadiance(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, CPURadianceInjector::CompareResult& result);
+	//Voxels cleared, restored, copied or covered by a voxelised mesh's bounds this frame
+	long long GetVoxelsTouchedThisFrame() { return m_iVoxelsTouched; }
+
+	//Amortised voxel updates, see VoxelUpdateScheduler. Needs incremental voxelisation, as the unlit voxels have to be
+	//kept around to relight a region from. The budget is ignored when not amortising, as only what changed is relit.
+	bool IsAmortisingVoxelUpdates() { return m_bAmortisedVoxelUpdates; }
+	void SetVoxelUpdateBudgetMs(float fBudgetMs) { if (m_bAmortisedVoxelUpdates) { m_UpdateScheduler.SetBudgetMs(fBudgetMs); } }
+	const VoxelUpdateScheduler::FrameStats& GetVoxelUpdateStats() { return m_UpdateScheduler.GetFrameStats(); }
+
 private:
 
 	int m_iTextureDimension;
@@ -131,6 +209,14 @@ private:
 	HRESULT InitialiseShadersAndInputLayout(ID3D11Device3* pDevice, ID3D11DeviceContext* pContext, HWND hwnd);
 	void OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shaderFilename);
 	bool InitialiseDebugBuffers(ID3D11Device* pDevice);
+	//Copies mip 0 of the texture into the volume through a staging texture
+	bool ReadbackMip0(ID3D11Device3* pDevice, ID3D11DeviceContext3* pContext, ID3D11Texture3D* pTexture, CPUVoxelVolume& volume);
+	//The voxels an AABB covers, with a voxel either side for conservative rasterisation. False if it's outside the grid.
+	bool GetVoxelBox(const AABB& worldAABB, D3D11_BOX& box);
+	//Marks the regions a changed light reaches dirty, everything if the ambient or directional light changed
+	void MarkChangedLightsDirty();
+	//Hands the scheduler the inject radiance times that have come back since last frame, without waiting on any
+	void ReportInjectRadianceTimes(ID3D11DeviceContext* pContext);
 
 	
 	RenderPass*				m_pVoxeliseScenePass;
@@ -148,6 +234,34 @@ private:
 
 	Texture3D* m_pRadianceVolume;
 
+	//Incremental voxelisation. The static meshes are voxelised once into m_pStaticVoxelVolume and m_pVoxelVolume has the
+	//dynamic ones on top. Injecting radiance lights it in place, so the regions that changed are copied on to be lit.
+	bool m_bIncrementalVoxelisation;
+	bool m_bStaticVoxelsValid;
+	Texture3D* m_pStaticVoxelVolume;
+	Texture3D* m_pVoxelVolume;
+	std::vector<D3D11_BOX> m_arrDynamicVoxelBoxes;	//where the dynamic meshes were voxelised last frame
+	long long m_iVoxelsTouched;
+
+	//Region voxel updates. The voxels of the regions being relit are copied into m_pInjectVolume, which is empty
+	//everywhere else, radiance is injected into it and the regions are copied on into the radiance volume, which keeps
+	//the rest of the volume lit from earlier frames. m_pEmptyRegionVolume clears the regions out again afterwards.
+	//Without amortising only the dirty regions go, where the dynamic meshes were and are and the changed lights reach.
+	bool m_bRegionVoxelUpdates;
+	bool m_bAmortisedVoxelUpdates;
+	Texture3D* m_pInjectVolume;
+	Texture3D* m_pEmptyRegionVolume;
+	VoxelUpdateScheduler m_UpdateScheduler;
+	LightManager::LightBuffer m_LastLightBuffer;
+	int m_iLastNumLights;
+	//Timestamps around the amortised inject radiance pass, so the scheduler learns what a region costs whether or not
+	//the profiler's showing times. A set a frame for the last few frames, read back once the GPU's done with them.
+	ID3D11Query* m_pInjectTimingDisjoint[INJECT_TIMING_FRAMES];
+	ID3D11Query* m_pInjectTimingStart[INJECT_TIMING_FRAMES];
+	ID3D11Query* m_pInjectTimingEnd[INJECT_TIMING_FRAMES];
+	int m_arrInjectTimingFrame[INJECT_TIMING_FRAMES];		//the inject frame each set was issued in, -1 when it's been read
+	int m_iInjectFrame;
+
 	XMMATRIX m_mViewProjMatrices[3];
 	XMFLOAT3 m_vVoxelGridSize;
 	XMFLOAT3 m_vVoxelGridMin;
@@ -173,8 +287,18 @@ private:
 	Texture3D* m_pTileOccupation;
 	ID3D11Texture3D* m_pTileOccupationStaging[OCCUPATION_FRAMES];
 
-	std::vector<bool> m_bPreviousFrameOccupation;
-	bool *m_bPreviousFrameOccupationMipLevels[MIP_LEVELS - 1];
+	//The occupancy diff, residency prediction and mapping schedule, off the render thread with TILE_RESIDENCY_WORKER
+	bool m_bPredictTileResidency;
+	TileResidencyWorker m_ResidencyWorker;
+
+#if SPARSE_VOXEL_OCTREES
+	void InitialiseOctreeData();
+	SparseVoxelOctree* m_pOctree;
+#endif
+
+#if BRICK_POOL
+	BrickPool* m_pBrickPool;
+#endif
 
 
 };